@@ -147,6 +147,8 @@ struct kvm_vm_stat {
 
 struct kvm_vcpu_stat {
 	u32 halt_wakeup;
+	u32 halt_successful_poll;
+	u32 halt_attempted_poll;
 };
 
 struct kvm_vcpu_init;
@@ -82,6 +82,10 @@
 
 #define SO_BPF_EXTENSIONS	48
 
+#define SO_ATTACH_REUSEPORT_CBPF	49
+
+#define SO_ZEROCOPY		50
+
 #endif /* _ASM_SOCKET_H */
 
 
@@ -80,5 +80,9 @@
 
 #define SO_BPF_EXTENSIONS	48
 
+#define SO_ATTACH_REUSEPORT_CBPF	49
+
+#define SO_ZEROCOPY		50
+
 #endif /* _ASM_SOCKET_H */
 
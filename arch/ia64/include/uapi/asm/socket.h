@@ -89,4 +89,8 @@
 
 #define SO_BPF_EXTENSIONS	48
 
+#define SO_ATTACH_REUSEPORT_CBPF	49
+
+#define SO_ZEROCOPY		50
+
 #endif /* _ASM_IA64_SOCKET_H */
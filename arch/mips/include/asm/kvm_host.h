@@ -126,6 +126,8 @@ struct kvm_vcpu_stat {
 	u32 break_inst_exits;
 	u32 flush_dcache_exits;
 	u32 halt_wakeup;
+	u32 halt_successful_poll;
+	u32 halt_attempted_poll;
 };
 
 enum kvm_mips_exit_types {
@@ -48,6 +48,8 @@ struct kvm_stats_debugfs_item debugfs_entries[] = {
 	{ "break_inst", VCPU_STAT(break_inst_exits) },
 	{ "flush_dcache", VCPU_STAT(flush_dcache_exits) },
 	{ "halt_wakeup", VCPU_STAT(halt_wakeup) },
+	{ "halt_successful_poll", VCPU_STAT(halt_successful_poll) },
+	{ "halt_attempted_poll", VCPU_STAT(halt_attempted_poll) },
 	{NULL}
 };
 
@@ -203,6 +203,8 @@ struct kvm_vcpu_stat {
 	u32 deliver_program_int;
 	u32 deliver_io_int;
 	u32 exit_wait_state;
+	u32 halt_successful_poll;
+	u32 halt_attempted_poll;
 	u32 instruction_pfmf;
 	u32 instruction_stidp;
 	u32 instruction_spx;
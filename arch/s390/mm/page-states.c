@@ -99,7 +99,7 @@ void arch_set_page_states(int make_stable)
 	if (make_stable)
 		drain_local_pages(NULL);
 	for_each_populated_zone(zone) {
-		spin_lock_irqsave(&zone->lock, flags);
+		numa_spin_lock_irqsave(&zone->lock, flags);
 		for_each_migratetype_order(order, t) {
 			list_for_each(l, &zone->free_area[order].free_list[t]) {
 				page = list_entry(l, struct page, lru);
@@ -109,6 +109,6 @@ void arch_set_page_states(int make_stable)
 					set_page_unstable(page, order);
 			}
 		}
-		spin_unlock_irqrestore(&zone->lock, flags);
+		numa_spin_unlock_irqrestore(&zone->lock, flags);
 	}
 }
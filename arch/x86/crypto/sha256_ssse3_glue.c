@@ -127,12 +127,11 @@ static int sha256_ssse3_update(struct shash_desc *desc, const u8 *data,
 }
 
 
-/* Add padding and return the message digest. */
-static int sha256_ssse3_final(struct shash_desc *desc, u8 *out)
+/* Add padding, must be called between kernel_fpu_begin() and _end(). */
+static void __sha256_ssse3_pad(struct shash_desc *desc)
 {
 	struct sha256_state *sctx = shash_desc_ctx(desc);
-	unsigned int i, index, padlen;
-	__be32 *dst = (__be32 *)out;
+	unsigned int index, padlen;
 	__be64 bits;
 	static const u8 padding[SHA256_BLOCK_SIZE] = { 0x80, };
 
@@ -140,24 +139,23 @@ static int sha256_ssse3_final(struct shash_desc *desc, u8 *out)
 
 	/* Pad out to 56 mod 64 and append length */
 	index = sctx->count % SHA256_BLOCK_SIZE;
-	padlen = (index < 56) ? (56 - index) : ((SHA256_BLOCK_SIZE+56)-index);
+	padlen = (index < 56) ? (56 - index) : ((SHA256_BLOCK_SIZE+56) - index);
 
-	if (!irq_fpu_usable()) {
-		crypto_sha256_update(desc, padding, padlen);
-		crypto_sha256_update(desc, (const u8 *)&bits, sizeof(bits));
+	/* We need to fill a whole block for __sha256_ssse3_update() */
+	if (padlen <= 56) {
+		sctx->count += padlen;
+		memcpy(sctx->buf + index, padding, padlen);
 	} else {
-		kernel_fpu_begin();
-		/* We need to fill a whole block for __sha256_ssse3_update() */
-		if (padlen <= 56) {
-			sctx->count += padlen;
-			memcpy(sctx->buf + index, padding, padlen);
-		} else {
-			__sha256_ssse3_update(desc, padding, padlen, index);
-		}
-		__sha256_ssse3_update(desc, (const u8 *)&bits,
-					sizeof(bits), 56);
-		kernel_fpu_end();
+		__sha256_ssse3_update(desc, padding, padlen, index);
 	}
+	__sha256_ssse3_update(desc, (const u8 *)&bits, sizeof(bits), 56);
+}
+
+static void sha256_ssse3_store(struct shash_desc *desc, u8 *out)
+{
+	struct sha256_state *sctx = shash_desc_ctx(desc);
+	__be32 *dst = (__be32 *)out;
+	unsigned int i;
 
 	/* Store state in digest */
 	for (i = 0; i < 8; i++)
@@ -165,6 +163,61 @@ static int sha256_ssse3_final(struct shash_desc *desc, u8 *out)
 
 	/* Wipe context */
 	memset(sctx, 0, sizeof(*sctx));
+}
+
+/* Add padding and return the message digest. */
+static int sha256_ssse3_final(struct shash_desc *desc, u8 *out)
+{
+	struct sha256_state *sctx = shash_desc_ctx(desc);
+	unsigned int index, padlen;
+	__be64 bits;
+	static const u8 padding[SHA256_BLOCK_SIZE] = { 0x80, };
+
+	if (!irq_fpu_usable()) {
+		bits = cpu_to_be64(sctx->count << 3);
+		index = sctx->count % SHA256_BLOCK_SIZE;
+		padlen = (index < 56) ? (56 - index) :
+					((SHA256_BLOCK_SIZE+56) - index);
+		crypto_sha256_update(desc, padding, padlen);
+		crypto_sha256_update(desc, (const u8 *)&bits, sizeof(bits));
+	} else {
+		kernel_fpu_begin();
+		__sha256_ssse3_pad(desc);
+		kernel_fpu_end();
+	}
+
+	sha256_ssse3_store(desc, out);
+
+	return 0;
+}
+
+/*
+ * Hash the remaining data and pad it within a single FPU section, rather
+ * than paying for kernel_fpu_begin()/_end() in both update() and final().
+ * Callers that hash many small independent buffers (dm-verity, IPsec)
+ * mostly go through here.
+ */
+static int sha256_ssse3_finup(struct shash_desc *desc, const u8 *data,
+			     unsigned int len, u8 *out)
+{
+	struct sha256_state *sctx = shash_desc_ctx(desc);
+	unsigned int partial = sctx->count % SHA256_BLOCK_SIZE;
+
+	if (!irq_fpu_usable())
+		return sha256_ssse3_update(desc, data, len) ?:
+		       sha256_ssse3_final(desc, out);
+
+	kernel_fpu_begin();
+	if (partial + len < SHA256_BLOCK_SIZE) {
+		sctx->count += len;
+		memcpy(sctx->buf + partial, data, len);
+	} else {
+		__sha256_ssse3_update(desc, data, len, partial);
+	}
+	__sha256_ssse3_pad(desc);
+	kernel_fpu_end();
+
+	sha256_ssse3_store(desc, out);
 
 	return 0;
 }
@@ -221,6 +274,7 @@ static struct shash_alg algs[] = { {
 	.init		=	sha256_ssse3_init,
 	.update		=	sha256_ssse3_update,
 	.final		=	sha256_ssse3_final,
+	.finup		=	sha256_ssse3_finup,
 	.export		=	sha256_ssse3_export,
 	.import		=	sha256_ssse3_import,
 	.descsize	=	sizeof(struct sha256_state),
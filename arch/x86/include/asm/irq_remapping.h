@@ -31,6 +31,15 @@ struct msi_msg;
 struct pci_dev;
 struct irq_cfg;
 
+/*
+ * Where a remapped interrupt gets posted to instead of interrupting the
+ * host, see irq_remapping_set_vcpu_affinity().
+ */
+struct irq_remap_vcpu_info {
+	u64 pi_desc_addr;	/* physical address of the vcpu's descriptor */
+	u32 vector;		/* guest vector */
+};
+
 #ifdef CONFIG_IRQ_REMAP
 
 extern void setup_irq_remapping_ops(void);
@@ -55,6 +64,9 @@ extern void panic_if_irq_remap(const char *msg);
 extern bool setup_remapped_irq(int irq,
 			       struct irq_cfg *cfg,
 			       struct irq_chip *chip);
+extern bool irq_remapping_posting_supported(void);
+extern int irq_remapping_set_vcpu_affinity(int irq,
+					   struct irq_remap_vcpu_info *info);
 
 void irq_remap_modify_chip_defaults(struct irq_chip *chip);
 
@@ -101,6 +113,17 @@ static inline bool setup_remapped_irq(int irq,
 {
 	return false;
 }
+
+static inline bool irq_remapping_posting_supported(void)
+{
+	return false;
+}
+
+static inline int irq_remapping_set_vcpu_affinity(int irq,
+					struct irq_remap_vcpu_info *info)
+{
+	return -ENODEV;
+}
 #endif /* CONFIG_IRQ_REMAP */
 
 #define dmar_alloc_hwirq()	irq_alloc_hwirq(-1)
@@ -40,6 +40,12 @@
 
 #define KVM_MMIO_SIZE 16
 
+/* how long a halted vcpu may poll for a wakeup, at most */
+#define KVM_HALT_POLL_NS_DEFAULT 400000
+
+/* tdp faults install leaf sptes with mmu_lock held for read */
+#define KVM_HAVE_MMU_RWLOCK
+
 #define KVM_PIO_PAGE_OFFSET 1
 #define KVM_COALESCED_MMIO_PAGE_OFFSET 2
 
@@ -553,6 +559,8 @@ struct kvm_arch {
 	unsigned int n_requested_mmu_pages;
 	unsigned int n_max_mmu_pages;
 	unsigned int indirect_shadow_pages;
+	/* serializes rmap updates of faults holding mmu_lock for read */
+	spinlock_t mmu_rmap_lock;
 	unsigned long mmu_valid_gen;
 	struct hlist_head mmu_page_hash[KVM_NUM_MMU_PAGES];
 	/*
@@ -566,6 +574,7 @@ struct kvm_arch {
 	bool iommu_noncoherent;
 #define __KVM_HAVE_ARCH_NONCOHERENT_DMA
 	atomic_t noncoherent_dma_count;
+#define __KVM_HAVE_ARCH_POSTED_IRQ
 	struct kvm_pic *vpic;
 	struct kvm_ioapic *vioapic;
 	struct kvm_pit *vpit;
@@ -640,6 +649,8 @@ struct kvm_vcpu_stat {
 	u32 nmi_window_exits;
 	u32 halt_exits;
 	u32 halt_wakeup;
+	u32 halt_successful_poll;
+	u32 halt_attempted_poll;
 	u32 request_irq_exits;
 	u32 irq_exits;
 	u32 host_state_reload;
@@ -740,6 +751,12 @@ struct kvm_x86_ops {
 	void (*set_virtual_x2apic_mode)(struct kvm_vcpu *vcpu, bool set);
 	void (*deliver_posted_interrupt)(struct kvm_vcpu *vcpu, int vector);
 	void (*sync_pir_to_irr)(struct kvm_vcpu *vcpu);
+	/* let the IOMMU post host_irq straight to the vcpu guest_irq targets */
+	int (*update_pi_irte)(struct kvm *kvm, unsigned int host_irq,
+			      u32 guest_irq, bool set);
+	/* returns 1 if the vcpu must not block, a posted irq is pending */
+	int (*pre_block)(struct kvm_vcpu *vcpu);
+	void (*post_block)(struct kvm_vcpu *vcpu);
 	int (*set_tss_addr)(struct kvm *kvm, unsigned int addr);
 	int (*get_tdp_level)(void);
 	u64 (*get_mt_mask)(struct kvm_vcpu *vcpu, gfn_t gfn, bool is_mmio);
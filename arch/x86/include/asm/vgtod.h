@@ -31,6 +31,15 @@ struct vsyscall_gtod_data {
 	gtod_long_t	wall_time_coarse_nsec;
 	gtod_long_t	monotonic_time_coarse_sec;
 	gtod_long_t	monotonic_time_coarse_nsec;
+	gtod_long_t	boot_time_sec;
+	u64		boot_time_snsec;
+	gtod_long_t	tai_time_sec;
+
+	/* CLOCK_MONOTONIC_RAW: not NTP adjusted, so own mult/shift */
+	u32		raw_mult;
+	u32		raw_shift;
+	gtod_long_t	raw_time_sec;
+	u64		raw_time_snsec;
 
 	int		tz_minuteswest;
 	int		tz_dsttime;
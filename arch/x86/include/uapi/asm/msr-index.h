@@ -107,6 +107,24 @@
 
 #define MSR_IA32_POWER_CTL		0x000001fc
 
+#define MSR_IA32_RTIT_CTL		0x00000570
+#define RTIT_CTL_TRACEEN		(1UL << 0)
+#define RTIT_CTL_OS			(1UL << 2)
+#define RTIT_CTL_USR			(1UL << 3)
+#define RTIT_CTL_CR3EN			(1UL << 7)
+#define RTIT_CTL_TOPA			(1UL << 8)
+#define RTIT_CTL_TSC_EN			(1UL << 10)
+#define RTIT_CTL_DISRETC		(1UL << 11)
+#define RTIT_CTL_BRANCH_EN		(1UL << 13)
+#define MSR_IA32_RTIT_STATUS		0x00000571
+#define RTIT_STATUS_CONTEXTEN		(1UL << 1)
+#define RTIT_STATUS_TRIGGEREN		(1UL << 2)
+#define RTIT_STATUS_ERROR		(1UL << 4)
+#define RTIT_STATUS_STOPPED		(1UL << 5)
+#define MSR_IA32_RTIT_CR3_MATCH		0x00000572
+#define MSR_IA32_RTIT_OUTPUT_BASE	0x00000560
+#define MSR_IA32_RTIT_OUTPUT_MASK	0x00000561
+
 #define MSR_IA32_MC0_CTL		0x00000400
 #define MSR_IA32_MC0_STATUS		0x00000401
 #define MSR_IA32_MC0_ADDR		0x00000402
@@ -248,7 +248,27 @@ msr_fail:
 	return false;
 }
 
-static void hw_perf_event_destroy(struct perf_event *event)
+int x86_reserve_hardware(void)
+{
+	int err = 0;
+
+	if (!atomic_inc_not_zero(&active_events)) {
+		mutex_lock(&pmc_reserve_mutex);
+		if (atomic_read(&active_events) == 0) {
+			if (!reserve_pmc_hardware())
+				err = -EBUSY;
+			else
+				reserve_ds_buffers();
+		}
+		if (!err)
+			atomic_inc(&active_events);
+		mutex_unlock(&pmc_reserve_mutex);
+	}
+
+	return err;
+}
+
+void x86_release_hardware(void)
 {
 	if (atomic_dec_and_mutex_lock(&active_events, &pmc_reserve_mutex)) {
 		release_pmc_hardware();
@@ -257,6 +277,46 @@ static void hw_perf_event_destroy(struct perf_event *event)
 	}
 }
 
+/*
+ * BTS and Intel PT both own the branch tracing hardware, so only one of
+ * them can have events at any given time.
+ */
+static atomic_t x86_pmu_exclusive[x86_exclusive_max];
+
+int x86_add_exclusive(unsigned int what)
+{
+	int i, ret = -EBUSY;
+
+	if (atomic_inc_not_zero(&x86_pmu_exclusive[what]))
+		return 0;
+
+	mutex_lock(&pmc_reserve_mutex);
+	for (i = 0; i < ARRAY_SIZE(x86_pmu_exclusive); i++) {
+		if (i != what && atomic_read(&x86_pmu_exclusive[i]))
+			goto out;
+	}
+
+	atomic_inc(&x86_pmu_exclusive[what]);
+	ret = 0;
+
+out:
+	mutex_unlock(&pmc_reserve_mutex);
+	return ret;
+}
+
+void x86_del_exclusive(unsigned int what)
+{
+	atomic_dec(&x86_pmu_exclusive[what]);
+}
+
+static void hw_perf_event_destroy(struct perf_event *event)
+{
+	if (event->hw.flags & PERF_X86_EVENT_EXCL_BTS)
+		x86_del_exclusive(x86_exclusive_bts);
+
+	x86_release_hardware();
+}
+
 static inline int x86_pmu_initialized(void)
 {
 	return x86_pmu.handle_irq != NULL;
@@ -340,6 +400,12 @@ int x86_setup_perfctr(struct perf_event *event)
 		/* BTS is currently only allowed for user-mode. */
 		if (!attr->exclude_kernel)
 			return -EOPNOTSUPP;
+
+		/* BTS can't be used while Intel PT is tracing */
+		if (x86_add_exclusive(x86_exclusive_bts))
+			return -EBUSY;
+
+		hwc->flags |= PERF_X86_EVENT_EXCL_BTS;
 	}
 
 	hwc->config |= config;
@@ -456,19 +522,7 @@ static int __x86_pmu_event_init(struct perf_event *event)
 	if (!x86_pmu_initialized())
 		return -ENODEV;
 
-	err = 0;
-	if (!atomic_inc_not_zero(&active_events)) {
-		mutex_lock(&pmc_reserve_mutex);
-		if (atomic_read(&active_events) == 0) {
-			if (!reserve_pmc_hardware())
-				err = -EBUSY;
-			else
-				reserve_ds_buffers();
-		}
-		if (!err)
-			atomic_inc(&active_events);
-		mutex_unlock(&pmc_reserve_mutex);
-	}
+	err = x86_reserve_hardware();
 	if (err)
 		return err;
 
@@ -65,5 +65,24 @@ void update_vsyscall(struct timekeeper *tk)
 		vdata->monotonic_time_coarse_sec++;
 	}
 
+	vdata->boot_time_sec		= vdata->monotonic_time_sec
+					+ tk->total_sleep_time.tv_sec;
+	vdata->boot_time_snsec		= vdata->monotonic_time_snsec
+					+ ((u64)tk->total_sleep_time.tv_nsec
+						<< tk->shift);
+	while (vdata->boot_time_snsec >=
+					(((u64)NSEC_PER_SEC) << tk->shift)) {
+		vdata->boot_time_snsec -= ((u64)NSEC_PER_SEC) << tk->shift;
+		vdata->boot_time_sec++;
+	}
+
+	vdata->tai_time_sec		= tk->xtime_sec + tk->tai_offset;
+
+	vdata->raw_mult			= tk->clock->mult;
+	vdata->raw_shift		= tk->clock->shift;
+	vdata->raw_time_sec		= tk->raw_time.tv_sec;
+	vdata->raw_time_snsec		= (u64)tk->raw_time.tv_nsec
+						<< tk->clock->shift;
+
 	gtod_write_end(vdata);
 }
@@ -896,6 +896,15 @@ static bool mapping_level_dirty_bitmap(struct kvm_vcpu *vcpu, gfn_t large_gfn)
 	return !gfn_to_memslot_dirty_bitmap(vcpu, large_gfn, true);
 }
 
+static bool gfn_is_dirty_logged(struct kvm_vcpu *vcpu, gfn_t gfn)
+{
+	struct kvm_memory_slot *slot;
+
+	slot = gfn_to_memslot(vcpu->kvm, gfn);
+	return slot && !(slot->flags & KVM_MEMSLOT_INVALID) &&
+	       slot->dirty_bitmap;
+}
+
 static int mapping_level(struct kvm_vcpu *vcpu, gfn_t large_gfn)
 {
 	int host_level, level, max_level;
@@ -1864,6 +1873,21 @@ static void kvm_mmu_pages_init(struct kvm_mmu_page *parent,
 	pvec->nr = 0;
 }
 
+/*
+ * cond_resched_lock() for the write side of mmu_lock.  rwlocks don't
+ * track contention, so only break out if we should reschedule anyway.
+ */
+static bool mmu_lock_cond_resched(struct kvm *kvm)
+{
+	if (!need_resched())
+		return false;
+
+	write_unlock(&kvm->mmu_lock);
+	cond_resched();
+	write_lock(&kvm->mmu_lock);
+	return true;
+}
+
 static void mmu_sync_children(struct kvm_vcpu *vcpu,
 			      struct kvm_mmu_page *parent)
 {
@@ -1888,7 +1912,7 @@ static void mmu_sync_children(struct kvm_vcpu *vcpu,
 			mmu_pages_clear_parents(&parents);
 		}
 		kvm_mmu_commit_zap_page(vcpu->kvm, &invalid_list);
-		cond_resched_lock(&vcpu->kvm->mmu_lock);
+		mmu_lock_cond_resched(vcpu->kvm);
 		kvm_mmu_pages_init(parent, &parents, &pages);
 	}
 }
@@ -2235,7 +2259,7 @@ void kvm_mmu_change_mmu_pages(struct kvm *kvm, unsigned int goal_nr_mmu_pages)
 {
 	LIST_HEAD(invalid_list);
 
-	spin_lock(&kvm->mmu_lock);
+	write_lock(&kvm->mmu_lock);
 
 	if (kvm->arch.n_used_mmu_pages > goal_nr_mmu_pages) {
 		/* Need to free some mmu pages to achieve the goal. */
@@ -2249,7 +2273,7 @@ void kvm_mmu_change_mmu_pages(struct kvm *kvm, unsigned int goal_nr_mmu_pages)
 
 	kvm->arch.n_max_mmu_pages = goal_nr_mmu_pages;
 
-	spin_unlock(&kvm->mmu_lock);
+	write_unlock(&kvm->mmu_lock);
 }
 
 int kvm_mmu_unprotect_page(struct kvm *kvm, gfn_t gfn)
@@ -2260,7 +2284,7 @@ int kvm_mmu_unprotect_page(struct kvm *kvm, gfn_t gfn)
 
 	pgprintk("%s: looking for gfn %llx\n", __func__, gfn);
 	r = 0;
-	spin_lock(&kvm->mmu_lock);
+	write_lock(&kvm->mmu_lock);
 	for_each_gfn_indirect_valid_sp(kvm, sp, gfn) {
 		pgprintk("%s: gfn %llx role %x\n", __func__, gfn,
 			 sp->role.word);
@@ -2268,7 +2292,7 @@ int kvm_mmu_unprotect_page(struct kvm *kvm, gfn_t gfn)
 		kvm_mmu_prepare_zap_page(kvm, sp, &invalid_list);
 	}
 	kvm_mmu_commit_zap_page(kvm, &invalid_list);
-	spin_unlock(&kvm->mmu_lock);
+	write_unlock(&kvm->mmu_lock);
 
 	return r;
 }
@@ -2457,6 +2481,13 @@ static int set_spte(struct kvm_vcpu *vcpu, u64 *sptep,
 
 	spte |= (u64)pfn << PAGE_SHIFT;
 
+	/*
+	 * Large sptes of dirty logged memory are read-only, the first
+	 * write splits them.  See mmu_split_large_spte().
+	 */
+	if (level > PT_PAGE_TABLE_LEVEL && gfn_is_dirty_logged(vcpu, gfn))
+		pte_access &= ~ACC_WRITE_MASK;
+
 	if (pte_access & ACC_WRITE_MASK) {
 
 		/*
@@ -2641,6 +2672,54 @@ static void direct_pte_prefetch(struct kvm_vcpu *vcpu, u64 *sptep)
 	__direct_pte_prefetch(vcpu, sp, sptep);
 }
 
+/*
+ * Replace the read-only large spte of dirty logged memory at @sptep by a
+ * page table mapping the same memory with the next smaller page size.
+ * A write then only costs the large mapping of the part it touches, the
+ * rest of the region stays mapped and keeps its TLB reach.
+ */
+static void mmu_split_large_spte(struct kvm_vcpu *vcpu, u64 *sptep,
+				 int level, u64 addr)
+{
+	u64 large_spte = *sptep;
+	u64 child_spte, child_size;
+	struct kvm_mmu_page *sp;
+	gfn_t base_gfn;
+	int i;
+
+	base_gfn = (addr & PT64_LVL_ADDR_MASK(level)) >> PAGE_SHIFT;
+	__drop_large_spte(vcpu->kvm, sptep);
+	sp = kvm_mmu_get_page(vcpu, base_gfn, addr, level - 1, 1, ACC_ALL,
+			      sptep);
+
+	/* keep the host writable bits so that fast_page_fault() can work */
+	child_spte = large_spte & ~PT_WRITABLE_MASK;
+	if (level - 1 == PT_PAGE_TABLE_LEVEL)
+		child_spte &= ~PT_PAGE_SIZE_MASK;
+	child_size = KVM_PAGES_PER_HPAGE(level - 1);
+
+	for (i = 0; i < PT64_ENT_PER_PAGE; i++) {
+		u64 *child = sp->spt + i;
+
+		/* a reused page table may still map some of it */
+		if (is_shadow_present_pte(*child))
+			continue;
+
+		/* the rest gets mapped on demand */
+		if (!rmap_can_add(vcpu))
+			break;
+
+		mmu_spte_set(child, child_spte +
+			     ((i * child_size) << PAGE_SHIFT));
+		rmap_add(vcpu, child, base_gfn + i * child_size);
+		if (level - 1 > PT_PAGE_TABLE_LEVEL)
+			++vcpu->kvm->stat.lpages;
+	}
+
+	link_shadow_page(sptep, sp, true);
+	kvm_flush_remote_tlbs(vcpu->kvm);
+}
+
 static int __direct_map(struct kvm_vcpu *vcpu, gpa_t v, int write,
 			int map_writable, int level, gfn_t gfn, pfn_t pfn,
 			bool prefault)
@@ -2663,7 +2742,12 @@ static int __direct_map(struct kvm_vcpu *vcpu, gpa_t v, int write,
 			break;
 		}
 
-		drop_large_spte(vcpu, iterator.sptep);
+		if (is_large_pte(*iterator.sptep) &&
+		    gfn_is_dirty_logged(vcpu, gfn))
+			mmu_split_large_spte(vcpu, iterator.sptep,
+					     iterator.level, iterator.addr);
+		else
+			drop_large_spte(vcpu, iterator.sptep);
 		if (!is_shadow_present_pte(*iterator.sptep)) {
 			u64 base_addr = iterator.addr;
 
@@ -2935,7 +3019,7 @@ static int nonpaging_map(struct kvm_vcpu *vcpu, gva_t v, u32 error_code,
 	if (handle_abnormal_pfn(vcpu, v, gfn, pfn, ACC_ALL, &r))
 		return r;
 
-	spin_lock(&vcpu->kvm->mmu_lock);
+	write_lock(&vcpu->kvm->mmu_lock);
 	if (mmu_notifier_retry(vcpu->kvm, mmu_seq))
 		goto out_unlock;
 	make_mmu_pages_available(vcpu);
@@ -2943,13 +3027,13 @@ static int nonpaging_map(struct kvm_vcpu *vcpu, gva_t v, u32 error_code,
 		transparent_hugepage_adjust(vcpu, &gfn, &pfn, &level);
 	r = __direct_map(vcpu, v, write, map_writable, level, gfn, pfn,
 			 prefault);
-	spin_unlock(&vcpu->kvm->mmu_lock);
+	write_unlock(&vcpu->kvm->mmu_lock);
 
 
 	return r;
 
 out_unlock:
-	spin_unlock(&vcpu->kvm->mmu_lock);
+	write_unlock(&vcpu->kvm->mmu_lock);
 	kvm_release_pfn_clean(pfn);
 	return 0;
 }
@@ -2969,19 +3053,19 @@ static void mmu_free_roots(struct kvm_vcpu *vcpu)
 	     vcpu->arch.mmu.direct_map)) {
 		hpa_t root = vcpu->arch.mmu.root_hpa;
 
-		spin_lock(&vcpu->kvm->mmu_lock);
+		write_lock(&vcpu->kvm->mmu_lock);
 		sp = page_header(root);
 		--sp->root_count;
 		if (!sp->root_count && sp->role.invalid) {
 			kvm_mmu_prepare_zap_page(vcpu->kvm, sp, &invalid_list);
 			kvm_mmu_commit_zap_page(vcpu->kvm, &invalid_list);
 		}
-		spin_unlock(&vcpu->kvm->mmu_lock);
+		write_unlock(&vcpu->kvm->mmu_lock);
 		vcpu->arch.mmu.root_hpa = INVALID_PAGE;
 		return;
 	}
 
-	spin_lock(&vcpu->kvm->mmu_lock);
+	write_lock(&vcpu->kvm->mmu_lock);
 	for (i = 0; i < 4; ++i) {
 		hpa_t root = vcpu->arch.mmu.pae_root[i];
 
@@ -2996,7 +3080,7 @@ static void mmu_free_roots(struct kvm_vcpu *vcpu)
 		vcpu->arch.mmu.pae_root[i] = INVALID_PAGE;
 	}
 	kvm_mmu_commit_zap_page(vcpu->kvm, &invalid_list);
-	spin_unlock(&vcpu->kvm->mmu_lock);
+	write_unlock(&vcpu->kvm->mmu_lock);
 	vcpu->arch.mmu.root_hpa = INVALID_PAGE;
 }
 
@@ -3018,19 +3102,19 @@ static int mmu_alloc_direct_roots(struct kvm_vcpu *vcpu)
 	unsigned i;
 
 	if (vcpu->arch.mmu.shadow_root_level == PT64_ROOT_LEVEL) {
-		spin_lock(&vcpu->kvm->mmu_lock);
+		write_lock(&vcpu->kvm->mmu_lock);
 		make_mmu_pages_available(vcpu);
 		sp = kvm_mmu_get_page(vcpu, 0, 0, PT64_ROOT_LEVEL,
 				      1, ACC_ALL, NULL);
 		++sp->root_count;
-		spin_unlock(&vcpu->kvm->mmu_lock);
+		write_unlock(&vcpu->kvm->mmu_lock);
 		vcpu->arch.mmu.root_hpa = __pa(sp->spt);
 	} else if (vcpu->arch.mmu.shadow_root_level == PT32E_ROOT_LEVEL) {
 		for (i = 0; i < 4; ++i) {
 			hpa_t root = vcpu->arch.mmu.pae_root[i];
 
 			ASSERT(!VALID_PAGE(root));
-			spin_lock(&vcpu->kvm->mmu_lock);
+			write_lock(&vcpu->kvm->mmu_lock);
 			make_mmu_pages_available(vcpu);
 			sp = kvm_mmu_get_page(vcpu, i << (30 - PAGE_SHIFT),
 					      i << 30,
@@ -3038,7 +3122,7 @@ static int mmu_alloc_direct_roots(struct kvm_vcpu *vcpu)
 					      NULL);
 			root = __pa(sp->spt);
 			++sp->root_count;
-			spin_unlock(&vcpu->kvm->mmu_lock);
+			write_unlock(&vcpu->kvm->mmu_lock);
 			vcpu->arch.mmu.pae_root[i] = root | PT_PRESENT_MASK;
 		}
 		vcpu->arch.mmu.root_hpa = __pa(vcpu->arch.mmu.pae_root);
@@ -3069,13 +3153,13 @@ static int mmu_alloc_shadow_roots(struct kvm_vcpu *vcpu)
 
 		ASSERT(!VALID_PAGE(root));
 
-		spin_lock(&vcpu->kvm->mmu_lock);
+		write_lock(&vcpu->kvm->mmu_lock);
 		make_mmu_pages_available(vcpu);
 		sp = kvm_mmu_get_page(vcpu, root_gfn, 0, PT64_ROOT_LEVEL,
 				      0, ACC_ALL, NULL);
 		root = __pa(sp->spt);
 		++sp->root_count;
-		spin_unlock(&vcpu->kvm->mmu_lock);
+		write_unlock(&vcpu->kvm->mmu_lock);
 		vcpu->arch.mmu.root_hpa = root;
 		return 0;
 	}
@@ -3103,14 +3187,14 @@ static int mmu_alloc_shadow_roots(struct kvm_vcpu *vcpu)
 			if (mmu_check_root(vcpu, root_gfn))
 				return 1;
 		}
-		spin_lock(&vcpu->kvm->mmu_lock);
+		write_lock(&vcpu->kvm->mmu_lock);
 		make_mmu_pages_available(vcpu);
 		sp = kvm_mmu_get_page(vcpu, root_gfn, i << 30,
 				      PT32_ROOT_LEVEL, 0,
 				      ACC_ALL, NULL);
 		root = __pa(sp->spt);
 		++sp->root_count;
-		spin_unlock(&vcpu->kvm->mmu_lock);
+		write_unlock(&vcpu->kvm->mmu_lock);
 
 		vcpu->arch.mmu.pae_root[i] = root | pm_mask;
 	}
@@ -3186,9 +3270,9 @@ static void mmu_sync_roots(struct kvm_vcpu *vcpu)
 
 void kvm_mmu_sync_roots(struct kvm_vcpu *vcpu)
 {
-	spin_lock(&vcpu->kvm->mmu_lock);
+	write_lock(&vcpu->kvm->mmu_lock);
 	mmu_sync_roots(vcpu);
-	spin_unlock(&vcpu->kvm->mmu_lock);
+	write_unlock(&vcpu->kvm->mmu_lock);
 }
 EXPORT_SYMBOL_GPL(kvm_mmu_sync_roots);
 
@@ -3249,6 +3333,30 @@ static u64 walk_shadow_page_get_mmio_spte(struct kvm_vcpu *vcpu, u64 addr)
 	return spte;
 }
 
+/*
+ * Level of the first non-present or large spte on the walk for @addr,
+ * i.e. the largest mapping that doesn't replace existing page tables.
+ */
+static int walk_shadow_page_get_level(struct kvm_vcpu *vcpu, u64 addr)
+{
+	struct kvm_shadow_walk_iterator iterator;
+	int level = PT_PAGE_TABLE_LEVEL;
+	u64 spte;
+
+	if (!VALID_PAGE(vcpu->arch.mmu.root_hpa))
+		return level;
+
+	walk_shadow_page_lockless_begin(vcpu);
+	for_each_shadow_entry_lockless(vcpu, addr, iterator, spte) {
+		level = iterator.level;
+		if (!is_shadow_present_pte(spte) || is_large_pte(spte))
+			break;
+	}
+	walk_shadow_page_lockless_end(vcpu);
+
+	return level;
+}
+
 int handle_mmio_page_fault_common(struct kvm_vcpu *vcpu, u64 addr, bool direct)
 {
 	u64 spte;
@@ -3372,12 +3480,89 @@ static bool try_async_pf(struct kvm_vcpu *vcpu, bool prefault, gfn_t gfn,
 	return false;
 }
 
+/*
+ * Map a 4K page whose page table is already there with mmu_lock held
+ * for read, so that vcpus faulting in guest memory don't serialize on
+ * each other.  Everything that creates or zaps shadow pages, or walks
+ * and changes rmaps, holds mmu_lock for write; faults racing here for
+ * the same spte are sorted out by cmpxchg64, and rmap_add() of
+ * different sptes by kvm->arch.mmu_rmap_lock.
+ *
+ * Write protection of a gfn only matters with indirect shadow pages
+ * around, so with those this is left to the exclusive path.  Returns
+ * false if the fault still has to go there.
+ */
+static bool tdp_map_shared(struct kvm_vcpu *vcpu, gfn_t gfn, pfn_t pfn,
+			   bool prefault, bool map_writable,
+			   unsigned long mmu_seq)
+{
+	struct kvm_shadow_walk_iterator iterator;
+	struct kvm *kvm = vcpu->kvm;
+	u64 *sptep = NULL;
+	u64 spte;
+	bool ret = false;
+
+	if (is_error_noslot_pfn(pfn) || kvm_is_mmio_pfn(pfn) ||
+	    PageTransCompound(pfn_to_page(pfn)))
+		return false;
+
+	read_lock(&kvm->mmu_lock);
+	if (mmu_notifier_retry(kvm, mmu_seq) ||
+	    kvm->arch.indirect_shadow_pages ||
+	    !VALID_PAGE(vcpu->arch.mmu.root_hpa))
+		goto out_unlock;
+
+	for_each_shadow_entry(vcpu, (u64)gfn << PAGE_SHIFT, iterator) {
+		if (iterator.level == PT_PAGE_TABLE_LEVEL) {
+			sptep = iterator.sptep;
+			break;
+		}
+
+		if (!is_shadow_present_pte(*iterator.sptep) ||
+		    is_large_pte(*iterator.sptep))
+			goto out_unlock;
+	}
+
+	/* present, mmio or zapped sptes take the exclusive path */
+	if (!sptep || mmu_spte_get_lockless(sptep))
+		goto out_unlock;
+
+	spte = PT_PRESENT_MASK | shadow_x_mask | shadow_user_mask;
+	if (!prefault)
+		spte |= shadow_accessed_mask;
+	spte |= kvm_x86_ops->get_mt_mask(vcpu, gfn, false);
+	spte |= (u64)pfn << PAGE_SHIFT;
+	if (map_writable)
+		spte |= SPTE_HOST_WRITEABLE | PT_WRITABLE_MASK |
+			SPTE_MMU_WRITEABLE;
+
+	/* another vcpu beat us to it, the guest just retries the access */
+	ret = true;
+	if (cmpxchg64(sptep, 0ull, spte) != 0ull)
+		goto out_unlock;
+
+	if (map_writable)
+		mark_page_dirty(kvm, gfn);
+
+	spin_lock(&kvm->arch.mmu_rmap_lock);
+	rmap_add(vcpu, sptep, gfn);
+	spin_unlock(&kvm->arch.mmu_rmap_lock);
+
+	++vcpu->stat.pf_fixed;
+
+out_unlock:
+	read_unlock(&kvm->mmu_lock);
+	if (ret)
+		kvm_release_pfn_clean(pfn);
+	return ret;
+}
+
 static int tdp_page_fault(struct kvm_vcpu *vcpu, gva_t gpa, u32 error_code,
 			  bool prefault)
 {
 	pfn_t pfn;
 	int r;
-	int level;
+	int level, max_level = PT_PDPE_LEVEL;
 	int force_pt_level;
 	gfn_t gfn = gpa >> PAGE_SHIFT;
 	unsigned long mmu_seq;
@@ -3398,9 +3583,18 @@ static int tdp_page_fault(struct kvm_vcpu *vcpu, gva_t gpa, u32 error_code,
 	if (r)
 		return r;
 
+	/*
+	 * Reads of dirty logged memory can still be mapped large, unless a
+	 * write has already split the region.  Such sptes stay read-only
+	 * and get split by the first write.
+	 */
 	force_pt_level = mapping_level_dirty_bitmap(vcpu, gfn);
+	if (force_pt_level && !write && gfn_is_dirty_logged(vcpu, gfn)) {
+		max_level = walk_shadow_page_get_level(vcpu, gpa);
+		force_pt_level = max_level == PT_PAGE_TABLE_LEVEL;
+	}
 	if (likely(!force_pt_level)) {
-		level = mapping_level(vcpu, gfn);
+		level = min(mapping_level(vcpu, gfn), max_level);
 		gfn &= ~(KVM_PAGES_PER_HPAGE(level) - 1);
 	} else
 		level = PT_PAGE_TABLE_LEVEL;
@@ -3417,7 +3611,11 @@ static int tdp_page_fault(struct kvm_vcpu *vcpu, gva_t gpa, u32 error_code,
 	if (handle_abnormal_pfn(vcpu, 0, gfn, pfn, ACC_ALL, &r))
 		return r;
 
-	spin_lock(&vcpu->kvm->mmu_lock);
+	if (level == PT_PAGE_TABLE_LEVEL &&
+	    tdp_map_shared(vcpu, gfn, pfn, prefault, map_writable, mmu_seq))
+		return 0;
+
+	write_lock(&vcpu->kvm->mmu_lock);
 	if (mmu_notifier_retry(vcpu->kvm, mmu_seq))
 		goto out_unlock;
 	make_mmu_pages_available(vcpu);
@@ -3425,12 +3623,12 @@ static int tdp_page_fault(struct kvm_vcpu *vcpu, gva_t gpa, u32 error_code,
 		transparent_hugepage_adjust(vcpu, &gfn, &pfn, &level);
 	r = __direct_map(vcpu, gpa, write, map_writable,
 			 level, gfn, pfn, prefault);
-	spin_unlock(&vcpu->kvm->mmu_lock);
+	write_unlock(&vcpu->kvm->mmu_lock);
 
 	return r;
 
 out_unlock:
-	spin_unlock(&vcpu->kvm->mmu_lock);
+	write_unlock(&vcpu->kvm->mmu_lock);
 	kvm_release_pfn_clean(pfn);
 	return 0;
 }
@@ -4107,7 +4305,7 @@ void kvm_mmu_pte_write(struct kvm_vcpu *vcpu, gpa_t gpa,
 	 */
 	mmu_topup_memory_caches(vcpu);
 
-	spin_lock(&vcpu->kvm->mmu_lock);
+	write_lock(&vcpu->kvm->mmu_lock);
 	++vcpu->kvm->stat.mmu_pte_write;
 	kvm_mmu_audit(vcpu, AUDIT_PRE_PTE_WRITE);
 
@@ -4141,7 +4339,7 @@ void kvm_mmu_pte_write(struct kvm_vcpu *vcpu, gpa_t gpa,
 	mmu_pte_write_flush_tlb(vcpu, zap_page, remote_flush, local_flush);
 	kvm_mmu_commit_zap_page(vcpu->kvm, &invalid_list);
 	kvm_mmu_audit(vcpu, AUDIT_POST_PTE_WRITE);
-	spin_unlock(&vcpu->kvm->mmu_lock);
+	write_unlock(&vcpu->kvm->mmu_lock);
 }
 
 int kvm_mmu_unprotect_page_virt(struct kvm_vcpu *vcpu, gva_t gva)
@@ -4299,7 +4497,7 @@ void kvm_mmu_slot_remove_write_access(struct kvm *kvm, int slot)
 	memslot = id_to_memslot(kvm->memslots, slot);
 	last_gfn = memslot->base_gfn + memslot->npages - 1;
 
-	spin_lock(&kvm->mmu_lock);
+	write_lock(&kvm->mmu_lock);
 
 	for (i = PT_PAGE_TABLE_LEVEL;
 	     i < PT_PAGE_TABLE_LEVEL + KVM_NR_PAGE_SIZES; ++i) {
@@ -4313,12 +4511,11 @@ void kvm_mmu_slot_remove_write_access(struct kvm *kvm, int slot)
 			if (*rmapp)
 				__rmap_write_protect(kvm, rmapp, false);
 
-			if (need_resched() || spin_needbreak(&kvm->mmu_lock))
-				cond_resched_lock(&kvm->mmu_lock);
+			mmu_lock_cond_resched(kvm);
 		}
 	}
 
-	spin_unlock(&kvm->mmu_lock);
+	write_unlock(&kvm->mmu_lock);
 
 	/*
 	 * kvm_mmu_slot_remove_write_access() and kvm_vm_ioctl_get_dirty_log()
@@ -4372,7 +4569,7 @@ restart:
 		 * generation number.
 		 */
 		if (batch >= BATCH_ZAP_PAGES &&
-		      cond_resched_lock(&kvm->mmu_lock)) {
+		      mmu_lock_cond_resched(kvm)) {
 			batch = 0;
 			goto restart;
 		}
@@ -4403,7 +4600,7 @@ restart:
  */
 void kvm_mmu_invalidate_zap_all_pages(struct kvm *kvm)
 {
-	spin_lock(&kvm->mmu_lock);
+	write_lock(&kvm->mmu_lock);
 	trace_kvm_mmu_invalidate_zap_all_pages(kvm);
 	kvm->arch.mmu_valid_gen++;
 
@@ -4419,7 +4616,7 @@ void kvm_mmu_invalidate_zap_all_pages(struct kvm *kvm)
 	kvm_reload_remote_mmus(kvm);
 
 	kvm_zap_obsolete_pages(kvm);
-	spin_unlock(&kvm->mmu_lock);
+	write_unlock(&kvm->mmu_lock);
 }
 
 static bool kvm_has_zapped_obsolete_pages(struct kvm *kvm)
@@ -4471,7 +4668,7 @@ mmu_shrink_scan(struct shrinker *shrink, struct shrink_control *sc)
 			continue;
 
 		idx = srcu_read_lock(&kvm->srcu);
-		spin_lock(&kvm->mmu_lock);
+		write_lock(&kvm->mmu_lock);
 
 		if (kvm_has_zapped_obsolete_pages(kvm)) {
 			kvm_mmu_commit_zap_page(kvm,
@@ -4484,7 +4681,7 @@ mmu_shrink_scan(struct shrinker *shrink, struct shrink_control *sc)
 		kvm_mmu_commit_zap_page(kvm, &invalid_list);
 
 unlock:
-		spin_unlock(&kvm->mmu_lock);
+		write_unlock(&kvm->mmu_lock);
 		srcu_read_unlock(&kvm->srcu, idx);
 
 		/*
@@ -45,6 +45,8 @@
 #include <asm/perf_event.h>
 #include <asm/debugreg.h>
 #include <asm/kexec.h>
+#include <asm/apic.h>
+#include <asm/irq_remapping.h>
 
 #include "trace.h"
 
@@ -386,11 +388,23 @@ struct nested_vmx {
 };
 
 #define POSTED_INTR_ON  0
+#define POSTED_INTR_SN  1
+
 /* Posted-Interrupt Descriptor */
 struct pi_desc {
 	u32 pir[8];     /* Posted interrupt requested */
-	u32 control;	/* bit 0 of control is outstanding notification bit */
-	u32 rsvd[7];
+	union {
+		struct {
+			u16	on	: 1,	/* outstanding notification */
+				sn	: 1,	/* suppress notification */
+				rsvd_1	: 14;
+			u8	nv;		/* notification vector */
+			u8	rsvd_2;
+			u32	ndst;		/* notification destination */
+		};
+		u64 control;
+	};
+	u32 rsvd[6];
 } __aligned(64);
 
 static bool pi_test_and_set_on(struct pi_desc *pi_desc)
@@ -405,6 +419,16 @@ static bool pi_test_and_clear_on(struct pi_desc *pi_desc)
 			(unsigned long *)&pi_desc->control);
 }
 
+static bool pi_test_on(struct pi_desc *pi_desc)
+{
+	return test_bit(POSTED_INTR_ON, (unsigned long *)&pi_desc->control);
+}
+
+static void pi_set_sn(struct pi_desc *pi_desc)
+{
+	set_bit(POSTED_INTR_SN, (unsigned long *)&pi_desc->control);
+}
+
 static int pi_test_and_set_pir(int vector, struct pi_desc *pi_desc)
 {
 	return test_and_set_bit(vector, (unsigned long *)pi_desc->pir);
@@ -479,6 +503,10 @@ struct vcpu_vmx {
 	/* Posted interrupt descriptor */
 	struct pi_desc pi_desc;
 
+	/* on the wakeup list of pi_blocked_cpu while halted */
+	struct list_head pi_blocked_list;
+	int pi_blocked_cpu;
+
 	/* Support for a guest hypervisor (nested VMX) */
 	struct nested_vmx nested;
 };
@@ -738,6 +766,7 @@ static void vmx_get_segment(struct kvm_vcpu *vcpu,
 static bool guest_state_valid(struct kvm_vcpu *vcpu);
 static u32 vmx_segment_access_rights(struct kvm_segment *var);
 static void vmx_sync_pir_to_irr_dummy(struct kvm_vcpu *vcpu);
+static void pi_wakeup_handler(void);
 static void copy_vmcs12_to_shadow(struct vcpu_vmx *vmx);
 static void copy_shadow_to_vmcs12(struct vcpu_vmx *vmx);
 static bool vmx_mpx_supported(void);
@@ -751,6 +780,16 @@ static DEFINE_PER_CPU(struct vmcs *, current_vmcs);
 static DEFINE_PER_CPU(struct list_head, loaded_vmcss_on_cpu);
 static DEFINE_PER_CPU(struct desc_ptr, host_gdt);
 
+/*
+ * Halted vcpus that device interrupts get posted to, by the cpu their
+ * wakeup notification is sent to.
+ */
+static DEFINE_PER_CPU(struct list_head, pi_blocked_vcpus);
+static DEFINE_PER_CPU(spinlock_t, pi_blocked_vcpus_lock);
+
+/* the IOMMU can post device interrupts to vcpus */
+static bool __read_mostly enable_device_pi;
+
 static unsigned long *vmx_io_bitmap_a;
 static unsigned long *vmx_io_bitmap_b;
 static unsigned long *vmx_msr_bitmap_legacy;
@@ -1786,6 +1825,55 @@ static void vmx_load_host_state(struct vcpu_vmx *vmx)
 	preempt_enable();
 }
 
+static bool vmx_vcpu_uses_device_pi(struct kvm_vcpu *vcpu)
+{
+	return enable_device_pi && vcpu->kvm->arch.iommu_domain &&
+	       irqchip_in_kernel(vcpu->kvm);
+}
+
+static u32 pi_ndst(int cpu)
+{
+	u32 dest = cpu_physical_id(cpu);
+
+	return x2apic_enabled() ? dest : (dest << 8) & 0xff00;
+}
+
+/*
+ * Device interrupts posted by the IOMMU notify the cpu the vcpu runs
+ * on, a halted vcpu gets woken from the one it blocked on instead.
+ */
+static void vmx_vcpu_pi_load(struct kvm_vcpu *vcpu, int cpu)
+{
+	struct pi_desc *pi_desc = &to_vmx(vcpu)->pi_desc;
+	struct pi_desc old, new;
+
+	if (!vmx_vcpu_uses_device_pi(vcpu))
+		return;
+
+	do {
+		old.control = new.control = pi_desc->control;
+		/* vmx_post_block() restores the destination of a woken vcpu */
+		if (old.nv != POSTED_INTR_WAKEUP_VECTOR)
+			new.ndst = pi_ndst(cpu);
+		new.sn = 0;
+	} while (cmpxchg(&pi_desc->control, old.control,
+			 new.control) != old.control);
+}
+
+static void vmx_vcpu_pi_put(struct kvm_vcpu *vcpu)
+{
+	if (!vmx_vcpu_uses_device_pi(vcpu))
+		return;
+
+	/*
+	 * A preempted vcpu picks up what got posted when it runs again,
+	 * no need to notify anyone.  One going to sleep in kvm_vcpu_block()
+	 * still wants its wakeup.
+	 */
+	if (vcpu->preempted)
+		pi_set_sn(&to_vmx(vcpu)->pi_desc);
+}
+
 /*
  * Switches to specified vcpu, until a matching vcpu_put(), but assumes
  * vcpu mutex is already taken.
@@ -1836,10 +1924,14 @@ static void vmx_vcpu_load(struct kvm_vcpu *vcpu, int cpu)
 		vmcs_writel(HOST_IA32_SYSENTER_ESP, sysenter_esp); /* 22.2.3 */
 		vmx->loaded_vmcs->cpu = cpu;
 	}
+
+	vmx_vcpu_pi_load(vcpu, cpu);
 }
 
 static void vmx_vcpu_put(struct kvm_vcpu *vcpu)
 {
+	vmx_vcpu_pi_put(vcpu);
+
 	__vmx_load_host_state(to_vmx(vcpu));
 	if (!vmm_exclusive) {
 		__loaded_vmcs_clear(to_vmx(vcpu)->loaded_vmcs);
@@ -3113,6 +3205,15 @@ static __init int hardware_setup(void)
 		kvm_x86_ops->sync_pir_to_irr = vmx_sync_pir_to_irr_dummy;
 	}
 
+	enable_device_pi = enable_apicv && irq_remapping_posting_supported();
+	if (enable_device_pi)
+		kvm_set_posted_intr_wakeup_handler(pi_wakeup_handler);
+	else {
+		kvm_x86_ops->update_pi_irte = NULL;
+		kvm_x86_ops->pre_block = NULL;
+		kvm_x86_ops->post_block = NULL;
+	}
+
 	if (nested)
 		nested_vmx_setup_ctls_msrs();
 
@@ -3121,6 +3222,8 @@ static __init int hardware_setup(void)
 
 static __exit void hardware_unsetup(void)
 {
+	if (enable_device_pi)
+		kvm_set_posted_intr_wakeup_handler(NULL);
 	free_kvm_area();
 }
 
@@ -4207,6 +4310,133 @@ static void vmx_sync_pir_to_irr_dummy(struct kvm_vcpu *vcpu)
 	return;
 }
 
+/* POSTED_INTR_WAKEUP_VECTOR: kick the vcpus halted here with irqs posted */
+static void pi_wakeup_handler(void)
+{
+	int cpu = smp_processor_id();
+	struct vcpu_vmx *vmx;
+
+	spin_lock(&per_cpu(pi_blocked_vcpus_lock, cpu));
+	list_for_each_entry(vmx, &per_cpu(pi_blocked_vcpus, cpu),
+			    pi_blocked_list)
+		if (pi_test_on(&vmx->pi_desc))
+			kvm_vcpu_kick(&vmx->vcpu);
+	spin_unlock(&per_cpu(pi_blocked_vcpus_lock, cpu));
+}
+
+static void pi_blocked_del(struct vcpu_vmx *vmx)
+{
+	int cpu = vmx->pi_blocked_cpu;
+	unsigned long flags;
+
+	spin_lock_irqsave(&per_cpu(pi_blocked_vcpus_lock, cpu), flags);
+	list_del(&vmx->pi_blocked_list);
+	spin_unlock_irqrestore(&per_cpu(pi_blocked_vcpus_lock, cpu), flags);
+	vmx->pi_blocked_cpu = -1;
+}
+
+/*
+ * Before a vcpu halts, have posted device interrupts send the wakeup
+ * vector to this cpu rather than the notification vector meant for a
+ * running guest.  Returns 1 if something was posted already.
+ */
+static int vmx_pre_block(struct kvm_vcpu *vcpu)
+{
+	struct vcpu_vmx *vmx = to_vmx(vcpu);
+	struct pi_desc *pi_desc = &vmx->pi_desc;
+	struct pi_desc old, new;
+	unsigned long flags;
+	int cpu;
+
+	if (!vmx_vcpu_uses_device_pi(vcpu))
+		return 0;
+
+	cpu = get_cpu();
+	vmx->pi_blocked_cpu = cpu;
+	spin_lock_irqsave(&per_cpu(pi_blocked_vcpus_lock, cpu), flags);
+	list_add_tail(&vmx->pi_blocked_list, &per_cpu(pi_blocked_vcpus, cpu));
+	spin_unlock_irqrestore(&per_cpu(pi_blocked_vcpus_lock, cpu), flags);
+	put_cpu();
+
+	do {
+		old.control = new.control = pi_desc->control;
+
+		if (old.on) {
+			pi_blocked_del(vmx);
+			return 1;
+		}
+
+		new.ndst = pi_ndst(cpu);
+		new.nv = POSTED_INTR_WAKEUP_VECTOR;
+	} while (cmpxchg(&pi_desc->control, old.control,
+			 new.control) != old.control);
+
+	return 0;
+}
+
+static void vmx_post_block(struct kvm_vcpu *vcpu)
+{
+	struct vcpu_vmx *vmx = to_vmx(vcpu);
+	struct pi_desc *pi_desc = &vmx->pi_desc;
+	struct pi_desc old, new;
+	int cpu;
+
+	/* not blocked, or vmx_pre_block() found an irq posted already */
+	if (vmx->pi_blocked_cpu < 0)
+		return;
+
+	cpu = get_cpu();
+	do {
+		old.control = new.control = pi_desc->control;
+		new.ndst = pi_ndst(cpu);
+		new.nv = POSTED_INTR_VECTOR;
+		new.sn = 0;
+	} while (cmpxchg(&pi_desc->control, old.control,
+			 new.control) != old.control);
+	put_cpu();
+
+	pi_blocked_del(vmx);
+}
+
+/*
+ * Post host_irq to the vcpu its guest MSI route targets if that is a
+ * single one, or give it back to the host.
+ */
+static int vmx_update_pi_irte(struct kvm *kvm, unsigned int host_irq,
+			      u32 guest_irq, bool set)
+{
+	struct kvm_kernel_irq_routing_entry *e;
+	struct kvm_irq_routing_table *irq_rt;
+	struct irq_remap_vcpu_info vcpu_info;
+	struct kvm_lapic_irq irq;
+	struct kvm_vcpu *vcpu = NULL;
+	int idx;
+
+	if (!vmx_vm_has_apicv(kvm))
+		return 0;
+
+	idx = srcu_read_lock(&kvm->irq_srcu);
+	irq_rt = srcu_dereference(kvm->irq_routing, &kvm->irq_srcu);
+	if (set && guest_irq < irq_rt->nr_rt_entries) {
+		hlist_for_each_entry(e, &irq_rt->map[guest_irq], link) {
+			if (e->type != KVM_IRQ_ROUTING_MSI)
+				continue;
+
+			kvm_set_msi_irq(e, &irq);
+			vcpu = kvm_intr_single_vcpu(kvm, &irq);
+			break;
+		}
+	}
+	srcu_read_unlock(&kvm->irq_srcu, idx);
+
+	if (!vcpu)
+		return irq_remapping_set_vcpu_affinity(host_irq, NULL);
+
+	vcpu_info.pi_desc_addr = __pa(&to_vmx(vcpu)->pi_desc);
+	vcpu_info.vector = irq.vector;
+	return irq_remapping_set_vcpu_affinity(host_irq, &vcpu_info);
+}
+
 /*
  * Set up the vmcs's constant host-state fields, i.e., host-state fields that
  * will not change in the lifetime of the guest.
@@ -4524,8 +4754,11 @@ static void vmx_vcpu_reset(struct kvm_vcpu *vcpu)
 		vmcs_write64(APIC_ACCESS_ADDR,
 			     page_to_phys(vmx->vcpu.kvm->arch.apic_access_page));
 
-	if (vmx_vm_has_apicv(vcpu->kvm))
-		memset(&vmx->pi_desc, 0, sizeof(struct pi_desc));
+	if (vmx_vm_has_apicv(vcpu->kvm)) {
+		/* the notification setup belongs to vcpu load and halt */
+		memset(vmx->pi_desc.pir, 0, sizeof(vmx->pi_desc.pir));
+		pi_test_and_clear_on(&vmx->pi_desc);
+	}
 
 	if (vmx->vpid != 0)
 		vmcs_write16(VIRTUAL_PROCESSOR_ID, vmx->vpid);
@@ -7352,6 +7585,15 @@ static void __noclone vmx_vcpu_run(struct kvm_vcpu *vcpu)
 		vmx->nested.sync_shadow_vmcs = false;
 	}
 
+	/*
+	 * The notification for a device irq posted while we were in root
+	 * mode went to the host.  Resend it to ourselves, with interrupts
+	 * off it stays pending until the guest runs and gets processed as
+	 * a posted-interrupt notification there.
+	 */
+	if (vmx_vcpu_uses_device_pi(vcpu) && pi_test_on(&vmx->pi_desc))
+		apic->send_IPI_self(POSTED_INTR_VECTOR);
+
 	if (test_bit(VCPU_REGS_RSP, (unsigned long *)&vcpu->arch.regs_dirty))
 		vmcs_writel(GUEST_RSP, vcpu->arch.regs[VCPU_REGS_RSP]);
 	if (test_bit(VCPU_REGS_RIP, (unsigned long *)&vcpu->arch.regs_dirty))
@@ -7543,6 +7785,12 @@ static struct kvm_vcpu *vmx_create_vcpu(struct kvm *kvm, unsigned int id)
 
 	allocate_vpid(vmx);
 
+	/* notifications are suppressed until the vcpu is loaded */
+	vmx->pi_desc.nv = POSTED_INTR_VECTOR;
+	vmx->pi_desc.sn = 1;
+	INIT_LIST_HEAD(&vmx->pi_blocked_list);
+	vmx->pi_blocked_cpu = -1;
+
 	err = kvm_vcpu_init(&vmx->vcpu, kvm, id);
 	if (err)
 		goto free_vcpu;
@@ -8850,6 +9098,9 @@ static struct kvm_x86_ops vmx_x86_ops = {
 	.hwapic_isr_update = vmx_hwapic_isr_update,
 	.sync_pir_to_irr = vmx_sync_pir_to_irr,
 	.deliver_posted_interrupt = vmx_deliver_posted_interrupt,
+	.update_pi_irte = vmx_update_pi_irte,
+	.pre_block = vmx_pre_block,
+	.post_block = vmx_post_block,
 
 	.set_tss_addr = vmx_set_tss_addr,
 	.get_tdp_level = get_ept_level,
@@ -8893,6 +9144,11 @@ static int __init vmx_init(void)
 	for (i = 0; i < NR_VMX_MSR; ++i)
 		kvm_define_shared_msr(i, vmx_msr_index[i]);
 
+	for_each_possible_cpu(i) {
+		INIT_LIST_HEAD(&per_cpu(pi_blocked_vcpus, i));
+		spin_lock_init(&per_cpu(pi_blocked_vcpus_lock, i));
+	}
+
 	vmx_io_bitmap_a = (unsigned long *)__get_free_page(GFP_KERNEL);
 	if (!vmx_io_bitmap_a)
 		return -ENOMEM;
@@ -74,6 +74,7 @@
 #define MADV_SEQUENTIAL	2		/* expect sequential page references */
 #define MADV_WILLNEED	3		/* will need these pages */
 #define MADV_DONTNEED	4		/* don't need these pages */
+#define MADV_FREE	8		/* free pages only if memory pressure */
 
 /* common parameters: try to keep these consistent across architectures */
 #define MADV_REMOVE	9		/* remove these pages & resources */
@@ -90,6 +91,10 @@
 					   overrides the coredump filter bits */
 #define MADV_DODUMP	17		/* Clear the MADV_NODUMP flag */
 
+#define MADV_FAULTAROUND 18		/* Map anon pages ahead of sequential
+					   first touch */
+#define MADV_NOFAULTAROUND 19		/* Clear the MADV_FAULTAROUND flag */
+
 /* compatibility flags */
 #define MAP_FILE	0
 
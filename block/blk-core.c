@@ -32,6 +32,7 @@
 #include <linux/delay.h>
 #include <linux/ratelimit.h>
 #include <linux/pm_runtime.h>
+#include <linux/ktime.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/block.h>
@@ -39,6 +40,8 @@
 #include "blk.h"
 #include "blk-cgroup.h"
 #include "blk-mq.h"
+#include "blk-wbt.h"
+#include "blk-iolatency.h"
 
 EXPORT_TRACEPOINT_SYMBOL_GPL(block_bio_remap);
 EXPORT_TRACEPOINT_SYMBOL_GPL(block_rq_remap);
@@ -370,7 +373,7 @@ static void __blk_drain_queue(struct request_queue *q, bool drain_all)
 		 * The caller might be trying to drain @q before its
 		 * elevator is initialized.
 		 */
-		if (q->elevator)
+		if (q->elevator && !q->mq_ops)
 			elv_drain_elevator(q);
 
 		blkcg_drain_queue(q);
@@ -581,6 +584,10 @@ struct request_queue *blk_alloc_queue_node(gfp_t gfp_mask, int node_id)
 	if (q->id < 0)
 		goto fail_q;
 
+	q->lat_hist = alloc_percpu(struct blk_lat_hist);
+	if (!q->lat_hist)
+		goto fail_id;
+
 	q->backing_dev_info.ra_pages =
 			(VM_MAX_READAHEAD * 1024) / PAGE_CACHE_SIZE;
 	q->backing_dev_info.state = 0;
@@ -590,7 +597,7 @@ struct request_queue *blk_alloc_queue_node(gfp_t gfp_mask, int node_id)
 
 	err = bdi_init(&q->backing_dev_info);
 	if (err)
-		goto fail_id;
+		goto fail_hist;
 
 	setup_timer(&q->backing_dev_info.laptop_mode_wb_timer,
 		    laptop_mode_timer_fn, (unsigned long) q);
@@ -626,6 +633,8 @@ struct request_queue *blk_alloc_queue_node(gfp_t gfp_mask, int node_id)
 	q->bypass_depth = 1;
 	__set_bit(QUEUE_FLAG_BYPASS, &q->queue_flags);
 
+	q->poll_nsec = -1;
+
 	init_waitqueue_head(&q->mq_freeze_wq);
 
 	if (blkcg_init_queue(q))
@@ -635,6 +644,8 @@ struct request_queue *blk_alloc_queue_node(gfp_t gfp_mask, int node_id)
 
 fail_bdi:
 	bdi_destroy(&q->backing_dev_info);
+fail_hist:
+	free_percpu(q->lat_hist);
 fail_id:
 	ida_simple_remove(&blk_queue_ida, q->id);
 fail_q:
@@ -1353,6 +1364,9 @@ void __blk_put_request(struct request_queue *q, struct request *req)
 
 	blk_pm_put_request(req);
 
+	wbt_done(q, req);
+	blk_iolatency_done(req);
+
 	elv_completed_request(q, req);
 
 	/* this is a bio leak */
@@ -1551,6 +1565,8 @@ void blk_queue_bio(struct request_queue *q, struct bio *bio)
 	int el_ret, rw_flags, where = ELEVATOR_INSERT_SORT;
 	struct request *req;
 	unsigned int request_count = 0;
+	struct blkcg_gq *iolat_blkg;
+	bool wb_acct;
 
 	/*
 	 * low level driver can indicate that it wants pages above a
@@ -1607,16 +1623,26 @@ get_rq:
 	if (sync)
 		rw_flags |= REQ_SYNC;
 
+	iolat_blkg = blk_iolatency_throttle(q, bio, q->queue_lock);
+	wb_acct = wbt_wait(q, bio, q->queue_lock);
+
 	/*
 	 * Grab a free request. This is might sleep but can not fail.
 	 * Returns with the queue unlocked.
 	 */
 	req = get_request(q, rw_flags, bio, GFP_NOIO);
 	if (unlikely(!req)) {
+		if (wb_acct)
+			__wbt_done(q);
+		if (iolat_blkg)
+			__blk_iolatency_done(iolat_blkg);
 		bio_endio(bio, -ENODEV);	/* @q is dead */
 		goto out_unlock;
 	}
 
+	wbt_track(req, wb_acct);
+	blk_iolatency_track(req, iolat_blkg);
+
 	/*
 	 * After dropping the lock and possibly sleeping here, our request
 	 * may now be mergeable after it had proven unmergeable (above).
@@ -2029,6 +2055,13 @@ int blk_insert_cloned_request(struct request_queue *q, struct request *rq)
 	    should_fail_request(&rq->rq_disk->part0, blk_rq_bytes(rq)))
 		return -EIO;
 
+	if (q->mq_ops) {
+		/* the clone was allocated from @q, so it is ready to go */
+		blk_account_io_start(rq, true);
+		blk_mq_insert_request(rq, false, true, true);
+		return 0;
+	}
+
 	spin_lock_irqsave(q->queue_lock, flags);
 	if (unlikely(blk_queue_dying(q))) {
 		spin_unlock_irqrestore(q->queue_lock, flags);
@@ -2111,6 +2144,44 @@ void blk_account_io_completion(struct request *req, unsigned int bytes)
 	}
 }
 
+static void blk_account_io_latency(int cpu, struct request *req)
+{
+	struct blk_lat_hist *hist;
+	unsigned int dir, size, bucket;
+	u64 usecs;
+
+	if (!req->acct_start_ns)
+		return;
+
+	usecs = div_u64(ktime_to_ns(ktime_get()) - req->acct_start_ns,
+			NSEC_PER_USEC);
+	req->acct_start_ns = 0;
+
+	if (req->cmd_flags & REQ_DISCARD)
+		dir = 2;
+	else
+		dir = rq_data_dir(req);
+
+	if (req->acct_bytes <= 4096)
+		size = 0;
+	else if (req->acct_bytes <= 16384)
+		size = 1;
+	else if (req->acct_bytes <= 65536)
+		size = 2;
+	else
+		size = 3;
+
+	/* bucket 0 is below 16us, bucket n covers [2^(n+3), 2^(n+4)) us */
+	if (usecs < 16)
+		bucket = 0;
+	else
+		bucket = min_t(unsigned int, ilog2(usecs) - 3,
+			       BLK_LAT_HIST_BUCKETS - 1);
+
+	hist = per_cpu_ptr(req->q->lat_hist, cpu);
+	hist->count[dir][size][bucket]++;
+}
+
 void blk_account_io_done(struct request *req)
 {
 	/*
@@ -2131,6 +2202,7 @@ void blk_account_io_done(struct request *req)
 		part_stat_add(cpu, part, ticks[rw], duration);
 		part_round_stats(cpu, part);
 		part_dec_in_flight(part, rw);
+		blk_account_io_latency(cpu, req);
 
 		hd_struct_put(part);
 		part_stat_unlock();
@@ -2170,6 +2242,8 @@ void blk_account_io_start(struct request *rq, bool new_io)
 
 	cpu = part_stat_lock();
 
+	rq->acct_bytes = blk_rq_bytes(rq);
+
 	if (!new_io) {
 		part = rq->part;
 		part_stat_inc(cpu, part, merges[rw]);
@@ -2190,6 +2264,7 @@ void blk_account_io_start(struct request *rq, bool new_io)
 		part_round_stats(cpu, part);
 		part_inc_in_flight(part, rw);
 		rq->part = part;
+		rq->acct_start_ns = ktime_to_ns(ktime_get());
 	}
 
 	part_stat_unlock();
@@ -2348,6 +2423,8 @@ void blk_start_request(struct request *req)
 
 	BUG_ON(test_bit(REQ_ATOM_COMPLETE, &req->atomic_flags));
 	blk_add_timer(req);
+	wbt_issue(req->q, req);
+	blk_iolatency_issue(req);
 }
 EXPORT_SYMBOL(blk_start_request);
 
@@ -2888,7 +2965,7 @@ EXPORT_SYMBOL_GPL(blk_rq_unprep_clone);
 static void __blk_rq_prep_clone(struct request *dst, struct request *src)
 {
 	dst->cpu = src->cpu;
-	dst->cmd_flags = (src->cmd_flags & REQ_CLONE_MASK) | REQ_NOMERGE;
+	dst->cmd_flags |= (src->cmd_flags & REQ_CLONE_MASK) | REQ_NOMERGE;
 	dst->cmd_type = src->cmd_type;
 	dst->__sector = blk_rq_pos(src);
 	dst->__data_len = blk_rq_bytes(src);
@@ -2909,6 +2986,8 @@ static void __blk_rq_prep_clone(struct request *dst, struct request *src)
  *
  * Description:
  *     Clones bios in @rq_src to @rq, and copies attributes of @rq_src to @rq.
+ *     @rq must already be initialized, either by blk_rq_init() or because
+ *     it was allocated from a blk-mq queue.
  *     The actual data parts of @rq_src (e.g. ->cmd, ->sense)
  *     are not copied, and copying such parts is the caller's responsibility.
  *     Also, pages which the original bios are pointing to are not copied
@@ -2926,8 +3005,6 @@ int blk_rq_prep_clone(struct request *rq, struct request *rq_src,
 	if (!bs)
 		bs = fs_bio_set;
 
-	blk_rq_init(NULL, rq);
-
 	__rq_for_each_bio(bio_src, rq_src) {
 		bio = bio_clone_bioset(bio_src, gfp_mask, bs);
 		if (!bio)
@@ -3162,6 +3239,92 @@ void blk_finish_plug(struct blk_plug *plug)
 }
 EXPORT_SYMBOL(blk_finish_plug);
 
+/*
+ * Sleep for part of the time polled I/O takes to complete instead of
+ * spinning all of it away, either the io_poll_delay set for the queue or
+ * half of the mean completion time seen so far.  The task stays in the
+ * caller's sleeping state, so its completion still wakes it early.
+ */
+static bool blk_poll_hybrid_sleep(struct request_queue *q)
+{
+	struct hrtimer_sleeper hs;
+	long state = current->state;
+	u64 nsec;
+
+	if (q->poll_nsec > 0)
+		nsec = q->poll_nsec;
+	else if (q->poll_nsec == 0)
+		nsec = ACCESS_ONCE(q->poll_mean_nsec) / 2;
+	else
+		return false;
+
+	if (!nsec)
+		return false;
+
+	hrtimer_init_on_stack(&hs.timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	hrtimer_set_expires(&hs.timer, ns_to_ktime(nsec));
+	hrtimer_init_sleeper(&hs, current);
+
+	hrtimer_start_expires(&hs.timer, HRTIMER_MODE_REL);
+	if (hs.task && !signal_pending_state(state, current))
+		io_schedule();
+	hrtimer_cancel(&hs.timer);
+	destroy_hrtimer_on_stack(&hs.timer);
+
+	__set_current_state(TASK_RUNNING);
+	return true;
+}
+
+/**
+ * blk_poll - spin on a queue's completions instead of sleeping
+ * @q: the queue the caller's REQ_HIPRI I/O was submitted to
+ * @may_sleep: the caller hasn't polled for this I/O yet
+ *
+ * Description:
+ *    Called by a task that has set its state to sleep until its I/O
+ *    completes.  Instead of waiting for the interrupt, repeatedly ask the
+ *    driver to reap completions until the task is woken or has to give
+ *    up the CPU.  Returns true if the caller was woken, false if it
+ *    should go to sleep as usual.
+ *
+ *    If @may_sleep and the queue is in hybrid mode, the task first
+ *    sleeps for a while instead and true is returned once it is back,
+ *    whether its I/O completed or not.  The caller rechecks and, if it
+ *    still has to wait, calls blk_poll() again with @may_sleep false.
+ */
+bool blk_poll(struct request_queue *q, bool may_sleep)
+{
+	long state;
+
+	if (!q->poll_fn || !blk_queue_poll(q))
+		return false;
+
+	if (may_sleep && blk_poll_hybrid_sleep(q))
+		return true;
+
+	state = current->state;
+	while (!need_resched()) {
+		int ret = q->poll_fn(q);
+
+		if (ret > 0) {
+			set_current_state(TASK_RUNNING);
+			return true;
+		}
+
+		if (signal_pending_state(state, current))
+			set_current_state(TASK_RUNNING);
+
+		if (current->state == TASK_RUNNING)
+			return true;
+		if (ret < 0)
+			break;
+		cpu_relax();
+	}
+
+	return false;
+}
+EXPORT_SYMBOL_GPL(blk_poll);
+
 #ifdef CONFIG_PM_RUNTIME
 /**
  * blk_pm_runtime_init - Block layer runtime PM initialization routine
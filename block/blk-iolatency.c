@@ -0,0 +1,369 @@
+/*
+ * Block cgroup I/O latency controller
+ *
+ * A blkcg can be given a completion latency target on a device.  Every
+ * group gets its own limit on the number of requests it may have in
+ * flight there, which starts out at the queue depth.  Completions are
+ * sampled per group over a window; when the mean latency of a group
+ * misses its target, all groups with a looser target, or none at all,
+ * get their depth halved each window until the protected group has been
+ * meeting its target for a while.  They then scale back up one step per
+ * window.
+ *
+ * Throttling happens before a request is allocated, on both the legacy
+ * and the blk-mq request paths, so a group waiting for a slot doesn't
+ * hold any of the queue's tags.
+ */
+#include <linux/kernel.h>
+#include <linux/blkdev.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/wait.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+
+#include "blk-cgroup.h"
+#include "blk-iolatency.h"
+
+#define IOLAT_WINDOW_NSEC	(100 * 1000 * 1000ULL)
+
+/* for how long a missed target keeps the other groups from scaling up */
+#define IOLAT_MISS_HOLD		(HZ / 2)
+
+static struct blkcg_policy blkcg_policy_iolat;
+
+struct iolat_grp {
+	/* must be the first member */
+	struct blkg_policy_data pd;
+
+	u64 min_lat_nsec;		/* latency target, 0 if none */
+
+	atomic_t inflight;
+	wait_queue_head_t wait;
+	int scale_step;			/* depth is nr_requests >> scale_step */
+
+	/* completion samples of the current window, protected by ->lock */
+	spinlock_t lock;
+	u64 win_start_ns;
+	u64 lat_sum_ns;
+	unsigned int nr_samples;
+
+	/* root group only: tightest target missed and when, under ->lock */
+	unsigned long missed_at;
+	u64 missed_lat_nsec;
+};
+
+static inline struct iolat_grp *pd_to_ig(struct blkg_policy_data *pd)
+{
+	return pd ? container_of(pd, struct iolat_grp, pd) : NULL;
+}
+
+static inline struct iolat_grp *blkg_to_ig(struct blkcg_gq *blkg)
+{
+	return pd_to_ig(blkg_to_pd(blkg, &blkcg_policy_iolat));
+}
+
+static bool atomic_inc_below(atomic_t *v, int below)
+{
+	int cur = atomic_read(v);
+
+	for (;;) {
+		int old;
+
+		if (cur >= below)
+			return false;
+		old = atomic_cmpxchg(v, cur, cur + 1);
+		if (old == cur)
+			break;
+		cur = old;
+	}
+
+	return true;
+}
+
+static unsigned int iolat_depth(struct request_queue *q, struct iolat_grp *ig)
+{
+	int shift = min(ACCESS_ONCE(ig->scale_step), 31);
+
+	return max_t(unsigned int, q->nr_requests >> shift, 1);
+}
+
+static void scale_up(struct iolat_grp *ig)
+{
+	if (ig->scale_step <= 0)
+		return;
+
+	ig->scale_step--;
+	wake_up_all(&ig->wait);
+}
+
+static void scale_down(struct request_queue *q, struct iolat_grp *ig)
+{
+	/* can't go below a single request */
+	if (iolat_depth(q, ig) == 1)
+		return;
+
+	ig->scale_step++;
+}
+
+/*
+ * Called with the mean completion latency of a group's window that just
+ * ended.  Only one completion ends any given window, so ->scale_step
+ * isn't updated concurrently.
+ */
+static void iolat_end_window(struct blkcg_gq *blkg, struct iolat_grp *ig,
+			     u64 mean_ns)
+{
+	struct request_queue *q = blkg->q;
+	struct iolat_grp *root;
+	u64 target = ACCESS_ONCE(ig->min_lat_nsec);
+	u64 missed_lat = 0;
+	unsigned long flags;
+
+	if (!q->root_blkg)
+		return;
+	root = blkg_to_ig(q->root_blkg);
+
+	spin_lock_irqsave(&root->lock, flags);
+	if (root->missed_lat_nsec &&
+	    time_after_eq(jiffies, root->missed_at + IOLAT_MISS_HOLD))
+		root->missed_lat_nsec = 0;
+
+	if (target && mean_ns > target) {
+		if (!root->missed_lat_nsec || target < root->missed_lat_nsec)
+			root->missed_lat_nsec = target;
+		root->missed_at = jiffies;
+	}
+	missed_lat = root->missed_lat_nsec;
+	spin_unlock_irqrestore(&root->lock, flags);
+
+	/*
+	 * Back off while a group with a tighter target is missing it,
+	 * otherwise hand the depth back one step per window.
+	 */
+	if (missed_lat && (!target || target > missed_lat))
+		scale_down(q, ig);
+	else
+		scale_up(ig);
+}
+
+static void iolat_add_sample(struct blkcg_gq *blkg, struct iolat_grp *ig,
+			     u64 lat_ns)
+{
+	u64 now = ktime_to_ns(ktime_get());
+	u64 mean_ns = 0;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ig->lock, flags);
+	if (!ig->win_start_ns)
+		ig->win_start_ns = now;
+	ig->lat_sum_ns += lat_ns;
+	ig->nr_samples++;
+
+	if (now - ig->win_start_ns >= IOLAT_WINDOW_NSEC) {
+		mean_ns = div_u64(ig->lat_sum_ns, ig->nr_samples);
+		ig->win_start_ns = now;
+		ig->lat_sum_ns = 0;
+		ig->nr_samples = 0;
+	}
+	spin_unlock_irqrestore(&ig->lock, flags);
+
+	if (mean_ns)
+		iolat_end_window(blkg, ig, mean_ns);
+}
+
+/**
+ * blk_iolatency_throttle - wait for a slot of the bio's group
+ * @q:		the request queue
+ * @bio:	the bio about to get a request
+ * @lock:	queue_lock if held by the caller (dropped while sleeping)
+ *
+ * Returns the blkg @bio was accounted to with a reference held, the
+ * request allocated for it must then be attached with
+ * blk_iolatency_track().  If no request gets allocated after all,
+ * __blk_iolatency_done() returns the slot.  Returns %NULL if @bio isn't
+ * subject to the controller.
+ */
+struct blkcg_gq *blk_iolatency_throttle(struct request_queue *q,
+					struct bio *bio, spinlock_t *lock)
+{
+	struct blkcg *blkcg;
+	struct blkcg_gq *blkg;
+	struct iolat_grp *ig;
+	DEFINE_WAIT(wait);
+
+	rcu_read_lock();
+	blkcg = bio_blkcg(bio);
+
+	/* the root group is what everybody else gets throttled for */
+	if (blkcg == &blkcg_root) {
+		rcu_read_unlock();
+		return NULL;
+	}
+
+	blkg = blkg_lookup(blkcg, q);
+	if (unlikely(!blkg)) {
+		if (!lock)
+			spin_lock_irq(q->queue_lock);
+		blkg = blkg_lookup_create(blkcg, q);
+		if (IS_ERR(blkg))
+			blkg = NULL;
+		if (!lock)
+			spin_unlock_irq(q->queue_lock);
+	}
+
+	if (blkg && (!blkg_to_ig(blkg) || !atomic_inc_not_zero(&blkg->refcnt)))
+		blkg = NULL;
+	rcu_read_unlock();
+
+	if (!blkg)
+		return NULL;
+
+	ig = blkg_to_ig(blkg);
+	if (!atomic_inc_below(&ig->inflight, iolat_depth(q, ig))) {
+		do {
+			prepare_to_wait_exclusive(&ig->wait, &wait,
+						  TASK_UNINTERRUPTIBLE);
+
+			if (atomic_inc_below(&ig->inflight, iolat_depth(q, ig)))
+				break;
+
+			if (lock)
+				spin_unlock_irq(lock);
+
+			io_schedule();
+
+			if (lock)
+				spin_lock_irq(lock);
+		} while (1);
+
+		finish_wait(&ig->wait, &wait);
+	}
+
+	return blkg;
+}
+
+void __blk_iolatency_done(struct blkcg_gq *blkg)
+{
+	struct iolat_grp *ig = blkg_to_ig(blkg);
+
+	atomic_dec(&ig->inflight);
+	smp_mb__after_atomic();
+	if (waitqueue_active(&ig->wait))
+		wake_up(&ig->wait);
+
+	blkg_put(blkg);
+}
+
+/*
+ * Called when a request is freed.  Requests that made it to the driver
+ * provide a latency sample for their group.
+ */
+void blk_iolatency_done(struct request *rq)
+{
+	struct blkcg_gq *blkg = rq->iolat_blkg;
+
+	if (!blkg)
+		return;
+
+	rq->iolat_blkg = NULL;
+
+	if (rq->iolat_issue_ns) {
+		u64 lat = ktime_to_ns(ktime_get()) - rq->iolat_issue_ns;
+
+		rq->iolat_issue_ns = 0;
+		iolat_add_sample(blkg, blkg_to_ig(blkg), lat);
+	}
+
+	__blk_iolatency_done(blkg);
+}
+
+static void iolat_pd_init(struct blkcg_gq *blkg)
+{
+	struct iolat_grp *ig = blkg_to_ig(blkg);
+
+	ig->min_lat_nsec = 0;
+	atomic_set(&ig->inflight, 0);
+	init_waitqueue_head(&ig->wait);
+	ig->scale_step = 0;
+	spin_lock_init(&ig->lock);
+	ig->win_start_ns = 0;
+	ig->lat_sum_ns = 0;
+	ig->nr_samples = 0;
+	ig->missed_at = 0;
+	ig->missed_lat_nsec = 0;
+}
+
+static u64 iolat_prfill_target(struct seq_file *sf,
+			       struct blkg_policy_data *pd, int off)
+{
+	struct iolat_grp *ig = pd_to_ig(pd);
+
+	if (!ig->min_lat_nsec)
+		return 0;
+	return __blkg_prfill_u64(sf, pd, div_u64(ig->min_lat_nsec,
+						 NSEC_PER_USEC));
+}
+
+static int iolat_print_target(struct seq_file *sf, void *v)
+{
+	blkcg_print_blkgs(sf, css_to_blkcg(seq_css(sf)), iolat_prfill_target,
+			  &blkcg_policy_iolat, 0, false);
+	return 0;
+}
+
+static ssize_t iolat_set_target(struct kernfs_open_file *of,
+				char *buf, size_t nbytes, loff_t off)
+{
+	struct blkcg *blkcg = css_to_blkcg(of_css(of));
+	struct blkg_conf_ctx ctx;
+	struct iolat_grp *ig;
+	int ret;
+
+	ret = blkg_conf_prep(blkcg, &blkcg_policy_iolat, buf, &ctx);
+	if (ret)
+		return ret;
+
+	ig = blkg_to_ig(ctx.blkg);
+	ig->min_lat_nsec = ctx.v * NSEC_PER_USEC;
+
+	/* a new target starts out unthrottled */
+	ig->scale_step = 0;
+	wake_up_all(&ig->wait);
+
+	blkg_conf_finish(&ctx);
+	return nbytes;
+}
+
+static struct cftype iolat_files[] = {
+	{
+		.name = "latency.target_usec_device",
+		.seq_show = iolat_print_target,
+		.write = iolat_set_target,
+	},
+	{ }	/* terminate */
+};
+
+static struct blkcg_policy blkcg_policy_iolat = {
+	.pd_size		= sizeof(struct iolat_grp),
+	.cftypes		= iolat_files,
+
+	.pd_init_fn		= iolat_pd_init,
+};
+
+int blk_iolatency_init(struct request_queue *q)
+{
+	return blkcg_activate_policy(q, &blkcg_policy_iolat);
+}
+
+void blk_iolatency_exit(struct request_queue *q)
+{
+	blkcg_deactivate_policy(q, &blkcg_policy_iolat);
+}
+
+static int __init iolat_init(void)
+{
+	return blkcg_policy_register(&blkcg_policy_iolat);
+}
+
+module_init(iolat_init);
@@ -0,0 +1,65 @@
+#ifndef BLK_IOLATENCY_H
+#define BLK_IOLATENCY_H
+
+#include <linux/blkdev.h>
+#include <linux/ktime.h>
+
+struct blkcg_gq;
+
+#ifdef CONFIG_BLK_CGROUP_IOLATENCY
+
+int blk_iolatency_init(struct request_queue *);
+void blk_iolatency_exit(struct request_queue *);
+struct blkcg_gq *blk_iolatency_throttle(struct request_queue *, struct bio *,
+					spinlock_t *);
+void __blk_iolatency_done(struct blkcg_gq *);
+void blk_iolatency_done(struct request *);
+
+/*
+ * Attach the group blk_iolatency_throttle() accounted the request to, the
+ * slot and group reference are dropped by blk_iolatency_done().
+ */
+static inline void blk_iolatency_track(struct request *rq,
+				       struct blkcg_gq *blkg)
+{
+	rq->iolat_blkg = blkg;
+}
+
+static inline void blk_iolatency_issue(struct request *rq)
+{
+	if (rq->iolat_blkg)
+		rq->iolat_issue_ns = ktime_to_ns(ktime_get());
+}
+
+#else
+
+static inline int blk_iolatency_init(struct request_queue *q)
+{
+	return 0;
+}
+static inline void blk_iolatency_exit(struct request_queue *q)
+{
+}
+static inline struct blkcg_gq *
+blk_iolatency_throttle(struct request_queue *q, struct bio *bio,
+		       spinlock_t *lock)
+{
+	return NULL;
+}
+static inline void __blk_iolatency_done(struct blkcg_gq *blkg)
+{
+}
+static inline void blk_iolatency_done(struct request *rq)
+{
+}
+static inline void blk_iolatency_track(struct request *rq,
+				       struct blkcg_gq *blkg)
+{
+}
+static inline void blk_iolatency_issue(struct request *rq)
+{
+}
+
+#endif /* CONFIG_BLK_CGROUP_IOLATENCY */
+
+#endif
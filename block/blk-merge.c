@@ -522,6 +522,7 @@ static int attempt_merge(struct request_queue *q, struct request *req,
 	req->biotail = next->biotail;
 
 	req->__data_len += blk_rq_bytes(next);
+	req->acct_bytes = blk_rq_bytes(req);
 
 	elv_merge_requests(q, req, next);
 
@@ -0,0 +1,76 @@
+#ifndef INT_BLK_MQ_SCHED_H
+#define INT_BLK_MQ_SCHED_H
+
+#include <linux/elevator.h>
+#include <linux/rcupdate.h>
+
+/*
+ * q->elevator of a blk-mq queue only changes with the queue frozen, and the
+ * old scheduler is torn down an RCU grace period later (see
+ * elevator_switch_mq()).  So the hardware queue run side just needs to hold
+ * rcu_read_lock() across each call into the scheduler.
+ */
+
+/* flush sequences and passthrough requests are never sorted */
+static inline bool blk_mq_sched_bypass(struct request *rq)
+{
+	return (rq->cmd_flags & REQ_FLUSH_SEQ) || rq->cmd_type != REQ_TYPE_FS;
+}
+
+/*
+ * Move the requests spliced off the software queues into the scheduler,
+ * anything it should not see stays on @list for direct dispatch.
+ */
+static inline void blk_mq_sched_insert_requests(struct blk_mq_hw_ctx *hctx,
+						struct list_head *list)
+{
+	struct elevator_queue *e;
+	struct request *rq, *next;
+	LIST_HEAD(sched_list);
+
+	if (list_empty(list))
+		return;
+
+	rcu_read_lock();
+	e = ACCESS_ONCE(hctx->queue->elevator);
+	if (e) {
+		list_for_each_entry_safe(rq, next, list, queuelist)
+			if (!blk_mq_sched_bypass(rq))
+				list_move_tail(&rq->queuelist, &sched_list);
+
+		if (!list_empty(&sched_list))
+			e->type->mq_ops.insert_requests(e, hctx, &sched_list);
+	}
+	rcu_read_unlock();
+}
+
+static inline struct request *
+blk_mq_sched_dispatch_request(struct blk_mq_hw_ctx *hctx)
+{
+	struct elevator_queue *e;
+	struct request *rq = NULL;
+
+	rcu_read_lock();
+	e = ACCESS_ONCE(hctx->queue->elevator);
+	if (e)
+		rq = e->type->mq_ops.dispatch_request(e, hctx);
+	rcu_read_unlock();
+
+	return rq;
+}
+
+static inline bool blk_mq_sched_has_work(struct blk_mq_hw_ctx *hctx)
+{
+	struct elevator_queue *e;
+	bool ret = false;
+
+	rcu_read_lock();
+	e = ACCESS_ONCE(hctx->queue->elevator);
+	if (e)
+		ret = e->type->mq_ops.has_work(e, hctx);
+	rcu_read_unlock();
+
+	return ret;
+}
+
+#endif
@@ -206,7 +206,7 @@ static int __bt_get(struct blk_mq_hw_ctx *hctx, struct blk_mq_bitmap_tags *bt,
 done:
 	if (tag == org_last_tag) {
 		last_tag = tag + 1;
-		if (last_tag >= bt->depth - 1)
+		if (last_tag >= bt->depth)
 			last_tag = 0;
 
 		*tag_cache = last_tag;
@@ -346,20 +346,25 @@ static void bt_clear_tag(struct blk_mq_bitmap_tags *bt, unsigned int tag)
 	 */
 	clear_bit_unlock(TAG_TO_BIT(bt, tag), &bt->map[index].word);
 
+	/*
+	 * Order the clear against the waitqueue_active() checks below,
+	 * pairs with prepare_to_wait() and the retry in bt_get(). Without
+	 * it a submitter that just went to sleep may miss the free tag
+	 * and nobody would wake it.
+	 */
+	smp_mb__after_atomic();
+
 	bs = bt_wake_ptr(bt);
 	if (!bs)
 		return;
 
 	wait_cnt = atomic_dec_return(&bs->wait_cnt);
+	if (unlikely(wait_cnt < 0))
+		wait_cnt = atomic_inc_return(&bs->wait_cnt);
 	if (wait_cnt == 0) {
-wake:
 		atomic_add(bt->wake_cnt, &bs->wait_cnt);
 		bt_index_atomic_inc(&bt->wake_index);
 		wake_up(&bs->wait);
-	} else if (wait_cnt < 0) {
-		wait_cnt = atomic_inc_return(&bs->wait_cnt);
-		if (!wait_cnt)
-			goto wake;
 	}
 }
 
@@ -462,13 +467,31 @@ static void bt_update_count(struct blk_mq_bitmap_tags *bt,
 		}
 	}
 
+	/*
+	 * Each wait queue needs wake_cnt frees before it is woken. With
+	 * all BT_WAIT_QUEUES in use that must still fit into the depth,
+	 * or the last waiters can sleep forever once every tag is back.
+	 * Moderate depths shared by many CPUs hit exactly that.
+	 */
 	bt->wake_cnt = BT_WAIT_BATCH;
-	if (bt->wake_cnt > depth / 4)
-		bt->wake_cnt = max(1U, depth / 4);
+	if (bt->wake_cnt > depth / BT_WAIT_QUEUES)
+		bt->wake_cnt = max(1U, depth / BT_WAIT_QUEUES);
 
 	bt->depth = depth;
 }
 
+/*
+ * Restart the wakeup countdown after wake_cnt changed, a batch left over
+ * from a larger depth could otherwise never be reached.
+ */
+static void bt_reset_wait_cnt(struct blk_mq_bitmap_tags *bt)
+{
+	int i;
+
+	for (i = 0; i < BT_WAIT_QUEUES; i++)
+		atomic_set(&bt->bs[i].wait_cnt, bt->wake_cnt);
+}
+
 static int bt_alloc(struct blk_mq_bitmap_tags *bt, unsigned int depth,
 			int node, bool reserved)
 {
@@ -515,10 +538,9 @@ static int bt_alloc(struct blk_mq_bitmap_tags *bt, unsigned int depth,
 
 	bt_update_count(bt, depth);
 
-	for (i = 0; i < BT_WAIT_QUEUES; i++) {
+	for (i = 0; i < BT_WAIT_QUEUES; i++)
 		init_waitqueue_head(&bt->bs[i].wait);
-		atomic_set(&bt->bs[i].wait_cnt, bt->wake_cnt);
-	}
+	bt_reset_wait_cnt(bt);
 
 	return 0;
 }
@@ -591,6 +613,7 @@ int blk_mq_tag_update_depth(struct blk_mq_tags *tags, unsigned int tdepth)
 	 * static and should never need resizing.
 	 */
 	bt_update_count(&tags->bitmap_tags, tdepth);
+	bt_reset_wait_cnt(&tags->bitmap_tags);
 	blk_mq_tag_wakeup_all(tags);
 	return 0;
 }
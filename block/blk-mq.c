@@ -27,6 +27,9 @@
 #include "blk.h"
 #include "blk-mq.h"
 #include "blk-mq-tag.h"
+#include "blk-mq-sched.h"
+#include "blk-wbt.h"
+#include "blk-iolatency.h"
 
 static DEFINE_MUTEX(all_q_mutex);
 static LIST_HEAD(all_q_list);
@@ -44,7 +47,7 @@ static bool blk_mq_hctx_has_pending(struct blk_mq_hw_ctx *hctx)
 		if (hctx->ctx_map.map[i].word)
 			return true;
 
-	return false;
+	return blk_mq_sched_has_work(hctx);
 }
 
 static inline struct blk_align_bitmap *get_bm(struct blk_mq_hw_ctx *hctx,
@@ -76,7 +79,7 @@ static void blk_mq_hctx_clear_pending(struct blk_mq_hw_ctx *hctx,
 	clear_bit(CTX_TO_BIT(hctx, ctx), &bm->word);
 }
 
-static int blk_mq_queue_enter(struct request_queue *q)
+static int blk_mq_queue_enter(struct request_queue *q, gfp_t gfp)
 {
 	int ret;
 
@@ -90,6 +93,10 @@ static int blk_mq_queue_enter(struct request_queue *q)
 
 	__percpu_counter_add(&q->mq_usage_counter, -1, 1000000);
 
+	/* atomic allocations (e.g. from a stacking driver) can't wait */
+	if (!(gfp & __GFP_WAIT))
+		return -EBUSY;
+
 	spin_lock_irq(q->queue_lock);
 	ret = wait_event_interruptible_lock_irq(q->mq_freeze_wq,
 		!blk_queue_bypass(q) || blk_queue_dying(q),
@@ -129,7 +136,7 @@ void blk_mq_drain_queue(struct request_queue *q)
  * Guarantee no request is in use, so we can change any data structure of
  * the queue afterward.
  */
-static void blk_mq_freeze_queue(struct request_queue *q)
+void blk_mq_freeze_queue(struct request_queue *q)
 {
 	bool drain;
 
@@ -141,8 +148,9 @@ static void blk_mq_freeze_queue(struct request_queue *q)
 	if (drain)
 		blk_mq_drain_queue(q);
 }
+EXPORT_SYMBOL_GPL(blk_mq_freeze_queue);
 
-static void blk_mq_unfreeze_queue(struct request_queue *q)
+void blk_mq_unfreeze_queue(struct request_queue *q)
 {
 	bool wake = false;
 
@@ -156,6 +164,7 @@ static void blk_mq_unfreeze_queue(struct request_queue *q)
 	if (wake)
 		wake_up_all(&q->mq_freeze_wq);
 }
+EXPORT_SYMBOL_GPL(blk_mq_unfreeze_queue);
 
 bool blk_mq_can_queue(struct blk_mq_hw_ctx *hctx)
 {
@@ -186,6 +195,15 @@ static void blk_mq_rq_ctx_init(struct request_queue *q, struct blk_mq_ctx *ctx,
 	set_start_time_ns(rq);
 	rq->io_start_time_ns = 0;
 #endif
+#ifdef CONFIG_BLK_WBT
+	rq->wbt_issue_ns = 0;
+#endif
+#ifdef CONFIG_BLK_CGROUP_IOLATENCY
+	rq->iolat_blkg = NULL;
+	rq->iolat_issue_ns = 0;
+#endif
+	rq->acct_start_ns = 0;
+	rq->poll_start_ns = 0;
 	rq->nr_phys_segments = 0;
 #if defined(CONFIG_BLK_DEV_INTEGRITY)
 	rq->nr_integrity_segments = 0;
@@ -241,7 +259,7 @@ struct request *blk_mq_alloc_request(struct request_queue *q, int rw, gfp_t gfp,
 	struct request *rq;
 	struct blk_mq_alloc_data alloc_data;
 
-	if (blk_mq_queue_enter(q))
+	if (blk_mq_queue_enter(q, gfp))
 		return NULL;
 
 	ctx = blk_mq_get_ctx(q);
@@ -275,6 +293,9 @@ static void __blk_mq_free_request(struct blk_mq_hw_ctx *hctx,
 	if (rq->cmd_flags & REQ_MQ_INFLIGHT)
 		atomic_dec(&hctx->nr_active);
 
+	wbt_done(q, rq);
+	blk_iolatency_done(rq);
+
 	clear_bit(REQ_ATOM_STARTED, &rq->atomic_flags);
 	blk_mq_put_tag(hctx, tag, &ctx->last_tag);
 	blk_mq_queue_exit(q);
@@ -312,10 +333,31 @@ void blk_mq_clone_flush_request(struct request *flush_rq,
 		hctx->cmd_size);
 }
 
+/*
+ * Keep a running mean of how long polled requests take from submission
+ * until they complete, which the adaptive hybrid mode of blk_poll() sleeps
+ * for half of.  Racing updates from other CPUs just lose a sample.
+ */
+static void blk_mq_poll_stat(struct request *rq)
+{
+	struct request_queue *q = rq->q;
+	unsigned long mean = ACCESS_ONCE(q->poll_mean_nsec);
+	u64 nsec = ktime_to_ns(ktime_get()) - rq->poll_start_ns;
+
+	rq->poll_start_ns = 0;
+
+	if (mean)
+		nsec = ((u64) mean * 7 + nsec) >> 3;
+	ACCESS_ONCE(q->poll_mean_nsec) = min_t(u64, nsec, ULONG_MAX);
+}
+
 inline void __blk_mq_end_io(struct request *rq, int error)
 {
 	blk_account_io_done(rq);
 
+	if (rq->poll_start_ns)
+		blk_mq_poll_stat(rq);
+
 	if (rq->end_io) {
 		rq->end_io(rq, error);
 	} else {
@@ -407,6 +449,8 @@ static void blk_mq_start_request(struct request *rq, bool last)
 		rq->next_rq->resid_len = blk_rq_bytes(rq->next_rq);
 
 	blk_add_timer(rq);
+	wbt_issue(q, rq);
+	blk_iolatency_issue(rq);
 
 	/*
 	 * Mark us as started and clear complete. Complete might have been
@@ -736,6 +780,11 @@ static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
 	 */
 	flush_busy_ctxs(hctx, &rq_list);
 
+	/*
+	 * With an I/O scheduler attached, hand it what we just collected.
+	 */
+	blk_mq_sched_insert_requests(hctx, &rq_list);
+
 	/*
 	 * If we have previous entries on our dispatch list, grab them
 	 * and stuff them at the front for more fair dispatch.
@@ -748,16 +797,26 @@ static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
 	}
 
 	/*
-	 * Now process all the entries, sending them to the driver.
+	 * Now process all the entries, sending them to the driver. Once
+	 * those are gone, keep asking the scheduler for more until either
+	 * it or the driver runs out.
 	 */
 	queued = 0;
-	while (!list_empty(&rq_list)) {
+	while (1) {
 		int ret;
 
-		rq = list_first_entry(&rq_list, struct request, queuelist);
-		list_del_init(&rq->queuelist);
+		if (!list_empty(&rq_list)) {
+			rq = list_first_entry(&rq_list, struct request,
+						queuelist);
+			list_del_init(&rq->queuelist);
+		} else {
+			rq = blk_mq_sched_dispatch_request(hctx);
+			if (!rq)
+				break;
+		}
 
-		blk_mq_start_request(rq, list_empty(&rq_list));
+		blk_mq_start_request(rq, list_empty(&rq_list) &&
+					 !blk_mq_sched_has_work(hctx));
 
 		ret = q->mq_ops->queue_rq(hctx, rq);
 		switch (ret) {
@@ -1086,6 +1145,9 @@ static void blk_mq_bio_to_request(struct request *rq, struct bio *bio)
 {
 	init_request_from_bio(rq, bio);
 
+	if ((bio->bi_rw & REQ_HIPRI) && rq->q->poll_nsec == 0)
+		rq->poll_start_ns = ktime_to_ns(ktime_get());
+
 	if (blk_do_io_stat(rq))
 		blk_account_io_start(rq, 1);
 }
@@ -1131,7 +1193,7 @@ static struct request *blk_mq_map_request(struct request_queue *q,
 	int rw = bio_data_dir(bio);
 	struct blk_mq_alloc_data alloc_data;
 
-	if (unlikely(blk_mq_queue_enter(q))) {
+	if (unlikely(blk_mq_queue_enter(q, GFP_KERNEL))) {
 		bio_endio(bio, -EIO);
 		return NULL;
 	}
@@ -1177,6 +1239,8 @@ static void blk_mq_make_request(struct request_queue *q, struct bio *bio)
 	const int is_flush_fua = bio->bi_rw & (REQ_FLUSH | REQ_FUA);
 	struct blk_map_ctx data;
 	struct request *rq;
+	struct blkcg_gq *iolat_blkg;
+	bool wb_acct;
 
 	blk_queue_bounce(q, &bio);
 
@@ -1185,9 +1249,20 @@ static void blk_mq_make_request(struct request_queue *q, struct bio *bio)
 		return;
 	}
 
+	iolat_blkg = blk_iolatency_throttle(q, bio, NULL);
+	wb_acct = wbt_wait(q, bio, NULL);
+
 	rq = blk_mq_map_request(q, bio, &data);
-	if (unlikely(!rq))
+	if (unlikely(!rq)) {
+		if (wb_acct)
+			__wbt_done(q);
+		if (iolat_blkg)
+			__blk_iolatency_done(iolat_blkg);
 		return;
+	}
+
+	wbt_track(rq, wb_acct);
+	blk_iolatency_track(rq, iolat_blkg);
 
 	if (unlikely(is_flush_fua)) {
 		blk_mq_bio_to_request(rq, bio);
@@ -1195,7 +1270,11 @@ static void blk_mq_make_request(struct request_queue *q, struct bio *bio)
 		goto run_queue;
 	}
 
-	if (is_sync) {
+	/*
+	 * Issue sync IO straight to the driver, unless a scheduler wants
+	 * to see it first.
+	 */
+	if (is_sync && !q->elevator) {
 		int ret;
 
 		blk_mq_bio_to_request(rq, bio);
@@ -1245,6 +1324,8 @@ static void blk_sq_make_request(struct request_queue *q, struct bio *bio)
 	unsigned int use_plug, request_count = 0;
 	struct blk_map_ctx data;
 	struct request *rq;
+	struct blkcg_gq *iolat_blkg;
+	bool wb_acct;
 
 	/*
 	 * If we have multiple hardware queues, just go directly to
@@ -1263,9 +1344,20 @@ static void blk_sq_make_request(struct request_queue *q, struct bio *bio)
 	    blk_attempt_plug_merge(q, bio, &request_count))
 		return;
 
+	iolat_blkg = blk_iolatency_throttle(q, bio, NULL);
+	wb_acct = wbt_wait(q, bio, NULL);
+
 	rq = blk_mq_map_request(q, bio, &data);
-	if (unlikely(!rq))
+	if (unlikely(!rq)) {
+		if (wb_acct)
+			__wbt_done(q);
+		if (iolat_blkg)
+			__blk_iolatency_done(iolat_blkg);
 		return;
+	}
+
+	wbt_track(rq, wb_acct);
+	blk_iolatency_track(rq, iolat_blkg);
 
 	if (unlikely(is_flush_fua)) {
 		blk_mq_bio_to_request(rq, bio);
@@ -1756,11 +1848,41 @@ static void blk_mq_add_queue_tag_set(struct blk_mq_tag_set *set,
 	mutex_unlock(&set->tag_list_lock);
 }
 
+static int blk_mq_poll(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+
+	hctx = q->mq_ops->map_queue(q, raw_smp_processor_id());
+	return q->mq_ops->poll(hctx);
+}
+
 struct request_queue *blk_mq_init_queue(struct blk_mq_tag_set *set)
+{
+	struct request_queue *uninit_q, *q;
+
+	uninit_q = blk_alloc_queue_node(GFP_KERNEL, set->numa_node);
+	if (!uninit_q)
+		return ERR_PTR(-ENOMEM);
+
+	q = blk_mq_init_allocated_queue(set, uninit_q);
+	if (IS_ERR(q))
+		blk_cleanup_queue(uninit_q);
+
+	return q;
+}
+EXPORT_SYMBOL(blk_mq_init_queue);
+
+/*
+ * Turn a queue obtained from blk_alloc_queue() into a blk-mq queue driven
+ * by @set.  This lets a stacking driver such as request-based dm create
+ * its queue early and only pick the queue type once it knows what it is
+ * stacked on.  On failure @q is left for the caller to clean up.
+ */
+struct request_queue *blk_mq_init_allocated_queue(struct blk_mq_tag_set *set,
+						  struct request_queue *q)
 {
 	struct blk_mq_hw_ctx **hctxs;
 	struct blk_mq_ctx __percpu *ctx;
-	struct request_queue *q;
 	unsigned int *map;
 	int i;
 
@@ -1794,12 +1916,8 @@ struct request_queue *blk_mq_init_queue(struct blk_mq_tag_set *set)
 		hctxs[i]->queue_num = i;
 	}
 
-	q = blk_alloc_queue_node(GFP_KERNEL, set->numa_node);
-	if (!q)
-		goto err_hctxs;
-
 	if (percpu_counter_init(&q->mq_usage_counter, 0))
-		goto err_map;
+		goto err_hctxs;
 
 	setup_timer(&q->timeout, blk_mq_rq_timer, (unsigned long) q);
 	blk_queue_rq_timeout(q, 30000);
@@ -1840,6 +1958,9 @@ struct request_queue *blk_mq_init_queue(struct blk_mq_tag_set *set)
 	if (set->ops->complete)
 		blk_queue_softirq_done(q, set->ops->complete);
 
+	if (set->ops->poll)
+		blk_queue_poll_fn(q, blk_mq_poll);
+
 	blk_mq_init_flush(q);
 	blk_mq_init_cpu_queues(q, set->nr_hw_queues);
 
@@ -1847,7 +1968,7 @@ struct request_queue *blk_mq_init_queue(struct blk_mq_tag_set *set)
 				set->cmd_size, cache_line_size()),
 				GFP_KERNEL);
 	if (!q->flush_rq)
-		goto err_hw;
+		goto err_counter;
 
 	if (blk_mq_init_hw_queues(q, set))
 		goto err_flush_rq;
@@ -1864,8 +1985,14 @@ struct request_queue *blk_mq_init_queue(struct blk_mq_tag_set *set)
 
 err_flush_rq:
 	kfree(q->flush_rq);
-err_hw:
-	blk_cleanup_queue(q);
+	q->flush_rq = NULL;
+err_counter:
+	percpu_counter_destroy(&q->mq_usage_counter);
+	/* the caller tears @q down as the queue it was handed to us as */
+	q->mq_ops = NULL;
+	q->queue_ctx = NULL;
+	q->queue_hw_ctx = NULL;
+	q->mq_map = NULL;
 err_hctxs:
 	kfree(map);
 	for (i = 0; i < set->nr_hw_queues; i++) {
@@ -1880,7 +2007,7 @@ err_percpu:
 	free_percpu(ctx);
 	return ERR_PTR(-ENOMEM);
 }
-EXPORT_SYMBOL(blk_mq_init_queue);
+EXPORT_SYMBOL(blk_mq_init_allocated_queue);
 
 void blk_mq_free_queue(struct request_queue *q)
 {
@@ -194,6 +194,25 @@ void blk_queue_make_request(struct request_queue *q, make_request_fn *mfn)
 }
 EXPORT_SYMBOL(blk_queue_make_request);
 
+/**
+ * blk_queue_poll_fn - set a driver's completion polling function
+ * @q: the request queue for the device
+ * @pfn: the function that reaps completed commands
+ *
+ * Description:
+ *    Drivers that can check their completion queues without waiting for
+ *    an interrupt set @pfn, which is then called by blk_poll() on behalf
+ *    of submitters of %REQ_HIPRI I/O.  @pfn must return the number of
+ *    completions it found.  This also turns on polling for @q, which can
+ *    be switched off again through the io_poll sysfs attribute.
+ **/
+void blk_queue_poll_fn(struct request_queue *q, poll_q_fn *pfn)
+{
+	q->poll_fn = pfn;
+	queue_flag_set_unlocked(QUEUE_FLAG_POLL, q);
+}
+EXPORT_SYMBOL(blk_queue_poll_fn);
+
 /**
  * blk_queue_bounce_limit - set bounce buffer limit for queue
  * @q: the request queue for the device
@@ -0,0 +1,379 @@
+/*
+ * Writeback throttling, based on read completion latency
+ *
+ * Buffered writeback is allowed a limited number of requests in flight on
+ * the queue.  Completion latency of reads is sampled over a window; if the
+ * fastest read in a window still took longer than the target, writeback
+ * is hurting and its depth is halved.  Like CoDel, the window shrinks with
+ * the square root of the number of consecutive reductions.  Windows with
+ * reads that met the target scale the depth back up.
+ */
+#include <linux/kernel.h>
+#include <linux/blkdev.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/swap.h>
+#include <linux/ktime.h>
+#include <linux/percpu.h>
+
+#include "blk-wbt.h"
+
+/* starting depth, scaling up from here is capped at 3/4 of the queue */
+#define RWB_DEF_DEPTH		16
+
+#define RWB_WINDOW_NSEC		(100 * 1000 * 1000ULL)
+
+/* default read latency targets */
+#define RWB_NONROT_LAT_NSEC	(2 * 1000 * 1000ULL)
+#define RWB_ROT_LAT_NSEC	(75 * 1000 * 1000ULL)
+
+/* writeback near other IO completing this recently gets the lower limit */
+#define RWB_CLOSE_IO		(HZ / 10)
+
+static bool atomic_inc_below(atomic_t *v, int below)
+{
+	int cur = atomic_read(v);
+
+	for (;;) {
+		int old;
+
+		if (cur >= below)
+			return false;
+		old = atomic_cmpxchg(v, cur, cur + 1);
+		if (old == cur)
+			break;
+		cur = old;
+	}
+
+	return true;
+}
+
+static inline bool rwb_enabled(struct rq_wb *rwb)
+{
+	return rwb && rwb->min_lat_nsec;
+}
+
+static void calc_wb_limits(struct rq_wb *rwb)
+{
+	unsigned int qd = max_t(unsigned int, rwb->q->nr_requests, 1);
+	unsigned int depth = min_t(unsigned int, RWB_DEF_DEPTH, qd);
+
+	if (rwb->scale_step > 0) {
+		depth = 1 + ((depth - 1) >> min(31, rwb->scale_step));
+	} else if (rwb->scale_step < 0) {
+		unsigned int maxd = max(3 * qd / 4, 1U);
+
+		depth = 1 + ((depth - 1) << min(31, -rwb->scale_step));
+		if (depth > maxd) {
+			depth = maxd;
+			rwb->scaled_max = true;
+		}
+	}
+
+	rwb->wb_max = depth;
+	rwb->wb_normal = (depth + 1) / 2;
+	rwb->wb_background = (depth + 3) / 4;
+}
+
+static void rwb_update_limits(struct rq_wb *rwb)
+{
+	calc_wb_limits(rwb);
+
+	if (rwb->scale_step > 0)
+		rwb->cur_win_nsec = div_u64(rwb->win_nsec << 4,
+					int_sqrt((rwb->scale_step + 1) << 8));
+	else
+		rwb->cur_win_nsec = rwb->win_nsec;
+}
+
+static void rwb_arm_timer(struct rq_wb *rwb)
+{
+	mod_timer(&rwb->window_timer,
+		  jiffies + max(nsecs_to_jiffies(rwb->cur_win_nsec), 1UL));
+}
+
+static void scale_up(struct rq_wb *rwb)
+{
+	/*
+	 * Only go beyond the default depth while writeback is actually
+	 * waiting for it.
+	 */
+	if (rwb->scale_step <= 0 &&
+	    (rwb->scaled_max || !waitqueue_active(&rwb->wait)))
+		return;
+
+	rwb->scale_step--;
+	rwb_update_limits(rwb);
+	wake_up_all(&rwb->wait);
+}
+
+static void scale_down(struct rq_wb *rwb)
+{
+	/* can't go below a single request */
+	if (rwb->wb_max == 1)
+		return;
+
+	if (rwb->scale_step < 0)
+		rwb->scale_step = 0;
+	else
+		rwb->scale_step++;
+	rwb->scaled_max = false;
+	rwb_update_limits(rwb);
+}
+
+/*
+ * Sum up and reset the per-cpu samples of the window that just ended.
+ * Completions racing with the reset on other CPUs simply get lost, one
+ * sample more or less doesn't change the picture.
+ */
+static void wbt_collect_window(struct rq_wb *rwb, struct wbt_stat *w)
+{
+	int cpu;
+
+	w->min_lat_nsec = 0;
+	w->nr_reads = 0;
+
+	for_each_possible_cpu(cpu) {
+		struct wbt_stat *s = per_cpu_ptr(rwb->stat, cpu);
+
+		if (!s->nr_reads)
+			continue;
+
+		if (!w->min_lat_nsec || s->min_lat_nsec < w->min_lat_nsec)
+			w->min_lat_nsec = s->min_lat_nsec;
+		w->nr_reads += s->nr_reads;
+
+		s->min_lat_nsec = 0;
+		s->nr_reads = 0;
+	}
+}
+
+static void wb_timer_fn(unsigned long data)
+{
+	struct rq_wb *rwb = (struct rq_wb *) data;
+	struct wbt_stat w;
+
+	wbt_collect_window(rwb, &w);
+
+	if (!rwb->min_lat_nsec)
+		return;
+
+	if (w.nr_reads) {
+		if (w.min_lat_nsec > rwb->min_lat_nsec)
+			scale_down(rwb);
+		else
+			scale_up(rwb);
+	} else if (rwb->scale_step > 0) {
+		/*
+		 * No reads to judge by, hand writeback its depth back one
+		 * step per window.
+		 */
+		scale_up(rwb);
+	}
+
+	/* keep monitoring while scaled down or writeback is in flight */
+	if (rwb->scale_step > 0 || atomic_read(&rwb->inflight))
+		rwb_arm_timer(rwb);
+}
+
+static bool close_io(struct rq_wb *rwb)
+{
+	return time_before(jiffies, ACCESS_ONCE(rwb->last_comp) + RWB_CLOSE_IO);
+}
+
+static unsigned int get_limit(struct rq_wb *rwb)
+{
+	/* memory reclaim needs pages cleaned, don't starve it */
+	if (current_is_kswapd())
+		return rwb->wb_max;
+
+	if (close_io(rwb))
+		return rwb->wb_background;
+
+	return rwb->wb_normal;
+}
+
+/*
+ * Only buffered writeback is throttled; sync writes, O_DIRECT and
+ * flushes have somebody waiting on them.
+ */
+static bool wbt_should_throttle(struct bio *bio)
+{
+	const unsigned long rw = bio->bi_rw;
+
+	if (!(rw & REQ_WRITE))
+		return false;
+
+	return !(rw & (REQ_SYNC | REQ_DISCARD | REQ_FLUSH | REQ_FUA));
+}
+
+/**
+ * wbt_wait - wait for a writeback slot before allocating a request
+ * @q:		the request queue
+ * @bio:	the bio about to get a request
+ * @lock:	queue_lock if held by the caller (dropped while sleeping)
+ *
+ * Returns true if @bio was counted against the writeback limit, the
+ * request allocated for it must then be marked with wbt_track().  If no
+ * request gets allocated after all, __wbt_done() returns the slot.
+ */
+bool wbt_wait(struct request_queue *q, struct bio *bio, spinlock_t *lock)
+{
+	struct rq_wb *rwb = q->rq_wb;
+	DEFINE_WAIT(wait);
+
+	if (!rwb_enabled(rwb) || !wbt_should_throttle(bio))
+		return false;
+
+	if (!atomic_inc_below(&rwb->inflight, get_limit(rwb))) {
+		do {
+			prepare_to_wait(&rwb->wait, &wait,
+					TASK_UNINTERRUPTIBLE);
+
+			if (atomic_inc_below(&rwb->inflight, get_limit(rwb)))
+				break;
+
+			if (lock)
+				spin_unlock_irq(lock);
+
+			io_schedule();
+
+			if (lock)
+				spin_lock_irq(lock);
+		} while (1);
+
+		finish_wait(&rwb->wait, &wait);
+	}
+
+	if (!timer_pending(&rwb->window_timer))
+		rwb_arm_timer(rwb);
+
+	return true;
+}
+
+void __wbt_done(struct request_queue *q)
+{
+	struct rq_wb *rwb = q->rq_wb;
+	int inflight, limit;
+
+	inflight = atomic_dec_return(&rwb->inflight);
+
+	if (!waitqueue_active(&rwb->wait))
+		return;
+
+	/*
+	 * Don't wake anyone for every single completion, wait until a
+	 * batch of slots is free.
+	 */
+	limit = rwb_enabled(rwb) ? rwb->wb_normal : rwb->wb_max;
+	if (!inflight || limit - inflight >= rwb->wb_background / 2)
+		wake_up_all(&rwb->wait);
+}
+
+/*
+ * Called when a request is freed.  Tracked writes give their slot back,
+ * filesystem reads that made it to the driver provide a latency sample.
+ */
+void wbt_done(struct request_queue *q, struct request *rq)
+{
+	struct rq_wb *rwb = q->rq_wb;
+
+	if (!rwb)
+		return;
+
+	if (rq->cmd_flags & REQ_WB_TRACKED) {
+		rq->cmd_flags &= ~REQ_WB_TRACKED;
+		__wbt_done(q);
+		return;
+	}
+
+	if (rq->cmd_type != REQ_TYPE_FS)
+		return;
+
+	if (ACCESS_ONCE(rwb->last_comp) != jiffies)
+		ACCESS_ONCE(rwb->last_comp) = jiffies;
+
+	if (rq->wbt_issue_ns) {
+		u64 lat = ktime_to_ns(ktime_get()) - rq->wbt_issue_ns;
+		struct wbt_stat *s;
+		unsigned long flags;
+
+		rq->wbt_issue_ns = 0;
+
+		local_irq_save(flags);
+		s = this_cpu_ptr(rwb->stat);
+		if (!s->nr_reads || lat < s->min_lat_nsec)
+			s->min_lat_nsec = lat;
+		s->nr_reads++;
+		local_irq_restore(flags);
+	}
+}
+
+void wbt_issue(struct request_queue *q, struct request *rq)
+{
+	if (!rwb_enabled(q->rq_wb))
+		return;
+
+	if (rq->cmd_type == REQ_TYPE_FS && rq_data_dir(rq) == READ)
+		rq->wbt_issue_ns = ktime_to_ns(ktime_get());
+}
+
+/*
+ * Set a new read latency target, 0 turns throttling off.  Called with
+ * q->sysfs_lock held.
+ */
+void wbt_set_min_lat(struct request_queue *q, u64 nsec)
+{
+	struct rq_wb *rwb = q->rq_wb;
+
+	rwb->min_lat_nsec = nsec;
+	rwb->scale_step = 0;
+	rwb->scaled_max = false;
+	rwb_update_limits(rwb);
+	wake_up_all(&rwb->wait);
+}
+
+int wbt_init(struct request_queue *q)
+{
+	struct rq_wb *rwb;
+
+	if (q->rq_wb)
+		return 0;
+
+	rwb = kzalloc_node(sizeof(*rwb), GFP_KERNEL, q->node);
+	if (!rwb)
+		return -ENOMEM;
+
+	rwb->stat = alloc_percpu(struct wbt_stat);
+	if (!rwb->stat) {
+		kfree(rwb);
+		return -ENOMEM;
+	}
+
+	atomic_set(&rwb->inflight, 0);
+	init_waitqueue_head(&rwb->wait);
+	setup_timer(&rwb->window_timer, wb_timer_fn, (unsigned long) rwb);
+	rwb->q = q;
+	rwb->win_nsec = RWB_WINDOW_NSEC;
+	if (blk_queue_nonrot(q))
+		rwb->min_lat_nsec = RWB_NONROT_LAT_NSEC;
+	else
+		rwb->min_lat_nsec = RWB_ROT_LAT_NSEC;
+	rwb_update_limits(rwb);
+
+	q->rq_wb = rwb;
+	return 0;
+}
+
+void wbt_exit(struct request_queue *q)
+{
+	struct rq_wb *rwb = q->rq_wb;
+
+	if (!rwb)
+		return;
+
+	del_timer_sync(&rwb->window_timer);
+	free_percpu(rwb->stat);
+	kfree(rwb);
+	q->rq_wb = NULL;
+}
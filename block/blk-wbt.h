@@ -0,0 +1,90 @@
+#ifndef BLK_WBT_H
+#define BLK_WBT_H
+
+#include <linux/atomic.h>
+#include <linux/wait.h>
+#include <linux/timer.h>
+#include <linux/blkdev.h>
+
+#ifdef CONFIG_BLK_WBT
+
+struct wbt_stat {
+	u64 min_lat_nsec;		/* 0 if no read completed */
+	unsigned int nr_reads;
+};
+
+/*
+ * Per request_queue writeback throttling state.  Buffered writeback is
+ * limited to a number of requests in flight that gets scaled down while
+ * reads complete slower than min_lat_nsec, and back up once they don't.
+ */
+struct rq_wb {
+	/*
+	 * Current limits, derived from the queue depth and scale_step.
+	 */
+	unsigned int wb_background;	/* close to other IO */
+	unsigned int wb_normal;
+	unsigned int wb_max;		/* kswapd */
+	int scale_step;
+	bool scaled_max;
+
+	u64 min_lat_nsec;		/* target read latency, 0 is off */
+	u64 win_nsec;			/* default monitoring window */
+	u64 cur_win_nsec;		/* window shrinks as we scale down */
+
+	unsigned long last_comp;	/* jiffies of last untracked completion */
+
+	struct timer_list window_timer;
+	struct wbt_stat __percpu *stat;
+
+	struct request_queue *q;
+
+	atomic_t inflight;
+	wait_queue_head_t wait;
+};
+
+int wbt_init(struct request_queue *);
+void wbt_exit(struct request_queue *);
+bool wbt_wait(struct request_queue *, struct bio *, spinlock_t *);
+void __wbt_done(struct request_queue *);
+void wbt_done(struct request_queue *, struct request *);
+void wbt_issue(struct request_queue *, struct request *);
+void wbt_set_min_lat(struct request_queue *, u64);
+
+#else
+
+static inline int wbt_init(struct request_queue *q)
+{
+	return 0;
+}
+static inline void wbt_exit(struct request_queue *q)
+{
+}
+static inline bool wbt_wait(struct request_queue *q, struct bio *bio,
+			    spinlock_t *lock)
+{
+	return false;
+}
+static inline void __wbt_done(struct request_queue *q)
+{
+}
+static inline void wbt_done(struct request_queue *q, struct request *rq)
+{
+}
+static inline void wbt_issue(struct request_queue *q, struct request *rq)
+{
+}
+
+#endif /* CONFIG_BLK_WBT */
+
+/*
+ * Mark a request allocated after wbt_wait() returned true, wbt_done()
+ * then returns its slot when the request is freed.
+ */
+static inline void wbt_track(struct request *rq, bool tracked)
+{
+	if (tracked)
+		rq->cmd_flags |= REQ_WB_TRACKED;
+}
+
+#endif
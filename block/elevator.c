@@ -32,6 +32,7 @@
 #include <linux/init.h>
 #include <linux/compiler.h>
 #include <linux/blktrace_api.h>
+#include <linux/blk-mq.h>
 #include <linux/hash.h>
 #include <linux/uaccess.h>
 #include <linux/pm_runtime.h>
@@ -204,6 +205,10 @@ int elevator_init(struct request_queue *q, char *name)
 		e = elevator_get(name, true);
 		if (!e)
 			return -EINVAL;
+		if (e->uses_mq) {
+			elevator_put(e);
+			return -EINVAL;
+		}
 	}
 
 	/*
@@ -213,6 +218,10 @@ int elevator_init(struct request_queue *q, char *name)
 	 */
 	if (!e && *chosen_elevator) {
 		e = elevator_get(chosen_elevator, false);
+		if (e && e->uses_mq) {
+			elevator_put(e);
+			e = NULL;
+		}
 		if (!e)
 			printk(KERN_ERR "I/O scheduler %s not found\n",
 							chosen_elevator);
@@ -236,7 +245,10 @@ EXPORT_SYMBOL(elevator_init);
 void elevator_exit(struct elevator_queue *e)
 {
 	mutex_lock(&e->sysfs_lock);
-	if (e->type->ops.elevator_exit_fn)
+	if (e->type->uses_mq) {
+		if (e->type->mq_ops.exit_sched)
+			e->type->mq_ops.exit_sched(e);
+	} else if (e->type->ops.elevator_exit_fn)
 		e->type->ops.elevator_exit_fn(e);
 	mutex_unlock(&e->sysfs_lock);
 
@@ -944,6 +956,68 @@ fail_init:
 	return err;
 }
 
+/*
+ * blk-mq variant of elevator_switch(), new_e may be NULL to run the queue
+ * without a scheduler.  Freezing the queue empties the old scheduler; the
+ * dispatch side only looks at q->elevator under rcu_read_lock(), so one
+ * grace period after the pointer changes nobody can be inside it anymore.
+ */
+static int elevator_switch_mq(struct request_queue *q,
+			      struct elevator_type *new_e)
+{
+	struct elevator_queue *old = q->elevator;
+	struct elevator_queue *new;
+	bool registered = old ? old->registered : q->kobj.state_in_sysfs;
+	int err = 0;
+
+	blk_mq_freeze_queue(q);
+
+	if (old && registered)
+		elv_unregister_queue(q);
+
+	if (new_e) {
+		err = new_e->mq_ops.init_sched(q, new_e);
+		if (err)
+			goto fail_init;
+
+		if (registered) {
+			err = elv_register_queue(q);
+			if (err)
+				goto fail_register;
+		}
+	} else {
+		spin_lock_irq(q->queue_lock);
+		q->elevator = NULL;
+		spin_unlock_irq(q->queue_lock);
+	}
+
+	if (old) {
+		synchronize_rcu();
+		elevator_exit(old);
+	}
+	blk_mq_unfreeze_queue(q);
+
+	blk_add_trace_msg(q, "elv switch: %s",
+			  new_e ? new_e->elevator_name : "none");
+
+	return 0;
+
+fail_register:
+	new = q->elevator;
+	spin_lock_irq(q->queue_lock);
+	q->elevator = old;
+	spin_unlock_irq(q->queue_lock);
+	synchronize_rcu();
+	elevator_exit(new);
+fail_init:
+	/* switch failed, restore and re-register old elevator */
+	if (old && registered)
+		elv_register_queue(q);
+	blk_mq_unfreeze_queue(q);
+
+	return err;
+}
+
 /*
  * Switch this queue to the given IO scheduler.
  */
@@ -952,21 +1026,41 @@ static int __elevator_change(struct request_queue *q, const char *name)
 	char elevator_name[ELV_NAME_MAX];
 	struct elevator_type *e;
 
-	if (!q->elevator)
+	if (!q->elevator && !q->mq_ops)
 		return -ENXIO;
 
 	strlcpy(elevator_name, name, sizeof(elevator_name));
-	e = elevator_get(strstrip(elevator_name), true);
+	name = strstrip(elevator_name);
+
+	/* blk-mq queues can do without a scheduler */
+	if (q->mq_ops && !strcmp(name, "none")) {
+		if (!q->elevator)
+			return 0;
+		return elevator_switch_mq(q, NULL);
+	}
+
+	e = elevator_get(name, true);
 	if (!e) {
-		printk(KERN_ERR "elevator: type %s not found\n", elevator_name);
+		printk(KERN_ERR "elevator: type %s not found\n", name);
 		return -EINVAL;
 	}
 
-	if (!strcmp(elevator_name, q->elevator->type->elevator_name)) {
+	if (q->elevator &&
+	    !strcmp(name, q->elevator->type->elevator_name)) {
 		elevator_put(e);
 		return 0;
 	}
 
+	if (e->uses_mq != !!q->mq_ops) {
+		printk(KERN_ERR "elevator: type %s not usable on this queue\n",
+		       name);
+		elevator_put(e);
+		return -EINVAL;
+	}
+
+	if (q->mq_ops)
+		return elevator_switch_mq(q, e);
+
 	return elevator_switch(q, e);
 }
 
@@ -988,7 +1082,7 @@ ssize_t elv_iosched_store(struct request_queue *q, const char *name,
 {
 	int ret;
 
-	if (!q->elevator)
+	if (!q->elevator && !q->mq_ops)
 		return count;
 
 	ret = __elevator_change(q, name);
@@ -1002,18 +1096,23 @@ ssize_t elv_iosched_store(struct request_queue *q, const char *name,
 ssize_t elv_iosched_show(struct request_queue *q, char *name)
 {
 	struct elevator_queue *e = q->elevator;
-	struct elevator_type *elv;
+	struct elevator_type *elv = NULL;
 	struct elevator_type *__e;
 	int len = 0;
 
-	if (!q->elevator || !blk_queue_stackable(q))
+	if ((!e && !q->mq_ops) || !blk_queue_stackable(q))
 		return sprintf(name, "none\n");
 
-	elv = e->type;
+	if (e)
+		elv = e->type;
+	if (q->mq_ops)
+		len += sprintf(name+len, e ? "none " : "[none] ");
 
 	spin_lock(&elv_list_lock);
 	list_for_each_entry(__e, &elv_list, list) {
-		if (!strcmp(elv->elevator_name, __e->elevator_name))
+		if (__e->uses_mq != !!q->mq_ops)
+			continue;
+		if (elv && !strcmp(elv->elevator_name, __e->elevator_name))
 			len += sprintf(name+len, "[%s] ", elv->elevator_name);
 		else
 			len += sprintf(name+len, "%s ", __e->elevator_name);
@@ -976,6 +976,49 @@ static ssize_t disk_discard_alignment_show(struct device *dev,
 	return sprintf(buf, "%d\n", queue_discard_alignment(disk->queue));
 }
 
+/*
+ * One line per direction and request size, holding the number of requests
+ * completed in each latency bucket: the first counts those that took less
+ * than 16us, each following one twice the range of the one before, and
+ * the last everything from about 4s up.
+ */
+static ssize_t disk_latency_hist_show(struct device *dev,
+				      struct device_attribute *attr,
+				      char *buf)
+{
+	static const char *const dirs[BLK_LAT_HIST_DIRS] = {
+		"read", "write", "discard",
+	};
+	static const char *const sizes[BLK_LAT_HIST_SIZES] = {
+		"4k", "16k", "64k", "large",
+	};
+	struct gendisk *disk = dev_to_disk(dev);
+	struct blk_lat_hist *lat_hist = disk->queue->lat_hist;
+	ssize_t len = 0;
+	int dir, size, b, cpu;
+
+	for (dir = 0; dir < BLK_LAT_HIST_DIRS; dir++) {
+		for (size = 0; size < BLK_LAT_HIST_SIZES; size++) {
+			len += scnprintf(buf + len, PAGE_SIZE - len, "%s %s",
+					 dirs[dir], sizes[size]);
+
+			for (b = 0; b < BLK_LAT_HIST_BUCKETS; b++) {
+				unsigned long sum = 0;
+
+				for_each_possible_cpu(cpu)
+					sum += per_cpu_ptr(lat_hist, cpu)->
+						count[dir][size][b];
+				len += scnprintf(buf + len, PAGE_SIZE - len,
+						 " %lu", sum);
+			}
+
+			len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+		}
+	}
+
+	return len;
+}
+
 static DEVICE_ATTR(range, S_IRUGO, disk_range_show, NULL);
 static DEVICE_ATTR(ext_range, S_IRUGO, disk_ext_range_show, NULL);
 static DEVICE_ATTR(removable, S_IRUGO, disk_removable_show, NULL);
@@ -987,6 +1030,7 @@ static DEVICE_ATTR(discard_alignment, S_IRUGO, disk_discard_alignment_show,
 static DEVICE_ATTR(capability, S_IRUGO, disk_capability_show, NULL);
 static DEVICE_ATTR(stat, S_IRUGO, part_stat_show, NULL);
 static DEVICE_ATTR(inflight, S_IRUGO, part_inflight_show, NULL);
+static DEVICE_ATTR(latency_hist, S_IRUGO, disk_latency_hist_show, NULL);
 #ifdef CONFIG_FAIL_MAKE_REQUEST
 static struct device_attribute dev_attr_fail =
 	__ATTR(make-it-fail, S_IRUGO|S_IWUSR, part_fail_show, part_fail_store);
@@ -1008,6 +1052,7 @@ static struct attribute *disk_attrs[] = {
 	&dev_attr_capability.attr,
 	&dev_attr_stat.attr,
 	&dev_attr_inflight.attr,
+	&dev_attr_latency_hist.attr,
 #ifdef CONFIG_FAIL_MAKE_REQUEST
 	&dev_attr_fail.attr,
 #endif
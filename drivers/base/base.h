@@ -103,6 +103,8 @@ struct kobject *virtual_device_parent(struct device *dev);
 
 extern int bus_add_device(struct device *dev);
 extern void bus_probe_device(struct device *dev);
+extern void device_initial_probe(struct device *dev);
+extern bool driver_allows_async_probing(struct device_driver *drv);
 extern void bus_remove_device(struct device *dev);
 
 extern int bus_add_driver(struct device_driver *drv);
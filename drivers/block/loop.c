@@ -70,11 +70,11 @@
 #include <linux/writeback.h>
 #include <linux/completion.h>
 #include <linux/highmem.h>
-#include <linux/kthread.h>
 #include <linux/splice.h>
 #include <linux/sysfs.h>
 #include <linux/miscdevice.h>
 #include <linux/falloc.h>
+#include <linux/aio.h>
 #include "loop.h"
 
 #include <asm/uaccess.h>
@@ -85,6 +85,9 @@ static DEFINE_MUTEX(loop_index_mutex);
 static int max_part;
 static int part_shift;
 
+static int hw_queues = 1;
+static int hw_queue_depth = 128;
+
 /*
  * Transfer functions
  */
@@ -411,6 +414,52 @@ lo_receive(struct loop_device *lo, struct bio *bio, int bsize, loff_t pos)
 	return 0;
 }
 
+/*
+ * Direct I/O against the backing file: the bio's pages are handed to the
+ * backing filesystem as they are, without going through its page cache.
+ */
+static int lo_rw_dio(struct loop_device *lo, struct bio *bio, loff_t pos,
+		     int rw)
+{
+	struct file *file = lo->lo_dio_file;
+	size_t count = bio->bi_iter.bi_size;
+	struct iov_iter iter;
+	struct kiocb kiocb;
+	ssize_t ret;
+
+	iter.type = ITER_BVEC | rw;
+	iter.bvec = bio->bi_io_vec + bio->bi_iter.bi_idx;
+	iter.nr_segs = bio->bi_vcnt - bio->bi_iter.bi_idx;
+	iter.iov_offset = bio->bi_iter.bi_bvec_done;
+	iter.count = count;
+
+	init_sync_kiocb(&kiocb, file);
+	kiocb.ki_pos = pos;
+	kiocb.ki_nbytes = count;
+
+	if (rw == WRITE) {
+		file_start_write(file);
+		ret = file->f_op->write_iter(&kiocb, &iter);
+	} else {
+		ret = file->f_op->read_iter(&kiocb, &iter);
+	}
+	if (ret == -EIOCBQUEUED)
+		ret = wait_on_sync_kiocb(&kiocb);
+	if (rw == WRITE)
+		file_end_write(file);
+
+	if (ret < 0)
+		return ret;
+	if (ret == count)
+		return 0;
+	if (rw == WRITE)
+		return -EIO;
+
+	/* short read beyond the end of the backing file */
+	zero_fill_bio(bio);
+	return 0;
+}
+
 static int do_bio_filebacked(struct loop_device *lo, struct bio *bio)
 {
 	loff_t pos;
@@ -452,182 +501,196 @@ static int do_bio_filebacked(struct loop_device *lo, struct bio *bio)
 			goto out;
 		}
 
-		ret = lo_send(lo, bio, pos);
+		if (lo->lo_flags & LO_FLAGS_DIRECT_IO)
+			ret = lo_rw_dio(lo, bio, pos, WRITE);
+		else
+			ret = lo_send(lo, bio, pos);
 
 		if ((bio->bi_rw & REQ_FUA) && !ret) {
 			ret = vfs_fsync(file, 0);
 			if (unlikely(ret && ret != -EINVAL))
 				ret = -EIO;
 		}
-	} else
+	} else if (lo->lo_flags & LO_FLAGS_DIRECT_IO)
+		ret = lo_rw_dio(lo, bio, pos, READ);
+	else
 		ret = lo_receive(lo, bio, lo->lo_blocksize, pos);
 
 out:
 	return ret;
 }
 
-/*
- * Add bio to back of pending list
- */
-static void loop_add_bio(struct loop_device *lo, struct bio *bio)
+static int loop_end_request(struct request *rq)
+{
+	struct loop_device *lo = rq->q->queuedata;
+	struct bio *bio;
+	int ret = 0;
+
+	if (rq_data_dir(rq) == WRITE && (lo->lo_flags & LO_FLAGS_READ_ONLY))
+		return -EIO;
+
+	/* flush requests from the flush state machine carry no data */
+	if (!rq->bio && (rq->cmd_flags & REQ_FLUSH)) {
+		ret = vfs_fsync(lo->lo_backing_file, 0);
+		if (unlikely(ret && ret != -EINVAL))
+			ret = -EIO;
+		return ret;
+	}
+
+	__rq_for_each_bio(bio, rq) {
+		ret = do_bio_filebacked(lo, bio);
+		if (ret)
+			break;
+	}
+	return ret;
+}
+
+static void loop_handle_cmd(struct loop_cmd *cmd)
 {
-	lo->lo_bio_count++;
-	bio_list_add(&lo->lo_bio_list, bio);
+	blk_mq_end_io(cmd->rq, loop_end_request(cmd->rq));
 }
 
 /*
- * Grab first pending buffer
+ * Workers that handle reads/writes to file backed loop devices, to avoid
+ * blocking in ->queue_rq.  They also do loop decrypting on reads for block
+ * backed loop, as that is too heavy to do from b_end_io context where irqs
+ * may be disabled.
  */
-static struct bio *loop_get_bio(struct loop_device *lo)
+static void loop_queue_read_work(struct work_struct *work)
 {
-	lo->lo_bio_count--;
-	return bio_list_pop(&lo->lo_bio_list);
+	loop_handle_cmd(container_of(work, struct loop_cmd, read_work));
 }
 
-static void loop_make_request(struct request_queue *q, struct bio *old_bio)
+static void loop_queue_write_work(struct work_struct *work)
 {
-	struct loop_device *lo = q->queuedata;
-	int rw = bio_rw(old_bio);
+	struct loop_hw_queue *lhq =
+		container_of(work, struct loop_hw_queue, write_work);
+	LIST_HEAD(cmd_list);
 
-	if (rw == READA)
-		rw = READ;
+	spin_lock_irq(&lhq->lock);
+ repeat:
+	list_splice_init(&lhq->write_list, &cmd_list);
+	spin_unlock_irq(&lhq->lock);
 
-	BUG_ON(!lo || (rw != READ && rw != WRITE));
+	while (!list_empty(&cmd_list)) {
+		struct loop_cmd *cmd = list_first_entry(&cmd_list,
+				struct loop_cmd, list);
 
-	spin_lock_irq(&lo->lo_lock);
-	if (lo->lo_state != Lo_bound)
-		goto out;
-	if (unlikely(rw == WRITE && (lo->lo_flags & LO_FLAGS_READ_ONLY)))
-		goto out;
-	if (lo->lo_bio_count >= q->nr_congestion_on)
-		wait_event_lock_irq(lo->lo_req_wait,
-				    lo->lo_bio_count < q->nr_congestion_off,
-				    lo->lo_lock);
-	loop_add_bio(lo, old_bio);
-	wake_up(&lo->lo_event);
-	spin_unlock_irq(&lo->lo_lock);
-	return;
+		list_del_init(&cmd->list);
+		loop_handle_cmd(cmd);
+	}
 
-out:
-	spin_unlock_irq(&lo->lo_lock);
-	bio_io_error(old_bio);
+	spin_lock_irq(&lhq->lock);
+	if (!list_empty(&lhq->write_list))
+		goto repeat;
+	spin_unlock_irq(&lhq->lock);
 }
 
-struct switch_request {
-	struct file *file;
-	struct completion wait;
-};
+static int loop_queue_rq(struct blk_mq_hw_ctx *hctx, struct request *rq)
+{
+	struct loop_cmd *cmd = blk_mq_rq_to_pdu(rq);
+	struct loop_hw_queue *lhq = hctx->driver_data;
+	struct loop_device *lo = lhq->lo;
+	unsigned long flags;
+	bool need_sched;
 
-static void do_loop_switch(struct loop_device *, struct switch_request *);
+	if (lo->lo_state != Lo_bound)
+		return BLK_MQ_RQ_QUEUE_ERROR;
 
-static inline void loop_handle_bio(struct loop_device *lo, struct bio *bio)
-{
-	if (unlikely(!bio->bi_bdev)) {
-		do_loop_switch(lo, bio->bi_private);
-		bio_put(bio);
-	} else {
-		int ret = do_bio_filebacked(lo, bio);
-		bio_endio(bio, ret);
+	if (rq_data_dir(rq) == READ) {
+		queue_work(lo->wq, &cmd->read_work);
+		return BLK_MQ_RQ_QUEUE_OK;
 	}
+
+	spin_lock_irqsave(&lhq->lock, flags);
+	need_sched = list_empty(&lhq->write_list);
+	list_add_tail(&cmd->list, &lhq->write_list);
+	spin_unlock_irqrestore(&lhq->lock, flags);
+
+	if (need_sched)
+		queue_work(lo->wq, &lhq->write_work);
+
+	return BLK_MQ_RQ_QUEUE_OK;
 }
 
-/*
- * worker thread that handles reads/writes to file backed loop devices,
- * to avoid blocking in our make_request_fn. it also does loop decrypting
- * on reads for block backed loop, as that is too heavy to do from
- * b_end_io context where irqs may be disabled.
- *
- * Loop explanation:  loop_clr_fd() sets lo_state to Lo_rundown before
- * calling kthread_stop().  Therefore once kthread_should_stop() is
- * true, make_request will not place any more requests.  Therefore
- * once kthread_should_stop() is true and lo_bio is NULL, we are
- * done with the loop.
- */
-static int loop_thread(void *data)
+static int loop_init_hctx(struct blk_mq_hw_ctx *hctx, void *data,
+			  unsigned int index)
 {
 	struct loop_device *lo = data;
-	struct bio *bio;
+	struct loop_hw_queue *lhq = &lo->hw_queues[index];
 
-	set_user_nice(current, MIN_NICE);
+	lhq->lo = lo;
+	spin_lock_init(&lhq->lock);
+	INIT_LIST_HEAD(&lhq->write_list);
+	INIT_WORK(&lhq->write_work, loop_queue_write_work);
 
-	while (!kthread_should_stop() || !bio_list_empty(&lo->lo_bio_list)) {
-
-		wait_event_interruptible(lo->lo_event,
-				!bio_list_empty(&lo->lo_bio_list) ||
-				kthread_should_stop());
+	hctx->driver_data = lhq;
+	return 0;
+}
 
-		if (bio_list_empty(&lo->lo_bio_list))
-			continue;
-		spin_lock_irq(&lo->lo_lock);
-		bio = loop_get_bio(lo);
-		if (lo->lo_bio_count < lo->lo_queue->nr_congestion_off)
-			wake_up(&lo->lo_req_wait);
-		spin_unlock_irq(&lo->lo_lock);
+static int loop_init_request(void *data, struct request *rq,
+		unsigned int hctx_idx, unsigned int request_idx,
+		unsigned int numa_node)
+{
+	struct loop_cmd *cmd = blk_mq_rq_to_pdu(rq);
 
-		BUG_ON(!bio);
-		loop_handle_bio(lo, bio);
-	}
+	cmd->rq = rq;
+	INIT_LIST_HEAD(&cmd->list);
+	INIT_WORK(&cmd->read_work, loop_queue_read_work);
 
 	return 0;
 }
 
+static struct blk_mq_ops loop_mq_ops = {
+	.queue_rq	= loop_queue_rq,
+	.map_queue	= blk_mq_map_queue,
+	.init_hctx	= loop_init_hctx,
+	.init_request	= loop_init_request,
+};
+
+/*
+ * Do the actual switch of the backing store; the queue is frozen, so
+ * no I/O is in flight.
+ */
+static void do_loop_switch(struct loop_device *lo, struct file *file)
+{
+	struct file *old_file = lo->lo_backing_file;
+	struct address_space *mapping = file->f_mapping;
+
+	mapping_set_gfp_mask(old_file->f_mapping, lo->old_gfp_mask);
+	lo->lo_backing_file = file;
+	lo->lo_blocksize = S_ISBLK(mapping->host->i_mode) ?
+		mapping->host->i_bdev->bd_block_size : PAGE_SIZE;
+	lo->old_gfp_mask = mapping_gfp_mask(mapping);
+	mapping_set_gfp_mask(mapping, lo->old_gfp_mask & ~(__GFP_IO|__GFP_FS));
+}
+
 /*
  * loop_switch performs the hard work of switching a backing store.
- * First it needs to flush existing IO, it does this by sending a magic
- * BIO down the pipe. The completion of this BIO does the actual switch.
+ * It waits for all in-flight I/O by freezing the queue, switches and
+ * lets I/O resume.  A NULL file just flushes the queued I/O.
  */
 static int loop_switch(struct loop_device *lo, struct file *file)
 {
-	struct switch_request w;
-	struct bio *bio = bio_alloc(GFP_KERNEL, 0);
-	if (!bio)
-		return -ENOMEM;
-	init_completion(&w.wait);
-	w.file = file;
-	bio->bi_private = &w;
-	bio->bi_bdev = NULL;
-	loop_make_request(lo->lo_queue, bio);
-	wait_for_completion(&w.wait);
+	blk_mq_freeze_queue(lo->lo_queue);
+	if (file)
+		do_loop_switch(lo, file);
+	blk_mq_unfreeze_queue(lo->lo_queue);
 	return 0;
 }
 
 /*
- * Helper to flush the IOs in loop, but keeping loop thread running
+ * Helper to flush the IOs in loop, but keeping the loop workers around
  */
 static int loop_flush(struct loop_device *lo)
 {
-	/* loop not yet configured, no running thread, nothing to flush */
-	if (!lo->lo_thread)
+	/* loop not yet configured, no workers, nothing to flush */
+	if (lo->lo_state != Lo_bound)
 		return 0;
 
 	return loop_switch(lo, NULL);
 }
 
-/*
- * Do the actual switch; called from the BIO completion routine
- */
-static void do_loop_switch(struct loop_device *lo, struct switch_request *p)
-{
-	struct file *file = p->file;
-	struct file *old_file = lo->lo_backing_file;
-	struct address_space *mapping;
-
-	/* if no new file, only flush of queued bios requested */
-	if (!file)
-		goto out;
-
-	mapping = file->f_mapping;
-	mapping_set_gfp_mask(old_file->f_mapping, lo->old_gfp_mask);
-	lo->lo_backing_file = file;
-	lo->lo_blocksize = S_ISBLK(mapping->host->i_mode) ?
-		mapping->host->i_bdev->bd_block_size : PAGE_SIZE;
-	lo->old_gfp_mask = mapping_gfp_mask(mapping);
-	mapping_set_gfp_mask(mapping, lo->old_gfp_mask & ~(__GFP_IO|__GFP_FS));
-out:
-	complete(&p->wait);
-}
-
-
 /*
  * loop_change_fd switched the backing store of a loopback device to
  * a new file. This is useful for operating system installers to free up
@@ -889,12 +952,9 @@ static int loop_set_fd(struct loop_device *lo, fmode_t mode,
 	lo->transfer = transfer_none;
 	lo->ioctl = NULL;
 	lo->lo_sizelimit = 0;
-	lo->lo_bio_count = 0;
 	lo->old_gfp_mask = mapping_gfp_mask(mapping);
 	mapping_set_gfp_mask(mapping, lo->old_gfp_mask & ~(__GFP_IO|__GFP_FS));
 
-	bio_list_init(&lo->lo_bio_list);
-
 	if (!(lo_flags & LO_FLAGS_READ_ONLY) && file->f_op->fsync)
 		blk_queue_flush(lo->lo_queue, REQ_FLUSH);
 
@@ -906,14 +966,14 @@ static int loop_set_fd(struct loop_device *lo, fmode_t mode,
 
 	set_blocksize(bdev, lo_blocksize);
 
-	lo->lo_thread = kthread_create(loop_thread, lo, "loop%d",
-						lo->lo_number);
-	if (IS_ERR(lo->lo_thread)) {
-		error = PTR_ERR(lo->lo_thread);
+	lo->wq = alloc_workqueue("kloopd%d",
+			WQ_MEM_RECLAIM | WQ_HIGHPRI | WQ_UNBOUND, 0,
+			lo->lo_number);
+	if (!lo->wq) {
+		error = -ENOMEM;
 		goto out_clr;
 	}
 	lo->lo_state = Lo_bound;
-	wake_up_process(lo->lo_thread);
 	if (part_shift)
 		lo->lo_flags |= LO_FLAGS_PARTSCAN;
 	if (lo->lo_flags & LO_FLAGS_PARTSCAN)
@@ -927,7 +987,6 @@ static int loop_set_fd(struct loop_device *lo, fmode_t mode,
 
 out_clr:
 	loop_sysfs_exit(lo);
-	lo->lo_thread = NULL;
 	lo->lo_device = NULL;
 	lo->lo_backing_file = NULL;
 	lo->lo_flags = 0;
@@ -1010,16 +1069,29 @@ static int loop_clr_fd(struct loop_device *lo)
 	if (filp == NULL)
 		return -EINVAL;
 
+	/*
+	 * Wait for in-flight I/O.  Submitters that are held off by the
+	 * freeze will see Lo_rundown/Lo_unbound and fail their requests.
+	 */
+	blk_mq_freeze_queue(lo->lo_queue);
+
 	spin_lock_irq(&lo->lo_lock);
 	lo->lo_state = Lo_rundown;
 	spin_unlock_irq(&lo->lo_lock);
 
-	kthread_stop(lo->lo_thread);
+	destroy_workqueue(lo->wq);
+	lo->wq = NULL;
 
 	spin_lock_irq(&lo->lo_lock);
 	lo->lo_backing_file = NULL;
 	spin_unlock_irq(&lo->lo_lock);
 
+	if (lo->lo_dio_file) {
+		fput(lo->lo_dio_file);
+		lo->lo_dio_file = NULL;
+	}
+	blk_queue_logical_block_size(lo->lo_queue, 512);
+
 	loop_release_xfer(lo);
 	lo->transfer = NULL;
 	lo->ioctl = NULL;
@@ -1028,7 +1100,6 @@ static int loop_clr_fd(struct loop_device *lo)
 	lo->lo_offset = 0;
 	lo->lo_sizelimit = 0;
 	lo->lo_encrypt_key_size = 0;
-	lo->lo_thread = NULL;
 	memset(lo->lo_encrypt_key, 0, LO_KEY_SIZE);
 	memset(lo->lo_crypt_name, 0, LO_NAME_SIZE);
 	memset(lo->lo_file_name, 0, LO_NAME_SIZE);
@@ -1045,6 +1116,7 @@ static int loop_clr_fd(struct loop_device *lo)
 	}
 	mapping_set_gfp_mask(filp->f_mapping, gfp);
 	lo->lo_state = Lo_unbound;
+	blk_mq_unfreeze_queue(lo->lo_queue);
 	/* This is safe: open() is still holding a reference. */
 	module_put(THIS_MODULE);
 	if (lo->lo_flags & LO_FLAGS_PARTSCAN && bdev)
@@ -1078,6 +1150,11 @@ loop_set_status(struct loop_device *lo, const struct loop_info64 *info)
 		return -ENXIO;
 	if ((unsigned int) info->lo_encrypt_key_size > LO_KEY_SIZE)
 		return -EINVAL;
+	/* direct I/O bypasses the transfer functions and needs alignment */
+	if ((lo->lo_flags & LO_FLAGS_DIRECT_IO) &&
+	    (info->lo_encrypt_type ||
+	     (info->lo_offset & (queue_logical_block_size(lo->lo_queue) - 1))))
+		return -EINVAL;
 
 	err = loop_release_xfer(lo);
 	if (err)
@@ -1285,6 +1362,62 @@ static int loop_set_capacity(struct loop_device *lo, struct block_device *bdev)
 	return figure_loop_size(lo, lo->lo_offset, lo->lo_sizelimit);
 }
 
+/*
+ * Switch between buffered and direct I/O to the backing file.  Direct
+ * I/O needs a filesystem that supports it, no transfer function, and a
+ * device offset aligned to the backing store's logical block size, which
+ * the loop device then also advertises so all I/O stays aligned.
+ */
+static int loop_set_direct_io(struct loop_device *lo, unsigned long arg)
+{
+	struct file *file = lo->lo_backing_file;
+	struct file *dio_file = NULL, *old_file;
+	struct inode *inode;
+	unsigned short bsize = 512;
+
+	if (lo->lo_state != Lo_bound)
+		return -ENXIO;
+
+	if (!!arg == !!(lo->lo_flags & LO_FLAGS_DIRECT_IO))
+		return 0;
+
+	if (arg) {
+		inode = file->f_mapping->host;
+		if (lo->transfer != transfer_none ||
+		    !file->f_mapping->a_ops->direct_IO ||
+		    !file->f_op->read_iter || !file->f_op->write_iter)
+			return -EINVAL;
+
+		if (S_ISBLK(inode->i_mode))
+			bsize = bdev_logical_block_size(inode->i_bdev);
+		else if (inode->i_sb->s_bdev)
+			bsize = bdev_logical_block_size(inode->i_sb->s_bdev);
+		if (lo->lo_offset & (bsize - 1))
+			return -EINVAL;
+
+		dio_file = dentry_open(&file->f_path, file->f_flags | O_DIRECT,
+				       file->f_cred);
+		if (IS_ERR(dio_file))
+			return PTR_ERR(dio_file);
+	}
+
+	blk_mq_freeze_queue(lo->lo_queue);
+	old_file = lo->lo_dio_file;
+	lo->lo_dio_file = dio_file;
+	if (dio_file) {
+		lo->lo_flags |= LO_FLAGS_DIRECT_IO;
+		blk_queue_logical_block_size(lo->lo_queue, bsize);
+	} else {
+		lo->lo_flags &= ~LO_FLAGS_DIRECT_IO;
+		blk_queue_logical_block_size(lo->lo_queue, 512);
+	}
+	blk_mq_unfreeze_queue(lo->lo_queue);
+
+	if (old_file)
+		fput(old_file);
+	return 0;
+}
+
 static int lo_ioctl(struct block_device *bdev, fmode_t mode,
 	unsigned int cmd, unsigned long arg)
 {
@@ -1328,6 +1461,11 @@ static int lo_ioctl(struct block_device *bdev, fmode_t mode,
 		if ((mode & FMODE_WRITE) || capable(CAP_SYS_ADMIN))
 			err = loop_set_capacity(lo, bdev);
 		break;
+	case LOOP_SET_DIRECT_IO:
+		err = -EPERM;
+		if ((mode & FMODE_WRITE) || capable(CAP_SYS_ADMIN))
+			err = loop_set_direct_io(lo, arg);
+		break;
 	default:
 		err = lo->ioctl ? lo->ioctl(lo, cmd, arg) : -EINVAL;
 	}
@@ -1560,6 +1698,10 @@ module_param(max_loop, int, S_IRUGO);
 MODULE_PARM_DESC(max_loop, "Maximum number of loop devices");
 module_param(max_part, int, S_IRUGO);
 MODULE_PARM_DESC(max_part, "Maximum number of partitions per loop device");
+module_param(hw_queues, int, S_IRUGO);
+MODULE_PARM_DESC(hw_queues, "Number of hardware queues per loop device. Default: 1");
+module_param(hw_queue_depth, int, S_IRUGO);
+MODULE_PARM_DESC(hw_queue_depth, "Queue depth for each hardware queue. Default: 128");
 MODULE_LICENSE("GPL");
 MODULE_ALIAS_BLOCKDEV_MAJOR(LOOP_MAJOR);
 
@@ -1627,14 +1769,27 @@ static int loop_add(struct loop_device **l, int i)
 	i = err;
 
 	err = -ENOMEM;
-	lo->lo_queue = blk_alloc_queue(GFP_KERNEL);
-	if (!lo->lo_queue)
+	lo->hw_queues = kcalloc(hw_queues, sizeof(*lo->hw_queues), GFP_KERNEL);
+	if (!lo->hw_queues)
 		goto out_free_idr;
 
-	/*
-	 * set queue make_request_fn
-	 */
-	blk_queue_make_request(lo->lo_queue, loop_make_request);
+	lo->tag_set.ops = &loop_mq_ops;
+	lo->tag_set.nr_hw_queues = hw_queues;
+	lo->tag_set.queue_depth = hw_queue_depth;
+	lo->tag_set.numa_node = NUMA_NO_NODE;
+	lo->tag_set.cmd_size = sizeof(struct loop_cmd);
+	lo->tag_set.flags = BLK_MQ_F_SHOULD_MERGE | BLK_MQ_F_SG_MERGE;
+	lo->tag_set.driver_data = lo;
+
+	err = blk_mq_alloc_tag_set(&lo->tag_set);
+	if (err)
+		goto out_free_hw_queues;
+
+	err = -ENOMEM;
+	lo->lo_queue = blk_mq_init_queue(&lo->tag_set);
+	if (!lo->lo_queue)
+		goto out_cleanup_tags;
+
 	lo->lo_queue->queuedata = lo;
 
 	disk = lo->lo_disk = alloc_disk(1 << part_shift);
@@ -1664,9 +1819,6 @@ static int loop_add(struct loop_device **l, int i)
 	disk->flags |= GENHD_FL_EXT_DEVT;
 	mutex_init(&lo->lo_ctl_mutex);
 	lo->lo_number		= i;
-	lo->lo_thread		= NULL;
-	init_waitqueue_head(&lo->lo_event);
-	init_waitqueue_head(&lo->lo_req_wait);
 	spin_lock_init(&lo->lo_lock);
 	disk->major		= LOOP_MAJOR;
 	disk->first_minor	= i << part_shift;
@@ -1680,6 +1832,10 @@ static int loop_add(struct loop_device **l, int i)
 
 out_free_queue:
 	blk_cleanup_queue(lo->lo_queue);
+out_cleanup_tags:
+	blk_mq_free_tag_set(&lo->tag_set);
+out_free_hw_queues:
+	kfree(lo->hw_queues);
 out_free_idr:
 	idr_remove(&loop_index_idr, i);
 out_free_dev:
@@ -1692,7 +1848,9 @@ static void loop_remove(struct loop_device *lo)
 {
 	del_gendisk(lo->lo_disk);
 	blk_cleanup_queue(lo->lo_queue);
+	blk_mq_free_tag_set(&lo->tag_set);
 	put_disk(lo->lo_disk);
+	kfree(lo->hw_queues);
 	kfree(lo);
 }
 
@@ -1854,6 +2012,12 @@ static int __init loop_init(void)
 		goto misc_out;
 	}
 
+	if (hw_queues < 1 || hw_queues > nr_cpu_ids ||
+	    hw_queue_depth < 1 || hw_queue_depth > BLK_MQ_MAX_DEPTH) {
+		err = -EINVAL;
+		goto misc_out;
+	}
+
 	/*
 	 * If max_loop is specified, create that many devices upfront.
 	 * This also becomes a hard limit. If max_loop is not specified,
@@ -11,8 +11,10 @@
 
 #include <linux/bio.h>
 #include <linux/blkdev.h>
+#include <linux/blk-mq.h>
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
+#include <linux/workqueue.h>
 #include <uapi/linux/loop.h>
 
 /* Possible states of device */
@@ -45,6 +47,7 @@ struct loop_device {
 				 unsigned long arg); 
 
 	struct file *	lo_backing_file;
+	struct file *	lo_dio_file;	/* O_DIRECT twin of lo_backing_file */
 	struct block_device *lo_device;
 	unsigned	lo_blocksize;
 	void		*key_data; 
@@ -52,19 +55,35 @@ struct loop_device {
 	gfp_t		old_gfp_mask;
 
 	spinlock_t		lo_lock;
-	struct bio_list		lo_bio_list;
-	unsigned int		lo_bio_count;
 	int			lo_state;
 	struct mutex		lo_ctl_mutex;
-	struct task_struct	*lo_thread;
-	wait_queue_head_t	lo_event;
-	/* wait queue for incoming requests */
-	wait_queue_head_t	lo_req_wait;
+	struct workqueue_struct	*wq;
 
 	struct request_queue	*lo_queue;
+	struct blk_mq_tag_set	tag_set;
+	struct loop_hw_queue	*hw_queues;
 	struct gendisk		*lo_disk;
 };
 
+/*
+ * Per hardware context state.  Reads are handed to the workqueue one
+ * request at a time so they can run in parallel, writes are queued on
+ * write_list and processed in order by a single write_work, as they would
+ * only serialize on the backing file's i_mutex anyway.
+ */
+struct loop_hw_queue {
+	struct loop_device	*lo;
+	spinlock_t		lock;
+	struct list_head	write_list;
+	struct work_struct	write_work;
+};
+
+struct loop_cmd {
+	struct work_struct	read_work;
+	struct request		*rq;
+	struct list_head	list;
+};
+
 /* Support for loadable transfer modules */
 struct loop_func_table {
 	int number;	/* filter type */ 
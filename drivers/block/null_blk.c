@@ -8,6 +8,9 @@
 #include <linux/slab.h>
 #include <linux/blk-mq.h>
 #include <linux/hrtimer.h>
+#include <linux/highmem.h>
+#include <linux/radix-tree.h>
+#include <linux/random.h>
 
 struct nullb_cmd {
 	struct list_head list;
@@ -17,6 +20,8 @@ struct nullb_cmd {
 	struct bio *bio;
 	unsigned int tag;
 	struct nullb_queue *nq;
+	struct hrtimer timer;
+	int error;
 };
 
 struct nullb_queue {
@@ -39,6 +44,10 @@ struct nullb {
 
 	struct nullb_queue *queues;
 	unsigned int nr_queues;
+
+	/* backing store for memory_backed, indexed by page offset */
+	struct radix_tree_root pages;
+	spinlock_t pages_lock;
 };
 
 static LIST_HEAD(nullb_list);
@@ -101,6 +110,22 @@ static int completion_nsec = 10000;
 module_param(completion_nsec, int, S_IRUGO);
 MODULE_PARM_DESC(completion_nsec, "Time in ns to complete a request in hardware. Default: 10,000ns");
 
+static int completion_jitter_nsec;
+module_param(completion_jitter_nsec, int, S_IRUGO);
+MODULE_PARM_DESC(completion_jitter_nsec, "Spread timer completions uniformly over completion_nsec +/- this many ns. Default: 0");
+
+static int completion_tail_nsec = 1000000;
+module_param(completion_tail_nsec, int, S_IRUGO);
+MODULE_PARM_DESC(completion_tail_nsec, "Time in ns to complete a tail request. Default: 1,000,000ns");
+
+static int completion_tail_permille;
+module_param(completion_tail_permille, int, S_IRUGO);
+MODULE_PARM_DESC(completion_tail_permille, "Timer completions per 1000 that take completion_tail_nsec. Default: 0");
+
+static bool memory_backed;
+module_param(memory_backed, bool, S_IRUGO);
+MODULE_PARM_DESC(memory_backed, "Keep written data in memory and return it on reads. Default: false");
+
 static int hw_queue_depth = 64;
 module_param(hw_queue_depth, int, S_IRUGO);
 MODULE_PARM_DESC(hw_queue_depth, "Queue depth for each hardware queue. Default: 64");
@@ -177,14 +202,14 @@ static void end_cmd(struct nullb_cmd *cmd)
 {
 	switch (queue_mode)  {
 	case NULL_Q_MQ:
-		blk_mq_end_io(cmd->rq, 0);
+		blk_mq_end_io(cmd->rq, cmd->error);
 		return;
 	case NULL_Q_RQ:
 		INIT_LIST_HEAD(&cmd->rq->queuelist);
-		blk_end_request_all(cmd->rq, 0);
+		blk_end_request_all(cmd->rq, cmd->error);
 		break;
 	case NULL_Q_BIO:
-		bio_endio(cmd->bio, 0);
+		bio_endio(cmd->bio, cmd->error);
 		break;
 	}
 
@@ -225,6 +250,76 @@ static void null_cmd_end_timer(struct nullb_cmd *cmd)
 	put_cpu();
 }
 
+static bool null_delay_varies(void)
+{
+	return completion_jitter_nsec || completion_tail_permille;
+}
+
+/* Pick a completion time for one command of a latency distribution */
+static u64 null_cmd_delay(void)
+{
+	s64 nsec = completion_nsec;
+
+	if (completion_tail_permille &&
+	    prandom_u32_max(1000) < completion_tail_permille)
+		return completion_tail_nsec;
+
+	if (completion_jitter_nsec) {
+		nsec += prandom_u32_max(2 * completion_jitter_nsec + 1);
+		nsec -= completion_jitter_nsec;
+	}
+
+	return nsec > 0 ? nsec : 0;
+}
+
+static enum hrtimer_restart null_cmd_delay_expired(struct hrtimer *timer)
+{
+	end_cmd(container_of(timer, struct nullb_cmd, timer));
+
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * With a latency distribution, each command completes on its own timer;
+ * the per-cpu completion queue can only complete everything at once.
+ */
+static void null_cmd_end_delayed(struct nullb_cmd *cmd)
+{
+	hrtimer_init(&cmd->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	cmd->timer.function = null_cmd_delay_expired;
+	hrtimer_start(&cmd->timer, ns_to_ktime(null_cmd_delay()),
+		      HRTIMER_MODE_REL);
+}
+
+/*
+ * REQ_HIPRI commands are completed through the timer completion queue,
+ * which stands in for the hardware completion queue here: polling reaps
+ * it directly rather than waiting for the hrtimer to fire.
+ */
+static int null_poll(struct blk_mq_hw_ctx *hctx)
+{
+	struct completion_queue *cq;
+	struct llist_node *entry;
+	struct nullb_cmd *cmd;
+	int found = 0;
+
+	cq = &per_cpu(completion_queues, get_cpu());
+
+	entry = llist_del_all(&cq->list);
+	if (entry) {
+		entry = llist_reverse_order(entry);
+		do {
+			cmd = container_of(entry, struct nullb_cmd, ll_list);
+			entry = entry->next;
+			end_cmd(cmd);
+			found++;
+		} while (entry);
+	}
+
+	put_cpu();
+	return found;
+}
+
 static void null_softirq_done_fn(struct request *rq)
 {
 	if (queue_mode == NULL_Q_MQ)
@@ -257,11 +352,136 @@ static inline void null_handle_cmd(struct nullb_cmd *cmd)
 		end_cmd(cmd);
 		break;
 	case NULL_IRQ_TIMER:
-		null_cmd_end_timer(cmd);
+		if (null_delay_varies())
+			null_cmd_end_delayed(cmd);
+		else
+			null_cmd_end_timer(cmd);
 		break;
 	}
 }
 
+static struct page *null_lookup_page(struct nullb *nullb, pgoff_t idx,
+				     bool alloc)
+{
+	struct page *page, *new;
+	unsigned long flags;
+
+	spin_lock_irqsave(&nullb->pages_lock, flags);
+	page = radix_tree_lookup(&nullb->pages, idx);
+	spin_unlock_irqrestore(&nullb->pages_lock, flags);
+
+	if (page || !alloc)
+		return page;
+
+	new = alloc_page(GFP_ATOMIC | __GFP_ZERO | __GFP_NOWARN);
+	if (!new)
+		return NULL;
+
+	new->index = idx;
+
+	spin_lock_irqsave(&nullb->pages_lock, flags);
+	if (radix_tree_insert(&nullb->pages, idx, new)) {
+		/* lost a race with another writer, or out of memory */
+		page = radix_tree_lookup(&nullb->pages, idx);
+		__free_page(new);
+	} else
+		page = new;
+	spin_unlock_irqrestore(&nullb->pages_lock, flags);
+
+	return page;
+}
+
+/*
+ * Copy one segment to or from the backing store.  Sectors that were
+ * never written read back as zeroes.
+ */
+static int null_transfer(struct nullb *nullb, struct page *page,
+			 unsigned int len, unsigned int off, bool is_write,
+			 sector_t sector)
+{
+	while (len) {
+		unsigned int pg_off = (sector << 9) & ~PAGE_MASK;
+		unsigned int chunk = min_t(unsigned int, len, PAGE_SIZE - pg_off);
+		struct page *t_page;
+		void *src, *dst;
+
+		t_page = null_lookup_page(nullb, sector >> (PAGE_SHIFT - 9),
+					  is_write);
+		dst = kmap_atomic(page);
+		if (is_write) {
+			if (!t_page) {
+				kunmap_atomic(dst);
+				return -ENOMEM;
+			}
+			src = kmap_atomic(t_page);
+			memcpy(src + pg_off, dst + off, chunk);
+			kunmap_atomic(src);
+		} else if (t_page) {
+			src = kmap_atomic(t_page);
+			memcpy(dst + off, src + pg_off, chunk);
+			kunmap_atomic(src);
+		} else
+			memset(dst + off, 0, chunk);
+		kunmap_atomic(dst);
+
+		len -= chunk;
+		off += chunk;
+		sector += chunk >> 9;
+	}
+
+	return 0;
+}
+
+static int null_transfer_bio(struct nullb *nullb, struct bio *bio)
+{
+	sector_t sector = bio->bi_iter.bi_sector;
+	bool is_write = bio_data_dir(bio) == WRITE;
+	struct bvec_iter iter;
+	struct bio_vec bvec;
+	int ret;
+
+	bio_for_each_segment(bvec, bio, iter) {
+		ret = null_transfer(nullb, bvec.bv_page, bvec.bv_len,
+				    bvec.bv_offset, is_write, sector);
+		if (ret)
+			return ret;
+		sector += bvec.bv_len >> 9;
+	}
+
+	return 0;
+}
+
+static int null_transfer_rq(struct nullb *nullb, struct request *rq)
+{
+	struct bio *bio;
+	int ret;
+
+	__rq_for_each_bio(bio, rq) {
+		ret = null_transfer_bio(nullb, bio);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static void null_free_pages(struct nullb *nullb)
+{
+	struct page *pages[16];
+	pgoff_t idx = 0;
+	int i, nr;
+
+	while ((nr = radix_tree_gang_lookup(&nullb->pages, (void **)pages,
+					    idx, ARRAY_SIZE(pages)))) {
+		for (i = 0; i < nr; i++) {
+			idx = pages[i]->index;
+			radix_tree_delete(&nullb->pages, idx);
+			__free_page(pages[i]);
+		}
+		idx++;
+	}
+}
+
 static struct nullb_queue *nullb_to_queue(struct nullb *nullb)
 {
 	int index = 0;
@@ -280,6 +500,7 @@ static void null_queue_bio(struct request_queue *q, struct bio *bio)
 
 	cmd = alloc_cmd(nq, 1);
 	cmd->bio = bio;
+	cmd->error = memory_backed ? null_transfer_bio(nullb, bio) : 0;
 
 	null_handle_cmd(cmd);
 }
@@ -308,6 +529,8 @@ static void null_request_fn(struct request_queue *q)
 		struct nullb_cmd *cmd = rq->special;
 
 		spin_unlock_irq(q->queue_lock);
+		cmd->error = memory_backed ?
+			null_transfer_rq(q->queuedata, rq) : 0;
 		null_handle_cmd(cmd);
 		spin_lock_irq(q->queue_lock);
 	}
@@ -319,8 +542,12 @@ static int null_queue_rq(struct blk_mq_hw_ctx *hctx, struct request *rq)
 
 	cmd->rq = rq;
 	cmd->nq = hctx->driver_data;
+	cmd->error = memory_backed ? null_transfer_rq(rq->q->queuedata, rq) : 0;
 
-	null_handle_cmd(cmd);
+	if (rq->cmd_flags & REQ_HIPRI)
+		null_cmd_end_timer(cmd);
+	else
+		null_handle_cmd(cmd);
 	return BLK_MQ_RQ_QUEUE_OK;
 }
 
@@ -351,6 +578,7 @@ static struct blk_mq_ops null_mq_ops = {
 	.map_queue      = blk_mq_map_queue,
 	.init_hctx	= null_init_hctx,
 	.complete	= null_softirq_done_fn,
+	.poll		= null_poll,
 };
 
 static void null_del_dev(struct nullb *nullb)
@@ -362,6 +590,7 @@ static void null_del_dev(struct nullb *nullb)
 	if (queue_mode == NULL_Q_MQ)
 		blk_mq_free_tag_set(&nullb->tag_set);
 	put_disk(nullb->disk);
+	null_free_pages(nullb);
 	kfree(nullb);
 }
 
@@ -468,6 +697,8 @@ static int null_add_dev(void)
 		goto out;
 
 	spin_lock_init(&nullb->lock);
+	spin_lock_init(&nullb->pages_lock);
+	INIT_RADIX_TREE(&nullb->pages, GFP_ATOMIC);
 
 	if (queue_mode == NULL_Q_MQ && use_per_node_hctx)
 		submit_queues = nr_online_nodes;
@@ -576,9 +807,7 @@ static int __init null_init(void)
 
 		init_llist_head(&cq->list);
 
-		if (irqmode != NULL_IRQ_TIMER)
-			continue;
-
+		/* also needed for REQ_HIPRI commands, see null_poll() */
 		hrtimer_init(&cq->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
 		cq->timer.function = null_cmd_timer_expired;
 	}
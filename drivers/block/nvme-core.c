@@ -25,6 +25,7 @@
 #include <linux/idr.h>
 #include <linux/init.h>
 #include <linux/interrupt.h>
+#include <linux/ioprio.h>
 #include <linux/io.h>
 #include <linux/kdev_t.h>
 #include <linux/kthread.h>
@@ -37,6 +38,7 @@
 #include <linux/poison.h>
 #include <linux/ptrace.h>
 #include <linux/sched.h>
+#include <linux/sizes.h>
 #include <linux/slab.h>
 #include <linux/types.h>
 #include <scsi/sg.h>
@@ -50,6 +52,14 @@
 #define ADMIN_TIMEOUT		(admin_timeout * HZ)
 #define IOD_TIMEOUT		(retry_time * HZ)
 
+/*
+ * I/O queues keep an arena of preallocated lists the size of the small PRP
+ * pool's, so the common case doesn't need to go to a dma_pool.
+ */
+#define NVME_ARENA_SLOT		256
+#define NVME_ARENA_DEPTH	256
+#define NVME_ARENA_SGLS		(NVME_ARENA_SLOT / sizeof(struct nvme_sgl_desc))
+
 static unsigned char admin_timeout = 60;
 module_param(admin_timeout, byte, 0644);
 MODULE_PARM_DESC(admin_timeout, "timeout in seconds for admin commands");
@@ -68,6 +78,34 @@ module_param(nvme_major, int, 0);
 static int use_threaded_interrupts;
 module_param(use_threaded_interrupts, int, 0);
 
+static bool use_wrr = true;
+module_param(use_wrr, bool, 0);
+MODULE_PARM_DESC(use_wrr, "use weighted round robin queue priorities if supported");
+
+static unsigned int sgl_threshold = SZ_32K;
+module_param(sgl_threshold, uint, 0644);
+MODULE_PARM_DESC(sgl_threshold,
+		"use SGLs when the average segment size is at least this, 0 disables");
+
+/*
+ * With weighted round robin arbitration every CPU gets a submission queue
+ * per priority class.  The queues of a class are numbered after those of
+ * the class before it, so a CPU's queue for class n is dev->max_qid * n
+ * above its urgent one.
+ */
+enum {
+	NVME_PRIO_URGENT,
+	NVME_PRIO_HIGH,
+	NVME_PRIO_MEDIUM,
+	NVME_PRIO_LOW,
+	NVME_NR_PRIO,
+};
+
+/* arbitration weights, the controller takes them minus one */
+#define NVME_WRR_HIGH		8
+#define NVME_WRR_MEDIUM		4
+#define NVME_WRR_LOW		1
+
 static DEFINE_SPINLOCK(dev_list_lock);
 static LIST_HEAD(dev_list);
 static struct task_struct *nvme_thread;
@@ -103,6 +141,10 @@ struct nvme_queue {
 	wait_queue_t sq_cong_wait;
 	struct bio_list sq_cong;
 	struct list_head iod_bio;
+	void *arena;
+	dma_addr_t arena_dma;
+	u16 *arena_free;	/* stack of unused arena slots */
+	u16 arena_top;
 	u32 __iomem *q_db;
 	u16 q_depth;
 	u16 cq_vector;
@@ -110,6 +152,7 @@ struct nvme_queue {
 	u16 sq_tail;
 	u16 cq_head;
 	u16 qid;
+	u8 sq_prio;
 	u8 cq_phase;
 	u8 cqe_seen;
 	u8 q_suspended;
@@ -284,12 +327,20 @@ static struct nvme_queue *raw_nvmeq(struct nvme_dev *dev, int qid)
 	return rcu_dereference_raw(dev->queues[qid]);
 }
 
-static struct nvme_queue *get_nvmeq(struct nvme_dev *dev) __acquires(RCU)
+static struct nvme_queue *get_nvmeq(struct nvme_dev *dev, int prio)
+							__acquires(RCU)
 {
 	struct nvme_queue *nvmeq;
 	unsigned queue_id = get_cpu_var(*dev->io_queue);
 
 	rcu_read_lock();
+	if (prio && prio < dev->nr_prio) {
+		nvmeq = rcu_dereference(dev->queues[queue_id +
+							prio * dev->max_qid]);
+		/* fall back to the CPU's first queue if this one isn't up */
+		if (nvmeq && !nvmeq->q_suspended)
+			return nvmeq;
+	}
 	nvmeq = rcu_dereference(dev->queues[queue_id]);
 	if (nvmeq)
 		return nvmeq;
@@ -379,6 +430,8 @@ nvme_alloc_iod(unsigned nseg, unsigned nbytes, gfp_t gfp)
 		iod->npages = -1;
 		iod->length = nbytes;
 		iod->nents = 0;
+		iod->nsgl = 0;
+		iod->arena = -1;
 		iod->first_dma = 0ULL;
 		iod->start_time = jiffies;
 	}
@@ -404,6 +457,31 @@ void nvme_free_iod(struct nvme_dev *dev, struct nvme_iod *iod)
 	kfree(iod);
 }
 
+/*
+ * Take a list out of the queue's arena for @iod, %NULL if none is left.
+ * Called with the q_lock held.
+ */
+static void *nvme_arena_get(struct nvme_queue *nvmeq, struct nvme_iod *iod)
+{
+	int slot;
+
+	if (!nvmeq->arena_top)
+		return NULL;
+
+	slot = nvmeq->arena_free[--nvmeq->arena_top];
+	iod->arena = slot;
+	iod->first_dma = nvmeq->arena_dma + slot * NVME_ARENA_SLOT;
+	return nvmeq->arena + slot * NVME_ARENA_SLOT;
+}
+
+/* Free an iod of the bio path, called with the q_lock held */
+static void nvme_free_bio_iod(struct nvme_queue *nvmeq, struct nvme_iod *iod)
+{
+	if (iod->arena >= 0)
+		nvmeq->arena_free[nvmeq->arena_top++] = iod->arena;
+	nvme_free_iod(nvmeq->dev, iod);
+}
+
 static void nvme_start_io_acct(struct bio *bio)
 {
 	struct gendisk *disk = bio->bi_bdev->bd_disk;
@@ -459,15 +537,18 @@ static void bio_completion(struct nvme_queue *nvmeq, void *ctx,
 			bio_data_dir(bio) ? DMA_TO_DEVICE : DMA_FROM_DEVICE);
 		nvme_end_io_acct(bio, iod->start_time);
 	}
-	nvme_free_iod(nvmeq->dev, iod);
+	nvme_free_bio_iod(nvmeq, iod);
 
 	trace_block_bio_complete(bdev_get_queue(bio->bi_bdev), bio, error);
 	bio_endio(bio, error);
 }
 
-/* length is in bytes.  gfp flags indicates whether we may sleep. */
-int nvme_setup_prps(struct nvme_dev *dev, struct nvme_iod *iod, int total_len,
-								gfp_t gfp)
+/*
+ * length is in bytes.  gfp flags indicates whether we may sleep.  A short
+ * PRP list comes from the arena of @nvmeq if one is given.
+ */
+static int __nvme_setup_prps(struct nvme_dev *dev, struct nvme_queue *nvmeq,
+			struct nvme_iod *iod, int total_len, gfp_t gfp)
 {
 	struct dma_pool *pool;
 	int length = total_len;
@@ -507,14 +588,23 @@ int nvme_setup_prps(struct nvme_dev *dev, struct nvme_iod *iod, int total_len,
 		iod->npages = 1;
 	}
 
-	prp_list = dma_pool_alloc(pool, gfp, &prp_dma);
+	/* an arena list isn't returned to a pool, so npages is -1 for it */
+	prp_list = NULL;
+	if (nvmeq && nprps <= NVME_ARENA_SLOT / 8) {
+		prp_list = nvme_arena_get(nvmeq, iod);
+		if (prp_list)
+			iod->npages = -1;
+	}
 	if (!prp_list) {
-		iod->first_dma = dma_addr;
-		iod->npages = -1;
-		return (total_len - length) + PAGE_SIZE;
+		prp_list = dma_pool_alloc(pool, gfp, &prp_dma);
+		if (!prp_list) {
+			iod->first_dma = dma_addr;
+			iod->npages = -1;
+			return (total_len - length) + PAGE_SIZE;
+		}
+		iod->first_dma = prp_dma;
 	}
 	list[0] = prp_list;
-	iod->first_dma = prp_dma;
 	i = 0;
 	for (;;) {
 		if (i == PAGE_SIZE / 8) {
@@ -544,6 +634,12 @@ int nvme_setup_prps(struct nvme_dev *dev, struct nvme_iod *iod, int total_len,
 	return total_len;
 }
 
+int nvme_setup_prps(struct nvme_dev *dev, struct nvme_iod *iod, int total_len,
+								gfp_t gfp)
+{
+	return __nvme_setup_prps(dev, NULL, iod, total_len, gfp);
+}
+
 static int nvme_split_and_submit(struct bio *bio, struct nvme_queue *nvmeq,
 				 int len)
 {
@@ -564,6 +660,56 @@ static int nvme_split_and_submit(struct bio *bio, struct nvme_queue *nvmeq,
 	return 0;
 }
 
+/*
+ * Describe the mapped @iod with SGLs instead of PRPs if the controller
+ * supports them and the segments are large enough on average to make this
+ * worth it.  A single segment fits in the command, more go to a segment in
+ * the arena.  Leaves iod->nsgl at 0 to fall back to PRPs.
+ */
+static void nvme_setup_sgls(struct nvme_queue *nvmeq, struct nvme_iod *iod,
+							int length, int count)
+{
+	struct nvme_sgl_desc *sgl;
+	struct scatterlist *sg;
+	int i;
+
+	if (!(nvmeq->dev->sgls & NVME_CTRL_SGLS_SUPPORTED) || !sgl_threshold)
+		return;
+	if (length / count < sgl_threshold)
+		return;
+
+	if (count > 1) {
+		if (count > NVME_ARENA_SGLS)
+			return;
+		sgl = nvme_arena_get(nvmeq, iod);
+		if (!sgl)
+			return;
+
+		for_each_sg(iod->sg, sg, count, i) {
+			memset(&sgl[i], 0, sizeof(sgl[i]));
+			sgl[i].addr = cpu_to_le64(sg_dma_address(sg));
+			sgl[i].length = cpu_to_le32(sg_dma_len(sg));
+			sgl[i].type = NVME_SGL_FMT_DATA_DESC << 4;
+		}
+	}
+	iod->nsgl = count;
+}
+
+/* Fill in the data pointer of a command set up with nvme_setup_sgls() */
+static void nvme_sgl_dptr(struct nvme_iod *iod, struct nvme_sgl_desc *dptr)
+{
+	memset(dptr, 0, sizeof(*dptr));
+	if (iod->nsgl == 1) {
+		dptr->addr = cpu_to_le64(sg_dma_address(iod->sg));
+		dptr->length = cpu_to_le32(sg_dma_len(iod->sg));
+		dptr->type = NVME_SGL_FMT_DATA_DESC << 4;
+	} else {
+		dptr->addr = cpu_to_le64(iod->first_dma);
+		dptr->length = cpu_to_le32(iod->nsgl * sizeof(*dptr));
+		dptr->type = NVME_SGL_FMT_LAST_SEG_DESC << 4;
+	}
+}
+
 /* NVMe scatterlists require no holes in the virtual address */
 #define BIOVEC_NOT_VIRT_MERGEABLE(vec1, vec2)	((vec2)->bv_offset || \
 			(((vec1)->bv_offset + (vec1)->bv_len) % PAGE_SIZE))
@@ -575,7 +721,7 @@ static int nvme_map_bio(struct nvme_queue *nvmeq, struct nvme_iod *iod,
 	struct bvec_iter iter;
 	struct scatterlist *sg = NULL;
 	int length = 0, nsegs = 0, split_len = bio->bi_iter.bi_size;
-	int first = 1;
+	int first = 1, count;
 
 	if (nvmeq->dev->stripe_size)
 		split_len = nvmeq->dev->stripe_size -
@@ -605,10 +751,12 @@ static int nvme_map_bio(struct nvme_queue *nvmeq, struct nvme_iod *iod,
 	}
 	iod->nents = nsegs;
 	sg_mark_end(sg);
-	if (dma_map_sg(nvmeq->q_dmadev, iod->sg, iod->nents, dma_dir) == 0)
+	count = dma_map_sg(nvmeq->q_dmadev, iod->sg, iod->nents, dma_dir);
+	if (count == 0)
 		return -ENOMEM;
 
 	BUG_ON(length != bio->bi_iter.bi_size);
+	nvme_setup_sgls(nvmeq, iod, length, count);
 	return length;
 }
 
@@ -689,8 +837,13 @@ static int nvme_submit_iod(struct nvme_queue *nvmeq, struct nvme_iod *iod)
 	cmnd->rw.opcode = bio_data_dir(bio) ? nvme_cmd_write : nvme_cmd_read;
 	cmnd->rw.command_id = cmdid;
 	cmnd->rw.nsid = cpu_to_le32(ns->ns_id);
-	cmnd->rw.prp1 = cpu_to_le64(sg_dma_address(iod->sg));
-	cmnd->rw.prp2 = cpu_to_le64(iod->first_dma);
+	if (iod->nsgl) {
+		cmnd->rw.flags = NVME_CMD_SGL_METABUF;
+		nvme_sgl_dptr(iod, (struct nvme_sgl_desc *)&cmnd->rw.prp1);
+	} else {
+		cmnd->rw.prp1 = cpu_to_le64(sg_dma_address(iod->sg));
+		cmnd->rw.prp2 = cpu_to_le64(iod->first_dma);
+	}
 	cmnd->rw.slba = cpu_to_le64(nvme_block_nr(ns, bio->bi_iter.bi_sector));
 	cmnd->rw.length =
 		cpu_to_le16((bio->bi_iter.bi_size >> ns->lba_shift) - 1);
@@ -745,27 +898,30 @@ static int nvme_submit_bio_queue(struct nvme_queue *nvmeq, struct nvme_ns *ns,
 	if (bio->bi_rw & REQ_DISCARD) {
 		void *range;
 		/*
-		 * We reuse the small pool to allocate the 16-byte range here
-		 * as it is not worth having a special pool for these or
-		 * additional cases to handle freeing the iod.
+		 * We reuse the arena or the small pool to allocate the 16-byte
+		 * range here as it is not worth having a special pool for
+		 * these or additional cases to handle freeing the iod.
 		 */
-		range = dma_pool_alloc(nvmeq->dev->prp_small_pool,
+		range = nvme_arena_get(nvmeq, iod);
+		if (!range) {
+			range = dma_pool_alloc(nvmeq->dev->prp_small_pool,
 						GFP_ATOMIC,
 						&iod->first_dma);
-		if (!range) {
-			result = -ENOMEM;
-			goto free_iod;
+			if (!range) {
+				result = -ENOMEM;
+				goto free_iod;
+			}
+			iod->npages = 0;
 		}
 		iod_list(iod)[0] = (__le64 *)range;
-		iod->npages = 0;
 	} else if (psegs) {
 		result = nvme_map_bio(nvmeq, iod, bio,
 			bio_data_dir(bio) ? DMA_TO_DEVICE : DMA_FROM_DEVICE,
 			psegs);
 		if (result <= 0)
 			goto free_iod;
-		if (nvme_setup_prps(nvmeq->dev, iod, result, GFP_ATOMIC) !=
-								result) {
+		if (!iod->nsgl && __nvme_setup_prps(nvmeq->dev, nvmeq, iod,
+						result, GFP_ATOMIC) != result) {
 			result = -ENOMEM;
 			goto free_iod;
 		}
@@ -779,7 +935,7 @@ static int nvme_submit_bio_queue(struct nvme_queue *nvmeq, struct nvme_ns *ns,
 	return 0;
 
  free_iod:
-	nvme_free_iod(nvmeq->dev, iod);
+	nvme_free_bio_iod(nvmeq, iod);
 	return result;
 }
 
@@ -823,10 +979,39 @@ static int nvme_process_cq(struct nvme_queue *nvmeq)
 	return 1;
 }
 
+/*
+ * Pick the submission queue priority for a bio from its I/O priority, or
+ * that of the submitting task.  Best effort reads and sync writes go to
+ * the high priority queue so they overtake background writeback.
+ */
+static int nvme_bio_prio(struct bio *bio)
+{
+	struct io_context *ioc = current->io_context;
+	int class;
+
+	if (bio_prio_valid(bio))
+		class = IOPRIO_PRIO_CLASS(bio_prio(bio));
+	else if (ioc && ioprio_valid(ioc->ioprio))
+		class = IOPRIO_PRIO_CLASS(ioc->ioprio);
+	else
+		class = task_nice_ioclass(current);
+
+	switch (class) {
+	case IOPRIO_CLASS_RT:
+		return NVME_PRIO_URGENT;
+	case IOPRIO_CLASS_IDLE:
+		return NVME_PRIO_LOW;
+	}
+
+	if (bio_data_dir(bio) == WRITE && !(bio->bi_rw & REQ_SYNC))
+		return NVME_PRIO_MEDIUM;
+	return NVME_PRIO_HIGH;
+}
+
 static void nvme_make_request(struct request_queue *q, struct bio *bio)
 {
 	struct nvme_ns *ns = q->queuedata;
-	struct nvme_queue *nvmeq = get_nvmeq(ns->dev);
+	struct nvme_queue *nvmeq = get_nvmeq(ns->dev, nvme_bio_prio(bio));
 	int result = -EBUSY;
 
 	if (!nvmeq) {
@@ -848,6 +1033,31 @@ static void nvme_make_request(struct request_queue *q, struct bio *bio)
 	put_nvmeq(nvmeq);
 }
 
+/*
+ * Reap completions on the submitting CPU's queue for REQ_HIPRI waiters.
+ * cqe_seen is left for the interrupt handler so that any interrupt raised
+ * for completions we consumed here still counts as handled.
+ */
+static int nvme_poll(struct request_queue *q)
+{
+	struct nvme_ns *ns = q->queuedata;
+	int prio, found = 0;
+
+	for (prio = 0; prio < ns->dev->nr_prio; prio++) {
+		struct nvme_queue *nvmeq = get_nvmeq(ns->dev, prio);
+
+		if (!nvmeq)
+			return -ENODEV;
+
+		spin_lock_irq(&nvmeq->q_lock);
+		found += nvme_process_cq(nvmeq);
+		spin_unlock_irq(&nvmeq->q_lock);
+		put_nvmeq(nvmeq);
+	}
+
+	return found;
+}
+
 static irqreturn_t nvme_irq(int irq, void *data)
 {
 	irqreturn_t result;
@@ -1018,7 +1228,13 @@ static int adapter_alloc_sq(struct nvme_dev *dev, u16 qid,
 {
 	int status;
 	struct nvme_command c;
-	int flags = NVME_QUEUE_PHYS_CONTIG | NVME_SQ_PRIO_MEDIUM;
+	static const int sq_prio[NVME_NR_PRIO] = {
+		[NVME_PRIO_URGENT]	= NVME_SQ_PRIO_URGENT,
+		[NVME_PRIO_HIGH]	= NVME_SQ_PRIO_HIGH,
+		[NVME_PRIO_MEDIUM]	= NVME_SQ_PRIO_MEDIUM,
+		[NVME_PRIO_LOW]		= NVME_SQ_PRIO_LOW,
+	};
+	int flags = NVME_QUEUE_PHYS_CONTIG | sq_prio[nvmeq->sq_prio];
 
 	memset(&c, 0, sizeof(c));
 	c.create_sq.opcode = nvme_admin_create_sq;
@@ -1172,6 +1388,17 @@ static void nvme_cancel_ios(struct nvme_queue *nvmeq, bool timeout)
 	}
 }
 
+static void nvme_free_arena(struct nvme_queue *nvmeq)
+{
+	int depth = min_t(int, nvmeq->q_depth, NVME_ARENA_DEPTH);
+
+	if (!nvmeq->arena)
+		return;
+	dma_free_coherent(nvmeq->q_dmadev, depth * NVME_ARENA_SLOT,
+					nvmeq->arena, nvmeq->arena_dma);
+	kfree(nvmeq->arena_free);
+}
+
 static void nvme_free_queue(struct rcu_head *r)
 {
 	struct nvme_queue *nvmeq = container_of(r, struct nvme_queue, r_head);
@@ -1198,6 +1425,7 @@ static void nvme_free_queue(struct rcu_head *r)
 				(void *)nvmeq->cqes, nvmeq->cq_dma_addr);
 	dma_free_coherent(nvmeq->q_dmadev, SQ_SIZE(nvmeq->q_depth),
 					nvmeq->sq_cmds, nvmeq->sq_dma_addr);
+	nvme_free_arena(nvmeq);
 	if (nvmeq->qid)
 		free_cpumask_var(nvmeq->cpu_mask);
 	kfree(nvmeq);
@@ -1234,7 +1462,7 @@ static int nvme_suspend_queue(struct nvme_queue *nvmeq)
 	nvmeq->dev->online_queues--;
 	spin_unlock_irq(&nvmeq->q_lock);
 
-	irq_set_affinity_hint(vector, NULL);
+	irq_set_affinity_managed(vector, NULL);
 	free_irq(vector, nvmeq);
 
 	return 0;
@@ -1266,6 +1494,33 @@ static void nvme_disable_queue(struct nvme_dev *dev, int qid)
 	nvme_clear_queue(nvmeq);
 }
 
+/*
+ * The arena is only an optimisation, without it the lists come from the
+ * dma_pools as before.
+ */
+static void nvme_alloc_arena(struct nvme_queue *nvmeq, struct device *dmadev,
+								int depth)
+{
+	int i;
+
+	depth = min(depth, NVME_ARENA_DEPTH);
+	nvmeq->arena_free = kmalloc(depth * sizeof(u16), GFP_KERNEL);
+	if (!nvmeq->arena_free)
+		return;
+
+	nvmeq->arena = dma_alloc_coherent(dmadev, depth * NVME_ARENA_SLOT,
+					&nvmeq->arena_dma, GFP_KERNEL);
+	if (!nvmeq->arena) {
+		kfree(nvmeq->arena_free);
+		nvmeq->arena_free = NULL;
+		return;
+	}
+
+	for (i = 0; i < depth; i++)
+		nvmeq->arena_free[i] = i;
+	nvmeq->arena_top = depth;
+}
+
 static struct nvme_queue *nvme_alloc_queue(struct nvme_dev *dev, int qid,
 							int depth, int vector)
 {
@@ -1289,6 +1544,9 @@ static struct nvme_queue *nvme_alloc_queue(struct nvme_dev *dev, int qid,
 	if (qid && !zalloc_cpumask_var(&nvmeq->cpu_mask, GFP_KERNEL))
 		goto free_sqdma;
 
+	if (qid)
+		nvme_alloc_arena(nvmeq, dmadev, depth);
+
 	nvmeq->q_dmadev = dmadev;
 	nvmeq->dev = dev;
 	snprintf(nvmeq->irqname, sizeof(nvmeq->irqname), "nvme%dq%d",
@@ -1304,6 +1562,10 @@ static struct nvme_queue *nvme_alloc_queue(struct nvme_dev *dev, int qid,
 	nvmeq->q_depth = depth;
 	nvmeq->cq_vector = vector;
 	nvmeq->qid = qid;
+	if (qid && dev->nr_prio > 1)
+		nvmeq->sq_prio = (qid - 1) / dev->max_qid;
+	else
+		nvmeq->sq_prio = NVME_PRIO_MEDIUM;
 	nvmeq->q_suspended = 1;
 	dev->queue_count++;
 	rcu_assign_pointer(dev->queues[qid], nvmeq);
@@ -1467,9 +1729,17 @@ static int nvme_configure_admin_queue(struct nvme_dev *dev)
 
 	dev->ctrl_config = NVME_CC_ENABLE | NVME_CC_CSS_NVM;
 	dev->ctrl_config |= (PAGE_SHIFT - 12) << NVME_CC_MPS_SHIFT;
-	dev->ctrl_config |= NVME_CC_ARB_RR | NVME_CC_SHN_NONE;
+	dev->ctrl_config |= NVME_CC_SHN_NONE;
 	dev->ctrl_config |= NVME_CC_IOSQES | NVME_CC_IOCQES;
 
+	if (use_wrr && NVME_CAP_AMS_WRRU(cap)) {
+		dev->ctrl_config |= NVME_CC_ARB_WRRU;
+		dev->nr_prio = NVME_NR_PRIO;
+	} else {
+		dev->ctrl_config |= NVME_CC_ARB_RR;
+		dev->nr_prio = 1;
+	}
+
 	writel(aqa, &dev->bar->aqa);
 	writeq(nvmeq->sq_dma_addr, &dev->bar->asq);
 	writeq(nvmeq->cq_dma_addr, &dev->bar->acq);
@@ -1917,6 +2187,7 @@ static struct nvme_ns *nvme_alloc_ns(struct nvme_dev *dev, unsigned nsid,
 	queue_flag_set_unlocked(QUEUE_FLAG_NOMERGES, ns->queue);
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, ns->queue);
 	blk_queue_make_request(ns->queue, nvme_make_request);
+	blk_queue_poll_fn(ns->queue, nvme_poll);
 	ns->dev = dev;
 	ns->queue->queuedata = ns;
 
@@ -2000,12 +2271,23 @@ static void nvme_create_io_queues(struct nvme_dev *dev)
 {
 	unsigned i, max;
 
-	max = min(dev->max_qid, num_online_cpus());
+	/*
+	 * The queues of all priority classes are numbered consecutively, so
+	 * they are all created up front rather than as CPUs come online.
+	 * Queues of the same CPU share its completion interrupt.
+	 */
+	if (dev->nr_prio > 1)
+		max = dev->max_qid * dev->nr_prio;
+	else
+		max = min(dev->max_qid, num_online_cpus());
 	for (i = dev->queue_count; i <= max; i++)
-		if (!nvme_alloc_queue(dev, i, dev->q_depth, i - 1))
+		if (!nvme_alloc_queue(dev, i, dev->q_depth,
+						(i - 1) % dev->max_qid))
 			break;
 
-	max = min(dev->queue_count - 1, num_online_cpus());
+	max = dev->queue_count - 1;
+	if (dev->nr_prio == 1)
+		max = min(max, num_online_cpus());
 	for (i = dev->online_queues; i <= max; i++)
 		if (nvme_create_queue(raw_nvmeq(dev, i), i))
 			break;
@@ -2024,7 +2306,7 @@ static void nvme_assign_io_queues(struct nvme_dev *dev)
 
 	nvme_create_io_queues(dev);
 
-	queues = min(dev->online_queues - 1, num_online_cpus());
+	queues = min3(dev->online_queues - 1, dev->max_qid, num_online_cpus());
 	if (!queues)
 		return;
 
@@ -2075,7 +2357,7 @@ static void nvme_assign_io_queues(struct nvme_dev *dev)
 			"nvme%d qid:%d mis-matched queue-to-cpu assignment\n",
 			dev->instance, i);
 
-		irq_set_affinity_hint(dev->entry[nvmeq->cq_vector].vector,
+		irq_set_affinity_managed(dev->entry[nvmeq->cq_vector].vector,
 							nvmeq->cpu_mask);
 		cpumask_andnot(unassigned_cpus, unassigned_cpus,
 						nvmeq->cpu_mask);
@@ -2140,20 +2422,43 @@ static int nvme_cpu_notify(struct notifier_block *self,
 	return NOTIFY_OK;
 }
 
+/*
+ * Weigh the high, medium and low priority classes; urgent queues are
+ * always served first.
+ */
+static void nvme_set_arbitration(struct nvme_dev *dev)
+{
+	u32 dword11 = (NVME_WRR_HIGH - 1) << 24 | (NVME_WRR_MEDIUM - 1) << 16 |
+			(NVME_WRR_LOW - 1) << 8;
+	int status;
+
+	status = nvme_set_features(dev, NVME_FEAT_ARBITRATION, dword11, 0,
+									NULL);
+	if (status)
+		dev_warn(&dev->pci_dev->dev,
+			"Could not set arbitration weights (%d)\n", status);
+}
+
 static int nvme_setup_io_queues(struct nvme_dev *dev)
 {
 	struct nvme_queue *adminq = raw_nvmeq(dev, 0);
 	struct pci_dev *pdev = dev->pci_dev;
 	int result, i, vecs, nr_io_queues, size;
 
+	/* nr_io_queues counts the queues of each priority class */
 	nr_io_queues = num_possible_cpus();
-	result = set_queue_count(dev, nr_io_queues);
+	result = set_queue_count(dev, nr_io_queues * dev->nr_prio);
 	if (result < 0)
 		return result;
-	if (result < nr_io_queues)
-		nr_io_queues = result;
+	if (result < dev->nr_prio)
+		dev->nr_prio = 1;
+	if (result < nr_io_queues * dev->nr_prio)
+		nr_io_queues = result / dev->nr_prio;
+
+	if (dev->nr_prio > 1)
+		nvme_set_arbitration(dev);
 
-	size = db_bar_size(dev, nr_io_queues);
+	size = db_bar_size(dev, nr_io_queues * dev->nr_prio);
 	if (size > 8192) {
 		iounmap(dev->bar);
 		do {
@@ -2162,7 +2467,7 @@ static int nvme_setup_io_queues(struct nvme_dev *dev)
 				break;
 			if (!--nr_io_queues)
 				return -ENOMEM;
-			size = db_bar_size(dev, nr_io_queues);
+			size = db_bar_size(dev, nr_io_queues * dev->nr_prio);
 		} while (1);
 		dev->dbs = ((void __iomem *)dev->bar) + 4096;
 		adminq->q_db = dev->dbs;
@@ -2191,6 +2496,10 @@ static int nvme_setup_io_queues(struct nvme_dev *dev)
 	 * number of interrupts.
 	 */
 	nr_io_queues = vecs;
+
+	/* queue numbering and vectors depend on max_qid with priorities */
+	if (dev->nr_prio > 1 && dev->max_qid && dev->max_qid != nr_io_queues)
+		nvme_free_queues(dev, 1);
 	dev->max_qid = nr_io_queues;
 
 	result = queue_request_irq(dev, adminq, adminq->irqname);
@@ -2200,7 +2509,7 @@ static int nvme_setup_io_queues(struct nvme_dev *dev)
 	}
 
 	/* Free previously allocated queues that are no longer usable */
-	nvme_free_queues(dev, nr_io_queues + 1);
+	nvme_free_queues(dev, nr_io_queues * dev->nr_prio + 1);
 	nvme_assign_io_queues(dev);
 
 	return 0;
@@ -2242,6 +2551,7 @@ static int nvme_dev_add(struct nvme_dev *dev)
 	ctrl = mem;
 	nn = le32_to_cpup(&ctrl->nn);
 	dev->oncs = le16_to_cpup(&ctrl->oncs);
+	dev->sgls = le32_to_cpup(&ctrl->sgls);
 	dev->abort_limit = ctrl->acl + 1;
 	dev->vwc = ctrl->vwc;
 	memcpy(dev->serial, ctrl->sn, sizeof(ctrl->sn));
@@ -2761,8 +3071,8 @@ static int nvme_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 								GFP_KERNEL);
 	if (!dev->entry)
 		goto free;
-	dev->queues = kcalloc(num_possible_cpus() + 1, sizeof(void *),
-								GFP_KERNEL);
+	dev->queues = kcalloc(num_possible_cpus() * NVME_NR_PRIO + 1,
+						sizeof(void *), GFP_KERNEL);
 	if (!dev->queues)
 		goto free;
 	dev->io_queue = alloc_percpu(unsigned short);
@@ -0,0 +1,176 @@
+/*
+ * Deduplication of identical pages stored by zram
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/kernel.h>
+#include <linux/jhash.h>
+#include <linux/rbtree.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+
+#include "zram_drv.h"
+
+u32 zram_dedup_checksum(unsigned char *mem)
+{
+	return jhash2((u32 *)mem, PAGE_SIZE / sizeof(u32), 0);
+}
+
+static void zram_entry_free(struct zram *zram, struct zram_entry *entry)
+{
+	zs_free(zram->meta->mem_pool, entry->handle);
+	atomic64_sub(entry->len, &zram->stats.compr_data_size);
+	kfree(entry);
+}
+
+/* Called with dedup_lock held, returns true if the last reference went */
+static bool __zram_entry_put(struct zram_meta *meta, struct zram_entry *entry)
+{
+	if (--entry->refcount)
+		return false;
+
+	rb_erase(&entry->rb_node, &meta->dedup_tree);
+	return true;
+}
+
+/*
+ * Drop a slot's reference to @entry. Returns true if that freed the
+ * stored object, false if other slots still share it.
+ */
+bool zram_dedup_put(struct zram *zram, struct zram_entry *entry)
+{
+	struct zram_meta *meta = zram->meta;
+	bool freed;
+
+	spin_lock(&meta->dedup_lock);
+	freed = __zram_entry_put(meta, entry);
+	spin_unlock(&meta->dedup_lock);
+
+	if (freed)
+		zram_entry_free(zram, entry);
+
+	return freed;
+}
+
+static bool zram_dedup_match(struct zram *zram, struct zram_entry *entry,
+		unsigned char *mem, struct zcomp_strm *zstrm)
+{
+	struct zram_meta *meta = zram->meta;
+	unsigned char *cmem;
+	bool match;
+
+	cmem = zs_map_object(meta->mem_pool, entry->handle, ZS_MM_RO);
+	if (entry->len == PAGE_SIZE)
+		match = !memcmp(mem, cmem, PAGE_SIZE);
+	else
+		match = !zcomp_decompress(zram->comp, cmem, entry->len,
+					  zstrm->buffer) &&
+			!memcmp(mem, zstrm->buffer, PAGE_SIZE);
+	zs_unmap_object(meta->mem_pool, entry->handle);
+
+	return match;
+}
+
+/*
+ * Look for a stored object with the same content as the page at @mem.
+ * On success the entry is returned with a reference held for the caller.
+ * The stream's buffer is used to decompress candidates, so this must be
+ * called before the page itself is compressed into it.
+ */
+struct zram_entry *zram_dedup_find(struct zram *zram, unsigned char *mem,
+		u32 checksum, struct zcomp_strm *zstrm)
+{
+	struct zram_meta *meta = zram->meta;
+	struct rb_node *node, *prev;
+	struct zram_entry *entry;
+
+	spin_lock(&meta->dedup_lock);
+	node = meta->dedup_tree.rb_node;
+	while (node) {
+		entry = rb_entry(node, struct zram_entry, rb_node);
+		if (checksum < entry->checksum)
+			node = node->rb_left;
+		else if (checksum > entry->checksum)
+			node = node->rb_right;
+		else
+			break;
+	}
+
+	/* Entries with equal checksums are adjacent, start at the first */
+	while (node && (prev = rb_prev(node)) &&
+	       rb_entry(prev, struct zram_entry, rb_node)->checksum == checksum)
+		node = prev;
+
+	while (node) {
+		entry = rb_entry(node, struct zram_entry, rb_node);
+		if (entry->checksum != checksum)
+			break;
+
+		entry->refcount++;
+		spin_unlock(&meta->dedup_lock);
+
+		if (zram_dedup_match(zram, entry, mem, zstrm))
+			return entry;
+
+		spin_lock(&meta->dedup_lock);
+		node = rb_next(node);
+		if (__zram_entry_put(meta, entry)) {
+			/* the tree may change once we drop the lock, give up */
+			spin_unlock(&meta->dedup_lock);
+			zram_entry_free(zram, entry);
+			return NULL;
+		}
+	}
+	spin_unlock(&meta->dedup_lock);
+
+	return NULL;
+}
+
+/*
+ * Make a newly stored object available for sharing. Returns NULL if no
+ * memory was available for tracking it, in which case the object stays
+ * private to its slot.
+ */
+struct zram_entry *zram_dedup_add(struct zram *zram, unsigned long handle,
+		unsigned int len, u32 checksum)
+{
+	struct zram_meta *meta = zram->meta;
+	struct rb_node **link, *parent = NULL;
+	struct zram_entry *entry, *new;
+
+	new = kmalloc(sizeof(*new), GFP_NOIO);
+	if (!new)
+		return NULL;
+
+	new->checksum = checksum;
+	new->handle = handle;
+	new->len = len;
+	new->refcount = 1;
+
+	spin_lock(&meta->dedup_lock);
+	link = &meta->dedup_tree.rb_node;
+	while (*link) {
+		parent = *link;
+		entry = rb_entry(parent, struct zram_entry, rb_node);
+		if (checksum < entry->checksum)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&new->rb_node, parent, link);
+	rb_insert_color(&new->rb_node, &meta->dedup_tree);
+	spin_unlock(&meta->dedup_lock);
+
+	return new;
+}
+
+void zram_dedup_init(struct zram_meta *meta)
+{
+	meta->dedup_tree = RB_ROOT;
+	spin_lock_init(&meta->dedup_lock);
+}
@@ -0,0 +1,61 @@
+/*
+ * Deduplication of identical pages stored by zram
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+#ifndef _ZRAM_DEDUP_H_
+#define _ZRAM_DEDUP_H_
+
+#include <linux/rbtree.h>
+#include <linux/types.h>
+
+struct zram;
+struct zram_meta;
+struct zcomp_strm;
+
+/*
+ * One stored object that may back several zram slots with identical
+ * content. Linked into meta->dedup_tree by checksum of the uncompressed
+ * page, protected by meta->dedup_lock.
+ */
+struct zram_entry {
+	struct rb_node rb_node;
+	u32 checksum;
+	unsigned long handle;
+	unsigned int len;
+	unsigned int refcount;
+};
+
+#ifdef CONFIG_ZRAM_DEDUP
+u32 zram_dedup_checksum(unsigned char *mem);
+struct zram_entry *zram_dedup_find(struct zram *zram, unsigned char *mem,
+		u32 checksum, struct zcomp_strm *zstrm);
+struct zram_entry *zram_dedup_add(struct zram *zram, unsigned long handle,
+		unsigned int len, u32 checksum);
+bool zram_dedup_put(struct zram *zram, struct zram_entry *entry);
+void zram_dedup_init(struct zram_meta *meta);
+#else
+static inline u32 zram_dedup_checksum(unsigned char *mem) { return 0; }
+static inline struct zram_entry *zram_dedup_find(struct zram *zram,
+		unsigned char *mem, u32 checksum, struct zcomp_strm *zstrm)
+{
+	return NULL;
+}
+static inline struct zram_entry *zram_dedup_add(struct zram *zram,
+		unsigned long handle, unsigned int len, u32 checksum)
+{
+	return NULL;
+}
+static inline bool zram_dedup_put(struct zram *zram,
+		struct zram_entry *entry)
+{
+	return false;
+}
+static inline void zram_dedup_init(struct zram_meta *meta) { }
+#endif
+
+#endif /* _ZRAM_DEDUP_H_ */
@@ -26,6 +26,8 @@
 #include <linux/blkdev.h>
 #include <linux/buffer_head.h>
 #include <linux/device.h>
+#include <linux/file.h>
+#include <linux/fs.h>
 #include <linux/genhd.h>
 #include <linux/highmem.h>
 #include <linux/slab.h>
@@ -109,6 +111,25 @@ static ssize_t mem_used_total_show(struct device *dev,
 	return scnprintf(buf, PAGE_SIZE, "%llu\n", val);
 }
 
+static ssize_t compact_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_meta *meta;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	meta = zram->meta;
+	zs_compact(meta->mem_pool);
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
 static ssize_t max_comp_streams_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -179,6 +200,41 @@ static ssize_t comp_algorithm_store(struct device *dev,
 	return len;
 }
 
+#ifdef CONFIG_ZRAM_DEDUP
+static ssize_t use_dedup_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	bool val;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	val = zram->use_dedup;
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", (int)val);
+}
+
+static ssize_t use_dedup_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	bool val;
+	struct zram *zram = dev_to_zram(dev);
+
+	if (strtobool(buf, &val))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change dedup usage for initialized device\n");
+		return -EBUSY;
+	}
+	zram->use_dedup = val;
+	up_write(&zram->init_lock);
+	return len;
+}
+#endif
+
 /* flag operations needs meta->tb_lock */
 static int zram_test_flag(struct zram_meta *meta, u32 index,
 			enum zram_pageflags flag)
@@ -198,6 +254,41 @@ static void zram_clear_flag(struct zram_meta *meta, u32 index,
 	meta->table[index].flags &= ~BIT(flag);
 }
 
+#ifdef CONFIG_ZRAM_DEDUP
+static inline bool zram_dedup_enabled(struct zram *zram)
+{
+	return zram->use_dedup;
+}
+
+static inline struct zram_entry *zram_get_entry(struct zram_meta *meta,
+						u32 index)
+{
+	return meta->table[index].entry;
+}
+
+static inline void zram_set_entry(struct zram_meta *meta, u32 index,
+				  struct zram_entry *entry)
+{
+	meta->table[index].entry = entry;
+}
+#else
+static inline bool zram_dedup_enabled(struct zram *zram)
+{
+	return false;
+}
+
+static inline struct zram_entry *zram_get_entry(struct zram_meta *meta,
+						u32 index)
+{
+	return NULL;
+}
+
+static inline void zram_set_entry(struct zram_meta *meta, u32 index,
+				  struct zram_entry *entry)
+{
+}
+#endif
+
 static inline int is_partial_io(struct bio_vec *bvec)
 {
 	return bvec->bv_len != PAGE_SIZE;
@@ -231,6 +322,9 @@ static inline int valid_io_request(struct zram *zram, struct bio *bio)
 static void zram_meta_free(struct zram_meta *meta)
 {
 	zs_destroy_pool(meta->mem_pool);
+#ifdef CONFIG_ZRAM_WRITEBACK
+	vfree(meta->idle);
+#endif
 	vfree(meta->table);
 	kfree(meta);
 }
@@ -249,15 +343,28 @@ static struct zram_meta *zram_meta_alloc(u64 disksize)
 		goto free_meta;
 	}
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+	meta->idle = vzalloc(BITS_TO_LONGS(num_pages) * sizeof(long));
+	if (!meta->idle) {
+		pr_err("Error allocating zram idle bitmap\n");
+		goto free_table;
+	}
+#endif
+
 	meta->mem_pool = zs_create_pool(GFP_NOIO | __GFP_HIGHMEM);
 	if (!meta->mem_pool) {
 		pr_err("Error creating memory pool\n");
-		goto free_table;
+		goto free_idle;
 	}
 
 	rwlock_init(&meta->tb_lock);
+	zram_dedup_init(meta);
 	return meta;
 
+free_idle:
+#ifdef CONFIG_ZRAM_WRITEBACK
+	vfree(meta->idle);
+#endif
 free_table:
 	vfree(meta->table);
 free_meta:
@@ -267,6 +374,252 @@ out:
 	return meta;
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+static void zram_mark_accessed(struct zram *zram, u32 index)
+{
+	clear_bit(index, zram->meta->idle);
+}
+
+static void reset_bdev(struct zram *zram)
+{
+	struct block_device *bdev;
+
+	if (!zram->backing_dev)
+		return;
+
+	bdev = zram->bdev;
+	/* hope filp_close flush all of IO */
+	set_blocksize(bdev, zram->old_block_size);
+	blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	filp_close(zram->backing_dev, NULL);
+	zram->backing_dev = NULL;
+	zram->old_block_size = 0;
+	zram->bdev = NULL;
+
+	vfree(zram->bitmap);
+	zram->bitmap = NULL;
+	zram->nr_pages = 0;
+}
+
+static ssize_t backing_dev_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct file *file;
+	char *p;
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	file = zram->backing_dev;
+	if (!file) {
+		memcpy(buf, "none\n", 5);
+		up_read(&zram->init_lock);
+		return 5;
+	}
+
+	p = d_path(&file->f_path, buf, PAGE_SIZE - 1);
+	if (IS_ERR(p)) {
+		ret = PTR_ERR(p);
+		goto out;
+	}
+
+	ret = strlen(p);
+	memmove(buf, p, ret);
+	buf[ret++] = '\n';
+out:
+	up_read(&zram->init_lock);
+	return ret;
+}
+
+static ssize_t backing_dev_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct block_device *bdev = NULL;
+	struct file *backing_dev = NULL;
+	struct inode *inode;
+	unsigned long *bitmap;
+	unsigned long nr_pages;
+	unsigned int old_block_size;
+	char *file_name;
+	int err;
+
+	file_name = kstrndup(buf, len, GFP_KERNEL);
+	if (!file_name)
+		return -ENOMEM;
+	strim(file_name);
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		pr_info("Can't setup backing device for initialized device\n");
+		err = -EBUSY;
+		goto out;
+	}
+
+	backing_dev = filp_open(file_name, O_RDWR | O_LARGEFILE, 0);
+	if (IS_ERR(backing_dev)) {
+		err = PTR_ERR(backing_dev);
+		backing_dev = NULL;
+		goto out;
+	}
+
+	inode = backing_dev->f_mapping->host;
+
+	/* Support only block device in this moment */
+	if (!S_ISBLK(inode->i_mode)) {
+		err = -ENOTBLK;
+		goto out;
+	}
+
+	bdev = bdgrab(I_BDEV(inode));
+	err = blkdev_get(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL, zram);
+	if (err < 0) {
+		bdev = NULL;
+		goto out;
+	}
+
+	nr_pages = i_size_read(inode) >> PAGE_SHIFT;
+	bitmap = vzalloc(BITS_TO_LONGS(nr_pages) * sizeof(long));
+	if (!bitmap) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	old_block_size = block_size(bdev);
+	err = set_blocksize(bdev, PAGE_SIZE);
+	if (err) {
+		vfree(bitmap);
+		goto out;
+	}
+
+	reset_bdev(zram);
+
+	zram->old_block_size = old_block_size;
+	zram->bdev = bdev;
+	zram->backing_dev = backing_dev;
+	zram->bitmap = bitmap;
+	zram->nr_pages = nr_pages;
+	up_write(&zram->init_lock);
+
+	pr_info("setup backing device %s\n", file_name);
+	kfree(file_name);
+
+	return len;
+out:
+	if (bdev)
+		blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+
+	if (backing_dev)
+		filp_close(backing_dev, NULL);
+
+	up_write(&zram->init_lock);
+
+	kfree(file_name);
+
+	return err;
+}
+
+static unsigned long alloc_block_bdev(struct zram *zram)
+{
+	unsigned long blk_idx = 1;
+retry:
+	/* skip 0 bit to confuse zram.handle = 0 */
+	blk_idx = find_next_zero_bit(zram->bitmap, zram->nr_pages, blk_idx);
+	if (blk_idx == zram->nr_pages)
+		return 0;
+
+	if (test_and_set_bit(blk_idx, zram->bitmap))
+		goto retry;
+
+	atomic64_inc(&zram->stats.bd_count);
+	return blk_idx;
+}
+
+static void free_block_bdev(struct zram *zram, unsigned long blk_idx)
+{
+	int was_set;
+
+	was_set = test_and_clear_bit(blk_idx, zram->bitmap);
+	WARN_ON_ONCE(!was_set);
+	atomic64_dec(&zram->stats.bd_count);
+}
+
+static int zram_bdev_rw(struct zram *zram, int rw, struct page *page,
+			unsigned long blk_idx)
+{
+	struct bio *bio;
+	int ret;
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_iter.bi_sector = blk_idx * (PAGE_SIZE >> SECTOR_SHIFT);
+	bio->bi_bdev = zram->bdev;
+	if (!bio_add_page(bio, page, PAGE_SIZE, 0)) {
+		bio_put(bio);
+		return -EIO;
+	}
+
+	ret = submit_bio_wait(rw, bio);
+	bio_put(bio);
+
+	if (rw == READ)
+		atomic64_inc(&zram->stats.bd_reads);
+	else
+		atomic64_inc(&zram->stats.bd_writes);
+
+	return ret;
+}
+
+/* Read a written back page into @bvec, may sleep */
+static int zram_bvec_read_bdev(struct zram *zram, struct bio_vec *bvec,
+			       unsigned long blk_idx, int offset)
+{
+	struct page *page = bvec->bv_page;
+	void *src, *dst;
+	int ret;
+
+	if (is_partial_io(bvec)) {
+		page = alloc_page(GFP_NOIO);
+		if (!page)
+			return -ENOMEM;
+	}
+
+	ret = zram_bdev_rw(zram, READ, page, blk_idx);
+	if (ret) {
+		pr_err("Backing device read failed! err=%d, block=%lu\n",
+			ret, blk_idx);
+		atomic64_inc(&zram->stats.failed_reads);
+		goto out;
+	}
+
+	if (is_partial_io(bvec)) {
+		src = kmap_atomic(page);
+		dst = kmap_atomic(bvec->bv_page);
+		memcpy(dst + bvec->bv_offset, src + offset, bvec->bv_len);
+		kunmap_atomic(dst);
+		kunmap_atomic(src);
+	}
+
+	flush_dcache_page(bvec->bv_page);
+out:
+	if (is_partial_io(bvec))
+		__free_page(page);
+	return ret;
+}
+#else
+static inline void zram_mark_accessed(struct zram *zram, u32 index) {}
+static inline void reset_bdev(struct zram *zram) {}
+static inline void free_block_bdev(struct zram *zram,
+				   unsigned long blk_idx) {}
+static inline int zram_bvec_read_bdev(struct zram *zram,
+			struct bio_vec *bvec, unsigned long blk_idx, int offset)
+{
+	return -EIO;
+}
+#endif
+
 static void update_position(u32 *index, int *offset, struct bio_vec *bvec)
 {
 	if (*offset + bvec->bv_len >= PAGE_SIZE)
@@ -309,6 +662,17 @@ static void zram_free_page(struct zram *zram, size_t index)
 {
 	struct zram_meta *meta = zram->meta;
 	unsigned long handle = meta->table[index].handle;
+	struct zram_entry *entry;
+
+	/* a pending writeback of this slot must not install its result */
+	zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		zram_clear_flag(meta, index, ZRAM_WB);
+		free_block_bdev(zram, handle);
+		meta->table[index].handle = 0;
+		return;
+	}
 
 	if (unlikely(!handle)) {
 		/*
@@ -322,9 +686,19 @@ static void zram_free_page(struct zram *zram, size_t index)
 		return;
 	}
 
-	zs_free(meta->mem_pool, handle);
+	entry = zram_get_entry(meta, index);
+	if (entry) {
+		/* the object stays around for the other sharers */
+		if (!zram_dedup_put(zram, entry))
+			atomic64_sub(meta->table[index].size,
+				     &zram->stats.dup_data_size);
+		zram_set_entry(meta, index, NULL);
+	} else {
+		zs_free(meta->mem_pool, handle);
+		atomic64_sub(meta->table[index].size,
+			     &zram->stats.compr_data_size);
+	}
 
-	atomic64_sub(meta->table[index].size, &zram->stats.compr_data_size);
 	atomic64_dec(&zram->stats.pages_stored);
 
 	meta->table[index].handle = 0;
@@ -349,6 +723,12 @@ static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 		return 0;
 	}
 
+	/* Written back meanwhile, the caller has to read the device */
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		read_unlock(&meta->tb_lock);
+		return -EAGAIN;
+	}
+
 	cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_RO);
 	if (size == PAGE_SIZE)
 		copy_page(mem, cmem);
@@ -372,17 +752,24 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 {
 	int ret;
 	struct page *page;
-	unsigned char *user_mem, *uncmem = NULL;
+	unsigned char *user_mem, *uncmem;
 	struct zram_meta *meta = zram->meta;
+	unsigned long handle;
 	page = bvec->bv_page;
 
+again:
+	uncmem = NULL;
 	read_lock(&meta->tb_lock);
-	if (unlikely(!meta->table[index].handle) ||
-			zram_test_flag(meta, index, ZRAM_ZERO)) {
+	handle = meta->table[index].handle;
+	if (unlikely(!handle) || zram_test_flag(meta, index, ZRAM_ZERO)) {
 		read_unlock(&meta->tb_lock);
 		handle_zero_page(bvec);
 		return 0;
 	}
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		read_unlock(&meta->tb_lock);
+		return zram_bvec_read_bdev(zram, bvec, handle, offset);
+	}
 	read_unlock(&meta->tb_lock);
 
 	if (is_partial_io(bvec))
@@ -400,7 +787,7 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	}
 
 	ret = zram_decompress_page(zram, uncmem, index);
-	/* Should NEVER happen. Return bio error if it does. */
+	/* -EAGAIN: written back meanwhile, anything else should NEVER happen */
 	if (unlikely(ret))
 		goto out_cleanup;
 
@@ -414,6 +801,8 @@ out_cleanup:
 	kunmap_atomic(user_mem);
 	if (is_partial_io(bvec))
 		kfree(uncmem);
+	if (ret == -EAGAIN)
+		goto again;
 	return ret;
 }
 
@@ -425,22 +814,33 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	unsigned long handle;
 	struct page *page;
 	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
+	struct page *uncmem_page = NULL;
 	struct zram_meta *meta = zram->meta;
 	struct zcomp_strm *zstrm;
+	struct zram_entry *entry = NULL;
+	u32 checksum = 0;
 	bool locked = false;
 
 	page = bvec->bv_page;
 	if (is_partial_io(bvec)) {
+		struct bio_vec vec;
+
 		/*
 		 * This is a partial IO. We need to read the full page
-		 * before to write the changes.
+		 * before to write the changes. The page may live on the
+		 * backing device, so go through the regular read path.
 		 */
-		uncmem = kmalloc(PAGE_SIZE, GFP_NOIO);
-		if (!uncmem) {
+		uncmem_page = alloc_page(GFP_NOIO);
+		if (!uncmem_page) {
 			ret = -ENOMEM;
 			goto out;
 		}
-		ret = zram_decompress_page(zram, uncmem, index);
+		uncmem = page_address(uncmem_page);
+
+		vec.bv_page = uncmem_page;
+		vec.bv_len = PAGE_SIZE;
+		vec.bv_offset = 0;
+		ret = zram_bvec_read(zram, &vec, index, 0, NULL);
 		if (ret)
 			goto out;
 	}
@@ -471,6 +871,19 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		goto out;
 	}
 
+	if (zram_dedup_enabled(zram)) {
+		checksum = zram_dedup_checksum(uncmem);
+		entry = zram_dedup_find(zram, uncmem, checksum, zstrm);
+		if (entry) {
+			if (user_mem)
+				kunmap_atomic(user_mem);
+			handle = entry->handle;
+			clen = entry->len;
+			atomic64_add(clen, &zram->stats.dup_data_size);
+			goto found_dup;
+		}
+	}
+
 	ret = zcomp_compress(zram->comp, zstrm, uncmem, &clen);
 	if (!is_partial_io(bvec)) {
 		kunmap_atomic(user_mem);
@@ -510,6 +923,11 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	locked = false;
 	zs_unmap_object(meta->mem_pool, handle);
 
+	if (zram_dedup_enabled(zram))
+		entry = zram_dedup_add(zram, handle, clen, checksum);
+	atomic64_add(clen, &zram->stats.compr_data_size);
+
+found_dup:
 	/*
 	 * Free memory associated with this sector
 	 * before overwriting unused sectors.
@@ -519,16 +937,16 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 
 	meta->table[index].handle = handle;
 	meta->table[index].size = clen;
+	zram_set_entry(meta, index, entry);
 	write_unlock(&zram->meta->tb_lock);
 
 	/* Update stats */
-	atomic64_add(clen, &zram->stats.compr_data_size);
 	atomic64_inc(&zram->stats.pages_stored);
 out:
 	if (locked)
 		zcomp_strm_release(zram->comp, zstrm);
-	if (is_partial_io(bvec))
-		kfree(uncmem);
+	if (uncmem_page)
+		__free_page(uncmem_page);
 	if (ret)
 		atomic64_inc(&zram->stats.failed_writes);
 	return ret;
@@ -540,6 +958,8 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 	int ret;
 	int rw = bio_data_dir(bio);
 
+	zram_mark_accessed(zram, index);
+
 	if (rw == READ) {
 		atomic64_inc(&zram->stats.num_reads);
 		ret = zram_bvec_read(zram, bvec, index, offset, bio);
@@ -551,6 +971,151 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 	return ret;
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+static ssize_t idle_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long nr_pages, index;
+
+	if (!sysfs_streq(buf, "all"))
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	/* Any access from now on clears the bit again */
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++)
+		set_bit(index, zram->meta->idle);
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
+static bool zram_wb_candidate(struct zram *zram, u32 index, bool idle)
+{
+	struct zram_meta *meta = zram->meta;
+
+	if (!meta->table[index].handle ||
+	    zram_test_flag(meta, index, ZRAM_ZERO) ||
+	    zram_test_flag(meta, index, ZRAM_WB) ||
+	    zram_test_flag(meta, index, ZRAM_UNDER_WB))
+		return false;
+
+	if (idle)
+		return test_bit(index, meta->idle);
+
+	/* stored uncompressed */
+	return meta->table[index].size == PAGE_SIZE;
+}
+
+/*
+ * Write "huge" to move pages that did not compress, or "idle" to move
+ * pages not accessed since the last "all" written to idle, out to the
+ * backing device.
+ */
+static ssize_t writeback_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_meta *meta;
+	unsigned long nr_pages, index, blk_idx;
+	struct page *page;
+	bool idle;
+	ssize_t ret = len;
+	int err;
+
+	if (sysfs_streq(buf, "idle"))
+		idle = true;
+	else if (sysfs_streq(buf, "huge"))
+		idle = false;
+	else
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		ret = -EINVAL;
+		goto release_init_lock;
+	}
+
+	if (!zram->backing_dev) {
+		ret = -ENODEV;
+		goto release_init_lock;
+	}
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page) {
+		ret = -ENOMEM;
+		goto release_init_lock;
+	}
+
+	meta = zram->meta;
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++) {
+		write_lock(&meta->tb_lock);
+		if (!zram_wb_candidate(zram, index, idle)) {
+			write_unlock(&meta->tb_lock);
+			continue;
+		}
+		zram_set_flag(meta, index, ZRAM_UNDER_WB);
+		write_unlock(&meta->tb_lock);
+
+		blk_idx = alloc_block_bdev(zram);
+		if (!blk_idx) {
+			ret = -ENOSPC;
+			goto clear_under_wb;
+		}
+
+		err = zram_decompress_page(zram, page_address(page), index);
+		if (!err)
+			err = zram_bdev_rw(zram, WRITE, page, blk_idx);
+		if (err) {
+			free_block_bdev(zram, blk_idx);
+			/* -EAGAIN: slot was reused and written back meanwhile */
+			if (err != -EAGAIN)
+				ret = err;
+			goto clear_under_wb;
+		}
+
+		/*
+		 * The slot was freed or rewritten while we were busy, so
+		 * the block holds stale data.
+		 */
+		write_lock(&meta->tb_lock);
+		if (!zram_test_flag(meta, index, ZRAM_UNDER_WB)) {
+			write_unlock(&meta->tb_lock);
+			free_block_bdev(zram, blk_idx);
+			continue;
+		}
+
+		zram_free_page(zram, index);
+		zram_set_flag(meta, index, ZRAM_WB);
+		meta->table[index].handle = blk_idx;
+		write_unlock(&meta->tb_lock);
+
+		cond_resched();
+		continue;
+
+clear_under_wb:
+		write_lock(&meta->tb_lock);
+		zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+		write_unlock(&meta->tb_lock);
+		if (ret < 0)
+			break;
+	}
+
+	__free_page(page);
+release_init_lock:
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+#endif
+
 /*
  * zram_bio_discard - handler on discard request
  * @index: physical block index in PAGE_SIZE units
@@ -607,10 +1172,15 @@ static void zram_reset_device(struct zram *zram, bool reset_capacity)
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
 		unsigned long handle = meta->table[index].handle;
-		if (!handle)
+		struct zram_entry *entry = zram_get_entry(meta, index);
+
+		if (!handle || zram_test_flag(meta, index, ZRAM_WB))
 			continue;
 
-		zs_free(meta->mem_pool, handle);
+		if (entry)
+			zram_dedup_put(zram, entry);
+		else
+			zs_free(meta->mem_pool, handle);
 	}
 
 	zcomp_destroy(zram->comp);
@@ -618,6 +1188,7 @@ static void zram_reset_device(struct zram *zram, bool reset_capacity)
 
 	zram_meta_free(zram->meta);
 	zram->meta = NULL;
+	reset_bdev(zram);
 	/* Reset stats */
 	memset(&zram->stats, 0, sizeof(zram->stats));
 
@@ -838,6 +1409,17 @@ static DEVICE_ATTR(initstate, S_IRUGO, initstate_show, NULL);
 static DEVICE_ATTR(reset, S_IWUSR, NULL, reset_store);
 static DEVICE_ATTR(orig_data_size, S_IRUGO, orig_data_size_show, NULL);
 static DEVICE_ATTR(mem_used_total, S_IRUGO, mem_used_total_show, NULL);
+static DEVICE_ATTR(compact, S_IWUSR, NULL, compact_store);
+#ifdef CONFIG_ZRAM_WRITEBACK
+static DEVICE_ATTR(backing_dev, S_IRUGO | S_IWUSR,
+		backing_dev_show, backing_dev_store);
+static DEVICE_ATTR(idle, S_IWUSR, NULL, idle_store);
+static DEVICE_ATTR(writeback, S_IWUSR, NULL, writeback_store);
+#endif
+#ifdef CONFIG_ZRAM_DEDUP
+static DEVICE_ATTR(use_dedup, S_IRUGO | S_IWUSR,
+		use_dedup_show, use_dedup_store);
+#endif
 static DEVICE_ATTR(max_comp_streams, S_IRUGO | S_IWUSR,
 		max_comp_streams_show, max_comp_streams_store);
 static DEVICE_ATTR(comp_algorithm, S_IRUGO | S_IWUSR,
@@ -851,6 +1433,14 @@ ZRAM_ATTR_RO(invalid_io);
 ZRAM_ATTR_RO(notify_free);
 ZRAM_ATTR_RO(zero_pages);
 ZRAM_ATTR_RO(compr_data_size);
+#ifdef CONFIG_ZRAM_WRITEBACK
+ZRAM_ATTR_RO(bd_count);
+ZRAM_ATTR_RO(bd_reads);
+ZRAM_ATTR_RO(bd_writes);
+#endif
+#ifdef CONFIG_ZRAM_DEDUP
+ZRAM_ATTR_RO(dup_data_size);
+#endif
 
 static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_disksize.attr,
@@ -866,8 +1456,21 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_orig_data_size.attr,
 	&dev_attr_compr_data_size.attr,
 	&dev_attr_mem_used_total.attr,
+	&dev_attr_compact.attr,
 	&dev_attr_max_comp_streams.attr,
 	&dev_attr_comp_algorithm.attr,
+#ifdef CONFIG_ZRAM_WRITEBACK
+	&dev_attr_backing_dev.attr,
+	&dev_attr_idle.attr,
+	&dev_attr_writeback.attr,
+	&dev_attr_bd_count.attr,
+	&dev_attr_bd_reads.attr,
+	&dev_attr_bd_writes.attr,
+#endif
+#ifdef CONFIG_ZRAM_DEDUP
+	&dev_attr_use_dedup.attr,
+	&dev_attr_dup_data_size.attr,
+#endif
 	NULL,
 };
 
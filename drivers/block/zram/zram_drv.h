@@ -19,6 +19,7 @@
 #include <linux/zsmalloc.h>
 
 #include "zcomp.h"
+#include "zram_dedup.h"
 
 /*
  * Some arbitrary value. This is just to catch
@@ -55,6 +56,10 @@ static const size_t max_zpage_size = PAGE_SIZE / 4 * 3;
 enum zram_pageflags {
 	/* Page consists entirely of zeros */
 	ZRAM_ZERO,
+	/* Page is stored on the backing device, handle is its block index */
+	ZRAM_WB,
+	/* Page is being written back, cleared if the slot changes meanwhile */
+	ZRAM_UNDER_WB,
 
 	__NR_ZRAM_PAGEFLAGS,
 };
@@ -64,6 +69,9 @@ enum zram_pageflags {
 /* Allocated for each disk page */
 struct table {
 	unsigned long handle;
+#ifdef CONFIG_ZRAM_DEDUP
+	struct zram_entry *entry;	/* set if handle may be shared */
+#endif
 	u16 size;	/* object size (excluding header) */
 	u8 flags;
 } __aligned(4);
@@ -78,12 +86,26 @@ struct zram_stats {
 	atomic64_t notify_free;	/* no. of swap slot free notifications */
 	atomic64_t zero_pages;		/* no. of zero filled pages */
 	atomic64_t pages_stored;	/* no. of pages currently stored */
+	atomic64_t dup_data_size;	/* compressed bytes saved by dedup */
+#ifdef CONFIG_ZRAM_WRITEBACK
+	atomic64_t bd_count;	/* no. of pages in backing device */
+	atomic64_t bd_reads;	/* no. of reads from backing device */
+	atomic64_t bd_writes;	/* no. of writes to backing device */
+#endif
 };
 
 struct zram_meta {
 	rwlock_t tb_lock;	/* protect table */
 	struct table *table;
 	struct zs_pool *mem_pool;
+#ifdef CONFIG_ZRAM_WRITEBACK
+	/* slots not accessed since they were last marked idle */
+	unsigned long *idle;
+#endif
+#ifdef CONFIG_ZRAM_DEDUP
+	struct rb_root dedup_tree;
+	spinlock_t dedup_lock;
+#endif
 };
 
 struct zram {
@@ -102,5 +124,16 @@ struct zram {
 	int max_comp_streams;
 	struct zram_stats stats;
 	char compressor[10];
+#ifdef CONFIG_ZRAM_DEDUP
+	bool use_dedup;
+#endif
+#ifdef CONFIG_ZRAM_WRITEBACK
+	struct file *backing_dev;
+	struct block_device *bdev;
+	unsigned int old_block_size;
+	/* in use blocks of the backing device, bit 0 is never handed out */
+	unsigned long *bitmap;
+	unsigned long nr_pages;
+#endif
 };
 #endif
@@ -34,10 +34,17 @@ struct hpet_scope {
 #define IR_X2APIC_MODE(mode) (mode ? (1 << 11) : 0)
 #define IRTE_DEST(dest) ((x2apic_mode) ? dest : dest << 8)
 
+/* posted-interrupt descriptor address, split over both IRTE halves */
+#define IRTE_PDA_LOW(addr)	(((addr) >> 6) & ((1ULL << 26) - 1))
+#define IRTE_PDA_HIGH(addr)	((addr) >> 32)
+
 static struct ioapic_scope ir_ioapic[MAX_IO_APICS];
 static struct hpet_scope ir_hpet[MAX_HPET_TBS];
 static int ir_ioapic_num, ir_hpet_num;
 
+/* all remapping units can post interrupts to vcpus */
+static bool intel_irq_posting;
+
 /*
  * Lock ordering:
  * ->dmar_global_lock
@@ -168,29 +175,55 @@ static int set_irte_irq(int irq, struct intel_iommu *iommu, u16 index, u16 subha
 	return 0;
 }
 
+/* called with irq_2_ir_lock held */
+static int __modify_irte(struct irq_2_iommu *irq_iommu,
+			 struct irte *irte_modified)
+{
+	struct intel_iommu *iommu = irq_iommu->iommu;
+	int index = irq_iommu->irte_index + irq_iommu->sub_handle;
+	struct irte *irte = &iommu->ir_table->base[index];
+
+#ifdef CONFIG_HAVE_CMPXCHG_DOUBLE
+	/*
+	 * The descriptor address of a posted IRTE spans both halves, the
+	 * hardware must never see one half updated without the other.
+	 */
+	if (irte->pst || irte_modified->pst) {
+		bool ret;
+
+		ret = cmpxchg_double(&irte->low, &irte->high,
+				     irte->low, irte->high,
+				     irte_modified->low, irte_modified->high);
+		WARN_ON(!ret);
+	} else
+#endif
+	{
+		set_64bit(&irte->low, irte_modified->low);
+		set_64bit(&irte->high, irte_modified->high);
+	}
+	__iommu_flush_cache(iommu, irte, sizeof(*irte));
+
+	return qi_flush_iec(iommu, index, 0);
+}
+
 static int modify_irte(int irq, struct irte *irte_modified)
 {
 	struct irq_2_iommu *irq_iommu = irq_2_iommu(irq);
-	struct intel_iommu *iommu;
 	unsigned long flags;
-	struct irte *irte;
-	int rc, index;
+	int rc = 0;
 
 	if (!irq_iommu)
 		return -1;
 
 	raw_spin_lock_irqsave(&irq_2_ir_lock, flags);
 
-	iommu = irq_iommu->iommu;
-
-	index = irq_iommu->irte_index + irq_iommu->sub_handle;
-	irte = &iommu->ir_table->base[index];
-
-	set_64bit(&irte->low, irte_modified->low);
-	set_64bit(&irte->high, irte_modified->high);
-	__iommu_flush_cache(iommu, irte, sizeof(*irte));
+	/*
+	 * A posted IRTE belongs to the vcpu, host affinity changes take
+	 * effect when it is handed back.
+	 */
+	if (!irq_iommu->posted)
+		rc = __modify_irte(irq_iommu, irte_modified);
 
-	rc = qi_flush_iec(iommu, index, 0);
 	raw_spin_unlock_irqrestore(&irq_2_ir_lock, flags);
 
 	return rc;
@@ -269,6 +302,7 @@ static int free_irte(int irq)
 	irq_iommu->irte_index = 0;
 	irq_iommu->sub_handle = 0;
 	irq_iommu->irte_mask = 0;
+	irq_iommu->posted = 0;
 
 	raw_spin_unlock_irqrestore(&irq_2_ir_lock, flags);
 
@@ -650,6 +684,18 @@ static int __init intel_enable_irq_remapping(void)
 
 	irq_remapping_enabled = 1;
 
+	/*
+	 * Posted interrupts need all units to support them, and a 128-bit
+	 * cmpxchg to switch an IRTE between the two formats.
+	 */
+	intel_irq_posting = config_enabled(CONFIG_HAVE_CMPXCHG_DOUBLE) &&
+			    cpu_has_cx16;
+	for_each_iommu(iommu, drhd)
+		if (!cap_pi_support(iommu->cap))
+			intel_irq_posting = false;
+	if (intel_irq_posting)
+		pr_info("Posted interrupts supported\n");
+
 	/*
 	 * VT-d has a different layout for IO-APIC entries when
 	 * interrupt remapping is enabled. So it needs a special routine
@@ -1129,6 +1175,63 @@ static int intel_setup_hpet_msi(unsigned int irq, unsigned int id)
 	return ret;
 }
 
+static bool intel_irq_posting_supported(void)
+{
+	return intel_irq_posting;
+}
+
+static int intel_set_vcpu_affinity(int irq, struct irq_remap_vcpu_info *info)
+{
+	struct irq_2_iommu *irq_iommu = irq_2_iommu(irq);
+	struct irq_cfg *cfg = irq_get_chip_data(irq);
+	unsigned long flags;
+	struct irte irte;
+	unsigned int dest;
+	int index, rc = 0;
+
+	if (!intel_irq_posting || !irq_iommu || !irq_iommu->iommu)
+		return -ENODEV;
+
+	raw_spin_lock_irqsave(&irq_2_ir_lock, flags);
+
+	index = irq_iommu->irte_index + irq_iommu->sub_handle;
+	irte = irq_iommu->iommu->ir_table->base[index];
+
+	if (info) {
+		/* the source-id fields stay, they are shared by both formats */
+		irte.low = 0;
+		irte.p_present = 1;
+		irte.p_pst = 1;
+		irte.p_vector = info->vector;
+		irte.pda_l = IRTE_PDA_LOW(info->pi_desc_addr);
+		irte.pda_h = IRTE_PDA_HIGH(info->pi_desc_addr);
+	} else if (irq_iommu->posted) {
+		u64 high = irte.high;
+
+		/*
+		 * Host affinity changes skipped the IRTE while it was
+		 * posted, rebuild it from the current vector assignment.
+		 */
+		if (apic->cpu_mask_to_apicid_and(cfg->domain, cpu_online_mask,
+						 &dest)) {
+			rc = -EINVAL;
+			goto out;
+		}
+		prepare_irte(&irte, cfg->vector, dest);
+		irte.high = high;
+		irte.pda_h = 0;
+	} else {
+		goto out;
+	}
+
+	irq_iommu->posted = !!info;
+	rc = __modify_irte(irq_iommu, &irte);
+out:
+	raw_spin_unlock_irqrestore(&irq_2_ir_lock, flags);
+
+	return rc;
+}
+
 struct irq_remap_ops intel_irq_remap_ops = {
 	.supported		= intel_irq_remapping_supported,
 	.prepare		= dmar_table_init,
@@ -1143,4 +1246,6 @@ struct irq_remap_ops intel_irq_remap_ops = {
 	.msi_alloc_irq		= intel_msi_alloc_irq,
 	.msi_setup_irq		= intel_msi_setup_irq,
 	.setup_hpet_msi		= intel_setup_hpet_msi,
+	.posting_supported	= intel_irq_posting_supported,
+	.set_vcpu_affinity	= intel_set_vcpu_affinity,
 };
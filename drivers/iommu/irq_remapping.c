@@ -3,6 +3,7 @@
 #include <linux/kernel.h>
 #include <linux/string.h>
 #include <linux/errno.h>
+#include <linux/export.h>
 #include <linux/msi.h>
 #include <linux/irq.h>
 #include <linux/pci.h>
@@ -351,6 +352,39 @@ int setup_hpet_msi_remapped(unsigned int irq, unsigned int id)
 	return remap_ops->setup_hpet_msi(irq, id);
 }
 
+bool irq_remapping_posting_supported(void)
+{
+	if (!irq_remapping_enabled || !remap_ops ||
+	    !remap_ops->posting_supported)
+		return false;
+
+	return remap_ops->posting_supported();
+}
+EXPORT_SYMBOL_GPL(irq_remapping_posting_supported);
+
+/**
+ * irq_remapping_set_vcpu_affinity - post a remapped interrupt to a vcpu
+ * @irq:	the host irq
+ * @info:	the vcpu's posted-interrupt descriptor and guest vector, or
+ *		%NULL to deliver @irq to the host again
+ *
+ * While posted, the interrupt is recorded in the descriptor and the
+ * vcpu is notified by the remapping hardware directly, without raising
+ * @irq on the host.  Host affinity changes are picked up once the
+ * interrupt is handed back.
+ */
+int irq_remapping_set_vcpu_affinity(int irq, struct irq_remap_vcpu_info *info)
+{
+	struct irq_cfg *cfg = irq_get_chip_data(irq);
+
+	if (!cfg || !irq_remapped(cfg) || !remap_ops ||
+	    !remap_ops->set_vcpu_affinity)
+		return -ENODEV;
+
+	return remap_ops->set_vcpu_affinity(irq, info);
+}
+EXPORT_SYMBOL_GPL(irq_remapping_set_vcpu_affinity);
+
 void panic_if_irq_remap(const char *msg)
 {
 	if (irq_remapping_enabled)
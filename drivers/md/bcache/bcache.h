@@ -347,6 +347,10 @@ struct cached_dev {
 
 	/* Limit number of writeback bios in flight */
 	struct semaphore	in_flight;
+
+	/* Writes to the backing device are issued in read_dirty() order */
+	atomic_t		writeback_sequence_next;
+	struct closure_waitlist	writeback_ordering_wait;
 	struct task_struct	*writeback_thread;
 
 	struct keybuf		writeback_keys;
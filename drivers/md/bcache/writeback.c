@@ -96,9 +96,18 @@ static unsigned writeback_delay(struct cached_dev *dc, unsigned sectors)
 	return bch_next_delay(&dc->writeback_rate, sectors);
 }
 
+/*
+ * read_dirty() gathers runs of contiguous dirty keys and issues them back to
+ * back; the backing device sees them as one large sequential write only if
+ * they reach it in order, so writes are released strictly by sequence number.
+ */
+#define MAX_WRITEBACKS_IN_PASS	5
+#define MAX_WRITESIZE_IN_PASS	5000	/* in sectors */
+
 struct dirty_io {
 	struct closure		cl;
 	struct cached_dev	*dc;
+	unsigned		sequence;
 	struct bio		bio;
 };
 
@@ -181,14 +190,29 @@ static void write_dirty(struct closure *cl)
 {
 	struct dirty_io *io = container_of(cl, struct dirty_io, cl);
 	struct keybuf_key *w = io->bio.bi_private;
+	struct cached_dev *dc = io->dc;
+
+	if (atomic_read(&dc->writeback_sequence_next) != io->sequence) {
+		/* Not our turn yet; wait for the previous write to go out */
+		closure_wait(&dc->writeback_ordering_wait, cl);
+
+		/* It may have gone out before we got on the wait list */
+		if (atomic_read(&dc->writeback_sequence_next) == io->sequence)
+			closure_wake_up(&dc->writeback_ordering_wait);
+
+		continue_at(cl, write_dirty, system_wq);
+	}
 
 	dirty_init(w);
 	io->bio.bi_rw		= WRITE;
 	io->bio.bi_iter.bi_sector = KEY_START(&w->key);
-	io->bio.bi_bdev		= io->dc->bdev;
+	io->bio.bi_bdev		= dc->bdev;
 	io->bio.bi_end_io	= dirty_endio;
 
-	closure_bio_submit(&io->bio, cl, &io->dc->disk);
+	closure_bio_submit(&io->bio, cl, &dc->disk);
+
+	atomic_set(&dc->writeback_sequence_next, io->sequence + 1);
+	closure_wake_up(&dc->writeback_ordering_wait);
 
 	continue_at(cl, write_dirty_finish, system_wq);
 }
@@ -215,11 +239,15 @@ static void read_dirty_submit(struct closure *cl)
 
 static void read_dirty(struct cached_dev *dc)
 {
-	unsigned delay = 0;
-	struct keybuf_key *w;
+	unsigned delay = 0, sequence = 0;
+	struct keybuf_key *next, *keys[MAX_WRITEBACKS_IN_PASS], *w;
+	unsigned size;
+	int nk, i;
 	struct dirty_io *io;
 	struct closure cl;
 
+	BUG_ON(!llist_empty(&dc->writeback_ordering_wait.list));
+	atomic_set(&dc->writeback_sequence_next, sequence);
 	closure_init_stack(&cl);
 
 	/*
@@ -227,56 +255,87 @@ static void read_dirty(struct cached_dev *dc)
 	 * mempools.
 	 */
 
-	while (!kthread_should_stop()) {
+	next = bch_keybuf_next(&dc->writeback_keys);
+
+	while (!kthread_should_stop() && next) {
 		try_to_freeze();
 
-		w = bch_keybuf_next(&dc->writeback_keys);
-		if (!w)
-			break;
+		size = 0;
+		nk = 0;
+
+		/*
+		 * Gather a run of contiguous keys, so the backing device gets
+		 * one sequential stream instead of writes spread out by the
+		 * rate limiter's delays.
+		 */
+		do {
+			BUG_ON(ptr_stale(dc->disk.c, &next->key, 0));
+
+			if (nk >= MAX_WRITEBACKS_IN_PASS ||
+			    size >= MAX_WRITESIZE_IN_PASS)
+				break;
 
-		BUG_ON(ptr_stale(dc->disk.c, &w->key, 0));
+			if (nk && bkey_cmp(&keys[nk - 1]->key,
+					   &START_KEY(&next->key)))
+				break;
 
-		if (KEY_START(&w->key) != dc->last_read ||
+			size += KEY_SIZE(&next->key);
+			keys[nk++] = next;
+		} while ((next = bch_keybuf_next(&dc->writeback_keys)));
+
+		if (KEY_START(&keys[0]->key) != dc->last_read ||
 		    jiffies_to_msecs(delay) > 50)
 			while (!kthread_should_stop() && delay)
 				delay = schedule_timeout_uninterruptible(delay);
 
-		dc->last_read	= KEY_OFFSET(&w->key);
+		dc->last_read	= KEY_OFFSET(&keys[nk - 1]->key);
+
+		for (i = 0; i < nk; i++) {
+			w = keys[i];
 
-		io = kzalloc(sizeof(struct dirty_io) + sizeof(struct bio_vec)
-			     * DIV_ROUND_UP(KEY_SIZE(&w->key), PAGE_SECTORS),
-			     GFP_KERNEL);
-		if (!io)
-			goto err;
+			io = kzalloc(sizeof(struct dirty_io) +
+				     sizeof(struct bio_vec) *
+				     DIV_ROUND_UP(KEY_SIZE(&w->key),
+						  PAGE_SECTORS),
+				     GFP_KERNEL);
+			if (!io)
+				goto err;
 
-		w->private	= io;
-		io->dc		= dc;
+			w->private	= io;
+			io->dc		= dc;
+			io->sequence	= sequence++;
 
-		dirty_init(w);
-		io->bio.bi_iter.bi_sector = PTR_OFFSET(&w->key, 0);
-		io->bio.bi_bdev		= PTR_CACHE(dc->disk.c,
-						    &w->key, 0)->bdev;
-		io->bio.bi_rw		= READ;
-		io->bio.bi_end_io	= read_dirty_endio;
+			dirty_init(w);
+			io->bio.bi_iter.bi_sector = PTR_OFFSET(&w->key, 0);
+			io->bio.bi_bdev		= PTR_CACHE(dc->disk.c,
+							    &w->key, 0)->bdev;
+			io->bio.bi_rw		= READ;
+			io->bio.bi_end_io	= read_dirty_endio;
 
-		if (bio_alloc_pages(&io->bio, GFP_KERNEL))
-			goto err_free;
+			if (bio_alloc_pages(&io->bio, GFP_KERNEL))
+				goto err_free;
 
-		trace_bcache_writeback(&w->key);
+			trace_bcache_writeback(&w->key);
 
-		down(&dc->in_flight);
-		closure_call(&io->cl, read_dirty_submit, NULL, &cl);
+			down(&dc->in_flight);
+			closure_call(&io->cl, read_dirty_submit, NULL, &cl);
+		}
 
-		delay = writeback_delay(dc, KEY_SIZE(&w->key));
+		delay = writeback_delay(dc, size);
 	}
 
 	if (0) {
 err_free:
 		kfree(w->private);
 err:
-		bch_keybuf_del(&dc->writeback_keys, w);
+		for (; i < nk; i++)
+			bch_keybuf_del(&dc->writeback_keys, keys[i]);
 	}
 
+	/* Keys we took but never issued would otherwise stay claimed */
+	if (next)
+		bch_keybuf_del(&dc->writeback_keys, next);
+
 	/*
 	 * Wait for outstanding writeback IOs to finish (and keybuf slots to be
 	 * freed) before refilling again
@@ -9,7 +9,6 @@
 
 #include <linux/hash.h>
 #include <linux/module.h>
-#include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 
@@ -332,8 +331,13 @@ static dm_cblock_t infer_cblock(struct entry_pool *ep, struct entry *e)
 struct mq_policy {
 	struct dm_cache_policy policy;
 
-	/* protects everything */
-	struct mutex lock;
+	/*
+	 * Protects everything.  Nothing done under it sleeps, so it's a
+	 * spin lock: map() is called for every bio and a sleeping lock made
+	 * non-blocking callers give up and defer the bio to the worker
+	 * whenever the worker happened to hold it.
+	 */
+	spinlock_t lock;
 	dm_cblock_t cache_size;
 	struct io_tracker tracker;
 
@@ -361,7 +365,7 @@ struct mq_policy {
 	 *
 	 * Access to tick_protected should be done with the spin lock held.
 	 * It's copied to tick at the start of the map function (within the
-	 * mutex).
+	 * main lock).
 	 */
 	spinlock_t tick_lock;
 	unsigned tick_protected;
@@ -896,10 +900,7 @@ static int mq_map(struct dm_cache_policy *p, dm_oblock_t oblock,
 
 	result->op = POLICY_MISS;
 
-	if (can_block)
-		mutex_lock(&mq->lock);
-	else if (!mutex_trylock(&mq->lock))
-		return -EWOULDBLOCK;
+	spin_lock(&mq->lock);
 
 	copy_tick(mq);
 
@@ -907,7 +908,7 @@ static int mq_map(struct dm_cache_policy *p, dm_oblock_t oblock,
 	r = map(mq, oblock, can_migrate, discarded_oblock,
 		bio_data_dir(bio), result);
 
-	mutex_unlock(&mq->lock);
+	spin_unlock(&mq->lock);
 
 	return r;
 }
@@ -918,8 +919,7 @@ static int mq_lookup(struct dm_cache_policy *p, dm_oblock_t oblock, dm_cblock_t
 	struct mq_policy *mq = to_mq_policy(p);
 	struct entry *e;
 
-	if (!mutex_trylock(&mq->lock))
-		return -EWOULDBLOCK;
+	spin_lock(&mq->lock);
 
 	e = hash_lookup(mq, oblock);
 	if (e && in_cache(mq, e)) {
@@ -928,7 +928,7 @@ static int mq_lookup(struct dm_cache_policy *p, dm_oblock_t oblock, dm_cblock_t
 	} else
 		r = -ENOENT;
 
-	mutex_unlock(&mq->lock);
+	spin_unlock(&mq->lock);
 
 	return r;
 }
@@ -949,18 +949,18 @@ static void mq_set_dirty(struct dm_cache_policy *p, dm_oblock_t oblock)
 {
 	struct mq_policy *mq = to_mq_policy(p);
 
-	mutex_lock(&mq->lock);
+	spin_lock(&mq->lock);
 	__mq_set_clear_dirty(mq, oblock, true);
-	mutex_unlock(&mq->lock);
+	spin_unlock(&mq->lock);
 }
 
 static void mq_clear_dirty(struct dm_cache_policy *p, dm_oblock_t oblock)
 {
 	struct mq_policy *mq = to_mq_policy(p);
 
-	mutex_lock(&mq->lock);
+	spin_lock(&mq->lock);
 	__mq_set_clear_dirty(mq, oblock, false);
-	mutex_unlock(&mq->lock);
+	spin_unlock(&mq->lock);
 }
 
 static int mq_load_mapping(struct dm_cache_policy *p,
@@ -1004,14 +1004,15 @@ static int mq_walk_mappings(struct dm_cache_policy *p, policy_walk_fn fn,
 	struct mq_policy *mq = to_mq_policy(p);
 	int r = 0;
 
-	mutex_lock(&mq->lock);
-
+	/*
+	 * @fn writes to the metadata device and may sleep, so the lock
+	 * can't be held here.  The target only walks the mappings once
+	 * it's suspended, when nothing else calls into the policy.
+	 */
 	r = mq_save_hints(mq, &mq->cache_clean, fn, context);
 	if (!r)
 		r = mq_save_hints(mq, &mq->cache_dirty, fn, context);
 
-	mutex_unlock(&mq->lock);
-
 	return r;
 }
 
@@ -1030,9 +1031,9 @@ static void mq_remove_mapping(struct dm_cache_policy *p, dm_oblock_t oblock)
 {
 	struct mq_policy *mq = to_mq_policy(p);
 
-	mutex_lock(&mq->lock);
+	spin_lock(&mq->lock);
 	__remove_mapping(mq, oblock);
-	mutex_unlock(&mq->lock);
+	spin_unlock(&mq->lock);
 }
 
 static int __remove_cblock(struct mq_policy *mq, dm_cblock_t cblock)
@@ -1053,9 +1054,9 @@ static int mq_remove_cblock(struct dm_cache_policy *p, dm_cblock_t cblock)
 	int r;
 	struct mq_policy *mq = to_mq_policy(p);
 
-	mutex_lock(&mq->lock);
+	spin_lock(&mq->lock);
 	r = __remove_cblock(mq, cblock);
-	mutex_unlock(&mq->lock);
+	spin_unlock(&mq->lock);
 
 	return r;
 }
@@ -1082,9 +1083,9 @@ static int mq_writeback_work(struct dm_cache_policy *p, dm_oblock_t *oblock,
 	int r;
 	struct mq_policy *mq = to_mq_policy(p);
 
-	mutex_lock(&mq->lock);
+	spin_lock(&mq->lock);
 	r = __mq_writeback_work(mq, oblock, cblock);
-	mutex_unlock(&mq->lock);
+	spin_unlock(&mq->lock);
 
 	return r;
 }
@@ -1107,9 +1108,9 @@ static void mq_force_mapping(struct dm_cache_policy *p,
 {
 	struct mq_policy *mq = to_mq_policy(p);
 
-	mutex_lock(&mq->lock);
+	spin_lock(&mq->lock);
 	__force_mapping(mq, current_oblock, new_oblock);
-	mutex_unlock(&mq->lock);
+	spin_unlock(&mq->lock);
 }
 
 static dm_cblock_t mq_residency(struct dm_cache_policy *p)
@@ -1117,9 +1118,9 @@ static dm_cblock_t mq_residency(struct dm_cache_policy *p)
 	dm_cblock_t r;
 	struct mq_policy *mq = to_mq_policy(p);
 
-	mutex_lock(&mq->lock);
+	spin_lock(&mq->lock);
 	r = to_cblock(mq->cache_pool.nr_allocated);
-	mutex_unlock(&mq->lock);
+	spin_unlock(&mq->lock);
 
 	return r;
 }
@@ -1234,7 +1235,7 @@ static struct dm_cache_policy *mq_create(dm_cblock_t cache_size,
 	mq->discard_promote_adjustment = DEFAULT_DISCARD_PROMOTE_ADJUSTMENT;
 	mq->read_promote_adjustment = DEFAULT_READ_PROMOTE_ADJUSTMENT;
 	mq->write_promote_adjustment = DEFAULT_WRITE_PROMOTE_ADJUSTMENT;
-	mutex_init(&mq->lock);
+	spin_lock_init(&mq->lock);
 	spin_lock_init(&mq->tick_lock);
 
 	queue_init(&mq->pre_cache);
@@ -1265,7 +1266,7 @@ bad_pre_cache_init:
 
 static struct dm_cache_policy_type mq_policy_type = {
 	.name = "mq",
-	.version = {1, 2, 0},
+	.version = {1, 3, 0},
 	.hint_size = 4,
 	.owner = THIS_MODULE,
 	.create = mq_create
@@ -1273,7 +1274,7 @@ static struct dm_cache_policy_type mq_policy_type = {
 
 static struct dm_cache_policy_type default_policy_type = {
 	.name = "default",
-	.version = {1, 2, 0},
+	.version = {1, 3, 0},
 	.hint_size = 4,
 	.owner = THIS_MODULE,
 	.create = mq_create,
@@ -108,7 +108,7 @@ struct iv_tcw_private {
  * Crypt: maps a linear range of a block device
  * and encrypts / decrypts at the same time.
  */
-enum flags { DM_CRYPT_SUSPENDED, DM_CRYPT_KEY_VALID };
+enum flags { DM_CRYPT_SUSPENDED, DM_CRYPT_KEY_VALID, DM_CRYPT_INLINE_WRITE };
 
 /*
  * The fields in here must be read only after initialization.
@@ -948,16 +948,16 @@ static int crypt_convert(struct crypt_config *cc,
  * *out_of_pages set to 1.
  */
 static struct bio *crypt_alloc_buffer(struct dm_crypt_io *io, unsigned size,
-				      unsigned *out_of_pages)
+				      gfp_t gfp, unsigned *out_of_pages)
 {
 	struct crypt_config *cc = io->cc;
 	struct bio *clone;
 	unsigned int nr_iovecs = (size + PAGE_SIZE - 1) >> PAGE_SHIFT;
-	gfp_t gfp_mask = GFP_NOIO | __GFP_HIGHMEM;
+	gfp_t gfp_mask = gfp | __GFP_HIGHMEM;
 	unsigned i, len;
 	struct page *page;
 
-	clone = bio_alloc_bioset(GFP_NOIO, nr_iovecs, cc->bs);
+	clone = bio_alloc_bioset(gfp, nr_iovecs, cc->bs);
 	if (!clone)
 		return NULL;
 
@@ -1209,7 +1209,8 @@ static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 	 * so repeat the whole process until all the data can be handled.
 	 */
 	while (remaining) {
-		clone = crypt_alloc_buffer(io, remaining, &out_of_pages);
+		clone = crypt_alloc_buffer(io, remaining, GFP_NOIO,
+					   &out_of_pages);
 		if (unlikely(!clone)) {
 			io->error = -ENOMEM;
 			break;
@@ -1281,6 +1282,55 @@ static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 	crypt_dec_pending(io);
 }
 
+/*
+ * Encrypt a write in the context that submitted it and pass the clone on
+ * right away, saving the round trip through kcryptd.  This runs under
+ * generic_make_request(), so clones issued by this task earlier are still
+ * parked on current->bio_list and the memory they pin won't come back
+ * before we return: nothing here may wait for it.  If the whole bio can't
+ * be buffered without waiting, leave it to kcryptd.
+ */
+static void kcryptd_crypt_write_inline(struct dm_crypt_io *io)
+{
+	struct crypt_config *cc = io->cc;
+	unsigned size = io->base_bio->bi_iter.bi_size;
+	struct bio *clone;
+	unsigned out_of_pages;
+	int r;
+
+	io->ctx.req = mempool_alloc(cc->req_pool, GFP_NOWAIT);
+	if (unlikely(!io->ctx.req))
+		goto queue;
+
+	clone = crypt_alloc_buffer(io, size, GFP_NOWAIT, &out_of_pages);
+	if (unlikely(!clone))
+		goto queue;
+	if (unlikely(clone->bi_iter.bi_size != size)) {
+		crypt_free_buffer_pages(cc, clone);
+		bio_put(clone);
+		goto queue;
+	}
+
+	crypt_inc_pending(io);
+	crypt_convert_init(cc, &io->ctx, clone, io->base_bio, io->sector);
+
+	crypt_inc_pending(io);
+
+	r = crypt_convert(cc, &io->ctx);
+	if (r < 0)
+		io->error = -EIO;
+
+	/* a synchronous cipher is done by now, an async one submits later */
+	if (atomic_dec_and_test(&io->ctx.cc_pending))
+		kcryptd_crypt_write_io_submit(io, 0);
+
+	crypt_dec_pending(io);
+	return;
+
+queue:
+	kcryptd_queue_crypt(io);
+}
+
 static void kcryptd_crypt_read_done(struct dm_crypt_io *io)
 {
 	crypt_dec_pending(io);
@@ -1686,7 +1736,7 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	char dummy;
 
 	static struct dm_arg _args[] = {
-		{0, 1, "Invalid number of feature args"},
+		{0, 2, "Invalid number of feature args"},
 	};
 
 	if (argc < 5) {
@@ -1770,15 +1820,23 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		if (ret)
 			goto bad;
 
-		opt_string = dm_shift_arg(&as);
+		while (opt_params--) {
+			opt_string = dm_shift_arg(&as);
+			if (!opt_string) {
+				ret = -EINVAL;
+				ti->error = "Not enough feature arguments";
+				goto bad;
+			}
 
-		if (opt_params == 1 && opt_string &&
-		    !strcasecmp(opt_string, "allow_discards"))
-			ti->num_discard_bios = 1;
-		else if (opt_params) {
-			ret = -EINVAL;
-			ti->error = "Invalid feature arguments";
-			goto bad;
+			if (!strcasecmp(opt_string, "allow_discards"))
+				ti->num_discard_bios = 1;
+			else if (!strcasecmp(opt_string, "inline_write"))
+				set_bit(DM_CRYPT_INLINE_WRITE, &cc->flags);
+			else {
+				ret = -EINVAL;
+				ti->error = "Invalid feature arguments";
+				goto bad;
+			}
 		}
 	}
 
@@ -1829,7 +1887,9 @@ static int crypt_map(struct dm_target *ti, struct bio *bio)
 	if (bio_data_dir(io->base_bio) == READ) {
 		if (kcryptd_io_read(io, GFP_NOWAIT))
 			kcryptd_queue_io(io);
-	} else
+	} else if (test_bit(DM_CRYPT_INLINE_WRITE, &cc->flags))
+		kcryptd_crypt_write_inline(io);
+	else
 		kcryptd_queue_crypt(io);
 
 	return DM_MAPIO_SUBMITTED;
@@ -1840,6 +1900,7 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 {
 	struct crypt_config *cc = ti->private;
 	unsigned i, sz = 0;
+	int num_feature_args = 0;
 
 	switch (type) {
 	case STATUSTYPE_INFO:
@@ -1858,8 +1919,15 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 		DMEMIT(" %llu %s %llu", (unsigned long long)cc->iv_offset,
 				cc->dev->name, (unsigned long long)cc->start);
 
-		if (ti->num_discard_bios)
-			DMEMIT(" 1 allow_discards");
+		num_feature_args += !!ti->num_discard_bios;
+		num_feature_args += !!test_bit(DM_CRYPT_INLINE_WRITE, &cc->flags);
+		if (num_feature_args) {
+			DMEMIT(" %d", num_feature_args);
+			if (ti->num_discard_bios)
+				DMEMIT(" allow_discards");
+			if (test_bit(DM_CRYPT_INLINE_WRITE, &cc->flags))
+				DMEMIT(" inline_write");
+		}
 
 		break;
 	}
@@ -1956,7 +2024,7 @@ static int crypt_iterate_devices(struct dm_target *ti,
 
 static struct target_type crypt_target = {
 	.name   = "crypt",
-	.version = {1, 13, 0},
+	.version = {1, 14, 0},
 	.module = THIS_MODULE,
 	.ctr    = crypt_ctr,
 	.dtr    = crypt_dtr,
@@ -10,6 +10,7 @@
 #include <linux/module.h>
 #include <linux/vmalloc.h>
 #include <linux/blkdev.h>
+#include <linux/blk-mq.h>
 #include <linux/namei.h>
 #include <linux/ctype.h>
 #include <linux/string.h>
@@ -861,6 +862,7 @@ static int dm_table_set_type(struct dm_table *t)
 {
 	unsigned i;
 	unsigned bio_based = 0, request_based = 0, hybrid = 0;
+	bool use_blk_mq = false, use_old_rq = false;
 	struct dm_target *tgt;
 	struct dm_dev_internal *dd;
 	struct list_head *devices;
@@ -889,7 +891,8 @@ static int dm_table_set_type(struct dm_table *t)
 		 * Default to bio-based if device is new.
 		 */
 		live_md_type = dm_get_md_type(t->md);
-		if (live_md_type == DM_TYPE_REQUEST_BASED)
+		if (live_md_type == DM_TYPE_REQUEST_BASED ||
+		    live_md_type == DM_TYPE_MQ_REQUEST_BASED)
 			request_based = 1;
 		else
 			bio_based = 1;
@@ -906,11 +909,29 @@ static int dm_table_set_type(struct dm_table *t)
 	/* Non-request-stackable devices can't be used for request-based dm */
 	devices = dm_table_get_devices(t);
 	list_for_each_entry(dd, devices, list) {
-		if (!blk_queue_stackable(bdev_get_queue(dd->dm_dev.bdev))) {
+		struct request_queue *q = bdev_get_queue(dd->dm_dev.bdev);
+
+		if (!blk_queue_stackable(q)) {
 			DMWARN("table load rejected: including"
 			       " non-request-stackable devices");
 			return -EINVAL;
 		}
+
+		if (q->mq_ops)
+			use_blk_mq = true;
+		else
+			use_old_rq = true;
+	}
+
+	/*
+	 * Clones are allocated from the underlying blk-mq queues but
+	 * embedded in dm's own structures otherwise, so all devices of a
+	 * table must be of one kind.
+	 */
+	if (use_blk_mq && use_old_rq) {
+		DMWARN("table load rejected: mixing blk-mq and"
+		       " non-blk-mq underlying devices");
+		return -EINVAL;
 	}
 
 	/*
@@ -924,7 +945,16 @@ static int dm_table_set_type(struct dm_table *t)
 		return -EINVAL;
 	}
 
-	t->type = DM_TYPE_REQUEST_BASED;
+	if (use_blk_mq) {
+		tgt = dm_table_get_target(t, 0);
+		if (!tgt->type->clone_and_map_rq) {
+			DMWARN("table load rejected: target does not"
+			       " support blk-mq underlying devices");
+			return -EINVAL;
+		}
+		t->type = DM_TYPE_MQ_REQUEST_BASED;
+	} else
+		t->type = DM_TYPE_REQUEST_BASED;
 
 	return 0;
 }
@@ -941,7 +971,10 @@ struct target_type *dm_table_get_immutable_target_type(struct dm_table *t)
 
 bool dm_table_request_based(struct dm_table *t)
 {
-	return dm_table_get_type(t) == DM_TYPE_REQUEST_BASED;
+	unsigned type = dm_table_get_type(t);
+
+	return type == DM_TYPE_REQUEST_BASED ||
+	       type == DM_TYPE_MQ_REQUEST_BASED;
 }
 
 static int dm_table_alloc_md_mempools(struct dm_table *t)
@@ -1628,7 +1661,10 @@ void dm_table_run_md_queue_async(struct dm_table *t)
 
 	md = dm_table_get_md(t);
 	queue = dm_get_md_queue(md);
-	if (queue) {
+	if (queue && queue->mq_ops) {
+		/* also kicks hw queues backing off a busy target */
+		blk_mq_start_stopped_hw_queues(queue, true);
+	} else if (queue) {
 		spin_lock_irqsave(queue->queue_lock, flags);
 		blk_run_queue_async(queue);
 		spin_unlock_irqrestore(queue->queue_lock, flags);
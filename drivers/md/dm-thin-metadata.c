@@ -10,6 +10,7 @@
 #include "persistent-data/dm-space-map-disk.h"
 #include "persistent-data/dm-transaction-manager.h"
 
+#include <linux/hash.h>
 #include <linux/list.h>
 #include <linux/device-mapper.h>
 #include <linux/workqueue.h>
@@ -201,6 +202,25 @@ struct dm_pool_metadata {
 	__u8 metadata_space_map_root[SPACE_MAP_ROOT_SIZE];
 };
 
+/*
+ * A small direct-mapped cache of recently looked up mappings sits in front
+ * of the mapping btree.  A hit spares the btree walk, and lets the
+ * non-blocking lookup in the bio map path succeed while the pool worker
+ * holds root_lock to insert a mapping or commit.
+ *
+ * Entries are only filled in with root_lock held for read, and only
+ * changed with it held for write, so an entry is never older than the
+ * btree.  mapping_lock just keeps the entries themselves consistent.
+ */
+#define MAPPING_CACHE_BITS 8
+#define MAPPING_CACHE_SIZE (1 << MAPPING_CACHE_BITS)
+#define MAPPING_CACHE_EMPTY ((dm_block_t) -1)
+
+struct mapping_cache_entry {
+	dm_block_t block;
+	uint64_t block_time;
+};
+
 struct dm_thin_device {
 	struct list_head list;
 	struct dm_pool_metadata *pmd;
@@ -213,6 +233,9 @@ struct dm_thin_device {
 	uint64_t transaction_id;
 	uint32_t creation_time;
 	uint32_t snapshotted_time;
+
+	spinlock_t mapping_lock;
+	struct mapping_cache_entry mapping_cache[MAPPING_CACHE_SIZE];
 };
 
 /*----------------------------------------------------------------
@@ -894,6 +917,69 @@ int dm_pool_metadata_close(struct dm_pool_metadata *pmd)
 	return 0;
 }
 
+/*----------------------------------------------------------------
+ * Mapping cache
+ *--------------------------------------------------------------*/
+
+static struct mapping_cache_entry *mapping_cache_slot(struct dm_thin_device *td,
+						      dm_block_t block)
+{
+	return td->mapping_cache + hash_64(block, MAPPING_CACHE_BITS);
+}
+
+static bool mapping_cache_lookup(struct dm_thin_device *td, dm_block_t block,
+				 uint64_t *block_time)
+{
+	struct mapping_cache_entry *e = mapping_cache_slot(td, block);
+	bool hit;
+
+	spin_lock(&td->mapping_lock);
+	hit = e->block == block;
+	if (hit)
+		*block_time = e->block_time;
+	spin_unlock(&td->mapping_lock);
+
+	return hit;
+}
+
+/*
+ * Caller holds root_lock, for read if @block_time came from the btree,
+ * for write if it is about to go into it.
+ */
+static void mapping_cache_set(struct dm_thin_device *td, dm_block_t block,
+			      uint64_t block_time)
+{
+	struct mapping_cache_entry *e = mapping_cache_slot(td, block);
+
+	spin_lock(&td->mapping_lock);
+	e->block = block;
+	e->block_time = block_time;
+	spin_unlock(&td->mapping_lock);
+}
+
+/*
+ * Caller holds root_lock for write.
+ */
+static void mapping_cache_invalidate(struct dm_thin_device *td, dm_block_t block)
+{
+	struct mapping_cache_entry *e = mapping_cache_slot(td, block);
+
+	spin_lock(&td->mapping_lock);
+	if (e->block == block)
+		e->block = MAPPING_CACHE_EMPTY;
+	spin_unlock(&td->mapping_lock);
+}
+
+static void mapping_cache_clear(struct dm_thin_device *td)
+{
+	unsigned i;
+
+	spin_lock(&td->mapping_lock);
+	for (i = 0; i < MAPPING_CACHE_SIZE; i++)
+		td->mapping_cache[i].block = MAPPING_CACHE_EMPTY;
+	spin_unlock(&td->mapping_lock);
+}
+
 /*
  * __open_device: Returns @td corresponding to device with id @dev,
  * creating it if @create is set and incrementing @td->open_count.
@@ -957,6 +1043,9 @@ static int __open_device(struct dm_pool_metadata *pmd,
 	(*td)->creation_time = le32_to_cpu(details_le.creation_time);
 	(*td)->snapshotted_time = le32_to_cpu(details_le.snapshotted_time);
 
+	spin_lock_init(&(*td)->mapping_lock);
+	mapping_cache_clear(*td);
+
 	list_add(&(*td)->list, &pmd->thin_devices);
 
 	return 0;
@@ -1393,6 +1482,11 @@ int dm_thin_find_block(struct dm_thin_device *td, dm_block_t block,
 	dm_block_t keys[2] = { td->id, block };
 	struct dm_btree_info *info;
 
+	if (mapping_cache_lookup(td, block, &block_time)) {
+		r = 0;
+		goto found;
+	}
+
 	if (can_block) {
 		down_read(&pmd->root_lock);
 		info = &pmd->info;
@@ -1405,12 +1499,15 @@ int dm_thin_find_block(struct dm_thin_device *td, dm_block_t block,
 		goto out;
 
 	r = dm_btree_lookup(info, pmd->root, keys, &value);
-	if (!r)
+	if (!r) {
 		block_time = le64_to_cpu(value);
+		mapping_cache_set(td, block, block_time);
+	}
 
 out:
 	up_read(&pmd->root_lock);
 
+found:
 	if (!r) {
 		dm_block_t exception_block;
 		uint32_t exception_time;
@@ -1427,17 +1524,23 @@ static int __insert(struct dm_thin_device *td, dm_block_t block,
 		    dm_block_t data_block)
 {
 	int r, inserted;
+	uint64_t block_time;
 	__le64 value;
 	struct dm_pool_metadata *pmd = td->pmd;
 	dm_block_t keys[2] = { td->id, block };
 
-	value = cpu_to_le64(pack_block_time(data_block, pmd->time));
+	block_time = pack_block_time(data_block, pmd->time);
+	value = cpu_to_le64(block_time);
 	__dm_bless_for_disk(&value);
 
 	r = dm_btree_insert_notify(&pmd->info, pmd->root, keys, &value,
 				   &pmd->root, &inserted);
-	if (r)
+	if (r) {
+		mapping_cache_invalidate(td, block);
 		return r;
+	}
+
+	mapping_cache_set(td, block, block_time);
 
 	td->changed = 1;
 	if (inserted)
@@ -1465,6 +1568,8 @@ static int __remove(struct dm_thin_device *td, dm_block_t block)
 	struct dm_pool_metadata *pmd = td->pmd;
 	dm_block_t keys[2] = { td->id, block };
 
+	mapping_cache_invalidate(td, block);
+
 	r = dm_btree_remove(&pmd->info, pmd->root, keys, &pmd->root);
 	if (r)
 		return r;
@@ -1577,8 +1682,11 @@ static void __set_abort_with_changes_flags(struct dm_pool_metadata *pmd)
 {
 	struct dm_thin_device *td;
 
-	list_for_each_entry(td, &pmd->thin_devices, list)
+	list_for_each_entry(td, &pmd->thin_devices, list) {
 		td->aborted_with_changes = td->changed;
+		/* Rolling back may undo mappings the cache holds */
+		mapping_cache_clear(td);
+	}
 }
 
 int dm_pool_abort_metadata(struct dm_pool_metadata *pmd)
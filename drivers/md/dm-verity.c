@@ -41,6 +41,7 @@ struct dm_verity {
 	struct crypto_shash *tfm;
 	u8 *root_digest;	/* digest of the root block */
 	u8 *salt;		/* salt: its size is salt_size */
+	u8 *initial_hashstate;	/* exported hash state after the salt */
 	unsigned salt_size;
 	sector_t data_start;	/* data offset in 512-byte sectors */
 	sector_t hash_start;	/* hash start in blocks */
@@ -174,6 +175,77 @@ static void verity_hash_at_level(struct dm_verity *v, sector_t block, int level,
 		*offset = idx << (v->hash_dev_block_bits - v->hash_per_block_bits);
 }
 
+/*
+ * Start hashing a block.  For format version 1 the salt is hashed first,
+ * and the state after it has been precomputed by verity_ctr(), so it only
+ * needs to be imported.
+ */
+static int verity_hash_init(struct dm_verity *v, struct shash_desc *desc)
+{
+	int r;
+
+	desc->tfm = v->tfm;
+	desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	if (likely(v->initial_hashstate)) {
+		r = crypto_shash_import(desc, v->initial_hashstate);
+		if (r < 0)
+			DMERR("crypto_shash_import failed: %d", r);
+		return r;
+	}
+
+	r = crypto_shash_init(desc);
+	if (r < 0) {
+		DMERR("crypto_shash_init failed: %d", r);
+		return r;
+	}
+
+	if (likely(v->version >= 1)) {
+		r = crypto_shash_update(desc, v->salt, v->salt_size);
+		if (r < 0)
+			DMERR("crypto_shash_update failed: %d", r);
+	}
+
+	return r;
+}
+
+static int verity_hash_update(struct dm_verity *v, struct shash_desc *desc,
+			      const u8 *data, size_t len)
+{
+	int r = crypto_shash_update(desc, data, len);
+
+	if (unlikely(r < 0))
+		DMERR("crypto_shash_update failed: %d", r);
+
+	return r;
+}
+
+/*
+ * Hash the last piece of a block and produce the digest.  This goes
+ * through finup(), so that accelerated implementations can process the
+ * tail and the padding in one go instead of in separate update() and
+ * final() calls.
+ */
+static int verity_hash_finup(struct dm_verity *v, struct shash_desc *desc,
+			     const u8 *data, size_t len, u8 *digest)
+{
+	int r;
+
+	if (unlikely(!v->version)) {
+		r = verity_hash_update(v, desc, data, len);
+		if (r < 0)
+			return r;
+		data = v->salt;
+		len = v->salt_size;
+	}
+
+	r = crypto_shash_finup(desc, data, len, digest);
+	if (unlikely(r < 0))
+		DMERR("crypto_shash_finup failed: %d", r);
+
+	return r;
+}
+
 /*
  * Verify hash of a metadata block pertaining to the specified data block
  * ("block" argument) at a specified level ("level" argument).
@@ -214,42 +286,15 @@ static int verity_verify_level(struct dm_verity_io *io, sector_t block,
 		}
 
 		desc = io_hash_desc(v, io);
-		desc->tfm = v->tfm;
-		desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
-		r = crypto_shash_init(desc);
-		if (r < 0) {
-			DMERR("crypto_shash_init failed: %d", r);
+		r = verity_hash_init(v, desc);
+		if (r < 0)
 			goto release_ret_r;
-		}
-
-		if (likely(v->version >= 1)) {
-			r = crypto_shash_update(desc, v->salt, v->salt_size);
-			if (r < 0) {
-				DMERR("crypto_shash_update failed: %d", r);
-				goto release_ret_r;
-			}
-		}
-
-		r = crypto_shash_update(desc, data, 1 << v->hash_dev_block_bits);
-		if (r < 0) {
-			DMERR("crypto_shash_update failed: %d", r);
-			goto release_ret_r;
-		}
-
-		if (!v->version) {
-			r = crypto_shash_update(desc, v->salt, v->salt_size);
-			if (r < 0) {
-				DMERR("crypto_shash_update failed: %d", r);
-				goto release_ret_r;
-			}
-		}
 
 		result = io_real_digest(v, io);
-		r = crypto_shash_final(desc, result);
-		if (r < 0) {
-			DMERR("crypto_shash_final failed: %d", r);
+		r = verity_hash_finup(v, desc, data,
+				      1 << v->hash_dev_block_bits, result);
+		if (r < 0)
 			goto release_ret_r;
-		}
 		if (unlikely(memcmp(result, io_want_digest(v, io), v->digest_size))) {
 			DMERR_LIMIT("metadata block %llu is corrupted",
 				(unsigned long long)hash_block);
@@ -315,21 +360,11 @@ static int verity_verify_io(struct dm_verity_io *io)
 
 test_block_hash:
 		desc = io_hash_desc(v, io);
-		desc->tfm = v->tfm;
-		desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
-		r = crypto_shash_init(desc);
-		if (r < 0) {
-			DMERR("crypto_shash_init failed: %d", r);
+		r = verity_hash_init(v, desc);
+		if (r < 0)
 			return r;
-		}
 
-		if (likely(v->version >= 1)) {
-			r = crypto_shash_update(desc, v->salt, v->salt_size);
-			if (r < 0) {
-				DMERR("crypto_shash_update failed: %d", r);
-				return r;
-			}
-		}
+		result = io_real_digest(v, io);
 		todo = 1 << v->data_dev_block_bits;
 		do {
 			u8 *page;
@@ -338,34 +373,21 @@ test_block_hash:
 
 			page = kmap_atomic(bv.bv_page);
 			len = bv.bv_len;
-			if (likely(len >= todo))
+			if (likely(len >= todo)) {
 				len = todo;
-			r = crypto_shash_update(desc, page + bv.bv_offset, len);
+				r = verity_hash_finup(v, desc, page + bv.bv_offset,
+						      len, result);
+			} else
+				r = verity_hash_update(v, desc,
+						       page + bv.bv_offset, len);
 			kunmap_atomic(page);
 
-			if (r < 0) {
-				DMERR("crypto_shash_update failed: %d", r);
+			if (r < 0)
 				return r;
-			}
 
 			bio_advance_iter(bio, &io->iter, len);
 			todo -= len;
 		} while (todo);
-
-		if (!v->version) {
-			r = crypto_shash_update(desc, v->salt, v->salt_size);
-			if (r < 0) {
-				DMERR("crypto_shash_update failed: %d", r);
-				return r;
-			}
-		}
-
-		result = io_real_digest(v, io);
-		r = crypto_shash_final(desc, result);
-		if (r < 0) {
-			DMERR("crypto_shash_final failed: %d", r);
-			return r;
-		}
 		if (unlikely(memcmp(result, io_want_digest(v, io), v->digest_size))) {
 			DMERR_LIMIT("data block %llu is corrupted",
 				(unsigned long long)(io->block + b));
@@ -614,6 +636,7 @@ static void verity_dtr(struct dm_target *ti)
 		dm_bufio_client_destroy(v->bufio);
 
 	kfree(v->salt);
+	kfree(v->initial_hashstate);
 	kfree(v->root_digest);
 
 	if (v->tfm)
@@ -790,6 +813,31 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		}
 	}
 
+	if (v->version >= 1) {
+		struct shash_desc *desc;
+
+		desc = kmalloc(v->shash_descsize, GFP_KERNEL);
+		v->initial_hashstate = kmalloc(crypto_shash_statesize(v->tfm),
+					       GFP_KERNEL);
+		if (!desc || !v->initial_hashstate) {
+			kfree(desc);
+			ti->error = "Cannot allocate initial hash state";
+			r = -ENOMEM;
+			goto bad;
+		}
+
+		desc->tfm = v->tfm;
+		desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
+		r = crypto_shash_init(desc) ?:
+		    crypto_shash_update(desc, v->salt, v->salt_size) ?:
+		    crypto_shash_export(desc, v->initial_hashstate);
+		kfree(desc);
+		if (r) {
+			ti->error = "Cannot set up initial hash state";
+			goto bad;
+		}
+	}
+
 	v->hash_per_block_bits =
 		__fls((1 << v->hash_dev_block_bits) / v->digest_size);
 
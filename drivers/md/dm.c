@@ -14,6 +14,7 @@
 #include <linux/moduleparam.h>
 #include <linux/blkpg.h>
 #include <linux/bio.h>
+#include <linux/blk-mq.h>
 #include <linux/mempool.h>
 #include <linux/slab.h>
 #include <linux/idr.h>
@@ -72,14 +73,19 @@ struct dm_io {
 
 /*
  * For request-based dm.
- * One of these is allocated per request.
+ * One of these is allocated per request, from md->io_pool or, when
+ * md->queue is a blk-mq queue, as the pdu of the original request.
+ *
+ * clone points to clone_rq unless the underlying devices are blk-mq, in
+ * which case the target allocates the clone from the chosen path's queue.
  */
 struct dm_rq_target_io {
 	struct mapped_device *md;
 	struct dm_target *ti;
-	struct request *orig, clone;
+	struct request *orig, *clone;
 	int error;
 	union map_info info;
+	struct request clone_rq;
 };
 
 /*
@@ -202,6 +208,9 @@ struct mapped_device {
 	struct bio flush_bio;
 
 	struct dm_stats stats;
+
+	/* for request-based devices on top of blk-mq, see use_blk_mq */
+	struct blk_mq_tag_set tag_set;
 };
 
 /*
@@ -228,6 +237,14 @@ static unsigned reserved_bio_based_ios = RESERVED_BIO_BASED_IOS;
  */
 static unsigned reserved_rq_based_ios = RESERVED_REQUEST_BASED_IOS;
 
+/*
+ * Whether request-based DM devices created from now on use blk-mq for
+ * their own queue, and how that queue is shaped.
+ */
+static bool use_blk_mq;
+static unsigned dm_mq_nr_hw_queues = 1;
+static unsigned dm_mq_queue_depth = 2048;
+
 static unsigned __dm_get_reserved_ios(unsigned *reserved_ios,
 				      unsigned def, unsigned max)
 {
@@ -879,8 +896,10 @@ static void rq_completed(struct mapped_device *md, int rw, int run_queue)
 	 * inside their request_fn (and holding the queue lock). Calling
 	 * back into ->request_fn() could deadlock attempting to grab the
 	 * queue lock again.
+	 *
+	 * blk-mq runs its hardware queues by itself.
 	 */
-	if (run_queue)
+	if (run_queue && !md->queue->mq_ops)
 		blk_run_queue_async(md->queue);
 
 	/*
@@ -889,17 +908,41 @@ static void rq_completed(struct mapped_device *md, int rw, int run_queue)
 	dm_put(md);
 }
 
+static struct dm_rq_target_io *tio_from_request(struct request *rq)
+{
+	return rq->q->mq_ops ? blk_mq_rq_to_pdu(rq) : rq->special;
+}
+
 static void free_rq_clone(struct request *clone)
 {
 	struct dm_rq_target_io *tio = clone->end_io_data;
 
 	blk_rq_unprep_clone(clone);
-	free_rq_tio(tio);
+
+	if (clone != &tio->clone_rq)
+		/* the target allocated it from a blk-mq underlying device */
+		tio->ti->type->release_clone_rq(clone);
+	tio->clone = NULL;
+
+	if (!tio->md->queue->mq_ops)
+		free_rq_tio(tio);
+}
+
+/*
+ * Complete the original request, which may be a blk-mq one.
+ */
+static void dm_end_original_request(struct request *rq, int error)
+{
+	if (rq->q->mq_ops)
+		blk_mq_end_io(rq, error);
+	else
+		blk_end_request_all(rq, error);
 }
 
 /*
  * Complete the clone and the original request.
- * Must be called without queue lock.
+ * Must be called without clone's queue lock held,
+ * see end_clone_request() for more details.
  */
 static void dm_end_request(struct request *clone, int error)
 {
@@ -922,29 +965,28 @@ static void dm_end_request(struct request *clone, int error)
 	}
 
 	free_rq_clone(clone);
-	blk_end_request_all(rq, error);
+	dm_end_original_request(rq, error);
 	rq_completed(md, rw, true);
 }
 
 static void dm_unprep_request(struct request *rq)
 {
-	struct request *clone = rq->special;
+	struct dm_rq_target_io *tio = rq->special;
 
 	rq->special = NULL;
 	rq->cmd_flags &= ~REQ_DONTPREP;
 
-	free_rq_clone(clone);
+	if (tio->clone)
+		free_rq_clone(tio->clone);
+	else
+		free_rq_tio(tio);
 }
 
 /*
  * Requeue the original request of a clone.
  */
-void dm_requeue_unmapped_request(struct request *clone)
+static void dm_old_requeue_request(struct request *rq)
 {
-	int rw = rq_data_dir(clone);
-	struct dm_rq_target_io *tio = clone->end_io_data;
-	struct mapped_device *md = tio->md;
-	struct request *rq = tio->orig;
 	struct request_queue *q = rq->q;
 	unsigned long flags;
 
@@ -953,9 +995,38 @@ void dm_requeue_unmapped_request(struct request *clone)
 	spin_lock_irqsave(q->queue_lock, flags);
 	blk_requeue_request(q, rq);
 	spin_unlock_irqrestore(q->queue_lock, flags);
+}
+
+static void dm_mq_requeue_request(struct request *rq)
+{
+	struct dm_rq_target_io *tio = blk_mq_rq_to_pdu(rq);
+
+	if (tio->clone)
+		free_rq_clone(tio->clone);
+
+	blk_mq_requeue_request(rq);
+	blk_mq_kick_requeue_list(rq->q);
+}
+
+static void dm_requeue_original_request(struct mapped_device *md,
+					struct request *rq)
+{
+	int rw = rq_data_dir(rq);
+
+	if (rq->q->mq_ops)
+		dm_mq_requeue_request(rq);
+	else
+		dm_old_requeue_request(rq);
 
 	rq_completed(md, rw, 0);
 }
+
+void dm_requeue_unmapped_request(struct request *clone)
+{
+	struct dm_rq_target_io *tio = clone->end_io_data;
+
+	dm_requeue_original_request(tio->md, tio->orig);
+}
 EXPORT_SYMBOL_GPL(dm_requeue_unmapped_request);
 
 static void __stop_queue(struct request_queue *q)
@@ -967,6 +1038,11 @@ static void stop_queue(struct request_queue *q)
 {
 	unsigned long flags;
 
+	if (q->mq_ops) {
+		blk_mq_stop_hw_queues(q);
+		return;
+	}
+
 	spin_lock_irqsave(q->queue_lock, flags);
 	__stop_queue(q);
 	spin_unlock_irqrestore(q->queue_lock, flags);
@@ -982,6 +1058,11 @@ static void start_queue(struct request_queue *q)
 {
 	unsigned long flags;
 
+	if (q->mq_ops) {
+		blk_mq_start_stopped_hw_queues(q, true);
+		return;
+	}
+
 	spin_lock_irqsave(q->queue_lock, flags);
 	__start_queue(q);
 	spin_unlock_irqrestore(q->queue_lock, flags);
@@ -1025,8 +1106,23 @@ static void dm_done(struct request *clone, int error, bool mapped)
 static void dm_softirq_done(struct request *rq)
 {
 	bool mapped = true;
-	struct request *clone = rq->completion_data;
-	struct dm_rq_target_io *tio = clone->end_io_data;
+	struct dm_rq_target_io *tio = tio_from_request(rq);
+	struct request *clone = tio->clone;
+
+	if (!clone) {
+		/* killed before the target got to allocate a clone */
+		struct mapped_device *md = tio->md;
+		int rw = rq_data_dir(rq);
+
+		if (!rq->q->mq_ops) {
+			rq->special = NULL;
+			rq->cmd_flags &= ~REQ_DONTPREP;
+			free_rq_tio(tio);
+		}
+		dm_end_original_request(rq, tio->error);
+		rq_completed(md, rw, true);
+		return;
+	}
 
 	if (rq->cmd_flags & REQ_FAILED)
 		mapped = false;
@@ -1038,14 +1134,26 @@ static void dm_softirq_done(struct request *rq)
  * Complete the clone and the original request with the error status
  * through softirq context.
  */
-static void dm_complete_request(struct request *clone, int error)
+static void dm_complete_request(struct request *rq, int error)
 {
-	struct dm_rq_target_io *tio = clone->end_io_data;
-	struct request *rq = tio->orig;
+	struct dm_rq_target_io *tio = tio_from_request(rq);
 
 	tio->error = error;
-	rq->completion_data = clone;
-	blk_complete_request(rq);
+	if (rq->q->mq_ops)
+		blk_mq_complete_request(rq);
+	else
+		blk_complete_request(rq);
+}
+
+/*
+ * Complete the not-mapped original request with the error status
+ * through softirq context.
+ * Target's rq_end_io() function isn't called.
+ */
+static void dm_kill_request(struct request *rq, int error)
+{
+	rq->cmd_flags |= REQ_FAILED;
+	dm_complete_request(rq, error);
 }
 
 /*
@@ -1057,35 +1165,37 @@ static void dm_complete_request(struct request *clone, int error)
 void dm_kill_unmapped_request(struct request *clone, int error)
 {
 	struct dm_rq_target_io *tio = clone->end_io_data;
-	struct request *rq = tio->orig;
 
-	rq->cmd_flags |= REQ_FAILED;
-	dm_complete_request(clone, error);
+	dm_kill_request(tio->orig, error);
 }
 EXPORT_SYMBOL_GPL(dm_kill_unmapped_request);
 
 /*
- * Called with the queue lock held
+ * Called with the clone's queue lock held (for non-blk-mq)
  */
 static void end_clone_request(struct request *clone, int error)
 {
-	/*
-	 * For just cleaning up the information of the queue in which
-	 * the clone was dispatched.
-	 * The clone is *NOT* freed actually here because it is alloced from
-	 * dm own mempool and REQ_ALLOCED isn't set in clone->cmd_flags.
-	 */
-	__blk_put_request(clone->q, clone);
+	struct dm_rq_target_io *tio = clone->end_io_data;
+
+	if (!clone->q->mq_ops) {
+		/*
+		 * For just cleaning up the information of the queue in which
+		 * the clone was dispatched.
+		 * The clone is *NOT* freed actually here because it is alloced
+		 * from dm own mempool (REQ_ALLOCED isn't set).
+		 */
+		__blk_put_request(clone->q, clone);
+	}
 
 	/*
 	 * Actual request completion is done in a softirq context which doesn't
-	 * hold the queue lock.  Otherwise, deadlock could occur because:
+	 * hold the clone's queue lock.  Otherwise, deadlock could occur because:
 	 *     - another request may be submitted by the upper level driver
 	 *       of the stacking during the completion
 	 *     - the submission which requires queue lock may be done
-	 *       against this queue
+	 *       against this clone's queue
 	 */
-	dm_complete_request(clone, error);
+	dm_complete_request(tio->orig, error);
 }
 
 /*
@@ -1575,6 +1685,7 @@ static void dm_request(struct request_queue *q, struct bio *bio)
 void dm_dispatch_request(struct request *rq)
 {
 	int r;
+	struct dm_rq_target_io *tio = rq->end_io_data;
 
 	if (blk_queue_io_stat(rq->q))
 		rq->cmd_flags |= REQ_IO_STAT;
@@ -1582,7 +1693,7 @@ void dm_dispatch_request(struct request *rq)
 	rq->start_time = jiffies;
 	r = blk_insert_cloned_request(rq->q, rq);
 	if (r)
-		dm_complete_request(rq, r);
+		dm_complete_request(tio->orig, r);
 }
 EXPORT_SYMBOL_GPL(dm_dispatch_request);
 
@@ -1616,33 +1727,56 @@ static int setup_clone(struct request *clone, struct request *rq,
 	clone->end_io = end_clone_request;
 	clone->end_io_data = tio;
 
+	tio->clone = clone;
+
 	return 0;
 }
 
-static struct request *clone_rq(struct request *rq, struct mapped_device *md,
-				gfp_t gfp_mask)
+static void init_tio(struct dm_rq_target_io *tio, struct request *rq,
+		     struct mapped_device *md)
 {
-	struct request *clone;
-	struct dm_rq_target_io *tio;
-
-	tio = alloc_rq_tio(md, gfp_mask);
-	if (!tio)
-		return NULL;
-
 	tio->md = md;
 	tio->ti = NULL;
+	tio->clone = NULL;
 	tio->orig = rq;
 	tio->error = 0;
 	memset(&tio->info, 0, sizeof(tio->info));
+}
+
+/*
+ * Set up the clone embedded in the tio, for non-blk-mq underlying devices.
+ */
+static struct request *clone_rq(struct request *rq,
+				struct dm_rq_target_io *tio)
+{
+	struct request *clone = &tio->clone_rq;
 
-	clone = &tio->clone;
-	if (setup_clone(clone, rq, tio)) {
+	blk_rq_init(NULL, clone);
+	if (setup_clone(clone, rq, tio))
 		/* -ENOMEM */
+		return NULL;
+
+	return clone;
+}
+
+static struct dm_rq_target_io *prep_tio(struct request *rq,
+					struct mapped_device *md, gfp_t gfp_mask)
+{
+	struct dm_rq_target_io *tio;
+
+	tio = alloc_rq_tio(md, gfp_mask);
+	if (!tio)
+		return NULL;
+
+	init_tio(tio, rq, md);
+
+	/* blk-mq clones are allocated by the target at map time */
+	if (md->type == DM_TYPE_REQUEST_BASED && !clone_rq(rq, tio)) {
 		free_rq_tio(tio);
 		return NULL;
 	}
 
-	return clone;
+	return tio;
 }
 
 /*
@@ -1651,18 +1785,18 @@ static struct request *clone_rq(struct request *rq, struct mapped_device *md,
 static int dm_prep_fn(struct request_queue *q, struct request *rq)
 {
 	struct mapped_device *md = q->queuedata;
-	struct request *clone;
+	struct dm_rq_target_io *tio;
 
 	if (unlikely(rq->special)) {
 		DMWARN("Already has something in rq->special.");
 		return BLKPREP_KILL;
 	}
 
-	clone = clone_rq(rq, md, GFP_ATOMIC);
-	if (!clone)
+	tio = prep_tio(rq, md, GFP_ATOMIC);
+	if (!tio)
 		return BLKPREP_DEFER;
 
-	rq->special = clone;
+	rq->special = tio;
 	rq->cmd_flags |= REQ_DONTPREP;
 
 	return BLKPREP_OK;
@@ -1670,17 +1804,37 @@ static int dm_prep_fn(struct request_queue *q, struct request *rq)
 
 /*
  * Returns:
- * 0  : the request has been processed (not requeued)
- * !0 : the request has been requeued
+ * DM_MAPIO_REQUEUE : the original request needs to be requeued
+ * otherwise        : the request has been processed
+ *
+ * A clone set up ahead of time is left alone on DM_MAPIO_REQUEUE, the
+ * caller's requeue method takes care of it.
  */
-static int map_request(struct dm_target *ti, struct request *clone,
+static int map_request(struct dm_target *ti, struct request *rq,
 		       struct mapped_device *md)
 {
-	int r, requeued = 0;
-	struct dm_rq_target_io *tio = clone->end_io_data;
+	int r;
+	struct dm_rq_target_io *tio = tio_from_request(rq);
+	struct request *clone = NULL;
 
 	tio->ti = ti;
-	r = ti->type->map_rq(ti, clone, &tio->info);
+	if (tio->clone) {
+		clone = tio->clone;
+		r = ti->type->map_rq(ti, clone, &tio->info);
+	} else {
+		r = ti->type->clone_and_map_rq(ti, rq, &tio->info, &clone);
+		if (r == DM_MAPIO_REMAPPED && setup_clone(clone, rq, tio)) {
+			/*
+			 * -ENOMEM: nothing was issued, so let the target drop
+			 * its per-I/O state as for a completed empty clone.
+			 */
+			if (ti->type->rq_end_io)
+				ti->type->rq_end_io(ti, clone, 0, &tio->info);
+			ti->type->release_clone_rq(clone);
+			return DM_MAPIO_REQUEUE;
+		}
+	}
+
 	switch (r) {
 	case DM_MAPIO_SUBMITTED:
 		/* The target has taken the I/O to submit by itself later */
@@ -1688,13 +1842,11 @@ static int map_request(struct dm_target *ti, struct request *clone,
 	case DM_MAPIO_REMAPPED:
 		/* The target has remapped the I/O so dispatch it */
 		trace_block_rq_remap(clone->q, clone, disk_devt(dm_disk(md)),
-				     blk_rq_pos(tio->orig));
+				     blk_rq_pos(rq));
 		dm_dispatch_request(clone);
 		break;
 	case DM_MAPIO_REQUEUE:
 		/* The target wants to requeue the I/O */
-		dm_requeue_unmapped_request(clone);
-		requeued = 1;
 		break;
 	default:
 		if (r > 0) {
@@ -1703,20 +1855,18 @@ static int map_request(struct dm_target *ti, struct request *clone,
 		}
 
 		/* The target wants to complete the I/O */
-		dm_kill_unmapped_request(clone, r);
+		dm_kill_request(rq, r);
 		break;
 	}
 
-	return requeued;
+	return r;
 }
 
-static struct request *dm_start_request(struct mapped_device *md, struct request *orig)
+static void dm_start_request(struct mapped_device *md, struct request *orig)
 {
-	struct request *clone;
-
-	blk_start_request(orig);
-	clone = orig->special;
-	atomic_inc(&md->pending[rq_data_dir(clone)]);
+	if (!orig->q->mq_ops)
+		blk_start_request(orig);
+	atomic_inc(&md->pending[rq_data_dir(orig)]);
 
 	/*
 	 * Hold the md reference here for the in-flight I/O.
@@ -1726,8 +1876,6 @@ static struct request *dm_start_request(struct mapped_device *md, struct request
 	 * See the comment in rq_completed() too.
 	 */
 	dm_get(md);
-
-	return clone;
 }
 
 /*
@@ -1740,7 +1888,7 @@ static void dm_request_fn(struct request_queue *q)
 	int srcu_idx;
 	struct dm_table *map = dm_get_live_table(md, &srcu_idx);
 	struct dm_target *ti;
-	struct request *rq, *clone;
+	struct request *rq;
 	sector_t pos;
 
 	/*
@@ -1763,22 +1911,24 @@ static void dm_request_fn(struct request_queue *q)
 		if (!dm_target_is_valid(ti)) {
 			/*
 			 * Must perform setup, that dm_done() requires,
-			 * before calling dm_kill_unmapped_request
+			 * before calling dm_kill_request
 			 */
 			DMERR_LIMIT("request attempted access beyond the end of device");
-			clone = dm_start_request(md, rq);
-			dm_kill_unmapped_request(clone, -EIO);
+			dm_start_request(md, rq);
+			dm_kill_request(rq, -EIO);
 			continue;
 		}
 
 		if (ti->type->busy && ti->type->busy(ti))
 			goto delay_and_out;
 
-		clone = dm_start_request(md, rq);
+		dm_start_request(md, rq);
 
 		spin_unlock(q->queue_lock);
-		if (map_request(ti, clone, md))
+		if (map_request(ti, rq, md) == DM_MAPIO_REQUEUE) {
+			dm_requeue_original_request(md, rq);
 			goto requeued;
+		}
 
 		BUG_ON(!irqs_disabled());
 		spin_lock(q->queue_lock);
@@ -1796,6 +1946,81 @@ out:
 	dm_put_live_table(md, srcu_idx);
 }
 
+/*
+ * ->queue_rq for request-based dm on top of blk-mq.
+ *
+ * The tio lives in the pdu of @rq, so nothing is allocated here except
+ * the clone's bios and, for blk-mq underlying devices, the clone itself.
+ * Where the old request_fn would delay the queue, the hardware queue is
+ * stopped and restarted after the same back off.
+ */
+static int dm_mq_queue_rq(struct blk_mq_hw_ctx *hctx, struct request *rq)
+{
+	struct dm_rq_target_io *tio = blk_mq_rq_to_pdu(rq);
+	struct mapped_device *md = tio->md;
+	int srcu_idx;
+	struct dm_table *map = dm_get_live_table(md, &srcu_idx);
+	struct dm_target *ti;
+	sector_t pos;
+
+	/*
+	 * dm_suspend() sets this and waits for io_barrier before counting
+	 * the in-flight I/Os, so no new one gets past here unaccounted.
+	 */
+	if (unlikely(test_bit(DMF_BLOCK_IO_FOR_SUSPEND, &md->flags))) {
+		dm_put_live_table(md, srcu_idx);
+		blk_mq_stop_hw_queue(hctx);
+		return BLK_MQ_RQ_QUEUE_BUSY;
+	}
+
+	/* always use block 0 to find the target for flushes for now */
+	pos = 0;
+	if (!(rq->cmd_flags & REQ_FLUSH))
+		pos = blk_rq_pos(rq);
+
+	init_tio(tio, rq, md);
+
+	ti = dm_table_find_target(map, pos);
+	if (!dm_target_is_valid(ti)) {
+		dm_put_live_table(md, srcu_idx);
+		/*
+		 * Must perform setup, that dm_done() requires,
+		 * before calling dm_kill_request
+		 */
+		DMERR_LIMIT("request attempted access beyond the end of device");
+		dm_start_request(md, rq);
+		dm_kill_request(rq, -EIO);
+		return BLK_MQ_RQ_QUEUE_OK;
+	}
+
+	if (ti->type->busy && ti->type->busy(ti))
+		goto busy;
+
+	/* clones for non-blk-mq devices are embedded in the tio */
+	if (md->type == DM_TYPE_REQUEST_BASED && !clone_rq(rq, tio))
+		goto busy;
+
+	dm_start_request(md, rq);
+
+	if (map_request(ti, rq, md) == DM_MAPIO_REQUEUE) {
+		/* Undo dm_start_request() and the clone before requeuing */
+		if (tio->clone)
+			free_rq_clone(tio->clone);
+		rq_completed(md, rq_data_dir(rq), false);
+		goto busy;
+	}
+
+	dm_put_live_table(md, srcu_idx);
+
+	return BLK_MQ_RQ_QUEUE_OK;
+
+busy:
+	dm_put_live_table(md, srcu_idx);
+	blk_mq_stop_hw_queue(hctx);
+	blk_mq_delay_queue(hctx, 100);
+	return BLK_MQ_RQ_QUEUE_BUSY;
+}
+
 int dm_underlying_device_busy(struct request_queue *q)
 {
 	return blk_lld_busy(q);
@@ -2048,6 +2273,8 @@ static void free_dev(struct mapped_device *md)
 
 	put_disk(md->disk);
 	blk_cleanup_queue(md->queue);
+	if (md->tag_set.tags)
+		blk_mq_free_tag_set(&md->tag_set);
 	dm_stats_cleanup(&md->stats);
 	module_put(THIS_MODULE);
 	kfree(md);
@@ -2067,7 +2294,7 @@ static void __bind_mempools(struct mapped_device *md, struct dm_table *t)
 			bioset_free(md->bs);
 			md->bs = p->bs;
 			p->bs = NULL;
-		} else if (dm_table_get_type(t) == DM_TYPE_REQUEST_BASED) {
+		} else if (dm_table_request_based(t)) {
 			/*
 			 * There's no need to reload with request-based dm
 			 * because the size of front_pad doesn't change.
@@ -2327,18 +2554,89 @@ static int dm_init_request_based_queue(struct mapped_device *md)
 	return 1;
 }
 
+static int dm_mq_init_request(void *data, struct request *rq,
+			      unsigned int hctx_idx, unsigned int request_idx,
+			      unsigned int numa_node)
+{
+	struct mapped_device *md = data;
+	struct dm_rq_target_io *tio = blk_mq_rq_to_pdu(rq);
+
+	/* dm_mq_queue_rq() finds the md through the tio */
+	tio->md = md;
+
+	return 0;
+}
+
+static struct blk_mq_ops dm_mq_ops = {
+	.queue_rq = dm_mq_queue_rq,
+	.map_queue = blk_mq_map_queue,
+	.complete = dm_softirq_done,
+	.init_request = dm_mq_init_request,
+};
+
+/*
+ * Turn md->queue into a blk-mq queue.  The tio is the request's pdu.
+ */
+static int dm_init_request_based_blk_mq_queue(struct mapped_device *md)
+{
+	struct request_queue *q;
+	int r;
+
+	if (md->queue->mq_ops)
+		return 0;
+
+	memset(&md->tag_set, 0, sizeof(md->tag_set));
+	md->tag_set.ops = &dm_mq_ops;
+	md->tag_set.nr_hw_queues = clamp_t(unsigned, dm_mq_nr_hw_queues,
+					   1, nr_cpu_ids);
+	md->tag_set.queue_depth = clamp_t(unsigned, dm_mq_queue_depth,
+					  1, BLK_MQ_MAX_DEPTH);
+	md->tag_set.numa_node = NUMA_NO_NODE;
+	md->tag_set.flags = BLK_MQ_F_SHOULD_MERGE | BLK_MQ_F_SG_MERGE;
+	md->tag_set.cmd_size = sizeof(struct dm_rq_target_io);
+	md->tag_set.driver_data = md;
+
+	r = blk_mq_alloc_tag_set(&md->tag_set);
+	if (r)
+		return r;
+
+	q = blk_mq_init_allocated_queue(&md->tag_set, md->queue);
+	if (IS_ERR(q)) {
+		r = PTR_ERR(q);
+		blk_mq_free_tag_set(&md->tag_set);
+		md->tag_set.tags = NULL;
+		return r;
+	}
+
+	/* blk_queue_make_request() reset these, see dm_init_md_queue() */
+	queue_flag_clear_unlocked(QUEUE_FLAG_STACKABLE, q);
+	blk_queue_bounce_limit(q, BLK_BOUNCE_ANY);
+
+	blk_mq_register_disk(md->disk);
+
+	return 0;
+}
+
 /*
  * Setup the DM device's queue based on md's type
  */
 int dm_setup_md_queue(struct mapped_device *md)
 {
-	if ((dm_get_md_type(md) == DM_TYPE_REQUEST_BASED) &&
-	    !dm_init_request_based_queue(md)) {
+	unsigned type = dm_get_md_type(md);
+	int r = 0;
+
+	if (type != DM_TYPE_REQUEST_BASED && type != DM_TYPE_MQ_REQUEST_BASED)
+		return 0;
+
+	if (use_blk_mq)
+		r = dm_init_request_based_blk_mq_queue(md);
+	else if (!dm_init_request_based_queue(md))
+		r = -EINVAL;
+
+	if (r)
 		DMWARN("Cannot initialize queue for request-based mapped device");
-		return -EINVAL;
-	}
 
-	return 0;
+	return r;
 }
 
 static struct mapped_device *dm_find_md(dev_t dev)
@@ -2887,7 +3185,8 @@ struct dm_md_mempools *dm_alloc_md_mempools(unsigned type, unsigned integrity, u
 		cachep = _io_cache;
 		pool_size = dm_get_reserved_bio_based_ios();
 		front_pad = roundup(per_bio_data_size, __alignof__(struct dm_target_io)) + offsetof(struct dm_target_io, clone);
-	} else if (type == DM_TYPE_REQUEST_BASED) {
+	} else if (type == DM_TYPE_REQUEST_BASED ||
+		   type == DM_TYPE_MQ_REQUEST_BASED) {
 		cachep = _rq_tio_cache;
 		pool_size = dm_get_reserved_rq_based_ios();
 		front_pad = offsetof(struct dm_rq_clone_bio_info, clone);
@@ -2952,6 +3251,15 @@ MODULE_PARM_DESC(reserved_bio_based_ios, "Reserved IOs in bio-based mempools");
 module_param(reserved_rq_based_ios, uint, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(reserved_rq_based_ios, "Reserved IOs in request-based mempools");
 
+module_param(use_blk_mq, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(use_blk_mq, "Use block multiqueue for request-based DM devices");
+
+module_param(dm_mq_nr_hw_queues, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(dm_mq_nr_hw_queues, "Number of hardware queues for request-based dm-mq devices");
+
+module_param(dm_mq_queue_depth, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(dm_mq_queue_depth, "Queue depth for request-based dm-mq devices");
+
 MODULE_DESCRIPTION(DM_NAME " driver");
 MODULE_AUTHOR("Joe Thornber <dm-devel@redhat.com>");
 MODULE_LICENSE("GPL");
@@ -49,6 +49,8 @@
 #include <linux/if_bridge.h>
 #include <linux/prefetch.h>
 #include <scsi/fc/fc_fcoe.h>
+#include <net/pkt_cls.h>
+#include <net/tc_act/tc_gact.h>
 
 #include "ixgbe.h"
 #include "ixgbe_common.h"
@@ -2088,6 +2090,73 @@ dma_sync:
 	return skb;
 }
 
+/**
+ * ixgbe_run_xdp - run the early RX program over a received frame
+ * @rx_ring: rx descriptor ring the frame was received on
+ * @rx_desc: descriptor of the frame
+ *
+ * Only frames held entirely in the buffer at next_to_clean are filtered,
+ * anything else is passed.  Returns the raw program result.
+ **/
+static u32 ixgbe_run_xdp(struct ixgbe_ring *rx_ring,
+			 union ixgbe_adv_rx_desc *rx_desc)
+{
+	struct ixgbe_rx_buffer *rx_buffer;
+	struct sk_filter *prog;
+	u32 act = XDP_PASS;
+
+	rcu_read_lock();
+	prog = rcu_dereference(rx_ring->xdp_prog);
+	if (!prog)
+		goto out;
+
+	rx_buffer = &rx_ring->rx_buffer_info[rx_ring->next_to_clean];
+	if (rx_buffer->skb ||
+	    !ixgbe_test_staterr(rx_desc, IXGBE_RXD_STAT_EOP))
+		goto out;
+
+	/* we are reusing so sync this buffer for CPU use */
+	dma_sync_single_range_for_cpu(rx_ring->dev,
+				      rx_buffer->dma,
+				      rx_buffer->page_offset,
+				      ixgbe_rx_bufsz(rx_ring),
+				      DMA_FROM_DEVICE);
+
+	act = xdp_run_filter(prog, &rx_ring->xdp,
+			     page_address(rx_buffer->page) +
+			     rx_buffer->page_offset,
+			     le16_to_cpu(rx_desc->wb.upper.length));
+out:
+	rcu_read_unlock();
+	return act;
+}
+
+/**
+ * ixgbe_xdp_drop - recycle the buffer of a frame dropped by ixgbe_run_xdp
+ * @rx_ring: rx descriptor ring the frame was received on
+ *
+ * No skb was allocated, so the page goes straight back to the ring.
+ **/
+static void ixgbe_xdp_drop(struct ixgbe_ring *rx_ring)
+{
+	struct ixgbe_rx_buffer *rx_buffer;
+	u32 ntc = rx_ring->next_to_clean;
+
+	rx_buffer = &rx_ring->rx_buffer_info[ntc];
+	ixgbe_reuse_rx_page(rx_ring, rx_buffer);
+
+	/* clear contents of buffer_info */
+	rx_buffer->dma = 0;
+	rx_buffer->page = NULL;
+
+	/* fetch, update, and store next to clean */
+	ntc++;
+	ntc = (ntc < rx_ring->count) ? ntc : 0;
+	rx_ring->next_to_clean = ntc;
+
+	prefetch(IXGBE_RX_DESC(rx_ring, ntc));
+}
+
 /**
  * ixgbe_clean_rx_irq - Clean completed descriptors from Rx ring - bounce buf
  * @q_vector: structure containing interrupt and ring information
@@ -2116,6 +2185,7 @@ static int ixgbe_clean_rx_irq(struct ixgbe_q_vector *q_vector,
 	while (likely(total_rx_packets < budget)) {
 		union ixgbe_adv_rx_desc *rx_desc;
 		struct sk_buff *skb;
+		u32 act;
 
 		/* return some buffers to hardware, one at a time is too slow */
 		if (cleaned_count >= IXGBE_RX_BUFFER_WRITE) {
@@ -2135,6 +2205,15 @@ static int ixgbe_clean_rx_irq(struct ixgbe_q_vector *q_vector,
 		 */
 		rmb();
 
+		act = ixgbe_run_xdp(rx_ring, rx_desc);
+		if (XDP_ACTION(act) == XDP_DROP) {
+			total_rx_bytes += le16_to_cpu(rx_desc->wb.upper.length);
+			total_rx_packets++;
+			cleaned_count++;
+			ixgbe_xdp_drop(rx_ring);
+			continue;
+		}
+
 		/* retrieve a buffer from the ring */
 		skb = ixgbe_fetch_rx_buffer(rx_ring, rx_desc);
 
@@ -2158,6 +2237,12 @@ static int ixgbe_clean_rx_irq(struct ixgbe_q_vector *q_vector,
 		/* populate checksum, timestamp, VLAN, and protocol */
 		ixgbe_process_skb_fields(rx_ring, rx_desc, skb);
 
+		if (XDP_ACTION(act) == XDP_REDIRECT) {
+			xdp_do_redirect(skb, act);
+			total_rx_packets++;
+			continue;
+		}
+
 #ifdef IXGBE_FCOE
 		/* if ddp, not passing to ULD unless for FCP_RSP or error */
 		if (ixgbe_rx_is_fcoe(rx_ring, rx_desc)) {
@@ -3523,6 +3608,9 @@ void ixgbe_configure_rx_ring(struct ixgbe_adapter *adapter,
 
 	ixgbe_rx_desc_queue_enable(adapter, ring);
 	ixgbe_alloc_rx_buffers(ring, ixgbe_desc_unused(ring));
+
+	xdp_buff_init(&ring->xdp, ring->netdev, ring->queue_index);
+	rcu_assign_pointer(ring->xdp_prog, adapter->xdp_prog);
 }
 
 static void ixgbe_setup_psrtype(struct ixgbe_adapter *adapter)
@@ -5564,6 +5652,10 @@ static int ixgbe_change_mtu(struct net_device *netdev, int new_mtu)
 	if ((new_mtu < 68) || (max_frame > IXGBE_MAX_JUMBO_FRAME_SIZE))
 		return -EINVAL;
 
+	/* the early RX program only sees single buffer frames */
+	if (adapter->xdp_prog && max_frame > IXGBE_RXBUFFER_2K)
+		return -EINVAL;
+
 	/*
 	 * For 82599EB we cannot allow legacy VFs to enable their receive
 	 * paths when MTU greater than 1500 is configured.  So display a
@@ -6843,6 +6935,32 @@ static void ixgbe_tx_olinfo_status(union ixgbe_adv_tx_desc *tx_desc,
 	tx_desc->read.olinfo_status = cpu_to_le32(olinfo_status);
 }
 
+static int __ixgbe_maybe_stop_tx(struct ixgbe_ring *tx_ring, u16 size)
+{
+	netif_stop_subqueue(tx_ring->netdev, tx_ring->queue_index);
+	/* Herbert's original patch had:
+	 *  smp_mb__after_netif_stop_queue();
+	 * but since that doesn't exist yet, just open code it. */
+	smp_mb();
+
+	/* We need to check again in a case another CPU has just
+	 * made room available. */
+	if (likely(ixgbe_desc_unused(tx_ring) < size))
+		return -EBUSY;
+
+	/* A reprieve! - use start_queue because it doesn't call schedule */
+	netif_start_subqueue(tx_ring->netdev, tx_ring->queue_index);
+	++tx_ring->tx_stats.restart_queue;
+	return 0;
+}
+
+static inline int ixgbe_maybe_stop_tx(struct ixgbe_ring *tx_ring, u16 size)
+{
+	if (likely(ixgbe_desc_unused(tx_ring) >= size))
+		return 0;
+	return __ixgbe_maybe_stop_tx(tx_ring, size);
+}
+
 #define IXGBE_TXD_CMD (IXGBE_TXD_CMD_EOP | \
 		       IXGBE_TXD_CMD_RS)
 
@@ -6964,8 +7082,11 @@ static void ixgbe_tx_map(struct ixgbe_ring *tx_ring,
 
 	tx_ring->next_to_use = i;
 
-	/* notify HW of packet */
-	ixgbe_write_tail(tx_ring, i);
+	ixgbe_maybe_stop_tx(tx_ring, DESC_NEEDED);
+
+	/* notify HW of packet, unless more are on their way */
+	if (netif_xmit_stopped(txring_txq(tx_ring)) || !skb->xmit_more)
+		ixgbe_write_tail(tx_ring, i);
 
 	return;
 dma_error:
@@ -7073,32 +7194,6 @@ static void ixgbe_atr(struct ixgbe_ring *ring,
 					      input, common, ring->queue_index);
 }
 
-static int __ixgbe_maybe_stop_tx(struct ixgbe_ring *tx_ring, u16 size)
-{
-	netif_stop_subqueue(tx_ring->netdev, tx_ring->queue_index);
-	/* Herbert's original patch had:
-	 *  smp_mb__after_netif_stop_queue();
-	 * but since that doesn't exist yet, just open code it. */
-	smp_mb();
-
-	/* We need to check again in a case another CPU has just
-	 * made room available. */
-	if (likely(ixgbe_desc_unused(tx_ring) < size))
-		return -EBUSY;
-
-	/* A reprieve! - use start_queue because it doesn't call schedule */
-	netif_start_subqueue(tx_ring->netdev, tx_ring->queue_index);
-	++tx_ring->tx_stats.restart_queue;
-	return 0;
-}
-
-static inline int ixgbe_maybe_stop_tx(struct ixgbe_ring *tx_ring, u16 size)
-{
-	if (likely(ixgbe_desc_unused(tx_ring) >= size))
-		return 0;
-	return __ixgbe_maybe_stop_tx(tx_ring, size);
-}
-
 static u16 ixgbe_select_queue(struct net_device *dev, struct sk_buff *skb,
 			      void *accel_priv, select_queue_fallback_t fallback)
 {
@@ -7267,8 +7362,6 @@ xmit_fcoe:
 #endif /* IXGBE_FCOE */
 	ixgbe_tx_map(tx_ring, first, hdr_len);
 
-	ixgbe_maybe_stop_tx(tx_ring, DESC_NEEDED);
-
 	return NETDEV_TX_OK;
 
 out_drop:
@@ -7620,6 +7713,183 @@ int ixgbe_setup_tc(struct net_device *dev, u8 tc)
 	return 0;
 }
 
+static int ixgbe_delete_clsu32(struct ixgbe_adapter *adapter,
+			       struct tc_cls_u32_offload *cls)
+{
+	int err;
+
+	spin_lock(&adapter->fdir_perfect_lock);
+	err = ixgbe_update_ethtool_fdir_entry(adapter, NULL,
+					      TC_U32_NODE(cls->knode.handle));
+	spin_unlock(&adapter->fdir_perfect_lock);
+
+	return err;
+}
+
+/* The flow director can drop IPv4 packets by source and destination
+ * address and by L4 protocol, which covers terminal u32 nodes of the
+ * root hash table matching on those header fields. All perfect filters
+ * however share one input mask, so a node whose mask differs from the
+ * installed ones stays a software-only filter.
+ */
+static int ixgbe_configure_clsu32(struct ixgbe_adapter *adapter,
+				  __be16 protocol,
+				  struct tc_cls_u32_offload *cls)
+{
+	u32 loc = TC_U32_NODE(cls->knode.handle);
+	struct tc_u32_sel *sel = cls->knode.sel;
+	struct ixgbe_hw *hw = &adapter->hw;
+	struct ixgbe_fdir_filter *input;
+	union ixgbe_atr_input mask;
+	struct tc_action *a;
+	int i, err;
+
+	if (!(adapter->flags & IXGBE_FLAG_FDIR_PERFECT_CAPABLE))
+		return -EOPNOTSUPP;
+
+	if (protocol != htons(ETH_P_IP))
+		return -EOPNOTSUPP;
+
+	if (TC_U32_USERHTID(cls->knode.handle) != 0x800 ||
+	    TC_U32_HASH(cls->knode.handle) || cls->knode.link_handle ||
+	    cls->knode.mask)
+		return -EOPNOTSUPP;
+
+	if (!(sel->flags & TC_U32_TERMINAL) ||
+	    (sel->flags & (TC_U32_OFFSET | TC_U32_VAROFFSET | TC_U32_EAT)))
+		return -EOPNOTSUPP;
+
+	/* Don't allow indexes to exist outside of available space */
+	if (loc >= ((1024 << adapter->fdir_pballoc) - 2))
+		return -EINVAL;
+
+	/* dropping is the only thing the hardware can do for us */
+	if (!tc_single_action(cls->knode.exts))
+		return -EOPNOTSUPP;
+	a = tc_first_action(cls->knode.exts);
+	if (!is_tcf_gact_shot(a))
+		return -EOPNOTSUPP;
+
+	input = kzalloc(sizeof(*input), GFP_KERNEL);
+	if (!input)
+		return -ENOMEM;
+
+	memset(&mask, 0, sizeof(union ixgbe_atr_input));
+
+	input->sw_idx = loc;
+	input->action = IXGBE_FDIR_DROP_QUEUE;
+	input->filter.formatted.flow_type = IXGBE_ATR_FLOW_TYPE_IPV4;
+	mask.formatted.flow_type = IXGBE_ATR_L4TYPE_IPV6_MASK;
+
+	err = -EOPNOTSUPP;
+	for (i = 0; i < sel->nkeys; i++) {
+		const struct tc_u32_key *key = &sel->keys[i];
+
+		if (key->offmask)
+			goto err_out;
+
+		switch (key->off) {
+		case offsetof(struct iphdr, saddr):
+			input->filter.formatted.src_ip[0] = key->val;
+			mask.formatted.src_ip[0] = key->mask;
+			break;
+		case offsetof(struct iphdr, daddr):
+			input->filter.formatted.dst_ip[0] = key->val;
+			mask.formatted.dst_ip[0] = key->mask;
+			break;
+		case offsetof(struct iphdr, ttl):
+			/* ttl, protocol and check: only protocol will do */
+			if (key->mask != htonl(0x00ff0000))
+				goto err_out;
+
+			switch ((ntohl(key->val) >> 16) & 0xff) {
+			case IPPROTO_TCP:
+				input->filter.formatted.flow_type =
+					IXGBE_ATR_FLOW_TYPE_TCPV4;
+				break;
+			case IPPROTO_UDP:
+				input->filter.formatted.flow_type =
+					IXGBE_ATR_FLOW_TYPE_UDPV4;
+				break;
+			case IPPROTO_SCTP:
+				input->filter.formatted.flow_type =
+					IXGBE_ATR_FLOW_TYPE_SCTPV4;
+				break;
+			default:
+				goto err_out;
+			}
+			mask.formatted.flow_type |= IXGBE_ATR_L4TYPE_MASK;
+			break;
+		default:
+			goto err_out;
+		}
+	}
+
+	err = -EINVAL;
+	spin_lock(&adapter->fdir_perfect_lock);
+
+	if (hlist_empty(&adapter->fdir_filter_list)) {
+		/* save mask and program input mask into HW */
+		memcpy(&adapter->fdir_mask, &mask, sizeof(mask));
+		err = ixgbe_fdir_set_input_mask_82599(hw, &mask);
+		if (err) {
+			e_err(drv, "Error writing mask\n");
+			goto err_out_w_lock;
+		}
+	} else if (memcmp(&adapter->fdir_mask, &mask, sizeof(mask))) {
+		e_info(drv, "u32 filter %x needs a different mask, not offloaded\n",
+		       cls->knode.handle);
+		goto err_out_w_lock;
+	}
+
+	/* apply mask and compute/store hash */
+	ixgbe_atr_compute_perfect_hash_82599(&input->filter, &mask);
+
+	/* program filters to filter memory */
+	err = ixgbe_fdir_write_perfect_filter_82599(hw, &input->filter,
+						    input->sw_idx,
+						    IXGBE_FDIR_DROP_QUEUE);
+	if (err)
+		goto err_out_w_lock;
+
+	ixgbe_update_ethtool_fdir_entry(adapter, input, input->sw_idx);
+	spin_unlock(&adapter->fdir_perfect_lock);
+
+	return 0;
+
+err_out_w_lock:
+	spin_unlock(&adapter->fdir_perfect_lock);
+err_out:
+	kfree(input);
+	return err;
+}
+
+static int ixgbe_setup_tc_offload(struct net_device *dev, u32 handle,
+				  __be16 proto, struct tc_to_netdev *tc)
+{
+	struct ixgbe_adapter *adapter = netdev_priv(dev);
+	int err;
+
+	/* the flow director sits in front of the receive queues */
+	if (TC_H_MAJ(handle) != TC_H_MAJ(TC_H_INGRESS) ||
+	    tc->type != TC_SETUP_CLSU32)
+		return -EOPNOTSUPP;
+
+	switch (tc->cls_u32->command) {
+	case TC_CLSU32_NEW_KNODE:
+	case TC_CLSU32_REPLACE_KNODE:
+		err = ixgbe_configure_clsu32(adapter, proto, tc->cls_u32);
+		/* never leave a stale version of the node in hardware */
+		if (err)
+			ixgbe_delete_clsu32(adapter, tc->cls_u32);
+		return err;
+	case TC_CLSU32_DELETE_KNODE:
+		return ixgbe_delete_clsu32(adapter, tc->cls_u32);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
 #ifdef CONFIG_PCI_IOV
 void ixgbe_sriov_reinit(struct ixgbe_adapter *adapter)
 {
@@ -7654,6 +7924,10 @@ static netdev_features_t ixgbe_fix_features(struct net_device *netdev,
 	if (!(adapter->flags2 & IXGBE_FLAG2_RSC_CAPABLE))
 		features &= ~NETIF_F_LRO;
 
+	/* RSC merges frames the early RX program would not see */
+	if (adapter->xdp_prog)
+		features &= ~NETIF_F_LRO;
+
 	return features;
 }
 
@@ -7916,6 +8190,48 @@ static void ixgbe_fwd_del(struct net_device *pdev, void *priv)
 	kfree(fwd_adapter);
 }
 
+static int ixgbe_xdp_setup(struct net_device *dev, struct sk_filter *prog)
+{
+	struct ixgbe_adapter *adapter = netdev_priv(dev);
+	int max_frame = dev->mtu + ETH_HLEN + ETH_FCS_LEN;
+	struct sk_filter *old_prog;
+	int i;
+
+	/* frames split across buffers would bypass the program */
+	if (prog && max_frame > IXGBE_RXBUFFER_2K)
+		return -EINVAL;
+
+	old_prog = adapter->xdp_prog;
+	adapter->xdp_prog = prog;
+
+	for (i = 0; i < adapter->num_rx_queues; i++)
+		rcu_assign_pointer(adapter->rx_ring[i]->xdp_prog, prog);
+
+	/* readers are under rcu, the filter is freed after a grace period */
+	if (old_prog)
+		sk_unattached_filter_destroy(old_prog);
+
+	/* ixgbe_fix_features() keeps LRO off while a program is attached */
+	netdev_update_features(dev);
+
+	return 0;
+}
+
+static int ixgbe_xdp(struct net_device *dev, struct netdev_xdp *xdp)
+{
+	struct ixgbe_adapter *adapter = netdev_priv(dev);
+
+	switch (xdp->command) {
+	case XDP_SETUP_PROG:
+		return ixgbe_xdp_setup(dev, xdp->prog);
+	case XDP_QUERY_PROG:
+		xdp->prog_attached = !!adapter->xdp_prog;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
 static const struct net_device_ops ixgbe_netdev_ops = {
 	.ndo_open		= ixgbe_open,
 	.ndo_stop		= ixgbe_close,
@@ -7937,6 +8253,7 @@ static const struct net_device_ops ixgbe_netdev_ops = {
 	.ndo_get_stats64	= ixgbe_get_stats64,
 #ifdef CONFIG_IXGBE_DCB
 	.ndo_setup_tc		= ixgbe_setup_tc,
+	.ndo_setup_tc_offload	= ixgbe_setup_tc_offload,
 #endif
 #ifdef CONFIG_NET_POLL_CONTROLLER
 	.ndo_poll_controller	= ixgbe_netpoll,
@@ -7960,6 +8277,7 @@ static const struct net_device_ops ixgbe_netdev_ops = {
 	.ndo_bridge_getlink	= ixgbe_ndo_bridge_getlink,
 	.ndo_dfwd_add_station	= ixgbe_fwd_add,
 	.ndo_dfwd_del_station	= ixgbe_fwd_del,
+	.ndo_xdp		= ixgbe_xdp,
 };
 
 /**
@@ -8267,7 +8585,8 @@ skip_sriov:
 	case ixgbe_mac_X540:
 		netdev->features |= NETIF_F_SCTP_CSUM;
 		netdev->hw_features |= NETIF_F_SCTP_CSUM |
-				       NETIF_F_NTUPLE;
+				       NETIF_F_NTUPLE |
+				       NETIF_F_HW_TC;
 		break;
 	default:
 		break;
@@ -8520,6 +8839,9 @@ static void ixgbe_remove(struct pci_dev *pdev)
 	if (netdev->reg_state == NETREG_REGISTERED)
 		unregister_netdev(netdev);
 
+	if (adapter->xdp_prog)
+		sk_unattached_filter_destroy(adapter->xdp_prog);
+
 #ifdef CONFIG_PCI_IOV
 	/*
 	 * Only disable SR-IOV on unload if the user specified the now
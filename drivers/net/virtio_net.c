@@ -27,13 +27,15 @@
 #include <linux/slab.h>
 #include <linux/cpu.h>
 #include <linux/average.h>
+#include <net/xdp.h>
 
 static int napi_weight = NAPI_POLL_WEIGHT;
 module_param(napi_weight, int, 0444);
 
-static bool csum = true, gso = true;
+static bool csum = true, gso = true, napi_tx;
 module_param(csum, bool, 0444);
 module_param(gso, bool, 0444);
+module_param(napi_tx, bool, 0644);
 
 /* FIXME: MTU in config. */
 #define GOOD_PACKET_LEN (ETH_HLEN + VLAN_HLEN + ETH_DATA_LEN)
@@ -69,6 +71,9 @@ struct send_queue {
 	/* TX: fragments + linear part + virtio header */
 	struct scatterlist sg[MAX_SKB_FRAGS + 2];
 
+	/* Reclaims sent skbs from the TX interrupt, weight 0 if unused */
+	struct napi_struct napi;
+
 	/* Name of the send queue: output.$index */
 	char name[40];
 };
@@ -92,6 +97,10 @@ struct receive_queue {
 	/* RX: fragments + linear part + virtio header */
 	struct scatterlist sg[MAX_SKB_FRAGS + 2];
 
+	/* Early RX program and its scratch buffer */
+	struct sk_filter __rcu *xdp_prog;
+	struct xdp_buff xdp;
+
 	/* Name of this receive queue: input.$index */
 	char name[40];
 };
@@ -142,6 +151,9 @@ struct virtnet_info {
 
 	/* CPU hot plug notifier */
 	struct notifier_block nb;
+
+	/* Early RX program shared by all receive queues, under rtnl_lock */
+	struct sk_filter *xdp_prog;
 };
 
 struct skb_vnet_hdr {
@@ -216,15 +228,40 @@ static struct page *get_a_page(struct receive_queue *rq, gfp_t gfp_mask)
 	return p;
 }
 
+static void virtqueue_napi_schedule(struct napi_struct *napi,
+				    struct virtqueue *vq)
+{
+	/* Schedule NAPI, Suppress further interrupts if successful. */
+	if (napi_schedule_prep(napi)) {
+		virtqueue_disable_cb(vq);
+		__napi_schedule(napi);
+	}
+}
+
+static void virtqueue_napi_complete(struct napi_struct *napi,
+				    struct virtqueue *vq)
+{
+	unsigned int r;
+
+	r = virtqueue_enable_cb_prepare(vq);
+	napi_complete(napi);
+	if (unlikely(virtqueue_poll(vq, r)))
+		virtqueue_napi_schedule(napi, vq);
+}
+
 static void skb_xmit_done(struct virtqueue *vq)
 {
 	struct virtnet_info *vi = vq->vdev->priv;
+	struct napi_struct *napi = &vi->sq[vq2txq(vq)].napi;
 
 	/* Suppress further interrupts. */
 	virtqueue_disable_cb(vq);
 
-	/* We were probably waiting for more output buffers. */
-	netif_wake_subqueue(vi->dev, vq2txq(vq));
+	if (napi->weight)
+		virtqueue_napi_schedule(napi, vq);
+	else
+		/* We were probably waiting for more output buffers. */
+		netif_wake_subqueue(vi->dev, vq2txq(vq));
 }
 
 static unsigned int mergeable_ctx_to_buf_truesize(unsigned long mrg_ctx)
@@ -435,6 +472,60 @@ err_buf:
 	return NULL;
 }
 
+static void free_rx_buf(struct virtnet_info *vi, struct receive_queue *rq,
+			void *buf)
+{
+	if (vi->mergeable_rx_bufs) {
+		unsigned long ctx = (unsigned long)buf;
+		void *base = mergeable_ctx_to_buf_address(ctx);
+		put_page(virt_to_head_page(base));
+	} else if (vi->big_packets) {
+		give_pages(rq, buf);
+	} else {
+		dev_kfree_skb(buf);
+	}
+}
+
+/* Run the early RX program over a received buffer.  Frames spread over
+ * more than one buffer are passed without running it.
+ */
+static u32 virtnet_run_xdp(struct virtnet_info *vi, struct receive_queue *rq,
+			   void *buf, unsigned int len)
+{
+	struct sk_filter *prog;
+	unsigned int hdr_len;
+	void *data;
+	u32 act = XDP_PASS;
+
+	rcu_read_lock();
+	prog = rcu_dereference(rq->xdp_prog);
+	if (!prog)
+		goto out;
+
+	if (vi->mergeable_rx_bufs) {
+		struct skb_vnet_hdr *hdr;
+
+		hdr = mergeable_ctx_to_buf_address((unsigned long)buf);
+		if (hdr->mhdr.num_buffers != 1)
+			goto out;
+		hdr_len = sizeof(hdr->mhdr);
+		data = (void *)hdr + hdr_len;
+	} else if (vi->big_packets) {
+		hdr_len = sizeof(struct virtio_net_hdr);
+		if (len - hdr_len > PAGE_SIZE - sizeof(struct padded_vnet_hdr))
+			goto out;
+		data = page_address(buf) + sizeof(struct padded_vnet_hdr);
+	} else {
+		hdr_len = sizeof(struct virtio_net_hdr);
+		data = ((struct sk_buff *)buf)->data;
+	}
+
+	act = xdp_run_filter(prog, &rq->xdp, data, len - hdr_len);
+out:
+	rcu_read_unlock();
+	return act;
+}
+
 static void receive_buf(struct receive_queue *rq, void *buf, unsigned int len)
 {
 	struct virtnet_info *vi = rq->vq->vdev->priv;
@@ -442,19 +533,22 @@ static void receive_buf(struct receive_queue *rq, void *buf, unsigned int len)
 	struct virtnet_stats *stats = this_cpu_ptr(vi->stats);
 	struct sk_buff *skb;
 	struct skb_vnet_hdr *hdr;
+	u32 act;
 
 	if (unlikely(len < sizeof(struct virtio_net_hdr) + ETH_HLEN)) {
 		pr_debug("%s: short packet %i\n", dev->name, len);
 		dev->stats.rx_length_errors++;
-		if (vi->mergeable_rx_bufs) {
-			unsigned long ctx = (unsigned long)buf;
-			void *base = mergeable_ctx_to_buf_address(ctx);
-			put_page(virt_to_head_page(base));
-		} else if (vi->big_packets) {
-			give_pages(rq, buf);
-		} else {
-			dev_kfree_skb(buf);
-		}
+		free_rx_buf(vi, rq, buf);
+		return;
+	}
+
+	act = virtnet_run_xdp(vi, rq, buf, len);
+	if (XDP_ACTION(act) == XDP_DROP) {
+		u64_stats_update_begin(&stats->rx_syncp);
+		stats->rx_bytes += len;
+		stats->rx_packets++;
+		u64_stats_update_end(&stats->rx_syncp);
+		free_rx_buf(vi, rq, buf);
 		return;
 	}
 
@@ -521,6 +615,11 @@ static void receive_buf(struct receive_queue *rq, void *buf, unsigned int len)
 		skb_shinfo(skb)->gso_segs = 0;
 	}
 
+	if (XDP_ACTION(act) == XDP_REDIRECT) {
+		xdp_do_redirect(skb, act);
+		return;
+	}
+
 	netif_receive_skb(skb);
 	return;
 
@@ -680,27 +779,44 @@ static void skb_recv_done(struct virtqueue *rvq)
 	struct virtnet_info *vi = rvq->vdev->priv;
 	struct receive_queue *rq = &vi->rq[vq2rxq(rvq)];
 
-	/* Schedule NAPI, Suppress further interrupts if successful. */
-	if (napi_schedule_prep(&rq->napi)) {
-		virtqueue_disable_cb(rvq);
-		__napi_schedule(&rq->napi);
-	}
+	virtqueue_napi_schedule(&rq->napi, rvq);
 }
 
-static void virtnet_napi_enable(struct receive_queue *rq)
+static void virtnet_napi_enable(struct virtqueue *vq, struct napi_struct *napi)
 {
-	napi_enable(&rq->napi);
+	napi_enable(napi);
 
 	/* If all buffers were filled by other side before we napi_enabled, we
 	 * won't get another interrupt, so process any outstanding packets
 	 * now.  virtnet_poll wants re-enable the queue, so we disable here.
 	 * We synchronize against interrupts via NAPI_STATE_SCHED */
-	if (napi_schedule_prep(&rq->napi)) {
-		virtqueue_disable_cb(rq->vq);
-		local_bh_disable();
-		__napi_schedule(&rq->napi);
-		local_bh_enable();
+	local_bh_disable();
+	virtqueue_napi_schedule(napi, vq);
+	local_bh_enable();
+}
+
+static void virtnet_napi_tx_enable(struct virtnet_info *vi,
+				   struct virtqueue *vq,
+				   struct napi_struct *napi)
+{
+	if (!napi->weight)
+		return;
+
+	/* Tx napi touches cachelines on the cpu handling tx interrupts. Only
+	 * enable it if that is likely the cpu doing the transmit as well.
+	 */
+	if (!vi->affinity_hint_set) {
+		napi->weight = 0;
+		return;
 	}
+
+	virtnet_napi_enable(vq, napi);
+}
+
+static void virtnet_napi_tx_disable(struct napi_struct *napi)
+{
+	if (napi->weight)
+		napi_disable(napi);
 }
 
 static void refill_work(struct work_struct *work)
@@ -715,7 +831,7 @@ static void refill_work(struct work_struct *work)
 
 		napi_disable(&rq->napi);
 		still_empty = !try_fill_recv(rq, GFP_KERNEL);
-		virtnet_napi_enable(rq);
+		virtnet_napi_enable(rq->vq, &rq->napi);
 
 		/* In theory, this can happen: if we don't get any buffers in
 		 * we will *never* try to fill again.
@@ -725,6 +841,48 @@ static void refill_work(struct work_struct *work)
 	}
 }
 
+static void free_old_xmit_skbs(struct send_queue *sq)
+{
+	struct sk_buff *skb;
+	unsigned int len;
+	struct virtnet_info *vi = sq->vq->vdev->priv;
+	struct virtnet_stats *stats = this_cpu_ptr(vi->stats);
+
+	while ((skb = virtqueue_get_buf(sq->vq, &len)) != NULL) {
+		pr_debug("Sent skb %p\n", skb);
+
+		u64_stats_update_begin(&stats->tx_syncp);
+		stats->tx_bytes += skb->len;
+		stats->tx_packets++;
+		u64_stats_update_end(&stats->tx_syncp);
+
+		dev_kfree_skb_any(skb);
+	}
+}
+
+/*
+ * With TX napi the RX interrupt is a cheap opportunity to reclaim sent
+ * skbs of the queue pair as well.
+ */
+static void virtnet_poll_cleantx(struct receive_queue *rq)
+{
+	struct virtnet_info *vi = rq->vq->vdev->priv;
+	unsigned int index = vq2rxq(rq->vq);
+	struct send_queue *sq = &vi->sq[index];
+	struct netdev_queue *txq = netdev_get_tx_queue(vi->dev, index);
+
+	if (!sq->napi.weight)
+		return;
+
+	if (__netif_tx_trylock(txq)) {
+		free_old_xmit_skbs(sq);
+		__netif_tx_unlock(txq);
+	}
+
+	if (sq->vq->num_free >= 2 + MAX_SKB_FRAGS)
+		netif_tx_wake_queue(txq);
+}
+
 static int virtnet_poll(struct napi_struct *napi, int budget)
 {
 	struct receive_queue *rq =
@@ -733,6 +891,8 @@ static int virtnet_poll(struct napi_struct *napi, int budget)
 	void *buf;
 	unsigned int r, len, received = 0;
 
+	virtnet_poll_cleantx(rq);
+
 again:
 	while (received < budget &&
 	       (buf = virtqueue_get_buf(rq->vq, &len)) != NULL) {
@@ -760,6 +920,25 @@ again:
 	return received;
 }
 
+static int virtnet_poll_tx(struct napi_struct *napi, int budget)
+{
+	struct send_queue *sq = container_of(napi, struct send_queue, napi);
+	struct virtnet_info *vi = sq->vq->vdev->priv;
+	struct netdev_queue *txq = netdev_get_tx_queue(vi->dev,
+						       vq2txq(sq->vq));
+
+	__netif_tx_lock(txq, raw_smp_processor_id());
+	free_old_xmit_skbs(sq);
+	__netif_tx_unlock(txq);
+
+	virtqueue_napi_complete(napi, sq->vq);
+
+	if (sq->vq->num_free >= 2 + MAX_SKB_FRAGS)
+		netif_tx_wake_queue(txq);
+
+	return 0;
+}
+
 static int virtnet_open(struct net_device *dev)
 {
 	struct virtnet_info *vi = netdev_priv(dev);
@@ -770,31 +949,13 @@ static int virtnet_open(struct net_device *dev)
 			/* Make sure we have some buffers: if oom use wq. */
 			if (!try_fill_recv(&vi->rq[i], GFP_KERNEL))
 				schedule_delayed_work(&vi->refill, 0);
-		virtnet_napi_enable(&vi->rq[i]);
+		virtnet_napi_enable(vi->rq[i].vq, &vi->rq[i].napi);
+		virtnet_napi_tx_enable(vi, vi->sq[i].vq, &vi->sq[i].napi);
 	}
 
 	return 0;
 }
 
-static void free_old_xmit_skbs(struct send_queue *sq)
-{
-	struct sk_buff *skb;
-	unsigned int len;
-	struct virtnet_info *vi = sq->vq->vdev->priv;
-	struct virtnet_stats *stats = this_cpu_ptr(vi->stats);
-
-	while ((skb = virtqueue_get_buf(sq->vq, &len)) != NULL) {
-		pr_debug("Sent skb %p\n", skb);
-
-		u64_stats_update_begin(&stats->tx_syncp);
-		stats->tx_bytes += skb->len;
-		stats->tx_packets++;
-		u64_stats_update_end(&stats->tx_syncp);
-
-		dev_kfree_skb_any(skb);
-	}
-}
-
 static int xmit_skb(struct send_queue *sq, struct sk_buff *skb)
 {
 	struct skb_vnet_hdr *hdr;
@@ -867,11 +1028,16 @@ static netdev_tx_t start_xmit(struct sk_buff *skb, struct net_device *dev)
 	struct virtnet_info *vi = netdev_priv(dev);
 	int qnum = skb_get_queue_mapping(skb);
 	struct send_queue *sq = &vi->sq[qnum];
+	bool use_napi = sq->napi.weight;
 	int err;
 
 	/* Free up any pending old buffers before queueing new ones. */
 	free_old_xmit_skbs(sq);
 
+	/* with TX napi the interrupt is what reclaims the rest */
+	if (use_napi)
+		virtqueue_enable_cb_delayed(sq->vq);
+
 	/* Try to transmit */
 	err = xmit_skb(sq, skb);
 
@@ -888,14 +1054,17 @@ static netdev_tx_t start_xmit(struct sk_buff *skb, struct net_device *dev)
 	virtqueue_kick(sq->vq);
 
 	/* Don't wait up for transmitted skbs to be freed. */
-	skb_orphan(skb);
-	nf_reset(skb);
+	if (!use_napi) {
+		skb_orphan(skb);
+		nf_reset(skb);
+	}
 
 	/* Apparently nice girls don't return TX_BUSY; stop the queue
 	 * before it gets out of hand.  Naturally, this wastes entries. */
 	if (sq->vq->num_free < 2+MAX_SKB_FRAGS) {
 		netif_stop_subqueue(dev, qnum);
-		if (unlikely(!virtqueue_enable_cb_delayed(sq->vq))) {
+		if (!use_napi &&
+		    unlikely(!virtqueue_enable_cb_delayed(sq->vq))) {
 			/* More just got used, free them then recheck. */
 			free_old_xmit_skbs(sq);
 			if (sq->vq->num_free >= 2+MAX_SKB_FRAGS) {
@@ -1081,8 +1250,10 @@ static int virtnet_close(struct net_device *dev)
 	/* Make sure refill_work doesn't re-enable napi! */
 	cancel_delayed_work_sync(&vi->refill);
 
-	for (i = 0; i < vi->max_queue_pairs; i++)
+	for (i = 0; i < vi->max_queue_pairs; i++) {
 		napi_disable(&vi->rq[i].napi);
+		virtnet_napi_tx_disable(&vi->sq[i].napi);
+	}
 
 	return 0;
 }
@@ -1200,30 +1371,57 @@ static void virtnet_clean_affinity(struct virtnet_info *vi, long hcpu)
 	}
 }
 
+/*
+ * Spread the online cpus over the queue pairs in use, in groups of
+ * consecutive cpus, and point XPS and the virtqueue interrupts of each
+ * pair at its group.  If there are more queue pairs than cpus, the cpus
+ * wrap around.
+ */
 static void virtnet_set_affinity(struct virtnet_info *vi)
 {
-	int i;
-	int cpu;
-
-	/* In multiqueue mode, when the number of cpu is equal to the number of
-	 * queue pairs, we let the queue pairs to be private to one cpu by
-	 * setting the affinity hint to eliminate the contention.
-	 */
-	if (vi->curr_queue_pairs == 1 ||
-	    vi->max_queue_pairs != num_online_cpus()) {
+	cpumask_var_t mask;
+	int stragglers;
+	int group_size;
+	int i, j, cpu;
+	int num_cpu;
+	int stride;
+
+	if (!zalloc_cpumask_var(&mask, GFP_KERNEL)) {
 		virtnet_clean_affinity(vi, -1);
 		return;
 	}
 
-	i = 0;
-	for_each_online_cpu(cpu) {
-		virtqueue_set_affinity(vi->rq[i].vq, cpu);
-		virtqueue_set_affinity(vi->sq[i].vq, cpu);
-		netif_set_xps_queue(vi->dev, cpumask_of(cpu), i);
-		i++;
+	num_cpu = num_online_cpus();
+	stride = max_t(int, num_cpu / vi->curr_queue_pairs, 1);
+	stragglers = num_cpu >= vi->curr_queue_pairs ?
+			num_cpu % vi->curr_queue_pairs : 0;
+	cpu = cpumask_first(cpu_online_mask);
+
+	for (i = 0; i < vi->curr_queue_pairs; i++) {
+		int first = cpu;
+
+		group_size = stride + (i < stragglers ? 1 : 0);
+		for (j = 0; j < group_size; j++) {
+			cpumask_set_cpu(cpu, mask);
+			cpu = cpumask_next(cpu, cpu_online_mask);
+			if (cpu >= nr_cpu_ids)
+				cpu = cpumask_first(cpu_online_mask);
+		}
+
+		/* the interrupt can only be hinted at a single cpu */
+		virtqueue_set_affinity(vi->rq[i].vq, first);
+		virtqueue_set_affinity(vi->sq[i].vq, first);
+		netif_set_xps_queue(vi->dev, mask, i);
+		cpumask_clear(mask);
+	}
+
+	for (; i < vi->max_queue_pairs; i++) {
+		virtqueue_set_affinity(vi->rq[i].vq, -1);
+		virtqueue_set_affinity(vi->sq[i].vq, -1);
 	}
 
 	vi->affinity_hint_set = true;
+	free_cpumask_var(mask);
 }
 
 static int virtnet_cpu_callback(struct notifier_block *nfb,
@@ -1327,12 +1525,64 @@ static const struct ethtool_ops virtnet_ethtool_ops = {
 
 static int virtnet_change_mtu(struct net_device *dev, int new_mtu)
 {
+	struct virtnet_info *vi = netdev_priv(dev);
+
 	if (new_mtu < MIN_MTU || new_mtu > MAX_MTU)
 		return -EINVAL;
+	/* the early RX program only sees single buffer frames */
+	if (vi->xdp_prog && new_mtu > ETH_DATA_LEN)
+		return -EINVAL;
 	dev->mtu = new_mtu;
 	return 0;
 }
 
+static int virtnet_xdp_setup(struct net_device *dev, struct sk_filter *prog)
+{
+	struct virtnet_info *vi = netdev_priv(dev);
+	struct sk_filter *old_prog;
+	int i;
+
+	if (prog) {
+		/* GSO frames from the host span several buffers and would
+		 * bypass the program, as would frames above ETH_DATA_LEN
+		 */
+		if (virtio_has_feature(vi->vdev, VIRTIO_NET_F_GUEST_TSO4) ||
+		    virtio_has_feature(vi->vdev, VIRTIO_NET_F_GUEST_TSO6) ||
+		    virtio_has_feature(vi->vdev, VIRTIO_NET_F_GUEST_ECN) ||
+		    virtio_has_feature(vi->vdev, VIRTIO_NET_F_GUEST_UFO))
+			return -EOPNOTSUPP;
+		if (dev->mtu > ETH_DATA_LEN)
+			return -EINVAL;
+	}
+
+	old_prog = vi->xdp_prog;
+	vi->xdp_prog = prog;
+
+	for (i = 0; i < vi->max_queue_pairs; i++)
+		rcu_assign_pointer(vi->rq[i].xdp_prog, prog);
+
+	/* readers are under rcu, the filter is freed after a grace period */
+	if (old_prog)
+		sk_unattached_filter_destroy(old_prog);
+
+	return 0;
+}
+
+static int virtnet_xdp(struct net_device *dev, struct netdev_xdp *xdp)
+{
+	struct virtnet_info *vi = netdev_priv(dev);
+
+	switch (xdp->command) {
+	case XDP_SETUP_PROG:
+		return virtnet_xdp_setup(dev, xdp->prog);
+	case XDP_QUERY_PROG:
+		xdp->prog_attached = !!vi->xdp_prog;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
 static const struct net_device_ops virtnet_netdev = {
 	.ndo_open            = virtnet_open,
 	.ndo_stop   	     = virtnet_close,
@@ -1347,6 +1597,7 @@ static const struct net_device_ops virtnet_netdev = {
 #ifdef CONFIG_NET_POLL_CONTROLLER
 	.ndo_poll_controller = virtnet_netpoll,
 #endif
+	.ndo_xdp	     = virtnet_xdp,
 };
 
 static void virtnet_config_changed_work(struct work_struct *work)
@@ -1398,8 +1649,10 @@ static void virtnet_free_queues(struct virtnet_info *vi)
 {
 	int i;
 
-	for (i = 0; i < vi->max_queue_pairs; i++)
+	for (i = 0; i < vi->max_queue_pairs; i++) {
 		netif_napi_del(&vi->rq[i].napi);
+		netif_napi_del(&vi->sq[i].napi);
+	}
 
 	kfree(vi->rq);
 	kfree(vi->sq);
@@ -1552,10 +1805,16 @@ static int virtnet_alloc_queues(struct virtnet_info *vi)
 		vi->rq[i].pages = NULL;
 		netif_napi_add(vi->dev, &vi->rq[i].napi, virtnet_poll,
 			       napi_weight);
+		netif_napi_add(vi->dev, &vi->sq[i].napi, virtnet_poll_tx,
+			       napi_tx ? napi_weight : 0);
 
 		sg_init_table(vi->rq[i].sg, ARRAY_SIZE(vi->rq[i].sg));
 		ewma_init(&vi->rq[i].mrg_avg_pkt_len, 1, RECEIVE_AVG_WEIGHT);
 		sg_init_table(vi->sq[i].sg, ARRAY_SIZE(vi->sq[i].sg));
+
+		/* also reached on restore, keep an attached program */
+		xdp_buff_init(&vi->rq[i].xdp, vi->dev, i);
+		RCU_INIT_POINTER(vi->rq[i].xdp_prog, vi->xdp_prog);
 	}
 
 	return 0;
@@ -1833,6 +2092,9 @@ static void virtnet_remove(struct virtio_device *vdev)
 
 	flush_work(&vi->config_work);
 
+	if (vi->xdp_prog)
+		sk_unattached_filter_destroy(vi->xdp_prog);
+
 	free_percpu(vi->stats);
 	free_netdev(vi->dev);
 }
@@ -1857,6 +2119,8 @@ static int virtnet_freeze(struct virtio_device *vdev)
 		for (i = 0; i < vi->max_queue_pairs; i++) {
 			napi_disable(&vi->rq[i].napi);
 			netif_napi_del(&vi->rq[i].napi);
+			virtnet_napi_tx_disable(&vi->sq[i].napi);
+			netif_napi_del(&vi->sq[i].napi);
 		}
 
 	remove_vq_common(vi);
@@ -1880,8 +2144,11 @@ static int virtnet_restore(struct virtio_device *vdev)
 			if (!try_fill_recv(&vi->rq[i], GFP_KERNEL))
 				schedule_delayed_work(&vi->refill, 0);
 
-		for (i = 0; i < vi->max_queue_pairs; i++)
-			virtnet_napi_enable(&vi->rq[i]);
+		for (i = 0; i < vi->max_queue_pairs; i++) {
+			virtnet_napi_enable(vi->rq[i].vq, &vi->rq[i].napi);
+			virtnet_napi_tx_enable(vi, vi->sq[i].vq,
+					       &vi->sq[i].napi);
+		}
 	}
 
 	netif_device_attach(vi->dev);
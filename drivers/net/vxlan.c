@@ -2499,6 +2499,7 @@ static struct vxlan_sock *vxlan_socket_create(struct net *net, __be16 port,
 
 	/* Initialize the vxlan udp offloads structure */
 	vs->udp_offloads.port = port;
+	vs->udp_offloads.encap_hlen = sizeof(struct vxlanhdr);
 	vs->udp_offloads.callbacks.gro_receive  = vxlan_gro_receive;
 	vs->udp_offloads.callbacks.gro_complete = vxlan_gro_complete;
 
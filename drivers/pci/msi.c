@@ -385,6 +385,8 @@ static void free_msi_irqs(struct pci_dev *dev)
 			nvec = 1 << entry->msi_attrib.multiple;
 		for (i = 0; i < nvec; i++)
 			BUG_ON(irq_has_action(entry->irq + i));
+		if (entry->affinity)
+			irq_set_affinity_managed(entry->irq, NULL);
 	}
 
 	arch_teardown_msi_irqs(dev);
@@ -407,6 +409,7 @@ static void free_msi_irqs(struct pci_dev *dev)
 		}
 
 		list_del(&entry->list);
+		kfree(entry->affinity);
 		kfree(entry);
 	}
 
@@ -1172,3 +1175,47 @@ int pci_enable_msix_range(struct pci_dev *dev, struct msix_entry *entries,
 	return nvec;
 }
 EXPORT_SYMBOL(pci_enable_msix_range);
+
+/**
+ * pci_enable_msix_range_affinity - enable MSI-X with vectors spread over cpus
+ * @dev: pointer to the pci_dev data structure of MSI-X device function
+ * @entries: pointer to an array of MSI-X entries
+ * @minvec: minimum number of MSI-X irqs requested
+ * @maxvec: maximum number of MSI-X irqs requested
+ *
+ * Works like pci_enable_msix_range(), then binds each allocated vector to
+ * the cpus irq_create_affinity_masks() assigns it, which is the cpu to
+ * hardware queue mapping of blk-mq.  The bindings are managed: user space
+ * cannot move the vectors, so a queue's completions stay on the cpus that
+ * submit to it.  The bindings are released by pci_disable_msix().
+ *
+ * Failing to set up the affinity is not fatal; the vectors are then left
+ * as pci_enable_msix_range() sets them up.
+ **/
+int pci_enable_msix_range_affinity(struct pci_dev *dev,
+				   struct msix_entry *entries,
+				   int minvec, int maxvec)
+{
+	struct cpumask *masks;
+	struct msi_desc *entry;
+	int nvec, i = 0;
+
+	nvec = pci_enable_msix_range(dev, entries, minvec, maxvec);
+	if (nvec < 0)
+		return nvec;
+
+	masks = irq_create_affinity_masks(nvec);
+	if (!masks)
+		return nvec;
+
+	list_for_each_entry(entry, &dev->msi_list, list) {
+		entry->affinity = kmemdup(&masks[i++], sizeof(*masks),
+					  GFP_KERNEL);
+		if (entry->affinity)
+			irq_set_affinity_managed(entry->irq, entry->affinity);
+	}
+
+	kfree(masks);
+	return nvec;
+}
+EXPORT_SYMBOL(pci_enable_msix_range_affinity);
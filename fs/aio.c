@@ -31,6 +31,7 @@
 #include <linux/timer.h>
 #include <linux/aio.h>
 #include <linux/highmem.h>
+#include <linux/pagemap.h>
 #include <linux/workqueue.h>
 #include <linux/security.h>
 #include <linux/eventfd.h>
@@ -40,6 +41,9 @@
 #include <linux/ramfs.h>
 #include <linux/percpu-refcount.h>
 #include <linux/mount.h>
+#include <linux/kthread.h>
+#include <linux/fdtable.h>
+#include <linux/cred.h>
 
 #include <asm/kmap_types.h>
 #include <asm/uaccess.h>
@@ -67,6 +71,10 @@ struct aio_ring {
 
 #define AIO_RING_PAGES	8
 
+#define AIO_SQ_MAX_ENTRIES	4096
+#define AIO_SQ_THREAD_IDLE	1000	/* msecs */
+#define AIO_SQ_THREAD_BATCH	32
+
 struct kioctx_table {
 	struct rcu_head	rcu;
 	unsigned	nr;
@@ -148,6 +156,27 @@ struct kioctx {
 	struct file		*aio_ring_file;
 
 	unsigned		id;
+
+	/*
+	 * Optional submission ring, set up by io_setup_sq().  It lives in
+	 * the ring pages following the completion ring, starting at page
+	 * sq_page.  sq_lock serializes consumers of the ring; the ring
+	 * pages themselves are still protected by ring_lock against page
+	 * migration.
+	 */
+	struct {
+		struct mutex	sq_lock;
+		unsigned	sq_head;
+		unsigned	sq_mask;
+		unsigned	sq_page;
+		unsigned	sq_flags;
+		bool		sq_compat;
+		unsigned long	sq_thread_idle;
+		wait_queue_head_t sq_wait;
+		struct mm_struct *sq_mm;
+		struct files_struct *sq_files;
+		const struct cred *sq_creds;
+	} ____cacheline_aligned_in_smp;
 };
 
 /*------ sysctl variables----*/
@@ -157,6 +186,9 @@ unsigned long aio_max_nr = 0x10000; /* system wide maximum number of aio request
 /*----end sysctl variables---*/
 
 static struct kmem_cache	*kiocb_cachep;
+
+/* completes buffered reads that missed the page cache at submission */
+static struct workqueue_struct *aio_read_wq;
 static struct kmem_cache	*kioctx_cachep;
 
 static struct vfsmount *aio_mnt;
@@ -223,6 +255,10 @@ static int __init aio_setup(void)
 	kiocb_cachep = KMEM_CACHE(kiocb, SLAB_HWCACHE_ALIGN|SLAB_PANIC);
 	kioctx_cachep = KMEM_CACHE(kioctx,SLAB_HWCACHE_ALIGN|SLAB_PANIC);
 
+	aio_read_wq = alloc_workqueue("aio_read", WQ_UNBOUND, 0);
+	if (!aio_read_wq)
+		panic("Failed to create aio read workqueue.");
+
 	pr_debug("sizeof(struct page) = %zu\n", sizeof(struct page));
 
 	return 0;
@@ -363,13 +399,13 @@ static const struct address_space_operations aio_ctx_aops = {
 #endif
 };
 
-static int aio_setup_ring(struct kioctx *ctx)
+static int aio_setup_ring(struct kioctx *ctx, unsigned sq_entries)
 {
 	struct aio_ring *ring;
 	unsigned nr_events = ctx->max_reqs;
 	struct mm_struct *mm = current->mm;
 	unsigned long size, unused;
-	int nr_pages;
+	int nr_pages, ev_pages;
 	int i;
 	struct file *file;
 
@@ -379,10 +415,15 @@ static int aio_setup_ring(struct kioctx *ctx)
 	size = sizeof(struct aio_ring);
 	size += sizeof(struct io_event) * nr_events;
 
-	nr_pages = PFN_UP(size);
-	if (nr_pages < 0)
+	ev_pages = PFN_UP(size);
+	if (ev_pages < 0)
 		return -EINVAL;
 
+	nr_pages = ev_pages;
+	if (sq_entries)
+		nr_pages += PFN_UP(sizeof(struct aio_sq_ring) +
+				   sizeof(struct iocb) * sq_entries);
+
 	file = aio_private_file(ctx, nr_pages);
 	if (IS_ERR(file)) {
 		ctx->aio_ring_file = NULL;
@@ -390,7 +431,7 @@ static int aio_setup_ring(struct kioctx *ctx)
 	}
 
 	ctx->aio_ring_file = file;
-	nr_events = (PAGE_SIZE * nr_pages - sizeof(struct aio_ring))
+	nr_events = (PAGE_SIZE * ev_pages - sizeof(struct aio_ring))
 			/ sizeof(struct io_event);
 
 	ctx->ring_pages = ctx->internal_pages;
@@ -454,6 +495,20 @@ static int aio_setup_ring(struct kioctx *ctx)
 	kunmap_atomic(ring);
 	flush_dcache_page(ctx->ring_pages[0]);
 
+	if (sq_entries) {
+		struct aio_sq_ring *sq;
+
+		ctx->sq_page = ev_pages;
+		ctx->sq_mask = sq_entries - 1;
+
+		sq = kmap_atomic(ctx->ring_pages[ctx->sq_page]);
+		sq->head = sq->tail = 0;
+		sq->mask = ctx->sq_mask;
+		sq->entries = sq_entries;
+		kunmap_atomic(sq);
+		flush_dcache_page(ctx->ring_pages[ctx->sq_page]);
+	}
+
 	return 0;
 }
 
@@ -504,6 +559,13 @@ static void free_ioctx(struct work_struct *work)
 
 	pr_debug("freeing %p\n", ctx);
 
+	if (ctx->sq_files)
+		put_files_struct(ctx->sq_files);
+	if (ctx->sq_creds)
+		put_cred(ctx->sq_creds);
+	if (ctx->sq_mm)
+		mmdrop(ctx->sq_mm);
+
 	aio_free_ring(ctx);
 	free_percpu(ctx->cpu);
 	kmem_cache_free(kioctx_cachep, ctx);
@@ -620,7 +682,7 @@ static void aio_nr_sub(unsigned nr)
 /* ioctx_alloc
  *	Allocates and initializes an ioctx.  Returns an ERR_PTR if it failed.
  */
-static struct kioctx *ioctx_alloc(unsigned nr_events)
+static struct kioctx *ioctx_alloc(unsigned nr_events, unsigned sq_entries)
 {
 	struct mm_struct *mm = current->mm;
 	struct kioctx *ctx;
@@ -662,6 +724,9 @@ static struct kioctx *ioctx_alloc(unsigned nr_events)
 	mutex_lock(&ctx->ring_lock);
 	init_waitqueue_head(&ctx->wait);
 
+	mutex_init(&ctx->sq_lock);
+	init_waitqueue_head(&ctx->sq_wait);
+
 	INIT_LIST_HEAD(&ctx->active_reqs);
 
 	if (percpu_ref_init(&ctx->users, free_ioctx_users))
@@ -674,7 +739,7 @@ static struct kioctx *ioctx_alloc(unsigned nr_events)
 	if (!ctx->cpu)
 		goto err;
 
-	err = aio_setup_ring(ctx);
+	err = aio_setup_ring(ctx, sq_entries);
 	if (err < 0)
 		goto err;
 
@@ -747,6 +812,7 @@ static int kill_ioctx(struct mm_struct *mm, struct kioctx *ctx,
 
 	/* percpu_ref_kill() will do the necessary call_rcu() */
 	wake_up_all(&ctx->wait);
+	wake_up_all(&ctx->sq_wait);
 
 	/*
 	 * It'd be more correct to do this in free_ioctx(), after all
@@ -1203,7 +1269,7 @@ SYSCALL_DEFINE2(io_setup, unsigned, nr_events, aio_context_t __user *, ctxp)
 		goto out;
 	}
 
-	ioctx = ioctx_alloc(nr_events);
+	ioctx = ioctx_alloc(nr_events, 0);
 	ret = PTR_ERR(ioctx);
 	if (!IS_ERR(ioctx)) {
 		ret = put_user(ioctx->user_id, ctxp);
@@ -1296,6 +1362,108 @@ static ssize_t aio_setup_single_vector(struct kiocb *kiocb,
 	return 0;
 }
 
+/*
+ * A buffered read that could not be satisfied from the page cache at
+ * submission time.  The submitter has already copied what was cached and
+ * started readahead for the rest; we wait for the first missing page to be
+ * unlocked and then finish the read from aio_read_wq in the submitter's mm.
+ */
+struct aio_buffered_read {
+	struct kiocb		*req;
+	struct mm_struct	*mm;
+	struct page		*page;		/* page being waited on */
+	wait_queue_t		wait;
+	struct work_struct	work;
+	ssize_t			done;		/* copied at submission */
+	struct iov_iter		iter;
+	struct iovec		iov[];
+};
+
+static void aio_buffered_read_work(struct work_struct *work)
+{
+	struct aio_buffered_read *r =
+		container_of(work, struct aio_buffered_read, work);
+	struct kiocb *req = r->req;
+	ssize_t ret;
+
+	if (r->page)
+		page_cache_release(r->page);
+
+	use_mm(r->mm);
+	req->ki_flags &= ~KIOCB_NOWAIT;
+	ret = req->ki_filp->f_op->read_iter(req, &r->iter);
+	unuse_mm(r->mm);
+
+	if (ret > 0)
+		ret += r->done;
+	else if (r->done)
+		ret = r->done;
+
+	/* complete before mmput(), which may end up in exit_aio() */
+	aio_complete(req, ret, 0);
+	mmput(r->mm);
+	kfree(r);
+}
+
+static int aio_buffered_read_wake(wait_queue_t *wait, unsigned mode,
+				  int sync, void *arg)
+{
+	struct aio_buffered_read *r =
+		container_of(wait, struct aio_buffered_read, wait);
+	struct wait_bit_key *key = arg;
+
+	if (key->flags != &r->page->flags || key->bit_nr != PG_locked)
+		return 0;
+
+	list_del_init(&wait->task_list);
+	queue_work(aio_read_wq, &r->work);
+	return 1;
+}
+
+/*
+ * Hand the rest of a short non-blocking buffered read off to aio_read_wq.
+ * Returns -EIOCBQUEUED, or the result of finishing the read synchronously
+ * if we could not allocate the state to defer it.
+ */
+static ssize_t aio_defer_buffered_read(struct kiocb *req, ssize_t done,
+				       struct iov_iter *iter,
+				       const struct iovec *iovec,
+				       unsigned long nr_segs)
+{
+	struct address_space *mapping = req->ki_filp->f_mapping;
+	struct aio_buffered_read *r;
+	ssize_t ret;
+
+	r = kmalloc(sizeof(*r) + nr_segs * sizeof(struct iovec), GFP_KERNEL);
+	if (!r) {
+		req->ki_flags &= ~KIOCB_NOWAIT;
+		ret = req->ki_filp->f_op->read_iter(req, iter);
+		if (ret > 0)
+			return ret + done;
+		return done ? done : ret;
+	}
+
+	memcpy(r->iov, iovec, nr_segs * sizeof(struct iovec));
+	r->iter = *iter;
+	r->iter.iov = r->iov + (iter->iov - iovec);
+	r->req = req;
+	r->done = done;
+	r->mm = current->mm;
+	atomic_inc(&r->mm->mm_users);
+	INIT_WORK(&r->work, aio_buffered_read_work);
+	init_waitqueue_func_entry(&r->wait, aio_buffered_read_wake);
+
+	/*
+	 * If readahead didn't leave a locked page for us to wait on, the
+	 * worker has to do (or wait for) the I/O itself.
+	 */
+	r->page = find_get_page(mapping, req->ki_pos >> PAGE_CACHE_SHIFT);
+	if (!r->page || wait_on_page_locked_async(r->page, &r->wait))
+		queue_work(aio_read_wq, &r->work);
+
+	return -EIOCBQUEUED;
+}
+
 /*
  * aio_setup_iocb:
  *	Performs the initial checks and aio retry method
@@ -1364,8 +1532,28 @@ rw_common:
 			file_start_write(file);
 
 		if (iter_op) {
+			bool nowait = rw == READ &&
+				      S_ISREG(file_inode(file)->i_mode) &&
+				      !(file->f_flags & O_DIRECT);
+
 			iov_iter_init(&iter, rw, iovec, nr_segs, req->ki_nbytes);
+			if (nowait)
+				req->ki_flags |= KIOCB_NOWAIT;
 			ret = iter_op(req, &iter);
+
+			/*
+			 * Don't block the submitter on page cache misses:
+			 * if only part of a buffered read was cached, finish
+			 * it once the readahead I/O has completed.
+			 */
+			if (nowait && (ret == -EAGAIN ||
+				       (ret >= 0 && iov_iter_count(&iter) &&
+					req->ki_pos < i_size_read(file_inode(file)))))
+				ret = aio_defer_buffered_read(req,
+						ret > 0 ? ret : 0, &iter,
+						iovec, nr_segs);
+			else
+				req->ki_flags &= ~KIOCB_NOWAIT;
 		} else {
 			ret = rw_op(req, iovec, nr_segs, req->ki_pos);
 		}
@@ -1458,10 +1646,13 @@ static int io_submit_one(struct kioctx *ctx, struct iocb __user *user_iocb,
 		}
 	}
 
-	ret = put_user(KIOCB_KEY, &user_iocb->aio_key);
-	if (unlikely(ret)) {
-		pr_debug("EFAULT: aio_key\n");
-		goto out_put_req;
+	/* iocbs taken from the submission ring have no userspace copy */
+	if (user_iocb) {
+		ret = put_user(KIOCB_KEY, &user_iocb->aio_key);
+		if (unlikely(ret)) {
+			pr_debug("EFAULT: aio_key\n");
+			goto out_put_req;
+		}
 	}
 
 	req->ki_obj.user = user_iocb;
@@ -1483,6 +1674,105 @@ out_put_req:
 	return ret;
 }
 
+static void aio_sq_update_flags(struct kioctx *ctx, unsigned flags)
+{
+	struct aio_sq_ring *sq;
+
+	mutex_lock(&ctx->ring_lock);
+	ctx->sq_flags = flags;
+	sq = kmap_atomic(ctx->ring_pages[ctx->sq_page]);
+	sq->flags = flags;
+	kunmap_atomic(sq);
+	flush_dcache_page(ctx->ring_pages[ctx->sq_page]);
+	mutex_unlock(&ctx->ring_lock);
+}
+
+/* aio_sq_peek
+ *	Copy the iocb at the head of the submission ring into *iocb, without
+ *	consuming it.  Returns false if the ring is empty.  Caller must hold
+ *	ctx->sq_lock.
+ */
+static bool aio_sq_peek(struct kioctx *ctx, struct iocb *iocb)
+{
+	struct aio_sq_ring *sq;
+	struct iocb *slot;
+	unsigned long off;
+	unsigned tail;
+
+	mutex_lock(&ctx->ring_lock);
+
+	/* Access to ->ring_pages here is protected by ctx->ring_lock. */
+	sq = kmap_atomic(ctx->ring_pages[ctx->sq_page]);
+	tail = ACCESS_ONCE(sq->tail);
+	kunmap_atomic(sq);
+
+	if (ctx->sq_head == tail) {
+		mutex_unlock(&ctx->ring_lock);
+		return false;
+	}
+
+	/* read the iocb only after we have seen the tail that covers it */
+	smp_rmb();
+
+	/*
+	 * The ring header and struct iocb are both 64 bytes, so a slot never
+	 * straddles a page boundary.
+	 */
+	off = sizeof(struct aio_sq_ring) +
+	      (ctx->sq_head & ctx->sq_mask) * sizeof(struct iocb);
+	slot = kmap_atomic(ctx->ring_pages[ctx->sq_page + off / PAGE_SIZE]);
+	memcpy(iocb, (void *)slot + off % PAGE_SIZE, sizeof(*iocb));
+	kunmap_atomic(slot);
+
+	mutex_unlock(&ctx->ring_lock);
+	return true;
+}
+
+static void aio_sq_advance(struct kioctx *ctx, bool dropped)
+{
+	struct aio_sq_ring *sq;
+
+	mutex_lock(&ctx->ring_lock);
+	sq = kmap_atomic(ctx->ring_pages[ctx->sq_page]);
+	sq->head = ++ctx->sq_head;
+	if (dropped)
+		sq->dropped++;
+	kunmap_atomic(sq);
+	flush_dcache_page(ctx->ring_pages[ctx->sq_page]);
+	mutex_unlock(&ctx->ring_lock);
+}
+
+/* aio_sq_submit
+ *	Submit up to nr iocbs from the submission ring.  An iocb that fails
+ *	to submit is consumed and counted in the ring's dropped field, except
+ *	for -EAGAIN which leaves it queued so it can be retried once events
+ *	have been reaped.  Returns the number of iocbs submitted.
+ */
+static long aio_sq_submit(struct kioctx *ctx, long nr)
+{
+	struct blk_plug plug;
+	struct iocb tmp;
+	long i = 0;
+	int ret;
+
+	mutex_lock(&ctx->sq_lock);
+	blk_start_plug(&plug);
+
+	while (i < nr && aio_sq_peek(ctx, &tmp)) {
+		ret = io_submit_one(ctx, NULL, &tmp, ctx->sq_compat);
+		if (ret == -EAGAIN)
+			break;
+
+		aio_sq_advance(ctx, ret != 0);
+		if (!ret)
+			i++;
+	}
+
+	blk_finish_plug(&plug);
+	mutex_unlock(&ctx->sq_lock);
+	return i;
+}
+
 long do_io_submit(aio_context_t ctx_id, long nr,
 		  struct iocb __user *__user *iocbpp, bool compat)
 {
@@ -1494,6 +1784,27 @@ long do_io_submit(aio_context_t ctx_id, long nr,
 	if (unlikely(nr < 0))
 		return -EINVAL;
 
+	/*
+	 * A NULL iocb array on a context with a submission ring means
+	 * "consume the ring", or just kick the submission thread if
+	 * there is one.
+	 */
+	if (!iocbpp) {
+		ctx = lookup_ioctx(ctx_id);
+		if (unlikely(!ctx))
+			return -EINVAL;
+
+		if (!ctx->sq_page)
+			ret = nr ? -EFAULT : 0;
+		else if (ctx->sq_mm)
+			wake_up(&ctx->sq_wait);
+		else
+			ret = aio_sq_submit(ctx, nr);
+
+		percpu_ref_put(&ctx->users);
+		return ret;
+	}
+
 	if (unlikely(nr > LONG_MAX/sizeof(*iocbpp)))
 		nr = LONG_MAX/sizeof(*iocbpp);
 
@@ -1554,6 +1865,176 @@ SYSCALL_DEFINE3(io_submit, aio_context_t, ctx_id, long, nr,
 	return do_io_submit(ctx_id, nr, iocbpp, 0);
 }
 
+static bool aio_sq_empty(struct kioctx *ctx)
+{
+	struct aio_sq_ring *sq;
+	bool empty;
+
+	mutex_lock(&ctx->ring_lock);
+	sq = kmap_atomic(ctx->ring_pages[ctx->sq_page]);
+	empty = ACCESS_ONCE(sq->tail) == ctx->sq_head;
+	kunmap_atomic(sq);
+	mutex_unlock(&ctx->ring_lock);
+
+	return empty;
+}
+
+/* aio_sq_thread
+ *	Polls the submission ring on behalf of the task that created the
+ *	context, running with its mm, files and credentials.  After
+ *	sq_thread_idle jiffies without work it sets AIO_SQ_NEED_WAKEUP and
+ *	sleeps until io_submit(ctx, 0, NULL) or io_destroy() wakes it.
+ *
+ *	The thread holds a reference on ctx->reqs, so the kioctx stays around
+ *	until it notices ctx->dead.  It only pins the mm while submitting, so
+ *	that the owner exiting still tears the context down via exit_aio().
+ */
+static int aio_sq_thread(void *data)
+{
+	struct kioctx *ctx = data;
+	struct mm_struct *mm = ctx->sq_mm;
+	struct files_struct *old_files;
+	const struct cred *old_cred;
+	unsigned long timeout;
+	DEFINE_WAIT(wait);
+
+	old_cred = override_creds(ctx->sq_creds);
+
+	task_lock(current);
+	old_files = current->files;
+	current->files = ctx->sq_files;
+	task_unlock(current);
+
+	timeout = jiffies + ctx->sq_thread_idle;
+	while (!atomic_read(&ctx->dead)) {
+		long nr;
+
+		if (!atomic_inc_not_zero(&mm->mm_users))
+			break;
+
+		use_mm(mm);
+		nr = aio_sq_submit(ctx, AIO_SQ_THREAD_BATCH);
+		unuse_mm(mm);
+		mmput(mm);
+
+		if (nr || time_before(jiffies, timeout)) {
+			if (nr)
+				timeout = jiffies + ctx->sq_thread_idle;
+			cond_resched();
+			continue;
+		}
+
+		prepare_to_wait(&ctx->sq_wait, &wait, TASK_INTERRUPTIBLE);
+		aio_sq_update_flags(ctx, ctx->sq_flags | AIO_SQ_NEED_WAKEUP);
+
+		/* pairs with the tail update made by userspace */
+		smp_mb();
+		if (aio_sq_empty(ctx) && !atomic_read(&ctx->dead))
+			schedule();
+
+		finish_wait(&ctx->sq_wait, &wait);
+		aio_sq_update_flags(ctx, ctx->sq_flags & ~AIO_SQ_NEED_WAKEUP);
+		timeout = jiffies + ctx->sq_thread_idle;
+	}
+
+	task_lock(current);
+	current->files = old_files;
+	task_unlock(current);
+
+	revert_creds(old_cred);
+
+	percpu_ref_put(&ctx->reqs);
+	return 0;
+}
+
+static int aio_sq_start_thread(struct kioctx *ctx, struct aio_sq_params *p)
+{
+	struct task_struct *tsk;
+
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	ctx->sq_thread_idle = msecs_to_jiffies(p->sq_thread_idle ?
+					       : AIO_SQ_THREAD_IDLE);
+
+	ctx->sq_files = get_files_struct(current);
+	ctx->sq_creds = get_current_cred();
+	atomic_inc(&current->mm->mm_count);
+	ctx->sq_mm = current->mm;
+
+	tsk = kthread_create(aio_sq_thread, ctx, "aio_sq/%d",
+			     task_pid_nr(current));
+	if (IS_ERR(tsk))
+		return PTR_ERR(tsk);
+
+	percpu_ref_get(&ctx->reqs);	/* aio_sq_thread() will drop this */
+	wake_up_process(tsk);
+	return 0;
+}
+
+/* sys_io_setup_sq:
+ *	Like io_setup(), but also create a submission ring of at least
+ *	params->sq_entries iocbs in the context's mapping.  The offset of
+ *	the ring from the context address is returned in params->sq_off.
+ *	iocbs placed on the ring are submitted by io_submit(ctx, nr, NULL),
+ *	or without any syscall by a kernel thread if AIO_SQ_THREAD is set in
+ *	params->flags.  May fail with -EPERM if AIO_SQ_THREAD is requested
+ *	without CAP_SYS_ADMIN, otherwise fails like io_setup().
+ */
+SYSCALL_DEFINE3(io_setup_sq, unsigned, nr_events,
+		struct aio_sq_params __user *, params,
+		aio_context_t __user *, ctxp)
+{
+	struct kioctx *ioctx;
+	struct aio_sq_params p;
+	unsigned long ctx;
+	long ret;
+	int i;
+
+	if (copy_from_user(&p, params, sizeof(p)))
+		return -EFAULT;
+
+	ret = get_user(ctx, ctxp);
+	if (unlikely(ret))
+		return ret;
+
+	if (unlikely(ctx || nr_events == 0))
+		return -EINVAL;
+
+	if (p.flags & ~AIO_SQ_THREAD)
+		return -EINVAL;
+
+	for (i = 0; i < ARRAY_SIZE(p.resv); i++)
+		if (p.resv[i])
+			return -EINVAL;
+
+	if (!p.sq_entries || p.sq_entries > AIO_SQ_MAX_ENTRIES)
+		return -EINVAL;
+
+	p.sq_entries = roundup_pow_of_two(p.sq_entries);
+
+	ioctx = ioctx_alloc(nr_events, p.sq_entries);
+	if (IS_ERR(ioctx))
+		return PTR_ERR(ioctx);
+
+	ioctx->sq_compat = is_compat_task();
+	p.sq_off = ioctx->sq_page << PAGE_SHIFT;
+
+	ret = 0;
+	if (p.flags & AIO_SQ_THREAD)
+		ret = aio_sq_start_thread(ioctx, &p);
+
+	if (!ret && copy_to_user(params, &p, sizeof(p)))
+		ret = -EFAULT;
+	if (!ret)
+		ret = put_user(ioctx->user_id, ctxp);
+	if (ret)
+		kill_ioctx(current->mm, ioctx, NULL);
+	percpu_ref_put(&ioctx->users);
+
+	return ret;
+}
+
 /* lookup_kiocb
  *	Finds a given iocb for cancellation.
  */
@@ -2627,6 +2627,128 @@ static int key_search(struct extent_buffer *b, struct btrfs_key *key,
 	return 0;
 }
 
+/* how often an optimistic descent may be raced before we take locks */
+#define BTRFS_OPTIMISTIC_RETRIES 3
+
+/*
+ * Optimistic lock coupling for the upper levels of btrfs_search_slot.
+ *
+ * Nodes above unlocked_level are searched without taking their tree locks.
+ * We sample the write sequence of each node, search it for the child
+ * pointer, and then check that no writer locked the node in the meantime.
+ * Only the first node at or below unlocked_level is really locked, and its
+ * parent is validated once more after that.  Inserts into different parts
+ * of a busy tree then share the upper nodes read-only instead of all
+ * bouncing the lock of the root.
+ *
+ * Anything that would need a lock up there makes us give up and return
+ * NULL with an empty path: blocks that must be COWed, nodes that may be
+ * split or merged, slot zero changes on insert or delete, and children
+ * that aren't cached and uptodate.  The caller then does the normal locked
+ * descent.  Otherwise the locked node is returned with a reference and
+ * *lock_type set, and the nodes above it are left in the path unlocked.
+ */
+static struct extent_buffer *
+search_optimistic(struct btrfs_trans_handle *trans, struct btrfs_root *root,
+		  struct btrfs_key *key, struct btrfs_path *p, int ins_len,
+		  int cow, int unlocked_level, int write_lock_level,
+		  int *lock_type)
+{
+	struct extent_buffer *b;
+	struct extent_buffer *child;
+	unsigned int seq;
+	unsigned int child_seq;
+	int retries = 0;
+	int level;
+	int slot;
+	int ret;
+	u32 nritems;
+	u64 blocknr;
+	u64 gen;
+
+again:
+	b = btrfs_root_node(root);
+	seq = btrfs_tree_write_seq(b);
+	level = btrfs_header_level(b);
+	p->nodes[level] = b;
+	if (b != root->node)
+		goto retry;
+
+	while (1) {
+		if (level <= unlocked_level)
+			goto fallback;
+		if (cow && should_cow_block(trans, root, b))
+			goto fallback;
+
+		nritems = btrfs_header_nritems(b);
+		if (!nritems || nritems > BTRFS_NODEPTRS_PER_BLOCK(root))
+			goto fallback;
+		if ((ins_len > 0 || p->search_for_split) &&
+		    nritems >= BTRFS_NODEPTRS_PER_BLOCK(root) - 3)
+			goto fallback;
+		if (ins_len < 0 &&
+		    nritems < BTRFS_NODEPTRS_PER_BLOCK(root) / 2)
+			goto fallback;
+
+		ret = bin_search(b, key, level, &slot);
+		if (ret && slot > 0)
+			slot -= 1;
+		if (ins_len && slot == 0)
+			goto fallback;
+		blocknr = btrfs_node_blockptr(b, slot);
+		gen = btrfs_node_ptr_generation(b, slot);
+		if (btrfs_tree_write_seq_retry(b, seq))
+			goto retry;
+		p->slots[level] = slot;
+
+		child = btrfs_find_tree_block(root, blocknr,
+					      btrfs_level_size(root, level - 1));
+		if (!child)
+			goto fallback;
+		if (btrfs_buffer_uptodate(child, gen, 1) <= 0 ||
+		    btrfs_header_level(child) != level - 1) {
+			free_extent_buffer(child);
+			goto fallback;
+		}
+		level--;
+
+		if (level <= unlocked_level) {
+			if (level <= write_lock_level) {
+				btrfs_tree_lock(child);
+				*lock_type = BTRFS_WRITE_LOCK;
+			} else {
+				btrfs_tree_read_lock(child);
+				*lock_type = BTRFS_READ_LOCK;
+			}
+			if (btrfs_tree_write_seq_retry(b, seq)) {
+				btrfs_tree_unlock_rw(child, *lock_type);
+				free_extent_buffer(child);
+				goto retry;
+			}
+			return child;
+		}
+
+		/* the child is only ours if its parent didn't change */
+		child_seq = btrfs_tree_write_seq(child);
+		if (btrfs_tree_write_seq_retry(b, seq)) {
+			free_extent_buffer(child);
+			goto retry;
+		}
+		b = child;
+		seq = child_seq;
+		p->nodes[level] = b;
+	}
+
+retry:
+	btrfs_release_path(p);
+	if (++retries <= BTRFS_OPTIMISTIC_RETRIES)
+		goto again;
+	return NULL;
+fallback:
+	btrfs_release_path(p);
+	return NULL;
+}
+
 int btrfs_find_item(struct btrfs_root *fs_root, struct btrfs_path *found_path,
 		u64 iobjectid, u64 ioff, u8 key_type,
 		struct btrfs_key *found_key)
@@ -2699,6 +2821,7 @@ int btrfs_search_slot(struct btrfs_trans_handle *trans, struct btrfs_root
 	u8 lowest_level = 0;
 	int min_write_lock_level;
 	int prev_cmp;
+	int optimistic;
 
 	lowest_level = p->lowest_level;
 	WARN_ON(lowest_level && ins_len > 0);
@@ -2729,6 +2852,13 @@ int btrfs_search_slot(struct btrfs_trans_handle *trans, struct btrfs_root
 
 	min_write_lock_level = write_lock_level;
 
+	/*
+	 * with keep_locks the caller wants the upper levels locked,
+	 * so they can't be walked optimistically
+	 */
+	optimistic = !p->search_commit_root && !p->skip_locking &&
+		     !p->keep_locks;
+
 again:
 	prev_cmp = -1;
 	/*
@@ -2754,6 +2884,12 @@ again:
 		if (p->skip_locking) {
 			b = btrfs_root_node(root);
 			level = btrfs_header_level(b);
+		} else if (optimistic &&
+			   (b = search_optimistic(trans, root, key, p, ins_len,
+					cow, max_t(int, write_lock_level,
+						   lowest_level),
+					write_lock_level, &root_lock))) {
+			level = btrfs_header_level(b);
 		} else {
 			/* we don't know the level of the root node
 			 * until we actually have it read locked
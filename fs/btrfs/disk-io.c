@@ -253,6 +253,47 @@ void btrfs_csum_final(u32 crc, char *result)
 	put_unaligned_le32(~crc, result);
 }
 
+/*
+ * compute the final csums of nr blocks of len bytes each, the results are
+ * in the same format as btrfs_csum_final() produces
+ */
+void btrfs_csum_data_multi(u8 * const *data, size_t len, u32 *csums, int nr)
+{
+	int i;
+
+	btrfs_crc32c_multi(~(u32)0, data, len, csums, nr);
+	for (i = 0; i < nr; i++)
+		btrfs_csum_final(csums[i], (char *)(csums + i));
+}
+
+/*
+ * csum up to BTRFS_CSUM_BATCH bvecs in one call.  The batch stops at the
+ * first bvec whose length differs from the first one, the number of csums
+ * stored is returned.
+ */
+int btrfs_csum_bvecs(struct bio_vec *bvec, int nr, u32 *csums)
+{
+	char *kaddr[BTRFS_CSUM_BATCH];
+	u8 *data[BTRFS_CSUM_BATCH];
+	int i;
+
+	nr = min(nr, BTRFS_CSUM_BATCH);
+	for (i = 0; i < nr; i++) {
+		if (bvec[i].bv_len != bvec[0].bv_len)
+			break;
+		kaddr[i] = kmap_atomic(bvec[i].bv_page);
+		data[i] = kaddr[i] + bvec[i].bv_offset;
+	}
+	nr = i;
+
+	btrfs_csum_data_multi(data, bvec[0].bv_len, csums, nr);
+
+	/* atomic kmaps have to be dropped in reverse order */
+	while (i--)
+		kunmap_atomic(kaddr[i]);
+	return nr;
+}
+
 /*
  * compute the csum for a btree block, and either verify it or write it
  * into the csum field of the block.
@@ -2538,9 +2579,10 @@ int open_ctree(struct super_block *sb,
 
 	max_active = fs_info->thread_pool_size;
 
+	/* the async submit workers csum data bios */
 	fs_info->workers =
 		btrfs_alloc_workqueue("worker", flags | WQ_HIGHPRI,
-				      max_active, 16);
+				      btrfs_csum_max_active(max_active), 16);
 
 	fs_info->delalloc_workers =
 		btrfs_alloc_workqueue("delalloc", flags, max_active, 2);
@@ -2569,7 +2611,8 @@ int open_ctree(struct super_block *sb,
 	 * low idle thresh
 	 */
 	fs_info->endio_workers =
-		btrfs_alloc_workqueue("endio", flags, max_active, 4);
+		btrfs_alloc_workqueue("endio", flags,
+				      btrfs_csum_max_active(max_active), 4);
 	fs_info->endio_meta_workers =
 		btrfs_alloc_workqueue("endio-meta", flags, max_active, 4);
 	fs_info->endio_meta_write_workers =
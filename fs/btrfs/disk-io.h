@@ -25,6 +25,9 @@
 #define BTRFS_SUPER_MIRROR_MAX	 3
 #define BTRFS_SUPER_MIRROR_SHIFT 12
 
+/* data blocks checksummed per btrfs_csum_bvecs() call */
+#define BTRFS_CSUM_BATCH 8
+
 enum {
 	BTRFS_WQ_ENDIO_DATA = 0,
 	BTRFS_WQ_ENDIO_METADATA = 1,
@@ -118,6 +121,19 @@ int btrfs_set_buffer_uptodate(struct extent_buffer *buf);
 int btrfs_read_buffer(struct extent_buffer *buf, u64 parent_transid);
 u32 btrfs_csum_data(char *data, u32 seed, size_t len);
 void btrfs_csum_final(u32 crc, char *result);
+void btrfs_csum_data_multi(u8 * const *data, size_t len, u32 *csums, int nr);
+int btrfs_csum_bvecs(struct bio_vec *bvec, int nr, u32 *csums);
+
+/*
+ * Data checksumming is CPU bound.  Unbound workqueues keep a pool per NUMA
+ * node and apply max_active to each one, so let the queues that csum data
+ * use every CPU of a node even when thread_pool is smaller.
+ */
+static inline int btrfs_csum_max_active(int max_active)
+{
+	return max_t(int, max_active,
+		     DIV_ROUND_UP(num_online_cpus(), num_online_nodes()));
+}
 int btrfs_bio_wq_end_io(struct btrfs_fs_info *info, struct bio *bio,
 			int metadata);
 int btrfs_wq_submit_bio(struct btrfs_fs_info *fs_info, struct inode *inode,
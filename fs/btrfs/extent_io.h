@@ -146,6 +146,12 @@ struct extent_buffer {
 	atomic_t spinning_writers;
 	int lock_nested;
 
+	/*
+	 * bumped when a writer takes and drops the lock, odd while write
+	 * locked.  Lets searches walk upper nodes without locking them.
+	 */
+	unsigned int write_seq;
+
 	/* protects write locks */
 	rwlock_t lock;
 
@@ -438,13 +438,15 @@ int btrfs_csum_one_bio(struct btrfs_root *root, struct inode *inode,
 {
 	struct btrfs_ordered_sum *sums;
 	struct btrfs_ordered_extent *ordered;
-	char *data;
 	struct bio_vec *bvec = bio->bi_io_vec;
 	int bio_index = 0;
 	int index;
 	unsigned long total_bytes = 0;
 	unsigned long this_sum_bytes = 0;
 	u64 offset;
+	u32 csums[BTRFS_CSUM_BATCH];
+	int next_csum = 0;
+	int nr_csums = 0;
 
 	WARN_ON(bio->bi_vcnt <= 0);
 	sums = kzalloc(btrfs_ordered_sum_size(root, bio->bi_iter.bi_size),
@@ -490,14 +492,14 @@ int btrfs_csum_one_bio(struct btrfs_root *root, struct inode *inode,
 			index = 0;
 		}
 
-		data = kmap_atomic(bvec->bv_page);
-		sums->sums[index] = ~(u32)0;
-		sums->sums[index] = btrfs_csum_data(data + bvec->bv_offset,
-						    sums->sums[index],
-						    bvec->bv_len);
-		kunmap_atomic(data);
-		btrfs_csum_final(sums->sums[index],
-				 (char *)(sums->sums + index));
+		/* csum the next few blocks together */
+		if (next_csum == nr_csums) {
+			nr_csums = btrfs_csum_bvecs(bvec,
+						    bio->bi_vcnt - bio_index,
+						    csums);
+			next_csum = 0;
+		}
+		sums->sums[index] = csums[next_csum++];
 
 		bio_index++;
 		index++;
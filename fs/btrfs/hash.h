@@ -24,6 +24,8 @@ int __init btrfs_hash_init(void);
 void btrfs_hash_exit(void);
 
 u32 btrfs_crc32c(u32 crc, const void *address, unsigned int length);
+void btrfs_crc32c_multi(u32 seed, u8 * const *data, unsigned int length,
+			u32 *crcs, int nr);
 
 static inline u64 btrfs_name_hash(const char *name, int len)
 {
@@ -7082,24 +7082,29 @@ static void btrfs_endio_direct_read(struct bio *bio, int err)
 	struct btrfs_root *root = BTRFS_I(inode)->root;
 	struct bio *dio_bio;
 	u32 *csums = (u32 *)dip->csum;
+	u32 batch[BTRFS_CSUM_BATCH];
+	int next_csum = 0;
+	int nr_csums = 0;
 	u64 start;
 	int i;
 
 	start = dip->logical_offset;
 	bio_for_each_segment_all(bvec, bio, i) {
 		if (!(BTRFS_I(inode)->flags & BTRFS_INODE_NODATASUM)) {
-			struct page *page = bvec->bv_page;
-			char *kaddr;
-			u32 csum = ~(u32)0;
-			unsigned long flags;
-
-			local_irq_save(flags);
-			kaddr = kmap_atomic(page);
-			csum = btrfs_csum_data(kaddr + bvec->bv_offset,
-					       csum, bvec->bv_len);
-			btrfs_csum_final(csum, (char *)&csum);
-			kunmap_atomic(kaddr);
-			local_irq_restore(flags);
+			u32 csum;
+
+			/* csum the next few blocks together */
+			if (next_csum == nr_csums) {
+				unsigned long flags;
+
+				local_irq_save(flags);
+				nr_csums = btrfs_csum_bvecs(bvec,
+							    bio->bi_vcnt - i,
+							    batch);
+				local_irq_restore(flags);
+				next_csum = 0;
+			}
+			csum = batch[next_csum++];
 
 			flush_dcache_page(bvec->bv_page);
 			if (csum != csums[i]) {
@@ -169,6 +169,8 @@ int btrfs_try_tree_write_lock(struct extent_buffer *eb)
 	atomic_inc(&eb->write_locks);
 	atomic_inc(&eb->spinning_writers);
 	eb->lock_owner = current->pid;
+	eb->write_seq++;
+	smp_wmb();
 	return 1;
 }
 
@@ -243,6 +245,8 @@ again:
 	atomic_inc(&eb->spinning_writers);
 	atomic_inc(&eb->write_locks);
 	eb->lock_owner = current->pid;
+	eb->write_seq++;
+	smp_wmb();
 }
 
 /*
@@ -258,6 +262,10 @@ void btrfs_tree_unlock(struct extent_buffer *eb)
 	eb->lock_owner = 0;
 	atomic_dec(&eb->write_locks);
 
+	/* let optimistic readers see our changes before the new sequence */
+	smp_wmb();
+	eb->write_seq++;
+
 	if (blockers) {
 		WARN_ON(atomic_read(&eb->spinning_writers));
 		atomic_dec(&eb->blocking_writers);
@@ -48,6 +48,27 @@ static inline void btrfs_tree_unlock_rw(struct extent_buffer *eb, int rw)
 		BUG();
 }
 
+/*
+ * Optimistic readers sample the write sequence of a block, read it without
+ * any lock, and then use btrfs_tree_write_seq_retry() to check that no
+ * writer held the lock in the meantime.  An odd sequence means the block
+ * is write locked right now.
+ */
+static inline unsigned int btrfs_tree_write_seq(struct extent_buffer *eb)
+{
+	unsigned int seq = ACCESS_ONCE(eb->write_seq);
+
+	smp_rmb();
+	return seq;
+}
+
+static inline int btrfs_tree_write_seq_retry(struct extent_buffer *eb,
+					     unsigned int seq)
+{
+	smp_rmb();
+	return (seq & 1) || ACCESS_ONCE(eb->write_seq) != seq;
+}
+
 static inline void btrfs_set_lock_blocking(struct extent_buffer *eb)
 {
 	btrfs_set_lock_blocking_rw(eb, BTRFS_WRITE_LOCK);
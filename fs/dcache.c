@@ -38,6 +38,7 @@
 #include <linux/prefetch.h>
 #include <linux/ratelimit.h>
 #include <linux/list_lru.h>
+#include <linux/percpu_counter.h>
 #include "internal.h"
 #include "mount.h"
 
@@ -118,6 +119,29 @@ struct dentry_stat_t dentry_stat = {
 static DEFINE_PER_CPU(long, nr_dentry);
 static DEFINE_PER_CPU(long, nr_dentry_unused);
 
+/*
+ * Unlike the counters above this one is read on every final dput() of a
+ * negative dentry once a limit is set, so it needs a cheap approximate
+ * global value and is a generic per-cpu counter.
+ */
+static struct percpu_counter nr_dentry_negative;
+
+/*
+ * Upper bound on the number of negative dentries, 0 for none.  Past it an
+ * unused negative dentry is freed right away instead of being kept on
+ * the LRU, so repeated misses stay cheap without negative entries taking
+ * over the cache.
+ */
+unsigned long sysctl_dentry_negative_limit __read_mostly;
+
+static inline bool dentry_negative_over_limit(void)
+{
+	unsigned long limit = ACCESS_ONCE(sysctl_dentry_negative_limit);
+
+	return limit &&
+	       percpu_counter_read_positive(&nr_dentry_negative) > limit;
+}
+
 #if defined(CONFIG_SYSCTL) && defined(CONFIG_PROC_FS)
 
 /*
@@ -155,6 +179,8 @@ int proc_nr_dentry(struct ctl_table *table, int write, void __user *buffer,
 {
 	dentry_stat.nr_dentry = get_nr_dentry();
 	dentry_stat.nr_unused = get_nr_dentry_unused();
+	dentry_stat.nr_negative =
+		percpu_counter_sum_positive(&nr_dentry_negative);
 	return proc_doulongvec_minmax(table, write, buffer, lenp, ppos);
 }
 #endif
@@ -305,6 +331,7 @@ static void dentry_unlink_inode(struct dentry * dentry)
 {
 	struct inode *inode = dentry->d_inode;
 	__d_clear_type(dentry);
+	percpu_counter_inc(&nr_dentry_negative);
 	dentry->d_inode = NULL;
 	hlist_del_init(&dentry->d_alias);
 	dentry_rcuwalk_barrier(dentry);
@@ -481,6 +508,8 @@ static void __dentry_kill(struct dentry *dentry)
 	 */
 	BUG_ON((int)dentry->d_lockref.count > 0);
 	this_cpu_dec(nr_dentry);
+	if (d_is_negative(dentry))
+		percpu_counter_dec(&nr_dentry_negative);
 	if (dentry->d_op && dentry->d_op->d_release)
 		dentry->d_op->d_release(dentry);
 
@@ -605,6 +634,9 @@ repeat:
 			goto kill_it;
 	}
 
+	if (d_is_negative(dentry) && dentry_negative_over_limit())
+		goto kill_it;
+
 	if (!(dentry->d_flags & DCACHE_REFERENCED))
 		dentry->d_flags |= DCACHE_REFERENCED;
 	dentry_lru_add(dentry);
@@ -968,24 +1000,22 @@ dentry_lru_isolate(struct list_head *item, spinlock_t *lru_lock, void *arg)
 /**
  * prune_dcache_sb - shrink the dcache
  * @sb: superblock
- * @nr_to_scan : number of entries to try to free
- * @nid: which node to scan for freeable entities
+ * @sc: shrink control, passed to list_lru_shrink_walk()
  *
- * Attempt to shrink the superblock dcache LRU by @nr_to_scan entries. This is
- * done when we need more memory an called from the superblock shrinker
- * function.
+ * Attempt to shrink the superblock dcache LRU by @sc->nr_to_scan entries of
+ * the node and memory cgroup it names. This is done when we need more memory
+ * an called from the superblock shrinker function.
  *
  * This function may fail to free any resources if all the dentries are in
  * use.
  */
-long prune_dcache_sb(struct super_block *sb, unsigned long nr_to_scan,
-		     int nid)
+long prune_dcache_sb(struct super_block *sb, struct shrink_control *sc)
 {
 	LIST_HEAD(dispose);
 	long freed;
 
-	freed = list_lru_walk_node(&sb->s_dentry_lru, nid, dentry_lru_isolate,
-				       &dispose, &nr_to_scan);
+	freed = list_lru_shrink_walk(&sb->s_dentry_lru, sc, dentry_lru_isolate,
+				     &dispose);
 	shrink_dentry_list(&dispose);
 	return freed;
 }
@@ -1480,6 +1510,7 @@ struct dentry *__d_alloc(struct super_block *sb, const struct qstr *name)
 	d_set_d_op(dentry, dentry->d_sb->s_d_op);
 
 	this_cpu_inc(nr_dentry);
+	percpu_counter_inc(&nr_dentry_negative);
 
 	return dentry;
 }
@@ -1597,6 +1628,8 @@ static void __d_instantiate(struct dentry *dentry, struct inode *inode)
 	unsigned add_flags = d_flags_for_inode(inode);
 
 	spin_lock(&dentry->d_lock);
+	if (inode && d_is_negative(dentry))
+		percpu_counter_dec(&nr_dentry_negative);
 	__d_set_type(dentry, add_flags);
 	if (inode)
 		hlist_add_head(&dentry->d_alias, &inode->i_dentry);
@@ -1835,6 +1868,7 @@ struct dentry *d_obtain_alias(struct inode *inode)
 	spin_lock(&tmp->d_lock);
 	tmp->d_inode = inode;
 	tmp->d_flags |= add_flags;
+	percpu_counter_dec(&nr_dentry_negative);
 	hlist_add_head(&tmp->d_alias, &inode->i_dentry);
 	hlist_bl_lock(&tmp->d_sb->s_anon);
 	hlist_bl_add_head(&tmp->d_hash, &tmp->d_sb->s_anon);
@@ -3372,6 +3406,9 @@ static void __init dcache_init(void)
 	dentry_cache = KMEM_CACHE(dentry,
 		SLAB_RECLAIM_ACCOUNT|SLAB_PANIC|SLAB_MEM_SPREAD);
 
+	if (percpu_counter_init(&nr_dentry_negative, 0))
+		panic("Failed to allocate the negative dentry counter");
+
 	/* Hash may have been set up in dcache_init_early */
 	if (!hashdist)
 		return;
@@ -125,6 +125,8 @@ struct dio {
 	unsigned long refcount;		/* direct_io_worker() and bios */
 	struct bio *bio_list;		/* singly linked via bi_private */
 	struct task_struct *waiter;	/* waiting task (NULL if none) */
+	bool hipri;			/* submitter polls for completion */
+	struct request_queue *poll_q;	/* queue to poll, NULL if none */
 
 	/* AIO related stuff */
 	struct kiocb *iocb;		/* kiocb */
@@ -385,6 +387,7 @@ static inline void dio_bio_submit(struct dio *dio, struct dio_submit *sdio)
 {
 	struct bio *bio = sdio->bio;
 	unsigned long flags;
+	int rw = dio->rw;
 
 	bio->bi_private = dio;
 
@@ -395,11 +398,16 @@ static inline void dio_bio_submit(struct dio *dio, struct dio_submit *sdio)
 	if (dio->is_async && dio->rw == READ)
 		bio_set_pages_dirty(bio);
 
+	if (dio->hipri) {
+		rw |= REQ_HIPRI;
+		dio->poll_q = bdev_get_queue(bio->bi_bdev);
+	}
+
 	if (sdio->submit_io)
-		sdio->submit_io(dio->rw, bio, dio->inode,
+		sdio->submit_io(rw, bio, dio->inode,
 			       sdio->logical_offset_in_bio);
 	else
-		submit_bio(dio->rw, bio);
+		submit_bio(rw, bio);
 
 	sdio->bio = NULL;
 	sdio->boundary = 0;
@@ -425,6 +433,7 @@ static struct bio *dio_await_one(struct dio *dio)
 {
 	unsigned long flags;
 	struct bio *bio = NULL;
+	bool may_sleep = true;
 
 	spin_lock_irqsave(&dio->bio_lock, flags);
 
@@ -438,7 +447,9 @@ static struct bio *dio_await_one(struct dio *dio)
 		__set_current_state(TASK_UNINTERRUPTIBLE);
 		dio->waiter = current;
 		spin_unlock_irqrestore(&dio->bio_lock, flags);
-		io_schedule();
+		if (!dio->poll_q || !blk_poll(dio->poll_q, may_sleep))
+			io_schedule();
+		may_sleep = false;
 		/* wake up sets us TASK_RUNNING */
 		spin_lock_irqsave(&dio->bio_lock, flags);
 		dio->waiter = NULL;
@@ -1178,6 +1189,9 @@ do_blockdev_direct_IO(int rw, struct kiocb *iocb, struct inode *inode,
 	dio->inode = inode;
 	dio->rw = rw;
 
+	/* Only a synchronous submitter is around to poll for completion */
+	dio->hipri = !dio->is_async && (iocb->ki_flags & KIOCB_HIPRI);
+
 	/*
 	 * For AIO O_(D)SYNC writes we need to defer completions to a workqueue
 	 * so that we can call ->fsync.
@@ -42,6 +42,7 @@
 #include <linux/seq_file.h>
 #include <linux/compat.h>
 #include <linux/rculist.h>
+#include <net/busy_poll.h>
 
 /*
  * LOCKING:
@@ -99,6 +100,9 @@
 
 #define EP_MAX_EVENTS (INT_MAX / sizeof(struct epoll_event))
 
+/* Upper bound for the EPIOCSBATCH coalescing delay */
+#define EP_MAX_BATCH_USECS USEC_PER_SEC
+
 #define EP_UNACTIVE_PTR ((void *) -1L)
 
 #define EP_ITEM_COST (sizeof(struct epitem) + sizeof(struct eppoll_entry))
@@ -219,6 +223,22 @@ struct eventpoll {
 	/* used to optimize loop detection check */
 	int visited;
 	struct list_head visited_list_link;
+
+	/*
+	 * Wakeup coalescing, set with EPIOCSBATCH.  A waiter is only woken
+	 * once batch_min items became ready, or batch_usecs after it started
+	 * waiting.  Everything is protected by ->lock.
+	 */
+	unsigned int batch_min;
+	unsigned int batch_usecs;
+	/* Items made ready since the current waiter went to sleep */
+	unsigned int batch_count;
+	ktime_t batch_deadline;
+
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	/* napi context of the most recently active socket, for busy polling */
+	unsigned int napi_id;
+#endif
 };
 
 /* Wait structure used by the poll hooks */
@@ -379,6 +399,81 @@ static inline int ep_events_available(struct eventpoll *ep)
 	return !list_empty(&ep->rdllist) || ep->ovflist != EP_UNACTIVE_PTR;
 }
 
+/*
+ * Tells whether a waiter on a coalescing instance should be given the
+ * ready list now.  Called with ep->lock held.
+ */
+static inline int ep_batch_done(struct eventpoll *ep)
+{
+	if (ep->batch_min <= 1)
+		return 1;
+	return ep->batch_count >= ep->batch_min ||
+	       !ktime_before(ktime_get(), ep->batch_deadline);
+}
+
+#ifdef CONFIG_NET_RX_BUSY_POLL
+static bool ep_busy_loop_end(void *p)
+{
+	struct eventpoll *ep = p;
+
+	return ep_events_available(ep) || signal_pending(current);
+}
+
+/*
+ * Busy poll the napi context last seen on one of our sockets, the same way
+ * poll/select do through sock_poll(), before going to sleep.
+ */
+static void ep_busy_loop(struct eventpoll *ep, int nonblock)
+{
+	unsigned int napi_id = ACCESS_ONCE(ep->napi_id);
+
+	if (napi_id && net_busy_loop_on() &&
+	    !need_resched() && !signal_pending(current))
+		napi_busy_loop(napi_id, nonblock ? 0 : busy_loop_end_time(),
+			       nonblock, ep_busy_loop_end, ep);
+}
+
+/* Remember the napi context a socket item is receiving from */
+static inline void ep_set_busy_poll_napi_id(struct epitem *epi)
+{
+	struct eventpoll *ep = epi->ep;
+	struct socket *sock;
+	unsigned int napi_id;
+	int err;
+
+	if (!net_busy_loop_on())
+		return;
+
+	sock = sock_from_file(epi->ffd.file, &err);
+	if (!sock || !sock->sk)
+		return;
+
+	napi_id = ACCESS_ONCE(sock->sk->sk_napi_id);
+	if (napi_id && ACCESS_ONCE(ep->napi_id) != napi_id)
+		ep->napi_id = napi_id;
+}
+#else
+static inline void ep_busy_loop(struct eventpoll *ep, int nonblock)
+{
+}
+
+static inline void ep_set_busy_poll_napi_id(struct epitem *epi)
+{
+}
+#endif /* CONFIG_NET_RX_BUSY_POLL */
+
+/* Count the ready list up to @max entries, called with ep->lock held */
+static unsigned int ep_count_ready(struct eventpoll *ep, unsigned int max)
+{
+	struct list_head *pos;
+	unsigned int n = 0;
+
+	list_for_each(pos, &ep->rdllist)
+		if (++n >= max)
+			break;
+	return n;
+}
+
 /**
  * ep_call_nested - Perform a bound (possibly) nested call, by checking
  *                  that the recursion limit is not exceeded, and that
@@ -893,12 +988,51 @@ static int ep_show_fdinfo(struct seq_file *m, struct file *f)
 #endif
 
 /* File callbacks that implement the eventpoll file behaviour */
+static long ep_eventpoll_ioctl(struct file *file, unsigned int cmd,
+			       unsigned long arg)
+{
+	struct eventpoll *ep = file->private_data;
+	void __user *argp = (void __user *)arg;
+	struct epoll_batch batch;
+
+	switch (cmd) {
+	case EPIOCSBATCH:
+		if (copy_from_user(&batch, argp, sizeof(batch)))
+			return -EFAULT;
+		if (batch.min_events > EP_MAX_EVENTS ||
+		    batch.max_wait_usecs > EP_MAX_BATCH_USECS)
+			return -EINVAL;
+		if (batch.min_events > 1 && !batch.max_wait_usecs)
+			return -EINVAL;
+
+		spin_lock_irq(&ep->lock);
+		ep->batch_min = batch.min_events;
+		ep->batch_usecs = batch.max_wait_usecs;
+		/* Let current waiters re-evaluate against the new settings */
+		if (waitqueue_active(&ep->wq))
+			wake_up_locked(&ep->wq);
+		spin_unlock_irq(&ep->lock);
+		return 0;
+	case EPIOCGBATCH:
+		spin_lock_irq(&ep->lock);
+		batch.min_events = ep->batch_min;
+		batch.max_wait_usecs = ep->batch_usecs;
+		spin_unlock_irq(&ep->lock);
+		if (copy_to_user(argp, &batch, sizeof(batch)))
+			return -EFAULT;
+		return 0;
+	}
+	return -ENOTTY;
+}
+
 static const struct file_operations eventpoll_fops = {
 #ifdef CONFIG_PROC_FS
 	.show_fdinfo	= ep_show_fdinfo,
 #endif
 	.release	= ep_eventpoll_release,
 	.poll		= ep_eventpoll_poll,
+	.unlocked_ioctl	= ep_eventpoll_ioctl,
+	.compat_ioctl	= ep_eventpoll_ioctl,
 	.llseek		= noop_llseek,
 };
 
@@ -1063,13 +1197,15 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	if (!ep_is_linked(&epi->rdllink)) {
 		list_add_tail(&epi->rdllink, &ep->rdllist);
 		ep_pm_stay_awake_rcu(epi);
+		ep->batch_count++;
 	}
 
 	/*
 	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
-	 * wait list.
+	 * wait list.  Waiters on a coalescing instance are left alone until
+	 * their batch is complete or its deadline has passed.
 	 */
-	if (waitqueue_active(&ep->wq))
+	if (waitqueue_active(&ep->wq) && ep_batch_done(ep))
 		wake_up_locked(&ep->wq);
 	if (waitqueue_active(&ep->poll_wait))
 		pwake++;
@@ -1328,6 +1464,7 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 	 * protected by "mtx", and ep_insert() is called with "mtx" held.
 	 */
 	ep_rbtree_insert(ep, epi);
+	ep_set_busy_poll_napi_id(epi);
 
 	/* now check if we've created too many backpaths */
 	error = -EINVAL;
@@ -1523,6 +1660,7 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 			}
 			eventcnt++;
 			uevent++;
+			ep_set_busy_poll_napi_id(epi);
 			if (epi->event.events & EPOLLONESHOT)
 				epi->event.events &= EP_PRIVATE_BITS;
 			else if (!(epi->event.events & EPOLLET)) {
@@ -1588,11 +1726,13 @@ static inline struct timespec ep_set_mstimeout(long ms)
 static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 		   int maxevents, long timeout)
 {
-	int res = 0, eavail, timed_out = 0;
+	int res = 0, eavail, timed_out = 0, batch_timed_out = 0;
 	unsigned long flags;
 	long slack = 0;
 	wait_queue_t wait;
 	ktime_t expires, *to = NULL;
+	ktime_t batch_expires = ktime_set(0, 0), *wait_to;
+	unsigned int batch_min = ACCESS_ONCE(ep->batch_min);
 
 	if (timeout > 0) {
 		struct timespec end_time = ep_set_mstimeout(timeout);
@@ -1610,14 +1750,31 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 		goto check_events;
 	}
 
+	/*
+	 * With wakeup coalescing the deadline runs from the time the caller
+	 * entered epoll_wait(), much like an interrupt moderation timer.
+	 */
+	if (batch_min > 1)
+		batch_expires = ktime_add_us(ktime_get(),
+					     ACCESS_ONCE(ep->batch_usecs));
+
 fetch_events:
+	if (!ep_events_available(ep))
+		ep_busy_loop(ep, timed_out);
+
 	spin_lock_irqsave(&ep->lock, flags);
 
-	if (!ep_events_available(ep)) {
+	if (batch_min > 1) {
+		ep->batch_deadline = batch_expires;
+		ep->batch_count = ep_count_ready(ep, ep->batch_min);
+	}
+
+	if (!ep_events_available(ep) || !ep_batch_done(ep)) {
 		/*
-		 * We don't have any available event to return to the caller.
-		 * We need to sleep here, and we will be wake up by
-		 * ep_poll_callback() when events will become available.
+		 * We don't have any available event to return to the caller,
+		 * or not enough of them yet.  We need to sleep here, and we
+		 * will be wake up by ep_poll_callback() when events will
+		 * become available.
 		 */
 		init_waitqueue_entry(&wait, current);
 		__add_wait_queue_exclusive(&ep->wq, &wait);
@@ -1629,16 +1786,34 @@ fetch_events:
 			 * to TASK_INTERRUPTIBLE before doing the checks.
 			 */
 			set_current_state(TASK_INTERRUPTIBLE);
-			if (ep_events_available(ep) || timed_out)
+			if (timed_out)
+				break;
+			if (ep_events_available(ep) &&
+			    (batch_timed_out || ep_batch_done(ep)))
 				break;
 			if (signal_pending(current)) {
 				res = -EINTR;
 				break;
 			}
 
+			/*
+			 * Sleep until the end of the coalescing window if that
+			 * comes before the caller's own timeout.
+			 */
+			wait_to = to;
+			if (batch_min > 1 && !batch_timed_out &&
+			    (!to || ktime_before(batch_expires, *to)))
+				wait_to = &batch_expires;
+
 			spin_unlock_irqrestore(&ep->lock, flags);
-			if (!schedule_hrtimeout_range(to, slack, HRTIMER_MODE_ABS))
-				timed_out = 1;
+			if (!schedule_hrtimeout_range(wait_to, wait_to == to ?
+						      slack : 0,
+						      HRTIMER_MODE_ABS)) {
+				if (wait_to == to)
+					timed_out = 1;
+				else
+					batch_timed_out = 1;
+			}
 
 			spin_lock_irqsave(&ep->lock, flags);
 		}
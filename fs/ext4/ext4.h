@@ -941,6 +941,16 @@ struct ext4_inode_info {
 	tid_t i_sync_tid;
 	tid_t i_datasync_tid;
 
+	/*
+	 * Fast commit state: link on s_fc_q, the last transaction that
+	 * modified the inode and the logical blocks it allocated since the
+	 * inode was last fast committed.  Protected by s_fc_lock.
+	 */
+	struct list_head i_fc_list;
+	tid_t i_fc_tid;
+	ext4_lblk_t i_fc_lblk_start;
+	ext4_lblk_t i_fc_lblk_end;
+
 	/* Precomputed uuid+inum+igen checksum for seeding inode checksums */
 	__u32 i_csum_seed;
 };
@@ -986,6 +996,7 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_DIOREAD_NOLOCK	0x400000 /* Enable support for dio read nolocking */
 #define EXT4_MOUNT_JOURNAL_CHECKSUM	0x800000 /* Journal checksums */
 #define EXT4_MOUNT_JOURNAL_ASYNC_COMMIT	0x1000000 /* Journal Async Commit */
+#define EXT4_MOUNT_FAST_COMMIT		0x2000000 /* Journal fast commits */
 #define EXT4_MOUNT_DELALLOC		0x8000000 /* Delalloc support */
 #define EXT4_MOUNT_DATA_ERR_ABORT	0x10000000 /* Abort on file data write */
 #define EXT4_MOUNT_BLOCK_VALIDITY	0x20000000 /* Block validity checking */
@@ -1237,6 +1248,16 @@ struct ext4_sb_info {
 	u32 s_max_batch_time;
 	u32 s_min_batch_time;
 	struct block_device *journal_bdev;
+
+	/* Fast commits */
+	spinlock_t s_fc_lock;
+	struct list_head s_fc_q;		/* inodes to log */
+	struct list_head s_fc_dentry_q;		/* directory updates to log */
+	tid_t s_fc_ineligible_tid;		/* last tid that needs a full
+						   commit */
+	struct mutex s_fc_mutex;		/* serializes fast commits */
+	char *s_fc_buf;				/* fast commit block payload */
+	struct list_head s_fc_replay_list;	/* payloads found by recovery */
 #ifdef CONFIG_QUOTA
 	char *s_qf_names[MAXQUOTAS];		/* Names of quota files with journalled quota */
 	int s_jquota_fmt;			/* Format of quota to use */
@@ -1260,6 +1281,9 @@ struct ext4_sb_info {
 	spinlock_t s_md_lock;
 	unsigned short *s_mb_offsets;
 	unsigned int *s_mb_maxs;
+	/* initialized groups, by order of their largest free extent */
+	struct list_head *s_mb_largest_free_orders;
+	spinlock_t *s_mb_largest_free_orders_locks;
 	unsigned int s_group_info_size;
 
 	/* tunables */
@@ -1271,9 +1295,8 @@ struct ext4_sb_info {
 	unsigned int s_mb_order2_reqs;
 	unsigned int s_mb_group_prealloc;
 	unsigned int s_max_dir_size_kb;
-	/* where last allocation was done - for stream allocation */
-	unsigned long s_mb_last_group;
-	unsigned long s_mb_last_start;
+	/* where last allocation was done on each cpu - for stream allocation */
+	struct ext4_mb_last_goal __percpu *s_mb_last_goal;
 
 	/* stats for buddy allocator */
 	atomic_t s_bal_reqs;	/* number of reqs with len > 1 */
@@ -2033,6 +2056,25 @@ static inline  unsigned char get_dtype(struct super_block *sb, int filetype)
 /* fsync.c */
 extern int ext4_sync_file(struct file *, loff_t, loff_t, int);
 
+/* fast_commit.c */
+extern void ext4_fc_init(struct super_block *sb);
+extern int ext4_fc_start(struct super_block *sb);
+extern void ext4_fc_init_inode(struct inode *inode);
+extern void ext4_fc_del(struct inode *inode);
+extern void ext4_fc_mark_ineligible(struct super_block *sb, handle_t *handle);
+extern void ext4_fc_track_inode(handle_t *handle, struct inode *inode);
+extern void ext4_fc_track_range(handle_t *handle, struct inode *inode,
+				ext4_lblk_t lblk, unsigned int len);
+extern void ext4_fc_track_link(handle_t *handle, struct inode *dir,
+			       struct inode *inode, const struct qstr *name);
+extern void ext4_fc_track_unlink(handle_t *handle, struct inode *dir,
+				 struct inode *inode, const struct qstr *name);
+extern int ext4_fc_commit(struct super_block *sb, tid_t tid);
+extern void ext4_fc_cleanup(struct super_block *sb, tid_t tid);
+extern int ext4_fc_replay_callback(journal_t *journal, void *buf, int len);
+extern void ext4_fc_replay(struct super_block *sb);
+extern void ext4_fc_destroy(struct super_block *sb);
+
 /* hash.c */
 extern int ext4fs_dirhash(const char *name, int len, struct
 			  dx_hash_info *hinfo);
@@ -2083,6 +2125,8 @@ extern int ext4_mb_add_groupinfo(struct super_block *sb,
 extern int ext4_group_add_blocks(handle_t *handle, struct super_block *sb,
 				ext4_fsblk_t block, unsigned long count);
 extern int ext4_trim_fs(struct super_block *, struct fstrim_range *);
+extern int ext4_mb_mark_bb(handle_t *handle, struct super_block *sb,
+			   ext4_fsblk_t block, int len);
 
 /* inode.c */
 struct buffer_head *ext4_getblk(handle_t *, struct inode *,
@@ -2176,6 +2220,10 @@ extern int ext4_generic_delete_entry(handle_t *handle,
 				     void *entry_buf,
 				     int buf_size,
 				     int csum_size);
+extern int ext4_fc_replay_link(struct inode *dir, struct inode *inode,
+			       const struct qstr *name);
+extern int ext4_fc_replay_unlink(struct inode *dir, unsigned long ino,
+				 const struct qstr *name);
 
 /* resize.c */
 extern int ext4_group_add(struct super_block *sb,
@@ -2460,6 +2508,8 @@ struct ext4_group_info {
 	ext4_grpblk_t	bb_free;	/* total free blocks */
 	ext4_grpblk_t	bb_fragments;	/* nr of freespace fragments */
 	ext4_grpblk_t	bb_largest_free_order;/* order of largest frag in BG */
+	ext4_group_t	bb_group;	/* group number */
+	struct          list_head bb_largest_free_order_node;
 	struct          list_head bb_prealloc_list;
 #ifdef DOUBLE_CHECK
 	void            *bb_bitmap;
@@ -2715,6 +2765,8 @@ extern struct ext4_ext_path *ext4_ext_find_extent(struct inode *, ext4_lblk_t,
 						  struct ext4_ext_path *,
 						  int flags);
 extern void ext4_ext_drop_refs(struct ext4_ext_path *);
+extern int ext4_ext_next_mapped_block(struct inode *inode, ext4_lblk_t lblk,
+				      ext4_lblk_t *next);
 extern int ext4_ext_check_inode(struct inode *inode);
 extern int ext4_find_delalloc_range(struct inode *inode,
 				    ext4_lblk_t lblk_start,
@@ -2783,9 +2835,17 @@ static inline void set_bitmap_uptodate(struct buffer_head *bh)
 	set_bit(BH_BITMAP_UPTODATE, &(bh)->b_state);
 }
 
+/*
+ * Values of the int iocb->private points to when ext4_file_write_iter()
+ * calls into ext4_ext_direct_IO().
+ */
+#define EXT4_DIO_LOCKED			0	/* may allocate, i_mutex held */
+#define EXT4_DIO_OVERWRITE		1	/* i_mutex dropped around the I/O */
+#define EXT4_DIO_OVERWRITE_UNLOCKED	2	/* i_mutex not held at all */
+
 /*
  * Disable DIO read nolock optimization, so new dioreaders will be forced
- * to grab i_mutex
+ * to grab i_mutex.  This also stops unlocked DIO overwrites.
  */
 static inline void ext4_inode_block_unlocked_dio(struct inode *inode)
 {
@@ -1587,6 +1587,30 @@ ext4_ext_next_allocated_block(struct ext4_ext_path *path)
 	return EXT_MAX_BLOCKS;
 }
 
+/*
+ * ext4_ext_next_mapped_block:
+ * stores in *next the first mapped block after the hole at @lblk, or
+ * EXT_MAX_BLOCKS.  The caller holds i_data_sem.
+ */
+int ext4_ext_next_mapped_block(struct inode *inode, ext4_lblk_t lblk,
+			       ext4_lblk_t *next)
+{
+	struct ext4_ext_path *path;
+	struct ext4_extent *ex;
+
+	path = ext4_ext_find_extent(inode, lblk, NULL, 0);
+	if (IS_ERR(path))
+		return PTR_ERR(path);
+	ex = path[path->p_depth].p_ext;
+	if (ex && le32_to_cpu(ex->ee_block) > lblk)
+		*next = le32_to_cpu(ex->ee_block);
+	else
+		*next = ext4_ext_next_allocated_block(path);
+	ext4_ext_drop_refs(path);
+	kfree(path);
+	return 0;
+}
+
 /*
  * ext4_ext_next_leaf_block:
  * returns first allocated block from next leaf or EXT_MAX_BLOCKS
@@ -4324,6 +4348,12 @@ int ext4_ext_map_blocks(handle_t *handle, struct inode *inode,
 			ext_debug("%u fit into %u:%d -> %llu\n", map->m_lblk,
 				  ee_block, ee_len, newblock);
 
+			/* Extent conversions are not fast committed */
+			if ((flags & EXT4_GET_BLOCKS_CREATE) &&
+			    (ext4_ext_is_unwritten(ex) ||
+			     (flags & EXT4_GET_BLOCKS_CONVERT_UNWRITTEN)))
+				ext4_fc_mark_ineligible(inode->i_sb, handle);
+
 			/*
 			 * If the extent is initialized check whether the
 			 * caller wants to convert it to unwritten.
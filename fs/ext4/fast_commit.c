@@ -0,0 +1,910 @@
+/*
+ *  linux/fs/ext4/fast_commit.c
+ *
+ * Fast commits: fsync writes a compact logical record of the inodes,
+ * block ranges and directory entries changed by the running transaction
+ * into the jbd2 fast commit area, instead of committing the transaction.
+ *
+ * Every inode modified under a handle is queued on s_fc_q together with
+ * the range of logical blocks it allocated, and link() and unlink() queue
+ * a directory update on s_fc_dentry_q.  Operations whose effect cannot be
+ * described by these records (creating or freeing inodes and blocks,
+ * rename, xattrs, extent conversion, resize, ...) mark the transaction
+ * ineligible, and fsync then falls back to a full commit of it.  A fast
+ * commit logs everything queued for the running transaction, so that the
+ * records never depend on changes which are neither committed nor logged.
+ *
+ * Recovery hands the records back after the log has been replayed.  They
+ * are applied at mount time with ordinary handles: all logged block ranges
+ * are first marked in use, so that nothing replayed later allocates them,
+ * then ranges, directory entries and inode attributes are replayed in log
+ * order, and the result is committed before the filesystem is used.
+ * Replaying a record that has already been applied is a no-op.
+ */
+
+#include <linux/fs.h>
+#include <linux/slab.h>
+#include <linux/pagemap.h>
+#include <linux/quotaops.h>
+#include <linux/blkdev.h>
+#include "ext4.h"
+#include "ext4_jbd2.h"
+#include "ext4_extents.h"
+#include "fast_commit.h"
+
+struct ext4_fc_dentry_update {
+	struct list_head	fcd_list;
+	tid_t			fcd_tid;
+	int			fcd_tag;	/* EXT4_FC_TAG_(UN)LINK */
+	unsigned long		fcd_parent;
+	unsigned long		fcd_ino;
+	unsigned int		fcd_name_len;
+	unsigned char		fcd_name[0];
+};
+
+/* A fast commit block payload found by recovery */
+struct ext4_fc_replay_buf {
+	struct list_head	fcr_list;
+	int			fcr_len;
+	char			fcr_data[0];
+};
+
+/* Fast commit block payload being assembled */
+struct ext4_fc_out {
+	char			*buf;
+	int			len;
+	int			max;
+};
+
+void ext4_fc_init(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+
+	spin_lock_init(&sbi->s_fc_lock);
+	INIT_LIST_HEAD(&sbi->s_fc_q);
+	INIT_LIST_HEAD(&sbi->s_fc_dentry_q);
+	INIT_LIST_HEAD(&sbi->s_fc_replay_list);
+	mutex_init(&sbi->s_fc_mutex);
+}
+
+/*
+ * Enable fast commits on the freshly loaded journal.  On failure the
+ * filesystem keeps doing full commits only.
+ */
+int ext4_fc_start(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	journal_t *journal = sbi->s_journal;
+	int err;
+
+	if (test_opt(sb, DATA_FLAGS) == EXT4_MOUNT_JOURNAL_DATA ||
+	    EXT4_HAS_RO_COMPAT_FEATURE(sb, EXT4_FEATURE_RO_COMPAT_BIGALLOC))
+		return -EINVAL;
+
+	sbi->s_fc_buf = kmalloc(journal->j_blocksize, GFP_KERNEL);
+	if (!sbi->s_fc_buf)
+		return -ENOMEM;
+	err = jbd2_journal_init_fc(journal, JBD2_DEFAULT_FAST_COMMIT_BLOCKS);
+	if (err) {
+		kfree(sbi->s_fc_buf);
+		sbi->s_fc_buf = NULL;
+		return err;
+	}
+	/* No transaction has been started yet */
+	sbi->s_fc_ineligible_tid = journal->j_transaction_sequence - 1;
+	return 0;
+}
+
+void ext4_fc_destroy(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_fc_dentry_update *fcd, *fcd_n;
+	struct ext4_fc_replay_buf *fcr, *fcr_n;
+
+	list_for_each_entry_safe(fcd, fcd_n, &sbi->s_fc_dentry_q, fcd_list)
+		kfree(fcd);
+	INIT_LIST_HEAD(&sbi->s_fc_dentry_q);
+	list_for_each_entry_safe(fcr, fcr_n, &sbi->s_fc_replay_list, fcr_list)
+		kfree(fcr);
+	INIT_LIST_HEAD(&sbi->s_fc_replay_list);
+	kfree(sbi->s_fc_buf);
+	sbi->s_fc_buf = NULL;
+}
+
+void ext4_fc_init_inode(struct inode *inode)
+{
+	struct ext4_inode_info *ei = EXT4_I(inode);
+
+	INIT_LIST_HEAD(&ei->i_fc_list);
+	ei->i_fc_tid = 0;
+	ei->i_fc_lblk_start = ei->i_fc_lblk_end = 0;
+}
+
+static inline void __ext4_fc_mark_ineligible(struct ext4_sb_info *sbi,
+					     tid_t tid)
+{
+	assert_spin_locked(&sbi->s_fc_lock);
+	if (tid_gt(tid, sbi->s_fc_ineligible_tid))
+		sbi->s_fc_ineligible_tid = tid;
+}
+
+/*
+ * The transaction @handle belongs to made a change that fast commit
+ * records cannot describe.
+ */
+void ext4_fc_mark_ineligible(struct super_block *sb, handle_t *handle)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+
+	if (!test_opt(sb, FAST_COMMIT) || !ext4_handle_valid(handle))
+		return;
+	spin_lock(&sbi->s_fc_lock);
+	__ext4_fc_mark_ineligible(sbi, handle->h_transaction->t_tid);
+	spin_unlock(&sbi->s_fc_lock);
+}
+
+/*
+ * An inode is being evicted.  If it still has changes queued, they can no
+ * longer be logged.
+ */
+void ext4_fc_del(struct inode *inode)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(inode->i_sb);
+	struct ext4_inode_info *ei = EXT4_I(inode);
+
+	if (list_empty_careful(&ei->i_fc_list))
+		return;
+	spin_lock(&sbi->s_fc_lock);
+	if (!list_empty(&ei->i_fc_list)) {
+		list_del_init(&ei->i_fc_list);
+		__ext4_fc_mark_ineligible(sbi, ei->i_fc_tid);
+	}
+	spin_unlock(&sbi->s_fc_lock);
+}
+
+/*
+ * Inodes whose changes fast commit records cannot describe: journal and
+ * quota files, and inline data, which lives in the inode body.
+ */
+static int ext4_fc_inode_eligible(struct inode *inode)
+{
+	if (inode->i_ino < EXT4_FIRST_INO(inode->i_sb) &&
+	    inode->i_ino != EXT4_ROOT_INO)
+		return 0;
+	if (IS_NOQUOTA(inode) || ext4_has_inline_data(inode))
+		return 0;
+	return 1;
+}
+
+/*
+ * Called whenever @inode is marked dirty under @handle: queue it for the
+ * next fast commit.
+ */
+void ext4_fc_track_inode(handle_t *handle, struct inode *inode)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(inode->i_sb);
+	struct ext4_inode_info *ei = EXT4_I(inode);
+	tid_t tid;
+
+	if (!test_opt(inode->i_sb, FAST_COMMIT) || !ext4_handle_valid(handle))
+		return;
+	tid = handle->h_transaction->t_tid;
+
+	spin_lock(&sbi->s_fc_lock);
+	if (!ext4_fc_inode_eligible(inode)) {
+		__ext4_fc_mark_ineligible(sbi, tid);
+	} else {
+		ei->i_fc_tid = tid;
+		if (list_empty(&ei->i_fc_list))
+			list_add_tail(&ei->i_fc_list, &sbi->s_fc_q);
+	}
+	spin_unlock(&sbi->s_fc_lock);
+}
+
+/*
+ * @inode had @len blocks from @lblk newly mapped under @handle.  Directory
+ * blocks are not tracked: replaying the directory entries rebuilds them.
+ */
+void ext4_fc_track_range(handle_t *handle, struct inode *inode,
+			 ext4_lblk_t lblk, unsigned int len)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(inode->i_sb);
+	struct ext4_inode_info *ei = EXT4_I(inode);
+
+	if (!test_opt(inode->i_sb, FAST_COMMIT) || !ext4_handle_valid(handle) ||
+	    !S_ISREG(inode->i_mode))
+		return;
+	if (!ext4_test_inode_flag(inode, EXT4_INODE_EXTENTS) ||
+	    ext4_should_journal_data(inode)) {
+		ext4_fc_mark_ineligible(inode->i_sb, handle);
+		return;
+	}
+
+	ext4_fc_track_inode(handle, inode);
+	spin_lock(&sbi->s_fc_lock);
+	if (ei->i_fc_lblk_start == ei->i_fc_lblk_end) {
+		ei->i_fc_lblk_start = lblk;
+		ei->i_fc_lblk_end = lblk + len;
+	} else {
+		ei->i_fc_lblk_start = min(ei->i_fc_lblk_start, lblk);
+		ei->i_fc_lblk_end = max(ei->i_fc_lblk_end, lblk + len);
+	}
+	spin_unlock(&sbi->s_fc_lock);
+}
+
+static void ext4_fc_track_dentry(handle_t *handle, int tag, struct inode *dir,
+				 struct inode *inode, const struct qstr *name)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(dir->i_sb);
+	struct ext4_fc_dentry_update *fcd;
+
+	if (!test_opt(dir->i_sb, FAST_COMMIT) || !ext4_handle_valid(handle))
+		return;
+
+	fcd = kmalloc(sizeof(*fcd) + name->len, GFP_NOFS);
+	if (!fcd) {
+		ext4_fc_mark_ineligible(dir->i_sb, handle);
+		return;
+	}
+	fcd->fcd_tid = handle->h_transaction->t_tid;
+	fcd->fcd_tag = tag;
+	fcd->fcd_parent = dir->i_ino;
+	fcd->fcd_ino = inode->i_ino;
+	fcd->fcd_name_len = name->len;
+	memcpy(fcd->fcd_name, name->name, name->len);
+
+	spin_lock(&sbi->s_fc_lock);
+	list_add_tail(&fcd->fcd_list, &sbi->s_fc_dentry_q);
+	spin_unlock(&sbi->s_fc_lock);
+}
+
+void ext4_fc_track_link(handle_t *handle, struct inode *dir,
+			struct inode *inode, const struct qstr *name)
+{
+	ext4_fc_track_dentry(handle, EXT4_FC_TAG_LINK, dir, inode, name);
+}
+
+void ext4_fc_track_unlink(handle_t *handle, struct inode *dir,
+			  struct inode *inode, const struct qstr *name)
+{
+	ext4_fc_track_dentry(handle, EXT4_FC_TAG_UNLINK, dir, inode, name);
+}
+
+/*
+ * Transaction @tid has committed: forget everything queued for it.
+ */
+void ext4_fc_cleanup(struct super_block *sb, tid_t tid)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_inode_info *ei, *ei_n;
+	struct ext4_fc_dentry_update *fcd, *fcd_n;
+
+	spin_lock(&sbi->s_fc_lock);
+	list_for_each_entry_safe(ei, ei_n, &sbi->s_fc_q, i_fc_list) {
+		if (tid_gt(ei->i_fc_tid, tid))
+			continue;
+		list_del_init(&ei->i_fc_list);
+		ei->i_fc_lblk_start = ei->i_fc_lblk_end = 0;
+	}
+	list_for_each_entry_safe(fcd, fcd_n, &sbi->s_fc_dentry_q, fcd_list) {
+		if (tid_gt(fcd->fcd_tid, tid))
+			continue;
+		list_del(&fcd->fcd_list);
+		kfree(fcd);
+	}
+	spin_unlock(&sbi->s_fc_lock);
+}
+
+/*
+ * Can @tid be fast committed?  It must be the running transaction, with
+ * the previous one fully committed, and must not be marked ineligible.
+ */
+static int ext4_fc_eligible(struct super_block *sb, tid_t tid)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	journal_t *journal = sbi->s_journal;
+	int ret;
+
+	read_lock(&journal->j_state_lock);
+	ret = journal->j_running_transaction &&
+	      journal->j_running_transaction->t_tid == tid &&
+	      !journal->j_committing_transaction;
+	read_unlock(&journal->j_state_lock);
+	if (!ret)
+		return 0;
+
+	spin_lock(&sbi->s_fc_lock);
+	ret = tid_gt(tid, sbi->s_fc_ineligible_tid);
+	spin_unlock(&sbi->s_fc_lock);
+	return ret;
+}
+
+/*
+ * Take a reference to every queued inode, optionally only to those which
+ * allocated blocks.  Returns the number of inodes in *inodesp, or a
+ * negative error.
+ */
+static int ext4_fc_grab_inodes(struct super_block *sb, struct inode ***inodesp,
+			       int ranges_only)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_inode_info *ei;
+	struct inode **inodes;
+	int nr = 0, max = 0;
+
+	spin_lock(&sbi->s_fc_lock);
+	list_for_each_entry(ei, &sbi->s_fc_q, i_fc_list)
+		max++;
+	spin_unlock(&sbi->s_fc_lock);
+
+	*inodesp = NULL;
+	if (!max)
+		return 0;
+	inodes = kmalloc(max * sizeof(*inodes), GFP_NOFS);
+	if (!inodes)
+		return -ENOMEM;
+
+	spin_lock(&sbi->s_fc_lock);
+	list_for_each_entry(ei, &sbi->s_fc_q, i_fc_list) {
+		if (nr == max)
+			break;
+		if (ranges_only && ei->i_fc_lblk_start == ei->i_fc_lblk_end)
+			continue;
+		inodes[nr] = igrab(&ei->vfs_inode);
+		if (inodes[nr])
+			nr++;
+	}
+	spin_unlock(&sbi->s_fc_lock);
+
+	*inodesp = inodes;
+	return nr;
+}
+
+static void ext4_fc_put_inodes(struct inode **inodes, int nr)
+{
+	while (nr--)
+		iput(inodes[nr]);
+	kfree(inodes);
+}
+
+/*
+ * In data=ordered mode, the data of all logged block ranges must be on
+ * disk before the fast commit block.  This needs handles for delayed
+ * allocation, so it is done before the journal is locked.
+ */
+static int ext4_fc_write_data(struct super_block *sb)
+{
+	struct inode **inodes;
+	int nr, i, ret = 0, err;
+
+	if (test_opt(sb, DATA_FLAGS) != EXT4_MOUNT_ORDERED_DATA)
+		return 0;
+
+	nr = ext4_fc_grab_inodes(sb, &inodes, 1);
+	if (nr < 0)
+		return nr;
+	for (i = 0; i < nr; i++) {
+		err = filemap_write_and_wait(inodes[i]->i_mapping);
+		if (!ret)
+			ret = err;
+	}
+	ext4_fc_put_inodes(inodes, nr);
+	return ret;
+}
+
+static void *ext4_fc_add_tl(struct ext4_fc_out *out, int tag, int len)
+{
+	struct ext4_fc_tl *tl;
+	int size = sizeof(*tl) + ALIGN(len, 4);
+
+	if (out->len + size > out->max)
+		return NULL;
+	tl = (struct ext4_fc_tl *)(out->buf + out->len);
+	memset(tl, 0, size);
+	tl->fc_tag = cpu_to_le16(tag);
+	tl->fc_len = cpu_to_le16(len);
+	out->len += size;
+	return tl + 1;
+}
+
+static int ext4_fc_write_dentries(struct super_block *sb,
+				  struct ext4_fc_out *out)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_fc_dentry_update *fcd;
+	struct ext4_fc_dentry *fd;
+	int ret = 0;
+
+	spin_lock(&sbi->s_fc_lock);
+	list_for_each_entry(fcd, &sbi->s_fc_dentry_q, fcd_list) {
+		fd = ext4_fc_add_tl(out, fcd->fcd_tag,
+				    sizeof(*fd) + fcd->fcd_name_len);
+		if (!fd) {
+			ret = -ENOSPC;
+			break;
+		}
+		fd->fc_parent = cpu_to_le32(fcd->fcd_parent);
+		fd->fc_ino = cpu_to_le32(fcd->fcd_ino);
+		memcpy(fd->fc_name, fcd->fcd_name, fcd->fcd_name_len);
+	}
+	spin_unlock(&sbi->s_fc_lock);
+	return ret;
+}
+
+static int ext4_fc_write_inode(struct inode *inode, struct ext4_fc_out *out)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(inode->i_sb);
+	struct ext4_inode_info *ei = EXT4_I(inode);
+	struct ext4_fc_add_range *fr;
+	struct ext4_fc_inode *fi;
+	struct ext4_map_blocks map;
+	ext4_lblk_t lblk, end;
+	int ret;
+
+	if (!ext4_fc_inode_eligible(inode))
+		return -EAGAIN;
+
+	spin_lock(&sbi->s_fc_lock);
+	lblk = ei->i_fc_lblk_start;
+	end = ei->i_fc_lblk_end;
+	spin_unlock(&sbi->s_fc_lock);
+
+	/* Data that raced with ext4_fc_write_data() is not on disk yet */
+	if (lblk < end &&
+	    test_opt(inode->i_sb, DATA_FLAGS) == EXT4_MOUNT_ORDERED_DATA &&
+	    (mapping_tagged(inode->i_mapping, PAGECACHE_TAG_DIRTY) ||
+	     mapping_tagged(inode->i_mapping, PAGECACHE_TAG_WRITEBACK)))
+		return -EAGAIN;
+
+	while (lblk < end) {
+		map.m_lblk = lblk;
+		map.m_len = end - lblk;
+		ret = ext4_map_blocks(NULL, inode, &map, 0);
+		if (ret < 0)
+			return ret;
+		if (ret == 0) {
+			down_read(&ei->i_data_sem);
+			ret = ext4_ext_next_mapped_block(inode, lblk, &lblk);
+			up_read(&ei->i_data_sem);
+			if (ret < 0)
+				return ret;
+			continue;
+		}
+
+		fr = ext4_fc_add_tl(out, EXT4_FC_TAG_ADD_RANGE, sizeof(*fr));
+		if (!fr)
+			return -ENOSPC;
+		fr->fc_ino = cpu_to_le32(inode->i_ino);
+		fr->fc_lblk = cpu_to_le32(map.m_lblk);
+		fr->fc_pblk = cpu_to_le64(map.m_pblk);
+		fr->fc_len = cpu_to_le32(map.m_len);
+		if (map.m_flags & EXT4_MAP_UNWRITTEN)
+			fr->fc_flags = cpu_to_le32(EXT4_FC_RANGE_UNWRITTEN);
+		lblk += map.m_len;
+	}
+
+	fi = ext4_fc_add_tl(out, EXT4_FC_TAG_INODE, sizeof(*fi));
+	if (!fi)
+		return -ENOSPC;
+	ext4_get_inode_flags(ei);
+	fi->fc_ino = cpu_to_le32(inode->i_ino);
+	fi->fc_mode = cpu_to_le16(inode->i_mode);
+	fi->fc_flags = cpu_to_le32(ei->i_flags & EXT4_FL_USER_MODIFIABLE);
+	fi->fc_generation = cpu_to_le32(inode->i_generation);
+	fi->fc_size = cpu_to_le64(ei->i_disksize);
+	fi->fc_atime = cpu_to_le32(inode->i_atime.tv_sec);
+	fi->fc_atime_nsec = cpu_to_le32(inode->i_atime.tv_nsec);
+	fi->fc_mtime = cpu_to_le32(inode->i_mtime.tv_sec);
+	fi->fc_mtime_nsec = cpu_to_le32(inode->i_mtime.tv_nsec);
+	fi->fc_ctime = cpu_to_le32(inode->i_ctime.tv_sec);
+	fi->fc_ctime_nsec = cpu_to_le32(inode->i_ctime.tv_nsec);
+	return 0;
+}
+
+/*
+ * Log everything queued for the running transaction @tid and forget it.
+ * @inodes are all queued inodes.  The caller holds s_fc_mutex and has
+ * locked out all handles.
+ */
+static int ext4_fc_perform_commit(struct super_block *sb, tid_t tid,
+				  struct inode **inodes, int nr)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	journal_t *journal = sbi->s_journal;
+	struct ext4_fc_out out;
+	struct ext4_fc_dentry_update *fcd, *fcd_n;
+	struct ext4_inode_info *ei, *ei_n;
+	int i, ret;
+
+	/* Evicting a queued inode marks its transaction ineligible */
+	if (!ext4_fc_eligible(sb, tid))
+		return -EAGAIN;
+
+	out.buf = sbi->s_fc_buf;
+	out.len = 0;
+	out.max = journal->j_blocksize - sizeof(jbd2_fc_header_t);
+	ret = ext4_fc_write_dentries(sb, &out);
+	for (i = 0; i < nr && !ret; i++)
+		ret = ext4_fc_write_inode(inodes[i], &out);
+	if (ret)
+		return ret;
+
+	/* The fast commit block flushes the journal device only */
+	if (journal->j_fs_dev != journal->j_dev &&
+	    (journal->j_flags & JBD2_BARRIER)) {
+		ret = blkdev_issue_flush(sb->s_bdev, GFP_NOFS, NULL);
+		if (ret)
+			return ret;
+	}
+	ret = jbd2_fc_commit_block(journal, tid, out.buf, out.len);
+	if (ret)
+		return ret;
+
+	spin_lock(&sbi->s_fc_lock);
+	list_for_each_entry_safe(ei, ei_n, &sbi->s_fc_q, i_fc_list) {
+		list_del_init(&ei->i_fc_list);
+		ei->i_fc_lblk_start = ei->i_fc_lblk_end = 0;
+	}
+	list_for_each_entry_safe(fcd, fcd_n, &sbi->s_fc_dentry_q, fcd_list) {
+		list_del(&fcd->fcd_list);
+		kfree(fcd);
+	}
+	spin_unlock(&sbi->s_fc_lock);
+	return 0;
+}
+
+/*
+ * Make the changes of transaction @tid durable with a fast commit.
+ * Returns 0 on success; otherwise the caller must commit @tid in full.
+ */
+int ext4_fc_commit(struct super_block *sb, tid_t tid)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	journal_t *journal = sbi->s_journal;
+	struct inode **inodes = NULL;
+	int nr = 0, ret;
+
+	if (!test_opt(sb, FAST_COMMIT))
+		return -EOPNOTSUPP;
+	if (!ext4_fc_eligible(sb, tid))
+		return -EAGAIN;
+
+	mutex_lock(&sbi->s_fc_mutex);
+	ret = ext4_fc_write_data(sb);
+	if (!ret) {
+		jbd2_journal_lock_updates(journal);
+		nr = ext4_fc_grab_inodes(sb, &inodes, 0);
+		if (nr < 0)
+			ret = nr;
+		else
+			ret = ext4_fc_perform_commit(sb, tid, inodes, nr);
+		jbd2_journal_unlock_updates(journal);
+	}
+	mutex_unlock(&sbi->s_fc_mutex);
+	/* The last reference may evict an inode, which needs a handle */
+	ext4_fc_put_inodes(inodes, max(nr, 0));
+	return ret;
+}
+
+/*
+ * Called by jbd2 recovery for each valid fast commit block.  The
+ * filesystem is not set up yet, so just keep the payload for
+ * ext4_fc_replay().
+ */
+int ext4_fc_replay_callback(journal_t *journal, void *buf, int len)
+{
+	struct super_block *sb = journal->j_private;
+	struct ext4_fc_replay_buf *fcr;
+
+	fcr = kmalloc(sizeof(*fcr) + len, GFP_KERNEL);
+	if (!fcr)
+		return -ENOMEM;
+	fcr->fcr_len = len;
+	memcpy(fcr->fcr_data, buf, len);
+	list_add_tail(&fcr->fcr_list, &EXT4_SB(sb)->s_fc_replay_list);
+	return 0;
+}
+
+static struct inode *ext4_fc_iget(struct super_block *sb, unsigned long ino)
+{
+	struct inode *inode;
+
+	if (!ext4_valid_inum(sb, ino))
+		return NULL;
+	inode = ext4_iget(sb, ino);
+	if (IS_ERR(inode)) {
+		ext4_msg(sb, KERN_WARNING, "fast commit replay: "
+			 "inode %lu: error %ld", ino, PTR_ERR(inode));
+		return NULL;
+	}
+	return inode;
+}
+
+/* Replay pass one: mark the blocks of a logged range in use */
+static int ext4_fc_reserve_range(struct super_block *sb,
+				 struct ext4_fc_add_range *fr)
+{
+	ext4_fsblk_t pblk = le64_to_cpu(fr->fc_pblk);
+	unsigned int len = le32_to_cpu(fr->fc_len);
+	ext4_group_t group;
+	ext4_grpblk_t offset;
+	handle_t *handle;
+	int n, ret;
+
+	if (!ext4_data_block_valid(EXT4_SB(sb), pblk, len)) {
+		ext4_msg(sb, KERN_WARNING, "fast commit replay: invalid "
+			 "range %llu/%u", pblk, len);
+		return 0;
+	}
+
+	while (len) {
+		ext4_get_group_no_and_offset(sb, pblk, &group, &offset);
+		n = min_t(unsigned int, len,
+			  EXT4_BLOCKS_PER_GROUP(sb) - offset);
+		handle = ext4_journal_start_sb(sb, EXT4_HT_MISC, 2);
+		if (IS_ERR(handle))
+			return PTR_ERR(handle);
+		ret = ext4_mb_mark_bb(handle, sb, pblk, n);
+		ext4_journal_stop(handle);
+		if (ret)
+			return ret;
+		pblk += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int ext4_fc_add_extent(struct inode *inode, ext4_lblk_t lblk,
+			      ext4_fsblk_t pblk, unsigned int len,
+			      int unwritten)
+{
+	struct ext4_inode_info *ei = EXT4_I(inode);
+	struct ext4_ext_path *path;
+	struct ext4_extent newex;
+	handle_t *handle;
+	int ret, err;
+
+	handle = ext4_journal_start(inode, EXT4_HT_MAP_BLOCKS,
+				    ext4_chunk_trans_blocks(inode, len));
+	if (IS_ERR(handle))
+		return PTR_ERR(handle);
+
+	down_write(&ei->i_data_sem);
+	path = ext4_ext_find_extent(inode, lblk, NULL, 0);
+	if (IS_ERR(path)) {
+		ret = PTR_ERR(path);
+		goto out;
+	}
+	newex.ee_block = cpu_to_le32(lblk);
+	ext4_ext_store_pblock(&newex, pblk);
+	newex.ee_len = cpu_to_le16(len);
+	if (unwritten)
+		ext4_ext_mark_unwritten(&newex);
+	ret = ext4_ext_insert_extent(handle, inode, path, &newex, 0);
+	ext4_ext_drop_refs(path);
+	kfree(path);
+	if (!ret)
+		ret = ext4_es_insert_extent(inode, lblk, len, pblk, unwritten ?
+					    EXTENT_STATUS_UNWRITTEN :
+					    EXTENT_STATUS_WRITTEN);
+out:
+	up_write(&ei->i_data_sem);
+	if (!ret) {
+		dquot_alloc_block_nofail(inode, len);
+		ret = ext4_mark_inode_dirty(handle, inode);
+	}
+	err = ext4_journal_stop(handle);
+	return ret ? ret : err;
+}
+
+/* Replay pass two: map the unmapped parts of a logged range */
+static int ext4_fc_replay_range(struct super_block *sb,
+				struct ext4_fc_add_range *fr)
+{
+	ext4_lblk_t lblk = le32_to_cpu(fr->fc_lblk), next;
+	ext4_fsblk_t pblk = le64_to_cpu(fr->fc_pblk);
+	unsigned int len = le32_to_cpu(fr->fc_len), n, max;
+	int unwritten = le32_to_cpu(fr->fc_flags) & EXT4_FC_RANGE_UNWRITTEN;
+	struct ext4_map_blocks map;
+	struct inode *inode;
+	int ret = 0;
+
+	if (!ext4_data_block_valid(EXT4_SB(sb), pblk, len))
+		return 0;
+	inode = ext4_fc_iget(sb, le32_to_cpu(fr->fc_ino));
+	if (!inode)
+		return 0;
+	if (!S_ISREG(inode->i_mode) ||
+	    !ext4_test_inode_flag(inode, EXT4_INODE_EXTENTS))
+		goto out;
+
+	max = unwritten ? EXT_UNWRITTEN_MAX_LEN : EXT_INIT_MAX_LEN;
+	while (len) {
+		map.m_lblk = lblk;
+		map.m_len = len;
+		ret = ext4_map_blocks(NULL, inode, &map, 0);
+		if (ret < 0)
+			break;
+		if (ret > 0) {
+			n = ret;
+		} else {
+			down_read(&EXT4_I(inode)->i_data_sem);
+			ret = ext4_ext_next_mapped_block(inode, lblk, &next);
+			up_read(&EXT4_I(inode)->i_data_sem);
+			if (ret < 0)
+				break;
+			n = min3(len, next - lblk, max);
+			ret = ext4_fc_add_extent(inode, lblk, pblk, n,
+						 unwritten);
+			if (ret)
+				break;
+		}
+		lblk += n;
+		pblk += n;
+		len -= n;
+	}
+out:
+	iput(inode);
+	return ret;
+}
+
+static int ext4_fc_replay_inode(struct super_block *sb,
+				struct ext4_fc_inode *fi)
+{
+	struct ext4_inode_info *ei;
+	struct inode *inode;
+	handle_t *handle;
+	int ret, err;
+
+	inode = ext4_fc_iget(sb, le32_to_cpu(fi->fc_ino));
+	if (!inode)
+		return 0;
+	ei = EXT4_I(inode);
+
+	handle = ext4_journal_start(inode, EXT4_HT_INODE, 1);
+	if (IS_ERR(handle)) {
+		iput(inode);
+		return PTR_ERR(handle);
+	}
+	inode->i_mode = (inode->i_mode & S_IFMT) |
+			(le16_to_cpu(fi->fc_mode) & ~S_IFMT);
+	ei->i_flags = (ei->i_flags & ~EXT4_FL_USER_MODIFIABLE) |
+		      (le32_to_cpu(fi->fc_flags) & EXT4_FL_USER_MODIFIABLE);
+	ext4_set_inode_flags(inode);
+	inode->i_generation = le32_to_cpu(fi->fc_generation);
+	/* Directory sizes follow from the replayed entries */
+	if (!S_ISDIR(inode->i_mode)) {
+		i_size_write(inode, le64_to_cpu(fi->fc_size));
+		ei->i_disksize = inode->i_size;
+	}
+	inode->i_atime.tv_sec = (signed)le32_to_cpu(fi->fc_atime);
+	inode->i_atime.tv_nsec = le32_to_cpu(fi->fc_atime_nsec);
+	inode->i_mtime.tv_sec = (signed)le32_to_cpu(fi->fc_mtime);
+	inode->i_mtime.tv_nsec = le32_to_cpu(fi->fc_mtime_nsec);
+	inode->i_ctime.tv_sec = (signed)le32_to_cpu(fi->fc_ctime);
+	inode->i_ctime.tv_nsec = le32_to_cpu(fi->fc_ctime_nsec);
+	ret = ext4_mark_inode_dirty(handle, inode);
+	err = ext4_journal_stop(handle);
+	iput(inode);
+	return ret ? ret : err;
+}
+
+static int ext4_fc_replay_dentry(struct super_block *sb, int tag,
+				 struct ext4_fc_dentry *fd, int name_len)
+{
+	struct qstr name = QSTR_INIT(fd->fc_name, name_len);
+	unsigned long ino = le32_to_cpu(fd->fc_ino);
+	struct inode *dir, *inode;
+	int ret = 0;
+
+	if (!name_len || name_len > EXT4_NAME_LEN)
+		return -EIO;
+	dir = ext4_fc_iget(sb, le32_to_cpu(fd->fc_parent));
+	if (!dir)
+		return 0;
+	if (!S_ISDIR(dir->i_mode))
+		goto out;
+
+	if (tag == EXT4_FC_TAG_UNLINK) {
+		ret = ext4_fc_replay_unlink(dir, ino, &name);
+	} else {
+		inode = ext4_fc_iget(sb, ino);
+		if (inode) {
+			ret = ext4_fc_replay_link(dir, inode, &name);
+			iput(inode);
+		}
+	}
+out:
+	iput(dir);
+	return ret;
+}
+
+static int ext4_fc_replay_one(struct super_block *sb,
+			      struct ext4_fc_replay_buf *fcr, int reserve)
+{
+	struct ext4_fc_tl *tl;
+	void *val;
+	int off = 0, tag, len, ret = 0;
+
+	while (!ret && off + (int)sizeof(*tl) <= fcr->fcr_len) {
+		tl = (struct ext4_fc_tl *)(fcr->fcr_data + off);
+		tag = le16_to_cpu(tl->fc_tag);
+		len = le16_to_cpu(tl->fc_len);
+		val = tl + 1;
+		off += sizeof(*tl) + ALIGN(len, 4);
+		if (off > fcr->fcr_len)
+			return -EIO;
+
+		switch (tag) {
+		case EXT4_FC_TAG_ADD_RANGE:
+			if (len < sizeof(struct ext4_fc_add_range))
+				return -EIO;
+			if (reserve)
+				ret = ext4_fc_reserve_range(sb, val);
+			else
+				ret = ext4_fc_replay_range(sb, val);
+			break;
+		case EXT4_FC_TAG_INODE:
+			if (len < sizeof(struct ext4_fc_inode))
+				return -EIO;
+			if (!reserve)
+				ret = ext4_fc_replay_inode(sb, val);
+			break;
+		case EXT4_FC_TAG_LINK:
+		case EXT4_FC_TAG_UNLINK:
+			if (len < sizeof(struct ext4_fc_dentry))
+				return -EIO;
+			if (!reserve)
+				ret = ext4_fc_replay_dentry(sb, tag, val,
+					len - sizeof(struct ext4_fc_dentry));
+			break;
+		default:
+			ext4_msg(sb, KERN_ERR, "fast commit replay: "
+				 "unknown tag %d", tag);
+			return -EIO;
+		}
+	}
+	return ret;
+}
+
+/*
+ * Apply the fast commit records recovery found, and commit the result
+ * before any new fast commit can overwrite them.
+ */
+void ext4_fc_replay(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_fc_replay_buf *fcr, *fcr_n;
+	unsigned long s_flags = sb->s_flags;
+	int ret = 0;
+
+	if (list_empty(&sbi->s_fc_replay_list))
+		return;
+
+	if (s_flags & MS_RDONLY) {
+		ext4_msg(sb, KERN_INFO, "write access will be enabled "
+			 "during fast commit replay");
+		sb->s_flags &= ~MS_RDONLY;
+	}
+
+	list_for_each_entry(fcr, &sbi->s_fc_replay_list, fcr_list) {
+		ret = ext4_fc_replay_one(sb, fcr, 1);
+		if (ret)
+			goto out;
+	}
+	list_for_each_entry(fcr, &sbi->s_fc_replay_list, fcr_list) {
+		ret = ext4_fc_replay_one(sb, fcr, 0);
+		if (ret)
+			goto out;
+	}
+	ret = ext4_force_commit(sb);
+	if (!ret)
+		ext4_msg(sb, KERN_INFO, "fast commit replay complete");
+out:
+	if (ret)
+		ext4_error(sb, "fast commit replay failed: %d", ret);
+	list_for_each_entry_safe(fcr, fcr_n, &sbi->s_fc_replay_list, fcr_list)
+		kfree(fcr);
+	INIT_LIST_HEAD(&sbi->s_fc_replay_list);
+	sb->s_flags = s_flags;
+}
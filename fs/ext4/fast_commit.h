@@ -0,0 +1,62 @@
+/*
+ *  fs/ext4/fast_commit.h
+ *
+ * On-disk format of ext4 fast commit records.
+ */
+
+#ifndef _EXT4_FAST_COMMIT_H
+#define _EXT4_FAST_COMMIT_H
+
+/*
+ * The payload of a jbd2 fast commit block is a sequence of
+ * tag/length/value records, each starting on a 4 byte boundary.  They are
+ * replayed in order on top of the last committed transaction.
+ */
+#define EXT4_FC_TAG_ADD_RANGE	0x0001	/* blocks mapped into a file */
+#define EXT4_FC_TAG_INODE	0x0002	/* inode attributes */
+#define EXT4_FC_TAG_LINK	0x0003	/* directory entry added */
+#define EXT4_FC_TAG_UNLINK	0x0004	/* directory entry removed */
+
+struct ext4_fc_tl {
+	__le16	fc_tag;
+	__le16	fc_len;		/* bytes of value following this header */
+};
+
+/* EXT4_FC_TAG_ADD_RANGE */
+struct ext4_fc_add_range {
+	__le32	fc_ino;
+	__le32	fc_lblk;
+	__le64	fc_pblk;
+	__le32	fc_len;
+	__le32	fc_flags;
+};
+
+#define EXT4_FC_RANGE_UNWRITTEN	0x0001
+
+/*
+ * EXT4_FC_TAG_INODE.  Block count, link count and the block map are not
+ * logged: replaying ranges and directory entries rebuilds them.
+ */
+struct ext4_fc_inode {
+	__le32	fc_ino;
+	__le16	fc_mode;
+	__le16	fc_pad;
+	__le32	fc_flags;
+	__le32	fc_generation;
+	__le64	fc_size;
+	__le32	fc_atime;
+	__le32	fc_atime_nsec;
+	__le32	fc_mtime;
+	__le32	fc_mtime_nsec;
+	__le32	fc_ctime;
+	__le32	fc_ctime_nsec;
+};
+
+/* EXT4_FC_TAG_LINK, EXT4_FC_TAG_UNLINK; the name fills the rest */
+struct ext4_fc_dentry {
+	__le32	fc_parent;
+	__le32	fc_ino;
+	__u8	fc_name[0];
+};
+
+#endif /* _EXT4_FAST_COMMIT_H */
@@ -26,6 +26,7 @@
 #include <linux/aio.h>
 #include <linux/quotaops.h>
 #include <linux/pagevec.h>
+#include <linux/security.h>
 #include "ext4.h"
 #include "ext4_jbd2.h"
 #include "xattr.h"
@@ -88,6 +89,100 @@ ext4_unaligned_aio(struct inode *inode, struct iov_iter *from, loff_t pos)
 	return 0;
 }
 
+/*
+ * Returns true if the blocks backing [pos, pos + len) are all allocated and
+ * written, so that a direct write to them needs no allocation or extent
+ * conversion.
+ */
+static bool ext4_overwrite_io(struct inode *inode, loff_t pos, size_t len)
+{
+	struct ext4_map_blocks map;
+	unsigned int blkbits = inode->i_blkbits;
+	int err, blklen;
+
+	map.m_lblk = pos >> blkbits;
+	map.m_len = (EXT4_BLOCK_ALIGN(pos + len, blkbits) >> blkbits)
+		- map.m_lblk;
+	blklen = map.m_len;
+
+	err = ext4_map_blocks(NULL, inode, &map, 0);
+	/*
+	 * 'err==len' means that all of blocks has been preallocated no
+	 * matter they are initialized or not.  For excluding unwritten
+	 * extents, we need to check m_flags.  There are two conditions that
+	 * indicate for initialized extents.  1) If we hit extent cache,
+	 * EXT4_MAP_MAPPED flag is returned; 2) If we do a real lookup,
+	 * non-flags are returned.  So we should check these two conditions.
+	 */
+	return err == blklen && (map.m_flags & EXT4_MAP_MAPPED);
+}
+
+/*
+ * Direct overwrites of written blocks inside i_size are done without
+ * i_mutex, so that writers of a preallocated file run in parallel.  Like
+ * the dioread_nolock readers, the write holds a reference on i_dio_count
+ * while the range is checked and the I/O submitted; everything changing
+ * the block mapping of the file under i_mutex blocks unlocked DIO with
+ * ext4_inode_block_unlocked_dio() and waits for i_dio_count to drain.
+ *
+ * Returns -EAGAIN if the write has to go through the locked path.
+ */
+static ssize_t ext4_unlocked_dio_write(struct kiocb *iocb,
+				       struct iov_iter *from)
+{
+	struct file *file = iocb->ki_filp;
+	struct inode *inode = file_inode(file);
+	int overwrite = EXT4_DIO_OVERWRITE_UNLOCKED;
+	size_t count = iov_iter_count(from);
+	loff_t pos = iocb->ki_pos;
+	struct blk_plug plug;
+	ssize_t ret = -EAGAIN;
+
+	atomic_inc(&inode->i_dio_count);
+	smp_mb();
+	if (unlikely(ext4_test_inode_state(inode, EXT4_STATE_DIOREAD_LOCK)))
+		goto out;
+
+	if (!count || file->f_mapping->nrpages ||
+	    pos + count > i_size_read(inode) ||
+	    !ext4_overwrite_io(inode, pos, count))
+		goto out;
+
+	/* Dropping the setuid bits needs i_mutex for notify_change(). */
+	if (should_remove_suid(file->f_path.dentry) ||
+	    security_inode_need_killpriv(file->f_path.dentry))
+		goto out;
+
+	ret = generic_write_checks(file, &pos, &count, 0);
+	if (ret || !count)
+		goto out;
+	iov_iter_truncate(from, count);
+
+	ret = file_update_time(file);
+	if (ret)
+		goto out;
+
+	blk_start_plug(&plug);
+	iocb->private = &overwrite;
+	ret = generic_file_direct_write(iocb, from, pos);
+	blk_finish_plug(&plug);
+
+	/* Nothing written, let the locked path fall back to buffered I/O. */
+	if (!ret)
+		ret = -EAGAIN;
+out:
+	inode_dio_done(inode);
+
+	if (ret > 0) {
+		ssize_t err;
+
+		err = generic_write_sync(file, iocb->ki_pos - ret, ret);
+		if (err < 0)
+			ret = err;
+	}
+	return ret;
+}
+
 static ssize_t
 ext4_file_write_iter(struct kiocb *iocb, struct iov_iter *from)
 {
@@ -96,7 +191,7 @@ ext4_file_write_iter(struct kiocb *iocb, struct iov_iter *from)
 	struct mutex *aio_mutex = NULL;
 	struct blk_plug plug;
 	int o_direct = file->f_flags & O_DIRECT;
-	int overwrite = 0;
+	int overwrite = EXT4_DIO_LOCKED;
 	size_t length = iov_iter_count(from);
 	ssize_t ret;
 	loff_t pos = iocb->ki_pos;
@@ -115,6 +210,13 @@ ext4_file_write_iter(struct kiocb *iocb, struct iov_iter *from)
 		ext4_unwritten_wait(inode);
 	}
 
+	if (o_direct && !aio_mutex && !(file->f_flags & O_APPEND) &&
+	    ext4_should_dioread_nolock(inode)) {
+		ret = ext4_unlocked_dio_write(iocb, from);
+		if (ret != -EAGAIN)
+			return ret;
+	}
+
 	mutex_lock(&inode->i_mutex);
 	if (file->f_flags & O_APPEND)
 		iocb->ki_pos = pos = i_size_read(inode);
@@ -144,32 +246,10 @@ ext4_file_write_iter(struct kiocb *iocb, struct iov_iter *from)
 
 		/* check whether we do a DIO overwrite or not */
 		if (ext4_should_dioread_nolock(inode) && !aio_mutex &&
-		    !file->f_mapping->nrpages && pos + length <= i_size_read(inode)) {
-			struct ext4_map_blocks map;
-			unsigned int blkbits = inode->i_blkbits;
-			int err, len;
-
-			map.m_lblk = pos >> blkbits;
-			map.m_len = (EXT4_BLOCK_ALIGN(pos + length, blkbits) >> blkbits)
-				- map.m_lblk;
-			len = map.m_len;
-
-			err = ext4_map_blocks(NULL, inode, &map, 0);
-			/*
-			 * 'err==len' means that all of blocks has
-			 * been preallocated no matter they are
-			 * initialized or not.  For excluding
-			 * unwritten extents, we need to check
-			 * m_flags.  There are two conditions that
-			 * indicate for initialized extents.  1) If we
-			 * hit extent cache, EXT4_MAP_MAPPED flag is
-			 * returned; 2) If we do a real lookup,
-			 * non-flags are returned.  So we should check
-			 * these two conditions.
-			 */
-			if (err == len && (map.m_flags & EXT4_MAP_MAPPED))
-				overwrite = 1;
-		}
+		    !file->f_mapping->nrpages &&
+		    pos + length <= i_size_read(inode) &&
+		    ext4_overwrite_io(inode, pos, length))
+			overwrite = EXT4_DIO_OVERWRITE;
 	}
 
 	ret = __generic_file_write_iter(iocb, from);
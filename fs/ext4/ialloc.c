@@ -262,6 +262,7 @@ void ext4_free_inode(handle_t *handle, struct inode *inode)
 	ino = inode->i_ino;
 	ext4_debug("freeing inode %lu\n", ino);
 	trace_ext4_free_inode(inode);
+	ext4_fc_mark_ineligible(sb, handle);
 
 	/*
 	 * Note: we must free any quota before locking the superblock,
@@ -867,6 +868,8 @@ next_group:
 	goto out;
 
 got:
+	/* Fast commit records cannot describe inode allocation */
+	ext4_fc_mark_ineligible(sb, handle);
 	BUFFER_TRACE(inode_bitmap_bh, "call ext4_handle_dirty_metadata");
 	err = ext4_handle_dirty_metadata(handle, NULL, inode_bitmap_bh);
 	if (err) {
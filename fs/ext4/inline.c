@@ -417,6 +417,7 @@ static int ext4_destroy_inline_data_nolock(handle_t *handle,
 
 	if (!ei->i_inline_off)
 		return 0;
+	ext4_fc_mark_ineligible(inode->i_sb, handle);
 
 	error = ext4_get_inode_loc(inode, &is.iloc);
 	if (error)
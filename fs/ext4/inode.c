@@ -705,6 +705,8 @@ found:
 
 has_zeroout:
 	up_write((&EXT4_I(inode)->i_data_sem));
+	if (retval > 0 && map->m_flags & EXT4_MAP_NEW)
+		ext4_fc_track_range(handle, inode, map->m_lblk, map->m_len);
 	if (retval > 0 && map->m_flags & EXT4_MAP_MAPPED) {
 		ret = check_block_validity(inode, map);
 		if (ret != 0)
@@ -3124,7 +3126,8 @@ static ssize_t ext4_ext_direct_IO(int rw, struct kiocb *iocb,
 
 	if (overwrite) {
 		down_read(&EXT4_I(inode)->i_data_sem);
-		mutex_unlock(&inode->i_mutex);
+		if (overwrite == EXT4_DIO_OVERWRITE)
+			mutex_unlock(&inode->i_mutex);
 	}
 
 	/*
@@ -3222,7 +3225,8 @@ retake_lock:
 	/* take i_mutex locking again if we do a ovewrite dio */
 	if (overwrite) {
 		up_read(&EXT4_I(inode)->i_data_sem);
-		mutex_lock(&inode->i_mutex);
+		if (overwrite == EXT4_DIO_OVERWRITE)
+			mutex_lock(&inode->i_mutex);
 	}
 
 	return ret;
@@ -4943,6 +4947,7 @@ int ext4_mark_inode_dirty(handle_t *handle, struct inode *inode)
 
 	might_sleep();
 	trace_ext4_mark_inode_dirty(inode, _RET_IP_);
+	ext4_fc_track_inode(handle, inode);
 	err = ext4_reserve_inode_write(handle, inode, &iloc);
 	if (ext4_handle_valid(handle) &&
 	    EXT4_I(inode)->i_extra_isize < sbi->s_want_extra_isize &&
@@ -4956,6 +4961,8 @@ int ext4_mark_inode_dirty(handle_t *handle, struct inode *inode)
 		 */
 		if ((jbd2_journal_extend(handle,
 			     EXT4_DATA_TRANS_BLOCKS(inode->i_sb))) == 0) {
+			/* This may move xattrs out to an xattr block */
+			ext4_fc_mark_ineligible(inode->i_sb, handle);
 			ret = ext4_expand_extra_isize(inode,
 						      sbi->s_want_extra_isize,
 						      iloc, handle);
@@ -700,9 +700,16 @@ static void ext4_mb_mark_free_simple(struct super_block *sb,
  * Cache the order of the largest free extent we have available in this block
  * group.
  */
+ *
+ * The group is also kept on the sbi list of groups with that order, so that
+ * 2^N requests can find a group with a large enough free extent without
+ * scanning all of them.  Called with the group lock held.
+ */
 static void
 mb_set_largest_free_order(struct super_block *sb, struct ext4_group_info *grp)
 {
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int old = grp->bb_largest_free_order;
 	int i;
 	int bits;
 
@@ -715,6 +722,23 @@ mb_set_largest_free_order(struct super_block *sb, struct ext4_group_info *grp)
 			break;
 		}
 	}
+
+	if (old == grp->bb_largest_free_order &&
+	    (old < 0 || !list_empty(&grp->bb_largest_free_order_node)))
+		return;
+
+	if (!list_empty(&grp->bb_largest_free_order_node)) {
+		spin_lock(&sbi->s_mb_largest_free_orders_locks[old]);
+		list_del_init(&grp->bb_largest_free_order_node);
+		spin_unlock(&sbi->s_mb_largest_free_orders_locks[old]);
+	}
+	i = grp->bb_largest_free_order;
+	if (i >= 0) {
+		spin_lock(&sbi->s_mb_largest_free_orders_locks[i]);
+		list_add_tail(&grp->bb_largest_free_order_node,
+			      &sbi->s_mb_largest_free_orders[i]);
+		spin_unlock(&sbi->s_mb_largest_free_orders_locks[i]);
+	}
 }
 
 static noinline_for_stack
@@ -1650,10 +1674,12 @@ static void ext4_mb_use_best_found(struct ext4_allocation_context *ac,
 	get_page(ac->ac_buddy_page);
 	/* store last allocated for subsequent stream allocation */
 	if (ac->ac_flags & EXT4_MB_STREAM_ALLOC) {
-		spin_lock(&sbi->s_md_lock);
-		sbi->s_mb_last_group = ac->ac_f_ex.fe_group;
-		sbi->s_mb_last_start = ac->ac_f_ex.fe_start;
-		spin_unlock(&sbi->s_md_lock);
+		struct ext4_mb_last_goal *goal;
+
+		goal = get_cpu_ptr(sbi->s_mb_last_goal);
+		goal->group = ac->ac_f_ex.fe_group;
+		goal->start = ac->ac_f_ex.fe_start;
+		put_cpu_ptr(sbi->s_mb_last_goal);
 	}
 }
 
@@ -2071,6 +2097,51 @@ static int ext4_mb_good_group(struct ext4_allocation_context *ac,
 	return 0;
 }
 
+/*
+ * Picks the next group to try for a 2^N request from the lists of groups by
+ * largest free extent order, without taking any group lock.  The group is
+ * moved to the tail of its list, so that concurrent allocators spread over
+ * the suitable groups instead of all contending for the first one.  Returns
+ * false if no initialized group can satisfy the request at cr 0.
+ */
+static bool ext4_mb_next_order_group(struct ext4_allocation_context *ac,
+				     ext4_group_t ngroups,
+				     ext4_group_t *group)
+{
+	struct super_block *sb = ac->ac_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int flex_size = ext4_flex_bg_size(sbi);
+	struct ext4_group_info *grp;
+	int order;
+
+	for (order = ac->ac_2order; order < MB_NUM_ORDERS(sb); order++) {
+		if (list_empty(&sbi->s_mb_largest_free_orders[order]))
+			continue;
+
+		spin_lock(&sbi->s_mb_largest_free_orders_locks[order]);
+		list_for_each_entry(grp, &sbi->s_mb_largest_free_orders[order],
+				    bb_largest_free_order_node) {
+			if (grp->bb_group >= ngroups ||
+			    grp->bb_free < ac->ac_g_ex.fe_len ||
+			    EXT4_MB_GRP_BBITMAP_CORRUPT(grp))
+				continue;
+			/* same as ext4_mb_good_group() for data files */
+			if ((ac->ac_flags & EXT4_MB_HINT_DATA) &&
+			    flex_size >= EXT4_FLEX_SIZE_DIR_ALLOC_SCHEME &&
+			    (grp->bb_group % flex_size) == 0)
+				continue;
+
+			*group = grp->bb_group;
+			list_move_tail(&grp->bb_largest_free_order_node,
+				       &sbi->s_mb_largest_free_orders[order]);
+			spin_unlock(&sbi->s_mb_largest_free_orders_locks[order]);
+			return true;
+		}
+		spin_unlock(&sbi->s_mb_largest_free_orders_locks[order]);
+	}
+	return false;
+}
+
 static noinline_for_stack int
 ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 {
@@ -2118,13 +2189,20 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 			ac->ac_2order = i - 1;
 	}
 
-	/* if stream allocation is enabled, use global goal */
+	/*
+	 * if stream allocation is enabled, continue where the last stream
+	 * allocation on this cpu ended, so that concurrent streams do not
+	 * all chase the same group
+	 */
 	if (ac->ac_flags & EXT4_MB_STREAM_ALLOC) {
-		/* TBD: may be hot point */
-		spin_lock(&sbi->s_md_lock);
-		ac->ac_g_ex.fe_group = sbi->s_mb_last_group;
-		ac->ac_g_ex.fe_start = sbi->s_mb_last_start;
-		spin_unlock(&sbi->s_md_lock);
+		struct ext4_mb_last_goal *goal;
+
+		goal = get_cpu_ptr(sbi->s_mb_last_goal);
+		ac->ac_g_ex.fe_group = goal->group;
+		ac->ac_g_ex.fe_start = goal->start;
+		put_cpu_ptr(sbi->s_mb_last_goal);
+		if (ac->ac_g_ex.fe_group >= ngroups)
+			ac->ac_g_ex.fe_group = 0;
 	}
 
 	/* Let's just scan groups to find more-less suitable blocks */
@@ -2144,6 +2222,15 @@ repeat:
 
 		for (i = 0; i < ngroups; group++, i++) {
 			cond_resched();
+			/*
+			 * Past the groups next to the goal, 2^N requests
+			 * only look at groups known to have a large enough
+			 * free extent.
+			 */
+			if (cr == 0 && i >= MB_DEFAULT_LINEAR_GROUPS &&
+			    ac->ac_2order < MB_NUM_ORDERS(sb) &&
+			    !ext4_mb_next_order_group(ac, ngroups, &group))
+				break;
 			/*
 			 * Artificially restricted ngroups for non-extent
 			 * files makes group > ngroups possible on first loop.
@@ -2417,6 +2504,8 @@ int ext4_mb_add_groupinfo(struct super_block *sb, ext4_group_t group,
 			ext4_free_group_clusters(sb, desc);
 	}
 
+	meta_group_info[i]->bb_group = group;
+	INIT_LIST_HEAD(&meta_group_info[i]->bb_largest_free_order_node);
 	INIT_LIST_HEAD(&meta_group_info[i]->bb_prealloc_list);
 	init_rwsem(&meta_group_info[i]->alloc_sem);
 	meta_group_info[i]->bb_free_root = RB_ROOT;
@@ -2570,6 +2659,25 @@ int ext4_mb_init(struct super_block *sb)
 		goto out;
 	}
 
+	i = MB_NUM_ORDERS(sb) * sizeof(*sbi->s_mb_largest_free_orders);
+	sbi->s_mb_largest_free_orders = kmalloc(i, GFP_KERNEL);
+	if (sbi->s_mb_largest_free_orders == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	i = MB_NUM_ORDERS(sb) * sizeof(*sbi->s_mb_largest_free_orders_locks);
+	sbi->s_mb_largest_free_orders_locks = kmalloc(i, GFP_KERNEL);
+	if (sbi->s_mb_largest_free_orders_locks == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < MB_NUM_ORDERS(sb); i++) {
+		INIT_LIST_HEAD(&sbi->s_mb_largest_free_orders[i]);
+		spin_lock_init(&sbi->s_mb_largest_free_orders_locks[i]);
+	}
+
 	ret = ext4_groupinfo_create_slab(sb->s_blocksize);
 	if (ret < 0)
 		goto out;
@@ -2638,10 +2746,16 @@ int ext4_mb_init(struct super_block *sb)
 		spin_lock_init(&lg->lg_prealloc_lock);
 	}
 
+	sbi->s_mb_last_goal = alloc_percpu(struct ext4_mb_last_goal);
+	if (sbi->s_mb_last_goal == NULL) {
+		ret = -ENOMEM;
+		goto out_free_locality_groups;
+	}
+
 	/* init file for buddy data */
 	ret = ext4_mb_init_backend(sb);
 	if (ret != 0)
-		goto out_free_locality_groups;
+		goto out_free_last_goal;
 
 	if (sbi->s_proc)
 		proc_create_data("mb_groups", S_IRUGO, sbi->s_proc,
@@ -2649,10 +2763,17 @@ int ext4_mb_init(struct super_block *sb)
 
 	return 0;
 
+out_free_last_goal:
+	free_percpu(sbi->s_mb_last_goal);
+	sbi->s_mb_last_goal = NULL;
 out_free_locality_groups:
 	free_percpu(sbi->s_locality_groups);
 	sbi->s_locality_groups = NULL;
 out:
+	kfree(sbi->s_mb_largest_free_orders);
+	sbi->s_mb_largest_free_orders = NULL;
+	kfree(sbi->s_mb_largest_free_orders_locks);
+	sbi->s_mb_largest_free_orders_locks = NULL;
 	kfree(sbi->s_mb_offsets);
 	sbi->s_mb_offsets = NULL;
 	kfree(sbi->s_mb_maxs);
@@ -2708,6 +2829,8 @@ int ext4_mb_release(struct super_block *sb)
 			kfree(sbi->s_group_info[i]);
 		ext4_kvfree(sbi->s_group_info);
 	}
+	kfree(sbi->s_mb_largest_free_orders);
+	kfree(sbi->s_mb_largest_free_orders_locks);
 	kfree(sbi->s_mb_offsets);
 	kfree(sbi->s_mb_maxs);
 	if (sbi->s_buddy_cache)
@@ -2737,6 +2860,7 @@ int ext4_mb_release(struct super_block *sb)
 	}
 
 	free_percpu(sbi->s_locality_groups);
+	free_percpu(sbi->s_mb_last_goal);
 
 	return 0;
 }
@@ -4651,6 +4775,8 @@ void ext4_free_blocks(handle_t *handle, struct inode *inode,
 
 	ext4_debug("freeing block %llu\n", block);
 	trace_ext4_free_blocks(inode, block, count, flags);
+	/* Fast commit records cannot describe freed blocks */
+	ext4_fc_mark_ineligible(sb, handle);
 
 	if (flags & EXT4_FREE_BLOCKS_FORGET) {
 		struct buffer_head *tbh = bh;
@@ -5012,6 +5138,99 @@ error_return:
 	return err;
 }
 
+/**
+ * ext4_mb_mark_bb() -- Mark given blocks in use
+ * @handle:			handle to this transaction
+ * @sb:				super block
+ * @block:			start physical block, within a single group
+ * @len:			number of blocks
+ *
+ * Used by fast commit replay to claim blocks logged as allocated.  Blocks
+ * which are already in use are left alone.
+ */
+int ext4_mb_mark_bb(handle_t *handle, struct super_block *sb,
+		    ext4_fsblk_t block, int len)
+{
+	struct buffer_head *bitmap_bh = NULL;
+	struct buffer_head *gd_bh;
+	struct ext4_group_desc *desc;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_free_extent ex;
+	struct ext4_buddy e4b;
+	ext4_group_t group;
+	ext4_grpblk_t bit, start, end;
+	int err, ret, used = 0;
+
+	ext4_get_group_no_and_offset(sb, block, &group, &bit);
+	if (bit + len > EXT4_BLOCKS_PER_GROUP(sb))
+		return -EINVAL;
+
+	bitmap_bh = ext4_read_block_bitmap(sb, group);
+	if (!bitmap_bh)
+		return -EIO;
+	err = -EIO;
+	desc = ext4_get_group_desc(sb, group, &gd_bh);
+	if (!desc)
+		goto out;
+
+	BUFFER_TRACE(bitmap_bh, "getting write access");
+	err = ext4_journal_get_write_access(handle, bitmap_bh);
+	if (err)
+		goto out;
+	BUFFER_TRACE(gd_bh, "get_write_access");
+	err = ext4_journal_get_write_access(handle, gd_bh);
+	if (err)
+		goto out;
+
+	err = ext4_mb_load_buddy(sb, group, &e4b);
+	if (err)
+		goto out;
+
+	ext4_lock_group(sb, group);
+	for (start = bit; start < bit + len; start = end) {
+		if (!mb_test_bit(start, bitmap_bh->b_data))
+			used++;
+		end = start + 1;
+		if (mb_test_bit(start, e4b.bd_bitmap))
+			continue;
+		end = mb_find_next_bit(e4b.bd_bitmap, bit + len, start);
+		ex.fe_group = group;
+		ex.fe_start = start;
+		ex.fe_len = end - start;
+		ex.fe_logical = 0;
+		mb_mark_used(&e4b, &ex);
+		for (start++; start < end; start++)
+			if (!mb_test_bit(start, bitmap_bh->b_data))
+				used++;
+	}
+	ext4_set_bits(bitmap_bh->b_data, bit, len);
+	if (desc->bg_flags & cpu_to_le16(EXT4_BG_BLOCK_UNINIT)) {
+		desc->bg_flags &= cpu_to_le16(~EXT4_BG_BLOCK_UNINIT);
+		ext4_free_group_clusters_set(sb, desc,
+			ext4_free_clusters_after_init(sb, group, desc));
+	}
+	ext4_free_group_clusters_set(sb, desc,
+			ext4_free_group_clusters(sb, desc) - used);
+	ext4_block_bitmap_csum_set(sb, group, desc, bitmap_bh);
+	ext4_group_desc_csum_set(sb, group, desc);
+	ext4_unlock_group(sb, group);
+	percpu_counter_sub(&sbi->s_freeclusters_counter, used);
+	if (sbi->s_log_groups_per_flex) {
+		ext4_group_t flex_group = ext4_flex_group(sbi, group);
+		atomic64_sub(used,
+			     &sbi->s_flex_groups[flex_group].free_clusters);
+	}
+	ext4_mb_unload_buddy(&e4b);
+
+	err = ext4_handle_dirty_metadata(handle, NULL, bitmap_bh);
+	ret = ext4_handle_dirty_metadata(handle, NULL, gd_bh);
+	if (!err)
+		err = ret;
+out:
+	brelse(bitmap_bh);
+	return err;
+}
+
 /**
  * ext4_trim_extent -- function to TRIM one single free extent in the group
  * @sb:		super block for the file system
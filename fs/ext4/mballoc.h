@@ -89,6 +89,22 @@ extern ushort ext4_mballoc_debug;
  */
 #define MB_DEFAULT_GROUP_PREALLOC	512
 
+/*
+ * number of groups scanned linearly from the goal for 2^N requests
+ * before candidates are taken from the largest free order lists
+ */
+#define MB_DEFAULT_LINEAR_GROUPS	4
+
+/*
+ * number of orders of free extents in a group, order 0 included
+ */
+#define MB_NUM_ORDERS(sb)		((sb)->s_blocksize_bits + 2)
+
+struct ext4_mb_last_goal {
+	ext4_group_t		group;
+	ext4_grpblk_t		start;
+};
+
 
 struct ext4_free_data {
 	/* MUST be the first member */
@@ -2571,6 +2571,7 @@ int ext4_orphan_add(handle_t *handle, struct inode *inode)
 	 */
 	if (!list_empty(&EXT4_I(inode)->i_orphan))
 		return 0;
+	ext4_fc_mark_ineligible(sb, handle);
 
 	/*
 	 * Orphan handling is only valid for files with data blocks
@@ -2652,6 +2653,7 @@ int ext4_orphan_del(handle_t *handle, struct inode *inode)
 		return 0;
 
 	if (handle) {
+		ext4_fc_mark_ineligible(inode->i_sb, handle);
 		/* Grab inode buffer early before taking global s_orphan_lock */
 		err = ext4_reserve_inode_write(handle, inode, &iloc);
 	}
@@ -2829,6 +2831,8 @@ static int ext4_unlink(struct inode *dir, struct dentry *dentry)
 	drop_nlink(inode);
 	if (!inode->i_nlink)
 		ext4_orphan_add(handle, inode);
+	else
+		ext4_fc_track_unlink(handle, dir, inode, &dentry->d_name);
 	inode->i_ctime = ext4_current_time(inode);
 	ext4_mark_inode_dirty(handle, inode);
 	retval = 0;
@@ -2980,6 +2984,9 @@ retry:
 		 */
 		if (inode->i_nlink == 1)
 			ext4_orphan_del(handle, inode);
+		else
+			ext4_fc_track_link(handle, dir, inode,
+					   &dentry->d_name);
 		d_instantiate(dentry, inode);
 	} else {
 		drop_nlink(inode);
@@ -2991,6 +2998,91 @@ retry:
 	return err;
 }
 
+/*
+ * Fast commit replay: add the entry @name for @inode to @dir, unless it
+ * is there already.
+ */
+int ext4_fc_replay_link(struct inode *dir, struct inode *inode,
+			const struct qstr *name)
+{
+	struct dentry parent = { .d_inode = dir };
+	struct dentry dentry = { .d_parent = &parent, .d_name = *name };
+	struct ext4_dir_entry_2 *de;
+	struct buffer_head *bh;
+	handle_t *handle;
+	int err, err2;
+
+	bh = ext4_find_entry(dir, name, &de, NULL);
+	if (bh) {
+		err = le32_to_cpu(de->inode) == inode->i_ino ? 0 : -EEXIST;
+		brelse(bh);
+		return err;
+	}
+
+	handle = ext4_journal_start(dir, EXT4_HT_DIR,
+		(EXT4_DATA_TRANS_BLOCKS(dir->i_sb) +
+		 EXT4_INDEX_EXTRA_TRANS_BLOCKS) + 1);
+	if (IS_ERR(handle))
+		return PTR_ERR(handle);
+	err = ext4_add_entry(handle, &dentry, inode);
+	if (!err) {
+		ext4_inc_count(handle, inode);
+		err = ext4_mark_inode_dirty(handle, inode);
+	}
+	err2 = ext4_journal_stop(handle);
+	return err ? err : err2;
+}
+
+/*
+ * Fast commit replay: remove the entry @name for inode @ino from @dir, if
+ * it is still there.
+ */
+int ext4_fc_replay_unlink(struct inode *dir, unsigned long ino,
+			  const struct qstr *name)
+{
+	struct ext4_dir_entry_2 *de;
+	struct buffer_head *bh;
+	struct inode *inode;
+	handle_t *handle;
+	int err, err2;
+
+	bh = ext4_find_entry(dir, name, &de, NULL);
+	if (!bh)
+		return 0;
+	if (le32_to_cpu(de->inode) != ino) {
+		brelse(bh);
+		return 0;
+	}
+	inode = ext4_iget(dir->i_sb, ino);
+	if (IS_ERR(inode)) {
+		brelse(bh);
+		return PTR_ERR(inode);
+	}
+
+	handle = ext4_journal_start(dir, EXT4_HT_DIR,
+				    EXT4_DATA_TRANS_BLOCKS(dir->i_sb));
+	if (IS_ERR(handle)) {
+		err = PTR_ERR(handle);
+		goto out;
+	}
+	err = ext4_delete_entry(handle, dir, de, bh);
+	if (!err) {
+		ext4_update_dx_flag(dir);
+		ext4_mark_inode_dirty(handle, dir);
+		/* The last link is never removed by a fast commit */
+		if (inode->i_nlink > 1)
+			drop_nlink(inode);
+		err = ext4_mark_inode_dirty(handle, inode);
+	}
+	err2 = ext4_journal_stop(handle);
+	if (!err)
+		err = err2;
+out:
+	iput(inode);
+	brelse(bh);
+	return err;
+}
+
 
 /*
  * Try to find buffer head where contains the parent block.
@@ -3274,6 +3366,7 @@ static int ext4_simple_rename(struct inode *old_dir, struct dentry *old_dentry,
 
 	if (IS_DIRSYNC(old.dir) || IS_DIRSYNC(new.dir))
 		ext4_handle_sync(handle);
+	ext4_fc_mark_ineligible(old.dir->i_sb, handle);
 
 	if (S_ISDIR(old.inode->i_mode)) {
 		if (new.inode) {
@@ -3414,6 +3507,7 @@ static int ext4_cross_rename(struct inode *old_dir, struct dentry *old_dentry,
 
 	if (IS_DIRSYNC(old.dir) || IS_DIRSYNC(new.dir))
 		ext4_handle_sync(handle);
+	ext4_fc_mark_ineligible(old.dir->i_sb, handle);
 
 	if (S_ISDIR(old.inode->i_mode)) {
 		old.is_dir = true;
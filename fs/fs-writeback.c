@@ -440,6 +440,137 @@ static void requeue_inode(struct inode *inode, struct bdi_writeback *wb,
 	}
 }
 
+/*
+ * Parallel writeback of one large inode.  The file is cut into
+ * MIN_WRITEBACK_PAGES segments which the flusher and up to
+ * bdi->writeback_workers - 1 helpers on bdi_wq claim in turn, starting at
+ * the mapping's cyclic writeback_index, until the chunk's page budget is
+ * used up.  ->writepages() already copes with concurrent callers on one
+ * mapping (fsync and sync_file_range race with the flusher all the time),
+ * so each segment is simply a ranged do_writepages().
+ */
+struct wb_segments {
+	struct address_space	*mapping;
+	struct writeback_control *wbc;	/* template for each segment */
+	pgoff_t			nr_segs;
+	pgoff_t			first_seg;
+	atomic_long_t		claimed;
+	atomic_long_t		nr_to_write;
+	atomic_long_t		pages_skipped;
+	int			err;
+};
+
+struct wb_segment_work {
+	struct work_struct	work;
+	struct wb_segments	*segs;
+};
+
+static void wb_write_segments(struct wb_segments *segs)
+{
+	struct writeback_control wbc;
+	long budget, claimed;
+	pgoff_t seg;
+	int ret;
+
+	while ((budget = atomic_long_read(&segs->nr_to_write)) > 0) {
+		claimed = atomic_long_inc_return(&segs->claimed) - 1;
+		if (claimed >= segs->nr_segs)
+			break;
+		seg = (segs->first_seg + claimed) % segs->nr_segs;
+
+		wbc = *segs->wbc;
+		wbc.range_cyclic = 0;
+		wbc.range_start = (loff_t)seg * MIN_WRITEBACK_PAGES <<
+							PAGE_CACHE_SHIFT;
+		wbc.range_end = wbc.range_start +
+			((loff_t)MIN_WRITEBACK_PAGES << PAGE_CACHE_SHIFT) - 1;
+		wbc.nr_to_write = min_t(long, budget, MIN_WRITEBACK_PAGES);
+		wbc.pages_skipped = 0;
+
+		ret = do_writepages(segs->mapping, &wbc);
+		atomic_long_sub(min_t(long, budget, MIN_WRITEBACK_PAGES) -
+				wbc.nr_to_write, &segs->nr_to_write);
+		atomic_long_add(wbc.pages_skipped, &segs->pages_skipped);
+		if (ret)
+			cmpxchg(&segs->err, 0, ret);
+	}
+}
+
+static void wb_segment_workfn(struct work_struct *work)
+{
+	struct wb_segment_work *sw = container_of(work,
+					struct wb_segment_work, work);
+
+	wb_write_segments(sw->segs);
+}
+
+static int writeback_inode_pages(struct inode *inode,
+				 struct writeback_control *wbc)
+{
+	struct address_space *mapping = inode->i_mapping;
+	struct backing_dev_info *bdi = inode_to_bdi(inode);
+	struct wb_segment_work works[BDI_MAX_WRITEBACK_WORKERS - 1];
+	struct wb_segments segs;
+	unsigned int workers = min_t(unsigned int, bdi->writeback_workers,
+				     BDI_MAX_WRITEBACK_WORKERS);
+	pgoff_t end_index;
+	unsigned int i;
+	loff_t isize;
+
+	/*
+	 * Only background and periodic writeback of large files: integrity
+	 * writeback relies on tagging the whole file in one pass.
+	 */
+	if (workers < 2 || wbc->sync_mode != WB_SYNC_NONE ||
+	    wbc->tagged_writepages || !wbc->range_cyclic ||
+	    wbc->nr_to_write < 2 * (long)MIN_WRITEBACK_PAGES)
+		return do_writepages(mapping, wbc);
+
+	isize = i_size_read(inode);
+	end_index = isize >> PAGE_CACHE_SHIFT;
+	if (end_index < 2 * MIN_WRITEBACK_PAGES)
+		return do_writepages(mapping, wbc);
+
+	segs.mapping = mapping;
+	segs.wbc = wbc;
+	segs.nr_segs = end_index / MIN_WRITEBACK_PAGES + 1;
+	segs.first_seg = (mapping->writeback_index / MIN_WRITEBACK_PAGES) %
+				segs.nr_segs;
+	atomic_long_set(&segs.claimed, 0);
+	atomic_long_set(&segs.nr_to_write, wbc->nr_to_write);
+	atomic_long_set(&segs.pages_skipped, 0);
+	segs.err = 0;
+
+	/* No point in more helpers than the budget has segments for */
+	workers = min_t(unsigned long, workers,
+			wbc->nr_to_write / MIN_WRITEBACK_PAGES);
+
+	for (i = 0; i + 1 < workers; i++) {
+		INIT_WORK_ONSTACK(&works[i].work, wb_segment_workfn);
+		works[i].segs = &segs;
+		queue_work(bdi_wq, &works[i].work);
+	}
+
+	wb_write_segments(&segs);
+
+	/*
+	 * Helpers that never got to run are not needed any more; don't wait
+	 * for them, bdi_wq may be down to its rescuer, which is us.
+	 */
+	for (i = 0; i + 1 < workers; i++) {
+		cancel_work_sync(&works[i].work);
+		destroy_work_on_stack(&works[i].work);
+	}
+
+	wbc->nr_to_write = atomic_long_read(&segs.nr_to_write);
+	wbc->pages_skipped += atomic_long_read(&segs.pages_skipped);
+	mapping->writeback_index = ((segs.first_seg +
+		min_t(long, atomic_long_read(&segs.claimed), segs.nr_segs)) %
+		segs.nr_segs) * MIN_WRITEBACK_PAGES;
+
+	return segs.err;
+}
+
 /*
  * Write out an inode and its dirty pages. Do not update the writeback list
  * linkage. That is left to the caller. The caller is also responsible for
@@ -457,7 +588,7 @@ __writeback_single_inode(struct inode *inode, struct writeback_control *wbc)
 
 	trace_writeback_single_inode_start(inode, wbc, nr_to_write);
 
-	ret = do_writepages(mapping, wbc);
+	ret = writeback_inode_pages(inode, wbc);
 
 	/*
 	 * Make sure to wait on the data before writing out the metadata.
@@ -28,11 +28,14 @@ static struct kmem_cache *fuse_req_cachep;
 
 static struct fuse_conn *fuse_get_conn(struct file *file)
 {
+	struct fuse_chan *chan = file->private_data;
+
 	/*
 	 * Lockless access is OK, because file->private data is set
-	 * once during mount and is valid until the file is released.
+	 * once during mount or clone and is valid until the file is
+	 * released.
 	 */
-	return file->private_data;
+	return chan ? chan->fc : NULL;
 }
 
 static void fuse_request_init(struct fuse_req *req, struct page **pages,
@@ -309,17 +312,67 @@ static u64 fuse_get_unique(struct fuse_conn *fc)
 	return fc->reqctr;
 }
 
+/* The channel of the CPU we are running on */
+static struct fuse_chan *fuse_route_chan(struct fuse_conn *fc)
+{
+	/* No channels left: the connection is being torn down */
+	if (!fc->num_chans)
+		return &fc->chan0;
+
+	return fc->chans[raw_smp_processor_id() % fc->num_chans];
+}
+
+/*
+ * Wake up a reader for work queued on @chan: one of its own readers if
+ * any is waiting, else one of another channel, which will steal it.
+ *
+ * Called with fc->lock held.
+ */
+static void fuse_wake_up_chan(struct fuse_conn *fc, struct fuse_chan *chan)
+{
+	unsigned i;
+
+	if (!waitqueue_active(&chan->waitq)) {
+		for (i = 0; i < fc->num_chans; i++) {
+			if (waitqueue_active(&fc->chans[i]->waitq)) {
+				chan = fc->chans[i];
+				break;
+			}
+		}
+	}
+	wake_up(&chan->waitq);
+}
+
+static void __fuse_wake_up_all(struct fuse_conn *fc)
+{
+	unsigned i;
+
+	for (i = 0; i < fc->num_chans; i++)
+		wake_up_all(&fc->chans[i]->waitq);
+}
+
+void fuse_wake_up_all(struct fuse_conn *fc)
+{
+	spin_lock(&fc->lock);
+	__fuse_wake_up_all(fc);
+	spin_unlock(&fc->lock);
+}
+EXPORT_SYMBOL_GPL(fuse_wake_up_all);
+
 static void queue_request(struct fuse_conn *fc, struct fuse_req *req)
 {
+	struct fuse_chan *chan = fuse_route_chan(fc);
+
 	req->in.h.len = sizeof(struct fuse_in_header) +
 		len_args(req->in.numargs, (struct fuse_arg *) req->in.args);
-	list_add_tail(&req->list, &fc->pending);
+	list_add_tail(&req->list, &chan->pending);
+	fc->num_pending++;
 	req->state = FUSE_REQ_PENDING;
 	if (!req->waiting) {
 		req->waiting = 1;
 		atomic_inc(&fc->num_waiting);
 	}
-	wake_up(&fc->waitq);
+	fuse_wake_up_chan(fc, chan);
 	kill_fasync(&fc->fasync, SIGIO, POLL_IN);
 }
 
@@ -333,7 +386,7 @@ void fuse_queue_forget(struct fuse_conn *fc, struct fuse_forget_link *forget,
 	if (fc->connected) {
 		fc->forget_list_tail->next = forget;
 		fc->forget_list_tail = forget;
-		wake_up(&fc->waitq);
+		fuse_wake_up_chan(fc, fuse_route_chan(fc));
 		kill_fasync(&fc->fasync, SIGIO, POLL_IN);
 	} else {
 		kfree(forget);
@@ -415,7 +468,7 @@ __acquires(fc->lock)
 static void queue_interrupt(struct fuse_conn *fc, struct fuse_req *req)
 {
 	list_add_tail(&req->intr_entry, &fc->interrupts);
-	wake_up(&fc->waitq);
+	fuse_wake_up_chan(fc, fuse_route_chan(fc));
 	kill_fasync(&fc->fasync, SIGIO, POLL_IN);
 }
 
@@ -453,6 +506,7 @@ __acquires(fc->lock)
 		/* Request is not yet in userspace, bail out */
 		if (req->state == FUSE_REQ_PENDING) {
 			list_del(&req->list);
+			fc->num_pending--;
 			__fuse_put_request(req);
 			req->out.h.error = -EINTR;
 			return;
@@ -1005,18 +1059,18 @@ static int forget_pending(struct fuse_conn *fc)
 
 static int request_pending(struct fuse_conn *fc)
 {
-	return !list_empty(&fc->pending) || !list_empty(&fc->interrupts) ||
+	return fc->num_pending || !list_empty(&fc->interrupts) ||
 		forget_pending(fc);
 }
 
 /* Wait until a request is available on the pending list */
-static void request_wait(struct fuse_conn *fc)
+static void request_wait(struct fuse_conn *fc, struct fuse_chan *chan)
 __releases(fc->lock)
 __acquires(fc->lock)
 {
 	DECLARE_WAITQUEUE(wait, current);
 
-	add_wait_queue_exclusive(&fc->waitq, &wait);
+	add_wait_queue_exclusive(&chan->waitq, &wait);
 	while (fc->connected && !request_pending(fc)) {
 		set_current_state(TASK_INTERRUPTIBLE);
 		if (signal_pending(current))
@@ -1027,7 +1081,24 @@ __acquires(fc->lock)
 		spin_lock(&fc->lock);
 	}
 	set_current_state(TASK_RUNNING);
-	remove_wait_queue(&fc->waitq, &wait);
+	remove_wait_queue(&chan->waitq, &wait);
+}
+
+/*
+ * Take the first pending request of @chan, or if it has none, of another
+ * channel.  Called with fc->lock held and fc->num_pending nonzero.
+ */
+static struct fuse_req *dequeue_pending(struct fuse_conn *fc,
+					struct fuse_chan *chan)
+{
+	unsigned i = 0;
+
+	while (list_empty(&chan->pending)) {
+		BUG_ON(i >= fc->num_chans);
+		chan = fc->chans[i++];
+	}
+	fc->num_pending--;
+	return list_entry(chan->pending.next, struct fuse_req, list);
 }
 
 /*
@@ -1195,6 +1266,7 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 				struct fuse_copy_state *cs, size_t nbytes)
 {
 	int err;
+	struct fuse_chan *chan = file->private_data;
 	struct fuse_req *req;
 	struct fuse_in *in;
 	unsigned reqsize;
@@ -1206,7 +1278,7 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 	    !request_pending(fc))
 		goto err_unlock;
 
-	request_wait(fc);
+	request_wait(fc, chan);
 	err = -ENODEV;
 	if (!fc->connected)
 		goto err_unlock;
@@ -1221,14 +1293,14 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 	}
 
 	if (forget_pending(fc)) {
-		if (list_empty(&fc->pending) || fc->forget_batch-- > 0)
+		if (!fc->num_pending || fc->forget_batch-- > 0)
 			return fuse_read_forget(fc, cs, nbytes);
 
 		if (fc->forget_batch <= -8)
 			fc->forget_batch = 16;
 	}
 
-	req = list_entry(fc->pending.next, struct fuse_req, list);
+	req = dequeue_pending(fc, chan);
 	req->state = FUSE_REQ_READING;
 	list_move(&req->list, &fc->io);
 
@@ -1975,11 +2047,12 @@ out:
 static unsigned fuse_dev_poll(struct file *file, poll_table *wait)
 {
 	unsigned mask = POLLOUT | POLLWRNORM;
+	struct fuse_chan *chan = file->private_data;
 	struct fuse_conn *fc = fuse_get_conn(file);
 	if (!fc)
 		return POLLERR;
 
-	poll_wait(file, &fc->waitq, wait);
+	poll_wait(file, &chan->waitq, wait);
 
 	spin_lock(&fc->lock);
 	if (!fc->connected)
@@ -2046,13 +2119,27 @@ __acquires(fc->lock)
 	}
 }
 
+static void end_pending_requests(struct fuse_conn *fc)
+__releases(fc->lock)
+__acquires(fc->lock)
+{
+	LIST_HEAD(head);
+	unsigned i;
+
+	for (i = 0; i < fc->num_chans; i++)
+		list_splice_tail_init(&fc->chans[i]->pending, &head);
+	list_splice_tail_init(&fc->chan0.pending, &head);
+	fc->num_pending = 0;
+	end_requests(fc, &head);
+}
+
 static void end_queued_requests(struct fuse_conn *fc)
 __releases(fc->lock)
 __acquires(fc->lock)
 {
 	fc->max_background = UINT_MAX;
 	flush_bg_queue(fc);
-	end_requests(fc, &fc->pending);
+	end_pending_requests(fc);
 	end_requests(fc, &fc->processing);
 	while (forget_pending(fc))
 		kfree(dequeue_forget(fc, 1, NULL));
@@ -2102,7 +2189,7 @@ void fuse_abort_conn(struct fuse_conn *fc)
 		end_io_requests(fc);
 		end_queued_requests(fc);
 		end_polls(fc);
-		wake_up_all(&fc->waitq);
+		__fuse_wake_up_all(fc);
 		wake_up_all(&fc->blocked_waitq);
 		kill_fasync(&fc->fasync, SIGIO, POLL_IN);
 	}
@@ -2110,18 +2197,41 @@ void fuse_abort_conn(struct fuse_conn *fc)
 }
 EXPORT_SYMBOL_GPL(fuse_abort_conn);
 
+/*
+ * Remove @chan from the channels of the connection and hand its pending
+ * requests to the first remaining one.  Called with fc->lock held.
+ */
+static void fuse_chan_detach(struct fuse_conn *fc, struct fuse_chan *chan)
+{
+	struct fuse_chan *last = fc->chans[--fc->num_chans];
+
+	fc->chans[chan->idx] = last;
+	last->idx = chan->idx;
+	if (fc->num_chans && !list_empty(&chan->pending)) {
+		list_splice_tail_init(&chan->pending, &fc->chans[0]->pending);
+		fuse_wake_up_chan(fc, fc->chans[0]);
+	}
+}
+
 int fuse_dev_release(struct inode *inode, struct file *file)
 {
+	struct fuse_chan *chan = file->private_data;
 	struct fuse_conn *fc = fuse_get_conn(file);
 	if (fc) {
 		spin_lock(&fc->lock);
-		fc->connected = 0;
-		fc->blocked = 0;
-		fc->initialized = 1;
-		end_queued_requests(fc);
-		end_polls(fc);
-		wake_up_all(&fc->blocked_waitq);
+		/* The connection goes away with its last channel */
+		if (fc->num_chans == 1) {
+			fc->connected = 0;
+			fc->blocked = 0;
+			fc->initialized = 1;
+			end_queued_requests(fc);
+			end_polls(fc);
+			wake_up_all(&fc->blocked_waitq);
+		}
+		fuse_chan_detach(fc, chan);
 		spin_unlock(&fc->lock);
+		if (chan != &fc->chan0)
+			kfree(chan);
 		fuse_conn_put(fc);
 	}
 
@@ -2129,6 +2239,73 @@ int fuse_dev_release(struct inode *inode, struct file *file)
 }
 EXPORT_SYMBOL_GPL(fuse_dev_release);
 
+/* Attach @new, a newly opened /dev/fuse file, to the connection of @old */
+static int fuse_dev_clone(struct file *new, struct file *old)
+{
+	struct fuse_conn *fc = fuse_get_conn(old);
+	struct fuse_chan *chan;
+	int err;
+
+	if (!fc || old->f_op != new->f_op)
+		return -EINVAL;
+
+	chan = kzalloc(sizeof(*chan), GFP_KERNEL);
+	if (!chan)
+		return -ENOMEM;
+	chan->fc = fc;
+	init_waitqueue_head(&chan->waitq);
+	INIT_LIST_HEAD(&chan->pending);
+
+	mutex_lock(&fuse_mutex);
+	err = -EINVAL;
+	if (new->private_data)
+		goto err_unlock;
+
+	spin_lock(&fc->lock);
+	err = -ENODEV;
+	if (!fc->connected || !fc->num_chans)
+		goto err_unlock_fc;
+	err = -EMFILE;
+	if (fc->num_chans == FUSE_MAX_CHANS)
+		goto err_unlock_fc;
+	chan->idx = fc->num_chans;
+	fc->chans[fc->num_chans++] = chan;
+	spin_unlock(&fc->lock);
+
+	fuse_conn_get(fc);
+	new->private_data = chan;
+	mutex_unlock(&fuse_mutex);
+	return 0;
+
+ err_unlock_fc:
+	spin_unlock(&fc->lock);
+ err_unlock:
+	mutex_unlock(&fuse_mutex);
+	kfree(chan);
+	return err;
+}
+
+static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
+			   unsigned long arg)
+{
+	struct file *old;
+	int oldfd, err;
+
+	if (cmd != FUSE_DEV_IOC_CLONE)
+		return -ENOTTY;
+
+	if (get_user(oldfd, (__u32 __user *) arg))
+		return -EFAULT;
+
+	old = fget(oldfd);
+	if (!old)
+		return -EBADF;
+	err = fuse_dev_clone(file, old);
+	fput(old);
+
+	return err;
+}
+
 static int fuse_dev_fasync(int fd, struct file *file, int on)
 {
 	struct fuse_conn *fc = fuse_get_conn(file);
@@ -2151,6 +2328,8 @@ const struct file_operations fuse_dev_operations = {
 	.poll		= fuse_dev_poll,
 	.release	= fuse_dev_release,
 	.fasync		= fuse_dev_fasync,
+	.unlocked_ioctl = fuse_dev_ioctl,
+	.compat_ioctl   = fuse_dev_ioctl,
 };
 EXPORT_SYMBOL_GPL(fuse_dev_operations);
 
@@ -2875,6 +2875,7 @@ fuse_direct_IO(int rw, struct kiocb *iocb, struct iov_iter *iter,
 	loff_t i_size;
 	size_t count = iov_iter_count(iter);
 	struct fuse_io_priv *io;
+	struct kiocb sync_iocb;
 
 	pos = offset;
 	inode = file->f_mapping->host;
@@ -2910,12 +2911,16 @@ fuse_direct_IO(int rw, struct kiocb *iocb, struct iov_iter *iter,
 	io->iocb = iocb;
 
 	/*
-	 * We cannot asynchronously extend the size of a file. We have no method
-	 * to wait on real async I/O requests, so we must submit this request
-	 * synchronously.
+	 * We cannot asynchronously extend the size of a file.  Such a write
+	 * is still sent as parallel requests, but completed against a
+	 * private synchronous kiocb that we wait on before updating the
+	 * size, so the aio behaves like a synchronous one.
 	 */
-	if (!is_sync_kiocb(iocb) && (offset + count > i_size) && rw == WRITE)
-		io->async = false;
+	if (io->async && !is_sync_kiocb(iocb) && (offset + count > i_size) &&
+	    rw == WRITE) {
+		init_sync_kiocb(&sync_iocb, file);
+		io->iocb = &sync_iocb;
+	}
 
 	if (rw == WRITE)
 		ret = __fuse_direct_write(io, iter, &pos);
@@ -2923,13 +2928,15 @@ fuse_direct_IO(int rw, struct kiocb *iocb, struct iov_iter *iter,
 		ret = __fuse_direct_read(io, iter, &pos);
 
 	if (io->async) {
+		struct kiocb *wait_iocb = io->iocb;
+
 		fuse_aio_complete(io, ret < 0 ? ret : 0, -1);
 
 		/* we have a non-extending, async request, so return */
-		if (!is_sync_kiocb(iocb))
+		if (!is_sync_kiocb(wait_iocb))
 			return -EIOCBQUEUED;
 
-		ret = wait_on_sync_kiocb(iocb);
+		ret = wait_on_sync_kiocb(wait_iocb);
 	} else {
 		kfree(io);
 	}
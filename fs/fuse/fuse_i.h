@@ -47,6 +47,9 @@
 /** Number of page pointers embedded in fuse_req */
 #define FUSE_REQ_INLINE_PAGES 1
 
+/** Maximum number of /dev/fuse channels of a connection */
+#define FUSE_MAX_CHANS 64
+
 /** List of active connections */
 extern struct list_head fuse_conn_list;
 
@@ -364,6 +367,29 @@ struct fuse_req {
 	struct file *stolen_file;
 };
 
+struct fuse_conn;
+
+/**
+ * A channel of a connection: an open /dev/fuse file.
+ *
+ * A connection starts with one channel, more are attached with
+ * FUSE_DEV_IOC_CLONE.  Requests are queued on the channel of the CPU they
+ * are submitted on, and readers of a channel take its requests first.
+ */
+struct fuse_chan {
+	/** The connection */
+	struct fuse_conn *fc;
+
+	/** Index in fc->chans, protected by fc->lock */
+	unsigned idx;
+
+	/** Readers of the channel are waiting on this */
+	wait_queue_head_t waitq;
+
+	/** The list of pending requests routed to this channel */
+	struct list_head pending;
+};
+
 /**
  * A Fuse connection.
  *
@@ -395,11 +421,15 @@ struct fuse_conn {
 	/** Maximum write size */
 	unsigned max_write;
 
-	/** Readers of the connection are waiting on this */
-	wait_queue_head_t waitq;
+	/** The channel the connection was created with */
+	struct fuse_chan chan0;
 
-	/** The list of pending requests */
-	struct list_head pending;
+	/** Attached channels, the first num_chans entries are valid */
+	struct fuse_chan *chans[FUSE_MAX_CHANS];
+	unsigned num_chans;
+
+	/** Number of requests on the pending lists of all channels */
+	unsigned num_pending;
 
 	/** The list of requests being processed */
 	struct list_head processing;
@@ -790,6 +820,11 @@ void fuse_request_send_background_locked(struct fuse_conn *fc,
 /* Abort all requests */
 void fuse_abort_conn(struct fuse_conn *fc);
 
+/**
+ * Wake up all readers of the connection
+ */
+void fuse_wake_up_all(struct fuse_conn *fc);
+
 /**
  * Invalidate inode attributes
  */
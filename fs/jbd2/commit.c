@@ -546,13 +546,16 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 
 	/*
 	 * Now start flushing things to disk, in the order they appear
-	 * on the transaction lists.  Data blocks go first.
+	 * on the transaction lists.  Data blocks go first.  The plug
+	 * covers the data, revoke and metadata writes alike, so that the
+	 * log I/O is queued while the data is still being submitted and
+	 * adjacent log blocks are merged into large requests.
 	 */
+	blk_start_plug(&plug);
 	err = journal_submit_data_buffers(journal, commit_transaction);
 	if (err)
 		jbd2_journal_abort(journal, err);
 
-	blk_start_plug(&plug);
 	jbd2_journal_write_revoke_records(journal, commit_transaction,
 					  &log_bufs, WRITE_SYNC);
 
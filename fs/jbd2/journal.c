@@ -43,6 +43,7 @@
 #include <linux/backing-dev.h>
 #include <linux/bitops.h>
 #include <linux/ratelimit.h>
+#include <linux/crc32.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/jbd2.h>
@@ -79,6 +80,7 @@ EXPORT_SYMBOL(jbd2_journal_init_inode);
 EXPORT_SYMBOL(jbd2_journal_check_used_features);
 EXPORT_SYMBOL(jbd2_journal_check_available_features);
 EXPORT_SYMBOL(jbd2_journal_set_features);
+EXPORT_SYMBOL(jbd2_journal_init_fc);
 EXPORT_SYMBOL(jbd2_journal_load);
 EXPORT_SYMBOL(jbd2_journal_destroy);
 EXPORT_SYMBOL(jbd2_journal_abort);
@@ -754,6 +756,125 @@ wait_commit:
 }
 EXPORT_SYMBOL(jbd2_complete_transaction);
 
+/**
+ * int jbd2_fc_commit_block() - Write a fast commit block for a transaction
+ * @journal: journal to write to
+ * @tid: the running transaction the record belongs to
+ * @buf: payload, opaque to jbd2
+ * @len: payload length, at most a block minus the fast commit header
+ *
+ * Append one block to the fast commit area on behalf of the running
+ * transaction @tid and wait for it to reach stable storage.  If @tid
+ * never commits, recovery hands the payloads of all fast commit blocks
+ * written for it back to the filesystem via j_fc_replay_callback.
+ *
+ * The caller must make sure that no handle can modify what @buf
+ * describes while this runs, typically with jbd2_journal_lock_updates().
+ *
+ * Returns 0 once the block is on disk.  -EAGAIN means @tid is not (or no
+ * longer) the only uncommitted transaction and -ENOSPC that the fast
+ * commit area is full; in both cases the caller must fall back to a full
+ * commit of @tid.
+ */
+int jbd2_fc_commit_block(journal_t *journal, tid_t tid, const void *buf,
+			 int len)
+{
+	jbd2_fc_header_t *fc;
+	struct buffer_head *bh;
+	unsigned long long blocknr;
+	unsigned long off;
+	int write_op = WRITE_SYNC;
+	int err;
+
+	if (!JBD2_HAS_INCOMPAT_FEATURE(journal,
+				       JBD2_FEATURE_INCOMPAT_FAST_COMMIT) ||
+	    len > journal->j_blocksize - sizeof(jbd2_fc_header_t))
+		return -EINVAL;
+
+	write_lock(&journal->j_state_lock);
+	while (journal->j_flags & JBD2_FAST_COMMIT_ONGOING) {
+		DEFINE_WAIT(wait);
+
+		prepare_to_wait(&journal->j_fc_wait, &wait,
+				TASK_UNINTERRUPTIBLE);
+		write_unlock(&journal->j_state_lock);
+		schedule();
+		finish_wait(&journal->j_fc_wait, &wait);
+		write_lock(&journal->j_state_lock);
+	}
+	/*
+	 * A fast commit is only replayed on top of the last committed
+	 * transaction, so there must be no other commit in flight.
+	 */
+	if (is_journal_aborted(journal)) {
+		err = -EIO;
+		goto out_unlock;
+	}
+	if (!journal->j_running_transaction ||
+	    journal->j_running_transaction->t_tid != tid ||
+	    journal->j_committing_transaction) {
+		err = -EAGAIN;
+		goto out_unlock;
+	}
+	if (journal->j_fc_tid != tid) {
+		journal->j_fc_tid = tid;
+		journal->j_fc_off = 0;
+	}
+	if (journal->j_fc_first + journal->j_fc_off >= journal->j_fc_last) {
+		err = -ENOSPC;
+		goto out_unlock;
+	}
+	off = journal->j_fc_off;
+	journal->j_flags |= JBD2_FAST_COMMIT_ONGOING;
+	write_unlock(&journal->j_state_lock);
+
+	err = jbd2_journal_bmap(journal, journal->j_fc_first + off, &blocknr);
+	if (err)
+		goto out;
+	bh = __getblk(journal->j_dev, blocknr, journal->j_blocksize);
+	if (!bh) {
+		err = -ENOMEM;
+		goto out;
+	}
+	lock_buffer(bh);
+	memset(bh->b_data, 0, journal->j_blocksize);
+	fc = (jbd2_fc_header_t *)bh->b_data;
+	fc->fc_header.h_magic = cpu_to_be32(JBD2_MAGIC_NUMBER);
+	fc->fc_header.h_blocktype = cpu_to_be32(JBD2_FC_BLOCK);
+	fc->fc_header.h_sequence = cpu_to_be32(tid);
+	fc->fc_len = cpu_to_be32(len);
+	memcpy(fc + 1, buf, len);
+	fc->fc_checksum = cpu_to_be32(crc32_be(~0, bh->b_data,
+					       journal->j_blocksize));
+	set_buffer_uptodate(bh);
+	clear_buffer_dirty(bh);
+
+	/*
+	 * The flush also covers the data the caller wrote before us, as
+	 * long as it lives on the journal device.
+	 */
+	if (journal->j_flags & JBD2_BARRIER)
+		write_op = WRITE_FLUSH_FUA;
+	get_bh(bh);
+	bh->b_end_io = end_buffer_write_sync;
+	submit_bh(write_op, bh);
+	wait_on_buffer(bh);
+	if (!buffer_uptodate(bh))
+		err = -EIO;
+	brelse(bh);
+
+out:
+	write_lock(&journal->j_state_lock);
+	if (!err && journal->j_fc_tid == tid)
+		journal->j_fc_off = off + 1;
+	journal->j_flags &= ~JBD2_FAST_COMMIT_ONGOING;
+	wake_up(&journal->j_fc_wait);
+out_unlock:
+	write_unlock(&journal->j_state_lock);
+	return err;
+}
+EXPORT_SYMBOL(jbd2_fc_commit_block);
+
 /*
  * Log buffer allocation routines:
  */
@@ -1082,6 +1203,7 @@ static journal_t * journal_init_common (void)
 	init_waitqueue_head(&journal->j_wait_commit);
 	init_waitqueue_head(&journal->j_wait_updates);
 	init_waitqueue_head(&journal->j_wait_reserved);
+	init_waitqueue_head(&journal->j_fc_wait);
 	mutex_init(&journal->j_barrier);
 	mutex_init(&journal->j_checkpoint_mutex);
 	spin_lock_init(&journal->j_revoke_lock);
@@ -1267,6 +1389,22 @@ static void journal_fail_superblock (journal_t *journal)
 	journal->j_sb_buffer = NULL;
 }
 
+/*
+ * With fast commits enabled, the last s_num_fc_blks blocks of the journal
+ * hold the fast commit area and the circular log ends in front of it.
+ */
+static void journal_fc_layout(journal_t *journal)
+{
+	journal_superblock_t *sb = journal->j_superblock;
+
+	journal->j_fc_first = journal->j_fc_last = journal->j_last;
+	if (!JBD2_HAS_INCOMPAT_FEATURE(journal,
+				       JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		return;
+	journal->j_last -= be32_to_cpu(sb->s_num_fc_blks);
+	journal->j_fc_first = journal->j_last;
+}
+
 /*
  * Given a journal_t structure, initialise the various fields for
  * startup of a new journaling session.  We use this both when creating
@@ -1290,10 +1428,11 @@ static int journal_reset(journal_t *journal)
 
 	journal->j_first = first;
 	journal->j_last = last;
+	journal_fc_layout(journal);
 
 	journal->j_head = first;
 	journal->j_tail = first;
-	journal->j_free = last - first;
+	journal->j_free = journal->j_last - first;
 
 	journal->j_tail_sequence = journal->j_transaction_sequence;
 	journal->j_commit_sequence = journal->j_transaction_sequence - 1;
@@ -1522,6 +1661,16 @@ static int journal_get_superblock(journal_t *journal)
 		goto out;
 	}
 
+	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
+				      JBD2_FEATURE_INCOMPAT_FAST_COMMIT) &&
+	    be32_to_cpu(sb->s_first) + JBD2_MIN_JOURNAL_BLOCKS +
+	    be32_to_cpu(sb->s_num_fc_blks) > be32_to_cpu(sb->s_maxlen) + 1) {
+		printk(KERN_WARNING
+			"JBD2: Invalid fast commit area size: %u\n",
+			be32_to_cpu(sb->s_num_fc_blks));
+		goto out;
+	}
+
 	if (JBD2_HAS_COMPAT_FEATURE(journal, JBD2_FEATURE_COMPAT_CHECKSUM) &&
 	    JBD2_HAS_INCOMPAT_FEATURE(journal, JBD2_FEATURE_INCOMPAT_CSUM_V2)) {
 		/* Can't have checksum v1 and v2 on at the same time! */
@@ -1586,6 +1735,7 @@ static int load_superblock(journal_t *journal)
 	journal->j_tail = be32_to_cpu(sb->s_start);
 	journal->j_first = be32_to_cpu(sb->s_first);
 	journal->j_last = be32_to_cpu(sb->s_maxlen);
+	journal_fc_layout(journal);
 	journal->j_errno = be32_to_cpu(sb->s_errno);
 
 	return 0;
@@ -1890,6 +2040,56 @@ void jbd2_journal_clear_features(journal_t *journal, unsigned long compat,
 }
 EXPORT_SYMBOL(jbd2_journal_clear_features);
 
+/**
+ * int jbd2_journal_init_fc() - Enable fast commits on a journal
+ * @journal: Journal to act on.
+ * @nblocks: number of blocks to set aside for fast commit records
+ *
+ * Carve a fast commit area of @nblocks blocks from the end of the journal
+ * and set JBD2_FEATURE_INCOMPAT_FAST_COMMIT.  This changes where the log
+ * wraps, so it may only be called on a freshly loaded, empty journal,
+ * before any handle has been started.  The superblock is written out
+ * before returning.  Calling this on a journal which already has fast
+ * commits enabled keeps the existing area.
+ */
+int jbd2_journal_init_fc(journal_t *journal, unsigned int nblocks)
+{
+	journal_superblock_t *sb = journal->j_superblock;
+
+	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
+				      JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		return 0;
+	if (journal->j_format_version < 2)
+		return -EINVAL;
+
+	write_lock(&journal->j_state_lock);
+	if (journal->j_running_transaction ||
+	    journal->j_committing_transaction ||
+	    journal->j_head != journal->j_tail) {
+		write_unlock(&journal->j_state_lock);
+		return -EBUSY;
+	}
+	if (journal->j_first + JBD2_MIN_JOURNAL_BLOCKS + nblocks >
+	    journal->j_last + 1) {
+		write_unlock(&journal->j_state_lock);
+		return -ENOSPC;
+	}
+	sb->s_num_fc_blks = cpu_to_be32(nblocks);
+	sb->s_feature_incompat |=
+		cpu_to_be32(JBD2_FEATURE_INCOMPAT_FAST_COMMIT);
+	journal_fc_layout(journal);
+	journal->j_head = journal->j_tail = journal->j_first;
+	journal->j_free = journal->j_last - journal->j_first;
+	write_unlock(&journal->j_state_lock);
+
+	/* Recovery must never see the old layout once the log is reused */
+	mutex_lock(&journal->j_checkpoint_mutex);
+	jbd2_journal_update_sb_log_tail(journal, journal->j_tail_sequence,
+					journal->j_tail, WRITE_FUA);
+	mutex_unlock(&journal->j_checkpoint_mutex);
+	return 0;
+}
+
 /**
  * int jbd2_journal_flush () - Flush journal
  * @journal: Journal to act on.
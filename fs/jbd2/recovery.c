@@ -43,6 +43,8 @@ static int do_one_pass(journal_t *journal,
 				struct recovery_info *info, enum passtype pass);
 static int scan_revoke_records(journal_t *, struct buffer_head *,
 				tid_t, struct recovery_info *);
+static int fc_do_one_pass(journal_t *journal, tid_t tid, int any_later,
+			  tid_t *fc_tid);
 
 #ifdef __KERNEL__
 
@@ -249,6 +251,7 @@ int jbd2_journal_recover(journal_t *journal)
 {
 	int			err, err2;
 	journal_superblock_t *	sb;
+	tid_t			fc_tid;
 
 	struct recovery_info	info;
 
@@ -265,7 +268,15 @@ int jbd2_journal_recover(journal_t *journal)
 		jbd_debug(1, "No recovery required, last transaction %d\n",
 			  be32_to_cpu(sb->s_sequence));
 		journal->j_transaction_sequence = be32_to_cpu(sb->s_sequence) + 1;
-		return 0;
+		/*
+		 * The log is empty, but a transaction started after it was
+		 * emptied may still have been fast committed.
+		 */
+		err = fc_do_one_pass(journal, be32_to_cpu(sb->s_sequence), 1,
+				     &fc_tid);
+		if (err > 0 && tid_geq(fc_tid, journal->j_transaction_sequence))
+			journal->j_transaction_sequence = fc_tid + 1;
+		return err < 0 ? err : 0;
 	}
 
 	err = do_one_pass(journal, &info, PASS_SCAN);
@@ -273,6 +284,11 @@ int jbd2_journal_recover(journal_t *journal)
 		err = do_one_pass(journal, &info, PASS_REVOKE);
 	if (!err)
 		err = do_one_pass(journal, &info, PASS_REPLAY);
+	if (!err) {
+		err = fc_do_one_pass(journal, info.end_transaction, 0, &fc_tid);
+		if (err > 0)
+			err = 0;
+	}
 
 	jbd_debug(1, "JBD2: recovery, exit status %d, "
 		  "recovered transactions %u to %u\n",
@@ -824,6 +840,82 @@ static int jbd2_revoke_block_csum_verify(journal_t *j,
 	return provided == cpu_to_be32(calculated);
 }
 
+/*
+ * Hand the fast commit area back to the filesystem.  Fast commit blocks
+ * only describe changes on top of the last committed transaction, so they
+ * are valid if they were written for @tid, the first transaction that did
+ * not commit.  With @any_later set, as for a log that was marked empty,
+ * any transaction from @tid on qualifies.  Replay stops at the first block
+ * that does not carry the same sequence as the first one, or whose
+ * checksum does not match.
+ *
+ * Returns 1 and the transaction in *fc_tid if the area belongs to it, so
+ * that the caller does not hand out that tid again, 0 if there is nothing
+ * to replay, or a negative error.
+ */
+static int fc_do_one_pass(journal_t *journal, tid_t tid, int any_later,
+			  tid_t *fc_tid)
+{
+	struct buffer_head	*bh;
+	jbd2_fc_header_t	*fc;
+	unsigned long		off;
+	unsigned int		sequence, len;
+	__be32			provided;
+	int			err, found = 0, nr = 0;
+
+	if (!JBD2_HAS_INCOMPAT_FEATURE(journal,
+				       JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		return 0;
+
+	for (off = journal->j_fc_first; off < journal->j_fc_last; off++) {
+		err = jread(&bh, journal, off);
+		if (err)
+			return err;
+
+		fc = (jbd2_fc_header_t *)bh->b_data;
+		sequence = be32_to_cpu(fc->fc_header.h_sequence);
+		if (fc->fc_header.h_magic != cpu_to_be32(JBD2_MAGIC_NUMBER) ||
+		    be32_to_cpu(fc->fc_header.h_blocktype) != JBD2_FC_BLOCK ||
+		    (found ? sequence != tid :
+		     sequence != tid && !(any_later && tid_gt(sequence, tid)))) {
+			brelse(bh);
+			break;
+		}
+		if (!found) {
+			tid = sequence;
+			found = 1;
+		}
+
+		len = be32_to_cpu(fc->fc_len);
+		provided = fc->fc_checksum;
+		fc->fc_checksum = 0;
+		if (len > journal->j_blocksize - sizeof(jbd2_fc_header_t) ||
+		    provided != cpu_to_be32(crc32_be(~0, bh->b_data,
+						     journal->j_blocksize))) {
+			fc->fc_checksum = provided;
+			printk(KERN_WARNING "JBD2: Invalid fast commit block "
+			       "%lu for transaction %u on %s\n", off, tid,
+			       journal->j_devname);
+			brelse(bh);
+			break;
+		}
+		fc->fc_checksum = provided;
+
+		err = 0;
+		if (journal->j_fc_replay_callback)
+			err = journal->j_fc_replay_callback(journal, fc + 1, len);
+		brelse(bh);
+		if (err)
+			return err;
+		nr++;
+	}
+
+	jbd_debug(1, "JBD2: %d fast commit blocks for transaction %u\n",
+		  nr, tid);
+	*fc_tid = tid;
+	return found;
+}
+
 /* Scan a revoke record, marking all blocks mentioned as revoked. */
 
 static int scan_revoke_records(journal_t *journal, struct buffer_head *bh,
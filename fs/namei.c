@@ -1473,10 +1473,33 @@ static int lookup_slow(struct nameidata *nd, struct path *path)
 	return 0;
 }
 
+/*
+ * Directories that everybody may search, that have neither an ACL nor a
+ * ->permission() method, and that no LSM looks at, need no further
+ * checks during RCU walk.  That covers most of the tree on a typical
+ * system.  IOP_FASTPERM is set once inode_permission() has seen the
+ * inode without ->permission(), and i_acl is NULL only once the lack of
+ * an ACL has been cached.
+ */
+static inline bool may_lookup_fast(struct inode *inode)
+{
+	if ((inode->i_mode & S_IXUGO) != S_IXUGO)
+		return false;
+	if (unlikely(!(inode->i_opflags & IOP_FASTPERM)))
+		return false;
+	if (IS_POSIXACL(inode) && ACCESS_ONCE(inode->i_acl) != NULL)
+		return false;
+	return security_inode_permission_is_default();
+}
+
 static inline int may_lookup(struct nameidata *nd)
 {
 	if (nd->flags & LOOKUP_RCU) {
-		int err = inode_permission(nd->inode, MAY_EXEC|MAY_NOT_BLOCK);
+		int err;
+
+		if (may_lookup_fast(nd->inode))
+			return 0;
+		err = inode_permission(nd->inode, MAY_EXEC|MAY_NOT_BLOCK);
 		if (err != -ECHILD)
 			return err;
 		if (unlazy_walk(nd, NULL))
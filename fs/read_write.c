@@ -651,7 +651,8 @@ unsigned long iov_shorten(struct iovec *iov, unsigned long nr_segs, size_t to)
 EXPORT_SYMBOL(iov_shorten);
 
 static ssize_t do_iter_readv_writev(struct file *filp, int rw, const struct iovec *iov,
-		unsigned long nr_segs, size_t len, loff_t *ppos, iter_fn_t fn)
+		unsigned long nr_segs, size_t len, loff_t *ppos, iter_fn_t fn,
+		int flags)
 {
 	struct kiocb kiocb;
 	struct iov_iter iter;
@@ -660,6 +661,8 @@ static ssize_t do_iter_readv_writev(struct file *filp, int rw, const struct iove
 	init_sync_kiocb(&kiocb, filp);
 	kiocb.ki_pos = *ppos;
 	kiocb.ki_nbytes = len;
+	if (flags & RWF_HIPRI)
+		kiocb.ki_flags |= KIOCB_HIPRI;
 
 	iov_iter_init(&iter, rw, iov, nr_segs, len);
 	ret = fn(&kiocb, &iter);
@@ -670,7 +673,8 @@ static ssize_t do_iter_readv_writev(struct file *filp, int rw, const struct iove
 }
 
 static ssize_t do_sync_readv_writev(struct file *filp, const struct iovec *iov,
-		unsigned long nr_segs, size_t len, loff_t *ppos, iov_fn_t fn)
+		unsigned long nr_segs, size_t len, loff_t *ppos, iov_fn_t fn,
+		int flags)
 {
 	struct kiocb kiocb;
 	ssize_t ret;
@@ -678,6 +682,8 @@ static ssize_t do_sync_readv_writev(struct file *filp, const struct iovec *iov,
 	init_sync_kiocb(&kiocb, filp);
 	kiocb.ki_pos = *ppos;
 	kiocb.ki_nbytes = len;
+	if (flags & RWF_HIPRI)
+		kiocb.ki_flags |= KIOCB_HIPRI;
 
 	ret = fn(&kiocb, iov, nr_segs, kiocb.ki_pos);
 	if (ret == -EIOCBQUEUED)
@@ -798,7 +804,7 @@ out:
 
 static ssize_t do_readv_writev(int type, struct file *file,
 			       const struct iovec __user * uvector,
-			       unsigned long nr_segs, loff_t *pos)
+			       unsigned long nr_segs, loff_t *pos, int flags)
 {
 	size_t tot_len;
 	struct iovec iovstack[UIO_FASTIOV];
@@ -832,10 +838,10 @@ static ssize_t do_readv_writev(int type, struct file *file,
 
 	if (iter_fn)
 		ret = do_iter_readv_writev(file, type, iov, nr_segs, tot_len,
-						pos, iter_fn);
+						pos, iter_fn, flags);
 	else if (fnv)
 		ret = do_sync_readv_writev(file, iov, nr_segs, tot_len,
-						pos, fnv);
+						pos, fnv, flags);
 	else
 		ret = do_loop_readv_writev(file, iov, nr_segs, pos, fn);
 
@@ -862,7 +868,7 @@ ssize_t vfs_readv(struct file *file, const struct iovec __user *vec,
 	if (!(file->f_mode & FMODE_CAN_READ))
 		return -EINVAL;
 
-	return do_readv_writev(READ, file, vec, vlen, pos);
+	return do_readv_writev(READ, file, vec, vlen, pos, 0);
 }
 
 EXPORT_SYMBOL(vfs_readv);
@@ -875,7 +881,7 @@ ssize_t vfs_writev(struct file *file, const struct iovec __user *vec,
 	if (!(file->f_mode & FMODE_CAN_WRITE))
 		return -EINVAL;
 
-	return do_readv_writev(WRITE, file, vec, vlen, pos);
+	return do_readv_writev(WRITE, file, vec, vlen, pos, 0);
 }
 
 EXPORT_SYMBOL(vfs_writev);
@@ -974,6 +980,86 @@ SYSCALL_DEFINE5(pwritev, unsigned long, fd, const struct iovec __user *, vec,
 	return ret;
 }
 
+static ssize_t do_preadv(unsigned long fd, const struct iovec __user *vec,
+			 unsigned long vlen, loff_t pos, int flags)
+{
+	struct fd f;
+	ssize_t ret = -EBADF;
+
+	if (pos < 0)
+		return -EINVAL;
+	if (flags & ~RWF_HIPRI)
+		return -EOPNOTSUPP;
+
+	f = fdget(fd);
+	if (f.file) {
+		ret = -ESPIPE;
+		if (!(f.file->f_mode & FMODE_PREAD))
+			goto out;
+		ret = -EBADF;
+		if (!(f.file->f_mode & FMODE_READ))
+			goto out;
+		ret = -EINVAL;
+		if (!(f.file->f_mode & FMODE_CAN_READ))
+			goto out;
+		ret = do_readv_writev(READ, f.file, vec, vlen, &pos, flags);
+out:
+		fdput(f);
+	}
+
+	if (ret > 0)
+		add_rchar(current, ret);
+	inc_syscr(current);
+	return ret;
+}
+
+static ssize_t do_pwritev(unsigned long fd, const struct iovec __user *vec,
+			  unsigned long vlen, loff_t pos, int flags)
+{
+	struct fd f;
+	ssize_t ret = -EBADF;
+
+	if (pos < 0)
+		return -EINVAL;
+	if (flags & ~RWF_HIPRI)
+		return -EOPNOTSUPP;
+
+	f = fdget(fd);
+	if (f.file) {
+		ret = -ESPIPE;
+		if (!(f.file->f_mode & FMODE_PWRITE))
+			goto out;
+		ret = -EBADF;
+		if (!(f.file->f_mode & FMODE_WRITE))
+			goto out;
+		ret = -EINVAL;
+		if (!(f.file->f_mode & FMODE_CAN_WRITE))
+			goto out;
+		ret = do_readv_writev(WRITE, f.file, vec, vlen, &pos, flags);
+out:
+		fdput(f);
+	}
+
+	if (ret > 0)
+		add_wchar(current, ret);
+	inc_syscw(current);
+	return ret;
+}
+
+SYSCALL_DEFINE6(preadv2, unsigned long, fd, const struct iovec __user *, vec,
+		unsigned long, vlen, unsigned long, pos_l, unsigned long, pos_h,
+		int, flags)
+{
+	return do_preadv(fd, vec, vlen, pos_from_hilo(pos_h, pos_l), flags);
+}
+
+SYSCALL_DEFINE6(pwritev2, unsigned long, fd, const struct iovec __user *, vec,
+		unsigned long, vlen, unsigned long, pos_l, unsigned long, pos_h,
+		int, flags)
+{
+	return do_pwritev(fd, vec, vlen, pos_from_hilo(pos_h, pos_l), flags);
+}
+
 #ifdef CONFIG_COMPAT
 
 static ssize_t compat_do_readv_writev(int type, struct file *file,
@@ -1012,10 +1098,10 @@ static ssize_t compat_do_readv_writev(int type, struct file *file,
 
 	if (iter_fn)
 		ret = do_iter_readv_writev(file, type, iov, nr_segs, tot_len,
-						pos, iter_fn);
+						pos, iter_fn, 0);
 	else if (fnv)
 		ret = do_sync_readv_writev(file, iov, nr_segs, tot_len,
-						pos, fnv);
+						pos, fnv, 0);
 	else
 		ret = do_loop_readv_writev(file, iov, nr_segs, pos, fn);
 
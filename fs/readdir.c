@@ -15,9 +15,12 @@
 #include <linux/fs.h>
 #include <linux/fsnotify.h>
 #include <linux/dirent.h>
+#include <linux/dirent_stat.h>
 #include <linux/security.h>
 #include <linux/syscalls.h>
 #include <linux/unistd.h>
+#include <linux/namei.h>
+#include <linux/slab.h>
 
 #include <asm/uaccess.h>
 
@@ -304,3 +307,159 @@ SYSCALL_DEFINE3(getdents64, unsigned int, fd,
 	fdput(f);
 	return error;
 }
+
+/*
+ * getdents_stat() collects the entries into a kernel buffer first and only
+ * looks them up once iterate_dir() has returned, so that neither the
+ * directory's i_mutex nor whatever ->iterate() holds while calling the
+ * actor nests around ->lookup() or ->getattr().
+ */
+#define GETDENTS_STAT_BUF_MAX	(32 * 1024)
+
+struct getdents_stat_callback {
+	struct dir_context ctx;
+	void *buf;
+	struct linux_dirent_stat *previous;
+	unsigned int used;
+	unsigned int size;
+	int error;
+};
+
+static int filldir_stat(void *__buf, const char *name, int namlen,
+			loff_t offset, u64 ino, unsigned int d_type)
+{
+	struct getdents_stat_callback *buf = __buf;
+	struct linux_dirent_stat *dirent;
+	int reclen = ALIGN(offsetof(struct linux_dirent_stat, d_name) +
+			   namlen + 1, sizeof(u64));
+
+	buf->error = -EINVAL;	/* only used if we fail.. */
+	if (reclen > buf->size - buf->used)
+		return -EINVAL;
+	if (buf->previous)
+		buf->previous->d_off = offset;
+	dirent = buf->buf + buf->used;
+	memset(dirent, 0, offsetof(struct linux_dirent_stat, d_name));
+	dirent->d_ino = ino;
+	dirent->d_reclen = reclen;
+	dirent->d_type = d_type;
+	memcpy(dirent->d_name, name, namlen);
+	dirent->d_name[namlen] = 0;
+	buf->previous = dirent;
+	buf->used += reclen;
+	return 0;
+}
+
+static struct dentry *getdents_stat_lookup(struct dentry *dir,
+					   const char *name, int len,
+					   unsigned int flags)
+{
+	struct qstr this = QSTR_INIT(name, len);
+	struct dentry *dentry;
+
+	if (name[0] == '.' && (len == 1 || (len == 2 && name[1] == '.')))
+		return NULL;
+
+	dentry = d_hash_and_lookup(dir, &this);
+	if (dentry || (flags & GETDENTS_STAT_CACHED))
+		return dentry;
+
+	mutex_lock(&dir->d_inode->i_mutex);
+	dentry = lookup_one_len(name, dir, len);
+	mutex_unlock(&dir->d_inode->i_mutex);
+	return dentry;
+}
+
+static void getdents_stat_fill(struct path *dir,
+			       struct linux_dirent_stat *dirent,
+			       unsigned int flags)
+{
+	struct user_namespace *ns = current_user_ns();
+	struct path path = { .mnt = dir->mnt };
+	struct kstat stat;
+	int err;
+
+	path.dentry = getdents_stat_lookup(dir->dentry, dirent->d_name,
+				strlen(dirent->d_name), flags);
+	if (IS_ERR_OR_NULL(path.dentry))
+		return;
+
+	err = -ENOENT;
+	if (path.dentry->d_inode)
+		err = vfs_getattr(&path, &stat);
+	dput(path.dentry);
+	if (err)
+		return;
+
+	dirent->st_mode = stat.mode;
+	dirent->st_nlink = stat.nlink;
+	dirent->st_uid = from_kuid_munged(ns, stat.uid);
+	dirent->st_gid = from_kgid_munged(ns, stat.gid);
+	dirent->st_blksize = stat.blksize;
+	dirent->st_rdev = huge_encode_dev(stat.rdev);
+	dirent->st_size = stat.size;
+	dirent->st_blocks = stat.blocks;
+	dirent->st_atime_sec = stat.atime.tv_sec;
+	dirent->st_atime_nsec = stat.atime.tv_nsec;
+	dirent->st_mtime_sec = stat.mtime.tv_sec;
+	dirent->st_mtime_nsec = stat.mtime.tv_nsec;
+	dirent->st_ctime_sec = stat.ctime.tv_sec;
+	dirent->st_ctime_nsec = stat.ctime.tv_nsec;
+	dirent->d_stat_valid = 1;
+}
+
+SYSCALL_DEFINE4(getdents_stat, unsigned int, fd,
+		struct linux_dirent_stat __user *, dirent, unsigned int, count,
+		unsigned int, flags)
+{
+	struct fd f;
+	struct getdents_stat_callback buf = {
+		.ctx.actor = filldir_stat,
+		.size = min_t(unsigned int, count, GETDENTS_STAT_BUF_MAX),
+	};
+	unsigned int pos;
+	int error;
+
+	if (flags & ~GETDENTS_STAT_CACHED)
+		return -EINVAL;
+
+	if (!access_ok(VERIFY_WRITE, dirent, count))
+		return -EFAULT;
+
+	f = fdget(fd);
+	if (!f.file)
+		return -EBADF;
+
+	error = -ENOMEM;
+	buf.buf = kmalloc(buf.size, GFP_KERNEL);
+	if (!buf.buf)
+		goto out;
+
+	error = iterate_dir(f.file, &buf.ctx);
+	if (error >= 0)
+		error = buf.error;
+	if (buf.previous) {
+		buf.previous->d_off = buf.ctx.pos;
+
+		/* As for lstat(), looking at the entries needs search
+		 * permission on the directory.
+		 */
+		if (!inode_permission(file_inode(f.file), MAY_EXEC)) {
+			for (pos = 0; pos < buf.used;) {
+				struct linux_dirent_stat *d = buf.buf + pos;
+
+				getdents_stat_fill(&f.file->f_path, d, flags);
+				pos += d->d_reclen;
+			}
+		}
+
+		if (copy_to_user(dirent, buf.buf, buf.used))
+			error = -EFAULT;
+		else
+			error = buf.used;
+	}
+	kfree(buf.buf);
+out:
+	fdput(f);
+	return error;
+}
@@ -1584,6 +1584,13 @@ out:
  * vmsplice splices a user address range into a pipe. It can be thought of
  * as splice-from-memory, where the regular splice is splice-from-file (or
  * to file). In both cases the output is a pipe, naturally.
+ *
+ * The user pages themselves go into the pipe, and splicing the pipe to a
+ * socket whose ->sendpage() takes page references (TCP on a device that
+ * can do scatter-gather) sends them without a copy. The references are
+ * dropped only once the data has left the socket, so memory vmspliced
+ * with SPLICE_F_GIFT may be unmapped right away, while the application
+ * must not write to it again unless it knows the data has been sent.
  */
 static long vmsplice_to_pipe(struct file *file, const struct iovec __user *iov,
 			     unsigned long nr_segs, unsigned int flags)
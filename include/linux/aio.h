@@ -27,6 +27,10 @@ struct kiocb;
  */
 #define KIOCB_CANCELLED		((void *) (~0ULL))
 
+/* ki_flags */
+#define KIOCB_HIPRI		(1 << 0)	/* poll for completion (RWF_HIPRI) */
+#define KIOCB_NOWAIT		(1 << 1)	/* don't wait for page cache misses */
+
 typedef int (kiocb_cancel_fn)(struct kiocb *);
 
 struct kiocb {
@@ -43,6 +47,7 @@ struct kiocb {
 	__u64			ki_user_data;	/* user's data for completion */
 	loff_t			ki_pos;
 	size_t			ki_nbytes;	/* copy of iocb->aio_nbytes */
+	unsigned int		ki_flags;	/* KIOCB_* */
 
 	struct list_head	ki_list;	/* the aio core uses this
 						 * for cancellation */
@@ -94,6 +94,8 @@ struct backing_dev_info {
 	unsigned int min_ratio;
 	unsigned int max_ratio, max_prop_frac;
 
+	unsigned int writeback_workers;	/* parallel writers per large inode */
+
 	struct bdi_writeback wb;  /* default writeback info for this bdi */
 	spinlock_t wb_lock;	  /* protects work_list & wb.dwork scheduling */
 
@@ -109,6 +111,9 @@ struct backing_dev_info {
 #endif
 };
 
+/* Upper bound for backing_dev_info->writeback_workers */
+#define BDI_MAX_WRITEBACK_WORKERS	8
+
 int __must_check bdi_init(struct backing_dev_info *bdi);
 void bdi_destroy(struct backing_dev_info *bdi);
 
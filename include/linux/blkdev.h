@@ -35,6 +35,7 @@ struct request;
 struct sg_io_hdr;
 struct bsg_job;
 struct blkcg_gq;
+struct rq_wb;
 
 #define BLKDEV_MIN_RQ	4
 #define BLKDEV_MAX_RQ	128	/* Default maximum */
@@ -43,7 +44,7 @@ struct blkcg_gq;
  * Maximum number of blkcg policies allowed to be registered concurrently.
  * Defined here to simplify include dependency.
  */
-#define BLKCG_MAX_POLS		2
+#define BLKCG_MAX_POLS		3
 
 struct request;
 typedef void (rq_end_io_fn)(struct request *, int);
@@ -167,6 +168,17 @@ struct request {
 	unsigned long long start_time_ns;
 	unsigned long long io_start_time_ns;    /* when passed to hardware */
 #endif
+#ifdef CONFIG_BLK_WBT
+	u64 wbt_issue_ns;			/* read issue time, see blk-wbt.c */
+#endif
+#ifdef CONFIG_BLK_CGROUP_IOLATENCY
+	struct blkcg_gq *iolat_blkg;		/* see blk-iolatency.c */
+	u64 iolat_issue_ns;
+#endif
+	/* for the latency histogram, see blk_account_io_done() */
+	u64 acct_start_ns;
+	unsigned int acct_bytes;
+	u64 poll_start_ns;			/* see blk_mq_poll_stat() */
 	/* Number of scatter-gather DMA addr+len pairs after
 	 * physical address coalescing is performed.
 	 */
@@ -233,6 +245,7 @@ struct blk_queue_ctx;
 
 typedef void (request_fn_proc) (struct request_queue *q);
 typedef void (make_request_fn) (struct request_queue *q, struct bio *bio);
+typedef int (poll_q_fn) (struct request_queue *q);
 typedef int (prep_rq_fn) (struct request_queue *, struct request *);
 typedef void (unprep_rq_fn) (struct request_queue *, struct request *);
 
@@ -303,6 +316,20 @@ struct queue_limits {
 	unsigned char		raid_partial_stripes_expensive;
 };
 
+/*
+ * Completion latency histogram, per cpu.  Requests are split by direction
+ * and size, latency buckets are log2 of the microseconds the request took
+ * from being queued until it completed.
+ */
+#define BLK_LAT_HIST_DIRS	3	/* read, write, discard */
+#define BLK_LAT_HIST_SIZES	4	/* <= 4k, 16k, 64k, larger */
+#define BLK_LAT_HIST_BUCKETS	20
+
+struct blk_lat_hist {
+	unsigned long	count[BLK_LAT_HIST_DIRS][BLK_LAT_HIST_SIZES]
+			     [BLK_LAT_HIST_BUCKETS];
+};
+
 struct request_queue {
 	/*
 	 * Together with queue_head for cacheline sharing
@@ -323,6 +350,7 @@ struct request_queue {
 
 	request_fn_proc		*request_fn;
 	make_request_fn		*make_request_fn;
+	poll_q_fn		*poll_fn;
 	prep_rq_fn		*prep_rq_fn;
 	unprep_rq_fn		*unprep_rq_fn;
 	merge_bvec_fn		*merge_bvec_fn;
@@ -481,6 +509,16 @@ struct request_queue {
 	/* Throttle data */
 	struct throtl_data *td;
 #endif
+#ifdef CONFIG_BLK_WBT
+	/* Writeback throttling */
+	struct rq_wb		*rq_wb;
+#endif
+	struct blk_lat_hist __percpu *lat_hist;
+
+	/* hybrid polling, see blk_poll() */
+	int			poll_nsec;	/* -1 off, 0 adaptive */
+	unsigned long		poll_mean_nsec;
+
 	struct rcu_head		rcu_head;
 	wait_queue_head_t	mq_freeze_wq;
 	struct percpu_counter	mq_usage_counter;
@@ -513,6 +551,7 @@ struct request_queue {
 #define QUEUE_FLAG_INIT_DONE   20	/* queue is initialized */
 #define QUEUE_FLAG_NO_SG_MERGE 21	/* don't attempt to merge SG segments*/
 #define QUEUE_FLAG_SG_GAPS     22	/* queue doesn't support SG gaps */
+#define QUEUE_FLAG_POLL	       23	/* IO polling enabled if set */
 
 #define QUEUE_FLAG_DEFAULT	((1 << QUEUE_FLAG_IO_STAT) |		\
 				 (1 << QUEUE_FLAG_STACKABLE)	|	\
@@ -520,6 +559,7 @@ struct request_queue {
 				 (1 << QUEUE_FLAG_ADD_RANDOM))
 
 #define QUEUE_FLAG_MQ_DEFAULT	((1 << QUEUE_FLAG_IO_STAT) |		\
+				 (1 << QUEUE_FLAG_STACKABLE)	|	\
 				 (1 << QUEUE_FLAG_SAME_COMP))
 
 static inline void queue_lockdep_assert_held(struct request_queue *q)
@@ -593,6 +633,7 @@ static inline void queue_flag_clear(unsigned int flag, struct request_queue *q)
 #define blk_queue_noxmerges(q)	\
 	test_bit(QUEUE_FLAG_NOXMERGES, &(q)->queue_flags)
 #define blk_queue_nonrot(q)	test_bit(QUEUE_FLAG_NONROT, &(q)->queue_flags)
+#define blk_queue_poll(q)	test_bit(QUEUE_FLAG_POLL, &(q)->queue_flags)
 #define blk_queue_io_stat(q)	test_bit(QUEUE_FLAG_IO_STAT, &(q)->queue_flags)
 #define blk_queue_add_random(q)	test_bit(QUEUE_FLAG_ADD_RANDOM, &(q)->queue_flags)
 #define blk_queue_stackable(q)	\
@@ -1001,6 +1042,8 @@ extern struct request_queue *blk_init_allocated_queue(struct request_queue *,
 						      request_fn_proc *, spinlock_t *);
 extern void blk_cleanup_queue(struct request_queue *);
 extern void blk_queue_make_request(struct request_queue *, make_request_fn *);
+extern void blk_queue_poll_fn(struct request_queue *, poll_q_fn *);
+extern bool blk_poll(struct request_queue *q, bool may_sleep);
 extern void blk_queue_bounce_limit(struct request_queue *, u64);
 extern void blk_limits_max_hw_sectors(struct queue_limits *, unsigned int);
 extern void blk_queue_max_hw_sectors(struct request_queue *, unsigned int);
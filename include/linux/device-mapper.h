@@ -49,6 +49,18 @@ typedef int (*dm_map_fn) (struct dm_target *ti, struct bio *bio);
 typedef int (*dm_map_request_fn) (struct dm_target *ti, struct request *clone,
 				  union map_info *map_context);
 
+/*
+ * Used instead of map_rq when the underlying devices are blk-mq: the
+ * target allocates the clone from the queue of the path it picked and
+ * returns it in @clone.  Called in atomic context, the usual map return
+ * values apply and *@clone is only looked at for DM_MAPIO_REMAPPED.
+ */
+typedef int (*dm_clone_and_map_request_fn) (struct dm_target *ti,
+					    struct request *rq,
+					    union map_info *map_context,
+					    struct request **clone);
+typedef void (*dm_release_clone_request_fn) (struct request *clone);
+
 /*
  * Returns:
  * < 0 : error (currently ignored)
@@ -142,6 +154,8 @@ struct target_type {
 	dm_dtr_fn dtr;
 	dm_map_fn map;
 	dm_map_request_fn map_rq;
+	dm_clone_and_map_request_fn clone_and_map_rq;
+	dm_release_clone_request_fn release_clone_rq;
 	dm_endio_fn end_io;
 	dm_request_endio_fn rq_end_io;
 	dm_presuspend_fn presuspend;
@@ -133,6 +133,7 @@ static inline int enable_drhd_fault_handling(void)
 
 struct irte {
 	union {
+		/* remapped format */
 		struct {
 			__u64	present 	: 1,
 				fpd		: 1,
@@ -141,11 +142,25 @@ struct irte {
 				trigger_mode	: 1,
 				dlvry_mode	: 3,
 				avail		: 4,
-				__reserved_1	: 4,
+				__reserved_1	: 3,
+				pst		: 1,
 				vector		: 8,
 				__reserved_2	: 8,
 				dest_id		: 32;
 		};
+		/* posted format, pst set */
+		struct {
+			__u64	p_present	: 1,
+				p_fpd		: 1,
+				__p_reserved_1	: 6,
+				p_avail		: 4,
+				__p_reserved_2	: 2,
+				p_urgent	: 1,
+				p_pst		: 1,
+				p_vector	: 8,
+				__p_reserved_3	: 14,
+				pda_l		: 26;
+		};
 		__u64 low;
 	};
 
@@ -154,7 +169,8 @@ struct irte {
 			__u64	sid		: 16,
 				sq		: 2,
 				svt		: 2,
-				__reserved_3	: 44;
+				__reserved_3	: 12,
+				pda_h		: 32;
 		};
 		__u64 high;
 	};
@@ -8,6 +8,7 @@
 
 struct io_cq;
 struct elevator_type;
+struct blk_mq_hw_ctx;
 
 typedef int (elevator_merge_fn) (struct request_queue *, struct request **,
 				 struct bio *);
@@ -40,6 +41,13 @@ typedef int (elevator_init_fn) (struct request_queue *,
 				struct elevator_type *e);
 typedef void (elevator_exit_fn) (struct elevator_queue *);
 
+typedef void (elevator_mq_insert_fn) (struct elevator_queue *,
+				      struct blk_mq_hw_ctx *, struct list_head *);
+typedef struct request *(elevator_mq_dispatch_fn) (struct elevator_queue *,
+						   struct blk_mq_hw_ctx *);
+typedef bool (elevator_mq_has_work_fn) (struct elevator_queue *,
+					struct blk_mq_hw_ctx *);
+
 struct elevator_ops
 {
 	elevator_merge_fn *elevator_merge_fn;
@@ -70,6 +78,22 @@ struct elevator_ops
 	elevator_exit_fn *elevator_exit_fn;
 };
 
+/*
+ * Schedulers for blk-mq queues.  Requests are handed over from the software
+ * queues when a hardware queue is run, and pulled back one at a time for as
+ * long as the driver accepts them.  The hooks are called without any block
+ * layer lock held, possibly concurrently for the same hardware queue.
+ */
+struct elevator_mq_ops
+{
+	elevator_init_fn *init_sched;
+	elevator_exit_fn *exit_sched;
+
+	elevator_mq_insert_fn *insert_requests;
+	elevator_mq_dispatch_fn *dispatch_request;
+	elevator_mq_has_work_fn *has_work;
+};
+
 #define ELV_NAME_MAX	(16)
 
 struct elv_fs_entry {
@@ -88,6 +112,8 @@ struct elevator_type
 
 	/* fields provided by elevator implementation */
 	struct elevator_ops ops;
+	struct elevator_mq_ops mq_ops;
+	bool uses_mq;		/* only valid for blk-mq queues */
 	size_t icq_size;	/* see iocontext.h */
 	size_t icq_align;	/* ditto */
 	struct elv_fs_entry *elevator_attrs;
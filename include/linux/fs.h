@@ -744,6 +744,18 @@ struct fown_struct {
 /*
  * Track a single file's readahead state
  */
+/*
+ * Readahead windows of other sequential streams on the same file, parked
+ * while the current window (start/size/async_size) serves another one.
+ */
+#define RA_STREAMS	3
+
+struct ra_stream {
+	pgoff_t start;
+	unsigned int size;
+	unsigned int async_size;
+};
+
 struct file_ra_state {
 	pgoff_t start;			/* where readahead started */
 	unsigned int size;		/* # of readahead pages */
@@ -753,6 +765,10 @@ struct file_ra_state {
 	unsigned int ra_pages;		/* Maximum readahead window */
 	unsigned int mmap_miss;		/* Cache miss stat for mmap accesses */
 	loff_t prev_pos;		/* Cache last read() position */
+
+	struct ra_stream streams[RA_STREAMS];	/* most recent first */
+	pgoff_t stride_prev;		/* last strided/random miss */
+	long stride;			/* distance to the miss before it */
 };
 
 /*
@@ -779,9 +795,15 @@ struct file {
 	 * Must not be taken from IRQ context.
 	 */
 	spinlock_t		f_lock;
-	atomic_long_t		f_count;
 	unsigned int 		f_flags;
 	fmode_t			f_mode;
+
+	/*
+	 * The fields above are read on every system call on the file. The
+	 * reference count and file position are written on every fget() and
+	 * read() when threads share the fd, so keep them out of that line.
+	 */
+	atomic_long_t		f_count ____cacheline_aligned_in_smp;
 	struct mutex		f_pos_lock;
 	loff_t			f_pos;
 	struct fown_struct	f_owner;
@@ -13,6 +13,8 @@ struct trace_array;
 struct trace_buffer;
 struct tracer;
 struct dentry;
+struct sk_filter;
+struct sock_filter_int;
 
 struct trace_print_flags {
 	unsigned long		mask;
@@ -293,6 +295,9 @@ struct ftrace_event_call {
 	int	(*perf_perm)(struct ftrace_event_call *,
 			     struct perf_event *);
 #endif
+#ifdef CONFIG_BPF_EVENTS
+	struct sk_filter __rcu		*prog;
+#endif
 };
 
 static inline const char *
@@ -402,6 +407,7 @@ enum event_trigger_type {
 	ETT_SNAPSHOT		= (1 << 1),
 	ETT_STACKTRACE		= (1 << 2),
 	ETT_EVENT_ENABLE	= (1 << 3),
+	ETT_EVENT_HIST		= (1 << 4),
 };
 
 extern void destroy_preds(struct ftrace_event_file *file);
@@ -419,6 +425,35 @@ extern enum event_trigger_type event_triggers_call(struct ftrace_event_file *fil
 extern void event_triggers_post_call(struct ftrace_event_file *file,
 				     enum event_trigger_type tt);
 
+#ifdef CONFIG_BPF_EVENTS
+extern unsigned int trace_call_bpf(struct ftrace_event_call *call, void *rec);
+extern int trace_event_attach_bpf(struct ftrace_event_call *call,
+				  struct sk_filter *prog);
+extern struct sk_filter *trace_event_detach_bpf(struct ftrace_event_call *call);
+extern struct sk_filter *trace_bpf_prog_alloc(const struct sock_filter_int *insns,
+					      unsigned int len);
+extern void trace_bpf_prog_free(struct sk_filter *prog);
+
+/*
+ * Run the BPF program attached to @call, if any, on the event record
+ * @rec. Returns 0 if the program asked for the event to be dropped.
+ */
+static inline unsigned int
+trace_event_call_bpf(struct ftrace_event_call *call, void *rec)
+{
+	if (likely(!rcu_access_pointer(call->prog)))
+		return 1;
+
+	return trace_call_bpf(call, rec);
+}
+#else
+static inline unsigned int
+trace_event_call_bpf(struct ftrace_event_call *call, void *rec)
+{
+	return 1;
+}
+#endif
+
 /**
  * ftrace_trigger_soft_disabled - do triggers and test if soft disabled
  * @file: The file pointer of the event to test
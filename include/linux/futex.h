@@ -55,6 +55,9 @@ union futex_key {
 #ifdef CONFIG_FUTEX
 extern void exit_robust_list(struct task_struct *curr);
 extern void exit_pi_state_list(struct task_struct *curr);
+extern int futex_set_private_hash(unsigned long slots);
+extern int futex_get_private_hash(void);
+extern void futex_free_private_hash(struct mm_struct *mm);
 #ifdef CONFIG_HAVE_FUTEX_CMPXCHG
 #define futex_cmpxchg_enabled 1
 #else
@@ -67,5 +70,16 @@ static inline void exit_robust_list(struct task_struct *curr)
 static inline void exit_pi_state_list(struct task_struct *curr)
 {
 }
+static inline int futex_set_private_hash(unsigned long slots)
+{
+	return -EINVAL;
+}
+static inline int futex_get_private_hash(void)
+{
+	return -EINVAL;
+}
+static inline void futex_free_private_hash(struct mm_struct *mm)
+{
+}
 #endif
 #endif
@@ -173,6 +173,8 @@ struct irq_data {
  * IRQD_IRQ_DISABLED		- Disabled state of the interrupt
  * IRQD_IRQ_MASKED		- Masked state of the interrupt
  * IRQD_IRQ_INPROGRESS		- In progress state of the interrupt
+ * IRQD_AFFINITY_MANAGED	- Affinity is managed by the kernel and
+ *				  cannot be changed from user space
  */
 enum {
 	IRQD_TRIGGER_MASK		= 0xf,
@@ -186,6 +188,7 @@ enum {
 	IRQD_IRQ_DISABLED		= (1 << 16),
 	IRQD_IRQ_MASKED			= (1 << 17),
 	IRQD_IRQ_INPROGRESS		= (1 << 18),
+	IRQD_AFFINITY_MANAGED		= (1 << 19),
 };
 
 static inline bool irqd_is_setaffinity_pending(struct irq_data *d)
@@ -213,6 +216,11 @@ static inline void irqd_mark_affinity_was_set(struct irq_data *d)
 	d->state_use_accessors |= IRQD_AFFINITY_SET;
 }
 
+static inline bool irqd_affinity_is_managed(struct irq_data *d)
+{
+	return d->state_use_accessors & IRQD_AFFINITY_MANAGED;
+}
+
 static inline u32 irqd_get_trigger_type(struct irq_data *d)
 {
 	return d->state_use_accessors & IRQD_TRIGGER_MASK;
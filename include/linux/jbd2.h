@@ -48,6 +48,11 @@
  */
 #define JBD2_DEFAULT_MAX_COMMIT_AGE 5
 
+/*
+ * The default number of blocks reserved for fast commits.
+ */
+#define JBD2_DEFAULT_FAST_COMMIT_BLOCKS 256
+
 #ifdef CONFIG_JBD2_DEBUG
 /*
  * Define JBD2_EXPENSIVE_CHECKING to enable more expensive internal
@@ -125,6 +130,7 @@ typedef struct journal_s	journal_t;	/* Journal control structure */
 #define JBD2_SUPERBLOCK_V1	3
 #define JBD2_SUPERBLOCK_V2	4
 #define JBD2_REVOKE_BLOCK	5
+#define JBD2_FC_BLOCK		6
 
 /*
  * Standard header for all descriptor blocks:
@@ -210,6 +216,20 @@ struct jbd2_journal_revoke_tail {
 	__be32		r_checksum;	/* crc32c(uuid+revoke_block) */
 };
 
+/*
+ * Fast commit block: a single record written outside of the circular log,
+ * in the area reserved at its end when FEATURE_INCOMPAT_FAST_COMMIT is set.
+ * fc_header.h_sequence is the running transaction the record belongs to;
+ * records are only replayed if that transaction never committed.  The
+ * checksum is crc32_be over the whole block with fc_checksum zeroed.
+ */
+typedef struct jbd2_fc_header_s
+{
+	journal_header_t fc_header;
+	__be32		 fc_len;	/* Bytes of payload following the header */
+	__be32		 fc_checksum;
+} jbd2_fc_header_t;
+
 /* Definitions for the journal tag flags word: */
 #define JBD2_FLAG_ESCAPE		1	/* on-disk block is escaped */
 #define JBD2_FLAG_SAME_UUID	2	/* block has same uuid as previous */
@@ -260,7 +280,8 @@ typedef struct journal_superblock_s
 /* 0x0050 */
 	__u8	s_checksum_type;	/* checksum type */
 	__u8	s_padding2[3];
-	__u32	s_padding[42];
+	__be32	s_num_fc_blks;		/* Nr of blocks kept for fast commits */
+	__u32	s_padding[41];
 	__be32	s_checksum;		/* crc32c(superblock) */
 
 /* 0x0100 */
@@ -284,6 +305,7 @@ typedef struct journal_superblock_s
 #define JBD2_FEATURE_INCOMPAT_64BIT		0x00000002
 #define JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT	0x00000004
 #define JBD2_FEATURE_INCOMPAT_CSUM_V2		0x00000008
+#define JBD2_FEATURE_INCOMPAT_FAST_COMMIT	0x00000020
 
 /* Features known to this kernel version: */
 #define JBD2_KNOWN_COMPAT_FEATURES	JBD2_FEATURE_COMPAT_CHECKSUM
@@ -291,7 +313,8 @@ typedef struct journal_superblock_s
 #define JBD2_KNOWN_INCOMPAT_FEATURES	(JBD2_FEATURE_INCOMPAT_REVOKE | \
 					JBD2_FEATURE_INCOMPAT_64BIT | \
 					JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT | \
-					JBD2_FEATURE_INCOMPAT_CSUM_V2)
+					JBD2_FEATURE_INCOMPAT_CSUM_V2 | \
+					JBD2_FEATURE_INCOMPAT_FAST_COMMIT)
 
 #ifdef __KERNEL__
 
@@ -740,6 +763,12 @@ jbd2_time_diff(unsigned long start, unsigned long end)
  * @j_proc_entry: procfs entry for the jbd statistics directory
  * @j_stats: Overall statistics
  * @j_private: An opaque pointer to fs-private information.
+ * @j_fc_first: first block of the fast commit area
+ * @j_fc_last: one beyond the last block of the fast commit area
+ * @j_fc_off: number of fast commit blocks written for @j_fc_tid
+ * @j_fc_tid: transaction the fast commit area currently belongs to
+ * @j_fc_wait: wait queue for JBD2_FAST_COMMIT_ONGOING to clear
+ * @j_fc_replay_callback: called by recovery for each valid fast commit
  */
 
 struct journal_s
@@ -982,6 +1011,20 @@ struct journal_s
 
 	/* Precomputed journal UUID checksum for seeding other checksums */
 	__u32 j_csum_seed;
+
+	/*
+	 * Fast commit area, carved from the end of the journal and not part
+	 * of the circular log.  [j_state_lock]
+	 */
+	unsigned long		j_fc_first;
+	unsigned long		j_fc_last;
+	unsigned long		j_fc_off;
+	tid_t			j_fc_tid;
+	wait_queue_head_t	j_fc_wait;
+
+	/* Replays the payload of one fast commit block during recovery */
+	int			(*j_fc_replay_callback)(journal_t *, void *,
+							int);
 };
 
 /*
@@ -996,6 +1039,8 @@ struct journal_s
 #define JBD2_ABORT_ON_SYNCDATA_ERR	0x040	/* Abort the journal on file
 						 * data write error in ordered
 						 * mode */
+#define JBD2_FAST_COMMIT_ONGOING	0x080	/* A fast commit block is being
+						 * written */
 
 /*
  * Function declarations for the journaling transaction and buffer
@@ -1140,6 +1185,7 @@ extern int	   jbd2_journal_set_features
 		   (journal_t *, unsigned long, unsigned long, unsigned long);
 extern void	   jbd2_journal_clear_features
 		   (journal_t *, unsigned long, unsigned long, unsigned long);
+extern int	   jbd2_journal_init_fc    (journal_t *, unsigned int);
 extern int	   jbd2_journal_load       (journal_t *journal);
 extern int	   jbd2_journal_destroy    (journal_t *);
 extern int	   jbd2_journal_recover    (journal_t *journal);
@@ -1233,6 +1279,8 @@ int __jbd2_log_start_commit(journal_t *journal, tid_t tid);
 int jbd2_journal_start_commit(journal_t *journal, tid_t *tid);
 int jbd2_log_wait_commit(journal_t *journal, tid_t tid);
 int jbd2_complete_transaction(journal_t *journal, tid_t tid);
+int jbd2_fc_commit_block(journal_t *journal, tid_t tid, const void *buf,
+			 int len);
 int jbd2_log_do_checkpoint(journal_t *journal);
 int jbd2_trans_will_send_data_barrier(journal_t *journal, tid_t tid);
 
@@ -0,0 +1,73 @@
+#ifndef KVM_DIRTY_RING_H
+#define KVM_DIRTY_RING_H
+
+#include <linux/kvm.h>
+#include <linux/kvm_types.h>
+
+/*
+ * Entries kept free for what a vcpu dirties between noticing the ring
+ * is soft full and actually exiting to userspace.
+ */
+#define KVM_DIRTY_RING_RSVD_ENTRIES	64
+#define KVM_DIRTY_RING_MAX_ENTRIES	65536
+
+struct kvm;
+struct kvm_memory_slot;
+
+/*
+ * Per vcpu ring of dirtied gfns.  Only the vcpu itself pushes entries
+ * and only KVM_RESET_DIRTY_RINGS, under slots_lock, moves reset_index.
+ */
+struct kvm_dirty_ring {
+	u32 dirty_index;
+	u32 reset_index;
+	u32 size;		/* in entries, 0 if there is no ring */
+	u32 soft_limit;
+	struct kvm_dirty_gfn *dirty_gfns;
+};
+
+#ifdef CONFIG_HAVE_KVM_DIRTY_RING
+
+int kvm_dirty_ring_alloc(struct kvm_dirty_ring *ring, u32 size);
+void kvm_dirty_ring_free(struct kvm_dirty_ring *ring);
+bool kvm_dirty_ring_push(struct kvm_dirty_ring *ring, u32 slot, u64 offset);
+int kvm_dirty_ring_reset(struct kvm *kvm, struct kvm_dirty_ring *ring);
+struct page *kvm_dirty_ring_get_page(struct kvm_dirty_ring *ring, u32 offset);
+
+static inline u32 kvm_dirty_ring_used(struct kvm_dirty_ring *ring)
+{
+	return ring->dirty_index - ring->reset_index;
+}
+
+static inline bool kvm_dirty_ring_soft_full(struct kvm_dirty_ring *ring)
+{
+	return ring->size && kvm_dirty_ring_used(ring) >= ring->soft_limit;
+}
+
+void kvm_arch_mmu_enable_log_dirty_pt_masked(struct kvm *kvm,
+					     struct kvm_memory_slot *slot,
+					     gfn_t gfn_offset,
+					     unsigned long mask);
+
+#else
+
+static inline int kvm_dirty_ring_alloc(struct kvm_dirty_ring *ring, u32 size)
+{
+	return 0;
+}
+static inline void kvm_dirty_ring_free(struct kvm_dirty_ring *ring)
+{
+}
+static inline bool kvm_dirty_ring_push(struct kvm_dirty_ring *ring,
+				       u32 slot, u64 offset)
+{
+	return false;
+}
+static inline bool kvm_dirty_ring_soft_full(struct kvm_dirty_ring *ring)
+{
+	return false;
+}
+
+#endif /* CONFIG_HAVE_KVM_DIRTY_RING */
+
+#endif
@@ -30,6 +30,7 @@
 #include <linux/kvm_para.h>
 
 #include <linux/kvm_types.h>
+#include <linux/kvm_dirty_ring.h>
 
 #include <asm/kvm_host.h>
 
@@ -37,6 +38,10 @@
 #define KVM_MMIO_SIZE 8
 #endif
 
+#ifndef KVM_HALT_POLL_NS_DEFAULT
+#define KVM_HALT_POLL_NS_DEFAULT 0
+#endif
+
 /*
  * The bit 16 ~ bit 31 of kvm_memory_region::flags are internally used
  * in kvm, other bits are visible for userspace which are defined in
@@ -136,6 +141,7 @@ static inline bool is_error_page(struct page *page)
 #define KVM_REQ_GLOBAL_CLOCK_UPDATE 22
 #define KVM_REQ_ENABLE_IBS        23
 #define KVM_REQ_DISABLE_IBS       24
+#define KVM_REQ_DIRTY_RING_FULL   25
 
 #define KVM_USERSPACE_IRQ_SOURCE_ID		0
 #define KVM_IRQFD_RESAMPLE_IRQ_SOURCE_ID	1
@@ -239,6 +245,8 @@ struct kvm_vcpu {
 	int sigset_active;
 	sigset_t sigset;
 	struct kvm_vcpu_stat stat;
+	unsigned int halt_poll_ns;
+	struct kvm_dirty_ring dirty_ring;
 
 #ifdef CONFIG_HAS_IOMEM
 	int mmio_needed;
@@ -365,7 +373,11 @@ struct kvm_memslots {
 };
 
 struct kvm {
+#ifdef KVM_HAVE_MMU_RWLOCK
+	rwlock_t mmu_lock;
+#else
 	spinlock_t mmu_lock;
+#endif
 	struct mutex slots_lock;
 	struct mm_struct *mm; /* userspace tied to this vm */
 	struct kvm_memslots *memslots;
@@ -397,6 +409,7 @@ struct kvm {
 	spinlock_t ring_lock;
 	struct list_head coalesced_zones;
 #endif
+	u32 dirty_ring_size;		/* bytes per vcpu ring, 0 if none */
 
 	struct mutex irq_lock;
 #ifdef CONFIG_HAVE_KVM_IRQCHIP
@@ -690,6 +703,18 @@ static inline bool kvm_arch_has_noncoherent_dma(struct kvm *kvm)
 }
 #endif
 
+#ifdef __KVM_HAVE_ARCH_POSTED_IRQ
+int kvm_arch_update_pi_irte(struct kvm *kvm, unsigned int host_irq,
+			    u32 guest_irq, bool set);
+#else
+static inline int kvm_arch_update_pi_irte(struct kvm *kvm,
+					  unsigned int host_irq,
+					  u32 guest_irq, bool set)
+{
+	return 0;
+}
+#endif
+
 static inline wait_queue_head_t *kvm_arch_vcpu_wq(struct kvm_vcpu *vcpu)
 {
 #ifdef __KVM_HAVE_ARCH_WQP
@@ -1019,6 +1044,7 @@ long kvm_vm_ioctl_assigned_device(struct kvm *kvm, unsigned ioctl,
 				  unsigned long arg);
 
 void kvm_free_all_assigned_devices(struct kvm *kvm);
+void kvm_assigned_dev_update_irq_routing(struct kvm *kvm);
 
 #else
 
@@ -1029,6 +1055,7 @@ static inline long kvm_vm_ioctl_assigned_device(struct kvm *kvm, unsigned ioctl,
 }
 
 static inline void kvm_free_all_assigned_devices(struct kvm *kvm) {}
+static inline void kvm_assigned_dev_update_irq_routing(struct kvm *kvm) {}
 
 #endif
 
@@ -9,6 +9,9 @@
 
 #include <linux/list.h>
 #include <linux/nodemask.h>
+#include <linux/shrinker.h>
+
+struct mem_cgroup;
 
 /* list_lru_walk_cb has to always return one of those */
 enum lru_status {
@@ -21,24 +24,51 @@ enum lru_status {
 				   internally, but has to return locked. */
 };
 
-struct list_lru_node {
-	spinlock_t		lock;
+struct list_lru_one {
 	struct list_head	list;
 	/* kept as signed so we can catch imbalance bugs */
 	long			nr_items;
+};
+
+struct list_lru_node {
+	/* protects all the lists of the node, including the per memcg ones */
+	spinlock_t		lock;
+	/* items not accounted to any memcg, or all items if !memcg_aware */
+	struct list_lru_one	lru;
+#ifdef CONFIG_MEMCG_KMEM
+	/* per memcg lists, indexed by memcg_cache_id() */
+	struct list_lru_one	**memcg_lrus;
+	int			memcg_nr_lrus;
+#endif
+	/* items on all the lists of the node */
+	long			nr_items;
 } ____cacheline_aligned_in_smp;
 
 struct list_lru {
 	struct list_lru_node	*node;
 	nodemask_t		active_nodes;
+#ifdef CONFIG_MEMCG_KMEM
+	bool			memcg_aware;
+	struct list_head	list;
+#endif
 };
 
 void list_lru_destroy(struct list_lru *lru);
-int list_lru_init_key(struct list_lru *lru, struct lock_class_key *key);
-static inline int list_lru_init(struct list_lru *lru)
+int __list_lru_init(struct list_lru *lru, bool memcg_aware,
+		    struct lock_class_key *key);
+
+#define list_lru_init(lru)		__list_lru_init((lru), false, NULL)
+#define list_lru_init_key(lru, key)	__list_lru_init((lru), false, (key))
+#define list_lru_init_memcg(lru)	__list_lru_init((lru), true, NULL)
+
+#ifdef CONFIG_MEMCG_KMEM
+int memcg_update_all_list_lrus(int num_memcgs);
+#else
+static inline int memcg_update_all_list_lrus(int num_memcgs)
 {
-	return list_lru_init_key(lru, NULL);
+	return 0;
 }
+#endif
 
 /**
  * list_lru_add: add an element to the lru list's tail
@@ -54,6 +84,9 @@ static inline int list_lru_init(struct list_lru *lru)
  * the previous list (with list_lru_del() for instance) before moving it
  * to @list_lru
  *
+ * Items of a memcg aware lru are put on the list of the memory cgroup the
+ * object containing @item is accounted to.
+ *
  * Return value: true if the list was updated, false otherwise
  */
 bool list_lru_add(struct list_lru *lru, struct list_head *item);
@@ -81,6 +114,28 @@ bool list_lru_del(struct list_lru *lru, struct list_head *item);
  * Callers that want such a guarantee need to provide an outer lock.
  */
 unsigned long list_lru_count_node(struct list_lru *lru, int nid);
+
+/**
+ * list_lru_count_one: return the number of objects of a memcg held by @lru
+ * @lru: the lru pointer.
+ * @nid: the node id to count from.
+ * @memcg: the cgroup to count from, %NULL for the objects of no cgroup.
+ */
+unsigned long list_lru_count_one(struct list_lru *lru, int nid,
+				 struct mem_cgroup *memcg);
+
+/*
+ * Shrinkers count and walk the lists of the cgroup being reclaimed from, or
+ * everything on the node for global reclaim.
+ */
+static inline unsigned long list_lru_shrink_count(struct list_lru *lru,
+						  struct shrink_control *sc)
+{
+	if (sc->memcg)
+		return list_lru_count_one(lru, sc->nid, sc->memcg);
+	return list_lru_count_node(lru, sc->nid);
+}
+
 static inline unsigned long list_lru_count(struct list_lru *lru)
 {
 	long count = 0;
@@ -113,12 +168,31 @@ typedef enum lru_status
  * Please note that nr_to_walk does not mean how many objects will be freed,
  * just how many objects will be scanned.
  *
+ * For memcg aware lrus all the lists of the node are walked, see
+ * list_lru_walk_one() to restrict the walk to a single cgroup.
+ *
  * Return value: the number of objects effectively removed from the LRU.
  */
 unsigned long list_lru_walk_node(struct list_lru *lru, int nid,
 				 list_lru_walk_cb isolate, void *cb_arg,
 				 unsigned long *nr_to_walk);
 
+unsigned long list_lru_walk_one(struct list_lru *lru, int nid,
+				struct mem_cgroup *memcg,
+				list_lru_walk_cb isolate, void *cb_arg,
+				unsigned long *nr_to_walk);
+
+static inline unsigned long
+list_lru_shrink_walk(struct list_lru *lru, struct shrink_control *sc,
+		     list_lru_walk_cb isolate, void *cb_arg)
+{
+	if (sc->memcg)
+		return list_lru_walk_one(lru, sc->nid, sc->memcg, isolate,
+					 cb_arg, &sc->nr_to_scan);
+	return list_lru_walk_node(lru, sc->nid, isolate, cb_arg,
+				  &sc->nr_to_scan);
+}
+
 static inline unsigned long
 list_lru_walk(struct list_lru *lru, list_lru_walk_cb isolate,
 	      void *cb_arg, unsigned long nr_to_walk)
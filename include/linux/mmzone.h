@@ -5,6 +5,7 @@
 #ifndef __GENERATING_BOUNDS_H
 
 #include <linux/spinlock.h>
+#include <linux/numa_spinlock.h>
 #include <linux/list.h>
 #include <linux/wait.h>
 #include <linux/bitops.h>
@@ -248,13 +249,24 @@ enum zone_watermarks {
 #define low_wmark_pages(z) (z->watermark[WMARK_LOW])
 #define high_wmark_pages(z) (z->watermark[WMARK_HIGH])
 
+/*
+ * Orders 1..PCP_HIGH_ORDER are cached on per-cpu lists as well, so that
+ * frequent small high-order users (network frags, SLUB slabs) don't take
+ * zone->lock for every allocation and free.
+ */
+#define PCP_HIGH_ORDER	PAGE_ALLOC_COSTLY_ORDER
+
 struct per_cpu_pages {
 	int count;		/* number of pages in the list */
 	int high;		/* high watermark, emptying needed */
 	int batch;		/* chunk size for buddy add/remove */
+	int high_count;		/* base pages on the high-order lists */
 
 	/* Lists of pages, one per migrate type stored on the pcp-lists */
 	struct list_head lists[MIGRATE_PCPTYPES];
+
+	/* Same for each order from 1 to PCP_HIGH_ORDER */
+	struct list_head high_lists[PCP_HIGH_ORDER][MIGRATE_PCPTYPES];
 };
 
 struct per_cpu_pageset {
@@ -364,7 +376,7 @@ struct zone {
 	/*
 	 * free areas of different sizes
 	 */
-	spinlock_t		lock;
+	numa_spinlock_t		lock;
 #if defined CONFIG_COMPACTION || defined CONFIG_CMA
 	/* Set to true when the PG_migrate_skip bits should be cleared */
 	bool			compact_blockskip_flush;
@@ -729,6 +741,9 @@ struct node_active_region {
 extern struct page *mem_map;
 #endif
 
+/* upper bound for the vm.kswapd_threads sysctl */
+#define MAX_KSWAPD_THREADS	16
+
 /*
  * The pg_data_t structure is used in machines with CONFIG_DISCONTIGMEM
  * (mostly NUMA machines?) to denote a higher-level memory zone than the
@@ -774,10 +789,15 @@ typedef struct pglist_data {
 	int node_id;
 	wait_queue_head_t kswapd_wait;
 	wait_queue_head_t pfmemalloc_wait;
-	struct task_struct *kswapd;	/* Protected by
+	struct task_struct *kswapd[MAX_KSWAPD_THREADS];	/* Protected by
 					   mem_hotplug_begin/end() */
 	int kswapd_max_order;
 	enum zone_type classzone_idx;
+#ifdef CONFIG_COMPACTION
+	wait_queue_head_t kcompactd_wait;
+	struct task_struct *kcompactd;	/* Protected by
+					   mem_hotplug_begin/end() */
+#endif
 #ifdef CONFIG_NUMA_BALANCING
 	/* Lock serializing the migrate rate limiting window */
 	spinlock_t numabalancing_migrate_lock;
@@ -788,6 +808,13 @@ typedef struct pglist_data {
 	/* Number of pages migrated during the rate limiting time interval */
 	unsigned long numabalancing_migrate_nr_pages;
 #endif
+#ifdef CONFIG_DEFERRED_STRUCT_PAGE_INIT
+	/*
+	 * If memory initialisation on large machines is deferred then this
+	 * is the first PFN that needs to be initialised.
+	 */
+	unsigned long first_deferred_pfn;
+#endif /* CONFIG_DEFERRED_STRUCT_PAGE_INIT */
 } pg_data_t;
 
 #define node_present_pages(nid)	(NODE_DATA(nid)->node_present_pages)
@@ -47,6 +47,9 @@ struct msi_desc {
 	/* Last set MSI message */
 	struct msi_msg msg;
 
+	/* Managed affinity, if set up by pci_enable_msix_range_affinity() */
+	struct cpumask *affinity;
+
 	struct kobject kobj;
 };
 
@@ -54,6 +54,9 @@
 struct netpoll_info;
 struct device;
 struct phy_device;
+struct sk_filter;
+struct tc_to_netdev;
+struct dp_flow_offload;
 /* 802.11 specific */
 struct wireless_dev;
 
@@ -313,9 +316,11 @@ struct napi_struct {
 	struct net_device	*dev;
 	struct sk_buff		*gro_list;
 	struct sk_buff		*skb;
+	struct sk_buff_head	rx_list;	/* GRO_NORMAL skbs to pass up */
 	struct list_head	dev_list;
 	struct hlist_node	napi_hash_node;
 	unsigned int		napi_id;
+	struct task_struct	*thread;	/* Poll thread, if threaded */
 };
 
 enum {
@@ -323,6 +328,8 @@ enum {
 	NAPI_STATE_DISABLE,	/* Disable pending */
 	NAPI_STATE_NPSVC,	/* Netpoll - don't dequeue from poll_list */
 	NAPI_STATE_HASHED,	/* In NAPI hash */
+	NAPI_STATE_THREADED,	/* Polled by its kthread, not in softirq */
+	NAPI_STATE_SCHED_THREADED, /* Scheduled to run in its kthread */
 };
 
 enum gro_result {
@@ -464,6 +471,18 @@ void napi_hash_add(struct napi_struct *napi);
  */
 void napi_hash_del(struct napi_struct *napi);
 
+/**
+ *	dev_set_threaded - poll a device's NAPI contexts from kthreads
+ *	@dev: network device
+ *	@threaded: true to poll from kthreads, false for softirq
+ *
+ * In threaded mode every NAPI context of @dev is polled by its own
+ * kthread, "napi/<dev>-<n>", rather than in NET_RX softirq.  The RX work
+ * is then scheduled, accounted and can be pinned or prioritized like any
+ * other task.  Must be called with RTNL held.
+ */
+int dev_set_threaded(struct net_device *dev, bool threaded);
+
 /**
  *	napi_disable - prevent NAPI from scheduling
  *	@n: napi context
@@ -660,6 +679,7 @@ static inline void rps_reset_sock_flow(struct rps_sock_flow_table *table,
 }
 
 extern struct rps_sock_flow_table __rcu *rps_sock_flow_table;
+extern int rps_encap_hash;
 
 #ifdef CONFIG_RFS_ACCEL
 bool rps_may_expire_flow(struct net_device *dev, u16 rxq_index, u32 flow_id,
@@ -749,6 +769,26 @@ struct netdev_phys_port_id {
 	unsigned char id_len;
 };
 
+enum xdp_netdev_command {
+	/* Replace the RX program of the device, NULL detaches it.  The
+	 * driver takes over the reference to the new program and releases
+	 * the old one.
+	 */
+	XDP_SETUP_PROG,
+	/* Report whether a program is attached */
+	XDP_QUERY_PROG,
+};
+
+struct netdev_xdp {
+	enum xdp_netdev_command command;
+	union {
+		/* XDP_SETUP_PROG */
+		struct sk_filter *prog;
+		/* XDP_QUERY_PROG */
+		bool prog_attached;
+	};
+};
+
 typedef u16 (*select_queue_fallback_t)(struct net_device *dev,
 				       struct sk_buff *skb);
 
@@ -865,6 +905,20 @@ typedef u16 (*select_queue_fallback_t)(struct net_device *dev,
  * 	queues stopped. This allows the netdevice to perform queue management
  * 	safely.
  *
+ * int (*ndo_setup_tc_offload)(struct net_device *dev, u32 handle,
+ *			       __be16 protocol, struct tc_to_netdev *tc);
+ *	Called to install, replace or remove a classifier in the filtering
+ *	hardware of the device, as described by @tc. @handle is that of the
+ *	qdisc the classifier hangs off and @protocol the one it matches.
+ *	Only used while NETIF_F_HW_TC is enabled; called with the rtnl lock
+ *	held.
+ *
+ * int (*ndo_dp_flow_offload)(struct net_device *dev,
+ *			      struct dp_flow_offload *fo);
+ *	Called to add, remove or read the counters of a datapath flow
+ *	switched in hardware from @dev, as described by @fo.  Only used
+ *	while NETIF_F_HW_TC is enabled; may sleep.
+ *
  *	Fiber Channel over Ethernet (FCoE) offload functions.
  * int (*ndo_fcoe_enable)(struct net_device *dev);
  *	Called when the FCoE protocol stack wants to start using LLD for FCoE
@@ -996,6 +1050,11 @@ typedef u16 (*select_queue_fallback_t)(struct net_device *dev,
  *	Callback to use for xmit over the accelerated station. This
  *	is used in place of ndo_start_xmit on accelerated net
  *	devices.
+ *
+ * int (*ndo_xdp)(struct net_device *dev, struct netdev_xdp *xdp);
+ *	Attach, detach or query the BPF program the driver runs on each
+ *	received frame before allocating an skb for it.  Called under
+ *	rtnl_lock.
  */
 struct net_device_ops {
 	int			(*ndo_init)(struct net_device *dev);
@@ -1061,6 +1120,12 @@ struct net_device_ops {
 	int			(*ndo_get_vf_port)(struct net_device *dev,
 						   int vf, struct sk_buff *skb);
 	int			(*ndo_setup_tc)(struct net_device *dev, u8 tc);
+	int			(*ndo_setup_tc_offload)(struct net_device *dev,
+							u32 handle,
+							__be16 protocol,
+							struct tc_to_netdev *tc);
+	int			(*ndo_dp_flow_offload)(struct net_device *dev,
+						       struct dp_flow_offload *fo);
 #if IS_ENABLED(CONFIG_FCOE)
 	int			(*ndo_fcoe_enable)(struct net_device *dev);
 	int			(*ndo_fcoe_disable)(struct net_device *dev);
@@ -1144,6 +1209,8 @@ struct net_device_ops {
 							struct net_device *dev,
 							void *priv);
 	int			(*ndo_get_lock_subclass)(struct net_device *dev);
+	int			(*ndo_xdp)(struct net_device *dev,
+					   struct netdev_xdp *xdp);
 };
 
 /**
@@ -1272,6 +1339,7 @@ struct net_device {
 
 	struct list_head	dev_list;
 	struct list_head	napi_list;
+	bool			threaded;	/* NAPI polled by kthreads */
 	struct list_head	unreg_list;
 	struct list_head	close_list;
 
@@ -1778,6 +1846,9 @@ struct packet_type {
 					 struct net_device *,
 					 struct packet_type *,
 					 struct net_device *);
+	void			(*list_func) (struct sk_buff_head *,
+					      struct packet_type *,
+					      struct net_device *);
 	bool			(*id_match)(struct packet_type *ptype,
 					    struct sock *sk);
 	void			*af_packet_priv;
@@ -1801,6 +1872,10 @@ struct packet_offload {
 
 struct udp_offload {
 	__be16			 port;
+	/* bytes between the UDP header and an inner Ethernet header,
+	 * lets the flow dissector look inside; 0 if not Ethernet
+	 */
+	u8			 encap_hlen;
 	struct offload_callbacks callbacks;
 };
 
@@ -2596,6 +2671,7 @@ static inline void dev_consume_skb_any(struct sk_buff *skb)
 int netif_rx(struct sk_buff *skb);
 int netif_rx_ni(struct sk_buff *skb);
 int netif_receive_skb(struct sk_buff *skb);
+void netif_receive_skb_list(struct sk_buff_head *head);
 gro_result_t napi_gro_receive(struct napi_struct *napi, struct sk_buff *skb);
 void napi_gro_flush(struct napi_struct *napi, bool flush_old);
 struct sk_buff *napi_get_frags(struct napi_struct *napi);
@@ -2631,8 +2707,18 @@ int dev_set_mac_address(struct net_device *, struct sockaddr *);
 int dev_change_carrier(struct net_device *, bool new_carrier);
 int dev_get_phys_port_id(struct net_device *dev,
 			 struct netdev_phys_port_id *ppid);
-int dev_hard_start_xmit(struct sk_buff *skb, struct net_device *dev,
-			struct netdev_queue *txq);
+int dev_change_xdp(struct net_device *dev, struct sk_filter *prog);
+bool dev_xdp_attached(struct net_device *dev);
+int __dev_hard_start_xmit(struct sk_buff *skb, struct net_device *dev,
+			  struct netdev_queue *txq, bool more);
+
+static inline int dev_hard_start_xmit(struct sk_buff *skb,
+				      struct net_device *dev,
+				      struct netdev_queue *txq)
+{
+	return __dev_hard_start_xmit(skb, dev, txq, false);
+}
+
 int __dev_forward_skb(struct net_device *dev, struct sk_buff *skb);
 int dev_forward_skb(struct net_device *dev, struct sk_buff *skb);
 bool is_skb_forwardable(struct net_device *dev, struct sk_buff *skb);
@@ -3125,6 +3211,7 @@ void netdev_stats_to_stats64(struct rtnl_link_stats64 *stats64,
 
 extern int		netdev_max_backlog;
 extern int		netdev_tstamp_prequeue;
+extern int		gro_normal_batch;
 extern int		weight_p;
 extern int		bpf_jit_enable;
 
@@ -3312,6 +3399,7 @@ static inline bool net_gso_ok(netdev_features_t features, int gso_type)
 	BUILD_BUG_ON(SKB_GSO_UDP_TUNNEL != (NETIF_F_GSO_UDP_TUNNEL >> NETIF_F_GSO_SHIFT));
 	BUILD_BUG_ON(SKB_GSO_UDP_TUNNEL_CSUM != (NETIF_F_GSO_UDP_TUNNEL_CSUM >> NETIF_F_GSO_SHIFT));
 	BUILD_BUG_ON(SKB_GSO_MPLS    != (NETIF_F_GSO_MPLS >> NETIF_F_GSO_SHIFT));
+	BUILD_BUG_ON(SKB_GSO_UDP_L4  != (NETIF_F_GSO_UDP_L4 >> NETIF_F_GSO_SHIFT));
 
 	return (features & feature) == feature;
 }
@@ -195,6 +195,29 @@ NF_HOOK(uint8_t pf, unsigned int hook, struct sk_buff *skb,
 	return NF_HOOK_THRESH(pf, hook, skb, in, out, okfn, INT_MIN);
 }
 
+/* Run the hook over every skb on @head; those allowed to pass are left
+ * on @head for the caller to continue with, the others are consumed.
+ * @okfn is only used for packets that get reinjected later.
+ */
+static inline void
+NF_HOOK_LIST(uint8_t pf, unsigned int hook, struct sk_buff_head *head,
+	     struct net_device *in, struct net_device *out,
+	     int (*okfn)(struct sk_buff *))
+{
+	struct sk_buff_head sublist;
+	struct sk_buff *skb;
+
+	if (!nf_hooks_active(pf, hook))
+		return;
+
+	__skb_queue_head_init(&sublist);
+	while ((skb = __skb_dequeue(head)) != NULL) {
+		if (nf_hook_slow(pf, hook, skb, in, out, okfn, INT_MIN) == 1)
+			__skb_queue_tail(&sublist, skb);
+	}
+	skb_queue_splice(&sublist, head);
+}
+
 /* Call setsockopt() */
 int nf_setsockopt(struct sock *sk, u_int8_t pf, int optval, char __user *opt,
 		  unsigned int len);
@@ -294,6 +317,12 @@ nf_nat_decode_session(struct sk_buff *skb, struct flowi *fl, u_int8_t family)
 #else /* !CONFIG_NETFILTER */
 #define NF_HOOK(pf, hook, skb, indev, outdev, okfn) (okfn)(skb)
 #define NF_HOOK_COND(pf, hook, skb, indev, outdev, okfn, cond) (okfn)(skb)
+static inline void
+NF_HOOK_LIST(uint8_t pf, unsigned int hook, struct sk_buff_head *head,
+	     struct net_device *in, struct net_device *out,
+	     int (*okfn)(struct sk_buff *))
+{
+}
 static inline int nf_hook_thresh(u_int8_t pf, unsigned int hook,
 				 struct sk_buff *skb,
 				 struct net_device *indev,
@@ -0,0 +1,93 @@
+#ifndef __LINUX_NUMA_SPINLOCK_H
+#define __LINUX_NUMA_SPINLOCK_H
+
+/*
+ * NUMA-aware spinlocks
+ *
+ * numa_spinlock_t is meant for the few very hot locks that are hammered
+ * from all nodes at once.  With CONFIG_NUMA_SPINLOCK it is a queued lock
+ * whose owner passes it on to a waiter of its own node when there is one;
+ * waiters from other nodes are set aside for at most NUMA_SPIN_BUDGET
+ * handovers.  Without it, the type and all operations are plain spinlocks.
+ */
+
+#include <linux/spinlock.h>
+
+#ifdef CONFIG_NUMA_SPINLOCK
+
+#include <linux/lockdep.h>
+
+/* node-local handovers while remote waiters are set aside */
+#define NUMA_SPIN_BUDGET	64
+
+struct numa_lock_node;
+
+typedef struct numa_spinlock {
+	int			locked;
+	unsigned int		budget;		/* protected by the lock */
+	struct numa_lock_node	*tail;		/* last queued waiter */
+	struct numa_lock_node	*sec_head;	/* bypassed remote waiters, */
+	struct numa_lock_node	*sec_tail;	/* protected by the lock */
+#ifdef CONFIG_DEBUG_LOCK_ALLOC
+	struct lockdep_map	dep_map;
+#endif
+} numa_spinlock_t;
+
+extern void __numa_spin_lock_init(numa_spinlock_t *lock, const char *name,
+				  struct lock_class_key *key);
+
+#define numa_spin_lock_init(lock)				\
+do {								\
+	static struct lock_class_key __key;			\
+								\
+	__numa_spin_lock_init((lock), #lock, &__key);		\
+} while (0)
+
+extern void numa_spin_lock(numa_spinlock_t *lock);
+extern void numa_spin_lock_bh(numa_spinlock_t *lock);
+extern void numa_spin_lock_irq(numa_spinlock_t *lock);
+extern unsigned long _numa_spin_lock_irqsave(numa_spinlock_t *lock);
+extern int numa_spin_trylock(numa_spinlock_t *lock);
+extern void numa_spin_unlock(numa_spinlock_t *lock);
+extern void numa_spin_unlock_bh(numa_spinlock_t *lock);
+extern void numa_spin_unlock_irq(numa_spinlock_t *lock);
+extern void numa_spin_unlock_irqrestore(numa_spinlock_t *lock,
+					unsigned long flags);
+
+#define numa_spin_lock_irqsave(lock, flags)			\
+do {								\
+	typecheck(unsigned long, flags);			\
+	flags = _numa_spin_lock_irqsave(lock);			\
+} while (0)
+
+static inline int numa_spin_is_locked(numa_spinlock_t *lock)
+{
+	return ACCESS_ONCE(lock->locked);
+}
+
+static inline int numa_spin_is_contended(numa_spinlock_t *lock)
+{
+	return ACCESS_ONCE(lock->tail) != NULL;
+}
+
+#else /* !CONFIG_NUMA_SPINLOCK */
+
+typedef spinlock_t numa_spinlock_t;
+
+#define numa_spin_lock_init(lock)		spin_lock_init(lock)
+#define numa_spin_lock(lock)			spin_lock(lock)
+#define numa_spin_lock_bh(lock)			spin_lock_bh(lock)
+#define numa_spin_lock_irq(lock)		spin_lock_irq(lock)
+#define numa_spin_lock_irqsave(lock, flags)	spin_lock_irqsave(lock, flags)
+#define numa_spin_trylock(lock)			spin_trylock(lock)
+#define numa_spin_unlock(lock)			spin_unlock(lock)
+#define numa_spin_unlock_bh(lock)		spin_unlock_bh(lock)
+#define numa_spin_unlock_irq(lock)		spin_unlock_irq(lock)
+#define numa_spin_unlock_irqrestore(lock, flags) \
+	spin_unlock_irqrestore(lock, flags)
+#define numa_spin_is_locked(lock)		spin_is_locked(lock)
+#define numa_spin_is_contended(lock)		spin_is_contended(lock)
+
+#endif /* CONFIG_NUMA_SPINLOCK */
+
+#endif /* __LINUX_NUMA_SPINLOCK_H */
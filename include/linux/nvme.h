@@ -35,6 +35,7 @@ struct nvme_bar {
 };
 
 #define NVME_CAP_MQES(cap)	((cap) & 0xffff)
+#define NVME_CAP_AMS_WRRU(cap)	(((cap) >> 17) & 0x1)
 #define NVME_CAP_TIMEOUT(cap)	(((cap) >> 24) & 0xff)
 #define NVME_CAP_STRIDE(cap)	(((cap) >> 32) & 0xf)
 #define NVME_CAP_MPSMIN(cap)	(((cap) >> 48) & 0xf)
@@ -80,6 +81,7 @@ struct nvme_dev {
 	unsigned queue_count;
 	unsigned online_queues;
 	unsigned max_qid;
+	unsigned nr_prio;
 	int q_depth;
 	u32 db_stride;
 	u32 ctrl_config;
@@ -97,6 +99,7 @@ struct nvme_dev {
 	char firmware_rev[8];
 	u32 max_hw_sectors;
 	u32 stripe_size;
+	u32 sgls;
 	u16 oncs;
 	u16 abort_limit;
 	u8 vwc;
@@ -131,6 +134,8 @@ struct nvme_iod {
 	int npages;		/* In the PRP list. 0 means small pool in use */
 	int offset;		/* Of PRP list */
 	int nents;		/* Used in scatterlist */
+	int nsgl;		/* SGL descriptors, 0 means PRPs in use */
+	int arena;		/* Slot in the queue's list arena, or -1 */
 	int length;		/* Of data, in bytes */
 	unsigned long start_time;
 	dma_addr_t first_dma;
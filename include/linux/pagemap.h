@@ -499,6 +499,7 @@ static inline int lock_page_or_retry(struct page *page, struct mm_struct *mm,
 extern void wait_on_page_bit(struct page *page, int bit_nr);
 
 extern int wait_on_page_bit_killable(struct page *page, int bit_nr);
+extern int wait_on_page_locked_async(struct page *page, wait_queue_t *wait);
 
 static inline int wait_on_page_locked_killable(struct page *page)
 {
@@ -1199,6 +1199,9 @@ static inline int pci_enable_msi_exact(struct pci_dev *dev, int nvec)
 }
 int pci_enable_msix_range(struct pci_dev *dev, struct msix_entry *entries,
 			  int minvec, int maxvec);
+int pci_enable_msix_range_affinity(struct pci_dev *dev,
+				   struct msix_entry *entries,
+				   int minvec, int maxvec);
 static inline int pci_enable_msix_exact(struct pci_dev *dev,
 					struct msix_entry *entries, int nvec)
 {
@@ -1228,6 +1231,9 @@ static inline int pci_enable_msi_exact(struct pci_dev *dev, int nvec)
 static inline int pci_enable_msix_range(struct pci_dev *dev,
 		      struct msix_entry *entries, int minvec, int maxvec)
 { return -ENOSYS; }
+static inline int pci_enable_msix_range_affinity(struct pci_dev *dev,
+		      struct msix_entry *entries, int minvec, int maxvec)
+{ return -ENOSYS; }
 static inline int pci_enable_msix_exact(struct pci_dev *dev,
 		      struct msix_entry *entries, int nvec)
 { return -ENOSYS; }
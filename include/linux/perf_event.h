@@ -262,6 +262,19 @@ struct pmu {
 	 * flush branch stack on context-switches (needed in cpu-wide mode)
 	 */
 	void (*flush_branch_stack)	(void);
+
+	/*
+	 * Set up pmu-private data structures for an AUX area; the pages are
+	 * written directly by the hardware.  Returns NULL on failure.
+	 */
+	void *(*setup_aux)		(int cpu, void **pages,
+					 int nr_pages, bool overwrite);
+					/* optional */
+
+	/*
+	 * Free pmu-private AUX data structures
+	 */
+	void (*free_aux)		(void *aux); /* optional */
 };
 
 /**
@@ -299,6 +312,7 @@ struct swevent_hlist {
 
 struct perf_cgroup;
 struct ring_buffer;
+struct perf_stack_agg;
 
 /**
  * struct perf_event - performance event kernel representation:
@@ -445,9 +459,18 @@ struct perf_event {
 #endif
 #endif
 
+	/* attr.aggregate_stacks: per-event (pid, callchain) table */
+	struct perf_stack_agg		*stack_agg;
+
 #ifdef CONFIG_CGROUP_PERF
 	struct perf_cgroup		*cgrp; /* cgroup event is attach to */
 	int				cgrp_defer_enabled;
+
+	/* attr.cgroup_count: counts of the attached cgroups, by css */
+	struct hlist_head		*cgrp_node_hash;
+	struct list_head		cgrp_node_entry;
+	u64				cgrp_node_count;
+	u64				cgrp_node_time;
 #endif
 
 #endif /* CONFIG_PERF_EVENTS */
@@ -528,6 +551,7 @@ struct perf_cpu_context {
 	struct list_head		rotation_list;
 	struct pmu			*unique_pmu;
 	struct perf_cgroup		*cgrp;
+	struct list_head		cgrp_node_list;
 };
 
 struct perf_output_handle {
@@ -537,6 +561,11 @@ struct perf_output_handle {
 	unsigned long			size;
 	void				*addr;
 	int				page;
+
+	/* perf_aux_output_*() */
+	void				*aux;
+	unsigned long			head;
+	u64				aux_flags;
 };
 
 #ifdef CONFIG_PERF_EVENTS
@@ -770,6 +799,16 @@ static inline bool has_branch_stack(struct perf_event *event)
 	return event->attr.sample_type & PERF_SAMPLE_BRANCH_STACK;
 }
 
+static inline bool has_aux(struct perf_event *event)
+{
+	return event->pmu->setup_aux;
+}
+
+static inline bool is_write_backward(struct perf_event *event)
+{
+	return !!event->attr.write_backward;
+}
+
 extern int perf_output_begin(struct perf_output_handle *handle,
 			     struct perf_event *event, unsigned int size);
 extern void perf_output_end(struct perf_output_handle *handle);
@@ -777,6 +816,13 @@ extern unsigned int perf_output_copy(struct perf_output_handle *handle,
 			     const void *buf, unsigned int len);
 extern unsigned int perf_output_skip(struct perf_output_handle *handle,
 				     unsigned int len);
+extern void *perf_aux_output_begin(struct perf_output_handle *handle,
+				   struct perf_event *event);
+extern void perf_aux_output_end(struct perf_output_handle *handle,
+				unsigned long size, bool truncated);
+extern int perf_aux_output_skip(struct perf_output_handle *handle,
+				unsigned long size);
+extern void *perf_get_aux(struct perf_output_handle *handle);
 extern int perf_swevent_get_recursion_context(void);
 extern void perf_swevent_put_recursion_context(int rctx);
 extern u64 perf_swevent_set_period(struct perf_event *event);
@@ -825,6 +871,17 @@ static inline void perf_event_enable(struct perf_event *event)		{ }
 static inline void perf_event_disable(struct perf_event *event)		{ }
 static inline int __perf_event_disable(void *info)			{ return -1; }
 static inline void perf_event_task_tick(void)				{ }
+static inline void *
+perf_aux_output_begin(struct perf_output_handle *handle,
+		      struct perf_event *event)				{ return NULL; }
+static inline void
+perf_aux_output_end(struct perf_output_handle *handle, unsigned long size,
+		    bool truncated)					{ }
+static inline int
+perf_aux_output_skip(struct perf_output_handle *handle,
+		     unsigned long size)				{ return -EINVAL; }
+static inline void *
+perf_get_aux(struct perf_output_handle *handle)				{ return NULL; }
 #endif
 
 #if defined(CONFIG_PERF_EVENTS) && defined(CONFIG_NO_HZ_FULL)
@@ -0,0 +1,150 @@
+/*
+ *	Definitions for a fixed size ring of pointers.
+ *
+ *	A slot holding NULL is free, so producer and consumer never need
+ *	to look at each other's index: the producer only checks that the
+ *	slot it is about to fill is empty, the consumer that the slot it
+ *	reads is not.  Producers are serialized among themselves by
+ *	producer_lock and consumers by consumer_lock, the two sides do not
+ *	share a lock or a cache line.
+ *
+ *	NULL can therefore not be queued.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version
+ *	2 of the License, or (at your option) any later version.
+ */
+
+#ifndef _LINUX_PTR_RING_H
+#define _LINUX_PTR_RING_H
+
+#include <linux/spinlock.h>
+#include <linux/cache.h>
+#include <linux/types.h>
+#include <linux/compiler.h>
+#include <linux/errno.h>
+#include <linux/slab.h>
+#include <asm/barrier.h>
+
+struct ptr_ring {
+	int producer ____cacheline_aligned_in_smp;
+	spinlock_t producer_lock;
+	int consumer ____cacheline_aligned_in_smp;
+	spinlock_t consumer_lock;
+	/* Shared consumer/producer data */
+	int size ____cacheline_aligned_in_smp; /* max entries in queue */
+	void **queue;
+};
+
+/* Note: callers invoking this in a loop must use a compiler barrier,
+ * for example cpu_relax(). Callers must hold producer_lock.
+ */
+static inline bool __ptr_ring_full(struct ptr_ring *r)
+{
+	return r->queue[r->producer];
+}
+
+/* Callers must hold producer_lock.
+ * Returns -ENOSPC if the ring is full.
+ */
+static inline int __ptr_ring_produce(struct ptr_ring *r, void *ptr)
+{
+	if (unlikely(r->queue[r->producer]))
+		return -ENOSPC;
+
+	/* Make sure the pointer we publish points to valid data, pairs
+	 * with smp_read_barrier_depends() in __ptr_ring_peek().
+	 */
+	smp_wmb();
+	ACCESS_ONCE(r->queue[r->producer]) = ptr;
+	if (unlikely(++r->producer >= r->size))
+		r->producer = 0;
+	return 0;
+}
+
+static inline int ptr_ring_produce(struct ptr_ring *r, void *ptr)
+{
+	int ret;
+
+	spin_lock(&r->producer_lock);
+	ret = __ptr_ring_produce(r, ptr);
+	spin_unlock(&r->producer_lock);
+
+	return ret;
+}
+
+/* Callers must hold consumer_lock, or be the only consumer. */
+static inline void *__ptr_ring_peek(struct ptr_ring *r)
+{
+	void *ptr = ACCESS_ONCE(r->queue[r->consumer]);
+
+	smp_read_barrier_depends();
+	return ptr;
+}
+
+/* May be called without consumer_lock, the answer can be stale by the
+ * time it is looked at.
+ */
+static inline bool __ptr_ring_empty(struct ptr_ring *r)
+{
+	return !ACCESS_ONCE(r->queue[ACCESS_ONCE(r->consumer)]);
+}
+
+/* Callers must hold consumer_lock. */
+static inline void *__ptr_ring_consume(struct ptr_ring *r)
+{
+	void *ptr = __ptr_ring_peek(r);
+
+	if (ptr) {
+		/* Hand the slot back to the producer only after the entry
+		 * has been read.
+		 */
+		smp_mb();
+		ACCESS_ONCE(r->queue[r->consumer]) = NULL;
+		if (unlikely(++r->consumer >= r->size))
+			r->consumer = 0;
+	}
+	return ptr;
+}
+
+static inline void *ptr_ring_consume(struct ptr_ring *r)
+{
+	void *ptr;
+
+	spin_lock(&r->consumer_lock);
+	ptr = __ptr_ring_consume(r);
+	spin_unlock(&r->consumer_lock);
+
+	return ptr;
+}
+
+static inline int ptr_ring_init(struct ptr_ring *r, int size, gfp_t gfp)
+{
+	r->queue = kcalloc(size, sizeof(*r->queue), gfp);
+	if (!r->queue)
+		return -ENOMEM;
+
+	r->size = size;
+	r->producer = r->consumer = 0;
+	spin_lock_init(&r->producer_lock);
+	spin_lock_init(&r->consumer_lock);
+
+	return 0;
+}
+
+/* Frees the ring, calling @destroy on every entry still queued.  Nobody
+ * may produce or consume concurrently.
+ */
+static inline void ptr_ring_cleanup(struct ptr_ring *r, void (*destroy)(void *))
+{
+	void *ptr;
+
+	if (destroy && r->queue)
+		while ((ptr = __ptr_ring_consume(r)))
+			destroy(ptr);
+	kfree(r->queue);
+	r->queue = NULL;
+}
+
+#endif /* _LINUX_PTR_RING_H */
@@ -22,6 +22,12 @@ struct shrink_control {
 	nodemask_t nodes_to_scan;
 	/* current node being shrunk (for NUMA aware shrinkers) */
 	int nid;
+
+	/*
+	 * memory cgroup being reclaimed from (for memcg aware shrinkers),
+	 * NULL for global reclaim
+	 */
+	struct mem_cgroup *memcg;
 };
 
 #define SHRINK_STOP (~0UL)
@@ -43,7 +49,9 @@ struct shrink_control {
  * attempts to call the @scan_objects will be made from the current reclaim
  * context.
  *
- * @flags determine the shrinker abilities, like numa awareness
+ * @flags determine the shrinker abilities, like numa awareness.  Only memcg
+ * aware shrinkers are called on memory cgroup limit reclaim, with
+ * shrink_control->memcg set to the cgroup to shrink.
  */
 struct shrinker {
 	unsigned long (*count_objects)(struct shrinker *,
@@ -64,6 +72,7 @@ struct shrinker {
 
 /* Flags */
 #define SHRINKER_NUMA_AWARE (1 << 0)
+#define SHRINKER_MEMCG_AWARE (1 << 1)
 
 extern int register_shrinker(struct shrinker *);
 extern void unregister_shrinker(struct shrinker *);
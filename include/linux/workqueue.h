@@ -103,6 +103,9 @@ struct work_struct {
 #ifdef CONFIG_LOCKDEP
 	struct lockdep_map lockdep_map;
 #endif
+#ifdef CONFIG_WQ_STATS
+	u64 queued_at;		/* local_clock() at queueing */
+#endif
 };
 
 #define WORK_DATA_INIT()	ATOMIC_LONG_INIT(WORK_STRUCT_NO_POOL)
@@ -125,10 +128,15 @@ struct delayed_work {
  * Unlike other fields, ->no_numa isn't a property of a worker_pool.  It
  * only modifies how apply_workqueue_attrs() select pools and thus doesn't
  * participate in pool hash calculations or equality comparisons.
+ *
+ * ->max_running caps the number of workers of an unbound pool executing
+ * work items at the same time.  Work items queued to such a pool must not
+ * depend on each other beyond that limit, or they may deadlock.
  */
 struct workqueue_attrs {
 	int			nice;		/* nice level */
 	cpumask_var_t		cpumask;	/* allowed CPUs */
+	int			max_running;	/* max busy workers, 0 for no limit */
 	bool			no_numa;	/* disable NUMA affinity */
 };
 
@@ -0,0 +1,69 @@
+#ifndef _NET_DP_FLOW_OFFLOAD_H
+#define _NET_DP_FLOW_OFFLOAD_H
+
+#include <linux/types.h>
+#include <linux/if_ether.h>
+#include <linux/netdevice.h>
+
+/* Datapath flows pushed into the embedded switch of a NIC.
+ *
+ * A software datapath (openvswitch) hands flows that it would forward
+ * from one port of the device to another, or drop, to the device
+ * receiving the packets.  If the driver accepts a flow, matching packets
+ * are switched by the hardware and never reach the host.  Anything the
+ * hardware does not match keeps following the regular receive path, so
+ * misses still go through the software datapath.
+ */
+
+enum dp_flow_offload_command {
+	DP_FLOW_OFFLOAD_ADD,
+	DP_FLOW_OFFLOAD_DEL,
+	DP_FLOW_OFFLOAD_STATS,
+};
+
+/* Fields a flow may match on.  Only the bits set in the mask are
+ * significant; the IPv4 and L4 fields are only used for IPv4 flows.
+ */
+struct dp_flow_offload_key {
+	u8	eth_src[ETH_ALEN];
+	u8	eth_dst[ETH_ALEN];
+	__be16	vlan_tci;
+	__be16	eth_type;
+	__be32	ipv4_src;
+	__be32	ipv4_dst;
+	u8	ip_proto;
+	__be16	tp_src;
+	__be16	tp_dst;
+};
+
+/**
+ * struct dp_flow_offload - request passed to ndo_dp_flow_offload()
+ * @command: what to do
+ * @cookie: identifies the flow, unique per device
+ * @key: values to match, already masked
+ * @mask: bits of @key to match
+ * @out_dev: device to switch matching packets to, %NULL to drop them
+ * @packets: %DP_FLOW_OFFLOAD_STATS: packets matched so far
+ * @bytes: %DP_FLOW_OFFLOAD_STATS: bytes matched so far
+ *
+ * @key, @mask and @out_dev are only valid for %DP_FLOW_OFFLOAD_ADD.  A
+ * driver refusing a flow returns an error and the flow stays in
+ * software only.  The counters are cumulative since the flow was added.
+ */
+struct dp_flow_offload {
+	enum dp_flow_offload_command	command;
+	unsigned long			cookie;
+	struct dp_flow_offload_key	key;
+	struct dp_flow_offload_key	mask;
+	struct net_device		*out_dev;
+	u64				packets;
+	u64				bytes;
+};
+
+static inline bool dp_flow_offload_supported(const struct net_device *dev)
+{
+	return (dev->features & NETIF_F_HW_TC) &&
+	       dev->netdev_ops->ndo_dp_flow_offload != NULL;
+}
+
+#endif /* _NET_DP_FLOW_OFFLOAD_H */
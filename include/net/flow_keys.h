@@ -11,8 +11,18 @@ struct flow_keys {
 	};
 	u16 thoff;
 	u8 ip_proto;
+	u8 encap;	/* keys are from inside a tunnel */
 };
 
-bool skb_flow_dissect(const struct sk_buff *skb, struct flow_keys *flow);
+/* also look inside UDP tunnels registered with udp_add_offload() */
+#define FLOW_DISSECTOR_F_PARSE_UDP_ENCAP	0x1
+
+bool __skb_flow_dissect(const struct sk_buff *skb, struct flow_keys *flow,
+			unsigned int flags);
+static inline bool skb_flow_dissect(const struct sk_buff *skb,
+				    struct flow_keys *flow)
+{
+	return __skb_flow_dissect(skb, flow, 0);
+}
 __be32 skb_flow_get_ports(const struct sk_buff *skb, int thoff, u8 ip_proto);
 #endif
@@ -74,6 +74,8 @@ struct inet_connection_sock_af_ops {
  * @icsk_pmtu_cookie	   Last pmtu seen by socket
  * @icsk_ca_ops		   Pluggable congestion control hook
  * @icsk_af_ops		   Operations which are AF_INET{4,6} specific
+ * @icsk_ulp_ops	   Pluggable ULP control hook
+ * @icsk_ulp_data	   ULP private data
  * @icsk_ca_state:	   Congestion control state
  * @icsk_retransmits:	   Number of unrecovered [RTO] timeouts
  * @icsk_pending:	   Scheduled timer event
@@ -96,6 +98,8 @@ struct inet_connection_sock {
 	__u32			  icsk_pmtu_cookie;
 	const struct tcp_congestion_ops *icsk_ca_ops;
 	const struct inet_connection_sock_af_ops *icsk_af_ops;
+	const struct tcp_ulp_ops  *icsk_ulp_ops;
+	void			  *icsk_ulp_data;
 	unsigned int		  (*icsk_sync_mss)(struct sock *sk, u32 pmtu);
 	__u8			  icsk_ca_state;
 	__u8			  icsk_retransmits;
@@ -125,9 +129,10 @@ struct inet_connection_sock {
 		/* Information on the current probe. */
 		int		  probe_size;
 	} icsk_mtup;
-	u32			  icsk_ca_priv[16];
 	u32			  icsk_user_timeout;
-#define ICSK_CA_PRIV_SIZE	(16 * sizeof(u32))
+
+	u64			  icsk_ca_priv[11];
+#define ICSK_CA_PRIV_SIZE	(11 * sizeof(u64))
 };
 
 #define ICSK_TIME_RETRANS	1	/* Retransmit timer */
@@ -207,6 +212,22 @@ static inline void inet_csk_clear_xmit_timer(struct sock *sk, const int what)
 #endif
 }
 
+/*
+ * The retransmit and delayed ACK timers are pushed back on almost every
+ * ACK.  Instead of paying a mod_timer() each time, leave a pending timer
+ * alone when its new deadline is later: the timer handlers compare the
+ * current deadline to jiffies and re-arm themselves when they fire early.
+ */
+static inline void inet_csk_lazy_reset_timer(struct sock *sk,
+					     struct timer_list *timer,
+					     unsigned long expires)
+{
+	if (timer_pending(timer) &&
+	    time_before_eq(ACCESS_ONCE(timer->expires), expires))
+		return;
+	sk_reset_timer(sk, timer, expires);
+}
+
 /*
  *	Reset the retransmission timer
  */
@@ -228,11 +249,13 @@ static inline void inet_csk_reset_xmit_timer(struct sock *sk, const int what,
 	    what == ICSK_TIME_EARLY_RETRANS || what ==  ICSK_TIME_LOSS_PROBE) {
 		icsk->icsk_pending = what;
 		icsk->icsk_timeout = jiffies + when;
-		sk_reset_timer(sk, &icsk->icsk_retransmit_timer, icsk->icsk_timeout);
+		inet_csk_lazy_reset_timer(sk, &icsk->icsk_retransmit_timer,
+					  icsk->icsk_timeout);
 	} else if (what == ICSK_TIME_DACK) {
 		icsk->icsk_ack.pending |= ICSK_ACK_TIMER;
 		icsk->icsk_ack.timeout = jiffies + when;
-		sk_reset_timer(sk, &icsk->icsk_delack_timer, icsk->icsk_ack.timeout);
+		inet_csk_lazy_reset_timer(sk, &icsk->icsk_delack_timer,
+					  icsk->icsk_ack.timeout);
 	}
 #ifdef INET_CSK_DEBUG
 	else {
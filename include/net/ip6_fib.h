@@ -196,6 +196,12 @@ static inline void rt6_set_from(struct rt6_info *rt, struct rt6_info *from)
 	rt->dst.from = new;
 }
 
+/* Invalidates the routes cached by ip6_pol_route(). */
+static inline void fib6_gen_bump(struct net *net)
+{
+	atomic_inc(&net->ipv6.fib6_gen);
+}
+
 static inline void ip6_rt_put(struct rt6_info *rt)
 {
 	/* dst_release() accepts a NULL parameter.
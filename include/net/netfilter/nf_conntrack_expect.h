@@ -87,6 +87,9 @@ struct nf_conntrack_expect *
 nf_ct_find_expectation(struct net *net, u16 zone,
 		       const struct nf_conntrack_tuple *tuple);
 
+bool nf_ct_expect_pending(struct net *net, u16 zone,
+			  const struct nf_conntrack_tuple *tuple);
+
 void nf_ct_unlink_expect_report(struct nf_conntrack_expect *exp,
 				u32 portid, int report);
 static inline void nf_ct_unlink_expect(struct nf_conntrack_expect *exp)
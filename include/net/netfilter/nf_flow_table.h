@@ -0,0 +1,95 @@
+#ifndef _NF_FLOW_TABLE_H
+#define _NF_FLOW_TABLE_H
+
+#include <linux/types.h>
+#include <linux/list.h>
+#include <linux/rcupdate.h>
+#include <linux/jiffies.h>
+#include <net/dst.h>
+#include <net/netfilter/nf_conntrack.h>
+
+/* A flow table entry mirrors an established, offloaded conntrack entry.
+ * Packets matching one of its two tuples are forwarded by the flow table
+ * hook without going through conntrack, the iptables chains and the
+ * routing code, using the route that was cached when the entry was set up.
+ */
+struct flow_offload_tuple {
+	__be32				src_v4;
+	__be32				dst_v4;
+	__be16				src_port;
+	__be16				dst_port;
+	int				iifidx;
+	u8				l3proto;
+	u8				l4proto;
+
+	/* Everything below is not part of the lookup key */
+	u8				dir;
+	u16				mtu;
+	struct dst_entry		*dst_cache;
+};
+
+#define FLOW_OFFLOAD_TUPLE_KEYLEN	offsetof(struct flow_offload_tuple, dir)
+
+struct flow_offload_tuple_hash {
+	struct hlist_node		node;
+	struct flow_offload_tuple	tuple;
+};
+
+enum flow_offload_bits {
+	FLOW_OFFLOAD_SNAT_BIT,
+	FLOW_OFFLOAD_DNAT_BIT,
+	FLOW_OFFLOAD_TEARDOWN_BIT,
+};
+
+struct flow_offload {
+	struct flow_offload_tuple_hash	tuplehash[IP_CT_DIR_MAX];
+	struct nf_conn			*ct;
+	unsigned long			flags;
+	/* jiffies at which the entry goes idle */
+	u32				timeout;
+	/* conntrack timeout in use when the entry was set up */
+	u32				ct_timeout;
+	struct rcu_head			rcu_head;
+};
+
+#define NF_FLOW_TIMEOUT			(30 * HZ)
+
+struct nf_flow_route {
+	struct {
+		struct dst_entry	*dst;
+	} tuple[IP_CT_DIR_MAX];
+};
+
+struct flow_offload *flow_offload_alloc(struct nf_conn *ct,
+					struct nf_flow_route *route);
+void flow_offload_free(struct flow_offload *flow);
+
+int flow_offload_add(struct flow_offload *flow);
+struct flow_offload_tuple_hash *
+flow_offload_lookup(struct net *net, const struct flow_offload_tuple *tuple);
+
+static inline struct flow_offload *
+flow_offload_from_tuple(struct flow_offload_tuple_hash *tuplehash)
+{
+	return container_of(tuplehash, struct flow_offload,
+			    tuplehash[tuplehash->tuple.dir]);
+}
+
+/* Hand the connection back to the slow path, the garbage collector
+ * removes the entry shortly afterwards.
+ */
+static inline void flow_offload_teardown(struct flow_offload *flow)
+{
+	set_bit(FLOW_OFFLOAD_TEARDOWN_BIT, &flow->flags);
+}
+
+static inline void flow_offload_refresh(struct flow_offload *flow)
+{
+	u32 timeout = (u32)jiffies + NF_FLOW_TIMEOUT;
+
+	/* avoid dirtying the cache line on every packet */
+	if (timeout - flow->timeout >= HZ)
+		flow->timeout = timeout;
+}
+
+#endif /* _NF_FLOW_TABLE_H */
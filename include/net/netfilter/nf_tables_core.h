@@ -1,12 +1,36 @@
 #ifndef _NET_NF_TABLES_CORE_H
 #define _NET_NF_TABLES_CORE_H
 
+#include <net/netfilter/nf_tables.h>
+
 int nf_tables_core_module_init(void);
 void nf_tables_core_module_exit(void);
 
 int nft_immediate_module_init(void);
 void nft_immediate_module_exit(void);
 
+/* Evaluation functions of the expressions built into nf_tables, called
+ * directly from nft_do_chain().
+ */
+void nft_immediate_eval(const struct nft_expr *expr,
+			struct nft_data data[NFT_REG_MAX + 1],
+			const struct nft_pktinfo *pkt);
+void nft_cmp_eval(const struct nft_expr *expr,
+		  struct nft_data data[NFT_REG_MAX + 1],
+		  const struct nft_pktinfo *pkt);
+void nft_lookup_eval(const struct nft_expr *expr,
+		     struct nft_data data[NFT_REG_MAX + 1],
+		     const struct nft_pktinfo *pkt);
+void nft_bitwise_eval(const struct nft_expr *expr,
+		      struct nft_data data[NFT_REG_MAX + 1],
+		      const struct nft_pktinfo *pkt);
+void nft_byteorder_eval(const struct nft_expr *expr,
+			struct nft_data data[NFT_REG_MAX + 1],
+			const struct nft_pktinfo *pkt);
+void nft_payload_eval(const struct nft_expr *expr,
+		      struct nft_data data[NFT_REG_MAX + 1],
+		      const struct nft_pktinfo *pkt);
+
 struct nft_cmp_fast_expr {
 	u32			data;
 	enum nft_registers	sreg:8;
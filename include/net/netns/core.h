@@ -2,6 +2,7 @@
 #define __NETNS_CORE_H__
 
 struct ctl_table_header;
+struct net_lat_hist;
 struct prot_inuse;
 
 struct netns_core {
@@ -11,6 +12,9 @@ struct netns_core {
 	int	sysctl_somaxconn;
 
 	struct prot_inuse __percpu *inuse;
+#ifdef CONFIG_NET_STACK_LATENCY
+	struct net_lat_hist __percpu *lat_hist;
+#endif
 };
 
 #endif
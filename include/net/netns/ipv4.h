@@ -15,6 +15,7 @@ struct fib_rules_ops;
 struct hlist_head;
 struct fib_table;
 struct sock;
+struct rt_output_cache;
 struct local_ports {
 	seqlock_t	lock;
 	int		range[2];
@@ -97,5 +98,7 @@ struct netns_ipv4 {
 #endif
 #endif
 	atomic_t	rt_genid;
+	struct rt_output_cache __percpu *rt_output_cache;
+	struct rt_output_cache __percpu *rt_output_cache_stash;
 };
 #endif
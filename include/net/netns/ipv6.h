@@ -9,6 +9,7 @@
 #include <net/dst_ops.h>
 
 struct ctl_table_header;
+struct rt6_pol_cache;
 
 struct netns_sysctl_ipv6 {
 #ifdef CONFIG_SYSCTL
@@ -31,6 +32,7 @@ struct netns_sysctl_ipv6 {
 	int icmpv6_time;
 	int anycast_src_echo_reply;
 	int fwmark_reflect;
+	int ip6_rt_pol_cache;
 };
 
 struct netns_ipv6 {
@@ -76,6 +78,9 @@ struct netns_ipv6 {
 #endif
 	atomic_t		dev_addr_genid;
 	atomic_t		rt_genid;
+	atomic_t		fib6_gen;
+	struct rt6_pol_cache __percpu *rt6_pol_cache;
+	struct rt6_pol_cache __percpu *rt6_pol_cache_stash;
 };
 
 #if IS_ENABLED(CONFIG_NF_DEFRAG_IPV6)
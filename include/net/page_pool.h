@@ -0,0 +1,97 @@
+/*
+ * page_pool.h - recycling of DMA-mapped pages for network RX rings
+ *
+ * A page_pool belongs to one RX queue.  The driver allocates its receive
+ * pages from the pool; when the skb built on top of them is freed (see
+ * skb_mark_for_recycle()), pages nobody else holds a reference on go back
+ * to the pool still DMA-mapped, so the steady state needs neither the page
+ * allocator nor dma_map_page()/dma_unmap_page() per packet.
+ *
+ * Allocation is lockless and must only happen from the queue's NAPI poll
+ * (or with NAPI disabled).  Pages may be returned from any context.
+ */
+#ifndef _NET_PAGE_POOL_H
+#define _NET_PAGE_POOL_H
+
+#include <linux/mm.h>
+#include <linux/spinlock.h>
+#include <linux/dma-direction.h>
+#include <linux/atomic.h>
+#include <linux/poison.h>
+
+#define PP_FLAG_DMA_MAP		1	/* Pool maps pages for dev on allocation
+					 * and keeps them mapped while recycled.
+					 */
+#define PP_FLAG_ALL		PP_FLAG_DMA_MAP
+
+/* Marks pages owned by a page_pool, kept in page->pp_magic */
+#define PP_SIGNATURE		(0x40 + POISON_POINTER_DELTA)
+
+/* Per-pool, NAPI-only cache in front of the shared ring */
+#define PP_ALLOC_CACHE_SIZE	128
+#define PP_ALLOC_CACHE_REFILL	64
+
+struct device;
+
+struct page_pool_params {
+	unsigned int	flags;
+	unsigned int	order;
+	unsigned int	pool_size;	/* recycle ring entries */
+	int		nid;		/* NUMA node to allocate from */
+	struct device	*dev;		/* device the pages are mapped for */
+	enum dma_data_direction dma_dir;
+};
+
+struct page_pool {
+	struct page_pool_params p;
+
+	/* Only touched from the pool owner's NAPI context */
+	struct {
+		unsigned int	count;
+		struct page	*cache[PP_ALLOC_CACHE_SIZE];
+	} alloc ____cacheline_aligned_in_smp;
+
+	/* Pages returned from other contexts, e.g. the skb free path */
+	spinlock_t	ring_lock ____cacheline_aligned_in_smp;
+	unsigned int	ring_head;
+	unsigned int	ring_count;
+	bool		destroyed;
+	struct page	**ring;
+
+	/*
+	 * One reference for the owner plus one per page allocated by the
+	 * pool and not yet released; the pool is freed when it drops to 0.
+	 */
+	atomic_t	users;
+};
+
+struct page_pool *page_pool_create(const struct page_pool_params *params);
+void page_pool_destroy(struct page_pool *pool);
+
+struct page *page_pool_alloc_pages(struct page_pool *pool, gfp_t gfp);
+void page_pool_put_page(struct page_pool *pool, struct page *page,
+			bool allow_direct);
+void page_pool_release_page(struct page_pool *pool, struct page *page);
+bool page_pool_return_skb_page(struct page *page);
+
+static inline struct page *page_pool_dev_alloc_pages(struct page_pool *pool)
+{
+	return page_pool_alloc_pages(pool, GFP_ATOMIC | __GFP_NOWARN | __GFP_COLD);
+}
+
+/*
+ * Return a page the driver did not pass up the stack, e.g. on an RX error.
+ * Only valid from the pool owner's NAPI context.
+ */
+static inline void page_pool_recycle_direct(struct page_pool *pool,
+					    struct page *page)
+{
+	page_pool_put_page(pool, page, true);
+}
+
+static inline dma_addr_t page_pool_get_dma_addr(struct page *page)
+{
+	return (dma_addr_t)page_private(page);
+}
+
+#endif /* _NET_PAGE_POOL_H */
@@ -334,6 +334,112 @@ static inline int tcf_valid_offset(const struct sk_buff *skb,
 		      (ptr <= (ptr + len)));
 }
 
+/* Hardware offload of classifiers
+ *
+ * A classifier that can be matched by the NIC describes each change to
+ * it with a struct tc_to_netdev and hands it to ndo_setup_tc_offload().
+ * Whatever the hardware does not take keeps being matched in software,
+ * unless the user asked for TCA_CLS_FLAGS_SKIP_SW, in which case the
+ * filter only exists in hardware and failing to offload it is an error.
+ */
+enum {
+	TC_SETUP_CLSU32,
+};
+
+enum tc_clsu32_command {
+	TC_CLSU32_NEW_KNODE,
+	TC_CLSU32_REPLACE_KNODE,
+	TC_CLSU32_DELETE_KNODE,
+	TC_CLSU32_NEW_HNODE,
+	TC_CLSU32_REPLACE_HNODE,
+	TC_CLSU32_DELETE_HNODE,
+};
+
+struct tc_cls_u32_knode {
+	struct tcf_exts *exts;
+	struct tc_u32_sel *sel;
+	u32 handle;
+	u32 val;		/* skb->mark match, if any */
+	u32 mask;
+	u32 link_handle;	/* hash table linked to, 0 if none */
+	u8 fshift;
+};
+
+struct tc_cls_u32_hnode {
+	u32 handle;
+	u32 prio;
+	unsigned int divisor;
+};
+
+struct tc_cls_u32_offload {
+	enum tc_clsu32_command command;
+	union {
+		struct tc_cls_u32_knode knode;
+		struct tc_cls_u32_hnode hnode;
+	};
+};
+
+struct tc_to_netdev {
+	unsigned int type;
+	union {
+		struct tc_cls_u32_offload *cls_u32;
+	};
+};
+
+static inline bool tc_should_offload(const struct net_device *dev, u32 flags)
+{
+	if (!(dev->features & NETIF_F_HW_TC))
+		return false;
+	if (flags & TCA_CLS_FLAGS_SKIP_HW)
+		return false;
+	return dev->netdev_ops->ndo_setup_tc_offload != NULL;
+}
+
+static inline bool tc_skip_sw(u32 flags)
+{
+	return (flags & TCA_CLS_FLAGS_SKIP_SW) ? true : false;
+}
+
+static inline bool tc_flags_valid(u32 flags)
+{
+	if (flags & ~(TCA_CLS_FLAGS_SKIP_HW | TCA_CLS_FLAGS_SKIP_SW))
+		return false;
+	/* a filter has to live somewhere */
+	return (flags & (TCA_CLS_FLAGS_SKIP_HW | TCA_CLS_FLAGS_SKIP_SW)) !=
+	       (TCA_CLS_FLAGS_SKIP_HW | TCA_CLS_FLAGS_SKIP_SW);
+}
+
+/* True if @exts holds no action at all, or exactly one. Drivers that
+ * can only carry out a single action use these to vet a filter.
+ */
+static inline bool tc_no_actions(const struct tcf_exts *exts)
+{
+#ifdef CONFIG_NET_CLS_ACT
+	return list_empty(&exts->actions);
+#else
+	return true;
+#endif
+}
+
+static inline bool tc_single_action(const struct tcf_exts *exts)
+{
+#ifdef CONFIG_NET_CLS_ACT
+	return list_is_singular(&exts->actions);
+#else
+	return false;
+#endif
+}
+
+static inline struct tc_action *tc_first_action(const struct tcf_exts *exts)
+{
+#ifdef CONFIG_NET_CLS_ACT
+	return list_first_entry_or_null(&exts->actions, struct tc_action,
+					list);
+#else
+	return NULL;
+#endif
+}
+
 #ifdef CONFIG_NET_CLS_IND
 #include <net/net_namespace.h>
 
@@ -109,6 +109,7 @@ void inet_unregister_protosw(struct inet_protosw *p);
 
 int  udp_add_offload(struct udp_offload *prot);
 void udp_del_offload(struct udp_offload *prot);
+unsigned int udp_offload_encap_hlen(__be16 port);
 
 #if IS_ENABLED(CONFIG_IPV6)
 int inet6_add_protocol(const struct inet6_protocol *prot, unsigned char num);
@@ -6,6 +6,8 @@
 #include <linux/rcupdate.h>
 #include <linux/pkt_sched.h>
 #include <linux/pkt_cls.h>
+#include <linux/percpu.h>
+#include <linux/u64_stats_sync.h>
 #include <net/gen_stats.h>
 #include <net/rtnetlink.h>
 
@@ -25,6 +27,8 @@ enum qdisc_state_t {
 	__QDISC_STATE_SCHED,
 	__QDISC_STATE_DEACTIVATED,
 	__QDISC_STATE_THROTTLED,
+	__QDISC_STATE_RUNNING,		/* TCQ_F_NOLOCK qdiscs only */
+	__QDISC_STATE_MISSED,		/* TCQ_F_NOLOCK qdiscs only */
 };
 
 /*
@@ -57,6 +61,11 @@ struct Qdisc {
 				      * Its true for MQ/MQPRIO slaves, or non
 				      * multiqueue device.
 				      */
+#define TCQ_F_NOLOCK		0x20 /* qdisc does its own locking: enqueue
+				      * and dequeue run without qdisc_lock(),
+				      * counters live in ->cpu_stats. Only
+				      * valid as the root of a tx queue.
+				      */
 #define TCQ_F_WARN_NONWC	(1 << 16)
 	u32			limit;
 	const struct Qdisc_ops	*ops;
@@ -86,6 +95,7 @@ struct Qdisc {
 	struct gnet_stats_basic_packed bstats;
 	unsigned int		__state;
 	struct gnet_stats_queue	qstats;
+	struct qdisc_cpu_stats __percpu *cpu_stats;
 	struct rcu_head		rcu_head;
 	int			padded;
 	atomic_t		refcnt;
@@ -93,13 +103,41 @@ struct Qdisc {
 	spinlock_t		busylock ____cacheline_aligned_in_smp;
 };
 
+/* Counters of a TCQ_F_NOLOCK qdisc, folded into ->q.qlen, ->bstats and
+ * ->qstats by qdisc_fold_cpu_stats() when they are reported.
+ */
+struct qdisc_cpu_stats {
+	struct gnet_stats_basic_packed	bstats;
+	struct u64_stats_sync		syncp;
+	struct gnet_stats_queue		qstats;
+	int				qlen;
+};
+
 static inline bool qdisc_is_running(const struct Qdisc *qdisc)
 {
+	if (qdisc->flags & TCQ_F_NOLOCK)
+		return test_bit(__QDISC_STATE_RUNNING, &qdisc->state);
 	return (qdisc->__state & __QDISC___STATE_RUNNING) ? true : false;
 }
 
 static inline bool qdisc_run_begin(struct Qdisc *qdisc)
 {
+	if (qdisc->flags & TCQ_F_NOLOCK) {
+		if (test_and_set_bit(__QDISC_STATE_RUNNING, &qdisc->state)) {
+			/* Whoever runs the qdisc has to look at the queue
+			 * again before giving up, in case it had found it
+			 * empty before our packet went in.
+			 */
+			set_bit(__QDISC_STATE_MISSED, &qdisc->state);
+			smp_mb__after_atomic();
+			if (test_and_set_bit(__QDISC_STATE_RUNNING,
+					     &qdisc->state))
+				return false;
+		}
+		clear_bit(__QDISC_STATE_MISSED, &qdisc->state);
+		smp_mb__after_atomic();
+		return true;
+	}
 	if (qdisc_is_running(qdisc))
 		return false;
 	qdisc->__state |= __QDISC___STATE_RUNNING;
@@ -108,6 +146,14 @@ static inline bool qdisc_run_begin(struct Qdisc *qdisc)
 
 static inline void qdisc_run_end(struct Qdisc *qdisc)
 {
+	if (qdisc->flags & TCQ_F_NOLOCK) {
+		smp_mb__before_atomic();
+		clear_bit(__QDISC_STATE_RUNNING, &qdisc->state);
+		smp_mb__after_atomic();
+		if (unlikely(test_bit(__QDISC_STATE_MISSED, &qdisc->state)))
+			__netif_schedule(qdisc);
+		return;
+	}
 	qdisc->__state &= ~__QDISC___STATE_RUNNING;
 }
 
@@ -315,6 +361,7 @@ static inline void sch_tree_unlock(const struct Qdisc *q)
 extern struct Qdisc noop_qdisc;
 extern struct Qdisc_ops noop_qdisc_ops;
 extern struct Qdisc_ops pfifo_fast_ops;
+extern struct Qdisc_ops pfifo_nolock_ops;
 extern struct Qdisc_ops mq_qdisc_ops;
 extern const struct Qdisc_ops *default_qdisc_ops;
 
@@ -368,6 +415,7 @@ struct Qdisc *dev_graft_qdisc(struct netdev_queue *dev_queue,
 			      struct Qdisc *qdisc);
 void qdisc_reset(struct Qdisc *qdisc);
 void qdisc_destroy(struct Qdisc *qdisc);
+void qdisc_fold_cpu_stats(struct Qdisc *qdisc);
 void qdisc_tree_decrease_qlen(struct Qdisc *qdisc, unsigned int n);
 struct Qdisc *qdisc_alloc(struct netdev_queue *dev_queue,
 			  const struct Qdisc_ops *ops);
@@ -216,6 +216,7 @@ struct sock_common {
 };
 
 struct cg_proto;
+struct sock_reuseport;
 /**
   *	struct sock - network layer representation of sockets
   *	@__sk_common: shared layout with inet_timewait_sock
@@ -240,6 +241,7 @@ struct cg_proto;
   *	@sk_allocation: allocation mode
   *	@sk_pacing_rate: Pacing rate (if supported by transport/packet scheduler)
   *	@sk_max_pacing_rate: Maximum pacing rate (%SO_MAX_PACING_RATE)
+  *	@sk_pacing_status: Pacing status (requested, handled by sch_fq)
   *	@sk_sndbuf: size of send buffer in bytes
   *	@sk_flags: %SO_LINGER (l_onoff), %SO_BROADCAST, %SO_KEEPALIVE,
   *		   %SO_OOBINLINE settings, %SO_TIMESTAMPING settings
@@ -273,6 +275,7 @@ struct cg_proto;
   *	@sk_sndtimeo: %SO_SNDTIMEO setting
   *	@sk_rxhash: flow hash received from netif layer
   *	@sk_filter: socket filtering instructions
+  *	@sk_reuseport_cb: %SO_REUSEPORT group, shared by all its sockets
   *	@sk_protinfo: private area, net family specific, when not using slab
   *	@sk_timer: sock cleanup timer
   *	@sk_stamp: time stamp of last packet received
@@ -280,6 +283,7 @@ struct cg_proto;
   *	@sk_user_data: RPC layer private data
   *	@sk_frag: cached page frag
   *	@sk_peek_off: current peek_offset value
+  *	@sk_zckey: counter to order MSG_ZEROCOPY notifications
   *	@sk_send_head: front of stuff to transmit
   *	@sk_security: used by security modules
   *	@sk_mark: generic packet mark
@@ -354,6 +358,7 @@ struct sock {
 
 	struct sk_filter __rcu	*sk_filter;
 	struct socket_wq __rcu	*sk_wq;
+	struct sock_reuseport __rcu	*sk_reuseport_cb;
 
 #ifdef CONFIG_NET_DMA
 	struct sk_buff_head	sk_async_wait_queue;
@@ -382,6 +387,7 @@ struct sock {
 	gfp_t			sk_allocation;
 	u32			sk_pacing_rate; /* bytes per second */
 	u32			sk_max_pacing_rate;
+	u32			sk_pacing_status; /* see enum sk_pacing */
 	netdev_features_t	sk_route_caps;
 	netdev_features_t	sk_route_nocaps;
 	int			sk_gso_type;
@@ -413,6 +419,7 @@ struct sock {
 	struct sk_buff		*sk_send_head;
 	__s32			sk_peek_off;
 	int			sk_write_pending;
+	atomic_t		sk_zckey;
 #ifdef CONFIG_SECURITY
 	void			*sk_security;
 #endif
@@ -428,6 +435,12 @@ struct sock {
 	void                    (*sk_destruct)(struct sock *sk);
 };
 
+enum sk_pacing {
+	SK_PACING_NONE		= 0,
+	SK_PACING_NEEDED	= 1,
+	SK_PACING_FQ		= 2,
+};
+
 #define __sk_user_data(sk) ((*((void __rcu **)&(sk)->sk_user_data)))
 
 #define rcu_dereference_sk_user_data(sk)	rcu_dereference(__sk_user_data((sk)))
@@ -700,6 +713,7 @@ enum sock_flags {
 		     */
 	SOCK_FILTER_LOCKED, /* Filter cannot be changed anymore */
 	SOCK_SELECT_ERR_QUEUE, /* Wake select on error queue */
+	SOCK_ZEROCOPY, /* buffers from userspace */
 };
 
 static inline void sock_copy_flags(struct sock *nsk, struct sock *osk)
@@ -989,6 +1003,9 @@ struct proto {
 	/* Memory pressure */
 	void			(*enter_memory_pressure)(struct sock *sk);
 	atomic_long_t		*memory_allocated;	/* Current allocated memory. */
+	int __percpu		*per_cpu_fw_alloc;	/* Not yet folded into
+							 * memory_allocated.
+							 */
 	struct percpu_counter	*sockets_allocated;	/* Current number of sockets. */
 	/*
 	 * Pressure flag: try to collapse.
@@ -1225,6 +1242,53 @@ static inline u64 memcg_memory_allocated_read(struct cg_proto *prot)
 	return ret >> PAGE_SHIFT;
 }
 
+/*
+ * Pages a cpu may charge to or uncharge from a protocol's memory_allocated
+ * before the change is folded into the shared counter, tunable as
+ * net.core.mem_pcpu_rsv.  Only used by protocols that provide
+ * per_cpu_fw_alloc; memory_allocated then lags by at most this much per
+ * cpu, which the tcp_mem style limits tolerate.  Use
+ * proto_memory_allocated_sum() where the exact value matters.
+ */
+#define SK_MEMORY_PCPU_RESERVE	(1 << (20 - PAGE_SHIFT))
+extern int sysctl_mem_pcpu_rsv;
+
+static inline long proto_memory_allocated_add(struct proto *prot, int amt)
+{
+	int local;
+
+	if (!prot->per_cpu_fw_alloc)
+		return atomic_long_add_return(amt, prot->memory_allocated);
+
+	preempt_disable();
+	local = __this_cpu_add_return(*prot->per_cpu_fw_alloc, amt);
+	if (local >= ACCESS_ONCE(sysctl_mem_pcpu_rsv)) {
+		__this_cpu_sub(*prot->per_cpu_fw_alloc, local);
+		atomic_long_add(local, prot->memory_allocated);
+	}
+	preempt_enable();
+
+	return atomic_long_read(prot->memory_allocated);
+}
+
+static inline void proto_memory_allocated_sub(struct proto *prot, int amt)
+{
+	int local;
+
+	if (!prot->per_cpu_fw_alloc) {
+		atomic_long_sub(amt, prot->memory_allocated);
+		return;
+	}
+
+	preempt_disable();
+	local = __this_cpu_sub_return(*prot->per_cpu_fw_alloc, amt);
+	if (local <= -ACCESS_ONCE(sysctl_mem_pcpu_rsv)) {
+		__this_cpu_sub(*prot->per_cpu_fw_alloc, local);
+		atomic_long_add(local, prot->memory_allocated);
+	}
+	preempt_enable();
+}
+
 static inline long
 sk_memory_allocated(const struct sock *sk)
 {
@@ -1243,11 +1307,11 @@ sk_memory_allocated_add(struct sock *sk, int amt, int *parent_status)
 	if (mem_cgroup_sockets_enabled && sk->sk_cgrp) {
 		memcg_memory_allocated_add(sk->sk_cgrp, amt, parent_status);
 		/* update the root cgroup regardless */
-		atomic_long_add_return(amt, prot->memory_allocated);
+		proto_memory_allocated_add(prot, amt);
 		return memcg_memory_allocated_read(sk->sk_cgrp);
 	}
 
-	return atomic_long_add_return(amt, prot->memory_allocated);
+	return proto_memory_allocated_add(prot, amt);
 }
 
 static inline void
@@ -1258,7 +1322,7 @@ sk_memory_allocated_sub(struct sock *sk, int amt)
 	if (mem_cgroup_sockets_enabled && sk->sk_cgrp)
 		memcg_memory_allocated_sub(sk->sk_cgrp, amt);
 
-	atomic_long_sub(amt, prot->memory_allocated);
+	proto_memory_allocated_sub(prot, amt);
 }
 
 static inline void sk_sockets_allocated_dec(struct sock *sk)
@@ -1312,6 +1376,8 @@ proto_memory_allocated(struct proto *prot)
 	return atomic_long_read(prot->memory_allocated);
 }
 
+long proto_memory_allocated_sum(struct proto *prot);
+
 static inline bool
 proto_memory_pressure(struct proto *prot)
 {
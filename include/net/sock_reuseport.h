@@ -0,0 +1,31 @@
+#ifndef _SOCK_REUSEPORT_H
+#define _SOCK_REUSEPORT_H
+
+#include <linux/filter.h>
+#include <linux/skbuff.h>
+#include <linux/types.h>
+#include <net/sock.h>
+
+/*
+ * All sockets bound to the same address and port with SO_REUSEPORT share
+ * one of these.  It gives each member a stable index, which a steering
+ * program attached with SO_ATTACH_REUSEPORT_CBPF returns to pick the
+ * socket for an incoming packet.
+ */
+struct sock_reuseport {
+	struct rcu_head		rcu;
+
+	u16			max_socks;	/* length of socks */
+	u16			num_socks;	/* elements in socks */
+	struct sk_filter __rcu	*prog;		/* optional steering program */
+	struct sock		*socks[0];	/* array of sock pointers */
+};
+
+int reuseport_alloc(struct sock *sk);
+int reuseport_add_sock(struct sock *sk, struct sock *sk2);
+void reuseport_detach_sock(struct sock *sk);
+struct sock *reuseport_select_sock(struct sock *sk, struct sk_buff *skb,
+				   int hdr_len);
+int reuseport_attach_prog(struct sock *sk, struct sk_filter *prog);
+
+#endif  /* _SOCK_REUSEPORT_H */
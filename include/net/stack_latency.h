@@ -0,0 +1,77 @@
+#ifndef _NET_STACK_LATENCY_H
+#define _NET_STACK_LATENCY_H
+
+/*
+ * Per-namespace histograms of where received packets spend their time.
+ *
+ * A packet is stamped when the driver hands it to the stack and at every
+ * later probe point; each probe accounts the time since the previous one
+ * to its stage.  Results are in /proc/net/stack_latency, collection is
+ * switched on with the net.core.stack_latency sysctl.
+ */
+
+#include <linux/skbuff.h>
+#include <linux/ktime.h>
+#include <linux/static_key.h>
+
+struct net;
+
+enum {
+	NET_LAT_DRIVER,		/* driver RX -> netif_receive_skb */
+	NET_LAT_IP,		/* netif_receive_skb -> transport rcv */
+	NET_LAT_TRANSPORT,	/* transport rcv -> socket receive queue */
+	NET_LAT_SOCKET,		/* socket receive queue -> recvmsg */
+	NET_LAT_MAX
+};
+
+/* Bucket i counts latencies in [2^(i-1), 2^i) ns, the last one the rest */
+#define NET_LAT_BUCKETS		32
+
+struct net_lat_hist {
+	u64	count[NET_LAT_MAX][NET_LAT_BUCKETS];
+};
+
+#ifdef CONFIG_NET_STACK_LATENCY
+extern struct static_key net_lat_needed;
+extern int sysctl_net_stack_latency;
+
+void __net_lat_stage(struct net *net, struct sk_buff *skb, int stage,
+		     bool last);
+
+/* Driver handed @skb to the stack: start timing it */
+static inline void net_lat_start(struct sk_buff *skb)
+{
+	if (static_key_false(&net_lat_needed))
+		skb->lat_stamp = ktime_get();
+}
+
+/* @skb finished @stage, which starts the next one */
+static inline void net_lat_stage(struct net *net, struct sk_buff *skb,
+				 int stage)
+{
+	if (static_key_false(&net_lat_needed))
+		__net_lat_stage(net, skb, stage, false);
+}
+
+/* @skb reached the application */
+static inline void net_lat_end(struct net *net, struct sk_buff *skb)
+{
+	if (static_key_false(&net_lat_needed))
+		__net_lat_stage(net, skb, NET_LAT_SOCKET, true);
+}
+#else
+static inline void net_lat_start(struct sk_buff *skb)
+{
+}
+
+static inline void net_lat_stage(struct net *net, struct sk_buff *skb,
+				 int stage)
+{
+}
+
+static inline void net_lat_end(struct net *net, struct sk_buff *skb)
+{
+}
+#endif /* CONFIG_NET_STACK_LATENCY */
+
+#endif /* _NET_STACK_LATENCY_H */
@@ -0,0 +1,95 @@
+#ifndef _TLS_OFFLOAD_H
+#define _TLS_OFFLOAD_H
+
+#include <linux/types.h>
+#include <linux/skbuff.h>
+#include <linux/scatterlist.h>
+#include <linux/crypto.h>
+
+#include <net/tcp.h>
+
+#include <uapi/linux/tls.h>
+
+/* Maximum data size carried in a TLS record */
+#define TLS_MAX_PAYLOAD_SIZE		((size_t)1 << 14)
+
+#define TLS_HEADER_SIZE			5
+#define TLS_NONCE_OFFSET		TLS_HEADER_SIZE
+
+#define TLS_RECORD_TYPE_DATA		0x17
+
+#define TLS_AAD_SPACE_SIZE		13
+
+/* header and explicit nonce in front of, tag behind the ciphertext */
+#define TLS_PREPEND_SIZE	(TLS_HEADER_SIZE + TLS_CIPHER_AES_GCM_128_IV_SIZE)
+#define TLS_OVERHEAD_SIZE	(TLS_PREPEND_SIZE + TLS_CIPHER_AES_GCM_128_TAG_SIZE)
+
+#define TLS_SG_MAX			MAX_SKB_FRAGS
+#define TLS_RECORD_PAGES_MAX	DIV_ROUND_UP(TLS_MAX_PAYLOAD_SIZE + \
+					     TLS_OVERHEAD_SIZE, PAGE_SIZE)
+
+enum {
+	TLS_BASE_TX,
+	TLS_SW_TX,
+	TLS_NUM_CONFIG,
+};
+
+/*
+ * Per socket state of the "tls" ULP, protected by the socket lock.
+ *
+ * Data is collected into sg_plaintext until a record is full or the
+ * sender doesn't announce more.  The record is then encrypted into
+ * freshly allocated pages, which are handed to TCP from sg_encrypted.
+ * If TCP can't take all of it, the rest is pushed before anything else
+ * is accepted.
+ */
+struct tls_context {
+	union {
+		struct tls_crypto_info crypto_send;
+		struct tls12_crypto_info_aes_gcm_128 crypto_send_aes_gcm_128;
+	};
+
+	u8 tx_conf;
+	u8 prot_idx;
+
+	/* record being filled, each entry holds a page reference */
+	struct scatterlist sg_plaintext[TLS_SG_MAX];
+	int sg_plaintext_num;
+	size_t plaintext_size;
+
+	/* page sendmsg() copies into and how much of it is used */
+	struct page *plain_page;
+	unsigned int plain_offset;
+
+	/* encrypted record not yet fully taken by TCP */
+	struct scatterlist sg_encrypted[TLS_RECORD_PAGES_MAX];
+	int sg_encrypted_num;
+	int pending_index;
+	unsigned int pending_offset;
+
+	struct crypto_aead *aead_send;
+	struct aead_request *aead_req;
+	char aad_space[TLS_AAD_SPACE_SIZE];
+	char iv[TLS_CIPHER_AES_GCM_128_SALT_SIZE +
+		TLS_CIPHER_AES_GCM_128_IV_SIZE];
+	char rec_seq[TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE];
+
+	/* the TCP proto this socket had before */
+	struct proto *sk_proto;
+};
+
+int tls_set_sw_offload(struct sock *sk, struct tls_context *ctx);
+void tls_sw_free_tx_resources(struct sock *sk);
+int tls_sw_sendmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
+		   size_t size);
+int tls_sw_sendpage(struct sock *sk, struct page *page,
+		    int offset, size_t size, int flags);
+
+static inline struct tls_context *tls_get_ctx(const struct sock *sk)
+{
+	struct inet_connection_sock *icsk = inet_csk(sk);
+
+	return icsk->icsk_ulp_data;
+}
+
+#endif /* _TLS_OFFLOAD_H */
@@ -0,0 +1,55 @@
+#ifndef _NET_XDP_H
+#define _NET_XDP_H
+
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+#include <uapi/linux/bpf.h>
+
+/*
+ * Early RX programs are classic BPF filters the driver runs on the raw
+ * receive buffer, before it allocates an skb.  The interpreter and the
+ * JITs load packet data through an sk_buff, so each RX ring keeps a
+ * scratch one whose data pointer is aimed at the frame for the duration
+ * of the run.  Only the fields read by classic loads and extensions are
+ * kept valid; the scratch skb never leaves the driver.
+ */
+struct xdp_buff {
+	struct sk_buff skb;
+};
+
+static inline void xdp_buff_init(struct xdp_buff *xdp, struct net_device *dev,
+				 u16 rx_queue)
+{
+	struct sk_buff *skb = &xdp->skb;
+
+	memset(skb, 0, sizeof(*skb));
+	skb->dev = dev;
+	skb_record_rx_queue(skb, rx_queue);
+	skb->pkt_type = PACKET_HOST;
+}
+
+/* Run @prog over @len bytes of frame at @data.  Must be called under
+ * rcu_read_lock(); returns the raw program result, see enum xdp_action.
+ */
+static inline u32 xdp_run_filter(const struct sk_filter *prog,
+				 struct xdp_buff *xdp,
+				 void *data, unsigned int len)
+{
+	struct sk_buff *skb = &xdp->skb;
+
+	skb->head = data;
+	skb->data = data;
+	skb->len = len;
+	skb_set_tail_pointer(skb, len);
+	skb_reset_mac_header(skb);
+	skb_set_network_header(skb, ETH_HLEN);
+	skb->protocol = len >= ETH_HLEN ? ((struct ethhdr *)data)->h_proto : 0;
+
+	return SK_RUN_FILTER(prog, skb);
+}
+
+int xdp_do_redirect(struct sk_buff *skb, u32 act);
+
+#endif /* _NET_XDP_H */
@@ -794,6 +794,11 @@ perf_trace_##call(void *__data, proto)					\
 									\
 	{ assign; }							\
 									\
+	if (!trace_event_call_bpf(event_call, entry)) {			\
+		perf_swevent_put_recursion_context(rctx);		\
+		return;							\
+	}								\
+									\
 	perf_trace_buf_submit(entry, __entry_size, rctx, __addr,	\
 		__count, &__regs, head, __task);			\
 }
@@ -699,9 +699,21 @@ __SYSCALL(__NR_sched_setattr, sys_sched_setattr)
 __SYSCALL(__NR_sched_getattr, sys_sched_getattr)
 #define __NR_renameat2 276
 __SYSCALL(__NR_renameat2, sys_renameat2)
+#define __NR_io_setup_sq 277
+__SYSCALL(__NR_io_setup_sq, sys_io_setup_sq)
+#define __NR_preadv2 278
+__SYSCALL(__NR_preadv2, sys_preadv2)
+#define __NR_pwritev2 279
+__SYSCALL(__NR_pwritev2, sys_pwritev2)
+#define __NR_bpf 280
+__SYSCALL(__NR_bpf, sys_bpf)
+#define __NR_getdents_stat 281
+__SYSCALL(__NR_getdents_stat, sys_getdents_stat)
+#define __NR_userfaultfd 282
+__SYSCALL(__NR_userfaultfd, sys_userfaultfd)
 
 #undef __NR_syscalls
-#define __NR_syscalls 277
+#define __NR_syscalls 283
 
 /*
  * All syscalls below here should go away really,
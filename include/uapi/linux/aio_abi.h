@@ -54,6 +54,36 @@ enum {
  */
 #define IOCB_FLAG_RESFD		(1 << 0)
 
+/*
+ * Valid flags for the "flags" member of "struct aio_sq_params".
+ *
+ * AIO_SQ_THREAD - Spawn a kernel thread that polls the submission ring,
+ *                 so that iocbs can be queued without calling io_submit().
+ */
+#define AIO_SQ_THREAD		(1 << 0)
+
+/*
+ * Bits in the "flags" member of "struct aio_sq_ring".
+ *
+ * AIO_SQ_NEED_WAKEUP - The submission thread went idle; userspace must
+ *                      call io_submit(ctx, 0, NULL) to restart it.
+ */
+#define AIO_SQ_NEED_WAKEUP	(1 << 0)
+
+/*
+ * Passed to io_setup_sq().  sq_entries and flags are filled in by the
+ * caller; the kernel rounds sq_entries up to a power of two and returns
+ * the offset of the submission ring within the aio context mapping in
+ * sq_off.
+ */
+struct aio_sq_params {
+	__u32	sq_entries;
+	__u32	flags;
+	__u32	sq_thread_idle;	/* msecs the thread polls before sleeping */
+	__u32	sq_off;
+	__u32	resv[4];
+};
+
 /* read() from /dev/aio returns these structures. */
 struct io_event {
 	__u64		data;		/* the data field from the iocb */
@@ -104,6 +134,25 @@ struct iocb {
 	__u32	aio_resfd;
 }; /* 64 bytes */
 
+/*
+ * Submission ring shared with userspace.  head and tail are free running
+ * counters, the slot for a counter value is (value & mask).  Userspace
+ * fills iocbs[tail & mask] and then advances tail; the kernel advances
+ * head once an iocb has been consumed.  iocbs that could not be submitted
+ * are counted in dropped.
+ */
+struct aio_sq_ring {
+	__u32		head;
+	__u32		tail;
+	__u32		mask;
+	__u32		entries;
+	__u32		flags;
+	__u32		dropped;
+	__u32		resv[10];
+
+	struct iocb	iocbs[0];
+}; /* 64 bytes + ring size */
+
 #undef IFBIG
 #undef IFLITTLE
 
@@ -0,0 +1,41 @@
+#ifndef _UAPI_LINUX_DIRENT_STAT_H
+#define _UAPI_LINUX_DIRENT_STAT_H
+
+#include <linux/types.h>
+
+/*
+ * Directory entry returned by getdents_stat(2): a linux_dirent64 with the
+ * attributes of the entry's inode, as lstat(2) would report them, placed
+ * before the name.  The layout is the same for 32 and 64 bit callers.
+ */
+struct linux_dirent_stat {
+	__u64	d_ino;
+	__s64	d_off;
+	__u16	d_reclen;
+	__u8	d_type;
+	__u8	d_stat_valid;	/* the st_ fields below are filled in */
+	__u32	st_mode;
+	__u32	st_nlink;
+	__u32	st_uid;
+	__u32	st_gid;
+	__u32	st_blksize;
+	__u64	st_rdev;
+	__u64	st_size;
+	__u64	st_blocks;
+	__s64	st_atime_sec;
+	__s64	st_mtime_sec;
+	__s64	st_ctime_sec;
+	__u32	st_atime_nsec;
+	__u32	st_mtime_nsec;
+	__u32	st_ctime_nsec;
+	__u32	__pad;
+	char	d_name[0];
+};
+
+/*
+ * Only report attributes of entries already in the dentry cache, the
+ * others are returned with d_stat_valid clear.
+ */
+#define GETDENTS_STAT_CACHED	0x0001
+
+#endif /* _UAPI_LINUX_DIRENT_STAT_H */
@@ -18,8 +18,11 @@ struct sock_extended_err {
 #define SO_EE_ORIGIN_ICMP	2
 #define SO_EE_ORIGIN_ICMP6	3
 #define SO_EE_ORIGIN_TXSTATUS	4
+#define SO_EE_ORIGIN_ZEROCOPY	5
 #define SO_EE_ORIGIN_TIMESTAMPING SO_EE_ORIGIN_TXSTATUS
 
+#define SO_EE_CODE_ZEROCOPY_COPIED	1
+
 #define SO_EE_OFFENDER(ee)	((struct sockaddr*)((ee)+1))
 
 
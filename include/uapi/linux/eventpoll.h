@@ -17,6 +17,7 @@
 /* For O_CLOEXEC */
 #include <linux/fcntl.h>
 #include <linux/types.h>
+#include <linux/ioctl.h>
 
 /* Flags for epoll_create1.  */
 #define EPOLL_CLOEXEC O_CLOEXEC
@@ -61,6 +62,20 @@ struct epoll_event {
 	__u64 data;
 } EPOLL_PACKED;
 
+/*
+ * Wakeup coalescing for an epoll instance.  epoll_wait() callers will not be
+ * woken until min_events descriptors became ready or max_wait_usecs passed
+ * since they started waiting, whichever comes first.  min_events <= 1
+ * disables coalescing.
+ */
+struct epoll_batch {
+	__u32 min_events;
+	__u32 max_wait_usecs;
+};
+
+#define EPIOCSBATCH	_IOW(0x8A, 0x01, struct epoll_batch)
+#define EPIOCGBATCH	_IOR(0x8A, 0x02, struct epoll_batch)
+
 #ifdef CONFIG_PM_SLEEP
 static inline void ep_take_care_of_epollwakeup(struct epoll_event *epev)
 {
@@ -755,4 +755,15 @@ struct fuse_notify_retrieve_in {
 	uint64_t	dummy4;
 };
 
+/*
+ * Device ioctls
+ *
+ * FUSE_DEV_IOC_CLONE: attach a newly opened /dev/fuse file to the
+ * connection of the /dev/fuse file descriptor passed as argument.  Each
+ * file is a separate channel: requests are queued on the channel of the
+ * submitting CPU, and reading a channel returns its own requests first.
+ */
+#define FUSE_DEV_IOC_MAGIC		229
+#define FUSE_DEV_IOC_CLONE		_IOR(FUSE_DEV_IOC_MAGIC, 0, uint32_t)
+
 #endif /* _LINUX_FUSE_H */
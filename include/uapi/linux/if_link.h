@@ -145,6 +145,7 @@ enum {
 	IFLA_CARRIER,
 	IFLA_PHYS_PORT_ID,
 	IFLA_CARRIER_CHANGES,
+	IFLA_XDP,
 	__IFLA_MAX
 };
 
@@ -555,4 +556,22 @@ enum {
 
 #define IFLA_HSR_MAX (__IFLA_HSR_MAX - 1)
 
+/* XDP section
+ *
+ * A classic BPF program run by the driver on each received frame before
+ * an skb is allocated for it.  Setting IFLA_XDP without IFLA_XDP_OPS
+ * detaches the current program.  The return value is an enum xdp_action
+ * from <linux/bpf.h>.
+ */
+
+enum {
+	IFLA_XDP_UNSPEC,
+	IFLA_XDP_OPS_LEN,	/* u16: number of struct sock_filter */
+	IFLA_XDP_OPS,		/* array of struct sock_filter */
+	IFLA_XDP_ATTACHED,	/* u8: dump only */
+	__IFLA_XDP_MAX,
+};
+
+#define IFLA_XDP_MAX (__IFLA_XDP_MAX - 1)
+
 #endif /* _UAPI_LINUX_IF_LINK_H */
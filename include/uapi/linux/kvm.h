@@ -172,6 +172,7 @@ struct kvm_pit_config {
 #define KVM_EXIT_S390_TSCH        22
 #define KVM_EXIT_EPR              23
 #define KVM_EXIT_SYSTEM_EVENT     24
+#define KVM_EXIT_DIRTY_RING_FULL  25
 
 /* For KVM_EXIT_INTERNAL_ERROR */
 /* Emulate instruction failed. */
@@ -381,6 +382,26 @@ struct kvm_dirty_log {
 	};
 };
 
+/*
+ * Entry of the per-vcpu dirty ring, mmap'ed from the vcpu fd at
+ * KVM_DIRTY_LOG_PAGE_OFFSET.  The kernel publishes an entry by setting
+ * KVM_DIRTY_GFN_F_DIRTY, userspace hands it back by setting
+ * KVM_DIRTY_GFN_F_RESET once it has collected the page, and
+ * KVM_RESET_DIRTY_RINGS then write protects collected pages again.
+ */
+#define KVM_DIRTY_GFN_F_DIRTY	(1 << 0)
+#define KVM_DIRTY_GFN_F_RESET	(1 << 1)
+
+struct kvm_dirty_gfn {
+	__u32 flags;
+	__u32 slot;		/* memslot id */
+	__u64 offset;		/* page offset into the memslot */
+};
+
+#ifndef KVM_DIRTY_LOG_PAGE_OFFSET
+#define KVM_DIRTY_LOG_PAGE_OFFSET 0
+#endif
+
 /* for KVM_SET_SIGNAL_MASK */
 struct kvm_signal_mask {
 	__u32 len;
@@ -758,6 +779,7 @@ struct kvm_ppc_smmu_info {
 #define KVM_CAP_VM_ATTRIBUTES 101
 #define KVM_CAP_ARM_PSCI_0_2 102
 #define KVM_CAP_PPC_FIXUP_HCALL 103
+#define KVM_CAP_DIRTY_LOG_RING 104
 
 #ifdef KVM_CAP_IRQ_ROUTING
 
@@ -1124,6 +1146,8 @@ struct kvm_s390_ucas_mapping {
 #define KVM_ARM_VCPU_INIT	  _IOW(KVMIO,  0xae, struct kvm_vcpu_init)
 #define KVM_ARM_PREFERRED_TARGET  _IOR(KVMIO,  0xaf, struct kvm_vcpu_init)
 #define KVM_GET_REG_LIST	  _IOWR(KVMIO, 0xb0, struct kvm_reg_list)
+/* Available with KVM_CAP_DIRTY_LOG_RING */
+#define KVM_RESET_DIRTY_RINGS	  _IO(KVMIO,   0xc7)
 
 #define KVM_DEV_ASSIGN_ENABLE_IOMMU	(1 << 0)
 #define KVM_DEV_ASSIGN_PCI_2_3		(1 << 1)
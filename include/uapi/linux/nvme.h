@@ -90,6 +90,7 @@ enum {
 	NVME_CTRL_ONCS_WRITE_UNCORRECTABLE	= 1 << 1,
 	NVME_CTRL_ONCS_DSM			= 1 << 2,
 	NVME_CTRL_VWC_PRESENT			= 1 << 0,
+	NVME_CTRL_SGLS_SUPPORTED		= 1 << 0,
 };
 
 struct nvme_lbaf {
@@ -192,6 +193,26 @@ enum nvme_opcode {
 	nvme_cmd_dsm		= 0x09,
 };
 
+/*
+ * Data pointer as a scatter gather list descriptor, it takes the place of
+ * both PRP entries in the command.
+ */
+struct nvme_sgl_desc {
+	__le64			addr;
+	__le32			length;
+	__u8			rsvd[3];
+	__u8			type;
+};
+
+enum {
+	NVME_SGL_FMT_DATA_DESC		= 0x00,
+	NVME_SGL_FMT_SEG_DESC		= 0x02,
+	NVME_SGL_FMT_LAST_SEG_DESC	= 0x03,
+};
+
+/* PSDT field of the command flags */
+#define NVME_CMD_SGL_METABUF	(1 << 6)
+
 struct nvme_common_command {
 	__u8			opcode;
 	__u8			flags;
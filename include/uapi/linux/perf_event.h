@@ -303,7 +303,10 @@ struct perf_event_attr {
 				exclude_callchain_user   : 1, /* exclude user callchains */
 				mmap2          :  1, /* include mmap with inode data     */
 				comm_exec      :  1, /* flag comm events that are due to an exec */
-				__reserved_1   : 39;
+				write_backward :  1, /* Write ring buffer from end to beginning */
+				cgroup_count   :  1, /* count per attached cgroup */
+				aggregate_stacks : 1, /* aggregate callchains in kernel */
+				__reserved_1   : 36;
 
 	union {
 		__u32		wakeup_events;	  /* wakeup every n events */
@@ -349,11 +352,27 @@ struct perf_event_attr {
 #define PERF_EVENT_IOC_SET_OUTPUT	_IO ('$', 5)
 #define PERF_EVENT_IOC_SET_FILTER	_IOW('$', 6, char *)
 #define PERF_EVENT_IOC_ID		_IOR('$', 7, __u64 *)
+#define PERF_EVENT_IOC_PAUSE_OUTPUT	_IOW('$', 8, __u32)
+#define PERF_EVENT_IOC_ATTACH_CGROUP	_IOW('$', 9, __u32)
+#define PERF_EVENT_IOC_READ_CGROUP	_IOWR('$', 10, struct perf_event_cgroup_read)
 
 enum perf_event_ioc_flags {
 	PERF_IOC_FLAG_GROUP		= 1U << 0,
 };
 
+/*
+ * Argument of PERF_EVENT_IOC_READ_CGROUP on an attr.cgroup_count event.
+ * The caller fills in cgroup_fd with a cgroup directory previously
+ * attached with PERF_EVENT_IOC_ATTACH_CGROUP, and gets back the count
+ * and the time accumulated on the event's cpu while tasks of that cgroup
+ * (or of its descendants) were running.
+ */
+struct perf_event_cgroup_read {
+	__u64	cgroup_fd;
+	__u64	value;
+	__u64	time_enabled;
+};
+
 /*
  * Structure of the page that can be mapped via mmap
  */
@@ -492,6 +511,24 @@ struct perf_event_mmap_page {
 	 */
 	__u64   data_head;		/* head in the data section */
 	__u64	data_tail;		/* user-space written tail */
+	__u64	data_offset;		/* where the buffer starts */
+	__u64	data_size;		/* data buffer size */
+
+	/*
+	 * AUX area is defined by aux_{offset,size} fields that should be set
+	 * by the userspace, so that
+	 *
+	 *   aux_offset >= data_offset + data_size
+	 *
+	 * prior to mmap()ing it. Size of the mmap()ed area should be aux_size.
+	 *
+	 * Ring buffer pointers aux_{head,tail} have the same semantics as
+	 * data_{head,tail} and same ordering rules apply.
+	 */
+	__u64	aux_head;
+	__u64	aux_tail;
+	__u64	aux_offset;
+	__u64	aux_size;
 };
 
 #define PERF_RECORD_MISC_CPUMODE_MASK		(7 << 0)
@@ -712,9 +749,47 @@ enum perf_event_type {
 	 */
 	PERF_RECORD_MMAP2			= 10,
 
+	/*
+	 * Records that new data landed in the AUX buffer part.
+	 *
+	 * struct {
+	 * 	struct perf_event_header	header;
+	 *
+	 * 	u64				aux_offset;
+	 * 	u64				aux_size;
+	 *	u64				flags;
+	 * 	struct sample_id		sample_id;
+	 * };
+	 */
+	PERF_RECORD_AUX				= 11,
+
+	/*
+	 * Emitted instead of PERF_RECORD_SAMPLE by attr.aggregate_stacks
+	 * events: a unique (pid, callchain) with the number of samples that
+	 * hit it and the sum of their periods since the last such record.
+	 *
+	 * struct {
+	 *	struct perf_event_header	header;
+	 *
+	 *	u32				pid;
+	 *	u32				nr;
+	 *	u64				count;
+	 *	u64				period;
+	 *	u64				ips[nr];
+	 *	struct sample_id		sample_id;
+	 * };
+	 */
+	PERF_RECORD_STACK_COUNT			= 12,
+
 	PERF_RECORD_MAX,			/* non-ABI */
 };
 
+/*
+ * PERF_RECORD_AUX::flags bits
+ */
+#define PERF_AUX_FLAG_TRUNCATED		0x01	/* record was truncated to fit */
+#define PERF_AUX_FLAG_OVERWRITE		0x02	/* snapshot from overwrite mode */
+
 #define PERF_MAX_STACK_DEPTH		127
 
 enum perf_callchain_context {
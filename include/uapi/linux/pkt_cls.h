@@ -116,6 +116,10 @@ enum {
 
 #define TCA_ID_MAX __TCA_ID_MAX
 
+/* Classifier flags */
+#define TCA_CLS_FLAGS_SKIP_HW	(1 << 0) /* don't offload filter to HW */
+#define TCA_CLS_FLAGS_SKIP_SW	(1 << 1) /* don't use filter in SW */
+
 struct tc_police {
 	__u32			index;
 	int			action;
@@ -188,6 +192,7 @@ enum {
 	TCA_U32_INDEV,
 	TCA_U32_PCNT,
 	TCA_U32_MARK,
+	TCA_U32_FLAGS,
 	__TCA_U32_MAX
 };
 
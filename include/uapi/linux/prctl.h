@@ -152,4 +152,13 @@
 #define PR_SET_THP_DISABLE	41
 #define PR_GET_THP_DISABLE	42
 
+/*
+ * Give the process its own hash table for PROCESS_PRIVATE futexes.
+ * arg2 is the number of hash slots (rounded up to a power of two),
+ * 0 returns the process to the global table.  Only allowed while the
+ * mm has a single user.
+ */
+#define PR_SET_FUTEX_HASH	43
+#define PR_GET_FUTEX_HASH	44
+
 #endif /* _LINUX_PRCTL_H */
@@ -0,0 +1,44 @@
+#ifndef _UAPI_TRACE_MMAP_H_
+#define _UAPI_TRACE_MMAP_H_
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/*
+ * Memory mapped per-cpu ring buffer, see trace_pipe_raw.
+ *
+ * The mapping starts with a meta page holding struct trace_buffer_meta,
+ * followed by nr_subbufs sub-buffers of subbuf_size bytes.  Each
+ * sub-buffer is a ring buffer data page, in the format described by
+ * events/header_page.  Sub-buffer "id" lives at offset
+ * meta_page_size + id * subbuf_size in the mapping.
+ *
+ * TRACE_MMAP_IOCTL_GET_READER consumes what the previous call handed
+ * out, and points reader at the next data to read: the events between
+ * reader.read and reader.commit in sub-buffer reader.id, both offsets
+ * into the data that follows the sub-buffer header.  It blocks
+ * while the buffer is empty unless the file is O_NONBLOCK.
+ */
+struct trace_buffer_meta {
+	__u32	meta_page_size;
+	__u32	meta_struct_len;
+
+	__u32	subbuf_size;
+	__u32	nr_subbufs;
+
+	struct {
+		__u64	lost_events;	/* lost before this sub-buffer */
+		__u32	id;
+		__u32	read;		/* first unread byte of data */
+		__u32	commit;		/* end of the data handed out */
+		__u32	__reserved;
+	} reader;
+
+	__u64	entries;
+	__u64	overrun;
+	__u64	read;
+};
+
+#define TRACE_MMAP_IOCTL_GET_READER		_IO('T', 0x1)
+
+#endif /* _UAPI_TRACE_MMAP_H_ */
@@ -63,6 +63,13 @@ struct vhost_memory {
 	struct vhost_memory_region regions[0];
 };
 
+struct vhost_worker_state {
+	/* Set by VHOST_NEW_WORKER, 0 is the device's default worker */
+	__u32 worker_id;
+	/* CPU to run the new worker on, -1 for any */
+	__s32 cpu;
+};
+
 /* ioctls */
 
 #define VHOST_VIRTIO 0xAF
@@ -92,6 +99,11 @@ struct vhost_memory {
 /* Specify an eventfd file descriptor to signal on log write. */
 #define VHOST_SET_LOG_FD _IOW(VHOST_VIRTIO, 0x07, int)
 
+/* Create another worker thread for the device, on top of the default one
+ * VHOST_SET_OWNER starts.  Virtqueues are attached to a worker with
+ * VHOST_ATTACH_VRING_WORKER. */
+#define VHOST_NEW_WORKER _IOWR(VHOST_VIRTIO, 0x08, struct vhost_worker_state)
+
 /* Ring setup. */
 /* Set number of descriptors in ring. This parameter can not
  * be modified while ring is running (bound to a device). */
@@ -112,6 +124,16 @@ struct vhost_memory {
 #define VHOST_SET_VRING_CALL _IOW(VHOST_VIRTIO, 0x21, struct vhost_vring_file)
 /* Set eventfd to signal an error */
 #define VHOST_SET_VRING_ERR _IOW(VHOST_VIRTIO, 0x22, struct vhost_vring_file)
+/* How long the worker busy polls the ring before it waits for a kick, in
+ * microseconds.  0 (the default) disables busy polling. */
+#define VHOST_SET_VRING_BUSYLOOP_TIMEOUT _IOW(VHOST_VIRTIO, 0x23,	\
+					 struct vhost_vring_state)
+#define VHOST_GET_VRING_BUSYLOOP_TIMEOUT _IOW(VHOST_VIRTIO, 0x24,	\
+					 struct vhost_vring_state)
+/* Run the ring on the worker with id num.  The ring must not have a
+ * backend attached. */
+#define VHOST_ATTACH_VRING_WORKER _IOW(VHOST_VIRTIO, 0x25,		\
+				       struct vhost_vring_state)
 
 /* VHOST_NET specific defines */
 
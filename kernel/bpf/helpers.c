@@ -0,0 +1,56 @@
+/*
+ * Map helpers callable from BPF programs through BPF_CALL
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ */
+#include <linux/bpf.h>
+#include <linux/export.h>
+#include <linux/rcupdate.h>
+
+/* If a program calls the helpers below, it does so under rcu_read_lock(),
+ * like every program run via SK_RUN_FILTER().  The element pointer returned
+ * by bpf_map_lookup_elem() stays valid for as long as that rcu read-side
+ * section lasts, and the map itself is kept alive by the owner of the
+ * program holding a bpf_map_get() reference.
+ */
+u64 bpf_map_lookup_elem(u64 r1, u64 r2, u64 r3, u64 r4, u64 r5)
+{
+	struct bpf_map *map = (struct bpf_map *) (unsigned long) r1;
+	void *key = (void *) (unsigned long) r2;
+	void *value;
+
+	WARN_ON_ONCE(!rcu_read_lock_held());
+
+	value = map->ops->map_lookup_elem(map, key);
+
+	/* lookup() returns either pointer to element value or NULL,
+	 * which is the meaning of the R0 result for the caller
+	 */
+	return (unsigned long) value;
+}
+EXPORT_SYMBOL_GPL(bpf_map_lookup_elem);
+
+u64 bpf_map_update_elem(u64 r1, u64 r2, u64 r3, u64 r4, u64 r5)
+{
+	struct bpf_map *map = (struct bpf_map *) (unsigned long) r1;
+	void *key = (void *) (unsigned long) r2;
+	void *value = (void *) (unsigned long) r3;
+
+	WARN_ON_ONCE(!rcu_read_lock_held());
+
+	return map->ops->map_update_elem(map, key, value, r4);
+}
+EXPORT_SYMBOL_GPL(bpf_map_update_elem);
+
+u64 bpf_map_delete_elem(u64 r1, u64 r2, u64 r3, u64 r4, u64 r5)
+{
+	struct bpf_map *map = (struct bpf_map *) (unsigned long) r1;
+	void *key = (void *) (unsigned long) r2;
+
+	WARN_ON_ONCE(!rcu_read_lock_held());
+
+	return map->ops->map_delete_elem(map, key);
+}
+EXPORT_SYMBOL_GPL(bpf_map_delete_elem);
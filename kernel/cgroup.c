@@ -477,8 +477,13 @@ static void cgroup_update_populated(struct cgroup *cgrp, bool populated)
  * hash table for cgroup groups. This improves the performance to find
  * an existing css_set. This hash doesn't (currently) take into
  * account cgroups in empty hierarchies.
+ *
+ * Hosts running many containers easily have thousands of css_sets and
+ * every miss in a chain costs a compare_css_sets() walk of the
+ * cgrp_links list, so size the table for that rather than for a
+ * handful of hierarchies.
  */
-#define CSS_SET_HASH_BITS	7
+#define CSS_SET_HASH_BITS	10
 static DEFINE_HASHTABLE(css_set_table, CSS_SET_HASH_BITS);
 
 static unsigned long css_set_hash(struct cgroup_subsys_state *css[])
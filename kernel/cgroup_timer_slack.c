@@ -0,0 +1,165 @@
+/*
+ * cgroup_timer_slack.c - control group timer slack subsystem
+ *
+ * Lets a cgroup impose a minimum timer slack on its tasks.  The slack of
+ * a task's hrtimer based sleeps (nanosleep, select/poll, futex waits)
+ * becomes the larger of its own prctl(PR_SET_TIMERSLACK) value and the
+ * effective minimum of its cgroup.  The effective minimum of a cgroup is
+ * the largest min_slack_ns configured on it or on any of its ancestors,
+ * so a parent can relax the wakeups of a whole subtree.
+ *
+ * hrtimers with a slack range expire together with any earlier timer
+ * whose expiry falls inside that range, so a larger slack lets mostly
+ * idle groups piggyback on wakeups that are happening anyway.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/cgroup.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+
+struct timer_slack_cgroup {
+	struct cgroup_subsys_state	css;
+	/* written by the user */
+	unsigned long			min_slack_ns;
+	/* max of min_slack_ns over this cgroup and its ancestors */
+	unsigned long			effective_slack_ns;
+};
+
+/* Serialises updates of effective_slack_ns across the hierarchy */
+static DEFINE_MUTEX(timer_slack_mutex);
+
+static inline struct timer_slack_cgroup *
+css_timer_slack(struct cgroup_subsys_state *css)
+{
+	return css ? container_of(css, struct timer_slack_cgroup, css) : NULL;
+}
+
+static inline struct timer_slack_cgroup *
+task_timer_slack(struct task_struct *task)
+{
+	return css_timer_slack(task_css(task, timer_slack_cgrp_id));
+}
+
+static inline struct timer_slack_cgroup *
+parent_timer_slack(struct timer_slack_cgroup *tslack)
+{
+	return css_timer_slack(tslack->css.parent);
+}
+
+/**
+ * task_get_effective_timer_slack - slack to apply to @tsk's timers
+ * @tsk: task of interest
+ *
+ * Returns the larger of @tsk's own timer slack and the minimum imposed
+ * by its timer_slack cgroup.
+ */
+unsigned long task_get_effective_timer_slack(struct task_struct *tsk)
+{
+	unsigned long slack;
+
+	rcu_read_lock();
+	slack = ACCESS_ONCE(task_timer_slack(tsk)->effective_slack_ns);
+	rcu_read_unlock();
+
+	return max(tsk->timer_slack_ns, slack);
+}
+
+static struct cgroup_subsys_state *
+timer_slack_css_alloc(struct cgroup_subsys_state *parent_css)
+{
+	struct timer_slack_cgroup *tslack;
+
+	tslack = kzalloc(sizeof(*tslack), GFP_KERNEL);
+	if (!tslack)
+		return ERR_PTR(-ENOMEM);
+
+	return &tslack->css;
+}
+
+static int timer_slack_css_online(struct cgroup_subsys_state *css)
+{
+	struct timer_slack_cgroup *tslack = css_timer_slack(css);
+	struct timer_slack_cgroup *parent = parent_timer_slack(tslack);
+
+	mutex_lock(&timer_slack_mutex);
+	if (parent)
+		tslack->effective_slack_ns = parent->effective_slack_ns;
+	mutex_unlock(&timer_slack_mutex);
+	return 0;
+}
+
+static void timer_slack_css_free(struct cgroup_subsys_state *css)
+{
+	kfree(css_timer_slack(css));
+}
+
+static u64 timer_slack_min_read(struct cgroup_subsys_state *css,
+				struct cftype *cft)
+{
+	return css_timer_slack(css)->min_slack_ns;
+}
+
+static int timer_slack_min_write(struct cgroup_subsys_state *css,
+				 struct cftype *cft, u64 val)
+{
+	struct timer_slack_cgroup *tslack = css_timer_slack(css);
+	struct cgroup_subsys_state *pos;
+
+	if (val > ULONG_MAX)
+		return -EINVAL;
+
+	/*
+	 * Recompute the effective slack of @css and all its descendants in
+	 * pre-order, so that each one sees its parent's new value.
+	 */
+	mutex_lock(&timer_slack_mutex);
+	tslack->min_slack_ns = val;
+
+	rcu_read_lock();
+	css_for_each_descendant_pre(pos, css) {
+		struct timer_slack_cgroup *pos_t = css_timer_slack(pos);
+		struct timer_slack_cgroup *parent = parent_timer_slack(pos_t);
+		unsigned long slack = pos_t->min_slack_ns;
+
+		if (parent)
+			slack = max(slack, parent->effective_slack_ns);
+		ACCESS_ONCE(pos_t->effective_slack_ns) = slack;
+	}
+	rcu_read_unlock();
+	mutex_unlock(&timer_slack_mutex);
+
+	return 0;
+}
+
+static u64 timer_slack_effective_read(struct cgroup_subsys_state *css,
+				      struct cftype *cft)
+{
+	return ACCESS_ONCE(css_timer_slack(css)->effective_slack_ns);
+}
+
+static struct cftype files[] = {
+	{
+		.name = "min_slack_ns",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = timer_slack_min_read,
+		.write_u64 = timer_slack_min_write,
+	},
+	{
+		.name = "effective_slack_ns",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = timer_slack_effective_read,
+	},
+	{ }	/* terminate */
+};
+
+struct cgroup_subsys timer_slack_cgrp_subsys = {
+	.css_alloc	= timer_slack_css_alloc,
+	.css_online	= timer_slack_css_online,
+	.css_free	= timer_slack_css_free,
+	.base_cftypes	= files,
+};
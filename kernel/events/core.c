@@ -18,6 +18,7 @@
 #include <linux/poll.h>
 #include <linux/slab.h>
 #include <linux/hash.h>
+#include <linux/jhash.h>
 #include <linux/tick.h>
 #include <linux/sysfs.h>
 #include <linux/dcache.h>
@@ -304,6 +305,7 @@ static void cpu_ctx_sched_in(struct perf_cpu_context *cpuctx,
 
 static void update_context_time(struct perf_event_context *ctx);
 static u64 perf_event_time(struct perf_event *event);
+static void perf_stack_agg_flush_group(struct perf_event *leader);
 
 void __weak perf_event_print_debug(void)	{ }
 
@@ -474,6 +476,278 @@ perf_cgroup_set_timestamp(struct task_struct *task,
 	info->timestamp = ctx->timestamp;
 }
 
+/*
+ * An attr.cgroup_count event is a single counting event per cpu that
+ * keeps a separate count for every attached cgroup.  When the cgroup
+ * changes on a context switch, the count accumulated since the previous
+ * switch is credited to the outgoing task's cgroup and its ancestors.
+ * Unlike one cgroup event per monitored cgroup, this never reprograms
+ * the pmu on a cgroup switch, so its cost doesn't grow with the number
+ * of cgroups.
+ */
+#define PERF_CGROUP_NODE_HASH_BITS	6
+
+struct perf_cgroup_node {
+	struct hlist_node		node;
+	struct perf_cgroup		*cgrp;
+	u64				count;
+	u64				time;
+};
+
+static inline int is_cgroup_count_event(struct perf_event *event)
+{
+	return event->attr.cgroup_count;
+}
+
+static struct perf_cgroup_node *
+perf_cgroup_node_find(struct perf_event *event, struct perf_cgroup *cgrp)
+{
+	struct perf_cgroup_node *cn;
+	struct hlist_head *head;
+
+	if (!event->cgrp_node_hash)
+		return NULL;
+
+	head = &event->cgrp_node_hash[hash_ptr(cgrp, PERF_CGROUP_NODE_HASH_BITS)];
+	hlist_for_each_entry(cn, head, node) {
+		if (cn->cgrp == cgrp)
+			return cn;
+	}
+
+	return NULL;
+}
+
+/*
+ * Credit what @event counted since the last update to @cgrp and its
+ * ancestors, cgroup scoping being recursive as for cgroup events.
+ * Called on the event's cpu with ctx->lock held.
+ */
+static void perf_cgroup_node_update(struct perf_event *event,
+				    struct perf_cgroup *cgrp)
+{
+	struct cgroup_subsys_state *css;
+	struct perf_cgroup_node *cn;
+	u64 count, now, delta, time;
+
+	if (event->state == PERF_EVENT_STATE_ACTIVE)
+		event->pmu->read(event);
+
+	count = local64_read(&event->count);
+	now = perf_clock();
+
+	/* PERF_EVENT_IOC_RESET moved the count back */
+	if (count < event->cgrp_node_count)
+		event->cgrp_node_count = 0;
+
+	delta = count - event->cgrp_node_count;
+	time = now - event->cgrp_node_time;
+	event->cgrp_node_count = count;
+	event->cgrp_node_time = now;
+
+	if (!event->cgrp_node_hash)
+		return;
+
+	for (css = &cgrp->css; css; css = css->parent) {
+		cn = perf_cgroup_node_find(event,
+				container_of(css, struct perf_cgroup, css));
+		if (cn) {
+			cn->count += delta;
+			cn->time += time;
+		}
+	}
+}
+
+static void perf_cgroup_node_sched_out(struct perf_cpu_context *cpuctx,
+				       struct task_struct *task)
+{
+	struct perf_cgroup *cgrp = perf_cgroup_from_task(task);
+	struct perf_event *event;
+
+	list_for_each_entry(event, &cpuctx->cgrp_node_list, cgrp_node_entry)
+		perf_cgroup_node_update(event, cgrp);
+}
+
+/* Must be called with ctx->lock held; ctx is the event's cpu context. */
+static inline void
+perf_cgroup_node_list_add(struct perf_event *event,
+			  struct perf_event_context *ctx)
+{
+	struct perf_cpu_context *cpuctx;
+
+	cpuctx = container_of(ctx, struct perf_cpu_context, ctx);
+	event->cgrp_node_count = local64_read(&event->count);
+	event->cgrp_node_time = perf_clock();
+	list_add(&event->cgrp_node_entry, &cpuctx->cgrp_node_list);
+}
+
+static inline void perf_cgroup_node_list_del(struct perf_event *event)
+{
+	list_del(&event->cgrp_node_entry);
+}
+
+static void perf_cgroup_node_free(struct perf_event *event)
+{
+	struct perf_cgroup_node *cn;
+	struct hlist_node *tmp;
+	int i;
+
+	if (!event->cgrp_node_hash)
+		return;
+
+	for (i = 0; i < (1 << PERF_CGROUP_NODE_HASH_BITS); i++) {
+		hlist_for_each_entry_safe(cn, tmp, &event->cgrp_node_hash[i],
+					  node) {
+			css_put(&cn->cgrp->css);
+			kfree(cn);
+		}
+	}
+
+	kfree(event->cgrp_node_hash);
+	event->cgrp_node_hash = NULL;
+}
+
+static struct perf_cgroup *perf_cgroup_get_from_fd(int fd)
+{
+	struct cgroup_subsys_state *css;
+	struct fd f = fdget(fd);
+
+	if (!f.file)
+		return ERR_PTR(-EBADF);
+
+	css = css_tryget_online_from_dir(f.file->f_dentry,
+					 &perf_event_cgrp_subsys);
+	fdput(f);
+	if (IS_ERR(css))
+		return ERR_CAST(css);
+
+	return container_of(css, struct perf_cgroup, css);
+}
+
+static int perf_event_attach_cgroup(struct perf_event *event, int fd)
+{
+	struct perf_event_context *ctx = event->ctx;
+	struct hlist_head *hash = NULL;
+	struct perf_cgroup_node *cn;
+	struct perf_cgroup *cgrp;
+	int ret = 0;
+
+	if (!is_cgroup_count_event(event))
+		return -EINVAL;
+
+	cgrp = perf_cgroup_get_from_fd(fd);
+	if (IS_ERR(cgrp))
+		return PTR_ERR(cgrp);
+
+	cn = kzalloc(sizeof(*cn), GFP_KERNEL);
+	if (!cn) {
+		ret = -ENOMEM;
+		goto err;
+	}
+	cn->cgrp = cgrp;
+
+	mutex_lock(&ctx->mutex);
+	if (!event->cgrp_node_hash) {
+		hash = kcalloc(1 << PERF_CGROUP_NODE_HASH_BITS,
+			       sizeof(struct hlist_head), GFP_KERNEL);
+		if (!hash) {
+			ret = -ENOMEM;
+			goto unlock;
+		}
+	}
+
+	raw_spin_lock_irq(&ctx->lock);
+	if (hash)
+		event->cgrp_node_hash = hash;
+	if (perf_cgroup_node_find(event, cgrp))
+		ret = -EEXIST;
+	else
+		hlist_add_head(&cn->node, &event->cgrp_node_hash[
+				hash_ptr(cgrp, PERF_CGROUP_NODE_HASH_BITS)]);
+	raw_spin_unlock_irq(&ctx->lock);
+unlock:
+	mutex_unlock(&ctx->mutex);
+	if (!ret)
+		return 0;
+
+	kfree(cn);
+err:
+	css_put(&cgrp->css);
+	return ret;
+}
+
+struct perf_cgroup_read_data {
+	struct perf_event		*event;
+	struct perf_cgroup		*cgrp;
+	u64				count;
+	u64				time;
+	int				ret;
+};
+
+static void __perf_event_read_cgroup(void *info)
+{
+	struct perf_cgroup_read_data *data = info;
+	struct perf_event *event = data->event;
+	struct perf_event_context *ctx = event->ctx;
+	struct perf_cgroup_node *cn;
+
+	raw_spin_lock(&ctx->lock);
+	/*
+	 * Everything counted since the last cgroup switch belongs to the
+	 * cgroup running now.  When the cpu is offline nothing is pending.
+	 */
+	if (event->cpu == smp_processor_id()) {
+		rcu_read_lock();
+		perf_cgroup_node_update(event, perf_cgroup_from_task(current));
+		rcu_read_unlock();
+	}
+
+	cn = perf_cgroup_node_find(event, data->cgrp);
+	if (cn) {
+		data->count = cn->count;
+		data->time = cn->time;
+		data->ret = 0;
+	}
+	raw_spin_unlock(&ctx->lock);
+}
+
+static int perf_event_read_cgroup(struct perf_event *event,
+				  struct perf_event_cgroup_read __user *uread)
+{
+	struct perf_cgroup_read_data data = {
+		.event	= event,
+		.ret	= -ENOENT,
+	};
+	struct perf_event_cgroup_read read;
+
+	if (!is_cgroup_count_event(event))
+		return -EINVAL;
+
+	if (copy_from_user(&read, uread, sizeof(read)))
+		return -EFAULT;
+
+	data.cgrp = perf_cgroup_get_from_fd(read.cgroup_fd);
+	if (IS_ERR(data.cgrp))
+		return PTR_ERR(data.cgrp);
+
+	if (smp_call_function_single(event->cpu, __perf_event_read_cgroup,
+				     &data, 1)) {
+		local_irq_disable();
+		__perf_event_read_cgroup(&data);
+		local_irq_enable();
+	}
+	css_put(&data.cgrp->css);
+
+	if (data.ret)
+		return data.ret;
+
+	read.value = data.count;
+	read.time_enabled = data.time;
+	if (copy_to_user(uread, &read, sizeof(read)))
+		return -EFAULT;
+
+	return 0;
+}
+
 #define PERF_CGROUP_SWOUT	0x1 /* cgroup switch out every event */
 #define PERF_CGROUP_SWIN	0x2 /* cgroup switch in events based on task */
 
@@ -507,6 +781,13 @@ void perf_cgroup_switch(struct task_struct *task, int mode)
 		if (cpuctx->unique_pmu != pmu)
 			continue; /* ensure we process each cpuctx once */
 
+		if ((mode & PERF_CGROUP_SWOUT) &&
+		    !list_empty(&cpuctx->cgrp_node_list)) {
+			perf_ctx_lock(cpuctx, cpuctx->task_ctx);
+			perf_cgroup_node_sched_out(cpuctx, task);
+			perf_ctx_unlock(cpuctx, cpuctx->task_ctx);
+		}
+
 		/*
 		 * perf_cgroup_events says at least one
 		 * context on this CPU has cgroup events.
@@ -690,6 +971,37 @@ static inline int is_cgroup_event(struct perf_event *event)
 	return 0;
 }
 
+static inline int is_cgroup_count_event(struct perf_event *event)
+{
+	return 0;
+}
+
+static inline void
+perf_cgroup_node_list_add(struct perf_event *event,
+			  struct perf_event_context *ctx)
+{
+}
+
+static inline void perf_cgroup_node_list_del(struct perf_event *event)
+{
+}
+
+static inline void perf_cgroup_node_free(struct perf_event *event)
+{
+}
+
+static inline int perf_event_attach_cgroup(struct perf_event *event, int fd)
+{
+	return -EINVAL;
+}
+
+static inline int
+perf_event_read_cgroup(struct perf_event *event,
+		       struct perf_event_cgroup_read __user *uread)
+{
+	return -EINVAL;
+}
+
 static inline u64 perf_cgroup_event_cgrp_time(struct perf_event *event)
 {
 	return 0;
@@ -1136,6 +1448,9 @@ list_add_event(struct perf_event *event, struct perf_event_context *ctx)
 	if (is_cgroup_event(event))
 		ctx->nr_cgroups++;
 
+	if (is_cgroup_count_event(event))
+		perf_cgroup_node_list_add(event, ctx);
+
 	if (has_branch_stack(event))
 		ctx->nr_branch_stack++;
 
@@ -1301,6 +1616,9 @@ list_del_event(struct perf_event *event, struct perf_event_context *ctx)
 			cpuctx->cgrp = NULL;
 	}
 
+	if (is_cgroup_count_event(event))
+		perf_cgroup_node_list_del(event);
+
 	if (has_branch_stack(event))
 		ctx->nr_branch_stack--;
 
@@ -1570,6 +1888,7 @@ int __perf_event_disable(void *info)
 		else
 			event_sched_out(event, cpuctx, ctx);
 		event->state = PERF_EVENT_STATE_OFF;
+		perf_stack_agg_flush_group(event);
 	}
 
 	raw_spin_unlock(&ctx->lock);
@@ -1628,6 +1947,7 @@ retry:
 	if (event->state == PERF_EVENT_STATE_INACTIVE) {
 		update_group_times(event);
 		event->state = PERF_EVENT_STATE_OFF;
+		perf_stack_agg_flush_group(event);
 	}
 	raw_spin_unlock_irq(&ctx->lock);
 }
@@ -3212,7 +3532,6 @@ static void free_event_rcu(struct rcu_head *head)
 	kfree(event);
 }
 
-static void ring_buffer_put(struct ring_buffer *rb);
 static void ring_buffer_attach(struct perf_event *event,
 			       struct ring_buffer *rb);
 
@@ -3225,7 +3544,7 @@ static void unaccount_event_cpu(struct perf_event *event, int cpu)
 		if (!(event->attach_state & PERF_ATTACH_TASK))
 			atomic_dec(&per_cpu(perf_branch_stack_events, cpu));
 	}
-	if (is_cgroup_event(event))
+	if (is_cgroup_event(event) || is_cgroup_count_event(event))
 		atomic_dec(&per_cpu(perf_cgroup_events, cpu));
 }
 
@@ -3244,7 +3563,7 @@ static void unaccount_event(struct perf_event *event)
 		atomic_dec(&nr_task_events);
 	if (event->attr.freq)
 		atomic_dec(&nr_freq_events);
-	if (is_cgroup_event(event))
+	if (is_cgroup_event(event) || is_cgroup_count_event(event))
 		static_key_slow_dec_deferred(&perf_sched_events);
 	if (has_branch_stack(event))
 		static_key_slow_dec_deferred(&perf_sched_events);
@@ -3268,6 +3587,8 @@ static void __free_event(struct perf_event *event)
 	if (event->pmu)
 		module_put(event->pmu->module);
 
+	vfree(event->stack_agg);
+
 	call_rcu(&event->rcu_head, free_event_rcu);
 }
 
@@ -3292,6 +3613,9 @@ static void _free_event(struct perf_event *event)
 	if (is_cgroup_event(event))
 		perf_detach_cgroup(event);
 
+	if (is_cgroup_count_event(event))
+		perf_cgroup_node_free(event);
+
 	__free_event(event);
 }
 
@@ -3705,6 +4029,33 @@ static long perf_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	case PERF_EVENT_IOC_SET_FILTER:
 		return perf_event_set_filter(event, (void __user *)arg);
 
+	case PERF_EVENT_IOC_ATTACH_CGROUP:
+		return perf_event_attach_cgroup(event, arg);
+
+	case PERF_EVENT_IOC_READ_CGROUP:
+		return perf_event_read_cgroup(event,
+			(struct perf_event_cgroup_read __user *)arg);
+
+	case PERF_EVENT_IOC_PAUSE_OUTPUT:
+	{
+		struct ring_buffer *rb;
+
+		/*
+		 * Stop writing into the buffer so that a flight recorder
+		 * (overwrite, usually backward) buffer can be read in one
+		 * consistent piece; records arriving meanwhile are lost.
+		 */
+		rcu_read_lock();
+		rb = rcu_dereference(event->rb);
+		if (!rb || !rb->nr_pages) {
+			rcu_read_unlock();
+			return -EINVAL;
+		}
+		ACCESS_ONCE(rb->paused) = !!arg;
+		rcu_read_unlock();
+		return 0;
+	}
+
 	default:
 		return -ENOTTY;
 	}
@@ -3780,6 +4131,8 @@ static void perf_event_init_userpage(struct perf_event *event)
 	/* Allow new userspace to detect that bit 0 is deprecated */
 	userpg->cap_bit0_is_deprecated = 1;
 	userpg->size = offsetof(struct perf_event_mmap_page, __reserved);
+	userpg->data_offset = PAGE_SIZE;
+	userpg->data_size = perf_data_size(rb);
 
 unlock:
 	rcu_read_unlock();
@@ -3943,10 +4296,12 @@ static void rb_free_rcu(struct rcu_head *rcu_head)
 	struct ring_buffer *rb;
 
 	rb = container_of(rcu_head, struct ring_buffer, rcu_head);
+	/* a pending free of the AUX area still uses the buffer */
+	irq_work_sync(&rb->aux_free_work);
 	rb_free(rb);
 }
 
-static struct ring_buffer *ring_buffer_get(struct perf_event *event)
+struct ring_buffer *ring_buffer_get(struct perf_event *event)
 {
 	struct ring_buffer *rb;
 
@@ -3961,7 +4316,7 @@ static struct ring_buffer *ring_buffer_get(struct perf_event *event)
 	return rb;
 }
 
-static void ring_buffer_put(struct ring_buffer *rb)
+void ring_buffer_put(struct ring_buffer *rb)
 {
 	if (!atomic_dec_and_test(&rb->refcount))
 		return;
@@ -3977,6 +4332,9 @@ static void perf_mmap_open(struct vm_area_struct *vma)
 
 	atomic_inc(&event->mmap_count);
 	atomic_inc(&event->rb->mmap_count);
+
+	if (vma->vm_pgoff)
+		atomic_inc(&event->rb->aux_mmap_count);
 }
 
 /*
@@ -3996,6 +4354,21 @@ static void perf_mmap_close(struct vm_area_struct *vma)
 	int mmap_locked = rb->mmap_locked;
 	unsigned long size = perf_data_size(rb);
 
+	/*
+	 * rb->aux_mmap_count always drops before rb->mmap_count and
+	 * event->mmap_count, so event->mmap_mutex serializes us against
+	 * perf_mmap() here.
+	 */
+	if (rb_has_aux(rb) && vma->vm_pgoff == rb->aux_pgoff &&
+	    atomic_dec_and_mutex_lock(&rb->aux_mmap_count,
+				      &event->mmap_mutex)) {
+		atomic_long_sub(rb->aux_nr_pages, &mmap_user->locked_vm);
+		vma->vm_mm->pinned_vm -= rb->aux_mmap_locked;
+
+		rb_free_aux(rb);
+		mutex_unlock(&event->mmap_mutex);
+	}
+
 	atomic_dec(&rb->mmap_count);
 
 	if (!atomic_dec_and_mutex_lock(&event->mmap_count, &event->mmap_mutex))
@@ -4080,10 +4453,10 @@ static int perf_mmap(struct file *file, struct vm_area_struct *vma)
 	unsigned long user_locked, user_lock_limit;
 	struct user_struct *user = current_user();
 	unsigned long locked, lock_limit;
-	struct ring_buffer *rb;
+	struct ring_buffer *rb = NULL;
 	unsigned long vma_size;
 	unsigned long nr_pages;
-	long user_extra, extra;
+	long user_extra = 0, extra = 0;
 	int ret = 0, flags = 0;
 
 	/*
@@ -4098,7 +4471,70 @@ static int perf_mmap(struct file *file, struct vm_area_struct *vma)
 		return -EINVAL;
 
 	vma_size = vma->vm_end - vma->vm_start;
-	nr_pages = (vma_size / PAGE_SIZE) - 1;
+
+	if (vma->vm_pgoff == 0) {
+		nr_pages = (vma_size / PAGE_SIZE) - 1;
+	} else {
+		/*
+		 * AUX area mapping: it has to sit above the data buffer at
+		 * the offset and size userspace put in the user page, and
+		 * every later mapping has to match the first one.
+		 */
+		u64 aux_offset, aux_size;
+
+		if (!event->rb)
+			return -EINVAL;
+
+		nr_pages = vma_size / PAGE_SIZE;
+
+		mutex_lock(&event->mmap_mutex);
+		ret = -EINVAL;
+
+		rb = event->rb;
+		if (!rb)
+			goto aux_unlock;
+
+		aux_offset = ACCESS_ONCE(rb->user_page->aux_offset);
+		aux_size = ACCESS_ONCE(rb->user_page->aux_size);
+
+		if (aux_offset < perf_data_size(rb) + PAGE_SIZE)
+			goto aux_unlock;
+
+		if (aux_offset != vma->vm_pgoff << PAGE_SHIFT)
+			goto aux_unlock;
+
+		/* already mapped with a different offset */
+		if (rb_has_aux(rb) && rb->aux_pgoff != vma->vm_pgoff)
+			goto aux_unlock;
+
+		if (aux_size != vma_size || aux_size != nr_pages * PAGE_SIZE)
+			goto aux_unlock;
+
+		/* already mapped with a different size */
+		if (rb_has_aux(rb) && rb->aux_nr_pages != nr_pages)
+			goto aux_unlock;
+
+		if (!is_power_of_2(nr_pages))
+			goto aux_unlock;
+
+		if (!atomic_inc_not_zero(&rb->mmap_count))
+			goto aux_unlock;
+
+		if (rb_has_aux(rb)) {
+			/* the last mapping is going away, it'll be freed */
+			if (!atomic_inc_not_zero(&rb->aux_mmap_count)) {
+				ret = -EBUSY;
+				goto unlock;
+			}
+			ret = 0;
+			goto unlock;
+		}
+
+		atomic_set(&rb->aux_mmap_count, 1);
+		user_extra = nr_pages;
+
+		goto accounting;
+	}
 
 	/*
 	 * If we have rb pages ensure they're a power-of-two number, so we
@@ -4110,9 +4546,6 @@ static int perf_mmap(struct file *file, struct vm_area_struct *vma)
 	if (vma_size != PAGE_SIZE * (1 + nr_pages))
 		return -EINVAL;
 
-	if (vma->vm_pgoff != 0)
-		return -EINVAL;
-
 	WARN_ON_ONCE(event->ctx->parent_ctx);
 again:
 	mutex_lock(&event->mmap_mutex);
@@ -4136,6 +4569,8 @@ again:
 	}
 
 	user_extra = nr_pages + 1;
+
+accounting:
 	user_lock_limit = sysctl_perf_event_mlock >> (PAGE_SHIFT - 10);
 
 	/*
@@ -4159,35 +4594,45 @@ again:
 		goto unlock;
 	}
 
-	WARN_ON(event->rb);
+	WARN_ON(!rb && event->rb);
 
 	if (vma->vm_flags & VM_WRITE)
 		flags |= RING_BUFFER_WRITABLE;
 
-	rb = rb_alloc(nr_pages, 
-		event->attr.watermark ? event->attr.wakeup_watermark : 0,
-		event->cpu, flags);
-
 	if (!rb) {
-		ret = -ENOMEM;
-		goto unlock;
-	}
+		rb = rb_alloc(nr_pages,
+			event->attr.watermark ? event->attr.wakeup_watermark : 0,
+			event->cpu, flags);
 
-	atomic_set(&rb->mmap_count, 1);
-	rb->mmap_locked = extra;
-	rb->mmap_user = get_current_user();
+		if (!rb) {
+			ret = -ENOMEM;
+			goto unlock;
+		}
 
-	atomic_long_add(user_extra, &user->locked_vm);
-	vma->vm_mm->pinned_vm += extra;
+		atomic_set(&rb->mmap_count, 1);
+		rb->mmap_locked = extra;
+		rb->mmap_user = get_current_user();
 
-	ring_buffer_attach(event, rb);
+		ring_buffer_attach(event, rb);
 
-	perf_event_init_userpage(event);
-	perf_event_update_userpage(event);
+		perf_event_init_userpage(event);
+		perf_event_update_userpage(event);
+	} else {
+		ret = rb_alloc_aux(rb, event, vma->vm_pgoff, nr_pages, flags);
+		if (!ret)
+			rb->aux_mmap_locked = extra;
+	}
 
 unlock:
-	if (!ret)
+	if (!ret) {
+		atomic_long_add(user_extra, &user->locked_vm);
+		vma->vm_mm->pinned_vm += extra;
+
 		atomic_inc(&event->mmap_count);
+	} else if (rb) {
+		atomic_dec(&rb->mmap_count);
+	}
+aux_unlock:
 	mutex_unlock(&event->mmap_mutex);
 
 	/*
@@ -5353,6 +5798,193 @@ void perf_event_mmap(struct vm_area_struct *vma)
 	perf_event_mmap_event(&mmap_event);
 }
 
+/*
+ * AUX area data logging
+ */
+
+void perf_event_aux_event(struct perf_event *event, unsigned long head,
+			  unsigned long size, u64 flags)
+{
+	struct perf_output_handle handle;
+	struct perf_sample_data sample;
+	struct perf_aux_event {
+		struct perf_event_header	header;
+		u64				offset;
+		u64				size;
+		u64				flags;
+	} rec = {
+		.header = {
+			.type = PERF_RECORD_AUX,
+			.misc = 0,
+			.size = sizeof(rec),
+		},
+		.offset		= head,
+		.size		= size,
+		.flags		= flags,
+	};
+	int ret;
+
+	perf_event_header__init_id(&rec.header, &sample, event);
+	ret = perf_output_begin(&handle, event, rec.header.size);
+
+	if (ret)
+		return;
+
+	perf_output_put(&handle, rec);
+	perf_event__output_id_sample(event, &handle, &sample);
+
+	perf_output_end(&handle);
+}
+
+/*
+ * In-kernel stack aggregation (attr.aggregate_stacks)
+ *
+ * Rather than a PERF_RECORD_SAMPLE with a callchain per overflow, the
+ * samples are hashed by (pid, callchain) into a table on the event, and
+ * only the unique stacks with their counts are written out, as
+ * PERF_RECORD_STACK_COUNT, when the table fills up, when it is older
+ * than PERF_STACK_AGG_FLUSH_NS and when the event is disabled.
+ *
+ * Sampling runs from the overflow handler, in NMI context for hardware
+ * events, so the table is preallocated and never grows.
+ */
+#define PERF_STACK_AGG_BITS		9
+#define PERF_STACK_AGG_SLOTS		(1 << PERF_STACK_AGG_BITS)
+#define PERF_STACK_AGG_MAX_ENTRIES	(PERF_STACK_AGG_SLOTS * 3 / 4)
+#define PERF_STACK_AGG_IPS		8192
+#define PERF_STACK_AGG_FLUSH_NS		NSEC_PER_SEC
+
+struct perf_stack_agg_entry {
+	u32				hash;
+	u32				pid;
+	u32				nr;	/* 0 for a free slot */
+	u32				ip_off;
+	u64				count;
+	u64				period;
+};
+
+struct perf_stack_agg {
+	u64				last_flush;
+	unsigned int			nr_entries;
+	unsigned int			nr_ips;
+	struct perf_stack_agg_entry	slots[PERF_STACK_AGG_SLOTS];
+	u64				ips[PERF_STACK_AGG_IPS];
+};
+
+/*
+ * Must not race with perf_stack_agg_sample(): called from the overflow
+ * handler itself, or once the event can't overflow anymore.
+ */
+static void perf_stack_agg_flush(struct perf_event *event)
+{
+	struct perf_stack_agg *agg = event->stack_agg;
+	struct perf_output_handle handle;
+	struct perf_sample_data sample;
+	struct perf_stack_agg_entry *e;
+	struct {
+		struct perf_event_header	header;
+		u32				pid;
+		u32				nr;
+		u64				count;
+		u64				period;
+	} rec;
+	int i;
+
+	if (!agg)
+		return;
+
+	for (i = 0; agg->nr_entries && i < PERF_STACK_AGG_SLOTS; i++) {
+		e = &agg->slots[i];
+		if (!e->nr)
+			continue;
+
+		rec.header.type = PERF_RECORD_STACK_COUNT;
+		rec.header.misc = 0;
+		rec.header.size = sizeof(rec) + e->nr * sizeof(u64);
+		rec.pid = e->pid;
+		rec.nr = e->nr;
+		rec.count = e->count;
+		rec.period = e->period;
+
+		perf_event_header__init_id(&rec.header, &sample, event);
+		if (perf_output_begin(&handle, event, rec.header.size))
+			continue;
+
+		perf_output_put(&handle, rec);
+		__output_copy(&handle, &agg->ips[e->ip_off],
+			      e->nr * sizeof(u64));
+		perf_event__output_id_sample(event, &handle, &sample);
+		perf_output_end(&handle);
+	}
+
+	if (agg->nr_entries) {
+		memset(agg->slots, 0, sizeof(agg->slots));
+		agg->nr_entries = 0;
+		agg->nr_ips = 0;
+	}
+	agg->last_flush = perf_clock();
+}
+
+static void perf_stack_agg_flush_group(struct perf_event *leader)
+{
+	struct perf_event *sub;
+
+	perf_stack_agg_flush(leader);
+	list_for_each_entry(sub, &leader->sibling_list, group_entry)
+		perf_stack_agg_flush(sub);
+}
+
+static void perf_stack_agg_sample(struct perf_event *event,
+				  struct perf_sample_data *data,
+				  struct pt_regs *regs)
+{
+	struct perf_stack_agg *agg = event->stack_agg;
+	struct perf_callchain_entry *callchain;
+	struct perf_stack_agg_entry *e;
+	u32 pid, hash, idx;
+
+	callchain = perf_callchain(event, regs);
+	if (!callchain || !callchain->nr)
+		return;
+
+	pid = perf_event_pid(event, current);
+	hash = jhash2((u32 *)callchain->ip, callchain->nr * 2, pid);
+
+again:
+	for (idx = hash;; idx++) {
+		e = &agg->slots[idx & (PERF_STACK_AGG_SLOTS - 1)];
+		if (!e->nr)
+			break;
+		if (e->hash == hash && e->pid == pid &&
+		    e->nr == callchain->nr &&
+		    !memcmp(&agg->ips[e->ip_off], callchain->ip,
+			    e->nr * sizeof(u64)))
+			goto found;
+	}
+
+	/* a new stack, make room for it first */
+	if (agg->nr_entries >= PERF_STACK_AGG_MAX_ENTRIES ||
+	    agg->nr_ips + callchain->nr > PERF_STACK_AGG_IPS) {
+		perf_stack_agg_flush(event);
+		goto again;
+	}
+
+	e->hash = hash;
+	e->pid = pid;
+	e->nr = callchain->nr;
+	e->ip_off = agg->nr_ips;
+	memcpy(&agg->ips[e->ip_off], callchain->ip, e->nr * sizeof(u64));
+	agg->nr_ips += e->nr;
+	agg->nr_entries++;
+
+found:
+	e->count++;
+	e->period += data->period;
+
+	if (perf_clock() - agg->last_flush >= PERF_STACK_AGG_FLUSH_NS)
+		perf_stack_agg_flush(event);
+}
+
 /*
  * IRQ throttle logging
  */
@@ -5455,6 +6087,8 @@ static int __perf_event_overflow(struct perf_event *event,
 
 	if (event->overflow_handler)
 		event->overflow_handler(event, data, regs);
+	else if (event->stack_agg)
+		perf_stack_agg_sample(event, data, regs);
 	else
 		perf_event_output(event, data, regs);
 
@@ -6588,6 +7222,7 @@ skip_type:
 		__perf_cpu_hrtimer_init(cpuctx, cpu);
 
 		INIT_LIST_HEAD(&cpuctx->rotation_list);
+		INIT_LIST_HEAD(&cpuctx->cgrp_node_list);
 		cpuctx->unique_pmu = pmu;
 	}
 
@@ -6714,7 +7349,7 @@ static void account_event_cpu(struct perf_event *event, int cpu)
 		if (!(event->attach_state & PERF_ATTACH_TASK))
 			atomic_inc(&per_cpu(perf_branch_stack_events, cpu));
 	}
-	if (is_cgroup_event(event))
+	if (is_cgroup_event(event) || is_cgroup_count_event(event))
 		atomic_inc(&per_cpu(perf_cgroup_events, cpu));
 }
 
@@ -6737,7 +7372,7 @@ static void account_event(struct perf_event *event)
 	}
 	if (has_branch_stack(event))
 		static_key_slow_inc(&perf_sched_events.key);
-	if (is_cgroup_event(event))
+	if (is_cgroup_event(event) || is_cgroup_count_event(event))
 		static_key_slow_inc(&perf_sched_events.key);
 
 	account_event_cpu(event, event->cpu);
@@ -6853,16 +7488,25 @@ perf_event_alloc(struct perf_event_attr *attr, int cpu,
 		goto err_ns;
 	}
 
+	if (event->attr.aggregate_stacks) {
+		err = -ENOMEM;
+		event->stack_agg = vzalloc(sizeof(struct perf_stack_agg));
+		if (!event->stack_agg)
+			goto err_pmu;
+	}
+
 	if (!event->parent) {
 		if (event->attr.sample_type & PERF_SAMPLE_CALLCHAIN) {
 			err = get_callchain_buffers();
 			if (err)
-				goto err_pmu;
+				goto err_agg;
 		}
 	}
 
 	return event;
 
+err_agg:
+	vfree(event->stack_agg);
 err_pmu:
 	if (event->destroy)
 		event->destroy(event);
@@ -7028,6 +7672,20 @@ perf_event_set_output(struct perf_event *event, struct perf_event *output_event)
 	if (output_event->cpu == -1 && output_event->ctx != event->ctx)
 		goto out;
 
+	/*
+	 * Either writing ring buffer from beginning or from end.
+	 * Mixing is not allowed.
+	 */
+	if (is_write_backward(output_event) != is_write_backward(event))
+		goto out;
+
+	/*
+	 * If both events generate aux data, they must be on the same PMU
+	 */
+	if (has_aux(event) && has_aux(output_event) &&
+	    event->pmu != output_event->pmu)
+		goto out;
+
 set:
 	mutex_lock(&event->mmap_mutex);
 	/* Can't redirect output if we've got an active mmap() */
@@ -7106,6 +7764,23 @@ SYSCALL_DEFINE5(perf_event_open,
 	if ((flags & PERF_FLAG_PID_CGROUP) && (pid == -1 || cpu == -1))
 		return -EINVAL;
 
+	/* stack aggregation replaces callchain samples */
+	if (attr.aggregate_stacks &&
+	    (!attr.sample_period || !(attr.sample_type & PERF_SAMPLE_CALLCHAIN)))
+		return -EINVAL;
+
+	/*
+	 * Cgroup-keyed counting is done by one counting event per cpu,
+	 * which itself is bound to neither a task nor a cgroup.
+	 */
+	if (attr.cgroup_count) {
+		if (!IS_ENABLED(CONFIG_CGROUP_PERF))
+			return -EOPNOTSUPP;
+		if (pid != -1 || cpu == -1 || (flags & PERF_FLAG_PID_CGROUP) ||
+		    attr.inherit || attr.sample_period)
+			return -EINVAL;
+	}
+
 	if (flags & PERF_FLAG_FD_CLOEXEC)
 		f_flags |= O_CLOEXEC;
 
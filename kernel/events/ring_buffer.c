@@ -101,12 +101,24 @@ out:
 	preempt_enable();
 }
 
+static inline bool
+ring_buffer_has_space(unsigned long head, unsigned long tail,
+		      unsigned long data_size, unsigned int size,
+		      bool backward)
+{
+	if (!backward)
+		return CIRC_SPACE(head, tail, data_size) >= size;
+	else
+		return CIRC_SPACE(tail, head, data_size) >= size;
+}
+
 int perf_output_begin(struct perf_output_handle *handle,
 		      struct perf_event *event, unsigned int size)
 {
 	struct ring_buffer *rb;
 	unsigned long tail, offset, head;
 	int have_lost, page_shift;
+	bool backward;
 	struct {
 		struct perf_event_header header;
 		u64			 id;
@@ -127,9 +139,17 @@ int perf_output_begin(struct perf_output_handle *handle,
 	if (unlikely(!rb->nr_pages))
 		goto out;
 
+	/* a paused flight recorder buffer is being read, drop the record */
+	if (unlikely(ACCESS_ONCE(rb->paused))) {
+		local_inc(&rb->lost);
+		goto out;
+	}
+
 	handle->rb    = rb;
 	handle->event = event;
 
+	backward = is_write_backward(event);
+
 	have_lost = local_read(&rb->lost);
 	if (unlikely(have_lost)) {
 		size += sizeof(lost_event);
@@ -143,7 +163,9 @@ int perf_output_begin(struct perf_output_handle *handle,
 		tail = ACCESS_ONCE(rb->user_page->data_tail);
 		offset = head = local_read(&rb->head);
 		if (!rb->overwrite &&
-		    unlikely(CIRC_SPACE(head, tail, perf_data_size(rb)) < size))
+		    unlikely(!ring_buffer_has_space(head, tail,
+						    perf_data_size(rb),
+						    size, backward)))
 			goto fail;
 
 		/*
@@ -158,16 +180,32 @@ int perf_output_begin(struct perf_output_handle *handle,
 		 * See perf_output_put_handle().
 		 */
 
-		head += size;
+		/*
+		 * A backward buffer grows down: the record is written at the
+		 * new head, so the newest record always starts at data_head
+		 * and userspace can walk the records forward from there.
+		 */
+		if (!backward)
+			head += size;
+		else
+			head -= size;
 	} while (local_cmpxchg(&rb->head, offset, head) != offset);
 
+	if (backward)
+		offset = head;
+
 	/*
 	 * We rely on the implied barrier() by local_cmpxchg() to ensure
 	 * none of the data stores below can be lifted up by the compiler.
 	 */
 
-	if (unlikely(head - local_read(&rb->wakeup) > rb->watermark))
-		local_add(rb->watermark, &rb->wakeup);
+	if (!backward) {
+		if (unlikely(head - local_read(&rb->wakeup) > rb->watermark))
+			local_add(rb->watermark, &rb->wakeup);
+	} else {
+		if (unlikely(local_read(&rb->wakeup) - head > rb->watermark))
+			local_sub(rb->watermark, &rb->wakeup);
+	}
 
 	page_shift = PAGE_SHIFT + page_order(rb);
 
@@ -220,6 +258,286 @@ void perf_output_end(struct perf_output_handle *handle)
 	rcu_read_unlock();
 }
 
+/*
+ * This is called before the hardware starts writing to the AUX area to
+ * get an output handle and make sure there's room in the buffer.  When
+ * the capture completes, perf_aux_output_end() commits the recorded data
+ * to the buffer.
+ *
+ * The ordering is that of perf_output_{begin,end}, except that (B) has to
+ * be taken care of by the pmu driver, since it depends on the hardware.
+ *
+ * Returns the pmu private data set up by pmu::setup_aux(), or NULL if
+ * there's no AUX area or no room in it.
+ */
+void *perf_aux_output_begin(struct perf_output_handle *handle,
+			    struct perf_event *event)
+{
+	struct perf_event *output_event = event;
+	unsigned long aux_head, aux_tail;
+	struct ring_buffer *rb;
+
+	if (output_event->parent)
+		output_event = output_event->parent;
+
+	/*
+	 * The handle is typically held across pmu::add/pmu::del, so take a
+	 * reference on the buffer rather than holding rcu_read_lock().
+	 */
+	rb = ring_buffer_get(output_event);
+	if (!rb)
+		return NULL;
+
+	if (!rb_has_aux(rb) || !atomic_inc_not_zero(&rb->aux_refcount))
+		goto err;
+
+	/*
+	 * If aux_mmap_count is zero, the AUX area is in perf_mmap_close()
+	 * and about to be freed.
+	 */
+	if (!atomic_read(&rb->aux_mmap_count))
+		goto err_put;
+
+	/* the AUX area has a single writer, catch nesting early */
+	if (WARN_ON_ONCE(local_xchg(&rb->aux_nest, 1)))
+		goto err_put;
+
+	aux_head = local_read(&rb->aux_head);
+
+	handle->rb = rb;
+	handle->event = event;
+	handle->head = aux_head;
+	handle->size = 0;
+	handle->aux_flags = 0;
+
+	/*
+	 * In overwrite mode the hardware doesn't look at aux_tail and may
+	 * use the whole buffer.
+	 */
+	if (rb->aux_overwrite) {
+		handle->size = perf_aux_size(rb);
+	} else {
+		aux_tail = ACCESS_ONCE(rb->user_page->aux_tail);
+		handle->wakeup = local_read(&rb->aux_wakeup) +
+				 rb->aux_watermark;
+		if (aux_head - aux_tail < perf_aux_size(rb))
+			handle->size = CIRC_SPACE(aux_head, aux_tail,
+						  perf_aux_size(rb));
+
+		/*
+		 * The size depends on the aux_tail load, which is the
+		 * control dependency (A) that separates it from the data
+		 * stores the hardware will do.
+		 */
+		if (!handle->size) {
+			event->pending_disable = 1;
+			perf_output_wakeup(handle);
+			local_set(&rb->aux_nest, 0);
+			goto err_put;
+		}
+	}
+
+	return handle->rb->aux_priv;
+
+err_put:
+	rb_free_aux(rb);
+
+err:
+	ring_buffer_put(rb);
+	handle->event = NULL;
+
+	return NULL;
+}
+EXPORT_SYMBOL_GPL(perf_aux_output_begin);
+
+static void perf_aux_wakeup(struct perf_output_handle *handle,
+			    unsigned long aux_head)
+{
+	struct ring_buffer *rb = handle->rb;
+
+	if (aux_head - local_read(&rb->aux_wakeup) >= rb->aux_watermark) {
+		perf_output_wakeup(handle);
+		local_add(rb->aux_watermark, &rb->aux_wakeup);
+	}
+}
+
+/*
+ * Commit the data written by the hardware since perf_aux_output_begin()
+ * and log a PERF_RECORD_AUX for it.  In overwrite mode the driver reports
+ * where the hardware stopped in handle->head, and size is the amount of
+ * data before that point which makes up the snapshot.
+ */
+void perf_aux_output_end(struct perf_output_handle *handle,
+			 unsigned long size, bool truncated)
+{
+	struct ring_buffer *rb = handle->rb;
+	unsigned long aux_head, start;
+	u64 flags = handle->aux_flags;
+
+	if (truncated)
+		flags |= PERF_AUX_FLAG_TRUNCATED;
+
+	if (rb->aux_overwrite) {
+		flags |= PERF_AUX_FLAG_OVERWRITE;
+		aux_head = handle->head;
+		start = aux_head - size;
+		local_set(&rb->aux_head, aux_head);
+	} else {
+		start = local_read(&rb->aux_head);
+		local_add(size, &rb->aux_head);
+	}
+
+	/* only log a record if there is something to tell */
+	if (size || flags)
+		perf_event_aux_event(handle->event, start, size, flags);
+
+	aux_head = local_read(&rb->aux_head);
+	rb->user_page->aux_head = aux_head;
+	perf_aux_wakeup(handle, aux_head);
+
+	handle->event = NULL;
+
+	local_set(&rb->aux_nest, 0);
+	rb_free_aux(rb);
+	ring_buffer_put(rb);
+}
+EXPORT_SYMBOL_GPL(perf_aux_output_end);
+
+/*
+ * Skip over a given number of bytes in the AUX area, for hardware that
+ * needs its output aligned or padded.
+ */
+int perf_aux_output_skip(struct perf_output_handle *handle,
+			 unsigned long size)
+{
+	struct ring_buffer *rb = handle->rb;
+	unsigned long aux_head;
+
+	if (size > handle->size)
+		return -ENOSPC;
+
+	local_add(size, &rb->aux_head);
+
+	aux_head = local_read(&rb->aux_head);
+	rb->user_page->aux_head = aux_head;
+	perf_aux_wakeup(handle, aux_head);
+	handle->wakeup = local_read(&rb->aux_wakeup) + rb->aux_watermark;
+
+	handle->head = aux_head;
+	handle->size -= size;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(perf_aux_output_skip);
+
+void *perf_get_aux(struct perf_output_handle *handle)
+{
+	/* only valid between perf_aux_output_begin() and *_end() */
+	if (!handle->event)
+		return NULL;
+
+	return handle->rb->aux_priv;
+}
+EXPORT_SYMBOL_GPL(perf_get_aux);
+
+#define PERF_AUX_GFP	(GFP_KERNEL | __GFP_ZERO | __GFP_NOWARN | __GFP_NORETRY)
+
+static void rb_free_aux_page(struct ring_buffer *rb, int idx)
+{
+	struct page *page = virt_to_page(rb->aux_pages[idx]);
+
+	page->mapping = NULL;
+	__free_page(page);
+}
+
+static void __rb_free_aux(struct ring_buffer *rb)
+{
+	int pg;
+
+	if (rb->aux_priv) {
+		rb->free_aux(rb->aux_priv);
+		rb->free_aux = NULL;
+		rb->aux_priv = NULL;
+	}
+
+	for (pg = 0; pg < rb->aux_nr_pages; pg++)
+		rb_free_aux_page(rb, pg);
+
+	kfree(rb->aux_pages);
+	rb->aux_pages = NULL;
+	rb->aux_nr_pages = 0;
+}
+
+/*
+ * The last reference can be dropped by perf_aux_output_end() from NMI
+ * context, so the AUX area is freed from irq_work.
+ */
+static void rb_free_aux_work(struct irq_work *work)
+{
+	struct ring_buffer *rb;
+
+	rb = container_of(work, struct ring_buffer, aux_free_work);
+	if (!atomic_read(&rb->aux_refcount))
+		__rb_free_aux(rb);
+}
+
+void rb_free_aux(struct ring_buffer *rb)
+{
+	if (atomic_dec_and_test(&rb->aux_refcount))
+		irq_work_queue(&rb->aux_free_work);
+}
+
+int rb_alloc_aux(struct ring_buffer *rb, struct perf_event *event,
+		 pgoff_t pgoff, int nr_pages, int flags)
+{
+	bool overwrite = !(flags & RING_BUFFER_WRITABLE);
+	int node = (event->cpu == -1) ? -1 : cpu_to_node(event->cpu);
+	int ret = -ENOMEM;
+
+	if (!has_aux(event))
+		return -ENOTSUPP;
+
+	rb->aux_pages = kzalloc_node(nr_pages * sizeof(void *), GFP_KERNEL,
+				     node);
+	if (!rb->aux_pages)
+		return -ENOMEM;
+
+	rb->free_aux = event->pmu->free_aux;
+	for (rb->aux_nr_pages = 0; rb->aux_nr_pages < nr_pages;
+	     rb->aux_nr_pages++) {
+		struct page *page;
+
+		page = alloc_pages_node(node, PERF_AUX_GFP, 0);
+		if (!page)
+			goto out;
+
+		rb->aux_pages[rb->aux_nr_pages] = page_address(page);
+	}
+
+	rb->aux_priv = event->pmu->setup_aux(event->cpu, rb->aux_pages,
+					     nr_pages, overwrite);
+	if (!rb->aux_priv)
+		goto out;
+
+	ret = 0;
+
+	/*
+	 * The pages and aux_priv are used by both the producer and the
+	 * consumer side, each of which holds a reference while it does.
+	 */
+	atomic_set(&rb->aux_refcount, 1);
+
+	rb->aux_overwrite = overwrite;
+	rb->aux_watermark = perf_aux_size(rb) / 2;
+	rb->aux_pgoff = pgoff;
+
+out:
+	if (ret)
+		__rb_free_aux(rb);
+
+	return ret;
+}
+
 static void
 ring_buffer_init(struct ring_buffer *rb, long watermark, int flags)
 {
@@ -237,6 +555,7 @@ ring_buffer_init(struct ring_buffer *rb, long watermark, int flags)
 		rb->overwrite = 1;
 
 	atomic_set(&rb->refcount, 1);
+	init_irq_work(&rb->aux_free_work, rb_free_aux_work);
 
 	INIT_LIST_HEAD(&rb->event_list);
 	spin_lock_init(&rb->event_lock);
@@ -248,8 +567,8 @@ ring_buffer_init(struct ring_buffer *rb, long watermark, int flags)
  * Back perf_mmap() with regular GFP_KERNEL-0 pages.
  */
 
-struct page *
-perf_mmap_to_page(struct ring_buffer *rb, unsigned long pgoff)
+static struct page *
+__perf_mmap_to_page(struct ring_buffer *rb, unsigned long pgoff)
 {
 	if (pgoff > rb->nr_pages)
 		return NULL;
@@ -339,8 +658,8 @@ static int data_page_nr(struct ring_buffer *rb)
 	return rb->nr_pages << page_order(rb);
 }
 
-struct page *
-perf_mmap_to_page(struct ring_buffer *rb, unsigned long pgoff)
+static struct page *
+__perf_mmap_to_page(struct ring_buffer *rb, unsigned long pgoff)
 {
 	/* The '>' counts in the user page. */
 	if (pgoff > data_page_nr(rb))
@@ -415,3 +734,19 @@ fail:
 }
 
 #endif
+
+struct page *
+perf_mmap_to_page(struct ring_buffer *rb, unsigned long pgoff)
+{
+	if (rb->aux_nr_pages) {
+		/* above AUX space */
+		if (pgoff >= rb->aux_pgoff + rb->aux_nr_pages)
+			return NULL;
+
+		/* AUX space */
+		if (pgoff >= rb->aux_pgoff)
+			return virt_to_page(rb->aux_pages[pgoff - rb->aux_pgoff]);
+	}
+
+	return __perf_mmap_to_page(rb, pgoff);
+}
@@ -64,6 +64,8 @@
 #include <linux/hugetlb.h>
 #include <linux/freezer.h>
 #include <linux/bootmem.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
 
 #include <asm/futex.h>
 
@@ -259,6 +261,25 @@ static unsigned long __read_mostly futex_hashsize;
 
 static struct futex_hash_bucket *futex_queues;
 
+/*
+ * A process may opt in, with PR_SET_FUTEX_HASH, to a hash table of its own
+ * for PROCESS_PRIVATE futexes.  Its buckets are allocated on the node the
+ * process runs on and are never shared with other processes, so e.g. a
+ * heavily threaded JVM stops colliding with everything else on the box.
+ *
+ * The table may only be installed or replaced while the mm has a single
+ * user: nobody can then be queued on, or about to lock, a bucket of the old
+ * table, so no waiters need to be moved across.  Once installed it stays put
+ * until the mm goes away and hash_futex() can read it without locking.
+ */
+struct futex_private_hash {
+	unsigned long hashsize;
+	struct futex_hash_bucket queues[0];
+};
+
+#define FUTEX_PRIVATE_HASH_MIN	16UL
+#define FUTEX_PRIVATE_HASH_MAX	(1UL << 16)
+
 static inline void futex_get_mm(union futex_key *key)
 {
 	atomic_inc(&key->private.mm->mm_count);
@@ -309,12 +330,103 @@ static inline int hb_waiters_pending(struct futex_hash_bucket *hb)
  */
 static struct futex_hash_bucket *hash_futex(union futex_key *key)
 {
+	struct futex_private_hash *fph = NULL;
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
+
+	if (!(key->both.offset & (FUT_OFF_INODE | FUT_OFF_MMSHARED)))
+		fph = ACCESS_ONCE(key->private.mm->futex_hash);
+	if (fph)
+		return &fph->queues[hash & (fph->hashsize - 1)];
+
 	return &futex_queues[hash & (futex_hashsize - 1)];
 }
 
+static void futex_hash_init(struct futex_hash_bucket *queues,
+			    unsigned long size)
+{
+	unsigned long i;
+
+	for (i = 0; i < size; i++) {
+		atomic_set(&queues[i].waiters, 0);
+		plist_head_init(&queues[i].chain);
+		spin_lock_init(&queues[i].lock);
+	}
+}
+
+static void futex_private_hash_free(struct futex_private_hash *fph)
+{
+	if (is_vmalloc_addr(fph))
+		vfree(fph);
+	else
+		kfree(fph);
+}
+
+/**
+ * futex_set_private_hash() - install a private futex hash for current->mm
+ * @slots:	number of hash buckets, 0 to go back to the global hash
+ *
+ * Return: 0 on success, -EBUSY if the mm has more than one user, or
+ * -EINVAL/-ENOMEM.
+ */
+int futex_set_private_hash(unsigned long slots)
+{
+	struct mm_struct *mm = current->mm;
+	struct futex_private_hash *fph = NULL, *old;
+	int node = numa_node_id();
+	size_t size;
+
+	if (slots > FUTEX_PRIVATE_HASH_MAX)
+		return -EINVAL;
+
+	if (slots) {
+		slots = roundup_pow_of_two(max(slots, FUTEX_PRIVATE_HASH_MIN));
+		size = sizeof(*fph) + slots * sizeof(fph->queues[0]);
+
+		fph = kzalloc_node(size, GFP_KERNEL | __GFP_NOWARN, node);
+		if (!fph)
+			fph = vzalloc_node(size, node);
+		if (!fph)
+			return -ENOMEM;
+
+		fph->hashsize = slots;
+		futex_hash_init(fph->queues, slots);
+	}
+
+	/*
+	 * A second user of the mm (thread, vfork child, or a transient
+	 * get_task_mm() reference) could have futexes queued on the current
+	 * table.  Only current can add users, so the check cannot race.
+	 */
+	if (atomic_read(&mm->mm_users) != 1) {
+		if (fph)
+			futex_private_hash_free(fph);
+		return -EBUSY;
+	}
+
+	old = mm->futex_hash;
+	ACCESS_ONCE(mm->futex_hash) = fph;
+	if (old)
+		futex_private_hash_free(old);
+
+	return 0;
+}
+
+int futex_get_private_hash(void)
+{
+	struct futex_private_hash *fph = ACCESS_ONCE(current->mm->futex_hash);
+
+	return fph ? fph->hashsize : 0;
+}
+
+void futex_free_private_hash(struct mm_struct *mm)
+{
+	if (mm->futex_hash)
+		futex_private_hash_free(mm->futex_hash);
+	mm->futex_hash = NULL;
+}
+
 /*
  * Return 1 if two futex_keys are equal, 0 otherwise.
  */
@@ -2202,7 +2314,7 @@ static int futex_wait(u32 __user *uaddr, unsigned int flags, u32 val,
 				      HRTIMER_MODE_ABS);
 		hrtimer_init_sleeper(to, current);
 		hrtimer_set_expires_range_ns(&to->timer, *abs_time,
-					     current->timer_slack_ns);
+				task_get_effective_timer_slack(current));
 	}
 
 retry:
@@ -2595,7 +2707,7 @@ static int futex_wait_requeue_pi(u32 __user *uaddr, unsigned int flags,
 				      HRTIMER_MODE_ABS);
 		hrtimer_init_sleeper(to, current);
 		hrtimer_set_expires_range_ns(&to->timer, *abs_time,
-					     current->timer_slack_ns);
+				task_get_effective_timer_slack(current));
 	}
 
 	/*
@@ -3052,7 +3164,6 @@ static void __init futex_detect_cmpxchg(void)
 static int __init futex_init(void)
 {
 	unsigned int futex_shift;
-	unsigned long i;
 
 #if CONFIG_BASE_SMALL
 	futex_hashsize = 16;
@@ -3069,11 +3180,7 @@ static int __init futex_init(void)
 
 	futex_detect_cmpxchg();
 
-	for (i = 0; i < futex_hashsize; i++) {
-		atomic_set(&futex_queues[i].waiters, 0);
-		plist_head_init(&futex_queues[i].chain);
-		spin_lock_init(&futex_queues[i].lock);
-	}
+	futex_hash_init(futex_queues, futex_hashsize);
 
 	return 0;
 }
@@ -0,0 +1,96 @@
+/*
+ * linux/kernel/irq/affinity.c
+ *
+ * This file contains helpers for spreading the interrupt vectors of
+ * multi-queue devices over the cpus.
+ */
+
+#include <linux/interrupt.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/cpu.h>
+
+static unsigned int cpu_to_vec(unsigned int nr_cpus, unsigned int nvec,
+			       unsigned int index)
+{
+	return index / ((nr_cpus + nvec - 1) / nvec);
+}
+
+static unsigned int get_first_sibling(unsigned int cpu)
+{
+	unsigned int ret;
+
+	ret = cpumask_first(topology_thread_cpumask(cpu));
+	if (ret < nr_cpu_ids)
+		return ret;
+
+	return cpu;
+}
+
+static unsigned int vec_of_cpu(struct cpumask *masks, unsigned int nvec,
+			       unsigned int cpu)
+{
+	unsigned int vec;
+
+	for (vec = 0; vec < nvec; vec++)
+		if (cpumask_test_cpu(cpu, &masks[vec]))
+			break;
+
+	return vec < nvec ? vec : 0;
+}
+
+/**
+ * irq_create_affinity_masks - spread the online cpus over interrupt vectors
+ * @nvec:	number of vectors
+ *
+ * Returns an array of @nvec cpumasks, to be freed with kfree(), or NULL if
+ * it could not be allocated.  Online cpus are handed out in order, and
+ * thread siblings share a vector when there are fewer vectors than cpus.
+ * This is the mapping blk-mq uses for hardware queues (see
+ * blk_mq_update_queue_map()), so vector i serves exactly the cpus that
+ * submit to queue i.  Vectors left without a cpu get all online cpus.
+ */
+struct cpumask *irq_create_affinity_masks(unsigned int nvec)
+{
+	unsigned int cpu, vec, nr_cpus = 0, nr_uniq_cpus = 0, index = 0;
+	struct cpumask *masks;
+
+	if (!nvec)
+		return NULL;
+
+	masks = kcalloc(nvec, sizeof(*masks), GFP_KERNEL);
+	if (!masks)
+		return NULL;
+
+	get_online_cpus();
+
+	for_each_online_cpu(cpu) {
+		nr_cpus++;
+		if (get_first_sibling(cpu) == cpu)
+			nr_uniq_cpus++;
+	}
+
+	for_each_online_cpu(cpu) {
+		/*
+		 * Enough vectors, or no siblings to take into account: hand
+		 * out consecutive runs of cpus.
+		 */
+		if (nvec >= nr_cpus || nr_cpus == nr_uniq_cpus)
+			vec = cpu_to_vec(nr_cpus, nvec, index++);
+		else if (get_first_sibling(cpu) == cpu)
+			vec = cpu_to_vec(nr_uniq_cpus, nvec, index++);
+		else
+			vec = vec_of_cpu(masks, nvec, get_first_sibling(cpu));
+
+		cpumask_set_cpu(cpu, &masks[vec]);
+	}
+
+	for (vec = 0; vec < nvec; vec++)
+		if (cpumask_empty(&masks[vec]))
+			cpumask_copy(&masks[vec], cpu_online_mask);
+
+	put_online_cpus();
+
+	return masks;
+}
+EXPORT_SYMBOL_GPL(irq_create_affinity_masks);
@@ -107,6 +107,7 @@ static inline void unregister_handler_proc(unsigned int irq,
 #endif
 
 extern int irq_select_affinity_usr(unsigned int irq, struct cpumask *mask);
+extern bool irq_can_set_affinity_usr(unsigned int irq);
 
 extern void irq_set_thread_affinity(struct irq_desc *desc);
 
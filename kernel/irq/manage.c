@@ -125,6 +125,21 @@ int irq_can_set_affinity(unsigned int irq)
 	return 1;
 }
 
+/**
+ *	irq_can_set_affinity_usr - Check if affinity of a irq can be set from user space
+ *	@irq:		Interrupt to check
+ *
+ *	Like irq_can_set_affinity(), but also false for interrupts whose
+ *	affinity is managed by the kernel.
+ */
+bool irq_can_set_affinity_usr(unsigned int irq)
+{
+	struct irq_desc *desc = irq_to_desc(irq);
+
+	return irq_can_set_affinity(irq) &&
+		!irqd_affinity_is_managed(&desc->irq_data);
+}
+
 /**
  *	irq_set_thread_affinity - Notify irq threads to adjust affinity
  *	@desc:		irq descriptor which has affitnity changed
@@ -246,6 +261,40 @@ int irq_set_affinity_hint(unsigned int irq, const struct cpumask *m)
 }
 EXPORT_SYMBOL_GPL(irq_set_affinity_hint);
 
+/**
+ *	irq_set_affinity_managed - bind an interrupt to a kernel chosen cpumask
+ *	@irq:		Interrupt to bind
+ *	@m:		cpumask pointer (NULL to release the binding)
+ *
+ *	Sets the affinity of @irq to @m and publishes @m as its affinity
+ *	hint, like irq_set_affinity() followed by irq_set_affinity_hint(),
+ *	but also refuses affinity changes from user space until released.
+ *	Meant for the per-queue interrupts of multi-queue devices: the
+ *	queue is only submitted to from the cpus in @m, so irqbalance
+ *	moving its interrupt elsewhere just makes every completion remote.
+ *
+ *	@m must stay valid until the binding is released.
+ */
+int irq_set_affinity_managed(unsigned int irq, const struct cpumask *m)
+{
+	unsigned long flags;
+	struct irq_desc *desc = irq_get_desc_lock(irq, &flags, IRQ_GET_DESC_CHECK_GLOBAL);
+	int ret = 0;
+
+	if (!desc)
+		return -EINVAL;
+	desc->affinity_hint = m;
+	if (m) {
+		irqd_set(&desc->irq_data, IRQD_AFFINITY_MANAGED);
+		ret = irq_set_affinity_locked(irq_desc_get_irq_data(desc), m,
+					      false);
+	} else
+		irqd_clear(&desc->irq_data, IRQD_AFFINITY_MANAGED);
+	irq_put_desc_unlock(desc, flags);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(irq_set_affinity_managed);
+
 static void irq_affinity_notify(struct work_struct *work)
 {
 	struct irq_affinity_notify *notify =
@@ -27,6 +27,9 @@
 #include <linux/debug_locks.h>
 #include "mcs_spinlock.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/lock.h>
+
 /*
  * In the DEBUG case we are using the "NULL fastpath" for mutexes,
  * which forces all calls into the slowpath:
@@ -497,6 +500,7 @@ slowpath:
 	waiter.task = task;
 
 	lock_contended(&lock->dep_map, ip);
+	trace_contention_begin(lock, LCB_F_MUTEX);
 
 	for (;;) {
 		/*
@@ -539,6 +543,7 @@ slowpath:
 	if (likely(list_empty(&lock->wait_list)))
 		atomic_set(&lock->count, 0);
 	debug_mutex_free_waiter(&waiter);
+	trace_contention_end(lock, 0);
 
 skip_wait:
 	/* got the lock - cleanup and rejoice! */
@@ -571,6 +576,7 @@ skip_wait:
 	return 0;
 
 err:
+	trace_contention_end(lock, ret);
 	mutex_remove_waiter(lock, &waiter, task_thread_info(task));
 	spin_unlock_mutex(&lock->wait_lock, flags);
 	debug_mutex_free_waiter(&waiter);
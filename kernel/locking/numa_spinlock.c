@@ -0,0 +1,269 @@
+/*
+ * NUMA-aware spinlock
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/numa_spinlock.h>
+#include <linux/percpu.h>
+#include <linux/topology.h>
+#include <linux/hardirq.h>
+#include <linux/bottom_half.h>
+#include <linux/export.h>
+#include "mcs_spinlock.h"
+
+/*
+ * Waiters queue up MCS style and only the queue head spins on the lock
+ * word, so the lock itself is as cheap as a test-and-set lock when it is
+ * not contended.
+ *
+ * What makes it NUMA aware is how the queue head is passed on once the
+ * head has acquired the lock: rather than waking its successor, the new
+ * owner looks for the first waiter from its own node and makes that the
+ * next head.  The remote waiters in front of it are moved, in order, to
+ * a secondary queue kept in the lock.  They get the lock back, ahead of
+ * everybody still in the main queue, as soon as the main queue runs out
+ * of local waiters or after NUMA_SPIN_BUDGET local handovers, whichever
+ * comes first; so the lock stays on one node for a while, and nobody
+ * starves.
+ *
+ * The secondary queue and the budget are only touched by the lock owner.
+ */
+
+/*
+ * One node per context that can take a lock: task, softirq, hardirq, nmi.
+ */
+#define MAX_NODES	4
+
+struct numa_lock_node {
+	struct mcs_spinlock	mcs;
+	int			nid;
+};
+
+static DEFINE_PER_CPU_ALIGNED(struct numa_lock_node, numa_lock_nodes[MAX_NODES]);
+
+static inline struct numa_lock_node *numa_lock_next(struct numa_lock_node *node)
+{
+	return (struct numa_lock_node *)ACCESS_ONCE(node->mcs.next);
+}
+
+static __always_inline int __numa_spin_trylock(numa_spinlock_t *lock)
+{
+	return !ACCESS_ONCE(lock->locked) && !cmpxchg(&lock->locked, 0, 1);
+}
+
+/*
+ * Called by the new owner, which still heads the queue: pick the waiter
+ * that becomes the next queue head and let it spin on the lock.
+ */
+static void numa_spin_pass_head(numa_spinlock_t *lock,
+				struct numa_lock_node *node)
+{
+	struct numa_lock_node *next, *prev, *cur;
+
+	next = numa_lock_next(node);
+	if (!next) {
+		struct numa_lock_node *sec = lock->sec_tail;
+
+		/*
+		 * We are the last waiter in the main queue; the bypassed
+		 * remote waiters become the queue, if there are any.
+		 */
+		if (cmpxchg(&lock->tail, node, sec) == node) {
+			if (!sec)
+				return;
+			next = lock->sec_head;
+			goto flush;
+		}
+
+		while (!(next = numa_lock_next(node)))
+			arch_mutex_cpu_relax();
+	}
+
+	if (lock->sec_head && !lock->budget) {
+		/* the remote waiters waited long enough, they go first */
+		lock->sec_tail->mcs.next = &next->mcs;
+		next = lock->sec_head;
+		goto flush;
+	}
+
+	if (next->nid != node->nid) {
+		for (prev = next; (cur = numa_lock_next(prev)); prev = cur) {
+			if (cur->nid != node->nid)
+				continue;
+
+			/* move next..prev to the secondary queue */
+			if (lock->sec_head)
+				lock->sec_tail->mcs.next = &next->mcs;
+			else
+				lock->sec_head = next;
+			lock->sec_tail = prev;
+			prev->mcs.next = NULL;
+			next = cur;
+			break;
+		}
+	}
+
+	if (lock->sec_head)
+		lock->budget--;
+	goto pass;
+
+flush:
+	lock->sec_head = lock->sec_tail = NULL;
+	lock->budget = NUMA_SPIN_BUDGET;
+pass:
+	arch_mcs_spin_unlock_contended(&next->mcs.locked);
+}
+
+static noinline void numa_spin_lock_slowpath(numa_spinlock_t *lock)
+{
+	struct numa_lock_node *prev, *node;
+	int idx;
+
+	node = this_cpu_ptr(&numa_lock_nodes[0]);
+	idx = node->mcs.count++;
+	BUG_ON(idx >= MAX_NODES);
+	node += idx;
+
+	node->mcs.next = NULL;
+	node->mcs.locked = 0;
+	node->nid = numa_node_id();
+
+	/*
+	 * The xchg() orders the node initialization against the stores
+	 * of whoever links up behind us.
+	 */
+	prev = xchg(&lock->tail, node);
+	if (prev) {
+		ACCESS_ONCE(prev->mcs.next) = &node->mcs;
+		arch_mcs_spin_lock_contended(&node->mcs.locked);
+	}
+
+	/* we are the queue head, wait for the owner to release the lock */
+	while (!__numa_spin_trylock(lock))
+		arch_mutex_cpu_relax();
+
+	numa_spin_pass_head(lock, node);
+
+	this_cpu_dec(numa_lock_nodes[0].mcs.count);
+}
+
+static __always_inline void __numa_spin_lock(numa_spinlock_t *lock)
+{
+	/* don't overtake the queue, that would defeat the handover policy */
+	if (likely(!ACCESS_ONCE(lock->tail)) && __numa_spin_trylock(lock))
+		return;
+
+	numa_spin_lock_slowpath(lock);
+}
+
+static __always_inline void __numa_spin_unlock(numa_spinlock_t *lock)
+{
+	smp_store_release(&lock->locked, 0);
+}
+
+void __numa_spin_lock_init(numa_spinlock_t *lock, const char *name,
+			   struct lock_class_key *key)
+{
+#ifdef CONFIG_DEBUG_LOCK_ALLOC
+	debug_check_no_locks_freed((void *)lock, sizeof(*lock));
+	lockdep_init_map(&lock->dep_map, name, key, 0);
+#endif
+	lock->locked = 0;
+	lock->budget = NUMA_SPIN_BUDGET;
+	lock->tail = NULL;
+	lock->sec_head = lock->sec_tail = NULL;
+}
+EXPORT_SYMBOL(__numa_spin_lock_init);
+
+void __lockfunc numa_spin_lock(numa_spinlock_t *lock)
+{
+	preempt_disable();
+	spin_acquire(&lock->dep_map, 0, 0, _RET_IP_);
+	__numa_spin_lock(lock);
+}
+EXPORT_SYMBOL(numa_spin_lock);
+
+void __lockfunc numa_spin_lock_bh(numa_spinlock_t *lock)
+{
+	__local_bh_disable_ip(_RET_IP_, SOFTIRQ_LOCK_OFFSET);
+	spin_acquire(&lock->dep_map, 0, 0, _RET_IP_);
+	__numa_spin_lock(lock);
+}
+EXPORT_SYMBOL(numa_spin_lock_bh);
+
+void __lockfunc numa_spin_lock_irq(numa_spinlock_t *lock)
+{
+	local_irq_disable();
+	preempt_disable();
+	spin_acquire(&lock->dep_map, 0, 0, _RET_IP_);
+	__numa_spin_lock(lock);
+}
+EXPORT_SYMBOL(numa_spin_lock_irq);
+
+unsigned long __lockfunc _numa_spin_lock_irqsave(numa_spinlock_t *lock)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+	preempt_disable();
+	spin_acquire(&lock->dep_map, 0, 0, _RET_IP_);
+	__numa_spin_lock(lock);
+	return flags;
+}
+EXPORT_SYMBOL(_numa_spin_lock_irqsave);
+
+int __lockfunc numa_spin_trylock(numa_spinlock_t *lock)
+{
+	preempt_disable();
+	if (!ACCESS_ONCE(lock->tail) && __numa_spin_trylock(lock)) {
+		spin_acquire(&lock->dep_map, 0, 1, _RET_IP_);
+		return 1;
+	}
+	preempt_enable();
+	return 0;
+}
+EXPORT_SYMBOL(numa_spin_trylock);
+
+void __lockfunc numa_spin_unlock(numa_spinlock_t *lock)
+{
+	spin_release(&lock->dep_map, 1, _RET_IP_);
+	__numa_spin_unlock(lock);
+	preempt_enable();
+}
+EXPORT_SYMBOL(numa_spin_unlock);
+
+void __lockfunc numa_spin_unlock_bh(numa_spinlock_t *lock)
+{
+	spin_release(&lock->dep_map, 1, _RET_IP_);
+	__numa_spin_unlock(lock);
+	__local_bh_enable_ip(_RET_IP_, SOFTIRQ_LOCK_OFFSET);
+}
+EXPORT_SYMBOL(numa_spin_unlock_bh);
+
+void __lockfunc numa_spin_unlock_irq(numa_spinlock_t *lock)
+{
+	spin_release(&lock->dep_map, 1, _RET_IP_);
+	__numa_spin_unlock(lock);
+	local_irq_enable();
+	preempt_enable();
+}
+EXPORT_SYMBOL(numa_spin_unlock_irq);
+
+void __lockfunc numa_spin_unlock_irqrestore(numa_spinlock_t *lock,
+					    unsigned long flags)
+{
+	spin_release(&lock->dep_map, 1, _RET_IP_);
+	__numa_spin_unlock(lock);
+	local_irq_restore(flags);
+	preempt_enable();
+}
+EXPORT_SYMBOL(numa_spin_unlock_irqrestore);
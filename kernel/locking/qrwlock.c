@@ -22,6 +22,7 @@
 #include <linux/hardirq.h>
 #include <linux/mutex.h>
 #include <asm/qrwlock.h>
+#include <trace/events/lock.h>
 
 /**
  * rspin_until_writer_unlock - inc reader count & spin until writer is gone
@@ -48,6 +49,8 @@ void queue_read_lock_slowpath(struct qrwlock *lock)
 {
 	u32 cnts;
 
+	trace_contention_begin(lock, LCB_F_SPIN | LCB_F_READ);
+
 	/*
 	 * Readers come here when they cannot get the lock without waiting
 	 */
@@ -58,6 +61,7 @@ void queue_read_lock_slowpath(struct qrwlock *lock)
 		 */
 		cnts = smp_load_acquire((u32 *)&lock->cnts);
 		rspin_until_writer_unlock(lock, cnts);
+		trace_contention_end(lock, 0);
 		return;
 	}
 	atomic_sub(_QR_BIAS, &lock->cnts);
@@ -84,6 +88,8 @@ void queue_read_lock_slowpath(struct qrwlock *lock)
 	 * Signal the next one in queue to become queue head
 	 */
 	arch_spin_unlock(&lock->lock);
+
+	trace_contention_end(lock, 0);
 }
 EXPORT_SYMBOL(queue_read_lock_slowpath);
 
@@ -95,6 +101,8 @@ void queue_write_lock_slowpath(struct qrwlock *lock)
 {
 	u32 cnts;
 
+	trace_contention_begin(lock, LCB_F_SPIN | LCB_F_WRITE);
+
 	/* Put the writer into the wait queue */
 	arch_spin_lock(&lock->lock);
 
@@ -129,5 +137,7 @@ void queue_write_lock_slowpath(struct qrwlock *lock)
 	}
 unlock:
 	arch_spin_unlock(&lock->lock);
+
+	trace_contention_end(lock, 0);
 }
 EXPORT_SYMBOL(queue_write_lock_slowpath);
@@ -0,0 +1,220 @@
+#ifndef _GEN_PV_LOCK_SLOWPATH
+#error "do not include this file"
+#endif
+
+/*
+ * Implement paravirt qspinlocks; the general idea is to halt the vcpus
+ * instead of spinning them.
+ *
+ * A queue node only waits for its predecessor to hand over the MCS lock;
+ * it records that it halted in pv_node::state so the predecessor knows to
+ * kick it.
+ *
+ * The queue head waits on the lock byte itself.  Before halting it sets
+ * the locked byte to _Q_SLOW_VAL, which makes the lock holder take the
+ * unlock slowpath, and publishes the lock it waits for in its pv_node.
+ * The unlocker then looks the head up among the cpus that have one
+ * waiting, much like the ticket lock kick code did.
+ */
+
+#define _Q_SLOW_VAL	(3U << _Q_LOCKED_OFFSET)
+
+enum vcpu_state {
+	vcpu_running = 0,
+	vcpu_halted,
+};
+
+struct pv_node {
+	struct mcs_spinlock	mcs;
+	struct qspinlock	*lock;	/* lock this queue head waits on */
+
+	int			cpu;
+	u8			state;
+};
+
+/* cpus with a queue head that might be halted, and how many per cpu */
+static struct cpumask pv_head_cpus;
+static DEFINE_PER_CPU(int, pv_heads_waiting);
+
+/*
+ * Initialize the PV part of the mcs_spinlock node.
+ */
+static void pv_init_node(struct mcs_spinlock *node)
+{
+	struct pv_node *pn = (struct pv_node *)node;
+
+	BUILD_BUG_ON(sizeof(struct pv_node) > sizeof(struct qnode));
+
+	pn->lock = NULL;
+	pn->cpu = smp_processor_id();
+	pn->state = vcpu_running;
+}
+
+/*
+ * Wait for node->locked to become true, halt the vcpu after a short spin.
+ * pv_kick_node() is used to wake the vcpu again.
+ */
+static void pv_wait_node(struct mcs_spinlock *node)
+{
+	struct pv_node *pn = (struct pv_node *)node;
+	int loop;
+
+	for (;;) {
+		for (loop = SPIN_THRESHOLD; loop; loop--) {
+			if (ACCESS_ONCE(node->locked))
+				return;
+			cpu_relax();
+		}
+
+		/*
+		 * Order pn->state vs pn->locked thusly:
+		 *
+		 * [S] pn->state = vcpu_halted	  [S] next->locked = 1
+		 *     MB			      MB
+		 * [L] pn->locked		[RmW] pn->state = vcpu_running
+		 *
+		 * Matches the xchg() from pv_kick_node().
+		 */
+		(void)xchg(&pn->state, vcpu_halted);
+
+		if (!ACCESS_ONCE(node->locked))
+			pv_wait(&pn->state, vcpu_halted);
+
+		/*
+		 * Reset the vCPU state to avoid unnecessary CPU kicking; if
+		 * the locked flag is still not set after wakeup, it was a
+		 * spurious wakeup and the vCPU waits again.
+		 */
+		ACCESS_ONCE(pn->state) = vcpu_running;
+	}
+
+	/*
+	 * By now our node->locked should be 1 and our caller will not actually
+	 * spin-wait for it. We do however rely on our caller to do a
+	 * load-acquire for us.
+	 */
+}
+
+/*
+ * Called after setting next->locked = 1, used to wake those stuck in
+ * pv_wait_node().
+ */
+static void pv_kick_node(struct mcs_spinlock *node)
+{
+	struct pv_node *pn = (struct pv_node *)node;
+
+	/*
+	 * Note that because node->locked is already set, this actual
+	 * mcs_spinlock entry could be re-used already.
+	 *
+	 * This should be fine however, kicking people for no reason is
+	 * harmless.
+	 *
+	 * See the comment in pv_wait_node().
+	 */
+	if (xchg(&pn->state, vcpu_running) == vcpu_halted)
+		pv_kick(pn->cpu);
+}
+
+static void pv_head_publish(struct pv_node *pn, struct qspinlock *lock)
+{
+	unsigned long flags;
+
+	/* an interrupt nesting another queue head must see a stable count */
+	local_irq_save(flags);
+	ACCESS_ONCE(pn->lock) = lock;
+	if (this_cpu_inc_return(pv_heads_waiting) == 1)
+		cpumask_set_cpu(pn->cpu, &pv_head_cpus);
+	local_irq_restore(flags);
+}
+
+static void pv_head_unpublish(struct pv_node *pn)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+	if (!this_cpu_dec_return(pv_heads_waiting))
+		cpumask_clear_cpu(pn->cpu, &pv_head_cpus);
+	ACCESS_ONCE(pn->lock) = NULL;
+	local_irq_restore(flags);
+}
+
+/*
+ * Wait for l->locked to become clear; halt the vcpu after a short spin.
+ * __pv_queue_spin_unlock() will wake us.
+ */
+static void pv_wait_head(struct qspinlock *lock, struct mcs_spinlock *node)
+{
+	struct pv_node *pn = (struct pv_node *)node;
+	struct __qspinlock *l = (void *)lock;
+	int loop;
+
+	for (;;) {
+		for (loop = SPIN_THRESHOLD; loop; loop--) {
+			if (!ACCESS_ONCE(l->locked))
+				return;
+			cpu_relax();
+		}
+
+		pv_head_publish(pn, lock);
+
+		/*
+		 * The cmpxchg() orders the publication above against the
+		 * unlocker reading _Q_SLOW_VAL; if the lock was released
+		 * meanwhile there is nobody to kick us, so don't halt.
+		 */
+		if (cmpxchg(&l->locked, _Q_LOCKED_VAL, _Q_SLOW_VAL))
+			pv_wait(&l->locked, _Q_SLOW_VAL);
+
+		pv_head_unpublish(pn);
+	}
+}
+
+static void pv_kick_head(struct qspinlock *lock)
+{
+	int cpu, idx;
+
+	for_each_cpu(cpu, &pv_head_cpus) {
+		for (idx = 0; idx < MAX_NODES; idx++) {
+			struct pv_node *pn;
+
+			pn = (struct pv_node *)per_cpu_ptr(&qnodes[idx].mcs, cpu);
+			if (ACCESS_ONCE(pn->lock) == lock) {
+				pv_kick(cpu);
+				return;
+			}
+		}
+	}
+}
+
+/*
+ * PV version of the unlock function to be used in stead of
+ * queue_spin_unlock().
+ */
+__visible void __pv_queue_spin_unlock(struct qspinlock *lock)
+{
+	struct __qspinlock *l = (void *)lock;
+	u8 locked;
+
+	/*
+	 * Only the lock holder and a queue head about to halt write the
+	 * locked byte, so a plain cmpxchg tells whether anybody needs a kick.
+	 */
+	locked = cmpxchg(&l->locked, _Q_LOCKED_VAL, 0);
+	if (likely(locked == _Q_LOCKED_VAL))
+		return;
+
+	if (unlikely(locked != _Q_SLOW_VAL)) {
+		WARN(1, "pvqspinlock: lock 0x%lx has corrupted value 0x%x!\n",
+		     (unsigned long)lock, atomic_read(&lock->val));
+		return;
+	}
+
+	/*
+	 * Release the lock before looking the head up; the head rechecks
+	 * the locked byte in pv_wait() before it actually halts.
+	 */
+	ACCESS_ONCE(l->locked) = 0;
+	smp_mb();
+	pv_kick_head(lock);
+}
@@ -16,6 +16,7 @@
 #include <linux/sched/rt.h>
 #include <linux/sched/deadline.h>
 #include <linux/timer.h>
+#include <trace/events/lock.h>
 
 #include "rtmutex_common.h"
 
@@ -919,6 +920,8 @@ rt_mutex_slowlock(struct rt_mutex *lock, int state,
 		return 0;
 	}
 
+	trace_contention_begin(lock, LCB_F_RT);
+
 	set_current_state(state);
 
 	/* Setup the timer, when timeout != NULL */
@@ -946,6 +949,8 @@ rt_mutex_slowlock(struct rt_mutex *lock, int state,
 	 */
 	fixup_rt_mutex_waiters(lock);
 
+	trace_contention_end(lock, ret);
+
 	raw_spin_unlock(&lock->wait_lock);
 
 	/* Remove pending timer: */
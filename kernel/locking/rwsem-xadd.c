@@ -8,6 +8,8 @@
  *
  * Optimistic spinning by Tim Chen <tim.c.chen@intel.com>
  * and Davidlohr Bueso <davidlohr@hp.com>. Based on mutexes.
+ *
+ * Reader spinning and waiter handoff on top of the above.
  */
 #include <linux/rwsem.h>
 #include <linux/sched.h>
@@ -15,7 +17,10 @@
 #include <linux/export.h>
 #include <linux/sched/rt.h>
 
+#include <trace/events/lock.h>
+
 #include "mcs_spinlock.h"
+#include "rwsem.h"
 
 /*
  * Guide to the rw_semaphore's count field for common values.
@@ -84,6 +89,7 @@ void __init_rwsem(struct rw_semaphore *sem, const char *name,
 	INIT_LIST_HEAD(&sem->wait_list);
 #ifdef CONFIG_RWSEM_SPIN_ON_OWNER
 	sem->owner = NULL;
+	sem->handoff = 0;
 	osq_lock_init(&sem->osq);
 #endif
 }
@@ -99,6 +105,7 @@ struct rwsem_waiter {
 	struct list_head list;
 	struct task_struct *task;
 	enum rwsem_waiter_type type;
+	unsigned long timeout;
 };
 
 enum rwsem_wake_type {
@@ -107,6 +114,43 @@ enum rwsem_wake_type {
 	RWSEM_WAKE_READ_OWNED	/* Waker thread holds the read lock */
 };
 
+/*
+ * Optimistic spinners may keep stealing the lock from a waiter that was
+ * woken to take it.  Once the waiter at the head of the queue has been
+ * waiting for longer than RWSEM_WAIT_TIMEOUT, it raises sem->handoff and
+ * spinners stop stealing until the lock has been handed to the queue.
+ */
+#define RWSEM_WAIT_TIMEOUT	DIV_ROUND_UP(HZ, 250)
+
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+static inline void rwsem_check_handoff(struct rw_semaphore *sem,
+				       struct rwsem_waiter *waiter)
+{
+	if (!sem->handoff && time_after(jiffies, waiter->timeout))
+		ACCESS_ONCE(sem->handoff) = 1;
+}
+
+static inline void rwsem_clear_handoff(struct rw_semaphore *sem)
+{
+	if (sem->handoff)
+		ACCESS_ONCE(sem->handoff) = 0;
+}
+
+static inline bool rwsem_handoff_pending(struct rw_semaphore *sem)
+{
+	return ACCESS_ONCE(sem->handoff);
+}
+#else
+static inline void rwsem_check_handoff(struct rw_semaphore *sem,
+				       struct rwsem_waiter *waiter)
+{
+}
+
+static inline void rwsem_clear_handoff(struct rw_semaphore *sem)
+{
+}
+#endif
+
 /*
  * handle the lock release when processes blocked on it that can now run
  * - if we come here from up_xxxx(), then:
@@ -149,8 +193,10 @@ __rwsem_do_wake(struct rw_semaphore *sem, enum rwsem_wake_type wake_type)
 		if (unlikely(oldcount < RWSEM_WAITING_BIAS)) {
 			/* A writer stole the lock. Undo our reader grant. */
 			if (rwsem_atomic_update(-adjustment, sem) &
-						RWSEM_ACTIVE_MASK)
+						RWSEM_ACTIVE_MASK) {
+				rwsem_check_handoff(sem, waiter);
 				goto out;
+			}
 			/* Last active locker left. Retry waking readers. */
 			goto try_reader_grant;
 		}
@@ -194,59 +240,12 @@ __rwsem_do_wake(struct rw_semaphore *sem, enum rwsem_wake_type wake_type)
 
 	sem->wait_list.next = next;
 	next->prev = &sem->wait_list;
+	rwsem_clear_handoff(sem);
 
  out:
 	return sem;
 }
 
-/*
- * Wait for the read lock to be granted
- */
-__visible
-struct rw_semaphore __sched *rwsem_down_read_failed(struct rw_semaphore *sem)
-{
-	long count, adjustment = -RWSEM_ACTIVE_READ_BIAS;
-	struct rwsem_waiter waiter;
-	struct task_struct *tsk = current;
-
-	/* set up my own style of waitqueue */
-	waiter.task = tsk;
-	waiter.type = RWSEM_WAITING_FOR_READ;
-	get_task_struct(tsk);
-
-	raw_spin_lock_irq(&sem->wait_lock);
-	if (list_empty(&sem->wait_list))
-		adjustment += RWSEM_WAITING_BIAS;
-	list_add_tail(&waiter.list, &sem->wait_list);
-
-	/* we're now waiting on the lock, but no longer actively locking */
-	count = rwsem_atomic_update(adjustment, sem);
-
-	/* If there are no active locks, wake the front queued process(es).
-	 *
-	 * If there are no writers and we are first in the queue,
-	 * wake our own waiter to join the existing active readers !
-	 */
-	if (count == RWSEM_WAITING_BIAS ||
-	    (count > RWSEM_WAITING_BIAS &&
-	     adjustment != -RWSEM_ACTIVE_READ_BIAS))
-		sem = __rwsem_do_wake(sem, RWSEM_WAKE_ANY);
-
-	raw_spin_unlock_irq(&sem->wait_lock);
-
-	/* wait to be given the lock */
-	while (true) {
-		set_task_state(tsk, TASK_UNINTERRUPTIBLE);
-		if (!waiter.task)
-			break;
-		schedule();
-	}
-
-	tsk->state = TASK_RUNNING;
-
-	return sem;
-}
-
 static inline bool rwsem_try_write_lock(long count, struct rw_semaphore *sem)
 {
 	if (!(count & RWSEM_ACTIVE_MASK)) {
@@ -263,6 +262,13 @@ static inline bool rwsem_try_write_lock(long count, struct rw_semaphore *sem)
 }
 
 #ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+/*
+ * How long a writer keeps spinning on a reader owned rwsem.  Readers are
+ * not tracked individually, so there is no telling whether they still
+ * run; bound the spin instead.
+ */
+#define RWSEM_SPIN_READERS_NS	(10 * NSEC_PER_USEC)
+
 /*
  * Try to acquire write lock before the writer has been put on wait queue.
  */
@@ -274,6 +280,10 @@ static inline bool rwsem_try_write_lock_unqueued(struct rw_semaphore *sem)
 		if (!(count == 0 || count == RWSEM_WAITING_BIAS))
 			return false;
 
+		/* a starving waiter is owed the lock, do not steal it */
+		if (count == RWSEM_WAITING_BIAS && rwsem_handoff_pending(sem))
+			return false;
+
 		old = cmpxchg(&sem->count, count, count + RWSEM_ACTIVE_WRITE_BIAS);
 		if (old == count)
 			return true;
@@ -282,26 +292,56 @@ static inline bool rwsem_try_write_lock_unqueued(struct rw_semaphore *sem)
 	}
 }
 
-static inline bool rwsem_can_spin_on_owner(struct rw_semaphore *sem)
+/*
+ * Try to acquire read lock before the reader has been put on wait queue.
+ * This only succeeds while there are neither writers nor waiters, so a
+ * spinning reader never jumps ahead of queued tasks.
+ */
+static inline bool rwsem_try_read_lock_unqueued(struct rw_semaphore *sem)
+{
+	long old, count = ACCESS_ONCE(sem->count);
+
+	while (count >= 0) {
+		old = cmpxchg(&sem->count, count,
+			      count + RWSEM_ACTIVE_READ_BIAS);
+		if (old == count)
+			return true;
+
+		count = old;
+	}
+	return false;
+}
+
+static inline bool rwsem_can_spin_on_owner(struct rw_semaphore *sem,
+					   bool reader)
 {
 	struct task_struct *owner;
-	bool on_cpu = false;
+	bool ret = true;
+
+	if (need_resched() || rwsem_handoff_pending(sem))
+		return false;
 
-	if (need_resched())
+	/*
+	 * A reader can only get the lock once the writers are gone and
+	 * nobody is queued; waiters mean it has to queue behind them.
+	 */
+	if (reader && !list_empty(&sem->wait_list))
 		return false;
 
 	rcu_read_lock();
 	owner = ACCESS_ONCE(sem->owner);
-	if (owner)
-		on_cpu = owner->on_cpu;
+	if (rwsem_owner_is_writer(owner))
+		ret = owner->on_cpu;
+	else if (reader)
+		ret = false;
 	rcu_read_unlock();
 
 	/*
-	 * If sem->owner is not set, yet we have just recently entered the
-	 * slowpath, then there is a possibility reader(s) may have the lock.
-	 * To be safe, avoid spinning in these situations.
+	 * Writers spin on a running writer, on readers (for a bounded
+	 * time) and on a lock whose owner has just left.  Readers only
+	 * spin on a running writer.
 	 */
-	return on_cpu;
+	return ret;
 }
 
 static inline bool owner_running(struct rw_semaphore *sem,
@@ -335,37 +375,62 @@ bool rwsem_spin_on_owner(struct rw_semaphore *sem, struct task_struct *owner)
 
 	/*
 	 * We break out the loop above on need_resched() or when the
-	 * owner changed, which is a sign for heavy contention. Return
-	 * success only when sem->owner is NULL.
+	 * owner changed. Another writer taking over is a sign for heavy
+	 * contention; return success only when the lock is free or has
+	 * gone to readers.
 	 */
-	return sem->owner == NULL;
+	return !rwsem_owner_is_writer(ACCESS_ONCE(sem->owner));
 }
 
-static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
+static bool rwsem_optimistic_spin(struct rw_semaphore *sem, bool reader)
 {
 	struct task_struct *owner;
+	u64 readers_deadline = 0;
 	bool taken = false;
 
 	preempt_disable();
 
 	/* sem->wait_lock should not be held when doing optimistic spinning */
-	if (!rwsem_can_spin_on_owner(sem))
+	if (!rwsem_can_spin_on_owner(sem, reader))
 		goto done;
 
 	if (!osq_lock(&sem->osq))
 		goto done;
 
 	while (true) {
+		/* a starving waiter asked for the lock to be handed over */
+		if (rwsem_handoff_pending(sem))
+			break;
+
 		owner = ACCESS_ONCE(sem->owner);
-		if (owner && !rwsem_spin_on_owner(sem, owner))
+		if (rwsem_owner_is_writer(owner) &&
+		    !rwsem_spin_on_owner(sem, owner))
 			break;
 
 		/* wait_lock will be acquired if write_lock is obtained */
-		if (rwsem_try_write_lock_unqueued(sem)) {
+		if (reader ? rwsem_try_read_lock_unqueued(sem) :
+			     rwsem_try_write_lock_unqueued(sem)) {
 			taken = true;
 			break;
 		}
 
+		owner = ACCESS_ONCE(sem->owner);
+		if (reader) {
+			/*
+			 * The lock is not free for readers although no
+			 * writer runs: there are waiters, queue behind them.
+			 */
+			if (!rwsem_owner_is_writer(owner))
+				break;
+		} else if (rwsem_owner_is_reader(owner)) {
+			if (!readers_deadline)
+				readers_deadline = local_clock() +
+						   RWSEM_SPIN_READERS_NS;
+			else if (need_resched() ||
+				 local_clock() > readers_deadline)
+				break;
+		}
+
 		/*
 		 * When there's no owner, we might have preempted between the
 		 * owner acquiring the lock and setting the owner field. If
@@ -390,12 +455,87 @@ done:
 }
 
 #else
-static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
+static inline bool rwsem_can_spin_on_owner(struct rw_semaphore *sem,
+					   bool reader)
+{
+	return false;
+}
+
+static bool rwsem_optimistic_spin(struct rw_semaphore *sem, bool reader)
 {
 	return false;
 }
 #endif
 
+/*
+ * Wait for the read lock to be granted
+ */
+__visible
+struct rw_semaphore __sched *rwsem_down_read_failed(struct rw_semaphore *sem)
+{
+	long count, adjustment = -RWSEM_ACTIVE_READ_BIAS;
+	struct rwsem_waiter waiter;
+	struct task_struct *tsk = current;
+	bool first;
+
+	trace_contention_begin(sem, LCB_F_READ);
+
+	/*
+	 * A running writer is likely to release the lock soon: drop our
+	 * read bias and spin on it rather than going to sleep.  If that
+	 * leaves queued waiters without an active locker, we must not run
+	 * off with the lock; queue up and do the wakeup below.
+	 */
+	if (rwsem_can_spin_on_owner(sem, true)) {
+		count = rwsem_atomic_update(-RWSEM_ACTIVE_READ_BIAS, sem);
+		adjustment = 0;
+		if (count != RWSEM_WAITING_BIAS &&
+		    rwsem_optimistic_spin(sem, true)) {
+			trace_contention_end(sem, 0);
+			return sem;
+		}
+	}
+
+	/* set up my own style of waitqueue */
+	waiter.task = tsk;
+	waiter.type = RWSEM_WAITING_FOR_READ;
+	waiter.timeout = jiffies + RWSEM_WAIT_TIMEOUT;
+	get_task_struct(tsk);
+
+	raw_spin_lock_irq(&sem->wait_lock);
+	first = list_empty(&sem->wait_list);
+	if (first)
+		adjustment += RWSEM_WAITING_BIAS;
+	list_add_tail(&waiter.list, &sem->wait_list);
+
+	/* we're now waiting on the lock, but no longer actively locking */
+	count = rwsem_atomic_update(adjustment, sem);
+
+	/* If there are no active locks, wake the front queued process(es).
+	 *
+	 * If there are no writers and we are first in the queue,
+	 * wake our own waiter to join the existing active readers !
+	 */
+	if (count == RWSEM_WAITING_BIAS ||
+	    (count > RWSEM_WAITING_BIAS && first))
+		sem = __rwsem_do_wake(sem, RWSEM_WAKE_ANY);
+
+	raw_spin_unlock_irq(&sem->wait_lock);
+
+	/* wait to be given the lock */
+	while (true) {
+		set_task_state(tsk, TASK_UNINTERRUPTIBLE);
+		if (!waiter.task)
+			break;
+		schedule();
+	}
+
+	tsk->state = TASK_RUNNING;
+	trace_contention_end(sem, 0);
+
+	return sem;
+}
+
 /*
  * Wait until we successfully acquire the write lock
  */
@@ -406,12 +546,16 @@ struct rw_semaphore __sched *rwsem_down_write_failed(struct rw_semaphore *sem)
 	bool waiting = true; /* any queued threads before us */
 	struct rwsem_waiter waiter;
 
+	trace_contention_begin(sem, LCB_F_WRITE);
+
 	/* undo write bias from down_write operation, stop active locking */
 	count = rwsem_atomic_update(-RWSEM_ACTIVE_WRITE_BIAS, sem);
 
 	/* do optimistic spinning and steal lock if possible */
-	if (rwsem_optimistic_spin(sem))
+	if (rwsem_optimistic_spin(sem, false)) {
+		trace_contention_end(sem, 0);
 		return sem;
+	}
 
 	/*
 	 * Optimistic spinning failed, proceed to the slowpath
@@ -419,6 +563,7 @@ struct rw_semaphore __sched *rwsem_down_write_failed(struct rw_semaphore *sem)
 	 */
 	waiter.task = current;
 	waiter.type = RWSEM_WAITING_FOR_WRITE;
+	waiter.timeout = jiffies + RWSEM_WAIT_TIMEOUT;
 
 	raw_spin_lock_irq(&sem->wait_lock);
 
@@ -448,6 +593,10 @@ struct rw_semaphore __sched *rwsem_down_write_failed(struct rw_semaphore *sem)
 	while (true) {
 		if (rwsem_try_write_lock(count, sem))
 			break;
+
+		/* spinners keep beating us to it, ask them to hand over */
+		if (sem->wait_list.next == &waiter.list)
+			rwsem_check_handoff(sem, &waiter);
 		raw_spin_unlock_irq(&sem->wait_lock);
 
 		/* Block until there are no active lockers. */
@@ -460,8 +609,10 @@ struct rw_semaphore __sched *rwsem_down_write_failed(struct rw_semaphore *sem)
 	}
 	__set_current_state(TASK_RUNNING);
 
+	rwsem_clear_handoff(sem);
 	list_del(&waiter.list);
 	raw_spin_unlock_irq(&sem->wait_lock);
+	trace_contention_end(sem, 0);
 
 	return sem;
 }
@@ -0,0 +1,56 @@
+/*
+ * R/W semaphores: owner tracking shared by the public interface and the
+ * contention handling in rwsem-xadd.c.
+ *
+ * sem->owner is only a hint for optimistic spinning:
+ *  - a task pointer while a writer holds the lock,
+ *  - RWSEM_READER_OWNED once a reader has acquired it; readers do not
+ *    clear it on release, so it may be stale,
+ *  - NULL when the last writer released the lock.
+ */
+
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+#define RWSEM_READER_OWNED	((struct task_struct *)1UL)
+
+static inline void rwsem_set_owner(struct rw_semaphore *sem)
+{
+	sem->owner = current;
+}
+
+static inline void rwsem_clear_owner(struct rw_semaphore *sem)
+{
+	sem->owner = NULL;
+}
+
+static inline void rwsem_set_reader_owned(struct rw_semaphore *sem)
+{
+	/*
+	 * Only write to the rwsem cacheline when it is really needed, a
+	 * stream of readers would otherwise keep bouncing it around.
+	 */
+	if (ACCESS_ONCE(sem->owner) != RWSEM_READER_OWNED)
+		ACCESS_ONCE(sem->owner) = RWSEM_READER_OWNED;
+}
+
+static inline bool rwsem_owner_is_writer(struct task_struct *owner)
+{
+	return owner && owner != RWSEM_READER_OWNED;
+}
+
+static inline bool rwsem_owner_is_reader(struct task_struct *owner)
+{
+	return owner == RWSEM_READER_OWNED;
+}
+#else
+static inline void rwsem_set_owner(struct rw_semaphore *sem)
+{
+}
+
+static inline void rwsem_clear_owner(struct rw_semaphore *sem)
+{
+}
+
+static inline void rwsem_set_reader_owned(struct rw_semaphore *sem)
+{
+}
+#endif
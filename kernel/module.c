@@ -1231,11 +1231,32 @@ static const struct kernel_symbol *resolve_symbol(struct module *mod,
 	struct module *owner;
 	const struct kernel_symbol *sym;
 	const unsigned long *crc;
+	bool gplok = !(mod->taints & (1 << TAINT_PROPRIETARY_MODULE));
 	int err;
 
+	/*
+	 * Most imports resolve to vmlinux, whose symbols never go away and
+	 * need no reference taken: look those up without module_mutex, so
+	 * that modules loading in parallel do not serialise on it for every
+	 * symbol they import.
+	 */
+	preempt_disable();
+	sym = find_symbol(name, &owner, &crc, gplok, true);
+	preempt_enable();
+	if (!sym)
+		return NULL;
+	if (!owner) {
+		if (!check_version(info->sechdrs, info->index.vers, name, mod,
+				   crc, owner)) {
+			strncpy(ownername, module_name(owner), MODULE_NAME_LEN);
+			return ERR_PTR(-EINVAL);
+		}
+		return sym;
+	}
+
+	/* Exported by a module: look again with the owner pinned. */
 	mutex_lock(&module_mutex);
-	sym = find_symbol(name, &owner, &crc,
-			  !(mod->taints & (1 << TAINT_PROPRIETARY_MODULE)), true);
+	sym = find_symbol(name, &owner, &crc, gplok, false);
 	if (!sym)
 		goto unlock;
 
@@ -3012,6 +3033,7 @@ static void do_mod_ctors(struct module *mod)
 /* This is where the real work happens */
 static int do_init_module(struct module *mod)
 {
+	void *init_mem;
 	int ret = 0;
 
 	/*
@@ -3079,7 +3101,7 @@ static int do_init_module(struct module *mod)
 	mod->strtab = mod->core_strtab;
 #endif
 	unset_module_init_ro_nx(mod);
-	module_free(mod, mod->module_init);
+	init_mem = mod->module_init;
 	mod->module_init = NULL;
 	mod->init_size = 0;
 	mod->init_ro_size = 0;
@@ -3087,6 +3109,9 @@ static int do_init_module(struct module *mod)
 	mutex_unlock(&module_mutex);
 	wake_up_all(&module_wq);
 
+	/* mod no longer points at the init region: free it unlocked. */
+	module_free(mod, init_mem);
+
 	return 0;
 }
 
@@ -3140,6 +3165,20 @@ static int complete_formation(struct module *mod, struct load_info *info)
 {
 	int err;
 
+	/*
+	 * Set RO and NX regions for core and init.  The page attribute
+	 * changes are slow and need no lock: set_all_modules_text_rw()
+	 * and friends skip us while we are still unformed.
+	 */
+	set_section_ro_nx(mod->module_core,
+				mod->core_text_size,
+				mod->core_ro_size,
+				mod->core_size);
+	set_section_ro_nx(mod->module_init,
+				mod->init_text_size,
+				mod->init_ro_size,
+				mod->init_size);
+
 	mutex_lock(&module_mutex);
 
 	/* Find duplicate symbols (must be called under lock). */
@@ -3150,18 +3189,6 @@ static int complete_formation(struct module *mod, struct load_info *info)
 	/* This relies on module_mutex for list integrity. */
 	module_bug_finalize(info->hdr, info->sechdrs, mod);
 
-	/* Set RO and NX regions for core */
-	set_section_ro_nx(mod->module_core,
-				mod->core_text_size,
-				mod->core_ro_size,
-				mod->core_size);
-
-	/* Set RO and NX regions for init */
-	set_section_ro_nx(mod->module_init,
-				mod->init_text_size,
-				mod->init_ro_size,
-				mod->init_size);
-
 	/* Mark state as coming so strong_try_module_get() ignores us,
 	 * but kallsyms etc. can see us. */
 	mod->state = MODULE_STATE_COMING;
@@ -3173,6 +3200,8 @@ static int complete_formation(struct module *mod, struct load_info *info)
 
 out:
 	mutex_unlock(&module_mutex);
+	unset_module_init_ro_nx(mod);
+	unset_module_core_ro_nx(mod);
 	return err;
 }
 
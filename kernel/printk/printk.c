@@ -45,6 +45,7 @@
 #include <linux/poll.h>
 #include <linux/irq_work.h>
 #include <linux/utsname.h>
+#include <linux/kthread.h>
 
 #include <asm/uaccess.h>
 
@@ -1449,6 +1450,28 @@ static int console_trylock_for_printk(unsigned int cpu)
 	return 1;
 }
 
+/*
+ * Once printk_kthread is running, printk() only stores the message and
+ * leaves printing it on the consoles to the kthread, so that callers
+ * never wait for a slow console.  Oopses, panics and the boot and
+ * shutdown paths still print synchronously, as does everything when
+ * printk.synchronous is set.
+ */
+static bool __read_mostly printk_sync;
+module_param_named(synchronous, printk_sync, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(synchronous, "print to the consoles from the caller's context");
+
+static struct task_struct *printk_kthread;
+static bool printk_kthread_need_flush;
+
+static bool printk_offload_console(void)
+{
+	return printk_kthread && !ACCESS_ONCE(printk_sync) &&
+		!oops_in_progress && system_state == SYSTEM_RUNNING;
+}
+
+static void defer_console_output(void);
+
 int printk_delay_msec __read_mostly;
 
 static inline void printk_delay(void)
@@ -1719,13 +1742,16 @@ asmlinkage int vprintk_emit(int facility, int level,
 
 	/* If called from the scheduler, we can not call up(). */
 	if (!in_sched) {
-		/*
-		 * Try to acquire and then immediately release the console
-		 * semaphore.  The release will print out buffers and wake up
-		 * /dev/kmsg and syslog() users.
-		 */
-		if (console_trylock_for_printk(this_cpu))
+		if (printk_offload_console()) {
+			defer_console_output();
+		} else if (console_trylock_for_printk(this_cpu)) {
+			/*
+			 * Try to acquire and then immediately release the
+			 * console semaphore.  The release will print out
+			 * buffers and wake up /dev/kmsg and syslog() users.
+			 */
 			console_unlock();
+		}
 	}
 
 	lockdep_on();
@@ -2551,9 +2577,13 @@ static void wake_up_klogd_work_func(struct irq_work *irq_work)
 	int pending = __this_cpu_xchg(printk_pending, 0);
 
 	if (pending & PRINTK_PENDING_OUTPUT) {
-		/* If trylock fails, someone else is doing the printing */
-		if (console_trylock())
+		if (printk_offload_console()) {
+			printk_kthread_need_flush = true;
+			wake_up_process(printk_kthread);
+		} else if (console_trylock()) {
+			/* If trylock fails, someone else is doing the printing */
 			console_unlock();
+		}
 	}
 
 	if (pending & PRINTK_PENDING_WAKEUP)
@@ -2575,6 +2605,14 @@ void wake_up_klogd(void)
 	preempt_enable();
 }
 
+static void defer_console_output(void)
+{
+	preempt_disable();
+	__this_cpu_or(printk_pending, PRINTK_PENDING_OUTPUT);
+	irq_work_queue(&__get_cpu_var(wake_up_klogd_work));
+	preempt_enable();
+}
+
 int printk_deferred(const char *fmt, ...)
 {
 	va_list args;
@@ -2585,13 +2623,44 @@ int printk_deferred(const char *fmt, ...)
 	r = vprintk_emit(0, SCHED_MESSAGE_LOGLEVEL, NULL, 0, fmt, args);
 	va_end(args);
 
-	__this_cpu_or(printk_pending, PRINTK_PENDING_OUTPUT);
-	irq_work_queue(&__get_cpu_var(wake_up_klogd_work));
+	defer_console_output();
 	preempt_enable();
 
 	return r;
 }
 
+static int printk_kthread_func(void *data)
+{
+	while (1) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!printk_kthread_need_flush)
+			schedule();
+
+		__set_current_state(TASK_RUNNING);
+		printk_kthread_need_flush = false;
+
+		console_lock();
+		console_unlock();
+	}
+
+	return 0;
+}
+
+static int __init init_printk_kthread(void)
+{
+	struct task_struct *thread;
+
+	thread = kthread_run(printk_kthread_func, NULL, "printk");
+	if (IS_ERR(thread)) {
+		pr_err("printk: unable to create printing thread\n");
+		return PTR_ERR(thread);
+	}
+
+	printk_kthread = thread;
+	return 0;
+}
+late_initcall(init_printk_kthread);
+
 /*
  * printk rate limiting, lifted from the networking subsystem.
  *
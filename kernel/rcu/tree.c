@@ -2917,16 +2917,42 @@ static int synchronize_sched_expedited_cpu_stop(void *data)
 	return 0;
 }
 
+/*
+ * Select the online CPUs that might be in an RCU-sched read-side
+ * critical section.  CPUs in dyntick-idle or nohz_full usermode have an
+ * even ->dynticks counter: they are in an extended quiescent state and
+ * will execute a full barrier on their way out of it, so they need not
+ * be stopped.  Neither does the current CPU, which is running us.
+ */
+static void sync_sched_exp_select_cpus(struct cpumask *cm)
+{
+	int cpu;
+
+	cpumask_copy(cm, cpu_online_mask);
+	cpumask_clear_cpu(raw_smp_processor_id(), cm);
+	for_each_cpu(cpu, cm) {
+		struct rcu_dynticks *rdtp = &per_cpu(rcu_dynticks, cpu);
+
+		/* atomic_add_return() orders against the EQS entry. */
+		if (!(atomic_add_return(0, &rdtp->dynticks) & 0x1))
+			cpumask_clear_cpu(cpu, cm);
+	}
+}
+
 /**
  * synchronize_sched_expedited - Brute-force RCU-sched grace period
  *
  * Wait for an RCU-sched grace period to elapse, but use a "big hammer"
  * approach to force the grace period to end quickly.  This consumes
- * significant time on all CPUs and is unfriendly to real-time workloads,
- * so is thus not recommended for any sort of common-case code.  In fact,
- * if you are using synchronize_sched_expedited() in a loop, please
- * restructure your code to batch your updates, and then use a single
- * synchronize_sched() instead.
+ * significant time on all non-idle CPUs and is unfriendly to real-time
+ * workloads, so is thus not recommended for any sort of common-case
+ * code.  In fact, if you are using synchronize_sched_expedited() in a
+ * loop, please restructure your code to batch your updates, and then use
+ * a single synchronize_sched() instead.
+ *
+ * CPUs that are idle or running nohz_full usermode are in an extended
+ * quiescent state and are left alone, only CPUs that might be executing
+ * in the kernel are stopped.
  *
  * Note that it is illegal to call this function while holding any lock
  * that is acquired by a CPU-hotplug notifier.  And yes, it is also illegal
@@ -2956,6 +2982,8 @@ static int synchronize_sched_expedited_cpu_stop(void *data)
  */
 void synchronize_sched_expedited(void)
 {
+	cpumask_var_t cm;
+	bool cma;
 	long firstsnap, s, snap;
 	int trycount = 0;
 	struct rcu_state *rsp = &rcu_sched_state;
@@ -2982,14 +3010,22 @@ void synchronize_sched_expedited(void)
 	 */
 	snap = atomic_long_inc_return(&rsp->expedited_start);
 	firstsnap = snap;
+
+	/* Without a mask, fall back to stopping every online CPU. */
+	cma = zalloc_cpumask_var(&cm, GFP_KERNEL);
+
 	get_online_cpus();
 	WARN_ON_ONCE(cpu_is_offline(raw_smp_processor_id()));
+	if (cma)
+		sync_sched_exp_select_cpus(cm);
 
 	/*
 	 * Each pass through the following loop attempts to force a
-	 * context switch on each CPU.
+	 * context switch on each CPU that is not in an extended
+	 * quiescent state.  If there is none, we are already done.
 	 */
-	while (try_stop_cpus(cpu_online_mask,
+	while (!(cma && cpumask_empty(cm)) &&
+	       try_stop_cpus(cma ? cm : cpu_online_mask,
 			     synchronize_sched_expedited_cpu_stop,
 			     NULL) == -EAGAIN) {
 		put_online_cpus();
@@ -3001,6 +3037,7 @@ void synchronize_sched_expedited(void)
 			/* ensure test happens before caller kfree */
 			smp_mb__before_atomic(); /* ^^^ */
 			atomic_long_inc(&rsp->expedited_workdone1);
+			free_cpumask_var(cm);
 			return;
 		}
 
@@ -3010,6 +3047,7 @@ void synchronize_sched_expedited(void)
 		} else {
 			wait_rcu_gp(call_rcu_sched);
 			atomic_long_inc(&rsp->expedited_normal);
+			free_cpumask_var(cm);
 			return;
 		}
 
@@ -3019,6 +3057,7 @@ void synchronize_sched_expedited(void)
 			/* ensure test happens before caller kfree */
 			smp_mb__before_atomic(); /* ^^^ */
 			atomic_long_inc(&rsp->expedited_workdone2);
+			free_cpumask_var(cm);
 			return;
 		}
 
@@ -3032,8 +3071,11 @@ void synchronize_sched_expedited(void)
 		get_online_cpus();
 		snap = atomic_long_read(&rsp->expedited_start);
 		smp_mb(); /* ensure read is before try_stop_cpus(). */
+		if (cma)
+			sync_sched_exp_select_cpus(cm);
 	}
 	atomic_long_inc(&rsp->expedited_stoppedcpus);
+	free_cpumask_var(cm);
 
 	/*
 	 * Everyone up to our most recent fetch is covered by our grace
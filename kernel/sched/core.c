@@ -643,18 +643,25 @@ int get_nohz_timer_target(int pinned)
 	int i;
 	struct sched_domain *sd;
 
-	if (pinned || !get_sysctl_timer_migration() || !idle_cpu(cpu))
+	if (pinned || !get_sysctl_timer_migration())
+		return cpu;
+
+	if (!idle_cpu(cpu) && is_housekeeping_cpu(cpu))
 		return cpu;
 
 	rcu_read_lock();
 	for_each_domain(cpu, sd) {
 		for_each_cpu(i, sched_domain_span(sd)) {
-			if (!idle_cpu(i)) {
+			if (!idle_cpu(i) && is_housekeeping_cpu(i)) {
 				cpu = i;
 				goto unlock;
 			}
 		}
 	}
+
+	/* keep unpinned timers off full dynticks CPUs */
+	if (!is_housekeeping_cpu(cpu))
+		cpu = housekeeping_any_cpu();
 unlock:
 	rcu_read_unlock();
 	return cpu;
@@ -1616,6 +1623,26 @@ bool cpus_share_cache(int this_cpu, int that_cpu)
 {
 	return per_cpu(sd_llc_id, this_cpu) == per_cpu(sd_llc_id, that_cpu);
 }
+
+/*
+ * Queue the wakeup on the target's wake_list rather than taking its
+ * rq->lock from here: always when the cpus don't share a cache, and
+ * within the LLC when the target is idle and polling on need_resched.
+ * The latter costs no IPI, wakers stop bouncing the idle cpu's rq->lock
+ * between them, and the activation runs on the cpu that will run the
+ * task.  Wakeups queued back to back only notify the target once.
+ */
+static bool ttwu_queue_cond(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+	int this_cpu = smp_processor_id();
+
+	if (!cpus_share_cache(this_cpu, cpu))
+		return true;
+
+	return sched_feat(TTWU_QUEUE_IDLE) && cpu != this_cpu &&
+	       is_idle_task(ACCESS_ONCE(rq->curr)) && tsk_is_polling(rq->idle);
+}
 #endif /* CONFIG_SMP */
 
 static void ttwu_queue(struct task_struct *p, int cpu)
@@ -1623,7 +1650,7 @@ static void ttwu_queue(struct task_struct *p, int cpu)
 	struct rq *rq = cpu_rq(cpu);
 
 #if defined(CONFIG_SMP)
-	if (sched_feat(TTWU_QUEUE) && !cpus_share_cache(smp_processor_id(), cpu)) {
+	if (sched_feat(TTWU_QUEUE) && ttwu_queue_cond(cpu)) {
 		sched_clock_cpu(cpu); /* sync clocks x-cpu */
 		ttwu_queue_remote(p, cpu);
 		return;
@@ -1767,6 +1794,61 @@ int wake_up_state(struct task_struct *p, unsigned int state)
 	return try_to_wake_up(p, state, 0);
 }
 
+/**
+ * wake_q_add - queue a wakeup for later
+ * @head: the wake-queue
+ * @task: the task to wake
+ *
+ * Takes a reference on @task, which wake_up_q() drops.  If @task is
+ * already queued somewhere this is a no-op: it is going to be woken
+ * anyway.
+ */
+void wake_q_add(struct wake_q_head *head, struct task_struct *task)
+{
+	struct wake_q_node *node = &task->wake_q;
+
+	/*
+	 * Atomically grab the task; if ->wake_q is non-NULL it is already
+	 * queued and will get its wakeup from there.
+	 *
+	 * The cmpxchg() implies a full barrier, which pairs with the write
+	 * barrier implied by the wakeup in wake_up_q().
+	 */
+	if (cmpxchg(&node->next, NULL, WAKE_Q_TAIL))
+		return;
+
+	get_task_struct(task);
+
+	/* The head is context local, there can be no concurrency. */
+	*head->lastp = node;
+	head->lastp = &node->next;
+}
+
+/**
+ * wake_up_q - wake all tasks queued on a wake-queue
+ * @head: the wake-queue
+ */
+void wake_up_q(struct wake_q_head *head)
+{
+	struct wake_q_node *node = head->first;
+
+	while (node != WAKE_Q_TAIL) {
+		struct task_struct *task;
+
+		task = container_of(node, struct task_struct, wake_q);
+		/* task can safely be re-inserted now */
+		node = node->next;
+		task->wake_q.next = NULL;
+
+		/*
+		 * wake_up_process() implies a wmb() to pair with the queueing
+		 * in wake_q_add() so as not to miss wakeups.
+		 */
+		wake_up_process(task);
+		put_task_struct(task);
+	}
+}
+
 /*
  * Perform scheduler related setup for a newly forked process p.
  * p is forked by current.
@@ -1783,6 +1865,7 @@ static void __sched_fork(unsigned long clone_flags, struct task_struct *p)
 	p->se.prev_sum_exec_runtime	= 0;
 	p->se.nr_migrations		= 0;
 	p->se.vruntime			= 0;
+	p->se.latency_nice		= current->se.latency_nice;
 	INIT_LIST_HEAD(&p->se.group_node);
 
 #ifdef CONFIG_SCHEDSTATS
@@ -1900,6 +1983,9 @@ int sched_fork(unsigned long clone_flags, struct task_struct *p)
 		} else if (PRIO_TO_NICE(p->static_prio) < 0)
 			p->static_prio = NICE_TO_PRIO(0);
 
+		if (p->se.latency_nice < 0)
+			p->se.latency_nice = 0;
+
 		p->prio = p->normal_prio = __normal_prio(p);
 		set_load_weight(p);
 
@@ -2006,11 +2092,18 @@ void __dl_add(struct dl_bw *dl_b, u64 tsk_bw)
 	dl_b->total_bw += tsk_bw;
 }
 
+/*
+ * Per-cpu bandwidth promised to task groups through cpu.dl_runtime_us;
+ * it is taken out of every root domain, on each of its cpus.
+ */
+static u64 dl_resv_bw;
+
 static inline
 bool __dl_overflow(struct dl_bw *dl_b, int cpus, u64 old_bw, u64 new_bw)
 {
 	return dl_b->bw != -1 &&
-	       dl_b->bw * cpus < dl_b->total_bw - old_bw + new_bw;
+	       dl_b->bw * cpus < dl_b->total_bw - old_bw + new_bw +
+				 dl_resv_bw * cpus;
 }
 
 /*
@@ -2510,35 +2603,74 @@ void scheduler_tick(void)
 	rq->idle_balance = idle_cpu(cpu);
 	trigger_load_balance(rq);
 #endif
-	rq_last_tick_reset(rq);
 }
 
 #ifdef CONFIG_NO_HZ_FULL
-/**
- * scheduler_tick_max_deferment
- *
- * Keep at least one tick per second when a single
- * active task is running because the scheduler doesn't
- * yet completely support full dynticks environment.
- *
- * This makes sure that uptime, CFS vruntime, load
- * balancing, etc... continue to move forward, even
- * with a very low granularity.
- *
- * Return: Maximum deferment in nanoseconds.
+/*
+ * A full dynticks CPU running a single task used to keep a 1Hz tick so
+ * that CFS vruntime, the task's runtime accounting and the like kept
+ * moving forward.  Instead, a housekeeping CPU ticks the scheduler of
+ * every stopped nohz_full CPU remotely, once a second, from the unbound
+ * workqueue (itself confined to housekeeping CPUs).
  */
-u64 scheduler_tick_max_deferment(void)
+struct tick_work {
+	int			cpu;
+	struct delayed_work	work;
+};
+
+static struct tick_work __percpu *tick_work_cpu;
+
+static void sched_tick_remote(struct work_struct *work)
 {
-	struct rq *rq = this_rq();
-	unsigned long next, now = ACCESS_ONCE(jiffies);
+	struct delayed_work *dwork = to_delayed_work(work);
+	struct tick_work *twork = container_of(dwork, struct tick_work, work);
+	int cpu = twork->cpu;
+	struct rq *rq = cpu_rq(cpu);
+	struct task_struct *curr;
+	unsigned long flags;
 
-	next = rq->last_sched_tick + HZ;
+	/*
+	 * Handle the tick only if it appears the remote CPU is running in
+	 * full dynticks mode.  The check is racy by nature, but missing a
+	 * tick or having one too much is no big deal because the scheduler
+	 * tick updates statistics and checks timeslices in a time-independent
+	 * way, regardless of when exactly it is running.
+	 */
+	if (!cpu_online(cpu) || idle_cpu(cpu) || !tick_nohz_tick_stopped_cpu(cpu))
+		goto out_requeue;
 
-	if (time_before_eq(next, now))
-		return 0;
+	raw_spin_lock_irqsave(&rq->lock, flags);
+	curr = rq->curr;
+	if (!is_idle_task(curr)) {
+		update_rq_clock(rq);
+		curr->sched_class->task_tick(rq, curr, 0);
+	}
+	raw_spin_unlock_irqrestore(&rq->lock, flags);
 
-	return jiffies_to_nsecs(next - now);
+out_requeue:
+	queue_delayed_work(system_unbound_wq, dwork, HZ);
 }
+
+static void __init sched_tick_remote_init(void)
+{
+	struct tick_work *twork;
+	int cpu;
+
+	if (!tick_nohz_full_enabled())
+		return;
+
+	tick_work_cpu = alloc_percpu(struct tick_work);
+	BUG_ON(!tick_work_cpu);
+
+	for_each_cpu(cpu, tick_nohz_full_mask) {
+		twork = per_cpu_ptr(tick_work_cpu, cpu);
+		twork->cpu = cpu;
+		INIT_DELAYED_WORK(&twork->work, sched_tick_remote);
+		queue_delayed_work(system_unbound_wq, &twork->work, HZ);
+	}
+}
+#else
+static inline void sched_tick_remote_init(void) { }
 #endif
 
 notrace unsigned long get_parent_ip(unsigned long addr)
@@ -2790,6 +2922,7 @@ need_resched:
 	if (likely(prev != next)) {
 		rq->nr_switches++;
 		rq->curr = next;
+		sched_core_update(rq, next);
 		++*switch_count;
 
 		context_switch(rq, prev, next); /* unlocks the rq */
@@ -3218,6 +3351,9 @@ static void __setscheduler_params(struct task_struct *p,
 	else if (fair_policy(policy))
 		p->static_prio = NICE_TO_PRIO(attr->sched_nice);
 
+	if (attr->sched_flags & SCHED_FLAG_LATENCY_NICE)
+		p->se.latency_nice = attr->sched_latency_nice;
+
 	/*
 	 * __sched_setscheduler() ensures attr->sched_priority == 0 when
 	 * !rt_policy. Always setting this ensures that things like
@@ -3347,9 +3483,16 @@ recheck:
 			return -EINVAL;
 	}
 
-	if (attr->sched_flags & ~(SCHED_FLAG_RESET_ON_FORK))
+	if (attr->sched_flags &
+	    ~(SCHED_FLAG_RESET_ON_FORK | SCHED_FLAG_LATENCY_NICE))
 		return -EINVAL;
 
+	if (attr->sched_flags & SCHED_FLAG_LATENCY_NICE) {
+		if (attr->sched_latency_nice < MIN_LATENCY_NICE ||
+		    attr->sched_latency_nice > MAX_LATENCY_NICE)
+			return -EINVAL;
+	}
+
 	/*
 	 * Valid priorities for SCHED_FIFO and SCHED_RR are
 	 * 1..MAX_USER_RT_PRIO-1, valid priority for SCHED_NORMAL,
@@ -3372,6 +3515,11 @@ recheck:
 				return -EPERM;
 		}
 
+		/* can't ask for lower wakeup latency than we have */
+		if ((attr->sched_flags & SCHED_FLAG_LATENCY_NICE) &&
+		    attr->sched_latency_nice < p->se.latency_nice)
+			return -EPERM;
+
 		if (rt_policy(policy)) {
 			unsigned long rlim_rtprio =
 					task_rlimit(p, RLIMIT_RTPRIO);
@@ -3447,6 +3595,9 @@ recheck:
 			goto change;
 		if (dl_policy(policy))
 			goto change;
+		if ((attr->sched_flags & SCHED_FLAG_LATENCY_NICE) &&
+		    attr->sched_latency_nice != p->se.latency_nice)
+			goto change;
 
 		p->sched_reset_on_fork = reset_on_fork;
 		task_rq_unlock(rq, p, &flags);
@@ -3913,6 +4064,12 @@ SYSCALL_DEFINE4(sched_getattr, pid_t, pid, struct sched_attr __user *, uattr,
 	else
 		attr.sched_nice = task_nice(p);
 
+	/* only report it to callers that know about it */
+	if (size >= SCHED_ATTR_SIZE_VER1) {
+		attr.sched_flags |= SCHED_FLAG_LATENCY_NICE;
+		attr.sched_latency_nice = p->se.latency_nice;
+	}
+
 	rcu_read_unlock();
 
 	retval = sched_read_attr(uattr, &attr, size);
@@ -6826,6 +6983,17 @@ void __init sched_init_smp(void)
 
 	init_sched_rt_class();
 	init_sched_dl_class();
+
+#ifdef CONFIG_SCHED_SMT
+	/*
+	 * We've enumerated all CPUs and will assume that if any CPU
+	 * has SMT siblings, CPU0 will too.
+	 */
+	if (cpumask_weight(cpu_smt_mask(0)) > 1)
+		static_key_slow_inc(&sched_smt_present);
+#endif
+
+	sched_tick_remote_init();
 }
 #else
 void __init sched_init_smp(void)
@@ -6984,9 +7152,6 @@ void __init sched_init(void)
 #ifdef CONFIG_NO_HZ_COMMON
 		rq->nohz_flags = 0;
 #endif
-#ifdef CONFIG_NO_HZ_FULL
-		rq->last_sched_tick = 0;
-#endif
 #endif
 		init_rq_hrtick(rq);
 		atomic_set(&rq->nr_iowait, 0);
@@ -7489,6 +7654,118 @@ static long sched_group_rt_period(struct task_group *tg)
 }
 #endif /* CONFIG_RT_GROUP_SCHED */
 
+#ifdef CONFIG_FAIR_GROUP_SCHED
+static DEFINE_MUTEX(dl_resv_mutex);
+
+static u64 tg_dl_resv_bw(struct task_group *tg)
+{
+	if (!tg->dl_runtime)
+		return 0;
+
+	return to_ratio(tg->dl_period, tg->dl_runtime);
+}
+
+/*
+ * Can every root domain give up another @new_bw - @old_bw of each of its
+ * cpus on top of the -deadline tasks it already admitted?
+ */
+static int dl_resv_admit(u64 old_bw, u64 new_bw)
+{
+	unsigned long flags;
+	int cpu, cpus, ret = 0;
+
+	for_each_online_cpu(cpu) {
+		struct dl_bw *dl_b = dl_bw_of(cpu);
+
+		raw_spin_lock_irqsave(&dl_b->lock, flags);
+		cpus = dl_bw_cpus(cpu);
+		if (__dl_overflow(dl_b, cpus, old_bw * cpus, new_bw * cpus))
+			ret = -EBUSY;
+		raw_spin_unlock_irqrestore(&dl_b->lock, flags);
+
+		if (ret)
+			break;
+	}
+
+	return ret;
+}
+
+/*
+ * Reservations nest: the children of a reserved group have to fit in
+ * what it was given, and only top-level groups take bandwidth out of
+ * the root domains.
+ */
+static int tg_set_dl_reservation(struct task_group *tg, u64 period,
+				 u64 runtime)
+{
+	struct task_group *parent = tg->parent, *child;
+	u64 new_bw, old_bw, sum = 0;
+	int ret = 0;
+
+	if (tg == &root_task_group)
+		return -EINVAL;
+
+	/* same bounds as the CFS bandwidth period */
+	if (period < NSEC_PER_MSEC || period > NSEC_PER_SEC)
+		return -EINVAL;
+
+	if (runtime > period)
+		return -EINVAL;
+
+	/* below the resolution of the -deadline bandwidth checks */
+	if (runtime && runtime < (1ULL << DL_SCALE))
+		return -EINVAL;
+
+	new_bw = runtime ? to_ratio(period, runtime) : 0;
+
+	mutex_lock(&dl_resv_mutex);
+	rcu_read_lock();
+	old_bw = tg_dl_resv_bw(tg);
+
+	list_for_each_entry_rcu(child, &tg->children, siblings)
+		sum += tg_dl_resv_bw(child);
+	if (sum > new_bw) {
+		ret = -EBUSY;
+		goto unlock;
+	}
+
+	if (parent == &root_task_group) {
+		ret = dl_resv_admit(old_bw, new_bw);
+		if (!ret)
+			dl_resv_bw = dl_resv_bw - old_bw + new_bw;
+		goto unlock;
+	}
+
+	sum = 0;
+	list_for_each_entry_rcu(child, &parent->children, siblings) {
+		if (child != tg)
+			sum += tg_dl_resv_bw(child);
+	}
+	if (sum + new_bw > tg_dl_resv_bw(parent))
+		ret = -EBUSY;
+unlock:
+	rcu_read_unlock();
+
+	if (!ret)
+		sched_group_set_dl_reservation(tg, period, runtime);
+	mutex_unlock(&dl_resv_mutex);
+
+	return ret;
+}
+
+static void tg_free_dl_reservation(struct task_group *tg)
+{
+	if (!tg->dl_runtime || tg->parent != &root_task_group)
+		return;
+
+	mutex_lock(&dl_resv_mutex);
+	dl_resv_bw -= tg_dl_resv_bw(tg);
+	mutex_unlock(&dl_resv_mutex);
+}
+#else
+static inline void tg_free_dl_reservation(struct task_group *tg) { }
+#endif /* CONFIG_FAIR_GROUP_SCHED */
+
 #ifdef CONFIG_RT_GROUP_SCHED
 static int sched_rt_global_constraints(void)
 {
@@ -7553,7 +7830,7 @@ static int sched_dl_global_constraints(void)
 		struct dl_bw *dl_b = dl_bw_of(cpu);
 
 		raw_spin_lock_irqsave(&dl_b->lock, flags);
-		if (new_bw < dl_b->total_bw)
+		if (new_bw < dl_b->total_bw || new_bw < dl_resv_bw)
 			ret = -EBUSY;
 		raw_spin_unlock_irqrestore(&dl_b->lock, flags);
 
@@ -7704,6 +7981,10 @@ static void cpu_cgroup_css_free(struct cgroup_subsys_state *css)
 {
 	struct task_group *tg = css_tg(css);
 
+#ifdef CONFIG_SCHED_SMT
+	if (tg->core_cookie)
+		static_key_slow_dec(&sched_core_tagged);
+#endif
 	sched_destroy_group(tg);
 }
 
@@ -7711,6 +7992,7 @@ static void cpu_cgroup_css_offline(struct cgroup_subsys_state *css)
 {
 	struct task_group *tg = css_tg(css);
 
+	tg_free_dl_reservation(tg);
 	sched_offline_group(tg);
 }
 
@@ -8036,13 +8318,113 @@ static u64 cpu_rt_period_read_uint(struct cgroup_subsys_state *css,
 }
 #endif /* CONFIG_RT_GROUP_SCHED */
 
+#ifdef CONFIG_FAIR_GROUP_SCHED
+static int cpu_dl_runtime_write_u64(struct cgroup_subsys_state *css,
+				    struct cftype *cft, u64 dl_runtime_us)
+{
+	struct task_group *tg = css_tg(css);
+
+	if (dl_runtime_us > U64_MAX / NSEC_PER_USEC)
+		return -EINVAL;
+
+	return tg_set_dl_reservation(tg, tg->dl_period,
+				     dl_runtime_us * NSEC_PER_USEC);
+}
+
+static u64 cpu_dl_runtime_read_u64(struct cgroup_subsys_state *css,
+				   struct cftype *cft)
+{
+	u64 dl_runtime_us = css_tg(css)->dl_runtime;
+
+	do_div(dl_runtime_us, NSEC_PER_USEC);
+	return dl_runtime_us;
+}
+
+static int cpu_dl_period_write_u64(struct cgroup_subsys_state *css,
+				   struct cftype *cft, u64 dl_period_us)
+{
+	struct task_group *tg = css_tg(css);
+
+	if (dl_period_us > U64_MAX / NSEC_PER_USEC)
+		return -EINVAL;
+
+	return tg_set_dl_reservation(tg, dl_period_us * NSEC_PER_USEC,
+				     tg->dl_runtime);
+}
+
+static u64 cpu_dl_period_read_u64(struct cgroup_subsys_state *css,
+				  struct cftype *cft)
+{
+	u64 dl_period_us = css_tg(css)->dl_period;
+
+	do_div(dl_period_us, NSEC_PER_USEC);
+	return dl_period_us;
+}
+#endif /* CONFIG_FAIR_GROUP_SCHED */
+
+#ifdef CONFIG_SCHED_SMT
+struct static_key sched_core_tagged = STATIC_KEY_INIT_FALSE;
+static DEFINE_MUTEX(sched_core_mutex);
+
+static u64 cpu_core_tag_read_u64(struct cgroup_subsys_state *css,
+				 struct cftype *cft)
+{
+	return !!css_tg(css)->core_cookie;
+}
+
+static int cpu_core_tag_write_u64(struct cgroup_subsys_state *css,
+				  struct cftype *cft, u64 val)
+{
+	struct task_group *tg = css_tg(css);
+	unsigned long cookie;
+
+	if (val > 1)
+		return -ERANGE;
+
+	/* The group's address makes a cookie unique among live groups. */
+	cookie = val ? (unsigned long)tg : 0;
+
+	mutex_lock(&sched_core_mutex);
+	if (tg->core_cookie != cookie) {
+		if (cookie)
+			static_key_slow_inc(&sched_core_tagged);
+		else
+			static_key_slow_dec(&sched_core_tagged);
+		tg->core_cookie = cookie;
+	}
+	mutex_unlock(&sched_core_mutex);
+
+	return 0;
+}
+#endif /* CONFIG_SCHED_SMT */
+
 static struct cftype cpu_files[] = {
+#ifdef CONFIG_SCHED_SMT
+	{
+		.name = "core_tag",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = cpu_core_tag_read_u64,
+		.write_u64 = cpu_core_tag_write_u64,
+	},
+#endif
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	{
 		.name = "shares",
 		.read_u64 = cpu_shares_read_u64,
 		.write_u64 = cpu_shares_write_u64,
 	},
+	{
+		.name = "dl_runtime_us",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = cpu_dl_runtime_read_u64,
+		.write_u64 = cpu_dl_runtime_write_u64,
+	},
+	{
+		.name = "dl_period_us",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = cpu_dl_period_read_u64,
+		.write_u64 = cpu_dl_period_write_u64,
+	},
 #endif
 #ifdef CONFIG_CFS_BANDWIDTH
 	{
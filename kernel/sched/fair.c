@@ -664,6 +664,117 @@ static u64 sched_vslice(struct cfs_rq *cfs_rq, struct sched_entity *se)
 	return calc_delta_fair(sched_slice(cfs_rq, se), se);
 }
 
+/*
+ * The wakeup bias of an entity's latency_nice: it ranges over +-half a
+ * sched_latency period, negative for latency sensitive entities.  Group
+ * entities are always latency_nice 0.
+ */
+static inline s64 latency_offset(struct sched_entity *se)
+{
+	return div_s64((s64)sysctl_sched_latency * se->latency_nice,
+		       LATENCY_NICE_WIDTH);
+}
+
+#ifdef CONFIG_FAIR_GROUP_SCHED
+/*
+ * Runtime reservations: a task group with cpu.dl_runtime_us set is
+ * promised that much runtime every cpu.dl_period_us on each cpu, ahead
+ * of whatever its fair share would be.  The budget lives in the group's
+ * cfs_rq and is refilled lazily when its period has elapsed; while it
+ * lasts, the group entity is picked ahead of its unreserved peers.
+ * Admission control (see tg_set_dl_reservation()) makes sure the
+ * promises fit within the deadline bandwidth of every root domain.
+ */
+static inline bool cfs_rq_has_resv(struct cfs_rq *cfs_rq)
+{
+	return cfs_rq && cfs_rq->tg->dl_runtime;
+}
+
+static void resv_refill(struct cfs_rq *cfs_rq)
+{
+	struct task_group *tg = cfs_rq->tg;
+	u64 now = rq_clock(rq_of(cfs_rq));
+
+	if (likely((s64)(now - cfs_rq->resv_period_end) < 0))
+		return;
+
+	cfs_rq->resv_runtime = tg->dl_runtime;
+	cfs_rq->resv_period_end = now + tg->dl_period;
+}
+
+/* Does the group behind @se still have reserved runtime this period? */
+static bool entity_resv_eligible(struct sched_entity *se)
+{
+	struct cfs_rq *my_q = group_cfs_rq(se);
+
+	if (!cfs_rq_has_resv(my_q))
+		return false;
+
+	resv_refill(my_q);
+	return my_q->resv_runtime > 0;
+}
+
+static inline void account_resv_runtime(struct sched_entity *curr,
+					u64 delta_exec)
+{
+	struct cfs_rq *my_q = group_cfs_rq(curr);
+
+	if (!cfs_rq_has_resv(my_q))
+		return;
+
+	resv_refill(my_q);
+	my_q->resv_runtime -= delta_exec;
+}
+
+static struct sched_entity *pick_resv_entity(struct cfs_rq *cfs_rq)
+{
+	int cpu = cpu_of(rq_of(cfs_rq));
+	struct cfs_rq *my_q;
+
+	list_for_each_entry(my_q, &cfs_rq->resv_list, resv_node) {
+		struct sched_entity *se = my_q->tg->se[cpu];
+
+		if (entity_resv_eligible(se))
+			return se;
+	}
+
+	return NULL;
+}
+
+static void list_add_resv_entity(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+	struct cfs_rq *my_q = group_cfs_rq(se);
+
+	if (cfs_rq_has_resv(my_q) && list_empty(&my_q->resv_node))
+		list_add_tail(&my_q->resv_node, &cfs_rq->resv_list);
+}
+
+static void list_del_resv_entity(struct sched_entity *se)
+{
+	struct cfs_rq *my_q = group_cfs_rq(se);
+
+	if (my_q && !list_empty(&my_q->resv_node))
+		list_del_init(&my_q->resv_node);
+}
+#else /* CONFIG_FAIR_GROUP_SCHED */
+static inline bool entity_resv_eligible(struct sched_entity *se)
+{
+	return false;
+}
+
+static inline void account_resv_runtime(struct sched_entity *curr,
+					u64 delta_exec) { }
+
+static inline struct sched_entity *pick_resv_entity(struct cfs_rq *cfs_rq)
+{
+	return NULL;
+}
+
+static inline void
+list_add_resv_entity(struct cfs_rq *cfs_rq, struct sched_entity *se) { }
+static inline void list_del_resv_entity(struct sched_entity *se) { }
+#endif /* CONFIG_FAIR_GROUP_SCHED */
+
 #ifdef CONFIG_SMP
 static unsigned long task_h_load(struct task_struct *p);
 
@@ -719,6 +830,8 @@ static void update_curr(struct cfs_rq *cfs_rq)
 		trace_sched_stat_runtime(curtask, delta_exec, curr->vruntime);
 		cpuacct_charge(curtask, delta_exec);
 		account_group_exec_runtime(curtask, delta_exec);
+	} else {
+		account_resv_runtime(curr, delta_exec);
 	}
 
 	account_cfs_rq_runtime(cfs_rq, delta_exec);
@@ -1937,10 +2050,14 @@ void task_numa_work(struct callback_head *work)
 		 * Shared library pages mapped by multiple processes are not
 		 * migrated as it is expected they are cache replicated. Avoid
 		 * hinting faults in read-only file-backed mappings or the vdso
-		 * as migrating the pages will be of marginal benefit.
+		 * as migrating the pages will be of marginal benefit, unless
+		 * the mapping opted in with mbind(MPOL_MF_LAZY).
 		 */
-		if (!vma->vm_mm ||
-		    (vma->vm_file && (vma->vm_flags & (VM_READ|VM_WRITE)) == (VM_READ)))
+		if (!vma->vm_mm)
+			continue;
+		if (vma->vm_file &&
+		    (vma->vm_flags & (VM_READ|VM_WRITE)) == (VM_READ) &&
+		    !vma_policy_mof_explicit(vma))
 			continue;
 
 		/*
@@ -2751,6 +2868,9 @@ place_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int initial)
 			thresh >>= 1;
 
 		vruntime -= thresh;
+
+		/* latency sensitive sleepers get placed further left */
+		vruntime += latency_offset(se);
 	}
 
 	/* ensure we never gain time by being placed backwards. */
@@ -2787,6 +2907,7 @@ enqueue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 	if (se != cfs_rq->curr)
 		__enqueue_entity(cfs_rq, se);
 	se->on_rq = 1;
+	list_add_resv_entity(cfs_rq, se);
 
 	if (cfs_rq->nr_running == 1) {
 		list_add_leaf_cfs_rq(cfs_rq);
@@ -2869,6 +2990,7 @@ dequeue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 	if (se != cfs_rq->curr)
 		__dequeue_entity(cfs_rq, se);
 	se->on_rq = 0;
+	list_del_resv_entity(se);
 	account_entity_dequeue(cfs_rq, se);
 
 	/*
@@ -2965,6 +3087,8 @@ wakeup_preempt_entity(struct sched_entity *curr, struct sched_entity *se);
  * 2) pick the "next" process, since someone really wants that to run
  * 3) pick the "last" process, for cache locality
  * 4) do not run the "skip" process, if something else is available
+ *
+ * All of which comes after serving groups with reserved runtime left.
  */
 static struct sched_entity *
 pick_next_entity(struct cfs_rq *cfs_rq, struct sched_entity *curr)
@@ -2972,6 +3096,12 @@ pick_next_entity(struct cfs_rq *cfs_rq, struct sched_entity *curr)
 	struct sched_entity *left = __pick_first_entity(cfs_rq);
 	struct sched_entity *se;
 
+	se = pick_resv_entity(cfs_rq);
+	if (se) {
+		clear_buddies(cfs_rq, se);
+		return se;
+	}
+
 	/*
 	 * If curr is set we have to see if its left of the leftmost entity
 	 * still in the tree, provided there was anything in the tree at all.
@@ -4409,48 +4539,263 @@ find_idlest_cpu(struct sched_group *group, struct task_struct *p, int this_cpu)
 	return idlest;
 }
 
+#ifdef CONFIG_SCHED_SMT
+
+struct static_key sched_smt_present = STATIC_KEY_INIT_FALSE;
+
+/*
+ * While some task group has cpu.core_tag set, only consider @cpu for
+ * @p if every busy SMT sibling of it runs a task with @p's cookie.
+ */
+static bool sched_core_cookie_match(struct task_struct *p, int cpu)
+{
+	unsigned long cookie;
+	int sibling;
+
+	if (!static_key_false(&sched_core_tagged))
+		return true;
+
+	cookie = task_core_cookie(p);
+	for_each_cpu(sibling, cpu_smt_mask(cpu)) {
+		if (sibling == cpu || idle_cpu(sibling))
+			continue;
+		if (ACCESS_ONCE(cpu_rq(sibling)->core_cookie) != cookie)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Whether the LLC may have a fully idle core.  The flag of an LLC lives
+ * in the per-cpu area of its first cpu, sd_llc_id, so all of its cpus
+ * share one copy without any allocation tied to the domain lifetime.
+ * It is only a hint: set on idle entry, cleared by a scan that failed.
+ */
+static DEFINE_PER_CPU(int, sd_llc_idle_cores);
+
+static inline void set_idle_cores(int cpu, int val)
+{
+	ACCESS_ONCE(per_cpu(sd_llc_idle_cores, per_cpu(sd_llc_id, cpu))) = val;
+}
+
+static inline bool test_idle_cores(int cpu)
+{
+	return ACCESS_ONCE(per_cpu(sd_llc_idle_cores, per_cpu(sd_llc_id, cpu)));
+}
+
+/*
+ * Scans the local SMT mask to see if the entire core is idle, and records
+ * this in the LLC's idle cores hint.  Called when a cpu goes idle.
+ *
+ * Since SMT siblings share all cache levels, inspecting this limited remote
+ * state should be fairly cheap.
+ */
+void __update_idle_core(struct rq *rq)
+{
+	int core = cpu_of(rq);
+	int cpu;
+
+	if (test_idle_cores(core))
+		return;
+
+	for_each_cpu(cpu, cpu_smt_mask(core)) {
+		if (cpu == core)
+			continue;
+
+		if (!idle_cpu(cpu))
+			return;
+	}
+
+	set_idle_cores(core, 1);
+}
+
+/*
+ * Scan the entire LLC domain for idle cores; this dynamically switches off
+ * if there are no idle cores left in the LLC, and is enabled again through
+ * update_idle_core() above.
+ */
+static int select_idle_core(struct task_struct *p, struct sched_domain *sd,
+			    int target)
+{
+	int core, cpu;
+
+	if (!static_key_false(&sched_smt_present))
+		return -1;
+
+	if (!test_idle_cores(target))
+		return -1;
+
+	for_each_cpu_wrap(core, sched_domain_span(sd), target) {
+		bool idle = true;
+		int allowed = -1;
+
+		/* Visit each core once, through its first sibling. */
+		if (core != cpumask_first(cpu_smt_mask(core)))
+			continue;
+
+		for_each_cpu(cpu, cpu_smt_mask(core)) {
+			if (!idle_cpu(cpu)) {
+				idle = false;
+				break;
+			}
+			if (allowed < 0 &&
+			    cpumask_test_cpu(cpu, tsk_cpus_allowed(p)))
+				allowed = cpu;
+		}
+
+		if (idle && allowed >= 0)
+			return allowed;
+	}
+
+	/*
+	 * Failed to find an idle core; stop looking for one.
+	 */
+	set_idle_cores(target, 0);
+
+	return -1;
+}
+
+/*
+ * Scan the local SMT mask for idle CPUs.
+ */
+static int select_idle_smt(struct task_struct *p, int target)
+{
+	int cpu;
+
+	if (!static_key_false(&sched_smt_present))
+		return -1;
+
+	for_each_cpu(cpu, cpu_smt_mask(target)) {
+		if (!cpumask_test_cpu(cpu, tsk_cpus_allowed(p)))
+			continue;
+		if (idle_cpu(cpu) && sched_core_cookie_match(p, cpu))
+			return cpu;
+	}
+
+	return -1;
+}
+
+#else /* CONFIG_SCHED_SMT */
+
+static inline bool sched_core_cookie_match(struct task_struct *p, int cpu)
+{
+	return true;
+}
+
+static inline int select_idle_core(struct task_struct *p,
+				   struct sched_domain *sd, int target)
+{
+	return -1;
+}
+
+static inline int select_idle_smt(struct task_struct *p, int target)
+{
+	return -1;
+}
+
+#endif /* CONFIG_SCHED_SMT */
+
+/* An idle cpu @p may be placed on without sharing a core with strangers */
+static inline bool idle_cpu_for(struct task_struct *p, int cpu)
+{
+	return idle_cpu(cpu) && sched_core_cookie_match(p, cpu);
+}
+
+/*
+ * Scan the LLC domain for idle CPUs; this is dynamically regulated by
+ * comparing the average scan cost (tracked in sd->avg_scan_cost) against
+ * the average idle time for this rq (as found in rq->avg_idle).
+ */
+static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd,
+			   int target)
+{
+	struct sched_domain *this_sd;
+	u64 avg_cost, avg_idle;
+	u64 time, cost;
+	s64 delta;
+	int cpu, nr = INT_MAX;
+
+	this_sd = rcu_dereference(*this_cpu_ptr(&sd_llc));
+	if (!this_sd)
+		return -1;
+
+	/*
+	 * Due to large variance we need a large fuzz factor; hackbench in
+	 * particularly is sensitive here.
+	 */
+	avg_idle = this_rq()->avg_idle / 512;
+	avg_cost = this_sd->avg_scan_cost + 1;
+
+	if (sched_feat(SIS_AVG_CPU) && avg_idle < avg_cost)
+		return -1;
+
+	if (sched_feat(SIS_PROP)) {
+		u64 span_avg = sd->span_weight * avg_idle;
+		if (span_avg > 4*avg_cost)
+			nr = div_u64(span_avg, avg_cost);
+		else
+			nr = 4;
+	}
+
+	time = local_clock();
+
+	for_each_cpu_wrap(cpu, sched_domain_span(sd), target) {
+		if (!--nr) {
+			cpu = -1;
+			break;
+		}
+		if (!cpumask_test_cpu(cpu, tsk_cpus_allowed(p)))
+			continue;
+		if (idle_cpu_for(p, cpu))
+			break;
+	}
+
+	time = local_clock() - time;
+	cost = this_sd->avg_scan_cost;
+	delta = (s64)(time - cost) / 8;
+	this_sd->avg_scan_cost += delta;
+
+	return cpu;
+}
+
 /*
  * Try and locate an idle CPU in the sched_domain.
  */
 static int select_idle_sibling(struct task_struct *p, int target)
 {
 	struct sched_domain *sd;
-	struct sched_group *sg;
 	int i = task_cpu(p);
 
-	if (idle_cpu(target))
+	if (idle_cpu_for(p, target))
 		return target;
 
 	/*
 	 * If the prevous cpu is cache affine and idle, don't be stupid.
 	 */
-	if (i != target && cpus_share_cache(i, target) && idle_cpu(i))
+	if (i != target && cpus_share_cache(i, target) && idle_cpu_for(p, i))
 		return i;
 
+	sd = rcu_dereference(per_cpu(sd_llc, target));
+	if (!sd)
+		return target;
+
 	/*
-	 * Otherwise, iterate the domains and find an elegible idle cpu.
+	 * Prefer a fully idle core, then an idle cpu found within a scan
+	 * bounded by the expected idle time, then an idle SMT sibling.
 	 */
-	sd = rcu_dereference(per_cpu(sd_llc, target));
-	for_each_lower_domain(sd) {
-		sg = sd->groups;
-		do {
-			if (!cpumask_intersects(sched_group_cpus(sg),
-						tsk_cpus_allowed(p)))
-				goto next;
+	i = select_idle_core(p, sd, target);
+	if ((unsigned)i < nr_cpu_ids)
+		return i;
 
-			for_each_cpu(i, sched_group_cpus(sg)) {
-				if (i == target || !idle_cpu(i))
-					goto next;
-			}
+	i = select_idle_cpu(p, sd, target);
+	if ((unsigned)i < nr_cpu_ids)
+		return i;
+
+	i = select_idle_smt(p, target);
+	if ((unsigned)i < nr_cpu_ids)
+		return i;
 
-			target = cpumask_first_and(sched_group_cpus(sg),
-					tsk_cpus_allowed(p));
-			goto done;
-next:
-			sg = sg->next;
-		} while (sg != sd->groups);
-	}
-done:
 	return target;
 }
 
@@ -4620,6 +4965,8 @@ wakeup_preempt_entity(struct sched_entity *curr, struct sched_entity *se)
 {
 	s64 gran, vdiff = curr->vruntime - se->vruntime;
 
+	vdiff += latency_offset(curr) - latency_offset(se);
+
 	if (vdiff <= 0)
 		return -1;
 
@@ -4710,6 +5057,11 @@ static void check_preempt_wakeup(struct rq *rq, struct task_struct *p, int wake_
 	find_matching_se(&se, &pse);
 	update_curr(cfs_rq_of(se));
 	BUG_ON(!pse);
+
+	/* a group with reserved runtime left goes ahead of one without */
+	if (entity_resv_eligible(pse) && !entity_resv_eligible(se))
+		goto preempt;
+
 	if (wakeup_preempt_entity(se, pse) == 1) {
 		/*
 		 * Bias pick_next to pick the sched entity that is
@@ -5410,6 +5762,23 @@ next:
 }
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
+/*
+ * A cfs_rq can leave the leaf list once nothing is queued on it and both
+ * its own and its group entity's averages have decayed to zero; its
+ * tg_load_contrib has then been folded back out of the task group too.
+ */
+static inline bool cfs_rq_is_decayed(struct cfs_rq *cfs_rq,
+				     struct sched_entity *se)
+{
+	if (cfs_rq->nr_running)
+		return false;
+
+	if (cfs_rq->runnable_load_avg || cfs_rq->blocked_load_avg)
+		return false;
+
+	return !se->avg.runnable_avg_sum;
+}
+
 /*
  * update tg->load_weight by folding this cpu's load_avg
  */
@@ -5427,15 +5796,16 @@ static void __update_blocked_averages_cpu(struct task_group *tg, int cpu)
 	if (se) {
 		update_entity_load_avg(se, 1);
 		/*
-		 * We pivot on our runnable average having decayed to zero for
-		 * list removal.  This generally implies that all our children
-		 * have also been removed (modulo rounding error or bandwidth
-		 * control); however, such cases are rare and we can fix these
-		 * at enqueue.
+		 * We pivot on our averages having decayed to zero for list
+		 * removal, so that the walk below only ever visits groups
+		 * that still carry load.  This generally implies that all our
+		 * children have also been removed (modulo rounding error or
+		 * bandwidth control); however, such cases are rare and we can
+		 * fix these at enqueue.
 		 *
 		 * TODO: fix up out-of-order children on enqueue.
 		 */
-		if (!se->avg.runnable_avg_sum && !cfs_rq->nr_running)
+		if (cfs_rq_is_decayed(cfs_rq, se))
 			list_del_leaf_cfs_rq(cfs_rq);
 	} else {
 		struct rq *rq = rq_of(cfs_rq);
@@ -5449,7 +5819,17 @@ static void update_blocked_averages(int cpu)
 	struct cfs_rq *cfs_rq;
 	unsigned long flags;
 
+	/*
+	 * The averages decay with a ~32ms half-life, walking the leaf list
+	 * more than once a tick (idle_balance() on a busy-idle cpu can call
+	 * us far more often than that) buys nothing.  Check this without
+	 * rq->lock; a racing walker at worst repeats an update.
+	 */
+	if (ACCESS_ONCE(rq->last_blocked_load_update) == jiffies)
+		return;
+
 	raw_spin_lock_irqsave(&rq->lock, flags);
+	rq->last_blocked_load_update = jiffies;
 	update_rq_clock(rq);
 	/*
 	 * Iterates the task_group tree in a bottom up fashion, see
@@ -7520,6 +7900,10 @@ void init_cfs_rq(struct cfs_rq *cfs_rq)
 	atomic64_set(&cfs_rq->decay_counter, 1);
 	atomic_long_set(&cfs_rq->removed_load, 0);
 #endif
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	INIT_LIST_HEAD(&cfs_rq->resv_list);
+	INIT_LIST_HEAD(&cfs_rq->resv_node);
+#endif
 }
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
@@ -7606,6 +7990,8 @@ int alloc_fair_sched_group(struct task_group *tg, struct task_group *parent)
 		goto err;
 
 	tg->shares = NICE_0_LOAD;
+	/* same default period as CFS bandwidth control */
+	tg->dl_period = 100 * NSEC_PER_MSEC;
 
 	init_cfs_bandwidth(tg_cfs_bandwidth(tg));
 
@@ -7719,6 +8105,34 @@ done:
 	mutex_unlock(&shares_mutex);
 	return 0;
 }
+
+/*
+ * Install an already admitted reservation; called with the reservation
+ * mutex held.  A zero @runtime removes it.
+ */
+void sched_group_set_dl_reservation(struct task_group *tg,
+				    u64 period, u64 runtime)
+{
+	unsigned long flags;
+	int i;
+
+	tg->dl_period = period;
+	tg->dl_runtime = runtime;
+
+	for_each_possible_cpu(i) {
+		struct rq *rq = cpu_rq(i);
+		struct sched_entity *se = tg->se[i];
+		struct cfs_rq *cfs_rq = tg->cfs_rq[i];
+
+		raw_spin_lock_irqsave(&rq->lock, flags);
+		/* start over with a full budget */
+		cfs_rq->resv_period_end = 0;
+		list_del_resv_entity(se);
+		if (se->on_rq)
+			list_add_resv_entity(cfs_rq_of(se), se);
+		raw_spin_unlock_irqrestore(&rq->lock, flags);
+	}
+}
 #else /* CONFIG_FAIR_GROUP_SCHED */
 
 void free_fair_sched_group(struct task_group *tg) { }
@@ -56,6 +56,20 @@ SCHED_FEAT(NONTASK_CAPACITY, true)
  */
 SCHED_FEAT(TTWU_QUEUE, true)
 
+/*
+ * Also queue wakeups for cpus sharing our cache while they are idle and
+ * polling: no IPI is needed and the idle cpu activates the task itself.
+ */
+SCHED_FEAT(TTWU_QUEUE_IDLE, true)
+
+/*
+ * When doing wakeups, attempt to limit superfluous scans of the LLC domain.
+ * SIS_AVG_CPU skips the scan when the average idle time is below the
+ * average scan cost, SIS_PROP bounds the scan depth by their ratio.
+ */
+SCHED_FEAT(SIS_AVG_CPU, false)
+SCHED_FEAT(SIS_PROP, true)
+
 SCHED_FEAT(FORCE_SD_OVERLAP, false)
 SCHED_FEAT(RT_RUNTIME_SHARE, true)
 SCHED_FEAT(LB_MIN, false)
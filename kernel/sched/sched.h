@@ -208,6 +208,10 @@ struct task_group {
 	struct cfs_rq **cfs_rq;
 	unsigned long shares;
 
+	/* guaranteed runtime per period on each cpu, see cpu.dl_runtime_us */
+	u64 dl_runtime;
+	u64 dl_period;
+
 #ifdef	CONFIG_SMP
 	atomic_long_t load_avg;
 	atomic_t runnable_avg;
@@ -232,6 +236,11 @@ struct task_group {
 	struct autogroup *autogroup;
 #endif
 
+#ifdef CONFIG_SCHED_SMT
+	/* non-zero when cpu.core_tag is set */
+	unsigned long core_cookie;
+#endif
+
 	struct cfs_bandwidth cfs_bandwidth;
 };
 
@@ -297,6 +306,8 @@ extern void sched_move_task(struct task_struct *tsk);
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
 extern int sched_group_set_shares(struct task_group *tg, unsigned long shares);
+extern void sched_group_set_dl_reservation(struct task_group *tg,
+					   u64 period, u64 runtime);
 #endif
 
 #else /* CONFIG_CGROUP_SCHED */
@@ -373,6 +384,17 @@ struct cfs_rq {
 	struct list_head leaf_cfs_rq_list;
 	struct task_group *tg;	/* group that "owns" this runqueue */
 
+	/*
+	 * Group entities queued on this cfs_rq whose group has a runtime
+	 * reservation are also kept on resv_list (linked through their
+	 * my_q->resv_node), so that pick_next_entity() can serve them ahead
+	 * of their peers while they have reserved runtime left.
+	 */
+	struct list_head resv_list;
+	struct list_head resv_node;
+	s64 resv_runtime;
+	u64 resv_period_end;
+
 #ifdef CONFIG_CFS_BANDWIDTH
 	int runtime_enabled;
 	u64 runtime_expires;
@@ -524,9 +546,6 @@ struct rq {
 #ifdef CONFIG_NO_HZ_COMMON
 	u64 nohz_stamp;
 	unsigned long nohz_flags;
-#endif
-#ifdef CONFIG_NO_HZ_FULL
-	unsigned long last_sched_tick;
 #endif
 	int skip_clock_update;
 
@@ -542,6 +561,8 @@ struct rq {
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	/* list of leaf cfs_rq on this cpu: */
 	struct list_head leaf_cfs_rq_list;
+	/* jiffies of the last update_blocked_averages() walk */
+	unsigned long last_blocked_load_update;
 
 	struct sched_avg avg;
 #endif /* CONFIG_FAIR_GROUP_SCHED */
@@ -590,6 +611,11 @@ struct rq {
 	u64 max_idle_balance_cost;
 #endif
 
+#ifdef CONFIG_SCHED_SMT
+	/* core_cookie of rq->curr, see task_core_cookie() */
+	unsigned long core_cookie;
+#endif
+
 #ifdef CONFIG_IRQ_TIME_ACCOUNTING
 	u64 prev_irq_time;
 #endif
@@ -846,6 +872,35 @@ static inline struct task_group *task_group(struct task_struct *p)
 
 #endif /* CONFIG_CGROUP_SCHED */
 
+#ifdef CONFIG_SCHED_SMT
+/* Enabled while any task group has cpu.core_tag set. */
+extern struct static_key sched_core_tagged;
+
+/*
+ * Tasks in a group with cpu.core_tag set share that group's cookie, all
+ * others have cookie 0.  Wakeup placement avoids running tasks with
+ * different cookies on the SMT siblings of one core.
+ */
+static inline unsigned long task_core_cookie(struct task_struct *p)
+{
+#ifdef CONFIG_CGROUP_SCHED
+	return task_group(p)->core_cookie;
+#else
+	return 0;
+#endif
+}
+
+static inline void sched_core_update(struct rq *rq, struct task_struct *next)
+{
+	if (static_key_false(&sched_core_tagged))
+		rq->core_cookie = task_core_cookie(next);
+}
+#else
+static inline void sched_core_update(struct rq *rq, struct task_struct *next)
+{
+}
+#endif /* CONFIG_SCHED_SMT */
+
 static inline void __set_task_cpu(struct task_struct *p, unsigned int cpu)
 {
 	set_task_rq(p, cpu);
@@ -1187,6 +1242,24 @@ static inline void idle_exit_fair(struct rq *rq) { }
 
 #endif
 
+#ifdef CONFIG_SCHED_SMT
+
+extern struct static_key sched_smt_present;
+
+extern void __update_idle_core(struct rq *rq);
+
+static inline void update_idle_core(struct rq *rq)
+{
+	if (static_key_false(&sched_smt_present))
+		__update_idle_core(rq);
+}
+
+#else
+
+static inline void update_idle_core(struct rq *rq) { }
+
+#endif
+
 extern void sysrq_sched_debug_show(void);
 extern void sched_init_granularity(void);
 extern void update_max_interval(void);
@@ -1234,13 +1307,6 @@ static inline void sub_nr_running(struct rq *rq, unsigned count)
 	rq->nr_running -= count;
 }
 
-static inline void rq_last_tick_reset(struct rq *rq)
-{
-#ifdef CONFIG_NO_HZ_FULL
-	rq->last_sched_tick = jiffies;
-#endif
-}
-
 extern void update_rq_clock(struct rq *rq);
 
 extern void activate_task(struct rq *rq, struct task_struct *p, int flags);
@@ -144,6 +144,7 @@ cond_syscall(compat_sys_ipc);
 cond_syscall(compat_sys_sysctl);
 cond_syscall(sys_flock);
 cond_syscall(sys_io_setup);
+cond_syscall(sys_io_setup_sq);
 cond_syscall(sys_io_destroy);
 cond_syscall(sys_io_submit);
 cond_syscall(sys_io_cancel);
@@ -213,3 +214,9 @@ cond_syscall(compat_sys_open_by_handle_at);
 
 /* compare kernel pointers */
 cond_syscall(sys_kcmp);
+
+/* access BPF maps */
+cond_syscall(sys_bpf);
+
+/* userspace page fault handling */
+cond_syscall(sys_userfaultfd);
@@ -0,0 +1,181 @@
+/*
+ * BPF programs attached to trace events
+ *
+ * A program attached to a kprobe or tracepoint event runs every time the
+ * event fires, on both the ftrace and the perf path, before the record is
+ * committed.  Its context (R1) is the raw event record, laid out as
+ * described by the event's "format" file.  It returns 0 to drop the
+ * record and non-zero to keep it, so a program that only updates maps
+ * (counts, histograms, latency buckets) and returns 0 lets the event be
+ * aggregated in kernel without anything reaching the trace buffers.
+ *
+ * Programs are internal BPF built in the kernel; there is no verifier,
+ * so they are trusted like the code that builds them.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/kprobes.h>
+#include <linux/bpf.h>
+#include <linux/filter.h>
+#include <linux/uaccess.h>
+#include <linux/ftrace_event.h>
+
+static DEFINE_MUTEX(bpf_event_mutex);
+
+/* Nesting level of programs on this cpu, see trace_call_bpf() */
+static DEFINE_PER_CPU(int, bpf_prog_active);
+
+/**
+ * trace_call_bpf - run the BPF program attached to a trace event
+ * @call:	the event that fired
+ * @rec:	the event record, passed to the program in R1
+ *
+ * Returns the program's return value, 0 meaning the record is to be
+ * dropped.  A program is never run from within another program on the
+ * same cpu: an event firing in a map helper, or in an interrupt that hit
+ * a program, is passed through untouched rather than risk a deadlock on
+ * a map lock.
+ */
+unsigned int trace_call_bpf(struct ftrace_event_call *call, void *rec)
+{
+	struct sk_filter *prog;
+	unsigned int ret = 1;
+
+	preempt_disable();
+
+	if (unlikely(__this_cpu_inc_return(bpf_prog_active) != 1))
+		goto out;
+
+	rcu_read_lock();
+	prog = rcu_dereference(call->prog);
+	if (prog)
+		ret = SK_RUN_FILTER(prog, rec);
+	rcu_read_unlock();
+
+ out:
+	__this_cpu_dec(bpf_prog_active);
+	preempt_enable();
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(trace_call_bpf);
+NOKPROBE_SYMBOL(trace_call_bpf);
+
+/**
+ * trace_event_attach_bpf - attach a BPF program to a trace event
+ * @call:	kprobe or tracepoint event
+ * @prog:	program from trace_bpf_prog_alloc()
+ *
+ * The program runs whenever the event is enabled for ftrace or perf.
+ * The caller keeps ownership of @prog and of the maps it uses, and must
+ * detach it before freeing either.  Only one program can be attached to
+ * an event at a time.
+ */
+int trace_event_attach_bpf(struct ftrace_event_call *call,
+			   struct sk_filter *prog)
+{
+	int ret = 0;
+
+	mutex_lock(&bpf_event_mutex);
+	if (rcu_dereference_protected(call->prog,
+				      lockdep_is_held(&bpf_event_mutex)))
+		ret = -EEXIST;
+	else
+		rcu_assign_pointer(call->prog, prog);
+	mutex_unlock(&bpf_event_mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(trace_event_attach_bpf);
+
+/**
+ * trace_event_detach_bpf - detach the BPF program of a trace event
+ * @call:	event to detach from
+ *
+ * Returns the program that was attached, or NULL.  When this returns,
+ * the program is no longer running on any cpu and can be freed.
+ */
+struct sk_filter *trace_event_detach_bpf(struct ftrace_event_call *call)
+{
+	struct sk_filter *prog;
+
+	mutex_lock(&bpf_event_mutex);
+	prog = rcu_dereference_protected(call->prog,
+					 lockdep_is_held(&bpf_event_mutex));
+	RCU_INIT_POINTER(call->prog, NULL);
+	mutex_unlock(&bpf_event_mutex);
+
+	if (prog)
+		synchronize_rcu();
+
+	return prog;
+}
+EXPORT_SYMBOL_GPL(trace_event_detach_bpf);
+
+/**
+ * trace_bpf_prog_alloc - build a program for trace_event_attach_bpf()
+ * @insns:	internal BPF instructions
+ * @len:	number of instructions
+ *
+ * The program is JITed when the internal BPF JIT is available.
+ */
+struct sk_filter *trace_bpf_prog_alloc(const struct sock_filter_int *insns,
+				       unsigned int len)
+{
+	struct sk_filter *prog;
+
+	if (!len || len > BPF_MAXINSNS)
+		return ERR_PTR(-EINVAL);
+
+	prog = kzalloc(sk_filter_size(len), GFP_KERNEL);
+	if (!prog)
+		return ERR_PTR(-ENOMEM);
+
+	prog->len = len;
+	memcpy(prog->insnsi, insns, len * sizeof(struct sock_filter_int));
+	sk_filter_select_runtime(prog);
+
+	return prog;
+}
+EXPORT_SYMBOL_GPL(trace_bpf_prog_alloc);
+
+void trace_bpf_prog_free(struct sk_filter *prog)
+{
+	sk_filter_free(prog);
+}
+EXPORT_SYMBOL_GPL(trace_bpf_prog_free);
+
+/*
+ * BPF_CALL helpers for trace programs.  Event records hold pointers
+ * (kprobe arguments, task and skb addresses in tracepoints) that the
+ * program may want to follow, which is only safe through
+ * bpf_probe_read().
+ */
+
+/* R1: destination, R2: size, R3: unsafe kernel address */
+u64 bpf_probe_read(u64 r1, u64 r2, u64 r3, u64 r4, u64 r5)
+{
+	void *dst = (void *) (unsigned long) r1;
+	int size = (int) r2;
+	void *unsafe_ptr = (void *) (unsigned long) r3;
+
+	return probe_kernel_read(dst, unsafe_ptr, size);
+}
+EXPORT_SYMBOL_GPL(bpf_probe_read);
+
+/*
+ * Timestamps for latency measurements between two events.  This is the
+ * perf clock: safe from NMI context, and close enough across cpus to
+ * measure e.g. wakeup latency.
+ */
+u64 bpf_ktime_get_ns(u64 r1, u64 r2, u64 r3, u64 r4, u64 r5)
+{
+	return local_clock();
+}
+EXPORT_SYMBOL_GPL(bpf_ktime_get_ns);
@@ -7,6 +7,7 @@
 #include <linux/ring_buffer.h>
 #include <linux/trace_clock.h>
 #include <linux/trace_seq.h>
+#include <linux/trace_mmap.h>
 #include <linux/spinlock.h>
 #include <linux/irq_work.h>
 #include <linux/debugfs.h>
@@ -357,6 +358,7 @@ struct buffer_page {
 	local_t		 entries;	/* entries on this page */
 	unsigned long	 real_end;	/* real end of data */
 	struct buffer_data_page *page;	/* Actual data page */
+	unsigned	 id;		/* sub-buffer id in a mapping */
 };
 
 /*
@@ -489,6 +491,12 @@ struct ring_buffer_per_cpu {
 	struct completion		update_done;
 
 	struct rb_irq_work		irq_work;
+
+	/* user space mappings, see ring_buffer_map() */
+	int				mapped;
+	unsigned int			mapped_commit;
+	struct trace_buffer_meta	*meta_page;
+	unsigned long			*subbuf_ids;
 };
 
 struct ring_buffer {
@@ -1653,6 +1661,15 @@ int ring_buffer_resize(struct ring_buffer *buffer, unsigned long size,
 	/* prevent another thread from changing buffer sizes */
 	mutex_lock(&buffer->mutex);
 
+	/* The pages of a mapped buffer must stay where they are */
+	for_each_buffer_cpu(buffer, cpu) {
+		if ((cpu_id == RING_BUFFER_ALL_CPUS || cpu == cpu_id) &&
+		    buffer->buffers[cpu]->mapped) {
+			mutex_unlock(&buffer->mutex);
+			return -EBUSY;
+		}
+	}
+
 	if (cpu_id == RING_BUFFER_ALL_CPUS) {
 		/* calculate the pages to update */
 		for_each_buffer_cpu(buffer, cpu) {
@@ -4158,6 +4175,9 @@ rb_reset_cpu(struct ring_buffer_per_cpu *cpu_buffer)
 	cpu_buffer->lost_events = 0;
 	cpu_buffer->last_overrun = 0;
 
+	/* whatever a mapped reader was handed out is gone */
+	cpu_buffer->mapped_commit = 0;
+
 	rb_head_page_activate(cpu_buffer);
 }
 
@@ -4304,6 +4324,10 @@ int ring_buffer_swap_cpu(struct ring_buffer *buffer_a,
 	if (cpu_buffer_a->nr_pages != cpu_buffer_b->nr_pages)
 		goto out;
 
+	ret = -EBUSY;
+	if (cpu_buffer_a->mapped || cpu_buffer_b->mapped)
+		goto out;
+
 	ret = -EAGAIN;
 
 	if (ring_buffer_flags != RB_BUFFERS_ON)
@@ -4431,6 +4455,7 @@ EXPORT_SYMBOL_GPL(ring_buffer_free_read_page);
  *
  * Returns:
  *  >=0 if data has been transferred, returns the offset of consumed data.
+ *  -EBUSY if the buffer is memory mapped, see ring_buffer_map().
  *  <0 if no data has been transferred.
  */
 int ring_buffer_read_page(struct ring_buffer *buffer,
@@ -4468,6 +4493,12 @@ int ring_buffer_read_page(struct ring_buffer *buffer,
 
 	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
 
+	/* Swapping pages out would pull them from under the mapping */
+	if (cpu_buffer->mapped) {
+		ret = -EBUSY;
+		goto out_unlock;
+	}
+
 	reader = rb_get_reader_page(cpu_buffer);
 	if (!reader)
 		goto out_unlock;
@@ -4597,6 +4628,264 @@ int ring_buffer_read_page(struct ring_buffer *buffer,
 }
 EXPORT_SYMBOL_GPL(ring_buffer_read_page);
 
+/*
+ * Memory mapped readers.
+ *
+ * A per cpu buffer can be mapped read-only in user space: a meta page
+ * followed by every data page of the buffer, the reader page included.
+ * While the buffer is mapped the set of data pages is fixed (no resize,
+ * no snapshot swap, no ring_buffer_read_page() swap), so user space reads
+ * events in place, and only asks the kernel to move the reader page
+ * along with ring_buffer_map_get_reader().  No data is copied.
+ */
+
+static void rb_update_meta_page(struct ring_buffer_per_cpu *cpu_buffer)
+{
+	struct trace_buffer_meta *meta = cpu_buffer->meta_page;
+
+	meta->reader.id = cpu_buffer->reader_page->id;
+	meta->reader.read = cpu_buffer->reader_page->read;
+	meta->reader.commit = cpu_buffer->mapped_commit;
+
+	meta->entries = local_read(&cpu_buffer->entries);
+	meta->overrun = local_read(&cpu_buffer->overrun);
+	meta->read = cpu_buffer->read;
+}
+
+static void rb_setup_ids(struct ring_buffer_per_cpu *cpu_buffer,
+			 unsigned long *subbuf_ids)
+{
+	struct buffer_page *first, *bpage;
+	unsigned id = 0;
+
+	bpage = cpu_buffer->reader_page;
+	bpage->id = id;
+	subbuf_ids[id++] = (unsigned long)bpage->page;
+
+	first = bpage = rb_set_head_page(cpu_buffer);
+	do {
+		bpage->id = id;
+		subbuf_ids[id++] = (unsigned long)bpage->page;
+		rb_inc_page(cpu_buffer, &bpage);
+	} while (bpage != first);
+
+	WARN_ON(id != cpu_buffer->nr_pages + 1);
+}
+
+/**
+ * ring_buffer_map - prepare a cpu buffer to be memory mapped
+ * @buffer: the buffer
+ * @cpu: the cpu buffer to map
+ *
+ * Mappings are counted, each ring_buffer_map() needs a matching
+ * ring_buffer_unmap().  Returns 0 on success.
+ */
+int ring_buffer_map(struct ring_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct trace_buffer_meta *meta;
+	unsigned long *subbuf_ids;
+	unsigned long flags;
+	int ret = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&buffer->mutex);
+
+	if (cpu_buffer->mapped) {
+		raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+		cpu_buffer->mapped++;
+		raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+		goto out;
+	}
+
+	subbuf_ids = kcalloc(cpu_buffer->nr_pages + 1, sizeof(*subbuf_ids),
+			     GFP_KERNEL);
+	if (!subbuf_ids) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	meta = (void *)get_zeroed_page(GFP_KERNEL);
+	if (!meta) {
+		kfree(subbuf_ids);
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	meta->meta_page_size = PAGE_SIZE;
+	meta->meta_struct_len = sizeof(*meta);
+	meta->subbuf_size = PAGE_SIZE;
+	meta->nr_subbufs = cpu_buffer->nr_pages + 1;
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	rb_setup_ids(cpu_buffer, subbuf_ids);
+	cpu_buffer->subbuf_ids = subbuf_ids;
+	cpu_buffer->meta_page = meta;
+	/* nothing handed out yet */
+	cpu_buffer->mapped_commit = cpu_buffer->reader_page->read;
+	rb_update_meta_page(cpu_buffer);
+	cpu_buffer->mapped = 1;
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+ out:
+	mutex_unlock(&buffer->mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map);
+
+/**
+ * ring_buffer_unmap - drop a mapping taken by ring_buffer_map()
+ * @buffer: the buffer
+ * @cpu: the mapped cpu buffer
+ */
+void ring_buffer_unmap(struct ring_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer = buffer->buffers[cpu];
+	struct trace_buffer_meta *meta = NULL;
+	unsigned long *subbuf_ids = NULL;
+	unsigned long flags;
+
+	mutex_lock(&buffer->mutex);
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	if (!WARN_ON(!cpu_buffer->mapped) && !--cpu_buffer->mapped) {
+		meta = cpu_buffer->meta_page;
+		subbuf_ids = cpu_buffer->subbuf_ids;
+		cpu_buffer->meta_page = NULL;
+		cpu_buffer->subbuf_ids = NULL;
+	}
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	mutex_unlock(&buffer->mutex);
+
+	if (meta)
+		free_page((unsigned long)meta);
+	kfree(subbuf_ids);
+}
+EXPORT_SYMBOL_GPL(ring_buffer_unmap);
+
+/**
+ * ring_buffer_map_page - page at a given offset of a mapping
+ * @buffer: the buffer
+ * @cpu: the mapped cpu buffer
+ * @pgoff: page offset in the mapping, 0 being the meta page
+ *
+ * Returns NULL if @pgoff is beyond the end of the mapping.
+ */
+struct page *ring_buffer_map_page(struct ring_buffer *buffer, int cpu,
+				  unsigned long pgoff)
+{
+	struct ring_buffer_per_cpu *cpu_buffer = buffer->buffers[cpu];
+
+	if (WARN_ON(!cpu_buffer->mapped))
+		return NULL;
+
+	if (!pgoff)
+		return virt_to_page(cpu_buffer->meta_page);
+
+	if (pgoff > cpu_buffer->nr_pages + 1)
+		return NULL;
+
+	return virt_to_page((void *)cpu_buffer->subbuf_ids[pgoff - 1]);
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map_page);
+
+/*
+ * Consume the reader page up to @end, a commit index handed out earlier.
+ * A fully written page is accounted in one go; otherwise walk the event
+ * headers, which are already in cache for user space to have read them.
+ */
+static void rb_consume_mapped(struct ring_buffer_per_cpu *cpu_buffer,
+			      unsigned end)
+{
+	struct buffer_page *reader = cpu_buffer->reader_page;
+	struct ring_buffer_event *event;
+
+	if (!reader->read && end == rb_page_size(reader) &&
+	    reader != cpu_buffer->commit_page) {
+		cpu_buffer->read += rb_page_entries(reader);
+		cpu_buffer->read_bytes += BUF_PAGE_SIZE;
+		reader->read = end;
+		return;
+	}
+
+	while (reader->read < end) {
+		event = rb_reader_event(cpu_buffer);
+		if (event->type_len <= RINGBUF_TYPE_DATA_TYPE_LEN_MAX)
+			cpu_buffer->read++;
+		rb_update_read_stamp(cpu_buffer, event);
+		reader->read += rb_event_length(event);
+	}
+}
+
+/**
+ * ring_buffer_map_get_reader - hand the next data to a mapped reader
+ * @buffer: the buffer
+ * @cpu: the mapped cpu buffer
+ *
+ * Consumes the data handed out by the previous call, swaps in a new
+ * reader page if that one is done, and publishes in the meta page where
+ * the next unread data is.
+ *
+ * Returns 0 if there is data to read, -EAGAIN if the buffer is empty,
+ * -ENODEV if the buffer is not mapped.
+ */
+int ring_buffer_map_get_reader(struct ring_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct trace_buffer_meta *meta;
+	struct buffer_page *reader;
+	unsigned long flags;
+	int ret = -EAGAIN;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+
+	/* not mapped, or unmapped from under the caller */
+	if (!cpu_buffer->mapped) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	meta = cpu_buffer->meta_page;
+
+	/*
+	 * A trace_pipe reader may have moved the reader page meanwhile,
+	 * in which case what we handed out is gone already.
+	 */
+	if (cpu_buffer->reader_page->id == meta->reader.id &&
+	    cpu_buffer->reader_page->read < cpu_buffer->mapped_commit)
+		rb_consume_mapped(cpu_buffer, cpu_buffer->mapped_commit);
+
+	reader = rb_get_reader_page(cpu_buffer);
+	if (reader) {
+		cpu_buffer->mapped_commit = rb_page_commit(reader);
+		meta->reader.lost_events = cpu_buffer->lost_events;
+		cpu_buffer->lost_events = 0;
+		ret = 0;
+	} else {
+		cpu_buffer->mapped_commit = cpu_buffer->reader_page->read;
+		meta->reader.lost_events = 0;
+	}
+
+	rb_update_meta_page(cpu_buffer);
+
+ out:
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map_get_reader);
+
 #ifdef CONFIG_HOTPLUG_CPU
 static int rb_cpu_notify(struct notifier_block *self,
 			 unsigned long action, void *hcpu)
@@ -39,6 +39,7 @@
 #include <linux/nmi.h>
 #include <linux/fs.h>
 #include <linux/sched/rt.h>
+#include <linux/trace_mmap.h>
 
 #include "trace.h"
 #include "trace_output.h"
@@ -257,6 +258,11 @@ int filter_check_discard(struct ftrace_event_file *file, void *rec,
 		return 1;
 	}
 
+	if (!trace_event_call_bpf(file->event_call, rec)) {
+		ring_buffer_discard_commit(buffer, event);
+		return 1;
+	}
+
 	return 0;
 }
 EXPORT_SYMBOL_GPL(filter_check_discard);
@@ -5296,12 +5302,18 @@ tracing_buffers_poll(struct file *filp, poll_table *poll_table)
 	return trace_poll(iter, filp, poll_table);
 }
 
+/*
+ * Reads return as many pages as fit in @count, so that a reader draining
+ * a busy buffer does not pay a system call per page.  Only the first
+ * page is waited for.
+ */
 static ssize_t
 tracing_buffers_read(struct file *filp, char __user *ubuf,
 		     size_t count, loff_t *ppos)
 {
 	struct ftrace_buffer_info *info = filp->private_data;
 	struct trace_iterator *iter = &info->iter;
+	ssize_t copied = 0;
 	ssize_t ret;
 	ssize_t size;
 
@@ -5324,56 +5336,71 @@ tracing_buffers_read(struct file *filp, char __user *ubuf,
 	if (!info->spare)
 		goto out_unlock;
 
-	/* Do we have previous read data to read? */
-	if (info->read < PAGE_SIZE)
-		goto read;
+	while (copied < count) {
+		/* Do we have previous read data to read? */
+		if (info->read < PAGE_SIZE)
+			goto read;
 
  again:
-	trace_access_lock(iter->cpu_file);
-	ret = ring_buffer_read_page(iter->trace_buffer->buffer,
-				    &info->spare,
-				    count,
-				    iter->cpu_file, 0);
-	trace_access_unlock(iter->cpu_file);
+		trace_access_lock(iter->cpu_file);
+		ret = ring_buffer_read_page(iter->trace_buffer->buffer,
+					    &info->spare,
+					    count - copied,
+					    iter->cpu_file, 0);
+		trace_access_unlock(iter->cpu_file);
+
+		if (ret == -EBUSY) {
+			size = copied ? copied : -EBUSY;
+			goto out_unlock;
+		}
 
-	if (ret < 0) {
-		if (trace_empty(iter)) {
-			if ((filp->f_flags & O_NONBLOCK)) {
-				size = -EAGAIN;
-				goto out_unlock;
-			}
-			mutex_unlock(&trace_types_lock);
-			ret = wait_on_pipe(iter);
-			mutex_lock(&trace_types_lock);
-			if (ret) {
-				size = ret;
-				goto out_unlock;
-			}
-			if (signal_pending(current)) {
-				size = -EINTR;
-				goto out_unlock;
+		if (ret < 0) {
+			if (copied)
+				break;
+			if (trace_empty(iter)) {
+				if ((filp->f_flags & O_NONBLOCK)) {
+					size = -EAGAIN;
+					goto out_unlock;
+				}
+				mutex_unlock(&trace_types_lock);
+				ret = wait_on_pipe(iter);
+				mutex_lock(&trace_types_lock);
+				if (ret) {
+					size = ret;
+					goto out_unlock;
+				}
+				if (signal_pending(current)) {
+					size = -EINTR;
+					goto out_unlock;
+				}
+				goto again;
 			}
-			goto again;
+			break;
 		}
-		size = 0;
-		goto out_unlock;
-	}
 
-	info->read = 0;
+		info->read = 0;
  read:
-	size = PAGE_SIZE - info->read;
-	if (size > count)
-		size = count;
+		size = PAGE_SIZE - info->read;
+		if (size > count - copied)
+			size = count - copied;
+
+		ret = copy_to_user(ubuf + copied, info->spare + info->read, size);
+		if (ret == size) {
+			if (!copied)
+				copied = -EFAULT;
+			break;
+		}
+		size -= ret;
 
-	ret = copy_to_user(ubuf, info->spare + info->read, size);
-	if (ret == size) {
-		size = -EFAULT;
-		goto out_unlock;
+		*ppos += size;
+		info->read += size;
+		copied += size;
+
+		if (ret)
+			break;
 	}
-	size -= ret;
 
-	*ppos += size;
-	info->read += size;
+	size = copied;
 
  out_unlock:
 	mutex_unlock(&trace_types_lock);
@@ -5470,7 +5497,7 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 		.spd_release	= buffer_spd_release,
 	};
 	struct buffer_ref *ref;
-	int entries, size, i;
+	int entries, size, i, r = 0;
 	ssize_t ret;
 
 	mutex_lock(&trace_types_lock);
@@ -5506,7 +5533,6 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 
 	for (i = 0; i < spd.nr_pages_max && len && entries; i++, len -= PAGE_SIZE) {
 		struct page *page;
-		int r;
 
 		ref = kzalloc(sizeof(*ref), GFP_KERNEL);
 		if (!ref)
@@ -5553,6 +5579,10 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 
 	/* did we read anything? */
 	if (!spd.nr_pages) {
+		if (r == -EBUSY) {
+			ret = r;
+			goto out;
+		}
 		if ((file->f_flags & O_NONBLOCK) || (flags & SPLICE_F_NONBLOCK)) {
 			ret = -EAGAIN;
 			goto out;
@@ -5577,12 +5607,112 @@ out:
 	return ret;
 }
 
+/*
+ * trace_pipe_raw can be mapped, see include/uapi/linux/trace_mmap.h.
+ * Each vma holds a reference on the mapping of the cpu buffer.
+ */
+static void tracing_buffers_mmap_open(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+	struct trace_iterator *iter = &info->iter;
+
+	WARN_ON(ring_buffer_map(iter->trace_buffer->buffer, iter->cpu_file));
+}
+
+static void tracing_buffers_mmap_close(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+	struct trace_iterator *iter = &info->iter;
+
+	ring_buffer_unmap(iter->trace_buffer->buffer, iter->cpu_file);
+}
+
+static const struct vm_operations_struct tracing_buffers_vmops = {
+	.open		= tracing_buffers_mmap_open,
+	.close		= tracing_buffers_mmap_close,
+};
+
+static int tracing_buffers_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = filp->private_data;
+	struct trace_iterator *iter = &info->iter;
+	struct ring_buffer *buffer = iter->trace_buffer->buffer;
+	unsigned long i;
+	int ret;
+
+	if (iter->cpu_file == RING_BUFFER_ALL_CPUS || vma->vm_pgoff)
+		return -EINVAL;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	ret = ring_buffer_map(buffer, iter->cpu_file);
+	if (ret)
+		return ret;
+
+	vma->vm_flags |= VM_DONTCOPY | VM_DONTEXPAND | VM_DONTDUMP;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	for (i = 0; i < vma_pages(vma); i++) {
+		struct page *page;
+
+		page = ring_buffer_map_page(buffer, iter->cpu_file, i);
+		if (!page) {
+			ret = -EINVAL;
+			break;
+		}
+
+		ret = vm_insert_page(vma, vma->vm_start + i * PAGE_SIZE, page);
+		if (ret)
+			break;
+	}
+
+	if (ret) {
+		ring_buffer_unmap(buffer, iter->cpu_file);
+		return ret;
+	}
+
+	vma->vm_ops = &tracing_buffers_vmops;
+
+	return 0;
+}
+
+static long tracing_buffers_ioctl(struct file *file, unsigned int cmd,
+				  unsigned long arg)
+{
+	struct ftrace_buffer_info *info = file->private_data;
+	struct trace_iterator *iter = &info->iter;
+	int ret;
+
+	if (cmd != TRACE_MMAP_IOCTL_GET_READER)
+		return -ENOTTY;
+
+	if (iter->cpu_file == RING_BUFFER_ALL_CPUS)
+		return -EINVAL;
+
+	for (;;) {
+		ret = ring_buffer_map_get_reader(iter->trace_buffer->buffer,
+						 iter->cpu_file);
+		if (ret != -EAGAIN || (file->f_flags & O_NONBLOCK))
+			return ret;
+
+		ret = wait_on_pipe(iter);
+		if (ret)
+			return ret;
+
+		if (signal_pending(current))
+			return -EINTR;
+	}
+}
+
 static const struct file_operations tracing_buffers_fops = {
 	.open		= tracing_buffers_open,
 	.read		= tracing_buffers_read,
 	.poll		= tracing_buffers_poll,
 	.release	= tracing_buffers_release,
 	.splice_read	= tracing_buffers_splice_read,
+	.mmap		= tracing_buffers_mmap,
+	.unlocked_ioctl	= tracing_buffers_ioctl,
 	.llseek		= no_llseek,
 };
 
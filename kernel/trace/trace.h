@@ -1120,7 +1120,10 @@ struct event_trigger_data {
  * @func: The trigger 'probe' function called when the triggering
  *	event occurs.  The data passed into this callback is the data
  *	that was supplied to the event_command @reg() function that
- *	registered the trigger (see struct event_command).
+ *	registered the trigger (see struct event_command).  @rec is
+ *	the trace record of the event, or NULL if the trigger is
+ *	invoked unconditionally or after the event was committed
+ *	(see @post_trigger and @needs_rec in struct event_command).
  *
  * @init: An optional initialization function called for the trigger
  *	when the trigger is registered (via the event_command reg()
@@ -1145,7 +1148,8 @@ struct event_trigger_data {
  *	(see trace_event_triggers.c).
  */
 struct event_trigger_ops {
-	void			(*func)(struct event_trigger_data *data);
+	void			(*func)(struct event_trigger_data *data,
+					void *rec);
 	int			(*init)(struct event_trigger_ops *ops,
 					struct event_trigger_data *data);
 	void			(*free)(struct event_trigger_ops *ops,
@@ -1169,8 +1173,8 @@ struct event_trigger_ops {
  * The data members in this structure provide per-event command data
  * for various event commands.
  *
- * All the data members below, except for @post_trigger, must be set
- * for each event command.
+ * All the data members below, except for @post_trigger and
+ * @needs_rec, must be set for each event command.
  *
  * @name: The unique name that identifies the event command.  This is
  *	the name used when setting triggers via trigger files.
@@ -1208,6 +1212,11 @@ struct event_trigger_ops {
  *	itself logs to the trace buffer, this flag should be set,
  *	otherwise it can be left unspecified.
  *
+ * @needs_rec: A flag that says whether or not the @func() probe of
+ *	this command reads the trace record of the event, as hist
+ *	triggers do.  Such a trigger is always invoked with the record,
+ *	the same way as a trigger with a filter.
+ *
  * All the methods below, except for @set_filter(), must be
  * implemented.
  *
@@ -1248,6 +1257,7 @@ struct event_command {
 	char			*name;
 	enum event_trigger_type	trigger_type;
 	bool			post_trigger;
+	bool			needs_rec;
 	int			(*func)(struct event_command *cmd_ops,
 					struct ftrace_event_file *file,
 					char *glob, char *cmd, char *params);
@@ -1267,6 +1277,25 @@ struct event_command {
 
 extern int trace_event_enable_disable(struct ftrace_event_file *file,
 				      int enable, int soft_disable);
+
+extern void trigger_data_free(struct event_trigger_data *data);
+extern int register_trigger(char *glob, struct event_trigger_ops *ops,
+			    struct event_trigger_data *data,
+			    struct ftrace_event_file *file);
+extern void unregister_trigger(char *glob, struct event_trigger_ops *ops,
+			       struct event_trigger_data *test,
+			       struct ftrace_event_file *file);
+extern int set_trigger_filter(char *filter_str,
+			      struct event_trigger_data *trigger_data,
+			      struct ftrace_event_file *file);
+extern int register_event_command(struct event_command *cmd);
+
+#ifdef CONFIG_HIST_TRIGGERS
+extern int register_trigger_hist_cmd(void);
+extern const struct file_operations event_hist_fops;
+#else
+static inline int register_trigger_hist_cmd(void) { return 0; }
+#endif
 extern int tracing_alloc_snapshot(void);
 
 extern const char *__start___trace_bprintk_fmt[];
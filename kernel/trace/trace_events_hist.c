@@ -0,0 +1,744 @@
+/*
+ * trace_events_hist - trace event hist triggers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * A hist trigger aggregates the events it is attached to into a table
+ * keyed by one or more event fields (or the kernel stack), keeping a
+ * hitcount and the sums of any number of value fields per key:
+ *
+ *   echo 'hist:keys=call_site:vals=bytes_req' > events/kmem/kmalloc/trigger
+ *   cat events/kmem/kmalloc/hist
+ *
+ * Key modifiers: .log2 (power of two buckets), .hex, .sym (kernel
+ * address), .execname (pid shown with its comm).  "stacktrace" as a key
+ * is the kernel stack at the event.  "size=" sets the number of keys
+ * kept, "sort=key" sorts the output by key rather than by hitcount.
+ */
+
+#include <linux/module.h>
+#include <linux/kallsyms.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/stacktrace.h>
+#include <linux/jhash.h>
+#include <linux/sort.h>
+
+#include "trace.h"
+
+#define HIST_KEYS_MAX		3
+#define HIST_VALS_MAX		4
+#define HIST_KEY_STRING_MAX	32
+#define HIST_STACKTRACE_DEPTH	16
+#define HIST_STACKTRACE_SKIP	5
+
+#define HIST_BITS_DEFAULT	11
+#define HIST_BITS_MIN		7
+#define HIST_BITS_MAX		17
+
+enum hist_field_flags {
+	HIST_FIELD_LOG2		= 1 << 0,
+	HIST_FIELD_HEX		= 1 << 1,
+	HIST_FIELD_SYM		= 1 << 2,
+	HIST_FIELD_EXECNAME	= 1 << 3,
+	HIST_FIELD_STRING	= 1 << 4,
+	HIST_FIELD_STACKTRACE	= 1 << 5,
+};
+
+struct hist_field {
+	struct ftrace_event_field	*field;	/* NULL for stacktrace */
+	unsigned long			flags;
+	unsigned int			offset;	/* in the key */
+	unsigned int			size;	/* in the key */
+};
+
+/*
+ * An element of the table.  An inserter claims a free element with
+ * @claimed, fills in the key, and publishes it by setting @hash, which
+ * is never 0 for a used element.  Nothing ever waits on another
+ * inserter, so events can be aggregated from any context, NMI
+ * included; two cpus racing to insert the same key may create two
+ * elements for it, which are merged when the table is read.
+ */
+struct hist_elt {
+	atomic_t	claimed;
+	u32		hash;
+	atomic64_t	hitcount;
+	atomic64_t	sums[HIST_VALS_MAX];
+	u64		key[0];
+};
+
+struct hist_trigger_data {
+	struct hist_field	keys[HIST_KEYS_MAX];
+	unsigned int		n_keys;
+	struct hist_field	vals[HIST_VALS_MAX];
+	unsigned int		n_vals;
+	unsigned int		key_size;
+	unsigned int		elt_size;
+	unsigned int		map_bits;
+	unsigned int		max_elts;	/* keys kept */
+	unsigned int		nr_slots;	/* twice max_elts */
+	atomic_t		nr_elts;
+	atomic64_t		drops;
+	bool			sort_by_key;
+	void			*elts;
+};
+
+static inline struct hist_elt *
+hist_elt(struct hist_trigger_data *hd, unsigned int idx)
+{
+	return hd->elts + idx * hd->elt_size;
+}
+
+static u64 hist_field_value(struct ftrace_event_field *field, void *rec)
+{
+	void *addr = rec + field->offset;
+
+	switch (field->size) {
+	case 1:
+		return field->is_signed ? (u64)*(s8 *)addr : *(u8 *)addr;
+	case 2:
+		return field->is_signed ? (u64)*(s16 *)addr : *(u16 *)addr;
+	case 4:
+		return field->is_signed ? (u64)*(s32 *)addr : *(u32 *)addr;
+	default:
+		return *(u64 *)addr;
+	}
+}
+
+static void hist_string_key(struct ftrace_event_field *field, void *rec,
+			    char *key)
+{
+	char *str = rec + field->offset;
+	int len = field->size;
+
+	if (field->filter_type == FILTER_DYN_STRING) {
+		u32 loc = *(u32 *)str;
+
+		str = rec + (loc & 0xffff);
+		len = loc >> 16;
+	}
+
+	memcpy(key, str, min(len, HIST_KEY_STRING_MAX - 1));
+}
+
+static void hist_build_key(struct hist_trigger_data *hd, void *rec, void *key)
+{
+	struct hist_field *hf;
+	unsigned int i;
+	u64 val;
+
+	memset(key, 0, hd->key_size);
+
+	for (i = 0; i < hd->n_keys; i++) {
+		hf = &hd->keys[i];
+
+		if (hf->flags & HIST_FIELD_STACKTRACE) {
+#ifdef CONFIG_STACKTRACE
+			struct stack_trace trace = {
+				.max_entries	= HIST_STACKTRACE_DEPTH,
+				.entries	= key + hf->offset,
+				.skip		= HIST_STACKTRACE_SKIP,
+			};
+
+			save_stack_trace(&trace);
+#endif
+			continue;
+		}
+
+		if (hf->flags & HIST_FIELD_STRING) {
+			hist_string_key(hf->field, rec, key + hf->offset);
+			continue;
+		}
+
+		val = hist_field_value(hf->field, rec);
+		if (hf->flags & HIST_FIELD_LOG2)
+			val = fls64(val);
+		*(u64 *)(key + hf->offset) = val;
+	}
+}
+
+static struct hist_elt *
+hist_find_or_insert(struct hist_trigger_data *hd, void *key, u32 hash)
+{
+	struct hist_elt *elt;
+	unsigned int i, idx;
+
+	for (i = 0, idx = hash; i < hd->nr_slots; i++, idx++) {
+		elt = hist_elt(hd, idx & (hd->nr_slots - 1));
+
+		if (ACCESS_ONCE(elt->hash) == hash) {
+			smp_rmb();	/* pairs with smp_wmb() below */
+			if (!memcmp(elt->key, key, hd->key_size))
+				return elt;
+			continue;
+		}
+
+		if (atomic_read(&elt->claimed) ||
+		    atomic_cmpxchg(&elt->claimed, 0, 1))
+			continue;
+
+		if (atomic_inc_return(&hd->nr_elts) > hd->max_elts)
+			return NULL;
+
+		memcpy(elt->key, key, hd->key_size);
+		smp_wmb();
+		ACCESS_ONCE(elt->hash) = hash;
+
+		return elt;
+	}
+
+	return NULL;
+}
+
+static void
+event_hist_trigger(struct event_trigger_data *data, void *rec)
+{
+	struct hist_trigger_data *hd = data->private_data;
+	u64 key[HIST_KEYS_MAX * HIST_STACKTRACE_DEPTH];
+	struct hist_elt *elt;
+	unsigned int i;
+	u32 hash;
+
+	if (!rec)
+		return;
+
+	hist_build_key(hd, rec, key);
+	hash = jhash(key, hd->key_size, 0) ?: 1;
+
+	elt = hist_find_or_insert(hd, key, hash);
+	if (!elt) {
+		atomic64_inc(&hd->drops);
+		return;
+	}
+
+	atomic64_inc(&elt->hitcount);
+	for (i = 0; i < hd->n_vals; i++)
+		atomic64_add(hist_field_value(hd->vals[i].field, rec),
+			     &elt->sums[i]);
+}
+
+static const char *hist_field_flag_name(unsigned long flags)
+{
+	if (flags & HIST_FIELD_LOG2)
+		return ".log2";
+	if (flags & HIST_FIELD_HEX)
+		return ".hex";
+	if (flags & HIST_FIELD_SYM)
+		return ".sym";
+	if (flags & HIST_FIELD_EXECNAME)
+		return ".execname";
+	return "";
+}
+
+static int parse_hist_key(struct hist_trigger_data *hd,
+			  struct ftrace_event_call *call, char *str)
+{
+	struct hist_field *hf = &hd->keys[hd->n_keys];
+	char *name = strsep(&str, ".");
+
+	if (hd->n_keys == HIST_KEYS_MAX)
+		return -EINVAL;
+
+	if (!strcmp(name, "stacktrace")) {
+#ifdef CONFIG_STACKTRACE
+		if (str)
+			return -EINVAL;
+		hf->flags = HIST_FIELD_STACKTRACE;
+		hf->size = HIST_STACKTRACE_DEPTH * sizeof(unsigned long);
+		goto out;
+#else
+		return -EINVAL;
+#endif
+	}
+
+	hf->field = trace_find_event_field(call, name);
+	if (!hf->field)
+		return -EINVAL;
+
+	if (hf->field->filter_type == FILTER_STATIC_STRING ||
+	    hf->field->filter_type == FILTER_DYN_STRING) {
+		if (str)
+			return -EINVAL;
+		hf->flags = HIST_FIELD_STRING;
+		hf->size = HIST_KEY_STRING_MAX;
+		goto out;
+	}
+
+	if (hf->field->filter_type != FILTER_OTHER ||
+	    hf->field->size > sizeof(u64))
+		return -EINVAL;
+
+	if (str) {
+		if (!strcmp(str, "log2"))
+			hf->flags = HIST_FIELD_LOG2;
+		else if (!strcmp(str, "hex"))
+			hf->flags = HIST_FIELD_HEX;
+		else if (!strcmp(str, "sym"))
+			hf->flags = HIST_FIELD_SYM;
+		else if (!strcmp(str, "execname") &&
+			 !strcmp(name, "common_pid"))
+			hf->flags = HIST_FIELD_EXECNAME;
+		else
+			return -EINVAL;
+	}
+
+	hf->size = sizeof(u64);
+ out:
+	hf->offset = hd->key_size;
+	hd->key_size += hf->size;
+	hd->n_keys++;
+
+	return 0;
+}
+
+static int parse_hist_val(struct hist_trigger_data *hd,
+			  struct ftrace_event_call *call, char *name)
+{
+	struct hist_field *hf = &hd->vals[hd->n_vals];
+
+	if (hd->n_vals == HIST_VALS_MAX)
+		return -EINVAL;
+
+	/* the hitcount is always there */
+	if (!strcmp(name, "hitcount"))
+		return 0;
+
+	hf->field = trace_find_event_field(call, name);
+	if (!hf->field || hf->field->filter_type != FILTER_OTHER ||
+	    hf->field->size > sizeof(u64))
+		return -EINVAL;
+
+	hd->n_vals++;
+
+	return 0;
+}
+
+static void destroy_hist_data(struct hist_trigger_data *hd)
+{
+	if (!hd)
+		return;
+
+	vfree(hd->elts);
+	kfree(hd);
+}
+
+/* keys=<key>[,<key>...][:vals=<val>[,<val>...]][:size=<n>][:sort=key|hitcount] */
+static struct hist_trigger_data *
+create_hist_data(struct ftrace_event_call *call, char *trigger)
+{
+	struct hist_trigger_data *hd;
+	unsigned int size = 1 << HIST_BITS_DEFAULT;
+	char *opt, *name, *list;
+	int ret = -EINVAL;
+
+	hd = kzalloc(sizeof(*hd), GFP_KERNEL);
+	if (!hd)
+		return ERR_PTR(-ENOMEM);
+
+	while ((opt = strsep(&trigger, ":")) != NULL) {
+		list = opt;
+		name = strsep(&list, "=");
+		if (!list)
+			goto free;
+
+		if (!strcmp(name, "keys") || !strcmp(name, "key")) {
+			while ((name = strsep(&list, ",")) != NULL) {
+				ret = parse_hist_key(hd, call, name);
+				if (ret)
+					goto free;
+			}
+		} else if (!strcmp(name, "vals") || !strcmp(name, "values")) {
+			while ((name = strsep(&list, ",")) != NULL) {
+				ret = parse_hist_val(hd, call, name);
+				if (ret)
+					goto free;
+			}
+		} else if (!strcmp(name, "size")) {
+			ret = kstrtouint(list, 0, &size);
+			if (ret)
+				goto free;
+		} else if (!strcmp(name, "sort")) {
+			if (!strcmp(list, "key"))
+				hd->sort_by_key = true;
+			else if (strcmp(list, "hitcount"))
+				goto free_inval;
+		} else
+			goto free_inval;
+	}
+
+	if (!hd->n_keys)
+		goto free_inval;
+
+	hd->map_bits = clamp_t(unsigned int, order_base_2(size),
+			       HIST_BITS_MIN, HIST_BITS_MAX);
+	hd->max_elts = 1 << hd->map_bits;
+	hd->nr_slots = hd->max_elts * 2;
+	hd->key_size = ALIGN(hd->key_size, sizeof(u64));
+	hd->elt_size = sizeof(struct hist_elt) + hd->key_size;
+
+	hd->elts = vzalloc(hd->nr_slots * hd->elt_size);
+	if (!hd->elts) {
+		ret = -ENOMEM;
+		goto free;
+	}
+
+	return hd;
+
+ free_inval:
+	ret = -EINVAL;
+ free:
+	destroy_hist_data(hd);
+	return ERR_PTR(ret);
+}
+
+static void hist_field_print(struct seq_file *m, struct hist_field *hf)
+{
+	if (hf->flags & HIST_FIELD_STACKTRACE)
+		seq_puts(m, "stacktrace");
+	else
+		seq_printf(m, "%s%s", hf->field->name,
+			   hist_field_flag_name(hf->flags));
+}
+
+static int
+event_hist_trigger_print(struct seq_file *m, struct event_trigger_ops *ops,
+			 struct event_trigger_data *data)
+{
+	struct hist_trigger_data *hd = data->private_data;
+	unsigned int i;
+
+	seq_puts(m, "hist:keys=");
+	for (i = 0; i < hd->n_keys; i++) {
+		if (i)
+			seq_putc(m, ',');
+		hist_field_print(m, &hd->keys[i]);
+	}
+
+	seq_puts(m, ":vals=hitcount");
+	for (i = 0; i < hd->n_vals; i++)
+		seq_printf(m, ",%s", hd->vals[i].field->name);
+
+	seq_printf(m, ":size=%u", hd->max_elts);
+	if (hd->sort_by_key)
+		seq_puts(m, ":sort=key");
+
+	if (data->filter_str)
+		seq_printf(m, " if %s", data->filter_str);
+
+	seq_puts(m, " [active]\n");
+
+	return 0;
+}
+
+static int
+event_hist_trigger_init(struct event_trigger_ops *ops,
+			struct event_trigger_data *data)
+{
+	data->ref++;
+	return 0;
+}
+
+static void
+event_hist_trigger_free(struct event_trigger_ops *ops,
+			struct event_trigger_data *data)
+{
+	struct hist_trigger_data *hd = data->private_data;
+
+	if (WARN_ON_ONCE(data->ref <= 0))
+		return;
+
+	data->ref--;
+	if (!data->ref) {
+		/* waits for the trigger to be done with the table */
+		trigger_data_free(data);
+		destroy_hist_data(hd);
+	}
+}
+
+static struct event_trigger_ops event_hist_trigger_ops = {
+	.func			= event_hist_trigger,
+	.print			= event_hist_trigger_print,
+	.init			= event_hist_trigger_init,
+	.free			= event_hist_trigger_free,
+};
+
+static struct event_trigger_ops *
+event_hist_get_trigger_ops(char *cmd, char *param)
+{
+	return &event_hist_trigger_ops;
+}
+
+static int
+event_hist_trigger_func(struct event_command *cmd_ops,
+			struct ftrace_event_file *file,
+			char *glob, char *cmd, char *param)
+{
+	struct event_trigger_data *trigger_data;
+	struct event_trigger_ops *trigger_ops;
+	struct hist_trigger_data *hd = NULL;
+	char *trigger;
+	int ret;
+
+	/* separate the trigger from the filter (k=v:... [if filter]) */
+	trigger = strsep(&param, " \t");
+	if (!trigger || !strlen(trigger))
+		return -EINVAL;
+
+	trigger_ops = cmd_ops->get_trigger_ops(cmd, trigger);
+
+	trigger_data = kzalloc(sizeof(*trigger_data), GFP_KERNEL);
+	if (!trigger_data)
+		return -ENOMEM;
+
+	trigger_data->count = -1;
+	trigger_data->ops = trigger_ops;
+	trigger_data->cmd_ops = cmd_ops;
+	INIT_LIST_HEAD(&trigger_data->list);
+
+	if (glob[0] == '!') {
+		cmd_ops->unreg(glob+1, trigger_ops, trigger_data, file);
+		kfree(trigger_data);
+		return 0;
+	}
+
+	hd = create_hist_data(file->event_call, trigger);
+	if (IS_ERR(hd)) {
+		kfree(trigger_data);
+		return PTR_ERR(hd);
+	}
+	trigger_data->private_data = hd;
+
+	if (param) {
+		ret = cmd_ops->set_filter(param, trigger_data, file);
+		if (ret < 0)
+			goto out_free;
+	}
+
+	ret = cmd_ops->reg(glob, trigger_ops, trigger_data, file);
+	/* zero means no trigger was enabled */
+	if (!ret)
+		ret = -ENOENT;
+	if (ret < 0)
+		goto out_free;
+
+	return 0;
+
+ out_free:
+	cmd_ops->set_filter(NULL, trigger_data, NULL);
+	kfree(trigger_data);
+	destroy_hist_data(hd);
+
+	return ret;
+}
+
+static struct event_command trigger_hist_cmd = {
+	.name			= "hist",
+	.trigger_type		= ETT_EVENT_HIST,
+	.needs_rec		= true,
+	.func			= event_hist_trigger_func,
+	.reg			= register_trigger,
+	.unreg			= unregister_trigger,
+	.get_trigger_ops	= event_hist_get_trigger_ops,
+	.set_filter		= set_trigger_filter,
+};
+
+__init int register_trigger_hist_cmd(void)
+{
+	int ret;
+
+	ret = register_event_command(&trigger_hist_cmd);
+	WARN_ON(ret < 0);
+
+	return ret;
+}
+
+/*
+ * Reading the table: the elements are copied out, merged by key and
+ * sorted, so that concurrent updates only make the totals a little
+ * stale.
+ */
+struct hist_snap {
+	const void	*key;
+	u64		hitcount;
+	u64		sums[HIST_VALS_MAX];
+};
+
+static unsigned int hist_sort_key_size;
+
+static int hist_cmp_key(const void *a, const void *b)
+{
+	const struct hist_snap *sa = a, *sb = b;
+
+	return memcmp(sa->key, sb->key, hist_sort_key_size);
+}
+
+static int hist_cmp_hitcount(const void *a, const void *b)
+{
+	const struct hist_snap *sa = a, *sb = b;
+
+	if (sa->hitcount == sb->hitcount)
+		return 0;
+
+	return sa->hitcount < sb->hitcount ? 1 : -1;
+}
+
+static void hist_print_key(struct seq_file *m, struct hist_field *hf,
+			   const void *key)
+{
+	u64 val = *(u64 *)key;
+	char comm[TASK_COMM_LEN];
+	unsigned int i;
+
+	if (hf->flags & HIST_FIELD_STACKTRACE) {
+		const unsigned long *stack = key;
+
+		seq_puts(m, "stacktrace:\n");
+		for (i = 0; i < HIST_STACKTRACE_DEPTH && stack[i]; i++) {
+			if (stack[i] == ULONG_MAX)
+				break;
+			seq_printf(m, "         %pS\n", (void *)stack[i]);
+		}
+		return;
+	}
+
+	seq_printf(m, "%s: ", hf->field->name);
+
+	if (hf->flags & HIST_FIELD_STRING)
+		seq_printf(m, "%-16s", (const char *)key);
+	else if (hf->flags & HIST_FIELD_EXECNAME) {
+		trace_find_cmdline((int)val, comm);
+		seq_printf(m, "%-16s[%10llu]", comm, val);
+	} else if (hf->flags & HIST_FIELD_SYM)
+		seq_printf(m, "[%016llx] %pS", val, (void *)(unsigned long)val);
+	else if (hf->flags & HIST_FIELD_HEX)
+		seq_printf(m, "%16llx", val);
+	else if (hf->flags & HIST_FIELD_LOG2) {
+		/* bucket n holds [2^(n-1), 2^n) */
+		if (!val)
+			seq_puts(m, "0");
+		else if (val == 64)
+			seq_printf(m, "[%llu, inf)", 1ULL << 63);
+		else
+			seq_printf(m, "[%llu, %llu)", 1ULL << (val - 1),
+				   1ULL << val);
+	} else if (hf->field->is_signed)
+		seq_printf(m, "%10lld", (s64)val);
+	else
+		seq_printf(m, "%10llu", val);
+}
+
+static void hist_trigger_show(struct seq_file *m,
+			      struct event_trigger_data *data)
+{
+	struct hist_trigger_data *hd = data->private_data;
+	struct hist_snap *snaps;
+	struct hist_elt *elt;
+	unsigned int i, j, n = 0, nr;
+	u64 hits = 0;
+
+	event_hist_trigger_print(m, data->ops, data);
+	seq_putc(m, '\n');
+
+	snaps = vmalloc(hd->nr_slots * sizeof(*snaps));
+	if (!snaps) {
+		seq_puts(m, "# out of memory\n");
+		return;
+	}
+
+	for (i = 0; i < hd->nr_slots; i++) {
+		elt = hist_elt(hd, i);
+		if (!ACCESS_ONCE(elt->hash))
+			continue;
+		smp_rmb();
+		snaps[n].key = elt->key;
+		snaps[n].hitcount = atomic64_read(&elt->hitcount);
+		for (j = 0; j < hd->n_vals; j++)
+			snaps[n].sums[j] = atomic64_read(&elt->sums[j]);
+		n++;
+	}
+
+	/* merge the elements that racing inserters made for the same key */
+	hist_sort_key_size = hd->key_size;
+	sort(snaps, n, sizeof(*snaps), hist_cmp_key, NULL);
+	for (i = 0, nr = 0; i < n; i++) {
+		if (nr && !hist_cmp_key(&snaps[nr - 1], &snaps[i])) {
+			snaps[nr - 1].hitcount += snaps[i].hitcount;
+			for (j = 0; j < hd->n_vals; j++)
+				snaps[nr - 1].sums[j] += snaps[i].sums[j];
+			continue;
+		}
+		snaps[nr++] = snaps[i];
+	}
+
+	if (!hd->sort_by_key)
+		sort(snaps, nr, sizeof(*snaps), hist_cmp_hitcount, NULL);
+
+	for (i = 0; i < nr; i++) {
+		seq_puts(m, "{ ");
+		for (j = 0; j < hd->n_keys; j++) {
+			if (j)
+				seq_puts(m, ", ");
+			hist_print_key(m, &hd->keys[j],
+				       snaps[i].key + hd->keys[j].offset);
+		}
+		seq_printf(m, " } hitcount: %10llu", snaps[i].hitcount);
+		for (j = 0; j < hd->n_vals; j++)
+			seq_printf(m, "  %s: %10llu", hd->vals[j].field->name,
+				   snaps[i].sums[j]);
+		seq_putc(m, '\n');
+		hits += snaps[i].hitcount;
+	}
+
+	seq_printf(m, "\nTotals:\n    Hits: %llu\n    Entries: %u\n    Dropped: %llu\n",
+		   hits, nr, (u64)atomic64_read(&hd->drops));
+
+	vfree(snaps);
+}
+
+static int hist_show(struct seq_file *m, void *v)
+{
+	struct event_trigger_data *data;
+	struct ftrace_event_file *event_file;
+	int ret = 0;
+
+	/* serializes readers too, see hist_sort_key_size */
+	mutex_lock(&event_mutex);
+
+	event_file = event_file_data(m->private);
+	if (unlikely(!event_file)) {
+		ret = -ENODEV;
+		goto out_unlock;
+	}
+
+	list_for_each_entry_rcu(data, &event_file->triggers, list) {
+		if (data->cmd_ops->trigger_type == ETT_EVENT_HIST)
+			hist_trigger_show(m, data);
+	}
+
+ out_unlock:
+	mutex_unlock(&event_mutex);
+
+	return ret;
+}
+
+static int event_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hist_show, file);
+}
+
+const struct file_operations event_hist_fops = {
+	.open = event_hist_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
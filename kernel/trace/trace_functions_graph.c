@@ -277,6 +277,17 @@ static inline int ftrace_graph_ignore_irqs(void)
 	return in_irq();
 }
 
+static inline int ftrace_graph_ignore_entry(struct ftrace_graph_ent *trace)
+{
+	if (!ftrace_trace_task(current))
+		return 1;
+
+	/* trace it when it is-nested-in or is a function enabled. */
+	return (!(trace->depth || ftrace_graph_addr(trace->func)) ||
+		ftrace_graph_ignore_irqs()) || (trace->depth < 0) ||
+		(max_depth && trace->depth >= max_depth);
+}
+
 int trace_graph_entry(struct ftrace_graph_ent *trace)
 {
 	struct trace_array *tr = graph_array;
@@ -287,13 +298,7 @@ int trace_graph_entry(struct ftrace_graph_ent *trace)
 	int cpu;
 	int pc;
 
-	if (!ftrace_trace_task(current))
-		return 0;
-
-	/* trace it when it is-nested-in or is a function enabled. */
-	if ((!(trace->depth || ftrace_graph_addr(trace->func)) ||
-	     ftrace_graph_ignore_irqs()) || (trace->depth < 0) ||
-	    (max_depth && trace->depth >= max_depth))
+	if (ftrace_graph_ignore_entry(trace))
 		return 0;
 
 	/*
@@ -323,10 +328,16 @@ int trace_graph_entry(struct ftrace_graph_ent *trace)
 	return ret;
 }
 
+/*
+ * With tracing_thresh set, nothing is written on entry: the function
+ * and its call time are already kept on the return stack, and the
+ * entry is written along with the return once the function turned out
+ * to be slow enough (see trace_graph_thresh_return()).
+ */
 int trace_graph_thresh_entry(struct ftrace_graph_ent *trace)
 {
 	if (tracing_thresh)
-		return 1;
+		return !ftrace_graph_ignore_entry(trace);
 	else
 		return trace_graph_entry(trace);
 }
@@ -412,13 +423,44 @@ void set_graph_array(struct trace_array *tr)
 	smp_mb();
 }
 
+/*
+ * Write the entry and the return of a call that took longer than
+ * tracing_thresh back to back, so that the output shows it like any
+ * other leaf function, with its duration.  Calls below the threshold
+ * cost no more than the return stack push and pop.
+ */
 void trace_graph_thresh_return(struct ftrace_graph_ret *trace)
 {
-	if (tracing_thresh &&
-	    (trace->rettime - trace->calltime < tracing_thresh))
-		return;
-	else
+	struct trace_array *tr = graph_array;
+	struct trace_array_cpu *data;
+	struct ftrace_graph_ent ent;
+	unsigned long flags;
+	long disabled;
+	int cpu;
+	int pc;
+
+	if (!tracing_thresh) {
 		trace_graph_return(trace);
+		return;
+	}
+
+	if (trace->rettime - trace->calltime < tracing_thresh)
+		return;
+
+	ent.func = trace->func;
+	ent.depth = trace->depth;
+
+	local_irq_save(flags);
+	cpu = raw_smp_processor_id();
+	data = per_cpu_ptr(tr->trace_buffer.data, cpu);
+	disabled = atomic_inc_return(&data->disabled);
+	if (likely(disabled == 1)) {
+		pc = preempt_count();
+		if (__trace_graph_entry(tr, &ent, flags, pc))
+			__trace_graph_return(tr, trace, flags, pc);
+	}
+	atomic_dec(&data->disabled);
+	local_irq_restore(flags);
 }
 
 static int graph_trace_init(struct trace_array *tr)
@@ -48,6 +48,7 @@
 #include <linux/nodemask.h>
 #include <linux/moduleparam.h>
 #include <linux/uaccess.h>
+#include <linux/tick.h>
 
 #include "workqueue_internal.h"
 
@@ -224,6 +225,22 @@ struct wq_flusher {
 
 struct wq_device;
 
+#ifdef CONFIG_WQ_STATS
+/*
+ * Per-cpu histograms of how long work items waited between being queued
+ * and starting to execute and of how long they executed.  Bucket i
+ * counts durations shorter than 2^i usecs, the last one all longer ones.
+ */
+#define WQ_STAT_BUCKETS		24
+
+struct wq_stats {
+	u64			lat_hist[WQ_STAT_BUCKETS];
+	u64			exec_hist[WQ_STAT_BUCKETS];
+	u64			lat_max;	/* nsecs */
+	u64			exec_max;	/* nsecs */
+};
+#endif
+
 /*
  * The externally visible workqueue.  It relays the issued work items to
  * the appropriate worker_pool through its pool_workqueues.
@@ -252,6 +269,9 @@ struct workqueue_struct {
 #ifdef CONFIG_SYSFS
 	struct wq_device	*wq_dev;	/* I: for sysfs interface */
 #endif
+#ifdef CONFIG_WQ_STATS
+	struct wq_stats __percpu *stats;	/* I: per-cpu latency stats */
+#endif
 #ifdef CONFIG_LOCKDEP
 	struct lockdep_map	lockdep_map;
 #endif
@@ -281,6 +301,11 @@ static bool wq_power_efficient;
 
 module_param_named(power_efficient, wq_power_efficient, bool, 0444);
 
+/* max_running of the standard high priority unbound pools, 0 = no limit */
+static int wq_highpri_unbound_max_running;
+module_param_named(highpri_unbound_max_running, wq_highpri_unbound_max_running,
+		   int, 0444);
+
 static bool wq_numa_enabled;		/* unbound NUMA affinity enabled */
 
 /* buf for wq_update_unbound_numa_attrs(), protected by CPU hotplug exclusion */
@@ -329,6 +354,69 @@ static void copy_workqueue_attrs(struct workqueue_attrs *to,
 #define CREATE_TRACE_POINTS
 #include <trace/events/workqueue.h>
 
+#ifdef CONFIG_WQ_STATS
+static int wq_stats_alloc(struct workqueue_struct *wq)
+{
+	wq->stats = alloc_percpu(struct wq_stats);
+	return wq->stats ? 0 : -ENOMEM;
+}
+
+static void wq_stats_free(struct workqueue_struct *wq)
+{
+	free_percpu(wq->stats);
+}
+
+static u64 wq_stats_clock(void)
+{
+	return local_clock();
+}
+
+static void wq_stats_queue(struct work_struct *work)
+{
+	work->queued_at = local_clock();
+}
+
+static u64 wq_stats_queued_at(struct work_struct *work)
+{
+	return work->queued_at;
+}
+
+static int wq_stats_bucket(u64 nsecs)
+{
+	u64 usecs = div_u64(nsecs, NSEC_PER_USEC);
+
+	return min_t(int, fls64(usecs), WQ_STAT_BUCKETS - 1);
+}
+
+/*
+ * Account a work item of @wq queued at @queued which started executing
+ * at @start and has just finished.  Called with pool->lock held, so the
+ * per-cpu stats are safe from interrupts.
+ */
+static void wq_stats_account(struct workqueue_struct *wq, u64 queued,
+			     u64 start)
+{
+	struct wq_stats *stats = this_cpu_ptr(wq->stats);
+	u64 now = local_clock();
+	/* the clocks of different CPUs may be slightly off */
+	u64 lat = (s64)(start - queued) > 0 ? start - queued : 0;
+	u64 exec = (s64)(now - start) > 0 ? now - start : 0;
+
+	stats->lat_hist[wq_stats_bucket(lat)]++;
+	stats->exec_hist[wq_stats_bucket(exec)]++;
+	stats->lat_max = max(stats->lat_max, lat);
+	stats->exec_max = max(stats->exec_max, exec);
+}
+#else
+static inline int wq_stats_alloc(struct workqueue_struct *wq) { return 0; }
+static inline void wq_stats_free(struct workqueue_struct *wq) { }
+static inline u64 wq_stats_clock(void) { return 0; }
+static inline void wq_stats_queue(struct work_struct *work) { }
+static inline u64 wq_stats_queued_at(struct work_struct *work) { return 0; }
+static inline void wq_stats_account(struct workqueue_struct *wq, u64 queued,
+				    u64 start) { }
+#endif
+
 #define assert_rcu_or_pool_mutex()					\
 	rcu_lockdep_assert(rcu_read_lock_sched_held() ||		\
 			   lockdep_is_held(&wq_pool_mutex),		\
@@ -732,6 +820,17 @@ static bool need_more_worker(struct worker_pool *pool)
 	return !list_empty(&pool->worklist) && __need_more_worker(pool);
 }
 
+/*
+ * Would @nr_more additional busy workers take @pool over its max_running
+ * limit?  Busy workers include the caller if it isn't idle.
+ */
+static bool max_running_reached(struct worker_pool *pool, int nr_more)
+{
+	int max = pool->attrs->max_running;
+
+	return max && pool->nr_workers - pool->nr_idle + nr_more > max;
+}
+
 /* Can I start working?  Called from busy but !running workers. */
 static bool may_start_working(struct worker_pool *pool)
 {
@@ -748,7 +847,8 @@ static bool keep_working(struct worker_pool *pool)
 /* Do we need a new worker?  Called from manager. */
 static bool need_to_create_worker(struct worker_pool *pool)
 {
-	return need_more_worker(pool) && !may_start_working(pool);
+	return need_more_worker(pool) && !may_start_working(pool) &&
+		!max_running_reached(pool, 1);
 }
 
 /* Do we have too many workers and should some go away? */
@@ -1271,6 +1371,7 @@ static void insert_work(struct pool_workqueue *pwq, struct work_struct *work,
 	set_work_pwq(work, pwq, extra_flags);
 	list_add_tail(&work->entry, head);
 	get_pwq(pwq);
+	wq_stats_queue(work);
 
 	/*
 	 * Ensure either wq_worker_sleeping() sees the above
@@ -2008,6 +2109,7 @@ __acquires(&pool->lock)
 	bool cpu_intensive = pwq->wq->flags & WQ_CPU_INTENSIVE;
 	int work_color;
 	struct worker *collision;
+	u64 queued_at, start;
 #ifdef CONFIG_LOCKDEP
 	/*
 	 * It is permissible to free the struct work_struct from
@@ -2048,6 +2150,7 @@ __acquires(&pool->lock)
 	worker->current_func = work->func;
 	worker->current_pwq = pwq;
 	work_color = get_work_color(work);
+	queued_at = wq_stats_queued_at(work);
 
 	list_del_init(&work->entry);
 
@@ -2062,7 +2165,8 @@ __acquires(&pool->lock)
 	 * Unbound pool isn't concurrency managed and work items should be
 	 * executed ASAP.  Wake up another worker if necessary.
 	 */
-	if ((worker->flags & WORKER_UNBOUND) && need_more_worker(pool))
+	if ((worker->flags & WORKER_UNBOUND) && need_more_worker(pool) &&
+	    !max_running_reached(pool, 1))
 		wake_up_worker(pool);
 
 	/*
@@ -2078,6 +2182,7 @@ __acquires(&pool->lock)
 	lock_map_acquire_read(&pwq->wq->lockdep_map);
 	lock_map_acquire(&lockdep_map);
 	trace_workqueue_execute_start(work);
+	start = wq_stats_clock();
 	worker->current_func(work);
 	/*
 	 * While we must be careful to not use "work" after this, the trace
@@ -2107,6 +2212,8 @@ __acquires(&pool->lock)
 
 	spin_lock_irq(&pool->lock);
 
+	wq_stats_account(pwq->wq, queued_at, start);
+
 	/* clear cpu intensive status */
 	if (unlikely(cpu_intensive))
 		worker_clr_flags(worker, WORKER_CPU_INTENSIVE);
@@ -2179,7 +2286,7 @@ woke_up:
 	worker_leave_idle(worker);
 recheck:
 	/* no more worker necessary? */
-	if (!need_more_worker(pool))
+	if (!need_more_worker(pool) || max_running_reached(pool, 0))
 		goto sleep;
 
 	/* do we need to manage? */
@@ -3050,9 +3157,53 @@ static ssize_t max_active_store(struct device *dev,
 }
 static DEVICE_ATTR_RW(max_active);
 
+#ifdef CONFIG_WQ_STATS
+static ssize_t wq_stats_show(struct workqueue_struct *wq, char *buf, bool exec)
+{
+	u64 hist[WQ_STAT_BUCKETS] = { };
+	u64 max_nsecs = 0;
+	int cpu, i, written = 0;
+
+	for_each_possible_cpu(cpu) {
+		struct wq_stats *stats = per_cpu_ptr(wq->stats, cpu);
+
+		for (i = 0; i < WQ_STAT_BUCKETS; i++)
+			hist[i] += exec ? stats->exec_hist[i] : stats->lat_hist[i];
+		max_nsecs = max(max_nsecs,
+				exec ? stats->exec_max : stats->lat_max);
+	}
+
+	for (i = 0; i < WQ_STAT_BUCKETS - 1; i++)
+		written += scnprintf(buf + written, PAGE_SIZE - written,
+				     "<%lu %llu\n", 1UL << i, hist[i]);
+	written += scnprintf(buf + written, PAGE_SIZE - written,
+			     ">=%lu %llu\nmax %llu\n", 1UL << i, hist[i],
+			     div_u64(max_nsecs, NSEC_PER_USEC));
+	return written;
+}
+
+static ssize_t queue_latency_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	return wq_stats_show(dev_to_wq(dev), buf, false);
+}
+static DEVICE_ATTR_RO(queue_latency);
+
+static ssize_t exec_time_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	return wq_stats_show(dev_to_wq(dev), buf, true);
+}
+static DEVICE_ATTR_RO(exec_time);
+#endif
+
 static struct attribute *wq_sysfs_attrs[] = {
 	&dev_attr_per_cpu.attr,
 	&dev_attr_max_active.attr,
+#ifdef CONFIG_WQ_STATS
+	&dev_attr_queue_latency.attr,
+	&dev_attr_exec_time.attr,
+#endif
 	NULL,
 };
 ATTRIBUTE_GROUPS(wq_sysfs);
@@ -3195,9 +3346,46 @@ static ssize_t wq_numa_store(struct device *dev, struct device_attribute *attr,
 	return ret ?: count;
 }
 
+static ssize_t wq_max_running_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	int written;
+
+	mutex_lock(&wq->mutex);
+	written = scnprintf(buf, PAGE_SIZE, "%d\n",
+			    wq->unbound_attrs->max_running);
+	mutex_unlock(&wq->mutex);
+
+	return written;
+}
+
+static ssize_t wq_max_running_store(struct device *dev,
+				    struct device_attribute *attr,
+				    const char *buf, size_t count)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	struct workqueue_attrs *attrs;
+	int ret;
+
+	attrs = wq_sysfs_prep_attrs(wq);
+	if (!attrs)
+		return -ENOMEM;
+
+	if (sscanf(buf, "%d", &attrs->max_running) == 1 &&
+	    attrs->max_running >= 0)
+		ret = apply_workqueue_attrs(wq, attrs);
+	else
+		ret = -EINVAL;
+
+	free_workqueue_attrs(attrs);
+	return ret ?: count;
+}
+
 static struct device_attribute wq_sysfs_unbound_attrs[] = {
 	__ATTR(pool_ids, 0444, wq_pool_ids_show, NULL),
 	__ATTR(nice, 0644, wq_nice_show, wq_nice_store),
+	__ATTR(max_running, 0644, wq_max_running_show, wq_max_running_store),
 	__ATTR(cpumask, 0644, wq_cpumask_show, wq_cpumask_store),
 	__ATTR(numa, 0644, wq_numa_show, wq_numa_store),
 	__ATTR_NULL,
@@ -3342,7 +3530,8 @@ struct workqueue_attrs *alloc_workqueue_attrs(gfp_t gfp_mask)
 	if (!alloc_cpumask_var(&attrs->cpumask, gfp_mask))
 		goto fail;
 
-	cpumask_copy(attrs->cpumask, cpu_possible_mask);
+	/* unbound work stays off full dynticks CPUs unless asked otherwise */
+	cpumask_copy(attrs->cpumask, housekeeping_cpumask());
 	return attrs;
 fail:
 	free_workqueue_attrs(attrs);
@@ -3354,6 +3543,7 @@ static void copy_workqueue_attrs(struct workqueue_attrs *to,
 {
 	to->nice = from->nice;
 	cpumask_copy(to->cpumask, from->cpumask);
+	to->max_running = from->max_running;
 	/*
 	 * Unlike hash and equality test, this function doesn't ignore
 	 * ->no_numa as it is used for both pool and wq attrs.  Instead,
@@ -3368,6 +3558,7 @@ static u32 wqattrs_hash(const struct workqueue_attrs *attrs)
 	u32 hash = 0;
 
 	hash = jhash_1word(attrs->nice, hash);
+	hash = jhash_1word(attrs->max_running, hash);
 	hash = jhash(cpumask_bits(attrs->cpumask),
 		     BITS_TO_LONGS(nr_cpumask_bits) * sizeof(long), hash);
 	return hash;
@@ -3379,6 +3570,8 @@ static bool wqattrs_equal(const struct workqueue_attrs *a,
 {
 	if (a->nice != b->nice)
 		return false;
+	if (a->max_running != b->max_running)
+		return false;
 	if (!cpumask_equal(a->cpumask, b->cpumask))
 		return false;
 	return true;
@@ -3613,6 +3806,7 @@ static void pwq_unbound_release_workfn(struct work_struct *work)
 	 */
 	if (is_last) {
 		free_workqueue_attrs(wq->unbound_attrs);
+		wq_stats_free(wq);
 		kfree(wq);
 	}
 }
@@ -4092,6 +4286,9 @@ struct workqueue_struct *__alloc_workqueue_key(const char *fmt,
 			goto err_free_wq;
 	}
 
+	if (wq_stats_alloc(wq))
+		goto err_free_wq;
+
 	va_start(args, lock_name);
 	vsnprintf(wq->name, sizeof(wq->name), fmt, args);
 	va_end(args);
@@ -4162,6 +4359,7 @@ struct workqueue_struct *__alloc_workqueue_key(const char *fmt,
 
 err_free_wq:
 	free_workqueue_attrs(wq->unbound_attrs);
+	wq_stats_free(wq);
 	kfree(wq);
 	return NULL;
 err_destroy:
@@ -4227,6 +4425,7 @@ void destroy_workqueue(struct workqueue_struct *wq)
 		 * free the pwqs and wq.
 		 */
 		free_percpu(wq->cpu_pwqs);
+		wq_stats_free(wq);
 		kfree(wq);
 	} else {
 		/*
@@ -4946,6 +5145,8 @@ static int __init init_workqueues(void)
 
 		BUG_ON(!(attrs = alloc_workqueue_attrs(GFP_KERNEL)));
 		attrs->nice = std_nice[i];
+		if (std_nice[i] == HIGHPRI_NICE_LEVEL)
+			attrs->max_running = max(wq_highpri_unbound_max_running, 0);
 		unbound_std_wq_attrs[i] = attrs;
 
 		/*
@@ -0,0 +1,735 @@
+/*
+ * Resizable, Scalable, Concurrent Hash Table
+ *
+ * A resize allocates a new bucket table, links it from the old one as
+ * its future_tbl and then moves the old buckets over one at a time,
+ * each under its bucket lock.  Entries are moved from the tail of a
+ * chain, so a lockless reader that is overtaken by the move ends up at
+ * the end of a chain in the new table; after a miss, readers retry in
+ * future_tbl.  Writers always operate on the oldest table whose bucket
+ * has not been moved yet, which keeps every key in exactly one bucket.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/log2.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/jhash.h>
+#include <linux/random.h>
+#include <linux/rhashtable.h>
+#include <linux/err.h>
+#include <linux/export.h>
+
+#define HASH_DEFAULT_SIZE	64UL
+#define HASH_MIN_SIZE		4U
+#define BUCKET_LOCKS_PER_CPU	128UL
+
+static void *rht_obj(const struct rhashtable *ht, const struct rhash_head *he)
+{
+	return (void *) he - ht->p.head_offset;
+}
+
+static u32 rht_bucket_index(const struct bucket_table *tbl, u32 hash)
+{
+	return hash & (tbl->size - 1);
+}
+
+static u32 key_hashfn(const struct rhashtable *ht,
+		      const struct bucket_table *tbl, const void *key)
+{
+	return rht_bucket_index(tbl, ht->p.hashfn(key, ht->p.key_len,
+						  tbl->hash_rnd));
+}
+
+static u32 head_hashfn(const struct rhashtable *ht,
+		       const struct bucket_table *tbl,
+		       const struct rhash_head *he)
+{
+	const char *ptr = rht_obj(ht, he);
+
+	if (likely(ht->p.key_len))
+		return key_hashfn(ht, tbl, ptr + ht->p.key_offset);
+
+	return rht_bucket_index(tbl, ht->p.obj_hashfn(ptr, tbl->hash_rnd));
+}
+
+static spinlock_t *bucket_lock(const struct bucket_table *tbl, u32 hash)
+{
+	return &tbl->locks[hash & tbl->locks_mask];
+}
+
+#ifdef CONFIG_PROVE_LOCKING
+int lockdep_rht_mutex_is_held(struct rhashtable *ht)
+{
+	return (debug_locks) ? lockdep_is_held(&ht->mutex) : 1;
+}
+EXPORT_SYMBOL_GPL(lockdep_rht_mutex_is_held);
+
+int lockdep_rht_bucket_is_held(const struct bucket_table *tbl, u32 hash)
+{
+	spinlock_t *lock = bucket_lock(tbl, hash);
+
+	return (debug_locks) ? lockdep_is_held(lock) : 1;
+}
+EXPORT_SYMBOL_GPL(lockdep_rht_bucket_is_held);
+#endif
+
+static int alloc_bucket_locks(struct rhashtable *ht, struct bucket_table *tbl)
+{
+	unsigned int i, size;
+#if defined(CONFIG_PROVE_LOCKING)
+	unsigned int nr_pcpus = 2;
+#else
+	unsigned int nr_pcpus = num_possible_cpus();
+#endif
+
+	nr_pcpus = min_t(unsigned int, nr_pcpus, 32UL);
+	size = roundup_pow_of_two(nr_pcpus * ht->p.locks_mul);
+
+	/* Never allocate more than 0.5 locks per bucket */
+	size = min_t(unsigned int, size, tbl->size >> 1);
+
+	if (sizeof(spinlock_t) != 0) {
+#ifdef CONFIG_NUMA
+		if (size * sizeof(spinlock_t) > PAGE_SIZE)
+			tbl->locks = vmalloc(size * sizeof(spinlock_t));
+		else
+#endif
+		tbl->locks = kmalloc_array(size, sizeof(spinlock_t),
+					   GFP_KERNEL);
+		if (!tbl->locks)
+			return -ENOMEM;
+		for (i = 0; i < size; i++)
+			spin_lock_init(&tbl->locks[i]);
+	}
+	tbl->locks_mask = size - 1;
+
+	return 0;
+}
+
+static void bucket_table_free(const struct bucket_table *tbl)
+{
+	if (tbl)
+		kvfree(tbl->locks);
+
+	kvfree(tbl);
+}
+
+static void bucket_table_free_rcu(struct rcu_head *head)
+{
+	bucket_table_free(container_of(head, struct bucket_table, rcu));
+}
+
+static struct bucket_table *bucket_table_alloc(struct rhashtable *ht,
+					       size_t nbuckets)
+{
+	struct bucket_table *tbl;
+	size_t size;
+
+	size = sizeof(*tbl) + nbuckets * sizeof(tbl->buckets[0]);
+	tbl = kzalloc(size, GFP_KERNEL | __GFP_NOWARN | __GFP_NORETRY);
+	if (tbl == NULL)
+		tbl = vzalloc(size);
+	if (tbl == NULL)
+		return NULL;
+
+	tbl->size = nbuckets;
+
+	if (alloc_bucket_locks(ht, tbl) < 0) {
+		bucket_table_free(tbl);
+		return NULL;
+	}
+
+	get_random_bytes(&tbl->hash_rnd, sizeof(tbl->hash_rnd));
+
+	return tbl;
+}
+
+/**
+ * rht_grow_above_75 - returns true if nelems > 0.75 * table-size
+ * @ht:		hash table
+ * @tbl:	current table
+ */
+static bool rht_grow_above_75(const struct rhashtable *ht,
+			      const struct bucket_table *tbl)
+{
+	/* Expand table when exceeding 75% load */
+	return atomic_read(&ht->nelems) > (tbl->size / 4 * 3) &&
+	       (!ht->p.max_size || tbl->size < ht->p.max_size);
+}
+
+/**
+ * rht_shrink_below_30 - returns true if nelems < 0.3 * table-size
+ * @ht:		hash table
+ * @tbl:	current table
+ */
+static bool rht_shrink_below_30(const struct rhashtable *ht,
+				const struct bucket_table *tbl)
+{
+	/* Shrink table beneath 30% load */
+	return ht->p.automatic_shrinking &&
+	       atomic_read(&ht->nelems) < (tbl->size * 3 / 10) &&
+	       tbl->size > ht->p.min_size;
+}
+
+/*
+ * Move the last entry of an old bucket to the new table.  Returns
+ * -ENOENT once the bucket is empty.  Moving the tail first means a
+ * reader still walking the old chain never skips an entry it has not
+ * yet seen without also reaching the end of the chain, at which point
+ * it retries in the new table.
+ */
+static int rhashtable_rehash_one(struct rhashtable *ht,
+				 struct bucket_table *old_tbl,
+				 struct bucket_table *new_tbl,
+				 unsigned int old_hash)
+{
+	struct rhash_head __rcu **pprev = &old_tbl->buckets[old_hash];
+	struct rhash_head *head, *entry = NULL, *pos;
+	spinlock_t *new_bucket_lock;
+	unsigned int new_hash;
+
+	rht_for_each(pos, old_tbl, old_hash) {
+		if (entry)
+			pprev = &entry->next;
+		entry = pos;
+	}
+	if (!entry)
+		return -ENOENT;
+
+	new_hash = head_hashfn(ht, new_tbl, entry);
+
+	new_bucket_lock = bucket_lock(new_tbl, new_hash);
+
+	spin_lock_nested(new_bucket_lock, SINGLE_DEPTH_NESTING);
+	head = rht_dereference_bucket(new_tbl->buckets[new_hash],
+				      new_tbl, new_hash);
+	RCU_INIT_POINTER(entry->next, head);
+
+	rcu_assign_pointer(new_tbl->buckets[new_hash], entry);
+	spin_unlock(new_bucket_lock);
+
+	/* Unlink from the old chain only once it is reachable in the new */
+	rcu_assign_pointer(*pprev, NULL);
+
+	return 0;
+}
+
+static void rhashtable_rehash_chain(struct rhashtable *ht,
+				    struct bucket_table *old_tbl,
+				    struct bucket_table *new_tbl,
+				    unsigned int old_hash)
+{
+	spinlock_t *old_bucket_lock = bucket_lock(old_tbl, old_hash);
+
+	spin_lock_bh(old_bucket_lock);
+	while (!rhashtable_rehash_one(ht, old_tbl, new_tbl, old_hash))
+		;
+	old_tbl->rehash++;
+	spin_unlock_bh(old_bucket_lock);
+}
+
+/* Must be called with ht->mutex held and no rehash in progress. */
+static int rhashtable_rehash(struct rhashtable *ht, unsigned int size)
+{
+	struct bucket_table *old_tbl = rht_dereference(ht->tbl, ht);
+	struct bucket_table *new_tbl;
+	unsigned int old_hash;
+
+	new_tbl = bucket_table_alloc(ht, size);
+	if (new_tbl == NULL)
+		return -ENOMEM;
+
+	/*
+	 * Make insertions go into the new table for buckets that have
+	 * been moved, and lookups retry there after a miss.
+	 */
+	rcu_assign_pointer(old_tbl->future_tbl, new_tbl);
+
+	for (old_hash = 0; old_hash < old_tbl->size; old_hash++) {
+		rhashtable_rehash_chain(ht, old_tbl, new_tbl, old_hash);
+		cond_resched();
+	}
+
+	/* Publish the new table pointer. */
+	rcu_assign_pointer(ht->tbl, new_tbl);
+
+	/* Wait for readers and writers that may still use the old table. */
+	call_rcu(&old_tbl->rcu, bucket_table_free_rcu);
+
+	return 0;
+}
+
+static void rht_deferred_worker(struct work_struct *work)
+{
+	struct rhashtable *ht;
+	struct bucket_table *tbl;
+	unsigned int size = 0;
+
+	ht = container_of(work, struct rhashtable, run_work);
+	mutex_lock(&ht->mutex);
+	tbl = rht_dereference(ht->tbl, ht);
+
+	if (rht_grow_above_75(ht, tbl))
+		size = tbl->size * 2;
+	else if (rht_shrink_below_30(ht, tbl))
+		size = max_t(unsigned int,
+			     roundup_pow_of_two(atomic_read(&ht->nelems) *
+						4 / 3),
+			     ht->p.min_size);
+
+	if (size && size != tbl->size && !rhashtable_rehash(ht, size)) {
+		/*
+		 * Writers do not kick the worker while a rehash is in
+		 * progress, so look at the new table once more.
+		 */
+		tbl = rht_dereference(ht->tbl, ht);
+		if (rht_grow_above_75(ht, tbl) || rht_shrink_below_30(ht, tbl))
+			schedule_work(&ht->run_work);
+	}
+
+	mutex_unlock(&ht->mutex);
+}
+
+/*
+ * Lock the bucket that @obj hashes to in the oldest table in which that
+ * bucket has not been moved yet.  Called with rcu_read_lock held.
+ */
+static struct bucket_table *rhashtable_lock_bucket(struct rhashtable *ht,
+						   struct rhash_head *obj,
+						   unsigned int *hash)
+{
+	struct bucket_table *tbl;
+	spinlock_t *lock;
+
+	tbl = rht_dereference_rcu(ht->tbl, ht);
+	for (;;) {
+		*hash = head_hashfn(ht, tbl, obj);
+		lock = bucket_lock(tbl, *hash);
+
+		spin_lock_bh(lock);
+		if (tbl->rehash <= *hash)
+			return tbl;
+		spin_unlock_bh(lock);
+
+		tbl = rht_dereference_rcu(tbl->future_tbl, ht);
+	}
+}
+
+static bool __rhashtable_insert(struct rhashtable *ht, struct rhash_head *obj,
+				bool (*compare)(void *, void *), void *arg)
+{
+	struct bucket_table *tbl;
+	struct rhash_head *head;
+	unsigned int hash;
+	bool no_resize_running;
+	bool success = true;
+
+	rcu_read_lock();
+
+	tbl = rhashtable_lock_bucket(ht, obj, &hash);
+
+	if (compare) {
+		struct rhash_head *he;
+
+		rht_for_each(he, tbl, hash) {
+			if (compare(rht_obj(ht, he), arg)) {
+				success = false;
+				goto exit;
+			}
+		}
+	}
+
+	no_resize_running = !rcu_access_pointer(tbl->future_tbl);
+
+	head = rht_dereference_bucket(tbl->buckets[hash], tbl, hash);
+	RCU_INIT_POINTER(obj->next, head);
+
+	rcu_assign_pointer(tbl->buckets[hash], obj);
+
+	atomic_inc(&ht->nelems);
+	if (no_resize_running && rht_grow_above_75(ht, tbl))
+		schedule_work(&ht->run_work);
+
+exit:
+	spin_unlock_bh(bucket_lock(tbl, hash));
+	rcu_read_unlock();
+
+	return success;
+}
+
+/**
+ * rhashtable_insert - insert object into hash table
+ * @ht:		hash table
+ * @obj:	pointer to hash head inside object
+ *
+ * Will take a per bucket spinlock to protect against mutual mutations
+ * on the same bucket. Multiple insertions may occur in parallel unless
+ * they map to the same bucket lock.
+ *
+ * It is safe to call this function from atomic context.
+ *
+ * Will trigger an automatic deferred table resizing if the table grows
+ * beyond 75% load.
+ */
+int rhashtable_insert(struct rhashtable *ht, struct rhash_head *obj)
+{
+	__rhashtable_insert(ht, obj, NULL, NULL);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(rhashtable_insert);
+
+/**
+ * rhashtable_remove - remove object from hash table
+ * @ht:		hash table
+ * @obj:	pointer to hash head inside object
+ *
+ * Since the hash chain is single linked, the removal operation needs to
+ * walk the bucket chain upon removal. The removal operation is thus
+ * considerable slow if the hash table is not correctly sized.
+ *
+ * Will automatically shrink the table if automatic_shrinking was set
+ * in the parameters passed to rhashtable_init().
+ *
+ * The caller must ensure that no concurrent table mutations occur for
+ * the same object and must free it only after an RCU grace period.
+ * Returns true if the object was found and removed.
+ */
+bool rhashtable_remove(struct rhashtable *ht, struct rhash_head *obj)
+{
+	struct bucket_table *tbl;
+	struct rhash_head __rcu **pprev;
+	struct rhash_head *he;
+	unsigned int hash;
+	bool ret = false;
+
+	rcu_read_lock();
+
+	/* The object can only be in the table that owns its bucket */
+	tbl = rhashtable_lock_bucket(ht, obj, &hash);
+
+	pprev = &tbl->buckets[hash];
+	rht_for_each(he, tbl, hash) {
+		if (he != obj) {
+			pprev = &he->next;
+			continue;
+		}
+
+		rcu_assign_pointer(*pprev, obj->next);
+		ret = true;
+		break;
+	}
+
+	if (ret) {
+		atomic_dec(&ht->nelems);
+		if (!rcu_access_pointer(tbl->future_tbl) &&
+		    rht_shrink_below_30(ht, tbl))
+			schedule_work(&ht->run_work);
+	}
+
+	spin_unlock_bh(bucket_lock(tbl, hash));
+	rcu_read_unlock();
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(rhashtable_remove);
+
+struct rhashtable_compare_arg {
+	struct rhashtable *ht;
+	const void *key;
+};
+
+static bool rhashtable_compare(void *ptr, void *arg)
+{
+	struct rhashtable_compare_arg *x = arg;
+	struct rhashtable *ht = x->ht;
+
+	return !memcmp(ptr + ht->p.key_offset, x->key, ht->p.key_len);
+}
+
+/**
+ * rhashtable_lookup - lookup key in hash table
+ * @ht:		hash table
+ * @key:	pointer to key
+ *
+ * Computes the hash value for the key and traverses the bucket chain looking
+ * for a entry with an identical key. The first matching entry is returned.
+ *
+ * This lookup function may only be used for fixed key hash table (key_len
+ * parameter set). It will BUG() if used inappropriately.
+ *
+ * Lookups may occur in parallel with hashtable mutations and resizing.
+ * The caller must hold rcu_read_lock for as long as it uses the result.
+ */
+void *rhashtable_lookup(struct rhashtable *ht, const void *key)
+{
+	struct rhashtable_compare_arg arg = {
+		.ht = ht,
+		.key = key,
+	};
+
+	BUG_ON(!ht->p.key_len);
+
+	return rhashtable_lookup_compare(ht, key, &rhashtable_compare, &arg);
+}
+EXPORT_SYMBOL_GPL(rhashtable_lookup);
+
+/**
+ * rhashtable_lookup_compare - search hash table with compare function
+ * @ht:		hash table
+ * @key:	the pointer to the key
+ * @compare:	compare function, must return true on match
+ * @arg:	argument passed on to compare function
+ *
+ * Traverses the bucket chain behind the provided hash value and calls the
+ * specified compare function for each entry.
+ *
+ * Lookups may occur in parallel with hashtable mutations and resizing.
+ *
+ * Returns the first entry on which the compare function returned true.
+ */
+void *rhashtable_lookup_compare(struct rhashtable *ht, const void *key,
+				bool (*compare)(void *, void *), void *arg)
+{
+	const struct bucket_table *tbl;
+	struct rhash_head *he;
+	u32 hash;
+
+	rcu_read_lock();
+
+	tbl = rht_dereference_rcu(ht->tbl, ht);
+restart:
+	hash = key_hashfn(ht, tbl, key);
+	rht_for_each_rcu(he, tbl, hash) {
+		if (!compare(rht_obj(ht, he), arg))
+			continue;
+		rcu_read_unlock();
+		return rht_obj(ht, he);
+	}
+
+	/* Ensure we see any new tables. */
+	smp_rmb();
+
+	tbl = rht_dereference_rcu(tbl->future_tbl, ht);
+	if (unlikely(tbl))
+		goto restart;
+	rcu_read_unlock();
+
+	return NULL;
+}
+EXPORT_SYMBOL_GPL(rhashtable_lookup_compare);
+
+/**
+ * rhashtable_lookup_insert - lookup and insert object into hash table
+ * @ht:		hash table
+ * @obj:	pointer to hash head inside object
+ *
+ * Locks down the bucket chain in the table that currently owns the
+ * object's bucket, so the key check and the insertion are atomic with
+ * respect to other writers and to a concurrent resize.
+ *
+ * This lookup function may only be used for fixed key hash table (key_len
+ * parameter set). It will BUG() if used inappropriately.
+ *
+ * It is safe to call this function from atomic context.
+ *
+ * Returns -EEXIST if an object with the same key is already present.
+ */
+int rhashtable_lookup_insert(struct rhashtable *ht, struct rhash_head *obj)
+{
+	struct rhashtable_compare_arg arg = {
+		.ht = ht,
+		.key = rht_obj(ht, obj) + ht->p.key_offset,
+	};
+
+	BUG_ON(!ht->p.key_len);
+
+	return rhashtable_lookup_compare_insert(ht, obj, &rhashtable_compare,
+						&arg);
+}
+EXPORT_SYMBOL_GPL(rhashtable_lookup_insert);
+
+/**
+ * rhashtable_lookup_compare_insert - search and insert object to hash table
+ *                                    with compare function
+ * @ht:		hash table
+ * @obj:	pointer to hash head inside object
+ * @compare:	compare function, must return true on match
+ * @arg:	argument passed on to compare function
+ *
+ * Like rhashtable_lookup_insert() but for hash tables whose keys are not
+ * a fixed-length field of the object.
+ *
+ * Returns -EEXIST if @compare matched an object already in the table.
+ */
+int rhashtable_lookup_compare_insert(struct rhashtable *ht,
+				     struct rhash_head *obj,
+				     bool (*compare)(void *, void *),
+				     void *arg)
+{
+	BUG_ON(!ht->p.key_len && !ht->p.obj_hashfn);
+
+	return __rhashtable_insert(ht, obj, compare, arg) ? 0 : -EEXIST;
+}
+EXPORT_SYMBOL_GPL(rhashtable_lookup_compare_insert);
+
+static size_t rounded_hashtable_size(const struct rhashtable_params *params)
+{
+	return max(roundup_pow_of_two(params->nelem_hint * 4 / 3),
+		   (unsigned long)params->min_size);
+}
+
+/**
+ * rhashtable_init - initialize a new hash table
+ * @ht:		hash table to be initialized
+ * @params:	configuration parameters
+ *
+ * Initializes a new hash table based on the provided configuration
+ * parameters. A table can be configured either with a variable or
+ * fixed length key:
+ *
+ * Configuration Example 1: Fixed length keys
+ * struct test_obj {
+ *	int			key;
+ *	void *			my_member;
+ *	struct rhash_head	node;
+ * };
+ *
+ * struct rhashtable_params params = {
+ *	.head_offset = offsetof(struct test_obj, node),
+ *	.key_offset = offsetof(struct test_obj, key),
+ *	.key_len = sizeof(int),
+ *	.hashfn = jhash,
+ * };
+ *
+ * Configuration Example 2: Variable length keys
+ * struct test_obj {
+ *	[...]
+ *	struct rhash_head	node;
+ * };
+ *
+ * u32 my_hash_fn(const void *data, u32 seed)
+ * {
+ *	struct test_obj *obj = data;
+ *
+ *	return [... hash ...];
+ * }
+ *
+ * struct rhashtable_params params = {
+ *	.head_offset = offsetof(struct test_obj, node),
+ *	.hashfn = jhash,
+ *	.obj_hashfn = my_hash_fn,
+ * };
+ */
+int rhashtable_init(struct rhashtable *ht,
+		    const struct rhashtable_params *params)
+{
+	struct bucket_table *tbl;
+	size_t size;
+
+	if ((params->key_len && !params->hashfn) ||
+	    (!params->key_len && !params->obj_hashfn))
+		return -EINVAL;
+
+	memset(ht, 0, sizeof(*ht));
+	mutex_init(&ht->mutex);
+	memcpy(&ht->p, params, sizeof(*params));
+
+	if (params->min_size)
+		ht->p.min_size = roundup_pow_of_two(params->min_size);
+
+	if (params->max_size)
+		ht->p.max_size = rounddown_pow_of_two(params->max_size);
+
+	ht->p.min_size = max(ht->p.min_size, HASH_MIN_SIZE);
+
+	if (params->locks_mul)
+		ht->p.locks_mul = roundup_pow_of_two(params->locks_mul);
+	else
+		ht->p.locks_mul = BUCKET_LOCKS_PER_CPU;
+
+	size = HASH_DEFAULT_SIZE;
+	if (params->nelem_hint)
+		size = rounded_hashtable_size(&ht->p);
+
+	tbl = bucket_table_alloc(ht, size);
+	if (tbl == NULL)
+		return -ENOMEM;
+
+	atomic_set(&ht->nelems, 0);
+
+	RCU_INIT_POINTER(ht->tbl, tbl);
+
+	INIT_WORK(&ht->run_work, rht_deferred_worker);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(rhashtable_init);
+
+/**
+ * rhashtable_free_and_destroy - free elements and destroy hash table
+ * @ht:		the hash table to destroy
+ * @free_fn:	callback to release resources of element
+ * @arg:	pointer passed to free_fn
+ *
+ * Stops an eventual async resize. If defined, invokes free_fn for each
+ * element to releasal resources. Please note that RCU protected
+ * readers may still be accessing the elements. Releasing of resources
+ * must occur in a compatible manner. Then frees the bucket array.
+ *
+ * This function will eventually sleep to wait for an async resize
+ * to complete. The caller is responsible that no further write operations
+ * occurs in parallel.
+ */
+void rhashtable_free_and_destroy(struct rhashtable *ht,
+				 void (*free_fn)(void *ptr, void *arg),
+				 void *arg)
+{
+	const struct bucket_table *tbl;
+	unsigned int i;
+
+	cancel_work_sync(&ht->run_work);
+
+	mutex_lock(&ht->mutex);
+	tbl = rht_dereference(ht->tbl, ht);
+	if (free_fn) {
+		for (i = 0; i < tbl->size; i++) {
+			struct rhash_head *pos, *next;
+
+			for (pos = rht_dereference(tbl->buckets[i], ht),
+			     next = pos ? rht_dereference(pos->next, ht)
+					: NULL;
+			     pos;
+			     pos = next,
+			     next = pos ? rht_dereference(pos->next, ht)
+					: NULL)
+				free_fn(rht_obj(ht, pos), arg);
+		}
+	}
+
+	bucket_table_free(tbl);
+	mutex_unlock(&ht->mutex);
+}
+EXPORT_SYMBOL_GPL(rhashtable_free_and_destroy);
+
+/**
+ * rhashtable_destroy - destroy hash table
+ * @ht:		the hash table to destroy
+ *
+ * Frees the bucket array. This function is not rcu safe, therefore the
+ * caller has to make sure that no resizing may happen by unpublishing the
+ * hashtable and waiting for the quiescent cycle before releasing the
+ * bucket array.
+ */
+void rhashtable_destroy(struct rhashtable *ht)
+{
+	return rhashtable_free_and_destroy(ht, NULL, NULL);
+}
+EXPORT_SYMBOL_GPL(rhashtable_destroy);
@@ -16,6 +16,8 @@
 #include <linux/sysfs.h>
 #include <linux/balloon_compaction.h>
 #include <linux/page-isolation.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include "internal.h"
 
 #ifdef CONFIG_COMPACTION
@@ -222,6 +224,31 @@ static bool compact_checklock_irqsave(spinlock_t *lock, unsigned long *flags,
 	return true;
 }
 
+/* As compact_checklock_irqsave(), for the zone lock */
+static bool compact_checklock_zone_irqsave(struct zone *zone,
+					   unsigned long *flags, bool locked,
+					   struct compact_control *cc)
+{
+	if (need_resched() || numa_spin_is_contended(&zone->lock)) {
+		if (locked) {
+			numa_spin_unlock_irqrestore(&zone->lock, *flags);
+			locked = false;
+		}
+
+		/* async aborts if taking too long or contended */
+		if (cc->mode == MIGRATE_ASYNC) {
+			cc->contended = true;
+			return false;
+		}
+
+		cond_resched();
+	}
+
+	if (!locked)
+		numa_spin_lock_irqsave(&zone->lock, *flags);
+	return true;
+}
+
 /*
  * Aside from avoiding lock contention, compaction also periodically checks
  * need_resched() and either schedules in sync compaction or aborts async
@@ -302,8 +329,8 @@ static unsigned long isolate_freepages_block(struct compact_control *cc,
 		 * spin on the lock and we acquire the lock as late as
 		 * possible.
 		 */
-		locked = compact_checklock_irqsave(&cc->zone->lock, &flags,
-								locked, cc);
+		locked = compact_checklock_zone_irqsave(cc->zone, &flags,
+							locked, cc);
 		if (!locked)
 			break;
 
@@ -357,7 +384,7 @@ isolate_fail:
 		total_isolated = 0;
 
 	if (locked)
-		spin_unlock_irqrestore(&cc->zone->lock, flags);
+		numa_spin_unlock_irqrestore(&cc->zone->lock, flags);
 
 	/* Update the pageblock-skip if the whole pageblock was scanned */
 	if (blockpfn == end_pfn)
@@ -1259,6 +1286,151 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+/*
+ * kcompactd: per-node background compaction.  Every
+ * kcompactd_sleep_millisecs it looks at each zone of its node and, where
+ * compaction_suitable() says an order-kcompactd_order allocation would
+ * fail for fragmentation rather than lack of memory (the fragmentation
+ * index is above extfrag_threshold), runs async compaction on it.  Async
+ * mode backs off on lock contention and need_resched(), and the zone's
+ * deferral state is honoured, so a zone that cannot be compacted costs
+ * little more than the check.  0 disables it.
+ */
+int sysctl_kcompactd_order;
+unsigned int sysctl_kcompactd_sleep_millisecs = 500;
+
+static void kcompactd_do_work(pg_data_t *pgdat, int order)
+{
+	int zoneid;
+	struct compact_control cc = {
+		.order = order,
+		.mode = MIGRATE_ASYNC,
+	};
+
+	count_vm_event(KCOMPACTD_WAKE);
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+		int status;
+
+		if (!populated_zone(zone))
+			continue;
+
+		if (compaction_deferred(zone, order) ||
+		    compaction_suitable(zone, order) != COMPACT_CONTINUE)
+			continue;
+
+		cc.nr_freepages = 0;
+		cc.nr_migratepages = 0;
+		cc.zone = zone;
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+
+		status = compact_zone(zone, &cc);
+
+		if (zone_watermark_ok(zone, order, low_wmark_pages(zone), 0, 0))
+			compaction_defer_reset(zone, order, false);
+		else if (status == COMPACT_COMPLETE)
+			/* a full pass did not help, back off like direct compaction */
+			defer_compaction(zone, order);
+
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+
+		if (kthread_should_stop())
+			return;
+	}
+}
+
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = (pg_data_t *)p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		int order;
+
+		wait_event_freezable_timeout(pgdat->kcompactd_wait,
+			kthread_should_stop(),
+			msecs_to_jiffies(sysctl_kcompactd_sleep_millisecs));
+
+		order = ACCESS_ONCE(sysctl_kcompactd_order);
+		if (order && !kthread_should_stop())
+			kcompactd_do_work(pgdat, order);
+	}
+
+	return 0;
+}
+
+/*
+ * This kcompactd start function will be called by init and node-hot-add.
+ */
+int kcompactd_run(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	int ret = 0;
+
+	if (pgdat->kcompactd)
+		return 0;
+
+	pgdat->kcompactd = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+	if (IS_ERR(pgdat->kcompactd)) {
+		pr_err("Failed to start kcompactd on node %d\n", nid);
+		ret = PTR_ERR(pgdat->kcompactd);
+		pgdat->kcompactd = NULL;
+	}
+	return ret;
+}
+
+/*
+ * Called by memory hotplug when all memory in a node is offlined.  Caller must
+ * hold mem_hotplug_begin/end().
+ */
+void kcompactd_stop(int nid)
+{
+	struct task_struct *kcompactd = NODE_DATA(nid)->kcompactd;
+
+	if (kcompactd) {
+		kthread_stop(kcompactd);
+		NODE_DATA(nid)->kcompactd = NULL;
+	}
+}
+
+/* Let running kcompactd threads pick up new settings right away */
+int sysctl_kcompactd_handler(struct ctl_table *table, int write,
+			void __user *buffer, size_t *length, loff_t *ppos)
+{
+	int ret, nid;
+
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (ret || !write)
+		return ret;
+
+	for_each_node_state(nid, N_MEMORY)
+		wake_up_interruptible(&NODE_DATA(nid)->kcompactd_wait);
+
+	return 0;
+}
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	/* keep huge pages available for THP faults by default */
+	sysctl_kcompactd_order = HPAGE_PMD_ORDER;
+#endif
+	for_each_node_state(nid, N_MEMORY)
+		kcompactd_run(nid);
+	return 0;
+}
+module_init(kcompactd_init)
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 static ssize_t sysfs_compact_node(struct device *dev,
 			struct device_attribute *attr,
@@ -726,6 +726,41 @@ void add_page_wait_queue(struct page *page, wait_queue_t *waiter)
 }
 EXPORT_SYMBOL_GPL(add_page_wait_queue);
 
+/**
+ * wait_on_page_locked_async - arrange a callback for when a page is unlocked
+ * @page: Page to wait for
+ * @wait: Waiter whose ->func is called when @page is unlocked
+ *
+ * Add @wait to the wait queue of @page without sleeping.  The page wait
+ * queues are hashed and shared with other bits, so @wait->func has to
+ * check the &struct wait_bit_key it is passed against @page and PG_locked,
+ * and take itself off the queue with list_del_init() when it matches.
+ *
+ * Returns 0 if @wait has been queued or has already been called, or
+ * -EAGAIN if @page was not locked and @wait was not queued.
+ */
+int wait_on_page_locked_async(struct page *page, wait_queue_t *wait)
+{
+	wait_queue_head_t *q = page_waitqueue(page);
+	unsigned long flags;
+	int ret = 0;
+
+	add_page_wait_queue(page, wait);
+	/* pairs with the barrier in unlock_page() */
+	smp_mb();
+	if (PageLocked(page))
+		return 0;
+
+	spin_lock_irqsave(&q->lock, flags);
+	if (!list_empty(&wait->task_list)) {
+		__remove_wait_queue(q, wait);
+		ret = -EAGAIN;
+	}
+	spin_unlock_irqrestore(&q->lock, flags);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(wait_on_page_locked_async);
+
 /**
  * unlock_page - unlock a locked page
  * @page: the page
@@ -1436,25 +1471,74 @@ static void shrink_readahead_size_eio(struct file *filp,
 	ra->ra_pages /= 4;
 }
 
+/*
+ * Sequential reads look their pages up PAGEVEC_SIZE at a time, with one
+ * radix tree walk for each run of cached pages instead of one per page.
+ * pages[next..nr-1] hold references to the pages at index + next onwards.
+ */
+struct read_batch {
+	pgoff_t index;
+	unsigned int nr;
+	unsigned int next;
+	struct page *pages[PAGEVEC_SIZE];
+};
+
+static void read_batch_release(struct read_batch *rb)
+{
+	while (rb->next < rb->nr)
+		page_cache_release(rb->pages[rb->next++]);
+}
+
+static struct page *read_batch_get(struct address_space *mapping,
+				   struct read_batch *rb,
+				   pgoff_t index, pgoff_t last_index)
+{
+	struct page *page;
+
+	if (rb->next < rb->nr && rb->index + rb->next == index) {
+		page = rb->pages[rb->next++];
+		/* truncated since the batch was looked up? */
+		if (likely(page->mapping == mapping))
+			return page;
+		page_cache_release(page);
+	}
+
+	read_batch_release(rb);
+	rb->index = index;
+	rb->next = 0;
+	rb->nr = find_get_pages_contig(mapping, index,
+			clamp_t(pgoff_t, last_index - index, 1, PAGEVEC_SIZE),
+			rb->pages);
+	if (!rb->nr)
+		return NULL;
+	return rb->pages[rb->next++];
+}
+
 /**
  * do_generic_file_read - generic file read routine
  * @filp:	the file to read
  * @ppos:	current file position
  * @iter:	data destination
  * @written:	already copied
+ * @nowait:	don't block on page cache misses
  *
  * This is a generic file read routine, and uses the
  * mapping->a_ops->readpage() function for the actual low-level stuff.
  *
+ * With @nowait set, only pages that are already uptodate are copied.  The
+ * first page that would need I/O or the page lock kicks off readahead and
+ * ends the read with a short count, or -EAGAIN if nothing was copied.
+ *
  * This is really ugly. But the goto's actually try to clarify some
  * of the logic when it comes to error handling etc.
  */
 static ssize_t do_generic_file_read(struct file *filp, loff_t *ppos,
-		struct iov_iter *iter, ssize_t written)
+		struct iov_iter *iter, ssize_t written, bool nowait)
 {
 	struct address_space *mapping = filp->f_mapping;
 	struct inode *inode = mapping->host;
 	struct file_ra_state *ra = &filp->f_ra;
+	struct read_batch rb = { .nr = 0, .next = 0 };
 	pgoff_t index;
 	pgoff_t last_index;
 	pgoff_t prev_index;
@@ -1476,14 +1560,19 @@ static ssize_t do_generic_file_read(struct file *filp, loff_t *ppos,
 
 		cond_resched();
 find_page:
-		page = find_get_page(mapping, index);
+		page = read_batch_get(mapping, &rb, index, last_index);
 		if (!page) {
 			page_cache_sync_readahead(mapping,
 					ra, filp,
 					index, last_index - index);
-			page = find_get_page(mapping, index);
-			if (unlikely(page == NULL))
+			page = read_batch_get(mapping, &rb, index, last_index);
+			if (unlikely(page == NULL)) {
+				if (nowait) {
+					error = -EAGAIN;
+					goto out;
+				}
 				goto no_cached_page;
+			}
 		}
 		if (PageReadahead(page)) {
 			page_cache_async_readahead(mapping,
@@ -1569,6 +1658,9 @@ page_ok:
 		continue;
 
 page_not_up_to_date:
+		if (nowait)
+			goto would_block;
+
 		/* Get exclusive access to the page ... */
 		error = lock_page_killable(page);
 		if (unlikely(error))
@@ -1588,6 +1680,11 @@ page_not_up_to_date_locked:
 			goto page_ok;
 		}
 
+		if (nowait) {
+			unlock_page(page);
+			goto would_block;
+		}
+
 readpage:
 		/*
 		 * A previous I/O error may have been due to temporary
@@ -1635,6 +1732,12 @@ readpage_error:
 		page_cache_release(page);
 		goto out;
 
+would_block:
+		/* The page is under I/O; let the caller wait for it */
+		page_cache_release(page);
+		error = -EAGAIN;
+		goto out;
+
 no_cached_page:
 		/*
 		 * Ok, it wasn't cached, so we need to create a new
@@ -1659,6 +1762,7 @@ no_cached_page:
 	}
 
 out:
+	read_batch_release(&rb);
 	ra->prev_pos = prev_index;
 	ra->prev_pos <<= PAGE_CACHE_SHIFT;
 	ra->prev_pos |= prev_offset;
@@ -1720,7 +1824,8 @@ generic_file_read_iter(struct kiocb *iocb, struct iov_iter *iter)
 		}
 	}
 
-	retval = do_generic_file_read(file, ppos, iter, retval);
+	retval = do_generic_file_read(file, ppos, iter, retval,
+				      iocb->ki_flags & KIOCB_NOWAIT);
 out:
 	return retval;
 }
@@ -1797,9 +1902,15 @@ static void do_sync_mmap_readahead(struct vm_area_struct *vma,
 		return;
 
 	/*
-	 * mmap read-around
+	 * mmap read-around.  Size the window from the hit rate: every
+	 * quarter of MMAP_LOTSAMISS net misses halves it, so a file that
+	 * is faulted in mostly at random stops reading whole ra_pages
+	 * windows around each fault long before read-around is given up.
 	 */
 	ra_pages = max_sane_readahead(ra->ra_pages);
+	ra_pages >>= ra->mmap_miss / (MMAP_LOTSAMISS / 4);
+	if (!ra_pages)
+		return;
 	ra->start = max_t(long, 0, offset - ra_pages / 2);
 	ra->size = ra_pages;
 	ra->async_size = ra_pages / 4;
@@ -23,6 +23,7 @@
 #include <linux/pagemap.h>
 #include <linux/migrate.h>
 #include <linux/hashtable.h>
+#include <linux/userfaultfd_k.h>
 
 #include <asm/tlb.h>
 #include <asm/pgalloc.h>
@@ -783,6 +784,36 @@ static bool set_huge_zero_page(pgtable_t pgtable, struct mm_struct *mm,
 	return true;
 }
 
+/*
+ * Place PMD-sized private anonymous mappings on a PMD boundary, so that
+ * the whole range can be backed by huge pages from the first fault rather
+ * than losing a partial huge page at either end.  The search asks for one
+ * extra huge page of room and rounds up inside it; only virtual space is
+ * padded, nothing is mapped there.
+ */
+unsigned long thp_get_unmapped_area(struct file *filp, unsigned long addr,
+		unsigned long len, unsigned long pgoff, unsigned long flags)
+{
+	unsigned long len_pad, ret;
+
+	if (!(transparent_hugepage_flags &
+	      ((1<<TRANSPARENT_HUGEPAGE_FLAG) |
+	       (1<<TRANSPARENT_HUGEPAGE_REQ_MADV_FLAG))))
+		goto out;
+
+	len_pad = len + HPAGE_PMD_SIZE;
+	if (len_pad < len || len_pad > TASK_SIZE)
+		goto out;
+
+	ret = current->mm->get_unmapped_area(filp, 0, len_pad, pgoff, flags);
+	if (IS_ERR_VALUE(ret))
+		goto out;
+
+	return round_up(ret, HPAGE_PMD_SIZE);
+out:
+	return current->mm->get_unmapped_area(filp, addr, len, pgoff, flags);
+}
+
 int do_huge_pmd_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
 			       unsigned long address, pmd_t *pmd,
 			       unsigned int flags)
@@ -792,9 +823,12 @@ int do_huge_pmd_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
 
 	if (haddr < vma->vm_start || haddr + HPAGE_PMD_SIZE > vma->vm_end)
 		return VM_FAULT_FALLBACK;
+	/* Missing pages are resolved one at a time by userland */
+	if (userfaultfd_missing(vma))
+		return VM_FAULT_FALLBACK;
 	if (unlikely(anon_vma_prepare(vma)))
 		return VM_FAULT_OOM;
-	if (unlikely(khugepaged_enter(vma)))
+	if (unlikely(khugepaged_enter(vma, vma->vm_flags)))
 		return VM_FAULT_OOM;
 	if (!(flags & FAULT_FLAG_WRITE) &&
 			transparent_hugepage_use_zero_page()) {
@@ -1954,7 +1988,7 @@ int hugepage_madvise(struct vm_area_struct *vma,
 		 * register it here without waiting a page fault that
 		 * may not happen any time soon.
 		 */
-		if (unlikely(khugepaged_enter_vma_merge(vma)))
+		if (unlikely(khugepaged_enter_vma_merge(vma, *vm_flags)))
 			return -ENOMEM;
 		break;
 	case MADV_NOHUGEPAGE:
@@ -2055,23 +2089,29 @@ int __khugepaged_enter(struct mm_struct *mm)
 	return 0;
 }
 
-int khugepaged_enter_vma_merge(struct vm_area_struct *vma)
+int khugepaged_enter_vma_merge(struct vm_area_struct *vma,
+			       unsigned long vm_flags)
 {
 	unsigned long hstart, hend;
-	if (!vma->anon_vma)
+	if (vma->vm_ops) {
+		/*
+		 * khugepaged only works on private file mappings that
+		 * asked for it, see hugepage_vma_check().  These don't
+		 * fault huge pages in, so register them right here.
+		 */
+		if (!vma->vm_file || !(vm_flags & VM_HUGEPAGE))
+			return 0;
+	} else if (!vma->anon_vma)
 		/*
 		 * Not yet faulted in so we will register later in the
 		 * page fault if needed.
 		 */
 		return 0;
-	if (vma->vm_ops)
-		/* khugepaged not yet working on file or special mappings */
-		return 0;
-	VM_BUG_ON(vma->vm_flags & VM_NO_THP);
+	VM_BUG_ON(vm_flags & VM_NO_THP);
 	hstart = (vma->vm_start + ~HPAGE_PMD_MASK) & HPAGE_PMD_MASK;
 	hend = vma->vm_end & HPAGE_PMD_MASK;
 	if (hstart < hend)
-		return khugepaged_enter(vma);
+		return khugepaged_enter(vma, vm_flags);
 	return 0;
 }
 
@@ -2119,11 +2159,44 @@ static void release_pte_pages(pte_t *pte, pte_t *_pte)
 {
 	while (--_pte >= pte) {
 		pte_t pteval = *_pte;
-		if (!pte_none(pteval))
+		/* page cache pages are copied, they were never isolated */
+		if (!pte_none(pteval) && PageAnon(pte_page(pteval)))
 			release_pte_page(pte_page(pteval));
 	}
 }
 
+/*
+ * In a private file mapping a none pte stands for the page cache page a
+ * fault would map there.  Map it now, like a fault would, so that the
+ * copy sees it as any other file pte and the pte pins the page in the
+ * meantime.  Only uptodate, unlocked pages inside i_size qualify, and
+ * the caller holds i_mmap_mutex so truncation cannot slip in between.
+ */
+static bool khugepaged_map_file_pte(struct vm_area_struct *vma,
+				    unsigned long address, pte_t *pte)
+{
+	struct address_space *mapping = vma->vm_file->f_mapping;
+	pgoff_t pgoff = linear_page_index(vma, address);
+	struct page *page;
+
+	if (pgoff >= DIV_ROUND_UP(i_size_read(mapping->host), PAGE_CACHE_SIZE))
+		return false;
+
+	page = find_get_page(mapping, pgoff);
+	if (!page)
+		return false;
+	if (PageLocked(page) || !PageUptodate(page) ||
+	    page->mapping != mapping) {
+		page_cache_release(page);
+		return false;
+	}
+
+	page_add_file_rmap(page);
+	inc_mm_counter(vma->vm_mm, MM_FILEPAGES);
+	set_pte_at(vma->vm_mm, address, pte, mk_pte(page, vma->vm_page_prot));
+	return true;
+}
+
 static int __collapse_huge_page_isolate(struct vm_area_struct *vma,
 					unsigned long address,
 					pte_t *pte)
@@ -2135,19 +2208,38 @@ static int __collapse_huge_page_isolate(struct vm_area_struct *vma,
 	     _pte++, address += PAGE_SIZE) {
 		pte_t pteval = *_pte;
 		if (pte_none(pteval)) {
-			if (++none <= khugepaged_max_ptes_none)
-				continue;
-			else
+			/* Filling holes would hide faults from userfaultfd */
+			if (++none > khugepaged_max_ptes_none ||
+			    userfaultfd_missing(vma))
+				goto out;
+			if (vma->vm_ops &&
+			    !khugepaged_map_file_pte(vma, address, _pte))
 				goto out;
+			continue;
 		}
-		if (!pte_present(pteval) || !pte_write(pteval))
+		if (!pte_present(pteval))
 			goto out;
 		page = vm_normal_page(vma, address, pteval);
 		if (unlikely(!page))
 			goto out;
 
 		VM_BUG_ON_PAGE(PageCompound(page), page);
-		VM_BUG_ON_PAGE(!PageAnon(page), page);
+		if (!PageAnon(page)) {
+			/*
+			 * Page cache page of a private file mapping: it is
+			 * only copied, so it needs neither isolation nor
+			 * an exclusive reference.
+			 */
+			VM_BUG_ON_PAGE(!vma->vm_ops, page);
+			if (PageLocked(page) || !PageUptodate(page))
+				goto out;
+			if (pte_young(pteval) || PageReferenced(page) ||
+			    mmu_notifier_test_young(vma->vm_mm, address))
+				referenced = 1;
+			continue;
+		}
+		if (!pte_write(pteval))
+			goto out;
 		VM_BUG_ON_PAGE(!PageSwapBacked(page), page);
 
 		/* cannot use mapcount: can't collapse if there's a gup pin */
@@ -2200,10 +2292,20 @@ static void __collapse_huge_page_copy(pte_t *pte, struct page *page,
 			clear_user_highpage(page, address);
 			add_mm_counter(vma->vm_mm, MM_ANONPAGES, 1);
 		} else {
+			bool anon;
+
 			src_page = pte_page(pteval);
+			anon = PageAnon(src_page);
 			copy_user_highpage(page, src_page, address, vma);
-			VM_BUG_ON_PAGE(page_mapcount(src_page) != 1, src_page);
-			release_pte_page(src_page);
+			if (anon) {
+				VM_BUG_ON_PAGE(page_mapcount(src_page) != 1,
+					       src_page);
+				release_pte_page(src_page);
+			} else {
+				/* the private copy replaces the file page */
+				add_mm_counter(vma->vm_mm, MM_FILEPAGES, -1);
+				add_mm_counter(vma->vm_mm, MM_ANONPAGES, 1);
+			}
 			/*
 			 * ptl mostly unnecessary, but preempt has to
 			 * be disabled to update the per-cpu stats
@@ -2217,7 +2319,10 @@ static void __collapse_huge_page_copy(pte_t *pte, struct page *page,
 			pte_clear(vma->vm_mm, address, _pte);
 			page_remove_rmap(src_page);
 			spin_unlock(ptl);
-			free_page_and_swap_cache(src_page);
+			if (anon)
+				free_page_and_swap_cache(src_page);
+			else
+				page_cache_release(src_page);
 		}
 
 		address += PAGE_SIZE;
@@ -2368,7 +2473,18 @@ static bool hugepage_vma_check(struct vm_area_struct *vma)
 	    (vma->vm_flags & VM_NOHUGEPAGE))
 		return false;
 
-	if (!vma->anon_vma || vma->vm_ops)
+	if (vma->vm_ops) {
+		/*
+		 * Private file mappings are collapsed into an anonymous
+		 * huge page holding a copy of the range, as if all of it
+		 * had been COWed.  That duplicates page cache, so it is
+		 * done only on explicit MADV_HUGEPAGE.  Shared mappings
+		 * would need huge pages in the page cache itself.
+		 */
+		if (!vma->vm_file || !(vma->vm_flags & VM_HUGEPAGE) ||
+		    (vma->vm_flags & VM_NONLINEAR))
+			return false;
+	} else if (!vma->anon_vma)
 		return false;
 	if (is_vma_temporary_stack(vma))
 		return false;
@@ -2386,6 +2502,7 @@ static void collapse_huge_page(struct mm_struct *mm,
 	pte_t *pte;
 	pgtable_t pgtable;
 	struct page *new_page;
+	struct address_space *mapping = NULL;
 	spinlock_t *pmd_ptl, *pte_ptl;
 	int isolated;
 	unsigned long hstart, hend;
@@ -2420,10 +2537,23 @@ static void collapse_huge_page(struct mm_struct *mm,
 		goto out;
 	if (!hugepage_vma_check(vma))
 		goto out;
+	if (vma->vm_ops) {
+		/* the huge page is anonymous even in a file mapping */
+		if (unlikely(anon_vma_prepare(vma)))
+			goto out;
+		mapping = vma->vm_file->f_mapping;
+	}
 	pmd = mm_find_pmd(mm, address);
 	if (!pmd)
 		goto out;
 
+	/*
+	 * For file mappings, hold off truncation until the huge pmd is
+	 * in place, so that it either sees the pmd and zaps it, or has
+	 * already removed the pages we would copy beyond i_size.
+	 */
+	if (mapping)
+		mutex_lock(&mapping->i_mmap_mutex);
 	anon_vma_lock_write(vma->anon_vma);
 
 	pte = pte_offset_map(pmd, address);
@@ -2459,6 +2589,8 @@ static void collapse_huge_page(struct mm_struct *mm,
 		pmd_populate(mm, pmd, pmd_pgtable(_pmd));
 		spin_unlock(pmd_ptl);
 		anon_vma_unlock_write(vma->anon_vma);
+		if (mapping)
+			mutex_unlock(&mapping->i_mmap_mutex);
 		goto out;
 	}
 
@@ -2490,6 +2622,8 @@ static void collapse_huge_page(struct mm_struct *mm,
 	set_pmd_at(mm, address, pmd, _pmd);
 	update_mmu_cache_pmd(vma, address, pmd);
 	spin_unlock(pmd_ptl);
+	if (mapping)
+		mutex_unlock(&mapping->i_mmap_mutex);
 
 	*hpage = NULL;
 
@@ -2528,12 +2662,13 @@ static int khugepaged_scan_pmd(struct mm_struct *mm,
 	     _pte++, _address += PAGE_SIZE) {
 		pte_t pteval = *_pte;
 		if (pte_none(pteval)) {
-			if (++none <= khugepaged_max_ptes_none)
+			if (!userfaultfd_missing(vma) &&
+			    ++none <= khugepaged_max_ptes_none)
 				continue;
 			else
 				goto out_unmap;
 		}
-		if (!pte_present(pteval) || !pte_write(pteval))
+		if (!pte_present(pteval))
 			goto out_unmap;
 		page = vm_normal_page(vma, _address, pteval);
 		if (unlikely(!page))
@@ -2547,7 +2682,18 @@ static int khugepaged_scan_pmd(struct mm_struct *mm,
 		node = page_to_nid(page);
 		khugepaged_node_load[node]++;
 		VM_BUG_ON_PAGE(PageCompound(page), page);
-		if (!PageLRU(page) || PageLocked(page) || !PageAnon(page))
+		if (!PageAnon(page)) {
+			/* file page, see __collapse_huge_page_isolate() */
+			if (!vma->vm_ops || PageLocked(page))
+				goto out_unmap;
+			if (pte_young(pteval) || PageReferenced(page) ||
+			    mmu_notifier_test_young(vma->vm_mm, address))
+				referenced = 1;
+			continue;
+		}
+		if (!pte_write(pteval))
+			goto out_unmap;
+		if (!PageLRU(page) || PageLocked(page))
 			goto out_unmap;
 		/* cannot use mapcount: can't collapse if there's a gup pin */
 		if (page_count(page) != 1)
@@ -223,6 +223,18 @@ static unsigned int ksm_thread_pages_to_scan = 100;
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/* Set when ksmd should size its batches by how well scanning pays off */
+static unsigned int ksm_adaptive_scan;
+
+/* Largest batch ksmd may grow to when scanning adaptively */
+static unsigned int ksm_thread_max_pages_to_scan = 10000;
+
+/* Batch size ksmd has settled on when scanning adaptively */
+static unsigned int ksm_adaptive_pages_to_scan;
+
+/* ksm_pages_sharing when the current full scan started */
+static unsigned long ksm_scan_start_sharing;
+
 #ifdef CONFIG_NUMA
 /* Zeroed when merging across nodes is not allowed */
 static unsigned int ksm_merge_across_nodes = 1;
@@ -825,6 +837,39 @@ error:
 }
 #endif /* CONFIG_SYSFS */
 
+/*
+ * Called by ksmd at the end of each full scan.  If the scan merged more
+ * pages than it lost, double the batch so the next pass covers memory
+ * sooner; otherwise halve it back towards pages_to_scan, so that ksmd
+ * does not burn cpu on memory that has nothing left to give.
+ */
+static void ksm_adapt_scan_rate(void)
+{
+	unsigned long sharing = ksm_pages_sharing;
+	unsigned int npages;
+
+	npages = max(ksm_adaptive_pages_to_scan, ksm_thread_pages_to_scan);
+	if (sharing > ksm_scan_start_sharing) {
+		if (npages > ksm_thread_max_pages_to_scan / 2)
+			npages = ksm_thread_max_pages_to_scan;
+		else
+			npages *= 2;
+	} else {
+		npages /= 2;
+	}
+
+	ksm_adaptive_pages_to_scan = max(npages, ksm_thread_pages_to_scan);
+	ksm_scan_start_sharing = sharing;
+}
+
+static unsigned int ksm_pages_to_scan(void)
+{
+	if (ksm_adaptive_scan)
+		return max(ksm_adaptive_pages_to_scan,
+			   ksm_thread_pages_to_scan);
+	return ksm_thread_pages_to_scan;
+}
+
 static u32 calc_checksum(struct page *page)
 {
 	u32 checksum;
@@ -1683,6 +1728,7 @@ next_mm:
 		goto next_mm;
 
 	ksm_scan.seqnr++;
+	ksm_adapt_scan_rate();
 	return NULL;
 }
 
@@ -1719,7 +1765,7 @@ static int ksm_scan_thread(void *nothing)
 		mutex_lock(&ksm_thread_mutex);
 		wait_while_offlining();
 		if (ksmd_should_run())
-			ksm_do_scan(ksm_thread_pages_to_scan);
+			ksm_do_scan(ksm_pages_to_scan());
 		mutex_unlock(&ksm_thread_mutex);
 
 		try_to_freeze();
@@ -2133,6 +2179,60 @@ static ssize_t pages_to_scan_store(struct kobject *kobj,
 }
 KSM_ATTR(pages_to_scan);
 
+static ssize_t adaptive_scan_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_adaptive_scan);
+}
+
+static ssize_t adaptive_scan_store(struct kobject *kobj,
+				   struct kobj_attribute *attr,
+				   const char *buf, size_t count)
+{
+	int err;
+	unsigned long knob;
+
+	err = kstrtoul(buf, 10, &knob);
+	if (err || knob > 1)
+		return -EINVAL;
+
+	mutex_lock(&ksm_thread_mutex);
+	ksm_adaptive_scan = knob;
+	ksm_adaptive_pages_to_scan = ksm_thread_pages_to_scan;
+	ksm_scan_start_sharing = ksm_pages_sharing;
+	mutex_unlock(&ksm_thread_mutex);
+
+	return count;
+}
+KSM_ATTR(adaptive_scan);
+
+static ssize_t max_pages_to_scan_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_thread_max_pages_to_scan);
+}
+
+static ssize_t max_pages_to_scan_store(struct kobject *kobj,
+				       struct kobj_attribute *attr,
+				       const char *buf, size_t count)
+{
+	int err;
+	unsigned long nr_pages;
+
+	err = kstrtoul(buf, 10, &nr_pages);
+	if (err || nr_pages > UINT_MAX)
+		return -EINVAL;
+
+	mutex_lock(&ksm_thread_mutex);
+	ksm_thread_max_pages_to_scan = nr_pages;
+	ksm_adaptive_pages_to_scan = min(ksm_adaptive_pages_to_scan,
+					 ksm_thread_max_pages_to_scan);
+	mutex_unlock(&ksm_thread_mutex);
+
+	return count;
+}
+KSM_ATTR(max_pages_to_scan);
+
 static ssize_t run_show(struct kobject *kobj, struct kobj_attribute *attr,
 			char *buf)
 {
@@ -2287,6 +2387,8 @@ KSM_ATTR_RO(full_scans);
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
+	&adaptive_scan_attr.attr,
+	&max_pages_to_scan_attr.attr,
 	&run_attr.attr,
 	&pages_shared_attr.attr,
 	&pages_sharing_attr.attr,
@@ -9,16 +9,73 @@
 #include <linux/mm.h>
 #include <linux/list_lru.h>
 #include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/memcontrol.h>
+
+#ifdef CONFIG_MEMCG_KMEM
+/* memcg aware lrus and the number of per memcg lists each of them has */
+static LIST_HEAD(list_lrus);
+static DEFINE_MUTEX(list_lrus_mutex);
+static int list_lrus_memcg_size;
+
+static inline bool list_lru_memcg_aware(struct list_lru *lru)
+{
+	return lru->memcg_aware;
+}
+
+static inline struct list_lru_one *
+list_lru_from_memcg_idx(struct list_lru_node *nlru, int idx)
+{
+	/*
+	 * The per memcg lists are only ever replaced under nlru->lock, and
+	 * they are grown before a cgroup is given its id, so there is no
+	 * need for the caller to check the index.
+	 */
+	if (idx < 0 || WARN_ON_ONCE(idx >= nlru->memcg_nr_lrus))
+		return &nlru->lru;
+	return nlru->memcg_lrus[idx];
+}
+
+static inline struct list_lru_one *
+list_lru_from_kmem(struct list_lru *lru, struct list_lru_node *nlru,
+		   void *ptr)
+{
+	if (!list_lru_memcg_aware(lru) || !memcg_kmem_enabled())
+		return &nlru->lru;
+	return list_lru_from_memcg_idx(nlru, memcg_kmem_obj_cache_id(ptr));
+}
+#else
+static inline bool list_lru_memcg_aware(struct list_lru *lru)
+{
+	return false;
+}
+
+static inline struct list_lru_one *
+list_lru_from_memcg_idx(struct list_lru_node *nlru, int idx)
+{
+	return &nlru->lru;
+}
+
+static inline struct list_lru_one *
+list_lru_from_kmem(struct list_lru *lru, struct list_lru_node *nlru,
+		   void *ptr)
+{
+	return &nlru->lru;
+}
+#endif /* CONFIG_MEMCG_KMEM */
 
 bool list_lru_add(struct list_lru *lru, struct list_head *item)
 {
 	int nid = page_to_nid(virt_to_page(item));
 	struct list_lru_node *nlru = &lru->node[nid];
+	struct list_lru_one *l;
 
 	spin_lock(&nlru->lock);
 	WARN_ON_ONCE(nlru->nr_items < 0);
 	if (list_empty(item)) {
-		list_add_tail(item, &nlru->list);
+		l = list_lru_from_kmem(lru, nlru, item);
+		list_add_tail(item, &l->list);
+		l->nr_items++;
 		if (nlru->nr_items++ == 0)
 			node_set(nid, lru->active_nodes);
 		spin_unlock(&nlru->lock);
@@ -33,10 +90,13 @@ bool list_lru_del(struct list_lru *lru, struct list_head *item)
 {
 	int nid = page_to_nid(virt_to_page(item));
 	struct list_lru_node *nlru = &lru->node[nid];
+	struct list_lru_one *l;
 
 	spin_lock(&nlru->lock);
 	if (!list_empty(item)) {
+		l = list_lru_from_kmem(lru, nlru, item);
 		list_del_init(item);
+		l->nr_items--;
 		if (--nlru->nr_items == 0)
 			node_clear(nid, lru->active_nodes);
 		WARN_ON_ONCE(nlru->nr_items < 0);
@@ -63,18 +123,43 @@ list_lru_count_node(struct list_lru *lru, int nid)
 }
 EXPORT_SYMBOL_GPL(list_lru_count_node);
 
-unsigned long
-list_lru_walk_node(struct list_lru *lru, int nid, list_lru_walk_cb isolate,
-		   void *cb_arg, unsigned long *nr_to_walk)
+unsigned long list_lru_count_one(struct list_lru *lru, int nid,
+				 struct mem_cgroup *memcg)
+{
+	struct list_lru_node *nlru = &lru->node[nid];
+	int idx = memcg_cache_id(memcg);
+	struct list_lru_one *l;
+	unsigned long count;
+
+	/* a cgroup that is not kmem limited has no objects of its own */
+	if (!list_lru_memcg_aware(lru) || (memcg && idx < 0))
+		return memcg ? 0 : list_lru_count_node(lru, nid);
+
+	spin_lock(&nlru->lock);
+	l = list_lru_from_memcg_idx(nlru, idx);
+	WARN_ON_ONCE(l->nr_items < 0);
+	count = l->nr_items;
+	spin_unlock(&nlru->lock);
+
+	return count;
+}
+EXPORT_SYMBOL_GPL(list_lru_count_one);
+
+static unsigned long
+__list_lru_walk_one(struct list_lru *lru, int nid, int memcg_idx,
+		    list_lru_walk_cb isolate, void *cb_arg,
+		    unsigned long *nr_to_walk)
 {
 
 	struct list_lru_node	*nlru = &lru->node[nid];
+	struct list_lru_one *l;
 	struct list_head *item, *n;
 	unsigned long isolated = 0;
 
 	spin_lock(&nlru->lock);
+	l = list_lru_from_memcg_idx(nlru, memcg_idx);
 restart:
-	list_for_each_safe(item, n, &nlru->list) {
+	list_for_each_safe(item, n, &l->list) {
 		enum lru_status ret;
 
 		/*
@@ -90,6 +175,7 @@ restart:
 		case LRU_REMOVED_RETRY:
 			assert_spin_locked(&nlru->lock);
 		case LRU_REMOVED:
+			l->nr_items--;
 			if (--nlru->nr_items == 0)
 				node_clear(nid, lru->active_nodes);
 			WARN_ON_ONCE(nlru->nr_items < 0);
@@ -103,7 +189,7 @@ restart:
 				goto restart;
 			break;
 		case LRU_ROTATE:
-			list_move_tail(item, &nlru->list);
+			list_move_tail(item, &l->list);
 			break;
 		case LRU_SKIP:
 			break;
@@ -122,11 +208,202 @@ restart:
 	spin_unlock(&nlru->lock);
 	return isolated;
 }
+
+unsigned long
+list_lru_walk_one(struct list_lru *lru, int nid, struct mem_cgroup *memcg,
+		  list_lru_walk_cb isolate, void *cb_arg,
+		  unsigned long *nr_to_walk)
+{
+	int idx = memcg_cache_id(memcg);
+
+	if (!list_lru_memcg_aware(lru) || (memcg && idx < 0))
+		return memcg ? 0 : list_lru_walk_node(lru, nid, isolate,
+						      cb_arg, nr_to_walk);
+
+	return __list_lru_walk_one(lru, nid, idx, isolate, cb_arg,
+				   nr_to_walk);
+}
+EXPORT_SYMBOL_GPL(list_lru_walk_one);
+
+unsigned long
+list_lru_walk_node(struct list_lru *lru, int nid, list_lru_walk_cb isolate,
+		   void *cb_arg, unsigned long *nr_to_walk)
+{
+	unsigned long isolated;
+#ifdef CONFIG_MEMCG_KMEM
+	int idx;
+#endif
+
+	isolated = __list_lru_walk_one(lru, nid, -1, isolate, cb_arg,
+				       nr_to_walk);
+#ifdef CONFIG_MEMCG_KMEM
+	/* the per memcg lists only ever grow, new ones are empty anyway */
+	for (idx = 0; idx < ACCESS_ONCE(lru->node[nid].memcg_nr_lrus); idx++) {
+		if (!*nr_to_walk)
+			break;
+		isolated += __list_lru_walk_one(lru, nid, idx, isolate,
+						cb_arg, nr_to_walk);
+	}
+#endif
+	return isolated;
+}
 EXPORT_SYMBOL_GPL(list_lru_walk_node);
 
-int list_lru_init_key(struct list_lru *lru, struct lock_class_key *key)
+static void init_one_lru(struct list_lru_one *l)
+{
+	INIT_LIST_HEAD(&l->list);
+	l->nr_items = 0;
+}
+
+#ifdef CONFIG_MEMCG_KMEM
+static void __memcg_destroy_list_lru_node(struct list_lru_one **lrus,
+					  int begin, int end)
 {
 	int i;
+
+	for (i = begin; i < end; i++)
+		kfree(lrus[i]);
+}
+
+/*
+ * Grows the per memcg lists of @nlru to @size, existing lists keep their
+ * items.  Called with list_lrus_mutex held.
+ */
+static int memcg_update_list_lru_node(struct list_lru_node *nlru, int size)
+{
+	struct list_lru_one **old, **new;
+	int old_size = nlru->memcg_nr_lrus;
+	int i;
+
+	if (size <= old_size)
+		return 0;
+
+	new = kmalloc(size * sizeof(*new), GFP_KERNEL);
+	if (!new)
+		return -ENOMEM;
+
+	for (i = old_size; i < size; i++) {
+		new[i] = kmalloc(sizeof(**new), GFP_KERNEL);
+		if (!new[i]) {
+			__memcg_destroy_list_lru_node(new, old_size, i);
+			kfree(new);
+			return -ENOMEM;
+		}
+		init_one_lru(new[i]);
+	}
+
+	spin_lock(&nlru->lock);
+	old = nlru->memcg_lrus;
+	if (old_size)
+		memcpy(new, old, old_size * sizeof(*new));
+	nlru->memcg_lrus = new;
+	nlru->memcg_nr_lrus = size;
+	spin_unlock(&nlru->lock);
+
+	kfree(old);
+	return 0;
+}
+
+static void memcg_destroy_list_lru_node(struct list_lru_node *nlru)
+{
+	__memcg_destroy_list_lru_node(nlru->memcg_lrus, 0,
+				      nlru->memcg_nr_lrus);
+	kfree(nlru->memcg_lrus);
+}
+
+static int memcg_update_list_lru(struct list_lru *lru, int size)
+{
+	int i, err;
+
+	for (i = 0; i < nr_node_ids; i++) {
+		err = memcg_update_list_lru_node(&lru->node[i], size);
+		if (err)
+			return err;
+	}
+	return 0;
+}
+
+/*
+ * Makes room for the lists of memory cgroup ids below @num_memcgs in all
+ * the memcg aware lrus.  Must be called before a cgroup id is handed out.
+ */
+int memcg_update_all_list_lrus(int num_memcgs)
+{
+	struct list_lru *lru;
+	int size, err = 0;
+
+	mutex_lock(&list_lrus_mutex);
+	if (num_memcgs <= list_lrus_memcg_size)
+		goto out;
+
+	size = max(num_memcgs, 2 * list_lrus_memcg_size);
+	list_for_each_entry(lru, &list_lrus, list) {
+		err = memcg_update_list_lru(lru, size);
+		if (err)
+			goto out;
+	}
+	list_lrus_memcg_size = size;
+out:
+	mutex_unlock(&list_lrus_mutex);
+	return err;
+}
+
+static int memcg_init_list_lru(struct list_lru *lru, bool memcg_aware)
+{
+	int i, err = 0;
+
+	lru->memcg_aware = memcg_aware;
+	for (i = 0; i < nr_node_ids; i++) {
+		lru->node[i].memcg_lrus = NULL;
+		lru->node[i].memcg_nr_lrus = 0;
+	}
+	if (!memcg_aware)
+		return 0;
+
+	mutex_lock(&list_lrus_mutex);
+	if (list_lrus_memcg_size)
+		err = memcg_update_list_lru(lru, list_lrus_memcg_size);
+	if (!err)
+		list_add(&lru->list, &list_lrus);
+	mutex_unlock(&list_lrus_mutex);
+
+	if (err) {
+		for (i = 0; i < nr_node_ids; i++)
+			memcg_destroy_list_lru_node(&lru->node[i]);
+		lru->memcg_aware = false;
+	}
+	return err;
+}
+
+static void memcg_destroy_list_lru(struct list_lru *lru)
+{
+	int i;
+
+	if (!list_lru_memcg_aware(lru))
+		return;
+
+	mutex_lock(&list_lrus_mutex);
+	list_del(&lru->list);
+	mutex_unlock(&list_lrus_mutex);
+
+	for (i = 0; i < nr_node_ids; i++)
+		memcg_destroy_list_lru_node(&lru->node[i]);
+}
+#else
+static int memcg_init_list_lru(struct list_lru *lru, bool memcg_aware)
+{
+	return 0;
+}
+
+static void memcg_destroy_list_lru(struct list_lru *lru)
+{
+}
+#endif /* CONFIG_MEMCG_KMEM */
+
+int __list_lru_init(struct list_lru *lru, bool memcg_aware,
+		    struct lock_class_key *key)
+{
+	int i, err;
 	size_t size = sizeof(*lru->node) * nr_node_ids;
 
 	lru->node = kzalloc(size, GFP_KERNEL);
@@ -138,15 +415,23 @@ int list_lru_init_key(struct list_lru *lru, struct lock_class_key *key)
 		spin_lock_init(&lru->node[i].lock);
 		if (key)
 			lockdep_set_class(&lru->node[i].lock, key);
-		INIT_LIST_HEAD(&lru->node[i].list);
+		init_one_lru(&lru->node[i].lru);
 		lru->node[i].nr_items = 0;
 	}
+
+	err = memcg_init_list_lru(lru, memcg_aware);
+	if (err) {
+		kfree(lru->node);
+		lru->node = NULL;
+		return err;
+	}
 	return 0;
 }
-EXPORT_SYMBOL_GPL(list_lru_init_key);
+EXPORT_SYMBOL_GPL(__list_lru_init);
 
 void list_lru_destroy(struct list_lru *lru)
 {
+	memcg_destroy_list_lru(lru);
 	kfree(lru->node);
 }
 EXPORT_SYMBOL_GPL(list_lru_destroy);
@@ -56,6 +56,7 @@
 #include <linux/oom.h>
 #include <linux/lockdep.h>
 #include <linux/file.h>
+#include <linux/list_lru.h>
 #include "internal.h"
 #include <net/sock.h>
 #include <net/ip.h>
@@ -318,6 +319,15 @@ struct mem_cgroup {
 	/* set when res.limit == memsw.limit */
 	bool		memsw_is_minimum;
 
+	/*
+	 * Background reclaim watermarks, in bytes.  Once usage rises
+	 * above high_wmark, wmark_work reclaims from this memcg until
+	 * usage drops to low_wmark again.
+	 */
+	unsigned long long high_wmark;
+	unsigned long long low_wmark;
+	struct work_struct wmark_work;
+
 	/* protect arrays of thresholds */
 	struct mutex thresholds_lock;
 
@@ -2625,6 +2635,55 @@ static int mem_cgroup_do_charge(struct mem_cgroup *memcg, gfp_t gfp_mask,
 	return CHARGE_NOMEM;
 }
 
+static struct workqueue_struct *memcg_wmark_wq;
+
+/* reclaim rounds per work invocation before yielding to other memcgs */
+#define MEM_CGROUP_WMARK_BATCH	32
+
+static unsigned long long mem_cgroup_wmark_target(struct mem_cgroup *memcg)
+{
+	return min(ACCESS_ONCE(memcg->low_wmark), ACCESS_ONCE(memcg->high_wmark));
+}
+
+static void mem_cgroup_wmark_work_fn(struct work_struct *work)
+{
+	struct mem_cgroup *memcg = container_of(work, struct mem_cgroup,
+						wmark_work);
+	int nr_retries = MEM_CGROUP_RECLAIM_RETRIES;
+	int nr_rounds = MEM_CGROUP_WMARK_BATCH;
+
+	while (res_counter_read_u64(&memcg->res, RES_USAGE) >
+	       mem_cgroup_wmark_target(memcg)) {
+		if (!try_to_free_mem_cgroup_pages(memcg, GFP_KERNEL,
+						  memcg->memsw_is_minimum) &&
+		    !--nr_retries)
+			return;
+		/*
+		 * Still above the low watermark after a full batch: requeue
+		 * rather than hog the worker while chargers keep refilling.
+		 */
+		if (!--nr_rounds) {
+			queue_work(memcg_wmark_wq, &memcg->wmark_work);
+			return;
+		}
+		cond_resched();
+	}
+}
+
+/*
+ * Kick background reclaim for @memcg and every hierarchical parent whose
+ * usage went above its high watermark.  Called after a res_counter charge,
+ * so the per-cpu stock fast path never gets here.
+ */
+static void mem_cgroup_check_wmark(struct mem_cgroup *memcg)
+{
+	for (; memcg; memcg = parent_mem_cgroup(memcg)) {
+		if (res_counter_read_u64(&memcg->res, RES_USAGE) >
+		    ACCESS_ONCE(memcg->high_wmark))
+			queue_work(memcg_wmark_wq, &memcg->wmark_work);
+	}
+}
+
 /**
  * mem_cgroup_try_charge - try charging a memcg
  * @memcg: memcg to charge
@@ -2690,6 +2749,8 @@ again:
 		}
 	} while (ret != CHARGE_OK);
 
+	mem_cgroup_check_wmark(memcg);
+
 	if (batch > nr_pages)
 		refill_stock(memcg, batch - nr_pages);
 done:
@@ -2998,6 +3059,23 @@ int memcg_cache_id(struct mem_cgroup *memcg)
 	return memcg ? memcg->kmemcg_id : -1;
 }
 
+/*
+ * Returns the index of the memcg the slab object @ptr is accounted to, or -1
+ * if it was allocated from a root cache.
+ */
+int memcg_kmem_obj_cache_id(void *ptr)
+{
+	struct page *page = virt_to_head_page(ptr);
+	struct kmem_cache *s;
+
+	if (!PageSlab(page))
+		return -1;
+	s = page->slab_cache;
+	if (is_root_cache(s))
+		return -1;
+	return memcg_cache_id(s->memcg_params->memcg);
+}
+
 static size_t memcg_caches_array_size(int num_groups)
 {
 	ssize_t size;
@@ -4945,6 +5023,11 @@ static int __memcg_activate_kmem(struct mem_cgroup *memcg,
 	if (err)
 		goto out_rmid;
 
+	/* Same for the per cgroup lists of the memcg aware list_lrus. */
+	err = memcg_update_all_list_lrus(memcg_id + 1);
+	if (err)
+		goto out_rmid;
+
 	memcg->kmemcg_id = memcg_id;
 	INIT_LIST_HEAD(&memcg->memcg_slab_caches);
 
@@ -5077,6 +5160,45 @@ static ssize_t mem_cgroup_write(struct kernfs_open_file *of,
 	return ret ?: nbytes;
 }
 
+enum {
+	WMARK_HIGH,
+	WMARK_LOW,
+};
+
+static u64 mem_cgroup_wmark_read(struct cgroup_subsys_state *css,
+				 struct cftype *cft)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(css);
+
+	if (cft->private == WMARK_HIGH)
+		return memcg->high_wmark;
+	return memcg->low_wmark;
+}
+
+static ssize_t mem_cgroup_wmark_write(struct kernfs_open_file *of,
+				      char *buf, size_t nbytes, loff_t off)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(of_css(of));
+	unsigned long long val;
+	int ret;
+
+	if (mem_cgroup_is_root(memcg))
+		return -EINVAL;
+
+	ret = res_counter_memparse_write_strategy(strstrip(buf), &val);
+	if (ret)
+		return ret;
+
+	if (of_cft(of)->private == WMARK_HIGH)
+		memcg->high_wmark = val;
+	else
+		memcg->low_wmark = val;
+
+	/* catch up with a group that is already above the new mark */
+	mem_cgroup_check_wmark(memcg);
+	return nbytes;
+}
+
 static void memcg_get_hierarchical_limit(struct mem_cgroup *memcg,
 		unsigned long long *mem_limit, unsigned long long *memsw_limit)
 {
@@ -5997,6 +6119,20 @@ static struct cftype mem_cgroup_files[] = {
 		.write = mem_cgroup_reset,
 		.read_u64 = mem_cgroup_read_u64,
 	},
+	{
+		.name = "high_wmark_in_bytes",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.private = WMARK_HIGH,
+		.write = mem_cgroup_wmark_write,
+		.read_u64 = mem_cgroup_wmark_read,
+	},
+	{
+		.name = "low_wmark_in_bytes",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.private = WMARK_LOW,
+		.write = mem_cgroup_wmark_write,
+		.read_u64 = mem_cgroup_wmark_read,
+	},
 	{
 		.name = "stat",
 		.seq_show = memcg_stat_show,
@@ -6264,6 +6400,9 @@ mem_cgroup_css_alloc(struct cgroup_subsys_state *parent_css)
 	vmpressure_init(&memcg->vmpressure);
 	INIT_LIST_HEAD(&memcg->event_list);
 	spin_lock_init(&memcg->event_list_lock);
+	memcg->high_wmark = RES_COUNTER_MAX;
+	memcg->low_wmark = RES_COUNTER_MAX;
+	INIT_WORK(&memcg->wmark_work, mem_cgroup_wmark_work_fn);
 
 	return &memcg->css;
 
@@ -6365,6 +6504,10 @@ static void mem_cgroup_css_offline(struct cgroup_subsys_state *css)
 
 	memcg_unregister_all_caches(memcg);
 	vmpressure_cleanup(&memcg->vmpressure);
+
+	/* nothing left to reclaim once the charges are reparented */
+	memcg->high_wmark = RES_COUNTER_MAX;
+	cancel_work_sync(&memcg->wmark_work);
 }
 
 static void mem_cgroup_css_free(struct cgroup_subsys_state *css)
@@ -7076,6 +7219,9 @@ static int __init mem_cgroup_init(void)
 	enable_swap_cgroup();
 	mem_cgroup_soft_limit_tree_init();
 	memcg_stock_init();
+	memcg_wmark_wq = alloc_workqueue("memcg_wmark",
+					 WQ_UNBOUND | WQ_MEM_RECLAIM, 0);
+	BUG_ON(!memcg_wmark_wq);
 	return 0;
 }
 subsys_initcall(mem_cgroup_init);
@@ -61,6 +61,7 @@
 #include <linux/string.h>
 #include <linux/dma-debug.h>
 #include <linux/debugfs.h>
+#include <linux/userfaultfd_k.h>
 
 #include <asm/io.h>
 #include <asm/pgalloc.h>
@@ -854,9 +855,12 @@ copy_one_pte(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 
 	/*
 	 * If it's a COW mapping, write protect it both
-	 * in the parent and the child
+	 * in the parent and the child.  Ptes left read-only by an
+	 * earlier fork need not be touched again: the atomic update
+	 * of the parent's pte dominates the copy of untouched memory
+	 * when a large process forks repeatedly.
 	 */
-	if (is_cow_mapping(vm_flags)) {
+	if (is_cow_mapping(vm_flags) && pte_write(pte)) {
 		ptep_set_wrprotect(src_mm, addr, src_pte);
 		pte = pte_wrprotect(pte);
 	}
@@ -967,8 +971,11 @@ static inline int copy_pmd_range(struct mm_struct *dst_mm, struct mm_struct *src
 					    dst_pmd, src_pmd, addr, vma);
 			if (err == -ENOMEM)
 				return -ENOMEM;
-			if (!err)
+			if (!err) {
+				/* copy_pte_range() does this per table */
+				cond_resched();
 				continue;
+			}
 			/* fall through */
 		}
 		if (pmd_none_or_clear_bad(src_pmd))
@@ -1087,6 +1094,7 @@ again:
 	init_rss_vec(rss);
 	start_pte = pte_offset_map_lock(mm, pmd, addr, &ptl);
 	pte = start_pte;
+	flush_tlb_batched_pending(mm);
 	arch_enter_lazy_mmu_mode();
 	do {
 		pte_t ptent = *pte;
@@ -2430,10 +2438,10 @@ static int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		goto out;
 	}
 	delayacct_set_flag(DELAYACCT_PF_SWAPIN);
-	page = lookup_swap_cache(entry);
+	page = lookup_swap_cache(entry, vma, address);
 	if (!page) {
-		page = swapin_readahead(entry,
-					GFP_HIGHUSER_MOVABLE, vma, address);
+		page = swap_vma_readahead(entry,
+					  GFP_HIGHUSER_MOVABLE, vma, address);
 		if (!page) {
 			/*
 			 * Back out if somebody else faulted in this pte
@@ -2620,6 +2628,87 @@ static inline int check_stack_guard_page(struct vm_area_struct *vma, unsigned lo
  * but allow concurrent faults), and pte mapped but not yet locked.
  * We return with mmap_sem still held, but pte unmapped and unlocked.
  */
+/*
+ * Anonymous fault-around, for areas marked with MADV_FAULTAROUND.  A write
+ * fault just after the previous page was touched, with the next one still
+ * unmapped, looks like sequential first touch of fresh memory: allocate
+ * and map zeroed pages for the next ANON_FAULT_AROUND_PAGES addresses in
+ * one go instead of taking a fault for each.
+ */
+#define ANON_FAULT_AROUND_PAGES	16
+
+/* Called with the pte lock held; the neighbours share @page_table's page */
+static inline bool anon_fault_around_wanted(struct vm_area_struct *vma,
+		unsigned long address, pte_t *page_table)
+{
+	if (address == vma->vm_start || !(address & ~PMD_MASK))
+		return false;
+	if (address + PAGE_SIZE >= vma->vm_end ||
+	    !((address + PAGE_SIZE) & ~PMD_MASK))
+		return false;
+	return !pte_none(page_table[-1]) && pte_none(page_table[1]);
+}
+
+static void do_anon_fault_around(struct mm_struct *mm,
+		struct vm_area_struct *vma, unsigned long address, pmd_t *pmd)
+{
+	struct page *pages[ANON_FAULT_AROUND_PAGES];
+	unsigned long start, end, addr;
+	spinlock_t *ptl;
+	pte_t *pte, entry;
+	int nr = 0, i;
+
+	start = address + PAGE_SIZE;
+	end = min3(vma->vm_end, (address & PMD_MASK) + PMD_SIZE,
+		   start + ANON_FAULT_AROUND_PAGES * PAGE_SIZE);
+
+	/*
+	 * Allocate and zero outside the page table lock.  This is only
+	 * speculative, so stop at the first allocation or charge failure
+	 * rather than pushing the system towards OOM.
+	 */
+	for (addr = start; addr < end; addr += PAGE_SIZE) {
+		struct page *page;
+
+		page = alloc_page_vma(GFP_HIGHUSER_MOVABLE | __GFP_NORETRY |
+				      __GFP_NOWARN, vma, addr);
+		if (!page)
+			break;
+		clear_user_highpage(page, addr);
+		if (mem_cgroup_charge_anon(page, mm, GFP_KERNEL)) {
+			page_cache_release(page);
+			break;
+		}
+		__SetPageUptodate(page);
+		pages[nr++] = page;
+	}
+	if (!nr)
+		return;
+
+	pte = pte_offset_map_lock(mm, pmd, start, &ptl);
+	for (i = 0, addr = start; i < nr; i++, addr += PAGE_SIZE) {
+		if (!pte_none(pte[i]))
+			continue;
+		entry = mk_pte(pages[i], vma->vm_page_prot);
+		if (vma->vm_flags & VM_WRITE)
+			entry = pte_mkwrite(pte_mkdirty(entry));
+		inc_mm_counter_fast(mm, MM_ANONPAGES);
+		page_add_new_anon_rmap(pages[i], vma, addr);
+		set_pte_at(mm, addr, pte + i, entry);
+		update_mmu_cache(vma, addr, pte + i);
+		pages[i] = NULL;
+	}
+	pte_unmap_unlock(pte, ptl);
+
+	/* Someone else faulted these in meanwhile */
+	for (i = 0; i < nr; i++) {
+		if (!pages[i])
+			continue;
+		mem_cgroup_uncharge_page(pages[i]);
+		page_cache_release(pages[i]);
+	}
+}
+
 static int do_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		unsigned long address, pte_t *page_table, pmd_t *pmd,
 		unsigned int flags)
@@ -2627,6 +2716,7 @@ static int do_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	struct page *page;
 	spinlock_t *ptl;
 	pte_t entry;
+	bool fault_around = false;
 
 	pte_unmap(page_table);
 
@@ -2641,6 +2731,12 @@ static int do_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		page_table = pte_offset_map_lock(mm, pmd, address, &ptl);
 		if (!pte_none(*page_table))
 			goto unlock;
+		/* Deliver the page fault to userland, check inside PT lock */
+		if (userfaultfd_missing(vma)) {
+			pte_unmap_unlock(page_table, ptl);
+			return handle_userfault(vma, address, flags,
+						VM_UFFD_MISSING);
+		}
 		goto setpte;
 	}
 
@@ -2668,8 +2764,19 @@ static int do_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	if (!pte_none(*page_table))
 		goto release;
 
+	/* Deliver the page fault to userland, check inside PT lock */
+	if (userfaultfd_missing(vma)) {
+		pte_unmap_unlock(page_table, ptl);
+		mem_cgroup_uncharge_page(page);
+		page_cache_release(page);
+		return handle_userfault(vma, address, flags, VM_UFFD_MISSING);
+	}
+
 	inc_mm_counter_fast(mm, MM_ANONPAGES);
 	page_add_new_anon_rmap(page, vma, address);
+	if (vma->vm_flags & VM_FAULTAROUND)
+		fault_around = anon_fault_around_wanted(vma, address,
+							page_table);
 setpte:
 	set_pte_at(mm, address, page_table, entry);
 
@@ -2677,6 +2784,8 @@ setpte:
 	update_mmu_cache(vma, address, page_table);
 unlock:
 	pte_unmap_unlock(page_table, ptl);
+	if (fault_around)
+		do_anon_fault_around(mm, vma, address, pmd);
 	return 0;
 release:
 	mem_cgroup_uncharge_page(page);
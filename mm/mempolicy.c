@@ -770,7 +770,7 @@ static int mbind_range(struct mm_struct *mm, unsigned long start,
 			((vmstart - vma->vm_start) >> PAGE_SHIFT);
 		prev = vma_merge(mm, prev, vmstart, vmend, vma->vm_flags,
 				  vma->anon_vma, vma->vm_file, pgoff,
-				  new_pol);
+				  new_pol, vma->vm_userfaultfd_ctx);
 		if (prev) {
 			vma = prev;
 			next = vma->vm_next;
@@ -1673,6 +1673,31 @@ bool vma_policy_mof(struct task_struct *task, struct vm_area_struct *vma)
 	return pol->flags & MPOL_F_MOF;
 }
 
+/*
+ * Unlike vma_policy_mof(), only report migrate-on-fault if the mapping
+ * itself asked for it with mbind(MPOL_MF_LAZY), not if it was inherited
+ * from the task or the system default. NUMA balancing uses this to decide
+ * whether shared page cache that is normally left to be cache replicated
+ * should be sampled and migrated towards the nodes that use it.
+ */
+bool vma_policy_mof_explicit(struct vm_area_struct *vma)
+{
+	struct mempolicy *pol;
+	bool ret = false;
+
+	if (vma->vm_ops && vma->vm_ops->get_policy) {
+		pol = vma->vm_ops->get_policy(vma, vma->vm_start);
+		if (pol && (pol->flags & MPOL_F_MOF))
+			ret = true;
+		mpol_cond_put(pol);
+
+		return ret;
+	}
+
+	pol = vma->vm_policy;
+	return pol && (pol->flags & MPOL_F_MOF);
+}
+
 static int apply_policy_zone(struct mempolicy *policy, enum zone_type zone)
 {
 	enum zone_type dynamic_policy_zone = policy_zone;
@@ -1730,10 +1730,11 @@ int migrate_misplaced_page(struct page *page, struct vm_area_struct *vma,
 
 	/*
 	 * Don't migrate file pages that are mapped in multiple processes
-	 * with execute permissions as they are probably shared libraries.
+	 * with execute permissions as they are probably shared libraries,
+	 * unless the mapping explicitly asked for migrate-on-fault.
 	 */
 	if (page_mapcount(page) != 1 && page_is_file_cache(page) &&
-	    (vma->vm_flags & VM_EXEC))
+	    (vma->vm_flags & VM_EXEC) && !vma_policy_mof_explicit(vma))
 		goto out;
 
 	/*
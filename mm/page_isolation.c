@@ -19,7 +19,7 @@ int set_migratetype_isolate(struct page *page, bool skip_hwpoisoned_pages)
 
 	zone = page_zone(page);
 
-	spin_lock_irqsave(&zone->lock, flags);
+	numa_spin_lock_irqsave(&zone->lock, flags);
 
 	pfn = page_to_pfn(page);
 	arg.start_pfn = pfn;
@@ -65,7 +65,7 @@ out:
 		__mod_zone_freepage_state(zone, -nr_pages, migratetype);
 	}
 
-	spin_unlock_irqrestore(&zone->lock, flags);
+	numa_spin_unlock_irqrestore(&zone->lock, flags);
 	if (!ret)
 		drain_all_pages();
 	return ret;
@@ -77,14 +77,14 @@ void unset_migratetype_isolate(struct page *page, unsigned migratetype)
 	unsigned long flags, nr_pages;
 
 	zone = page_zone(page);
-	spin_lock_irqsave(&zone->lock, flags);
+	numa_spin_lock_irqsave(&zone->lock, flags);
 	if (get_pageblock_migratetype(page) != MIGRATE_ISOLATE)
 		goto out;
 	nr_pages = move_freepages_block(zone, page, migratetype);
 	__mod_zone_freepage_state(zone, nr_pages, migratetype);
 	set_pageblock_migratetype(page, migratetype);
 out:
-	spin_unlock_irqrestore(&zone->lock, flags);
+	numa_spin_unlock_irqrestore(&zone->lock, flags);
 }
 
 static inline struct page *
@@ -241,10 +241,10 @@ int test_pages_isolated(unsigned long start_pfn, unsigned long end_pfn,
 		return -EBUSY;
 	/* Check all pages are free or marked as ISOLATED */
 	zone = page_zone(page);
-	spin_lock_irqsave(&zone->lock, flags);
+	numa_spin_lock_irqsave(&zone->lock, flags);
 	ret = __test_page_isolated_in_pageblock(start_pfn, end_pfn,
 						skip_hwpoisoned_pages);
-	spin_unlock_irqrestore(&zone->lock, flags);
+	numa_spin_unlock_irqrestore(&zone->lock, flags);
 	return ret ? 0 : -EBUSY;
 }
 
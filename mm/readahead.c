@@ -317,7 +317,119 @@ static unsigned long get_next_ra_size(struct file_ra_state *ra,
  *
  * The code ramps up the readahead size aggressively at first, but slow down as
  * it approaches max_readhead.
+ *
+ * Several sequential streams on one file (e.g. stripes of a columnar file
+ * read by concurrent workers) each keep their own window: when a new stream
+ * takes over the readahead state, the old window is parked in ra->streams[],
+ * and a later read at its expected offset swaps it back in and ramps it up
+ * as if it had never been interrupted.  Reads that skip forward by the same
+ * distance each time are recognised as a strided stream, and the next few
+ * strides are read along with the current one.
+ */
+
+/*
+ * Is @offset the next expected read of the window @start/@size/@async_size?
+ */
+static inline bool ra_window_expects(pgoff_t start, unsigned int size,
+				     unsigned int async_size, pgoff_t offset)
+{
+	return offset == start + size - async_size || offset == start + size;
+}
+
+/*
+ * Park the current window before another stream takes over the readahead
+ * state, unless @offset simply continues it.
+ */
+static void ra_park_stream(struct file_ra_state *ra, pgoff_t offset)
+{
+	if (!ra->size)
+		return;
+	if (offset >= ra->start && offset <= ra->start + ra->size)
+		return;
+
+	memmove(&ra->streams[1], &ra->streams[0],
+		(RA_STREAMS - 1) * sizeof(ra->streams[0]));
+	ra->streams[0].start = ra->start;
+	ra->streams[0].size = ra->size;
+	ra->streams[0].async_size = ra->async_size;
+}
+
+/*
+ * If @offset continues a parked stream, make that stream current again
+ * and park the current window in its place.
  */
+static bool ra_resume_stream(struct file_ra_state *ra, pgoff_t offset)
+{
+	struct ra_stream *s;
+	struct ra_stream cur;
+	int i;
+
+	for (i = 0; i < RA_STREAMS; i++) {
+		s = &ra->streams[i];
+		if (s->size &&
+		    ra_window_expects(s->start, s->size, s->async_size, offset))
+			break;
+	}
+	if (i == RA_STREAMS)
+		return false;
+
+	cur = *s;
+	if (ra->size) {
+		memmove(&ra->streams[1], &ra->streams[0],
+			i * sizeof(ra->streams[0]));
+		ra->streams[0].start = ra->start;
+		ra->streams[0].size = ra->size;
+		ra->streams[0].async_size = ra->async_size;
+	} else {
+		memmove(&ra->streams[i], &ra->streams[i + 1],
+			(RA_STREAMS - 1 - i) * sizeof(ra->streams[0]));
+		memset(&ra->streams[RA_STREAMS - 1], 0,
+		       sizeof(ra->streams[0]));
+	}
+
+	ra->start = cur.start;
+	ra->size = cur.size;
+	ra->async_size = cur.async_size;
+	return true;
+}
+
+/*
+ * Strided access: this miss is the same distance from the previous one as
+ * that was from the one before.  Read this request plus as many of the
+ * following strides as fit in the readahead window.
+ */
+static unsigned long ra_stride_readahead(struct address_space *mapping,
+					 struct file_ra_state *ra,
+					 struct file *filp, pgoff_t offset,
+					 unsigned long req_size,
+					 unsigned long max)
+{
+	long stride = (long)(offset - ra->stride_prev);
+	loff_t isize = i_size_read(mapping->host);
+	pgoff_t end_index, index;
+	unsigned long budget, nr;
+
+	if (stride != ra->stride || stride <= (long)req_size || !isize) {
+		ra->stride = stride;
+		ra->stride_prev = offset;
+		return 0;
+	}
+
+	end_index = (isize - 1) >> PAGE_CACHE_SHIFT;
+	nr = __do_page_cache_readahead(mapping, filp, offset, req_size, 0);
+	index = offset;
+	for (budget = max; budget >= 2 * req_size; budget -= req_size) {
+		if (index + stride > end_index)
+			break;
+		index += stride;
+		nr += __do_page_cache_readahead(mapping, filp, index,
+						req_size, 0);
+	}
+
+	/* The next miss is expected one stride past what we read ahead */
+	ra->stride_prev = index;
+	return nr;
+}
 
 /*
  * Count contiguously cached pages from @offset-1 to @offset-@max,
@@ -365,6 +477,7 @@ static int try_context_readahead(struct address_space *mapping,
 	if (size >= offset)
 		size *= 2;
 
+	ra_park_stream(ra, offset);
 	ra->start = offset;
 	ra->size = min(size + req_size, max);
 	ra->async_size = 1;
@@ -383,6 +496,7 @@ ondemand_readahead(struct address_space *mapping,
 {
 	unsigned long max = max_sane_readahead(ra->ra_pages);
 	pgoff_t prev_offset;
+	unsigned long nr;
 
 	/*
 	 * start of file
@@ -394,8 +508,8 @@ ondemand_readahead(struct address_space *mapping,
 	 * It's the expected callback offset, assume sequential access.
 	 * Ramp up sizes, and push forward the readahead window.
 	 */
-	if ((offset == (ra->start + ra->size - ra->async_size) ||
-	     offset == (ra->start + ra->size))) {
+	if (ra_window_expects(ra->start, ra->size, ra->async_size, offset) ||
+	    ra_resume_stream(ra, offset)) {
 		ra->start += ra->size;
 		ra->size = get_next_ra_size(ra, max);
 		ra->async_size = ra->size;
@@ -418,6 +532,7 @@ ondemand_readahead(struct address_space *mapping,
 		if (!start || start - offset > max)
 			return 0;
 
+		ra_park_stream(ra, offset);
 		ra->start = start;
 		ra->size = start - offset;	/* old async_size */
 		ra->size += req_size;
@@ -449,12 +564,16 @@ ondemand_readahead(struct address_space *mapping,
 		goto readit;
 
 	/*
-	 * standalone, small random read
-	 * Read as is, and do not pollute the readahead state.
+	 * standalone, small random read, unless it is part of a strided
+	 * pattern.  Read as is, and do not pollute the readahead state.
 	 */
+	nr = ra_stride_readahead(mapping, ra, filp, offset, req_size, max);
+	if (nr)
+		return nr;
 	return __do_page_cache_readahead(mapping, filp, offset, req_size, 0);
 
 initial_readahead:
+	ra_park_stream(ra, offset);
 	ra->start = offset;
 	ra->size = get_init_ra_size(req_size, max);
 	ra->async_size = ra->size > req_size ? ra->size - req_size : ra->size;
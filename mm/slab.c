@@ -3556,6 +3556,62 @@ void *kmem_cache_alloc(struct kmem_cache *cachep, gfp_t flags)
 }
 EXPORT_SYMBOL(kmem_cache_alloc);
 
+/**
+ * kmem_cache_alloc_bulk - Allocate an array of objects
+ * @cachep: The cache to allocate from.
+ * @flags: See kmalloc().
+ * @size: Number of objects to allocate.
+ * @p: Array the objects are stored to.
+ *
+ * Like kmem_cache_alloc() for each object, but with interrupts disabled
+ * only once for the whole array. Either all @size objects are allocated
+ * and true is returned, or none are and the return value is false.
+ */
+bool kmem_cache_alloc_bulk(struct kmem_cache *cachep, gfp_t flags,
+			   size_t size, void **p)
+{
+	size_t i, nr;
+
+	flags &= gfp_allowed_mask;
+
+	lockdep_trace_alloc(flags);
+
+	if (slab_should_failslab(cachep, flags))
+		return false;
+
+	cachep = memcg_kmem_get_cache(cachep, flags);
+
+	cache_alloc_debugcheck_before(cachep, flags);
+	local_irq_disable();
+	for (nr = 0; nr < size; nr++) {
+		p[nr] = __do_cache_alloc(cachep, flags);
+		if (unlikely(!p[nr]))
+			break;
+	}
+	local_irq_enable();
+
+	for (i = 0; i < nr; i++) {
+		void *objp = cache_alloc_debugcheck_after(cachep, flags, p[i],
+							  _RET_IP_);
+
+		kmemleak_alloc_recursive(objp, cachep->object_size, 1,
+					 cachep->flags, flags);
+		kmemcheck_slab_alloc(cachep, flags, objp, cachep->object_size);
+		if (unlikely(flags & __GFP_ZERO))
+			memset(objp, 0, cachep->object_size);
+		trace_kmem_cache_alloc(_RET_IP_, objp, cachep->object_size,
+				       cachep->size, flags);
+		p[i] = objp;
+	}
+
+	if (unlikely(nr < size)) {
+		kmem_cache_free_bulk(cachep, nr, p);
+		return false;
+	}
+	return true;
+}
+EXPORT_SYMBOL(kmem_cache_alloc_bulk);
+
 #ifdef CONFIG_TRACING
 void *
 kmem_cache_alloc_trace(struct kmem_cache *cachep, gfp_t flags, size_t size)
@@ -3717,6 +3773,39 @@ void kmem_cache_free(struct kmem_cache *cachep, void *objp)
 }
 EXPORT_SYMBOL(kmem_cache_free);
 
+/**
+ * kmem_cache_free_bulk - Deallocate an array of objects
+ * @orig_cachep: The cache the allocations were from.
+ * @size: Number of objects in @p.
+ * @p: The previously allocated objects.
+ *
+ * Like kmem_cache_free() on each object, but with interrupts disabled
+ * only once for the whole array.
+ */
+void kmem_cache_free_bulk(struct kmem_cache *orig_cachep, size_t size,
+			  void **p)
+{
+	struct kmem_cache *cachep;
+	size_t i;
+
+	local_irq_disable();
+	for (i = 0; i < size; i++) {
+		void *objp = p[i];
+
+		cachep = cache_from_obj(orig_cachep, objp);
+		if (!cachep)
+			continue;
+
+		debug_check_no_locks_freed(objp, cachep->object_size);
+		if (!(cachep->flags & SLAB_DEBUG_OBJECTS))
+			debug_check_no_obj_freed(objp, cachep->object_size);
+		__cache_free(cachep, objp, _RET_IP_);
+		trace_kmem_cache_free(_RET_IP_, objp);
+	}
+	local_irq_enable();
+}
+EXPORT_SYMBOL(kmem_cache_free_bulk);
+
 /**
  * kfree - free previously allocated memory
  * @objp: pointer returned by kmalloc.
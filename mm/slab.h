@@ -94,6 +94,10 @@ int __kmem_cache_shutdown(struct kmem_cache *);
 int __kmem_cache_shrink(struct kmem_cache *);
 void slab_kmem_cache_release(struct kmem_cache *);
 
+/* Generic bulk operations, one object at a time */
+bool __kmem_cache_alloc_bulk(struct kmem_cache *, gfp_t, size_t, void **);
+void __kmem_cache_free_bulk(struct kmem_cache *, size_t, void **);
+
 struct seq_file;
 struct file;
 
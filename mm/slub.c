@@ -2583,15 +2583,30 @@ static void __slab_free(struct kmem_cache *s, struct page *page,
 			} else { /* Needs to be taken off a list */
 
 	                        n = get_node(s, page_to_nid(page));
+
 				/*
-				 * Speculatively acquire the list_lock.
-				 * If the cmpxchg does not succeed then we may
-				 * drop the list_lock without any processing.
-				 *
-				 * Otherwise the list_lock will synchronize with
-				 * other processors updating the list of slabs.
+				 * A partial slab that becomes empty stays on
+				 * the partial list while the node is below
+				 * min_partial, so there is no list operation
+				 * to do and no need for the list_lock. If
+				 * nr_partial grows meanwhile the empty slab
+				 * is left for kmem_cache_shrink().
 				 */
-				spin_lock_irqsave(&n->list_lock, flags);
+				if (prior &&
+				    ACCESS_ONCE(n->nr_partial) < s->min_partial)
+					n = NULL;
+				else
+					/*
+					 * Speculatively acquire the list_lock.
+					 * If the cmpxchg does not succeed then
+					 * we may drop the list_lock without any
+					 * processing.
+					 *
+					 * Otherwise the list_lock will
+					 * synchronize with other processors
+					 * updating the list of slabs.
+					 */
+					spin_lock_irqsave(&n->list_lock, flags);
 
 			}
 		}
@@ -2713,6 +2728,105 @@ void kmem_cache_free(struct kmem_cache *s, void *x)
 }
 EXPORT_SYMBOL(kmem_cache_free);
 
+/*
+ * Objects that belong to the cpu slab are pushed onto the cpu freelist
+ * directly with interrupts disabled, instead of one cmpxchg_double per
+ * object. The rest take the regular slow path.
+ */
+void kmem_cache_free_bulk(struct kmem_cache *orig_s, size_t size, void **p)
+{
+	struct kmem_cache_cpu *c;
+	struct kmem_cache *s;
+	struct page *page;
+	size_t i;
+
+	local_irq_disable();
+	for (i = 0; i < size; i++) {
+		void *object = p[i];
+
+		s = cache_from_obj(orig_s, object);
+		if (unlikely(!s))
+			continue;
+
+		slab_free_hook(s, object);
+		page = virt_to_head_page(object);
+		c = this_cpu_ptr(s->cpu_slab);
+
+		if (c->page == page) {
+			set_freepointer(s, object, c->freelist);
+			c->freelist = object;
+			/* Let preempted fastpaths on this cpu see the change */
+			c->tid = next_tid(c->tid);
+			stat(s, FREE_FASTPATH);
+		} else {
+			local_irq_enable();
+			__slab_free(s, page, object, _RET_IP_);
+			local_irq_disable();
+		}
+		trace_kmem_cache_free(_RET_IP_, object);
+	}
+	local_irq_enable();
+}
+EXPORT_SYMBOL(kmem_cache_free_bulk);
+
+bool kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
+			   void **p)
+{
+	struct kmem_cache_cpu *c;
+	size_t i, nr;
+
+	/* Debug caches never use the cpu freelist */
+	if (kmem_cache_debug(s))
+		return __kmem_cache_alloc_bulk(s, flags, size, p);
+
+	if (slab_pre_alloc_hook(s, flags))
+		return false;
+
+	s = memcg_kmem_get_cache(s, flags);
+
+	local_irq_disable();
+	c = this_cpu_ptr(s->cpu_slab);
+
+	for (nr = 0; nr < size; nr++) {
+		void *object = c->freelist;
+
+		if (unlikely(!object)) {
+			/*
+			 * The slow path refills c->freelist and may enable
+			 * interrupts, so invalidate the tid of our direct
+			 * updates first and reload the cpu slab after.
+			 */
+			c->tid = next_tid(c->tid);
+			p[nr] = __slab_alloc(s, flags, NUMA_NO_NODE, _RET_IP_, c);
+			c = this_cpu_ptr(s->cpu_slab);
+			stat(s, ALLOC_SLOWPATH);
+			if (unlikely(!p[nr]))
+				break;
+			continue;
+		}
+		c->freelist = get_freepointer(s, object);
+		p[nr] = object;
+		stat(s, ALLOC_FASTPATH);
+	}
+	c->tid = next_tid(c->tid);
+	local_irq_enable();
+
+	for (i = 0; i < nr; i++) {
+		if (unlikely(flags & __GFP_ZERO))
+			memset(p[i], 0, s->object_size);
+		slab_post_alloc_hook(s, flags, p[i]);
+		trace_kmem_cache_alloc(_RET_IP_, p[i], s->object_size,
+				       s->size, flags);
+	}
+
+	if (unlikely(nr < size)) {
+		kmem_cache_free_bulk(s, nr, p);
+		return false;
+	}
+	return true;
+}
+EXPORT_SYMBOL(kmem_cache_alloc_bulk);
+
 /*
  * Object placement in a slab is made very easy because we always start at
  * offset 0. If we tune the size of the object to the alignment then we can
@@ -43,6 +43,7 @@ int page_cluster;
 static DEFINE_PER_CPU(struct pagevec, lru_add_pvec);
 static DEFINE_PER_CPU(struct pagevec, lru_rotate_pvecs);
 static DEFINE_PER_CPU(struct pagevec, lru_deactivate_pvecs);
+static DEFINE_PER_CPU(struct pagevec, lru_deactivate_anon_pvecs);
 
 /*
  * This path almost never happens for VM activity - pages are normally
@@ -762,6 +763,24 @@ static void lru_deactivate_fn(struct page *page, struct lruvec *lruvec,
 	update_page_reclaim_stat(lruvec, file, 0);
 }
 
+/*
+ * Move a mapped anonymous page the application no longer needs (see
+ * MADV_FREE) to the inactive list, where reclaim finds it sooner.
+ */
+static void lru_deactivate_anon_fn(struct page *page, struct lruvec *lruvec,
+				   void *arg)
+{
+	if (PageLRU(page) && PageActive(page) && !PageUnevictable(page)) {
+		del_page_from_lru_list(page, lruvec, LRU_ACTIVE_ANON);
+		ClearPageActive(page);
+		ClearPageReferenced(page);
+		add_page_to_lru_list(page, lruvec, LRU_INACTIVE_ANON);
+
+		__count_vm_event(PGDEACTIVATE);
+		update_page_reclaim_stat(lruvec, 0, 0);
+	}
+}
+
 /*
  * Drain pages out of the cpu's pagevecs.
  * Either "cpu" is the current CPU, and preemption has already been
@@ -788,6 +807,10 @@ void lru_add_drain_cpu(int cpu)
 	if (pagevec_count(pvec))
 		pagevec_lru_move_fn(pvec, lru_deactivate_fn, NULL);
 
+	pvec = &per_cpu(lru_deactivate_anon_pvecs, cpu);
+	if (pagevec_count(pvec))
+		pagevec_lru_move_fn(pvec, lru_deactivate_anon_fn, NULL);
+
 	activate_page_drain(cpu);
 }
 
@@ -817,6 +840,25 @@ void deactivate_page(struct page *page)
 	}
 }
 
+/**
+ * deactivate_anon_page - deactivate a lazily freed anonymous page
+ * @page: page to deactivate
+ *
+ * Unlike deactivate_page() this also handles mapped pages: the caller
+ * has cleaned the ptes so reclaim can simply discard the page.
+ */
+void deactivate_anon_page(struct page *page)
+{
+	if (PageActive(page) && PageAnon(page) && !PageUnevictable(page) &&
+	    likely(get_page_unless_zero(page))) {
+		struct pagevec *pvec = &get_cpu_var(lru_deactivate_anon_pvecs);
+
+		if (!pagevec_add(pvec, page))
+			pagevec_lru_move_fn(pvec, lru_deactivate_anon_fn, NULL);
+		put_cpu_var(lru_deactivate_anon_pvecs);
+	}
+}
+
 void lru_add_drain(void)
 {
 	lru_add_drain_cpu(get_cpu());
@@ -846,6 +888,7 @@ void lru_add_drain_all(void)
 		if (pagevec_count(&per_cpu(lru_add_pvec, cpu)) ||
 		    pagevec_count(&per_cpu(lru_rotate_pvecs, cpu)) ||
 		    pagevec_count(&per_cpu(lru_deactivate_pvecs, cpu)) ||
+		    pagevec_count(&per_cpu(lru_deactivate_anon_pvecs, cpu)) ||
 		    need_activate_page_drain(cpu)) {
 			INIT_WORK(work, lru_add_drain_per_cpu);
 			schedule_work_on(cpu, work);
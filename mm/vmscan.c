@@ -31,6 +31,7 @@
 #include <linux/mm_inline.h>
 #include <linux/backing-dev.h>
 #include <linux/rmap.h>
+#include <linux/ksm.h>
 #include <linux/topology.h>
 #include <linux/cpu.h>
 #include <linux/cpuset.h>
@@ -41,6 +42,7 @@
 #include <linux/kthread.h>
 #include <linux/freezer.h>
 #include <linux/memcontrol.h>
+#include <linux/memory_hotplug.h>
 #include <linux/delayacct.h>
 #include <linux/sysctl.h>
 #include <linux/oom.h>
@@ -136,6 +138,13 @@ struct scan_control {
  * From 0 .. 100.  Higher means more swappy.
  */
 int vm_swappiness = 60;
+/*
+ * Number of kswapd threads per node.  They all sleep on the same
+ * pgdat->kswapd_wait and run balance_pgdat() concurrently; the shared
+ * memcg reclaim iterator in shrink_zone() hands each of them a different
+ * memcg, so with multiple cgroups they partition the zone's lruvecs.
+ */
+int kswapd_threads = 1;
 unsigned long vm_total_pages;	/* The total number of pages which the VM controls */
 
 static LIST_HEAD(shrinker_list);
@@ -375,6 +384,10 @@ unsigned long shrink_slab(struct shrink_control *shrinkctl,
 	}
 
 	list_for_each_entry(shrinker, &shrinker_list, list) {
+		if (shrinkctl->memcg &&
+		    !(shrinker->flags & SHRINKER_MEMCG_AWARE))
+			continue;
+
 		if (!(shrinker->flags & SHRINKER_NUMA_AWARE)) {
 			shrinkctl->nid = 0;
 			freed += shrink_slab_node(shrinkctl, shrinker,
@@ -823,6 +836,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		int may_enter_fs;
 		enum page_references references = PAGEREF_RECLAIM_CLEAN;
 		bool dirty, writeback;
+		bool lazyfree = false;
 
 		cond_resched();
 
@@ -964,8 +978,19 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		if (PageAnon(page) && !PageSwapCache(page)) {
 			if (!(sc->gfp_mask & __GFP_IO))
 				goto keep_locked;
+			/*
+			 * A clean anonymous page is only dirty in its ptes,
+			 * unless MADV_FREE cleaned those too.  Keep it clean
+			 * in the swap cache so try_to_unmap() can tell, and
+			 * drop it rather than write it out if no pte was
+			 * written since.  KSM pages may be clean yet shared
+			 * with mappings that never saw the MADV_FREE.
+			 */
+			lazyfree = !PageDirty(page) && !PageKsm(page);
 			if (!add_to_swap(page, page_list))
 				goto activate_locked;
+			if (lazyfree)
+				ClearPageDirty(page);
 			may_enter_fs = 1;
 
 			/* Adding to swap updated mapping */
@@ -977,7 +1002,8 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		 * processes. Try to unmap it here.
 		 */
 		if (page_mapped(page) && mapping) {
-			switch (try_to_unmap(page, ttu_flags)) {
+			switch (try_to_unmap(page, ttu_flags|TTU_BATCH_FLUSH|
+					(lazyfree ? TTU_LZFREE : 0))) {
 			case SWAP_FAIL:
 				goto activate_locked;
 			case SWAP_AGAIN:
@@ -1017,7 +1043,12 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			if (!sc->may_writepage)
 				goto keep_locked;
 
-			/* Page is dirty, try to write it out here */
+			/*
+			 * Page is dirty. Flush the TLB if a writable entry
+			 * potentially exists to avoid CPU writes after IO
+			 * starts and then write it out here.
+			 */
+			try_to_unmap_flush_dirty();
 			switch (pageout(page, mapping, sc)) {
 			case PAGE_KEEP:
 				goto keep_locked;
@@ -1127,6 +1158,7 @@ keep:
 		VM_BUG_ON_PAGE(PageLRU(page) || PageUnevictable(page), page);
 	}
 
+	try_to_unmap_flush();
 	free_hot_cold_page_list(&free_pages, true);
 
 	list_splice(&ret_pages, page_list);
@@ -2241,6 +2273,32 @@ static inline bool should_continue_reclaim(struct zone *zone,
 	}
 }
 
+static void shrink_memcg_slab(struct zone *zone, struct lruvec *lruvec,
+			      struct mem_cgroup *memcg,
+			      struct scan_control *sc,
+			      unsigned long nr_scanned)
+{
+	struct reclaim_state *reclaim_state = current->reclaim_state;
+	struct shrink_control shrink = {
+		.gfp_mask = sc->gfp_mask,
+		.memcg = memcg,
+	};
+	unsigned long lru_pages;
+
+	lru_pages = get_lru_size(lruvec, LRU_ACTIVE_FILE) +
+		    get_lru_size(lruvec, LRU_INACTIVE_FILE) +
+		    get_lru_size(lruvec, LRU_ACTIVE_ANON) +
+		    get_lru_size(lruvec, LRU_INACTIVE_ANON);
+
+	nodes_clear(shrink.nodes_to_scan);
+	node_set(zone_to_nid(zone), shrink.nodes_to_scan);
+	shrink_slab(&shrink, nr_scanned, lru_pages);
+	if (reclaim_state) {
+		sc->nr_reclaimed += reclaim_state->reclaimed_slab;
+		reclaim_state->reclaimed_slab = 0;
+	}
+}
+
 static void shrink_zone(struct zone *zone, struct scan_control *sc)
 {
 	unsigned long nr_reclaimed, nr_scanned;
@@ -2258,6 +2316,7 @@ static void shrink_zone(struct zone *zone, struct scan_control *sc)
 
 		memcg = mem_cgroup_iter(root, NULL, &reclaim);
 		do {
+			unsigned long memcg_scanned = sc->nr_scanned;
 			struct lruvec *lruvec;
 
 			lruvec = mem_cgroup_zone_lruvec(zone, memcg);
@@ -2265,6 +2324,17 @@ static void shrink_zone(struct zone *zone, struct scan_control *sc)
 			sc->swappiness = mem_cgroup_swappiness(memcg);
 			shrink_lruvec(lruvec, sc);
 
+			/*
+			 * Limit reclaim shrinks the slab objects accounted to
+			 * the kmem limited cgroups it visits, in proportion to
+			 * the pages scanned from them.  Global reclaim shrinks
+			 * all slab caches at once from shrink_zones() and
+			 * kswapd.
+			 */
+			if (!global_reclaim(sc) && memcg_cache_id(memcg) >= 0)
+				shrink_memcg_slab(zone, lruvec, memcg, sc,
+						  sc->nr_scanned - memcg_scanned);
+
 			/*
 			 * Direct reclaim and kswapd have to scan all memory
 			 * cgroups to fulfill the overall scan target for the
@@ -3458,12 +3528,18 @@ static int cpu_callback(struct notifier_block *nfb, unsigned long action,
 		for_each_node_state(nid, N_MEMORY) {
 			pg_data_t *pgdat = NODE_DATA(nid);
 			const struct cpumask *mask;
+			int i;
 
 			mask = cpumask_of_node(pgdat->node_id);
 
-			if (cpumask_any_and(cpu_online_mask, mask) < nr_cpu_ids)
-				/* One of our CPUs online: restore mask */
-				set_cpus_allowed_ptr(pgdat->kswapd, mask);
+			if (cpumask_any_and(cpu_online_mask, mask) >= nr_cpu_ids)
+				continue;
+
+			/* One of our CPUs online: restore mask */
+			for (i = 0; i < MAX_KSWAPD_THREADS; i++)
+				if (pgdat->kswapd[i])
+					set_cpus_allowed_ptr(pgdat->kswapd[i],
+							     mask);
 		}
 	}
 	return NOTIFY_OK;
@@ -3476,20 +3552,39 @@ static int cpu_callback(struct notifier_block *nfb, unsigned long action,
 int kswapd_run(int nid)
 {
 	pg_data_t *pgdat = NODE_DATA(nid);
-	int ret = 0;
+	struct task_struct *tsk;
+	int i;
 
-	if (pgdat->kswapd)
-		return 0;
+	for (i = 0; i < kswapd_threads; i++) {
+		if (pgdat->kswapd[i])
+			continue;
 
-	pgdat->kswapd = kthread_run(kswapd, pgdat, "kswapd%d", nid);
-	if (IS_ERR(pgdat->kswapd)) {
-		/* failure at boot is fatal */
-		BUG_ON(system_state == SYSTEM_BOOTING);
-		pr_err("Failed to start kswapd on node %d\n", nid);
-		ret = PTR_ERR(pgdat->kswapd);
-		pgdat->kswapd = NULL;
+		if (i == 0)
+			tsk = kthread_run(kswapd, pgdat, "kswapd%d", nid);
+		else
+			tsk = kthread_run(kswapd, pgdat, "kswapd%d:%d", nid, i);
+		if (IS_ERR(tsk)) {
+			/* failure to start the first one at boot is fatal */
+			BUG_ON(i == 0 && system_state == SYSTEM_BOOTING);
+			pr_err("Failed to start kswapd on node %d\n", nid);
+			return PTR_ERR(tsk);
+		}
+		pgdat->kswapd[i] = tsk;
+	}
+	return 0;
+}
+
+/* Stop the kswapd threads of @pgdat with index @first and above. */
+static void __kswapd_stop(pg_data_t *pgdat, int first)
+{
+	int i;
+
+	for (i = first; i < MAX_KSWAPD_THREADS; i++) {
+		if (pgdat->kswapd[i]) {
+			kthread_stop(pgdat->kswapd[i]);
+			pgdat->kswapd[i] = NULL;
+		}
 	}
-	return ret;
 }
 
 /*
@@ -3498,12 +3593,38 @@ int kswapd_run(int nid)
  */
 void kswapd_stop(int nid)
 {
-	struct task_struct *kswapd = NODE_DATA(nid)->kswapd;
+	__kswapd_stop(NODE_DATA(nid), 0);
+}
+
+/*
+ * vm.kswapd_threads sysctl handler: start or stop threads on every node
+ * with memory.  get_online_mems() keeps hotplug from changing the set
+ * of nodes, or their kswapd arrays, under us.
+ */
+int kswapd_threads_sysctl_handler(struct ctl_table *table, int write,
+				  void __user *buffer, size_t *length,
+				  loff_t *ppos)
+{
+	static DEFINE_MUTEX(kswapd_threads_mutex);
+	int old, ret, nid;
+
+	mutex_lock(&kswapd_threads_mutex);
+	old = kswapd_threads;
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (ret || !write || kswapd_threads == old)
+		goto out;
 
-	if (kswapd) {
-		kthread_stop(kswapd);
-		NODE_DATA(nid)->kswapd = NULL;
+	get_online_mems();
+	for_each_node_state(nid, N_MEMORY) {
+		if (kswapd_threads > old)
+			kswapd_run(nid);
+		else
+			__kswapd_stop(NODE_DATA(nid), kswapd_threads);
 	}
+	put_online_mems();
+out:
+	mutex_unlock(&kswapd_threads_mutex);
+	return ret;
 }
 
 static int __init kswapd_init(void)
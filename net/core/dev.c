@@ -81,6 +81,7 @@
 #include <linux/hash.h>
 #include <linux/slab.h>
 #include <linux/sched.h>
+#include <linux/kthread.h>
 #include <linux/mutex.h>
 #include <linux/string.h>
 #include <linux/mm.h>
@@ -132,6 +133,8 @@
 #include <linux/hashtable.h>
 #include <linux/vmalloc.h>
 #include <linux/if_macvlan.h>
+#include <net/xdp.h>
+#include <net/stack_latency.h>
 
 #include "net-sysfs.h"
 
@@ -1719,7 +1722,7 @@ static inline int deliver_skb(struct sk_buff *skb,
 			      struct packet_type *pt_prev,
 			      struct net_device *orig_dev)
 {
-	if (unlikely(skb_orphan_frags(skb, GFP_ATOMIC)))
+	if (unlikely(skb_orphan_frags_rx(skb, GFP_ATOMIC)))
 		return -ENOMEM;
 	atomic_inc(&skb->users);
 	return pt_prev->func(skb, skb->dev, pt_prev, orig_dev);
@@ -2588,8 +2591,11 @@ netdev_features_t netif_skb_features(struct sk_buff *skb)
 }
 EXPORT_SYMBOL(netif_skb_features);
 
-int dev_hard_start_xmit(struct sk_buff *skb, struct net_device *dev,
-			struct netdev_queue *txq)
+/* @more tells the driver that the caller is about to hand it further
+ * packets for @txq, so that it may defer kicking the hardware.
+ */
+int __dev_hard_start_xmit(struct sk_buff *skb, struct net_device *dev,
+			  struct netdev_queue *txq, bool more)
 {
 	const struct net_device_ops *ops = dev->netdev_ops;
 	int rc = NETDEV_TX_OK;
@@ -2655,6 +2661,7 @@ int dev_hard_start_xmit(struct sk_buff *skb, struct net_device *dev,
 			dev_queue_xmit_nit(skb, dev);
 
 		skb_len = skb->len;
+		skb->xmit_more = more;
 		trace_net_dev_start_xmit(skb, dev);
 		rc = ops->ndo_start_xmit(skb, dev);
 		trace_net_dev_xmit(skb, rc, dev, skb_len);
@@ -2674,6 +2681,7 @@ gso:
 			dev_queue_xmit_nit(nskb, dev);
 
 		skb_len = nskb->len;
+		nskb->xmit_more = more || skb->next != NULL;
 		trace_net_dev_start_xmit(nskb, dev);
 		rc = ops->ndo_start_xmit(nskb, dev);
 		trace_net_dev_xmit(nskb, rc, dev, skb_len);
@@ -2700,7 +2708,7 @@ out_kfree_skb:
 out:
 	return rc;
 }
-EXPORT_SYMBOL_GPL(dev_hard_start_xmit);
+EXPORT_SYMBOL_GPL(__dev_hard_start_xmit);
 
 static void qdisc_pkt_len_init(struct sk_buff *skb)
 {
@@ -2742,6 +2750,18 @@ static inline int __dev_xmit_skb(struct sk_buff *skb, struct Qdisc *q,
 
 	qdisc_pkt_len_init(skb);
 	qdisc_calculate_pkt_len(skb, q);
+
+	if (q->flags & TCQ_F_NOLOCK) {
+		if (unlikely(test_bit(__QDISC_STATE_DEACTIVATED, &q->state))) {
+			kfree_skb(skb);
+			return NET_XMIT_DROP;
+		}
+		skb_dst_force(skb);
+		rc = q->enqueue(skb, q) & NET_XMIT_MASK;
+		qdisc_run(q);
+		return rc;
+	}
+
 	/*
 	 * Heuristic to force contended enqueues to serialize on a
 	 * separate lock before trying to get qdisc main lock.
@@ -2961,6 +2981,7 @@ int netdev_max_backlog __read_mostly = 1000;
 EXPORT_SYMBOL(netdev_max_backlog);
 
 int netdev_tstamp_prequeue __read_mostly = 1;
+int gro_normal_batch __read_mostly = 8;
 int netdev_budget __read_mostly = 300;
 int weight_p __read_mostly = 64;            /* old backlog weight */
 
@@ -2968,6 +2989,20 @@ int weight_p __read_mostly = 64;            /* old backlog weight */
 static inline void ____napi_schedule(struct softnet_data *sd,
 				     struct napi_struct *napi)
 {
+	struct task_struct *thread;
+
+	if (test_bit(NAPI_STATE_THREADED, &napi->state)) {
+		/* The thread may not exist yet while threaded mode is
+		 * being switched on; the softirq can poll meanwhile.
+		 */
+		thread = ACCESS_ONCE(napi->thread);
+		if (thread) {
+			set_bit(NAPI_STATE_SCHED_THREADED, &napi->state);
+			wake_up_process(thread);
+			return;
+		}
+	}
+
 	list_add_tail(&napi->poll_list, &sd->poll_list);
 	__raise_softirq_irqoff(NET_RX_SOFTIRQ);
 }
@@ -2980,9 +3015,12 @@ EXPORT_SYMBOL(rps_sock_flow_table);
 
 struct static_key rps_needed __read_mostly;
 
+/* Hash on the headers inside tunnels rather than the device hash */
+int rps_encap_hash __read_mostly;
+
 static struct rps_dev_flow *
 set_rps_cpu(struct net_device *dev, struct sk_buff *skb,
-	    struct rps_dev_flow *rflow, u16 next_cpu)
+	    struct rps_dev_flow *rflow, u16 next_cpu, bool encap)
 {
 	if (next_cpu != RPS_NO_CPU) {
 #ifdef CONFIG_RFS_ACCEL
@@ -2993,9 +3031,13 @@ set_rps_cpu(struct net_device *dev, struct sk_buff *skb,
 		u16 rxq_index;
 		int rc;
 
-		/* Should we steer this flow to a different hardware queue? */
+		/* Should we steer this flow to a different hardware queue?
+		 * Drivers build their filters from the outer headers, which
+		 * for a hash over tunnelled headers would pull every flow
+		 * of the tunnel along; leave those to software steering.
+		 */
 		if (!skb_rx_queue_recorded(skb) || !dev->rx_cpu_rmap ||
-		    !(dev->features & NETIF_F_NTUPLE))
+		    !(dev->features & NETIF_F_NTUPLE) || encap)
 			goto out;
 		rxq_index = cpu_rmap_lookup_index(dev->rx_cpu_rmap, next_cpu);
 		if (rxq_index == skb_get_rx_queue(skb))
@@ -3005,7 +3047,7 @@ set_rps_cpu(struct net_device *dev, struct sk_buff *skb,
 		flow_table = rcu_dereference(rxqueue->rps_flow_table);
 		if (!flow_table)
 			goto out;
-		flow_id = skb_get_hash(skb) & flow_table->mask;
+		flow_id = skb_get_hash_raw(skb) & flow_table->mask;
 		rc = dev->netdev_ops->ndo_rx_flow_steer(dev, skb,
 							rxq_index, flow_id);
 		if (rc < 0)
@@ -3037,6 +3079,7 @@ static int get_rps_cpu(struct net_device *dev, struct sk_buff *skb,
 	struct rps_map *map;
 	struct rps_dev_flow_table *flow_table;
 	struct rps_sock_flow_table *sock_flow_table;
+	bool encap = false;
 	int cpu = -1;
 	u16 tcpu;
 	u32 hash;
@@ -3068,7 +3111,10 @@ static int get_rps_cpu(struct net_device *dev, struct sk_buff *skb,
 	}
 
 	skb_reset_network_header(skb);
-	hash = skb_get_hash(skb);
+	if (rps_encap_hash)
+		hash = skb_get_encap_hash(skb, &encap);
+	else
+		hash = skb_get_hash(skb);
 	if (!hash)
 		goto done;
 
@@ -3099,7 +3145,7 @@ static int get_rps_cpu(struct net_device *dev, struct sk_buff *skb,
 		     ((int)(per_cpu(softnet_data, tcpu).input_queue_head -
 		      rflow->last_qtail)) >= 0)) {
 			tcpu = next_cpu;
-			rflow = set_rps_cpu(dev, skb, rflow, next_cpu);
+			rflow = set_rps_cpu(dev, skb, rflow, next_cpu, encap);
 		}
 
 		if (tcpu != RPS_NO_CPU && cpu_online(tcpu)) {
@@ -3393,6 +3439,13 @@ static void net_tx_action(struct softirq_action *h)
 
 			head = head->next_sched;
 
+			if (q->flags & TCQ_F_NOLOCK) {
+				smp_mb__before_atomic();
+				clear_bit(__QDISC_STATE_SCHED, &q->state);
+				qdisc_run(q);
+				continue;
+			}
+
 			root_lock = qdisc_lock(q);
 			if (spin_trylock(root_lock)) {
 				smp_mb__before_atomic();
@@ -3556,8 +3609,10 @@ static bool skb_pfmemalloc_protocol(struct sk_buff *skb)
 	}
 }
 
-static int __netif_receive_skb_core(struct sk_buff *skb, bool pfmemalloc)
+static int __netif_receive_skb_core(struct sk_buff **pskb, bool pfmemalloc,
+				    struct packet_type **ppt_prev)
 {
+	struct sk_buff *skb = *pskb;
 	struct packet_type *ptype, *pt_prev;
 	rx_handler_func_t *rx_handler;
 	struct net_device *orig_dev;
@@ -3569,6 +3624,7 @@ static int __netif_receive_skb_core(struct sk_buff *skb, bool pfmemalloc)
 	net_timestamp_check(!netdev_tstamp_prequeue, skb);
 
 	trace_netif_receive_skb(skb);
+	net_lat_stage(dev_net(skb->dev), skb, NET_LAT_DRIVER);
 
 	orig_dev = skb->dev;
 
@@ -3579,8 +3635,6 @@ static int __netif_receive_skb_core(struct sk_buff *skb, bool pfmemalloc)
 
 	pt_prev = NULL;
 
-	rcu_read_lock();
-
 another_round:
 	skb->skb_iif = skb->dev->ifindex;
 
@@ -3590,7 +3644,7 @@ another_round:
 	    skb->protocol == cpu_to_be16(ETH_P_8021AD)) {
 		skb = vlan_untag(skb);
 		if (unlikely(!skb))
-			goto unlock;
+			goto out;
 	}
 
 #ifdef CONFIG_NET_CLS_ACT
@@ -3615,7 +3669,7 @@ skip_taps:
 #ifdef CONFIG_NET_CLS_ACT
 	skb = handle_ing(skb, &pt_prev, &ret, orig_dev);
 	if (!skb)
-		goto unlock;
+		goto out;
 ncls:
 #endif
 
@@ -3630,7 +3684,7 @@ ncls:
 		if (vlan_do_receive(&skb))
 			goto another_round;
 		else if (unlikely(!skb))
-			goto unlock;
+			goto out;
 	}
 
 	rx_handler = rcu_dereference(skb->dev->rx_handler);
@@ -3642,7 +3696,7 @@ ncls:
 		switch (rx_handler(&skb)) {
 		case RX_HANDLER_CONSUMED:
 			ret = NET_RX_SUCCESS;
-			goto unlock;
+			goto out;
 		case RX_HANDLER_ANOTHER:
 			goto another_round;
 		case RX_HANDLER_EXACT:
@@ -3680,10 +3734,10 @@ ncls:
 	}
 
 	if (pt_prev) {
-		if (unlikely(skb_orphan_frags(skb, GFP_ATOMIC)))
+		if (unlikely(skb_orphan_frags_rx(skb, GFP_ATOMIC)))
 			goto drop;
-		else
-			ret = pt_prev->func(skb, skb->dev, pt_prev, orig_dev);
+		/* the caller delivers to the last match */
+		*ppt_prev = pt_prev;
 	} else {
 drop:
 		atomic_long_inc(&skb->dev->rx_dropped);
@@ -3694,11 +3748,77 @@ drop:
 		ret = NET_RX_DROP;
 	}
 
-unlock:
+out:
+	*pskb = skb;
+	return ret;
+}
+
+static int __netif_receive_skb_one_core(struct sk_buff *skb, bool pfmemalloc)
+{
+	struct net_device *orig_dev = skb->dev;
+	struct packet_type *pt_prev = NULL;
+	int ret;
+
+	rcu_read_lock();
+	ret = __netif_receive_skb_core(&skb, pfmemalloc, &pt_prev);
+	if (pt_prev)
+		ret = pt_prev->func(skb, skb->dev, pt_prev, orig_dev);
 	rcu_read_unlock();
 	return ret;
 }
 
+static void __netif_receive_skb_list_ptype(struct sk_buff_head *head,
+					   struct packet_type *pt_prev,
+					   struct net_device *orig_dev)
+{
+	struct sk_buff *skb;
+
+	if (!pt_prev || skb_queue_empty(head))
+		return;
+
+	if (pt_prev->list_func)
+		pt_prev->list_func(head, pt_prev, orig_dev);
+	else
+		while ((skb = __skb_dequeue(head)) != NULL)
+			pt_prev->func(skb, skb->dev, pt_prev, orig_dev);
+}
+
+static void __netif_receive_skb_list_core(struct sk_buff_head *head,
+					  bool pfmemalloc)
+{
+	/* Taps, rx_handlers and all but the last matching packet_type
+	 * are still served one packet at a time inside
+	 * __netif_receive_skb_core().  Only the last match is deferred,
+	 * and it is constant across a sublist, so no packet_type can
+	 * see packets out of order.
+	 */
+	struct packet_type *pt_curr = NULL;
+	struct net_device *od_curr = NULL;
+	struct sk_buff_head sublist;
+	struct sk_buff *skb;
+
+	__skb_queue_head_init(&sublist);
+
+	rcu_read_lock();
+	while ((skb = __skb_dequeue(head)) != NULL) {
+		struct net_device *orig_dev = skb->dev;
+		struct packet_type *pt_prev = NULL;
+
+		__netif_receive_skb_core(&skb, pfmemalloc, &pt_prev);
+		if (!pt_prev)
+			continue;
+		if (pt_curr != pt_prev || od_curr != orig_dev) {
+			__netif_receive_skb_list_ptype(&sublist, pt_curr,
+						       od_curr);
+			pt_curr = pt_prev;
+			od_curr = orig_dev;
+		}
+		__skb_queue_tail(&sublist, skb);
+	}
+	__netif_receive_skb_list_ptype(&sublist, pt_curr, od_curr);
+	rcu_read_unlock();
+}
+
 static int __netif_receive_skb(struct sk_buff *skb)
 {
 	int ret;
@@ -3716,14 +3836,52 @@ static int __netif_receive_skb(struct sk_buff *skb)
 		 * context down to all allocation sites.
 		 */
 		current->flags |= PF_MEMALLOC;
-		ret = __netif_receive_skb_core(skb, true);
+		ret = __netif_receive_skb_one_core(skb, true);
 		tsk_restore_flags(current, pflags, PF_MEMALLOC);
 	} else
-		ret = __netif_receive_skb_core(skb, false);
+		ret = __netif_receive_skb_one_core(skb, false);
 
 	return ret;
 }
 
+static void __netif_receive_skb_list_run(struct sk_buff_head *head,
+					 bool pfmemalloc)
+{
+	unsigned long pflags = current->flags;
+
+	/* see __netif_receive_skb() */
+	if (pfmemalloc)
+		current->flags |= PF_MEMALLOC;
+	__netif_receive_skb_list_core(head, pfmemalloc);
+	if (pfmemalloc)
+		tsk_restore_flags(current, pflags, PF_MEMALLOC);
+}
+
+static void __netif_receive_skb_list(struct sk_buff_head *head)
+{
+	struct sk_buff_head sublist;
+	bool pfmemalloc = false;
+	struct sk_buff *skb;
+
+	/* PFMEMALLOC skbs are rare: cut the list into runs that share
+	 * the same status rather than testing in the packet loop.
+	 */
+	__skb_queue_head_init(&sublist);
+	while ((skb = __skb_dequeue(head)) != NULL) {
+		bool pf = sk_memalloc_socks() && skb_pfmemalloc(skb);
+
+		if (pf != pfmemalloc) {
+			if (!skb_queue_empty(&sublist))
+				__netif_receive_skb_list_run(&sublist,
+							     pfmemalloc);
+			pfmemalloc = pf;
+		}
+		__skb_queue_tail(&sublist, skb);
+	}
+	if (!skb_queue_empty(&sublist))
+		__netif_receive_skb_list_run(&sublist, pfmemalloc);
+}
+
 static int netif_receive_skb_internal(struct sk_buff *skb)
 {
 	net_timestamp_check(netdev_tstamp_prequeue, skb);
@@ -3751,6 +3909,37 @@ static int netif_receive_skb_internal(struct sk_buff *skb)
 	return __netif_receive_skb(skb);
 }
 
+static void netif_receive_skb_list_internal(struct sk_buff_head *head)
+{
+	struct sk_buff_head sublist;
+	struct sk_buff *skb, *next;
+
+	__skb_queue_head_init(&sublist);
+	while ((skb = __skb_dequeue(head)) != NULL) {
+		net_timestamp_check(netdev_tstamp_prequeue, skb);
+		if (skb_defer_rx_timestamp(skb))
+			continue;
+		__skb_queue_tail(&sublist, skb);
+	}
+
+#ifdef CONFIG_RPS
+	if (static_key_false(&rps_needed)) {
+		rcu_read_lock();
+		skb_queue_walk_safe(&sublist, skb, next) {
+			struct rps_dev_flow voidflow, *rflow = &voidflow;
+			int cpu = get_rps_cpu(skb->dev, skb, &rflow);
+
+			if (cpu >= 0) {
+				__skb_unlink(skb, &sublist);
+				enqueue_to_backlog(skb, cpu, &rflow->last_qtail);
+			}
+		}
+		rcu_read_unlock();
+	}
+#endif
+	__netif_receive_skb_list(&sublist);
+}
+
 /**
  *	netif_receive_skb - process receive buffer from network
  *	@skb: buffer to process
@@ -3774,6 +3963,47 @@ int netif_receive_skb(struct sk_buff *skb)
 }
 EXPORT_SYMBOL(netif_receive_skb);
 
+/**
+ *	netif_receive_skb_list - process many receive buffers from network
+ *	@head: list of skbs to process, emptied on return
+ *
+ *	Like netif_receive_skb(), but packets that go to the same protocol
+ *	handler are passed on as one list, so a protocol implementing
+ *	packet_type.list_func processes them as a batch.  There is no
+ *	return value since the fates of the individual skbs differ.
+ *
+ *	This function may only be called from softirq context and interrupts
+ *	should be enabled.
+ */
+void netif_receive_skb_list(struct sk_buff_head *head)
+{
+	struct sk_buff *skb;
+
+	if (skb_queue_empty(head))
+		return;
+	skb_queue_walk(head, skb)
+		trace_netif_receive_skb_entry(skb);
+	netif_receive_skb_list_internal(head);
+}
+EXPORT_SYMBOL(netif_receive_skb_list);
+
+/* Pass GRO_NORMAL and completed GRO packets up in batches of
+ * gro_normal_batch; napi_gro_flush() pushes out the remainder.
+ */
+static void gro_normal_list(struct napi_struct *napi)
+{
+	if (skb_queue_empty(&napi->rx_list))
+		return;
+	netif_receive_skb_list_internal(&napi->rx_list);
+}
+
+static void gro_normal_one(struct napi_struct *napi, struct sk_buff *skb)
+{
+	__skb_queue_tail(&napi->rx_list, skb);
+	if (skb_queue_len(&napi->rx_list) >= gro_normal_batch)
+		gro_normal_list(napi);
+}
+
 /* Network device is going away, flush any packets still pending
  * Called with irqs disabled.
  */
@@ -3802,7 +4032,7 @@ static void flush_backlog(void *arg)
 	}
 }
 
-static int napi_gro_complete(struct sk_buff *skb)
+static int napi_gro_complete(struct napi_struct *napi, struct sk_buff *skb)
 {
 	struct packet_offload *ptype;
 	__be16 type = skb->protocol;
@@ -3833,7 +4063,8 @@ static int napi_gro_complete(struct sk_buff *skb)
 	}
 
 out:
-	return netif_receive_skb_internal(skb);
+	gro_normal_one(napi, skb);
+	return NET_RX_SUCCESS;
 }
 
 /* napi->gro_list contains packets ordered by age.
@@ -3854,14 +4085,16 @@ void napi_gro_flush(struct napi_struct *napi, bool flush_old)
 		skb->next = NULL;
 
 		if (flush_old && NAPI_GRO_CB(skb)->age == jiffies)
-			return;
+			goto out;
 
 		prev = skb->prev;
-		napi_gro_complete(skb);
+		napi_gro_complete(napi, skb);
 		napi->gro_count--;
 	}
 
 	napi->gro_list = NULL;
+out:
+	gro_normal_list(napi);
 }
 EXPORT_SYMBOL(napi_gro_flush);
 
@@ -3979,7 +4212,7 @@ static enum gro_result dev_gro_receive(struct napi_struct *napi, struct sk_buff
 
 		*pp = nskb->next;
 		nskb->next = NULL;
-		napi_gro_complete(nskb);
+		napi_gro_complete(napi, nskb);
 		napi->gro_count--;
 	}
 
@@ -3999,7 +4232,7 @@ static enum gro_result dev_gro_receive(struct napi_struct *napi, struct sk_buff
 		}
 		*pp = NULL;
 		nskb->next = NULL;
-		napi_gro_complete(nskb);
+		napi_gro_complete(napi, nskb);
 	} else {
 		napi->gro_count++;
 	}
@@ -4051,12 +4284,13 @@ struct packet_offload *gro_find_complete_by_type(__be16 type)
 }
 EXPORT_SYMBOL(gro_find_complete_by_type);
 
-static gro_result_t napi_skb_finish(gro_result_t ret, struct sk_buff *skb)
+static gro_result_t napi_skb_finish(struct napi_struct *napi,
+				    struct sk_buff *skb,
+				    gro_result_t ret)
 {
 	switch (ret) {
 	case GRO_NORMAL:
-		if (netif_receive_skb_internal(skb))
-			ret = GRO_DROP;
+		gro_normal_one(napi, skb);
 		break;
 
 	case GRO_DROP:
@@ -4084,7 +4318,7 @@ gro_result_t napi_gro_receive(struct napi_struct *napi, struct sk_buff *skb)
 
 	skb_gro_reset_offset(skb);
 
-	return napi_skb_finish(dev_gro_receive(napi, skb), skb);
+	return napi_skb_finish(napi, skb, dev_gro_receive(napi, skb));
 }
 EXPORT_SYMBOL(napi_gro_receive);
 
@@ -4124,8 +4358,8 @@ static gro_result_t napi_frags_finish(struct napi_struct *napi,
 	case GRO_HELD:
 		__skb_push(skb, ETH_HLEN);
 		skb->protocol = eth_type_trans(skb, skb->dev);
-		if (ret == GRO_NORMAL && netif_receive_skb_internal(skb))
-			ret = GRO_DROP;
+		if (ret == GRO_NORMAL)
+			gro_normal_one(napi, skb);
 		break;
 
 	case GRO_DROP:
@@ -4297,7 +4531,9 @@ void __napi_complete(struct napi_struct *n)
 	BUG_ON(!test_bit(NAPI_STATE_SCHED, &n->state));
 	BUG_ON(n->gro_list);
 
-	list_del(&n->poll_list);
+	/* A threaded NAPI isn't on a poll list, keep the entry valid */
+	list_del_init(&n->poll_list);
+	clear_bit(NAPI_STATE_SCHED_THREADED, &n->state);
 	smp_mb__before_atomic();
 	clear_bit(NAPI_STATE_SCHED, &n->state);
 }
@@ -4373,6 +4609,131 @@ void napi_hash_del(struct napi_struct *napi)
 }
 EXPORT_SYMBOL_GPL(napi_hash_del);
 
+static int napi_thread_wait(struct napi_struct *napi)
+{
+	set_current_state(TASK_INTERRUPTIBLE);
+
+	while (!kthread_should_stop()) {
+		/* NAPI_STATE_SCHED alone doesn't mean the poll is ours:
+		 * napi_disable() and netpoll set it too.
+		 */
+		if (test_bit(NAPI_STATE_SCHED_THREADED, &napi->state)) {
+			__set_current_state(TASK_RUNNING);
+			return 0;
+		}
+
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+
+	return -1;
+}
+
+static int napi_threaded_poll(void *data)
+{
+	struct napi_struct *napi = data;
+	int work, weight;
+	void *have;
+
+	while (!napi_thread_wait(napi)) {
+		do {
+			local_bh_disable();
+			have = netpoll_poll_lock(napi);
+
+			weight = napi->weight;
+			work = 0;
+			if (test_bit(NAPI_STATE_SCHED, &napi->state)) {
+				work = napi->poll(napi, weight);
+				trace_napi_poll(napi);
+			}
+
+			WARN_ON_ONCE(work > weight);
+
+			/* As in net_rx_action(), consuming the whole weight
+			 * leaves the NAPI instance with us.
+			 */
+			if (work == weight) {
+				if (unlikely(napi_disable_pending(napi))) {
+					napi_complete(napi);
+					work = 0;
+				} else if (napi->gro_list ||
+					   !skb_queue_empty(&napi->rx_list)) {
+					napi_gro_flush(napi, HZ >= 1000);
+				}
+			}
+
+			netpoll_poll_unlock(have);
+			local_bh_enable();
+
+			cond_resched();
+		} while (work == weight);
+	}
+
+	return 0;
+}
+
+static int napi_kthread_create(struct napi_struct *n)
+{
+	struct napi_struct *older = n;
+	struct task_struct *thread;
+	int index = 0;
+
+	if (n->thread)
+		return 0;
+
+	/* Number the threads in the order the contexts were added */
+	list_for_each_entry_continue(older, &n->dev->napi_list, dev_list)
+		index++;
+
+	thread = kthread_run(napi_threaded_poll, n, "napi/%s-%d",
+			     n->dev->name, index);
+	if (IS_ERR(thread)) {
+		pr_err("kthread_run failed with err %ld\n", PTR_ERR(thread));
+		return PTR_ERR(thread);
+	}
+
+	n->thread = thread;
+	return 0;
+}
+
+int dev_set_threaded(struct net_device *dev, bool threaded)
+{
+	struct napi_struct *napi;
+	int err = 0;
+
+	ASSERT_RTNL();
+
+	if (dev->threaded == threaded)
+		return 0;
+
+	if (threaded) {
+		list_for_each_entry(napi, &dev->napi_list, dev_list) {
+			err = napi_kthread_create(napi);
+			if (err) {
+				threaded = false;
+				break;
+			}
+		}
+	}
+
+	dev->threaded = threaded;
+
+	/* Threads are kept until netif_napi_del() once created; a poll in
+	 * progress finishes where it runs and the next one follows the
+	 * new mode.
+	 */
+	list_for_each_entry(napi, &dev->napi_list, dev_list) {
+		if (threaded)
+			set_bit(NAPI_STATE_THREADED, &napi->state);
+		else
+			clear_bit(NAPI_STATE_THREADED, &napi->state);
+	}
+
+	return err;
+}
+EXPORT_SYMBOL(dev_set_threaded);
+
 void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
 		    int (*poll)(struct napi_struct *, int), int weight)
 {
@@ -4380,6 +4741,7 @@ void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
 	napi->gro_count = 0;
 	napi->gro_list = NULL;
 	napi->skb = NULL;
+	__skb_queue_head_init(&napi->rx_list);
 	napi->poll = poll;
 	if (weight > NAPI_POLL_WEIGHT)
 		pr_err_once("netif_napi_add() called with weight %d on device %s\n",
@@ -4392,17 +4754,31 @@ void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
 	napi->poll_owner = -1;
 #endif
 	set_bit(NAPI_STATE_SCHED, &napi->state);
+
+	napi->thread = NULL;
+	if (dev->threaded) {
+		if (napi_kthread_create(napi))
+			dev->threaded = false;
+		else
+			set_bit(NAPI_STATE_THREADED, &napi->state);
+	}
 }
 EXPORT_SYMBOL(netif_napi_add);
 
 void netif_napi_del(struct napi_struct *napi)
 {
+	if (napi->thread) {
+		kthread_stop(napi->thread);
+		napi->thread = NULL;
+	}
+
 	list_del_init(&napi->dev_list);
 	napi_free_frags(napi);
 
 	kfree_skb_list(napi->gro_list);
 	napi->gro_list = NULL;
 	napi->gro_count = 0;
+	__skb_queue_purge(&napi->rx_list);
 }
 EXPORT_SYMBOL(netif_napi_del);
 
@@ -4468,7 +4844,8 @@ static void net_rx_action(struct softirq_action *h)
 				napi_complete(n);
 				local_irq_disable();
 			} else {
-				if (n->gro_list) {
+				if (n->gro_list ||
+				    !skb_queue_empty(&n->rx_list)) {
 					/* flush too old packets
 					 * If HZ < 1000, flush all packets.
 					 */
@@ -5651,6 +6028,84 @@ int dev_get_phys_port_id(struct net_device *dev,
 }
 EXPORT_SYMBOL(dev_get_phys_port_id);
 
+/**
+ *	dev_change_xdp - set or clear the early RX program of a device
+ *	@dev: device
+ *	@prog: unattached filter to run on received frames, or NULL
+ *
+ *	On success the device owns @prog and releases it, along with any
+ *	previous program, when it is replaced.  On failure the caller
+ *	still owns @prog.
+ */
+int dev_change_xdp(struct net_device *dev, struct sk_filter *prog)
+{
+	const struct net_device_ops *ops = dev->netdev_ops;
+	struct netdev_xdp xdp;
+
+	ASSERT_RTNL();
+
+	if (!ops->ndo_xdp)
+		return -EOPNOTSUPP;
+
+	memset(&xdp, 0, sizeof(xdp));
+	xdp.command = XDP_SETUP_PROG;
+	xdp.prog = prog;
+
+	return ops->ndo_xdp(dev, &xdp);
+}
+EXPORT_SYMBOL(dev_change_xdp);
+
+bool dev_xdp_attached(struct net_device *dev)
+{
+	const struct net_device_ops *ops = dev->netdev_ops;
+	struct netdev_xdp xdp;
+
+	ASSERT_RTNL();
+
+	if (!ops->ndo_xdp)
+		return false;
+
+	memset(&xdp, 0, sizeof(xdp));
+	xdp.command = XDP_QUERY_PROG;
+	if (ops->ndo_xdp(dev, &xdp) < 0)
+		return false;
+
+	return xdp.prog_attached;
+}
+EXPORT_SYMBOL(dev_xdp_attached);
+
+/**
+ *	xdp_do_redirect - transmit a frame redirected by an early RX program
+ *	@skb: frame built by the driver, mac header set
+ *	@act: return value of the program
+ *
+ *	Sends @skb unchanged out of the device named in @act, bypassing
+ *	the receive stack.  Consumes @skb.  Called from the driver's NAPI
+ *	poll.
+ */
+int xdp_do_redirect(struct sk_buff *skb, u32 act)
+{
+	struct net_device *dev;
+
+	rcu_read_lock();
+	dev = dev_get_by_index_rcu(dev_net(skb->dev),
+				   XDP_REDIRECT_IFINDEX(act));
+	if (unlikely(!dev || !(dev->flags & IFF_UP))) {
+		rcu_read_unlock();
+		atomic_long_inc(&skb->dev->rx_dropped);
+		kfree_skb(skb);
+		return NET_RX_DROP;
+	}
+
+	__skb_push(skb, skb->data - skb_mac_header(skb));
+	skb->dev = dev;
+	dev_queue_xmit(skb);
+	rcu_read_unlock();
+
+	return NET_RX_SUCCESS;
+}
+EXPORT_SYMBOL(xdp_do_redirect);
+
 /**
  *	dev_new_index	-	allocate an ifindex
  *	@net: the applicable net namespace
@@ -44,6 +44,7 @@
 #include <linux/ratelimit.h>
 #include <linux/seccomp.h>
 #include <linux/if_vlan.h>
+#include <net/sock_reuseport.h>
 
 /* Registers */
 #define BPF_R0	regs[BPF_REG_0]
@@ -143,6 +144,7 @@ noinline u64 __bpf_call_base(u64 r1, u64 r2, u64 r3, u64 r4, u64 r5)
 {
 	return 0;
 }
+EXPORT_SYMBOL_GPL(__bpf_call_base);
 
 /**
  *	__sk_run_filter - run a filter on a given context
@@ -1634,6 +1636,61 @@ int sk_attach_filter(struct sock_fprog *fprog, struct sock *sk)
 }
 EXPORT_SYMBOL_GPL(sk_attach_filter);
 
+/**
+ *	sk_reuseport_attach_filter - attach a steering filter to a reuseport group
+ *	@fprog: the filter program
+ *	@sk: a socket of the group
+ *
+ * The program is run by reuseport_select_sock() on packets for the group
+ * and returns the index of the member socket that should receive them.
+ * The group owns the filter, so it is not charged to @sk.  A socket that
+ * is not hashed yet gets a group of its own, which it gives up when it
+ * joins an existing group on bind() or listen().
+ */
+int sk_reuseport_attach_filter(struct sock_fprog *fprog, struct sock *sk)
+{
+	unsigned int fsize = sk_filter_proglen(fprog);
+	struct sk_filter *fp;
+	int err;
+
+	if (!sk->sk_reuseport)
+		return -EINVAL;
+
+	/* Make sure new filter is there and in the right amounts. */
+	if (fprog->filter == NULL)
+		return -EINVAL;
+
+	fp = kmalloc(sk_filter_size(fprog->len), GFP_KERNEL);
+	if (!fp)
+		return -ENOMEM;
+
+	if (copy_from_user(fp->insns, fprog->filter, fsize)) {
+		kfree(fp);
+		return -EFAULT;
+	}
+
+	atomic_set(&fp->refcnt, 1);
+	fp->len = fprog->len;
+	fp->orig_prog = NULL;
+
+	fp = __sk_prepare_filter(fp, NULL);
+	if (IS_ERR(fp))
+		return PTR_ERR(fp);
+
+	if (sk_unhashed(sk)) {
+		err = reuseport_alloc(sk);
+		if (err)
+			goto out;
+	}
+
+	err = reuseport_attach_prog(sk, fp);
+	if (!err)
+		return 0;
+out:
+	sk_unattached_filter_destroy(fp);
+	return err;
+}
+
 int sk_detach_filter(struct sock *sk)
 {
 	int ret = -ENOENT;
@@ -12,7 +12,9 @@
 #include <linux/if_tunnel.h>
 #include <linux/if_pppox.h>
 #include <linux/ppp_defs.h>
+#include <linux/udp.h>
 #include <net/flow_keys.h>
+#include <net/protocol.h>
 
 /* copy saddr & daddr, possibly using 64bit load/store
  * Equivalent to :	flow->src = iph->saddr;
@@ -51,7 +53,8 @@ __be32 skb_flow_get_ports(const struct sk_buff *skb, int thoff, u8 ip_proto)
 }
 EXPORT_SYMBOL(skb_flow_get_ports);
 
-bool skb_flow_dissect(const struct sk_buff *skb, struct flow_keys *flow)
+bool __skb_flow_dissect(const struct sk_buff *skb, struct flow_keys *flow,
+			unsigned int flags)
 {
 	int nhoff = skb_network_offset(skb);
 	u8 ip_proto;
@@ -161,16 +164,48 @@ ipv6:
 				proto = eth->h_proto;
 				nhoff += sizeof(*eth);
 			}
+			flow->encap = 1;
 			goto again;
 		}
 		break;
 	}
 	case IPPROTO_IPIP:
+		flow->encap = 1;
 		proto = htons(ETH_P_IP);
 		goto ip;
 	case IPPROTO_IPV6:
+		flow->encap = 1;
 		proto = htons(ETH_P_IPV6);
 		goto ipv6;
+#ifdef CONFIG_INET
+	case IPPROTO_UDP: {
+		const struct udphdr *uh;
+		struct udphdr _uh;
+		const struct ethhdr *eth;
+		struct ethhdr _eth;
+		unsigned int hlen;
+
+		if (!(flags & FLOW_DISSECTOR_F_PARSE_UDP_ENCAP))
+			break;
+		uh = skb_header_pointer(skb, nhoff, sizeof(_uh), &_uh);
+		if (!uh)
+			return false;
+		rcu_read_lock();
+		hlen = udp_offload_encap_hlen(uh->dest);
+		rcu_read_unlock();
+		if (!hlen)
+			break;
+
+		eth = skb_header_pointer(skb, nhoff + sizeof(_uh) + hlen,
+					 sizeof(_eth), &_eth);
+		if (!eth)
+			break;
+		proto = eth->h_proto;
+		nhoff += sizeof(_uh) + hlen + sizeof(*eth);
+		flow->encap = 1;
+		goto again;
+	}
+#endif
 	default:
 		break;
 	}
@@ -181,7 +216,7 @@ ipv6:
 
 	return true;
 }
-EXPORT_SYMBOL(skb_flow_dissect);
+EXPORT_SYMBOL(__skb_flow_dissect);
 
 static u32 hashrnd __read_mostly;
 static __always_inline void __flow_hash_secret_init(void)
@@ -201,6 +236,27 @@ static __always_inline u32 __flow_hash_1word(u32 a)
 	return jhash_1word(a, hashrnd);
 }
 
+static u32 __flow_hash_from_keys(struct flow_keys *keys)
+{
+	u32 hash;
+
+	/* get a consistent hash (same value on both flow directions) */
+	if (((__force u32)keys->dst < (__force u32)keys->src) ||
+	    (((__force u32)keys->dst == (__force u32)keys->src) &&
+	     ((__force u16)keys->port16[1] < (__force u16)keys->port16[0]))) {
+		swap(keys->dst, keys->src);
+		swap(keys->port16[0], keys->port16[1]);
+	}
+
+	hash = __flow_hash_3words((__force u32)keys->dst,
+				  (__force u32)keys->src,
+				  (__force u32)keys->ports);
+	if (!hash)
+		hash = 1;
+
+	return hash;
+}
+
 /*
  * __skb_get_hash: calculate a flow hash based on src/dst addresses
  * and src/dst port numbers.  Sets hash in skb to non-zero hash value
@@ -210,7 +266,6 @@ static __always_inline u32 __flow_hash_1word(u32 a)
 void __skb_get_hash(struct sk_buff *skb)
 {
 	struct flow_keys keys;
-	u32 hash;
 
 	if (!skb_flow_dissect(skb, &keys))
 		return;
@@ -218,23 +273,30 @@ void __skb_get_hash(struct sk_buff *skb)
 	if (keys.ports)
 		skb->l4_hash = 1;
 
-	/* get a consistent hash (same value on both flow directions) */
-	if (((__force u32)keys.dst < (__force u32)keys.src) ||
-	    (((__force u32)keys.dst == (__force u32)keys.src) &&
-	     ((__force u16)keys.port16[1] < (__force u16)keys.port16[0]))) {
-		swap(keys.dst, keys.src);
-		swap(keys.port16[0], keys.port16[1]);
-	}
+	skb->hash = __flow_hash_from_keys(&keys);
+}
+EXPORT_SYMBOL(__skb_get_hash);
 
-	hash = __flow_hash_3words((__force u32)keys.dst,
-				  (__force u32)keys.src,
-				  (__force u32)keys.ports);
-	if (!hash)
-		hash = 1;
+/*
+ * skb_get_encap_hash: like skb_get_hash(), but always dissects the packet,
+ * ignoring the hash the device computed over the outer headers, and also
+ * looks inside UDP tunnels.  Sets *encap if the hash covers inner headers.
+ */
+u32 skb_get_encap_hash(struct sk_buff *skb, bool *encap)
+{
+	struct flow_keys keys;
 
-	skb->hash = hash;
+	*encap = false;
+	if (!__skb_flow_dissect(skb, &keys, FLOW_DISSECTOR_F_PARSE_UDP_ENCAP))
+		return skb_get_hash(skb);
+
+	*encap = keys.encap;
+	skb->l4_hash = !!keys.ports;
+	skb->hash = __flow_hash_from_keys(&keys);
+
+	return skb->hash;
 }
-EXPORT_SYMBOL(__skb_get_hash);
+EXPORT_SYMBOL(skb_get_encap_hash);
 
 /*
  * Returns a Tx hash based on the given packet descriptor a Tx queues' number
@@ -0,0 +1,314 @@
+/*
+ *	page_pool.c - per RX queue recycling of DMA-mapped pages
+ *
+ *	Pages live in one of three places: handed out to the driver or
+ *	the stack, in the NAPI-only alloc cache, or in the recycle ring
+ *	that the skb free path feeds from any context.  Each page the pool
+ *	allocated holds a reference on the pool until it is released back
+ *	to the page allocator, so page_pool_destroy() can be called while
+ *	skbs built on pool pages are still in flight.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version
+ *	2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/device.h>
+#include <linux/dma-mapping.h>
+#include <linux/interrupt.h>
+#include <linux/export.h>
+#include <linux/err.h>
+
+#include <net/page_pool.h>
+
+/* Upper bound on the recycle ring, as for RX ring sizes */
+#define PP_RING_SIZE_MAX	32768
+
+struct page_pool *page_pool_create(const struct page_pool_params *params)
+{
+	struct page_pool *pool;
+
+	if (params->flags & ~PP_FLAG_ALL)
+		return ERR_PTR(-EINVAL);
+	if (!params->pool_size || params->pool_size > PP_RING_SIZE_MAX)
+		return ERR_PTR(-E2BIG);
+
+	if (params->flags & PP_FLAG_DMA_MAP) {
+		if (!params->dev)
+			return ERR_PTR(-EINVAL);
+		if (params->dma_dir != DMA_FROM_DEVICE &&
+		    params->dma_dir != DMA_BIDIRECTIONAL)
+			return ERR_PTR(-EINVAL);
+		/* The DMA address is kept in page->private */
+		if (sizeof(dma_addr_t) > sizeof(unsigned long))
+			return ERR_PTR(-EOPNOTSUPP);
+	}
+
+	pool = kzalloc_node(sizeof(*pool), GFP_KERNEL, params->nid);
+	if (!pool)
+		return ERR_PTR(-ENOMEM);
+
+	pool->ring = kcalloc(params->pool_size, sizeof(*pool->ring),
+			     GFP_KERNEL);
+	if (!pool->ring) {
+		kfree(pool);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	pool->p = *params;
+	spin_lock_init(&pool->ring_lock);
+	atomic_set(&pool->users, 1);
+
+	if (pool->p.flags & PP_FLAG_DMA_MAP)
+		get_device(pool->p.dev);
+
+	return pool;
+}
+EXPORT_SYMBOL(page_pool_create);
+
+static void page_pool_put(struct page_pool *pool)
+{
+	if (!atomic_dec_and_test(&pool->users))
+		return;
+
+	if (pool->p.flags & PP_FLAG_DMA_MAP)
+		put_device(pool->p.dev);
+	kfree(pool->ring);
+	kfree(pool);
+}
+
+static struct page *page_pool_alloc_pages_slow(struct page_pool *pool,
+					       gfp_t gfp)
+{
+	struct page *page;
+	dma_addr_t dma;
+
+	if (pool->p.order)
+		gfp |= __GFP_COMP;
+
+	page = alloc_pages_node(pool->p.nid, gfp, pool->p.order);
+	if (!page)
+		return NULL;
+
+	if (pool->p.flags & PP_FLAG_DMA_MAP) {
+		dma = dma_map_page(pool->p.dev, page, 0,
+				   PAGE_SIZE << pool->p.order, pool->p.dma_dir);
+		if (dma_mapping_error(pool->p.dev, dma)) {
+			__free_pages(page, pool->p.order);
+			return NULL;
+		}
+		set_page_private(page, dma);
+	}
+
+	page->pp_magic = PP_SIGNATURE;
+	page->pp = pool;
+	atomic_inc(&pool->users);
+
+	return page;
+}
+
+/* Move a batch of recycled pages from the ring into the alloc cache */
+static struct page *page_pool_refill_alloc_cache(struct page_pool *pool)
+{
+	unsigned long flags;
+
+	if (!ACCESS_ONCE(pool->ring_count))
+		return NULL;
+
+	spin_lock_irqsave(&pool->ring_lock, flags);
+	while (pool->ring_count && pool->alloc.count < PP_ALLOC_CACHE_REFILL) {
+		pool->alloc.cache[pool->alloc.count++] =
+			pool->ring[pool->ring_head];
+		if (++pool->ring_head == pool->p.pool_size)
+			pool->ring_head = 0;
+		pool->ring_count--;
+	}
+	spin_unlock_irqrestore(&pool->ring_lock, flags);
+
+	if (!pool->alloc.count)
+		return NULL;
+	return pool->alloc.cache[--pool->alloc.count];
+}
+
+/**
+ * page_pool_alloc_pages - get a page for an RX descriptor
+ * @pool: the queue's page pool
+ * @gfp: allocation flags used if no recycled page is available
+ *
+ * Must be called from the pool owner's NAPI context.  With PP_FLAG_DMA_MAP
+ * the page is already mapped, see page_pool_get_dma_addr().
+ */
+struct page *page_pool_alloc_pages(struct page_pool *pool, gfp_t gfp)
+{
+	struct page *page;
+
+	if (likely(pool->alloc.count))
+		return pool->alloc.cache[--pool->alloc.count];
+
+	page = page_pool_refill_alloc_cache(pool);
+	if (page)
+		return page;
+
+	return page_pool_alloc_pages_slow(pool, gfp);
+}
+EXPORT_SYMBOL(page_pool_alloc_pages);
+
+/**
+ * page_pool_release_page - disconnect a page from its pool
+ * @pool: the pool the page was allocated from
+ * @page: the page
+ *
+ * Unmaps the page and drops its reference on @pool.  The caller still
+ * owns its reference on the page and frees it like any other page.
+ */
+void page_pool_release_page(struct page_pool *pool, struct page *page)
+{
+	if (pool->p.flags & PP_FLAG_DMA_MAP) {
+		dma_unmap_page(pool->p.dev, page_pool_get_dma_addr(page),
+			       PAGE_SIZE << pool->p.order, pool->p.dma_dir);
+		set_page_private(page, 0);
+	}
+
+	page->pp_magic = 0;
+	page->pp = NULL;
+	page_pool_put(pool);
+}
+EXPORT_SYMBOL(page_pool_release_page);
+
+static bool page_pool_reusable(struct page_pool *pool, struct page *page)
+{
+	int nid = pool->p.nid == NUMA_NO_NODE ? numa_mem_id() : pool->p.nid;
+
+	return page_count(page) == 1 && !page->pfmemalloc &&
+	       page_to_nid(page) == nid;
+}
+
+static bool page_pool_recycle_in_ring(struct page_pool *pool,
+				      struct page *page)
+{
+	unsigned long flags;
+	unsigned int tail;
+	bool ret = false;
+
+	spin_lock_irqsave(&pool->ring_lock, flags);
+	if (!pool->destroyed && pool->ring_count < pool->p.pool_size) {
+		tail = pool->ring_head + pool->ring_count;
+		if (tail >= pool->p.pool_size)
+			tail -= pool->p.pool_size;
+		pool->ring[tail] = page;
+		pool->ring_count++;
+		ret = true;
+	}
+	spin_unlock_irqrestore(&pool->ring_lock, flags);
+
+	return ret;
+}
+
+/**
+ * page_pool_put_page - return a page the caller holds to its pool
+ * @pool: the pool the page was allocated from
+ * @page: the page
+ * @allow_direct: caller runs in the pool owner's NAPI context
+ *
+ * If the caller held the last reference the page is kept for reuse,
+ * otherwise it is released from the pool and the reference dropped.
+ */
+void page_pool_put_page(struct page_pool *pool, struct page *page,
+			bool allow_direct)
+{
+	if (page_pool_reusable(pool, page)) {
+		if (allow_direct && in_serving_softirq() &&
+		    pool->alloc.count < PP_ALLOC_CACHE_SIZE) {
+			pool->alloc.cache[pool->alloc.count++] = page;
+			return;
+		}
+		if (page_pool_recycle_in_ring(pool, page))
+			return;
+	}
+
+	page_pool_release_page(pool, page);
+	put_page(page);
+}
+EXPORT_SYMBOL(page_pool_put_page);
+
+/**
+ * page_pool_return_skb_page - free path for pages of a recycling skb
+ * @page: page backing the skb head or a fragment
+ *
+ * Returns false if @page is not a page_pool page, in which case the
+ * caller must drop its reference itself.
+ */
+bool page_pool_return_skb_page(struct page *page)
+{
+	struct page_pool *pool;
+
+	page = compound_head(page);
+	if (page->pp_magic != PP_SIGNATURE)
+		return false;
+
+	/*
+	 * Clones, splice and the like can leave several holders of a page
+	 * freeing it concurrently.  Only the one that claims the signature
+	 * deals with the pool; the others just drop their reference.  The
+	 * claimer either is the last holder and recycles the page, or it
+	 * releases the page from the pool for good.
+	 */
+	if (cmpxchg(&page->pp_magic, PP_SIGNATURE, 0) != PP_SIGNATURE)
+		return false;
+
+	pool = page->pp;
+	if (page_pool_reusable(pool, page)) {
+		/* Sole holder, nobody else can be looking at the page */
+		page->pp_magic = PP_SIGNATURE;
+		if (page_pool_recycle_in_ring(pool, page))
+			return true;
+	}
+
+	page_pool_release_page(pool, page);
+	put_page(page);
+	return true;
+}
+EXPORT_SYMBOL(page_pool_return_skb_page);
+
+/**
+ * page_pool_destroy - tear down a pool when its RX queue goes away
+ * @pool: the pool, may be NULL
+ *
+ * Frees all cached pages.  Pages still in flight are released when they
+ * come back and the pool itself is freed with the last of them.
+ */
+void page_pool_destroy(struct page_pool *pool)
+{
+	struct page *page;
+	unsigned long flags;
+
+	if (!pool)
+		return;
+
+	while (pool->alloc.count) {
+		page = pool->alloc.cache[--pool->alloc.count];
+		page_pool_release_page(pool, page);
+		put_page(page);
+	}
+
+	/* Nothing enters the ring once destroyed is set */
+	spin_lock_irqsave(&pool->ring_lock, flags);
+	pool->destroyed = true;
+	spin_unlock_irqrestore(&pool->ring_lock, flags);
+
+	while (pool->ring_count) {
+		page = pool->ring[pool->ring_head];
+		if (++pool->ring_head == pool->p.pool_size)
+			pool->ring_head = 0;
+		pool->ring_count--;
+		page_pool_release_page(pool, page);
+		put_page(page);
+	}
+
+	page_pool_put(pool);
+}
+EXPORT_SYMBOL(page_pool_destroy);
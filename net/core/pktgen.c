@@ -216,6 +216,7 @@
 #define PKTGEN_MAGIC 0xbe9be955
 #define PG_PROC_DIR "pktgen"
 #define PGCTRL	    "pgctrl"
+#define PGRX	    "pgrx"
 
 #define MAX_CFLOWS  65536
 
@@ -403,6 +404,17 @@ struct pktgen_hdr {
 	__be32 tv_usec;
 };
 
+/* log2 usec latency buckets, the last one is open ended */
+#define PKTGEN_RX_BUCKETS	24
+
+struct pktgen_rx_stats {
+	u64	packets;
+	u64	bytes;
+	u64	lat_sum;	/* usec */
+	u32	lat_min;
+	u32	lat_max;
+	u64	hist[PKTGEN_RX_BUCKETS];
+};
 
 static int pg_net_id __read_mostly;
 
@@ -411,6 +423,11 @@ struct pktgen_net {
 	struct proc_dir_entry	*proc_dir;
 	struct list_head	pktgen_threads;
 	bool			pktgen_exiting;
+
+	/* receive side, see pktgen_rx_rcv(); changed under RTNL */
+	struct net_device	*rx_dev;
+	struct packet_type	rx_pt[2];
+	struct pktgen_rx_stats __percpu *rx_stats;
 };
 
 struct pktgen_thread {
@@ -449,6 +466,7 @@ static void pktgen_stop_all_threads_ifs(struct pktgen_net *pn);
 
 static void pktgen_stop(struct pktgen_thread *t);
 static void pktgen_clear_counters(struct pktgen_dev *pkt_dev);
+static void pktgen_rx_disable(struct pktgen_net *pn);
 
 /* Module parameters, defaults. */
 static int pg_count_d __read_mostly = 1000;
@@ -1969,6 +1987,8 @@ static int pktgen_device_event(struct notifier_block *unused,
 
 	case NETDEV_UNREGISTER:
 		pktgen_mark_device(pn, dev->name);
+		if (pn->rx_dev == dev)
+			pktgen_rx_disable(pn);
 		break;
 	}
 
@@ -3716,6 +3736,246 @@ static int pktgen_remove_device(struct pktgen_thread *t,
 	return 0;
 }
 
+/*
+ * Receive side: count pktgen packets arriving on one device and build a
+ * histogram of their latency from the transmit timestamp in the pktgen
+ * header.  Sender and receiver must share a clock, e.g. a loopback cable
+ * or veth pair on the same host, and clone_skb should be 0 so that every
+ * packet carries a fresh timestamp.  Statistics are per cpu, so with RSS
+ * or RPS they also show how receive processing spreads over the cpus.
+ */
+static int pktgen_rx_rcv(struct sk_buff *skb, struct net_device *dev,
+			 struct packet_type *pt, struct net_device *orig_dev)
+{
+	struct pktgen_net *pn = pt->af_packet_priv;
+	struct pktgen_hdr *pgh, _pgh;
+	struct pktgen_rx_stats *st;
+	struct timeval now;
+	unsigned int off;
+	u32 lat;
+	s64 delta;
+
+	if (skb->protocol == htons(ETH_P_IP)) {
+		const struct iphdr *iph;
+		struct iphdr _iph;
+
+		iph = skb_header_pointer(skb, 0, sizeof(_iph), &_iph);
+		if (!iph || iph->protocol != IPPROTO_UDP)
+			goto out;
+		off = iph->ihl * 4;
+	} else {
+		const struct ipv6hdr *ip6h;
+		struct ipv6hdr _ip6h;
+
+		ip6h = skb_header_pointer(skb, 0, sizeof(_ip6h), &_ip6h);
+		if (!ip6h || ip6h->nexthdr != IPPROTO_UDP)
+			goto out;
+		off = sizeof(*ip6h);
+	}
+
+	pgh = skb_header_pointer(skb, off + sizeof(struct udphdr),
+				 sizeof(_pgh), &_pgh);
+	if (!pgh || pgh->pgh_magic != htonl(PKTGEN_MAGIC))
+		goto out;
+
+	do_gettimeofday(&now);
+	delta = (s64)(s32)((u32)now.tv_sec - ntohl(pgh->tv_sec)) * USEC_PER_SEC +
+		(s32)(now.tv_usec - ntohl(pgh->tv_usec));
+	lat = clamp_t(s64, delta, 0, U32_MAX);
+
+	st = this_cpu_ptr(pn->rx_stats);
+	st->packets++;
+	st->bytes += skb->len;
+	st->lat_sum += lat;
+	if (lat < st->lat_min)
+		st->lat_min = lat;
+	if (lat > st->lat_max)
+		st->lat_max = lat;
+	st->hist[lat ? min(ilog2(lat) + 1, PKTGEN_RX_BUCKETS - 1) : 0]++;
+out:
+	consume_skb(skb);
+	return NET_RX_SUCCESS;
+}
+
+static void pktgen_rx_reset(struct pktgen_net *pn)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct pktgen_rx_stats *st = per_cpu_ptr(pn->rx_stats, cpu);
+
+		memset(st, 0, sizeof(*st));
+		st->lat_min = U32_MAX;
+	}
+}
+
+static int pktgen_rx_enable(struct pktgen_net *pn, const char *ifname)
+{
+	struct net_device *dev;
+	int i;
+
+	ASSERT_RTNL();
+
+	if (pn->rx_dev)
+		pktgen_rx_disable(pn);
+
+	dev = dev_get_by_name(pn->net, ifname);
+	if (!dev)
+		return -ENODEV;
+
+	pn->rx_stats = alloc_percpu(struct pktgen_rx_stats);
+	if (!pn->rx_stats) {
+		dev_put(dev);
+		return -ENOMEM;
+	}
+	pktgen_rx_reset(pn);
+
+	pn->rx_dev = dev;
+	pn->rx_pt[0].type = htons(ETH_P_IP);
+	pn->rx_pt[1].type = htons(ETH_P_IPV6);
+	for (i = 0; i < ARRAY_SIZE(pn->rx_pt); i++) {
+		pn->rx_pt[i].dev = dev;
+		pn->rx_pt[i].func = pktgen_rx_rcv;
+		pn->rx_pt[i].af_packet_priv = pn;
+		dev_add_pack(&pn->rx_pt[i]);
+	}
+
+	return 0;
+}
+
+static void pktgen_rx_disable(struct pktgen_net *pn)
+{
+	int i;
+
+	ASSERT_RTNL();
+
+	if (!pn->rx_dev)
+		return;
+
+	/* dev_remove_pack() waits for the handlers to finish */
+	for (i = 0; i < ARRAY_SIZE(pn->rx_pt); i++)
+		dev_remove_pack(&pn->rx_pt[i]);
+
+	free_percpu(pn->rx_stats);
+	pn->rx_stats = NULL;
+	dev_put(pn->rx_dev);
+	pn->rx_dev = NULL;
+}
+
+static int pgrx_show(struct seq_file *seq, void *v)
+{
+	struct pktgen_net *pn = seq->private;
+	struct pktgen_rx_stats sum;
+	u64 lo;
+	int cpu, i;
+
+	rtnl_lock();
+
+	if (!pn->rx_dev) {
+		seq_puts(seq, "RX: disabled\n");
+		goto out;
+	}
+
+	memset(&sum, 0, sizeof(sum));
+	sum.lat_min = U32_MAX;
+
+	seq_printf(seq, "RX: %s\n", pn->rx_dev->name);
+	for_each_online_cpu(cpu) {
+		const struct pktgen_rx_stats *st = per_cpu_ptr(pn->rx_stats, cpu);
+
+		if (!st->packets)
+			continue;
+		seq_printf(seq, "  cpu%d: pkts: %llu bytes: %llu\n", cpu,
+			   (unsigned long long)st->packets,
+			   (unsigned long long)st->bytes);
+
+		sum.packets += st->packets;
+		sum.bytes += st->bytes;
+		sum.lat_sum += st->lat_sum;
+		sum.lat_min = min(sum.lat_min, st->lat_min);
+		sum.lat_max = max(sum.lat_max, st->lat_max);
+		for (i = 0; i < PKTGEN_RX_BUCKETS; i++)
+			sum.hist[i] += st->hist[i];
+	}
+
+	seq_printf(seq, "Total: pkts: %llu bytes: %llu\n",
+		   (unsigned long long)sum.packets,
+		   (unsigned long long)sum.bytes);
+	if (!sum.packets)
+		goto out;
+
+	seq_printf(seq, "Latency (us): min: %u avg: %llu max: %u\n",
+		   sum.lat_min,
+		   (unsigned long long)div64_u64(sum.lat_sum, sum.packets),
+		   sum.lat_max);
+	for (i = 0; i < PKTGEN_RX_BUCKETS; i++) {
+		if (!sum.hist[i])
+			continue;
+		lo = i ? 1ULL << (i - 1) : 0;
+		if (i == PKTGEN_RX_BUCKETS - 1)
+			seq_printf(seq, "  %10llu -      ...: %llu\n",
+				   lo, (unsigned long long)sum.hist[i]);
+		else
+			seq_printf(seq, "  %10llu - %8llu: %llu\n",
+				   lo, (1ULL << i) - 1,
+				   (unsigned long long)sum.hist[i]);
+	}
+out:
+	rtnl_unlock();
+	return 0;
+}
+
+static ssize_t pgrx_write(struct file *file, const char __user *buf,
+			  size_t count, loff_t *ppos)
+{
+	struct seq_file *seq = file->private_data;
+	struct pktgen_net *pn = seq->private;
+	char data[IFNAMSIZ + 8];
+	int ret = 0;
+
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	if (count == 0)
+		return -EINVAL;
+
+	if (count > sizeof(data))
+		count = sizeof(data);
+
+	if (copy_from_user(data, buf, count))
+		return -EFAULT;
+
+	data[count - 1] = 0;	/* Strip trailing '\n' and terminate string */
+
+	rtnl_lock();
+	if (!strncmp(data, "rx ", 3))
+		ret = pktgen_rx_enable(pn, strstrip(data + 3));
+	else if (!strcmp(data, "rx_reset")) {
+		if (pn->rx_dev)
+			pktgen_rx_reset(pn);
+	} else if (!strcmp(data, "rx_disable"))
+		pktgen_rx_disable(pn);
+	else
+		ret = -EINVAL;
+	rtnl_unlock();
+
+	return ret ? ret : count;
+}
+
+static int pgrx_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pgrx_show, PDE_DATA(inode));
+}
+
+static const struct file_operations pktgen_rx_fops = {
+	.owner   = THIS_MODULE,
+	.open    = pgrx_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.write   = pgrx_write,
+	.release = single_release,
+};
+
 static int __net_init pg_net_init(struct net *net)
 {
 	struct pktgen_net *pn = net_generic(net, pg_net_id);
@@ -3736,6 +3996,12 @@ static int __net_init pg_net_init(struct net *net)
 		ret = -EINVAL;
 		goto remove;
 	}
+	pe = proc_create_data(PGRX, 0600, pn->proc_dir, &pktgen_rx_fops, pn);
+	if (pe == NULL) {
+		pr_err("cannot create %s procfs entry\n", PGRX);
+		ret = -EINVAL;
+		goto remove_ctrl;
+	}
 
 	for_each_online_cpu(cpu) {
 		int err;
@@ -3755,6 +4021,8 @@ static int __net_init pg_net_init(struct net *net)
 	return 0;
 
 remove_entry:
+	remove_proc_entry(PGRX, pn->proc_dir);
+remove_ctrl:
 	remove_proc_entry(PGCTRL, pn->proc_dir);
 remove:
 	remove_proc_entry(PG_PROC_DIR, pn->net->proc_net);
@@ -3782,6 +4050,11 @@ static void __net_exit pg_net_exit(struct net *net)
 		kfree(t);
 	}
 
+	rtnl_lock();
+	pktgen_rx_disable(pn);
+	rtnl_unlock();
+
+	remove_proc_entry(PGRX, pn->proc_dir);
 	remove_proc_entry(PGCTRL, pn->proc_dir);
 	remove_proc_entry(PG_PROC_DIR, pn->net->proc_net);
 }
@@ -58,6 +58,7 @@ struct rtnl_link {
 	rtnl_doit_func		doit;
 	rtnl_dumpit_func	dumpit;
 	rtnl_calcit_func 	calcit;
+	unsigned int		flags;
 };
 
 static DEFINE_MUTEX(rtnl_mutex);
@@ -131,7 +132,7 @@ static rtnl_doit_func rtnl_get_doit(int protocol, int msgindex)
 	return tab[msgindex].doit;
 }
 
-static rtnl_dumpit_func rtnl_get_dumpit(int protocol, int msgindex)
+static struct rtnl_link *rtnl_get_dump_link(int protocol, int msgindex)
 {
 	struct rtnl_link *tab;
 
@@ -143,7 +144,7 @@ static rtnl_dumpit_func rtnl_get_dumpit(int protocol, int msgindex)
 	if (tab == NULL || tab[msgindex].dumpit == NULL)
 		tab = rtnl_msg_handlers[PF_UNSPEC];
 
-	return tab[msgindex].dumpit;
+	return &tab[msgindex];
 }
 
 static rtnl_calcit_func rtnl_get_calcit(int protocol, int msgindex)
@@ -162,12 +163,13 @@ static rtnl_calcit_func rtnl_get_calcit(int protocol, int msgindex)
 }
 
 /**
- * __rtnl_register - Register a rtnetlink message type
+ * __rtnl_register_flags - Register a rtnetlink message type
  * @protocol: Protocol family or PF_UNSPEC
  * @msgtype: rtnetlink message type
  * @doit: Function pointer called for each request message
  * @dumpit: Function pointer called for each dump request (NLM_F_DUMP) message
  * @calcit: Function pointer to calc size of dump message
+ * @flags: RTNL_FLAG_* flags applying to @dumpit
  *
  * Registers the specified function pointers (at least one of them has
  * to be non-NULL) to be called whenever a request message for the
@@ -177,11 +179,15 @@ static rtnl_calcit_func rtnl_get_calcit(int protocol, int msgindex)
  * function pointers for the case when no entry for the specific protocol
  * family exists.
  *
+ * Dump functions are called with the RTNL held unless
+ * RTNL_FLAG_DUMP_UNLOCKED is given, in which case they must only rely
+ * on RCU and the locks of the objects they walk.
+ *
  * Returns 0 on success or a negative error code.
  */
-int __rtnl_register(int protocol, int msgtype,
-		    rtnl_doit_func doit, rtnl_dumpit_func dumpit,
-		    rtnl_calcit_func calcit)
+int __rtnl_register_flags(int protocol, int msgtype,
+			  rtnl_doit_func doit, rtnl_dumpit_func dumpit,
+			  rtnl_calcit_func calcit, unsigned int flags)
 {
 	struct rtnl_link *tab;
 	int msgindex;
@@ -201,14 +207,31 @@ int __rtnl_register(int protocol, int msgtype,
 	if (doit)
 		tab[msgindex].doit = doit;
 
-	if (dumpit)
+	if (dumpit) {
 		tab[msgindex].dumpit = dumpit;
+		tab[msgindex].flags = flags;
+	}
 
 	if (calcit)
 		tab[msgindex].calcit = calcit;
 
 	return 0;
 }
+EXPORT_SYMBOL_GPL(__rtnl_register_flags);
+
+/**
+ * __rtnl_register - Register a rtnetlink message type
+ *
+ * Identical to __rtnl_register_flags() without any flags, the dump
+ * function is called with the RTNL held.
+ */
+int __rtnl_register(int protocol, int msgtype,
+		    rtnl_doit_func doit, rtnl_dumpit_func dumpit,
+		    rtnl_calcit_func calcit)
+{
+	return __rtnl_register_flags(protocol, msgtype, doit, dumpit, calcit,
+				     0);
+}
 EXPORT_SYMBOL_GPL(__rtnl_register);
 
 /**
@@ -231,6 +254,24 @@ void rtnl_register(int protocol, int msgtype,
 }
 EXPORT_SYMBOL_GPL(rtnl_register);
 
+/**
+ * rtnl_register_flags - Register a rtnetlink message type
+ *
+ * Identical to __rtnl_register_flags() but panics on failure, see
+ * rtnl_register().
+ */
+void rtnl_register_flags(int protocol, int msgtype,
+			 rtnl_doit_func doit, rtnl_dumpit_func dumpit,
+			 rtnl_calcit_func calcit, unsigned int flags)
+{
+	if (__rtnl_register_flags(protocol, msgtype, doit, dumpit, calcit,
+				  flags) < 0)
+		panic("Unable to register rtnetlink message handler, "
+		      "protocol = %d, message type = %d\n",
+		      protocol, msgtype);
+}
+EXPORT_SYMBOL_GPL(rtnl_register_flags);
+
 /**
  * rtnl_unregister - Unregister a rtnetlink message type
  * @protocol: Protocol family or PF_UNSPEC
@@ -250,6 +291,7 @@ int rtnl_unregister(int protocol, int msgtype)
 
 	rtnl_msg_handlers[protocol][msgindex].doit = NULL;
 	rtnl_msg_handlers[protocol][msgindex].dumpit = NULL;
+	rtnl_msg_handlers[protocol][msgindex].flags = 0;
 
 	return 0;
 }
@@ -832,6 +874,15 @@ static size_t rtnl_port_size(const struct net_device *dev,
 		return port_self_size;
 }
 
+static size_t rtnl_xdp_size(const struct net_device *dev)
+{
+	if (!dev->netdev_ops->ndo_xdp)
+		return 0;
+
+	return nla_total_size(0) +	/* nest IFLA_XDP */
+	       nla_total_size(1);	/* IFLA_XDP_ATTACHED */
+}
+
 static noinline size_t if_nlmsg_size(const struct net_device *dev,
 				     u32 ext_filter_mask)
 {
@@ -862,7 +913,8 @@ static noinline size_t if_nlmsg_size(const struct net_device *dev,
 	       + rtnl_port_size(dev, ext_filter_mask) /* IFLA_VF_PORTS + IFLA_PORT_SELF */
 	       + rtnl_link_get_size(dev) /* IFLA_LINKINFO */
 	       + rtnl_link_get_af_size(dev) /* IFLA_AF_SPEC */
-	       + nla_total_size(MAX_PHYS_PORT_ID_LEN); /* IFLA_PHYS_PORT_ID */
+	       + nla_total_size(MAX_PHYS_PORT_ID_LEN) /* IFLA_PHYS_PORT_ID */
+	       + rtnl_xdp_size(dev); /* IFLA_XDP */
 }
 
 static int rtnl_vf_ports_fill(struct sk_buff *skb, struct net_device *dev)
@@ -943,6 +995,26 @@ static int rtnl_port_fill(struct sk_buff *skb, struct net_device *dev,
 	return 0;
 }
 
+static int rtnl_xdp_fill(struct sk_buff *skb, struct net_device *dev)
+{
+	struct nlattr *xdp;
+
+	if (!dev->netdev_ops->ndo_xdp)
+		return 0;
+
+	xdp = nla_nest_start(skb, IFLA_XDP);
+	if (!xdp)
+		return -EMSGSIZE;
+
+	if (nla_put_u8(skb, IFLA_XDP_ATTACHED, dev_xdp_attached(dev))) {
+		nla_nest_cancel(skb, xdp);
+		return -EMSGSIZE;
+	}
+
+	nla_nest_end(skb, xdp);
+	return 0;
+}
+
 static int rtnl_phys_port_id_fill(struct sk_buff *skb, struct net_device *dev)
 {
 	int err;
@@ -1033,6 +1105,9 @@ static int rtnl_fill_ifinfo(struct sk_buff *skb, struct net_device *dev,
 	if (rtnl_phys_port_id_fill(skb, dev))
 		goto nla_put_failure;
 
+	if (rtnl_xdp_fill(skb, dev))
+		goto nla_put_failure;
+
 	attr = nla_reserve(skb, IFLA_STATS,
 			sizeof(struct rtnl_link_stats));
 	if (attr == NULL)
@@ -1192,6 +1267,14 @@ static const struct nla_policy ifla_policy[IFLA_MAX+1] = {
 	[IFLA_NUM_RX_QUEUES]	= { .type = NLA_U32 },
 	[IFLA_PHYS_PORT_ID]	= { .type = NLA_BINARY, .len = MAX_PHYS_PORT_ID_LEN },
 	[IFLA_CARRIER_CHANGES]	= { .type = NLA_U32 },  /* ignored */
+	[IFLA_XDP]		= { .type = NLA_NESTED },
+};
+
+static const struct nla_policy ifla_xdp_policy[IFLA_XDP_MAX + 1] = {
+	[IFLA_XDP_OPS_LEN]	= { .type = NLA_U16 },
+	[IFLA_XDP_OPS]		= { .type = NLA_BINARY,
+				    .len = sizeof(struct sock_filter) * BPF_MAXINSNS },
+	[IFLA_XDP_ATTACHED]	= { .type = NLA_U8 },
 };
 
 static const struct nla_policy ifla_info_policy[IFLA_INFO_MAX+1] = {
@@ -1475,6 +1558,46 @@ static int do_set_master(struct net_device *dev, int ifindex)
 	return 0;
 }
 
+static int rtnl_set_xdp(struct net_device *dev, struct nlattr *attr)
+{
+	struct nlattr *xdp[IFLA_XDP_MAX + 1];
+	struct sock_fprog_kern fprog;
+	struct sk_filter *prog = NULL;
+	u16 len;
+	int err;
+
+	err = nla_parse_nested(xdp, IFLA_XDP_MAX, attr, ifla_xdp_policy);
+	if (err < 0)
+		return err;
+
+	if (xdp[IFLA_XDP_ATTACHED])
+		return -EINVAL;
+
+	if (!xdp[IFLA_XDP_OPS])
+		return dev_change_xdp(dev, NULL);
+
+	if (!xdp[IFLA_XDP_OPS_LEN])
+		return -EINVAL;
+
+	len = nla_get_u16(xdp[IFLA_XDP_OPS_LEN]);
+	if (len == 0 || len > BPF_MAXINSNS ||
+	    nla_len(xdp[IFLA_XDP_OPS]) != len * sizeof(struct sock_filter))
+		return -EINVAL;
+
+	fprog.len = len;
+	fprog.filter = nla_data(xdp[IFLA_XDP_OPS]);
+
+	err = sk_unattached_filter_create(&prog, &fprog);
+	if (err)
+		return err;
+
+	err = dev_change_xdp(dev, prog);
+	if (err)
+		sk_unattached_filter_destroy(prog);
+
+	return err;
+}
+
 static int do_setlink(const struct sk_buff *skb,
 		      struct net_device *dev, struct ifinfomsg *ifm,
 		      struct nlattr **tb, char *ifname, int modified)
@@ -1698,6 +1821,13 @@ static int do_setlink(const struct sk_buff *skb,
 	}
 	err = 0;
 
+	if (tb[IFLA_XDP]) {
+		err = rtnl_set_xdp(dev, tb[IFLA_XDP]);
+		if (err < 0)
+			goto errout;
+		modified = 1;
+	}
+
 errout:
 	if (err < 0 && modified)
 		net_warn_ratelimited("A link change request failed with some changes committed already. Interface %s may have been left with an inconsistent configuration, please check.\n",
@@ -2162,6 +2292,22 @@ static u16 rtnl_calcit(struct sk_buff *skb, struct nlmsghdr *nlh)
 	return min_ifinfo_dump_size;
 }
 
+/* The rtnetlink socket has no cb_mutex of its own, so dumps run under the
+ * mutex of the requesting socket only.  Those that still depend on the
+ * RTNL take it here, once per skb filled.
+ */
+static int rtnl_dump_locked(struct sk_buff *skb, struct netlink_callback *cb)
+{
+	rtnl_dumpit_func dumpit = cb->data;
+	int err;
+
+	rtnl_lock();
+	err = dumpit(skb, cb);
+	rtnl_unlock();
+
+	return err;
+}
+
 static int rtnl_dump_all(struct sk_buff *skb, struct netlink_callback *cb)
 {
 	int idx;
@@ -2867,13 +3013,20 @@ static int rtnetlink_rcv_msg(struct sk_buff *skb, struct nlmsghdr *nlh)
 
 	if (kind == 2 && nlh->nlmsg_flags&NLM_F_DUMP) {
 		struct sock *rtnl;
+		struct rtnl_link *link;
 		rtnl_dumpit_func dumpit;
 		rtnl_calcit_func calcit;
 		u16 min_dump_alloc = 0;
+		void *data = NULL;
 
-		dumpit = rtnl_get_dumpit(family, type);
+		link = rtnl_get_dump_link(family, type);
+		dumpit = link->dumpit;
 		if (dumpit == NULL)
 			return -EOPNOTSUPP;
+		if (!(link->flags & RTNL_FLAG_DUMP_UNLOCKED)) {
+			data = dumpit;
+			dumpit = rtnl_dump_locked;
+		}
 		calcit = rtnl_get_calcit(family, type);
 		if (calcit)
 			min_dump_alloc = calcit(skb, nlh);
@@ -2883,6 +3036,7 @@ static int rtnetlink_rcv_msg(struct sk_buff *skb, struct nlmsghdr *nlh)
 		{
 			struct netlink_dump_control c = {
 				.dump		= dumpit,
+				.data		= data,
 				.min_dump_alloc	= min_dump_alloc,
 			};
 			err = netlink_dump_start(rtnl, skb, nlh, &c);
@@ -2941,7 +3095,6 @@ static int __net_init rtnetlink_net_init(struct net *net)
 	struct netlink_kernel_cfg cfg = {
 		.groups		= RTNLGRP_MAX,
 		.input		= rtnetlink_rcv,
-		.cb_mutex	= &rtnl_mutex,
 		.flags		= NL_CFG_F_NONROOT_RECV,
 	};
 
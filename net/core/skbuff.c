@@ -69,6 +69,7 @@
 #include <net/checksum.h>
 #include <net/ip6_checksum.h>
 #include <net/xfrm.h>
+#include <net/page_pool.h>
 
 #include <asm/uaccess.h>
 #include <trace/events/skb.h>
@@ -480,10 +481,17 @@ static void skb_clone_fraglist(struct sk_buff *skb)
 		skb_get(list);
 }
 
+static void skb_page_unref(const struct sk_buff *skb, struct page *page)
+{
+	if (skb->pp_recycle && page_pool_return_skb_page(page))
+		return;
+	put_page(page);
+}
+
 static void skb_free_head(struct sk_buff *skb)
 {
 	if (skb->head_frag)
-		put_page(virt_to_head_page(skb->head));
+		skb_page_unref(skb, virt_to_head_page(skb->head));
 	else
 		kfree(skb->head);
 }
@@ -496,7 +504,8 @@ static void skb_release_data(struct sk_buff *skb)
 		if (skb_shinfo(skb)->nr_frags) {
 			int i;
 			for (i = 0; i < skb_shinfo(skb)->nr_frags; i++)
-				skb_frag_unref(skb, i);
+				skb_page_unref(skb,
+					skb_frag_page(&skb_shinfo(skb)->frags[i]));
 		}
 
 		/*
@@ -720,6 +729,9 @@ static void __copy_skb_header(struct sk_buff *new, const struct sk_buff *old)
 	new->vlan_tci		= old->vlan_tci;
 
 	skb_copy_secmark(new, old);
+#ifdef CONFIG_NET_STACK_LATENCY
+	new->lat_stamp		= old->lat_stamp;
+#endif
 
 #ifdef CONFIG_NET_RX_BUSY_POLL
 	new->napi_id	= old->napi_id;
@@ -749,6 +761,7 @@ static struct sk_buff *__skb_clone(struct sk_buff *n, struct sk_buff *skb)
 	C(end);
 	C(head);
 	C(head_frag);
+	C(pp_recycle);
 	C(data);
 	C(truesize);
 	atomic_set(&n->users, 1);
@@ -777,6 +790,220 @@ struct sk_buff *skb_morph(struct sk_buff *dst, struct sk_buff *src)
 }
 EXPORT_SYMBOL_GPL(skb_morph);
 
+static void sock_rmem_free(struct sk_buff *skb);
+
+#define skb_from_uarg(uarg) container_of((void *)uarg, struct sk_buff, cb)
+
+/**
+ *	sock_zerocopy_alloc - allocate the completion state of a send
+ *	@sk: socket sending with %MSG_ZEROCOPY
+ *
+ *	The ubuf_info lives in the control buffer of an empty skb, which is
+ *	what gets queued on the error queue of @sk once the last skb
+ *	referencing the user pages is gone.  The caller starts out with the
+ *	only reference, every skb holding the pages takes another one.
+ */
+struct ubuf_info *sock_zerocopy_alloc(struct sock *sk)
+{
+	struct ubuf_info *uarg;
+	struct sk_buff *skb;
+
+	skb = alloc_skb(0, sk->sk_allocation);
+	if (!skb)
+		return NULL;
+
+	BUILD_BUG_ON(sizeof(*uarg) > sizeof(skb->cb));
+	uarg = (void *)skb->cb;
+
+	uarg->callback = sock_zerocopy_callback;
+	uarg->ctx = sk;
+	uarg->desc = 0;
+	uarg->id = ((u32)atomic_inc_return(&sk->sk_zckey)) - 1;
+	uarg->zerocopy = 1;
+	atomic_set(&uarg->refcnt, 1);
+	sock_hold(sk);
+
+	return uarg;
+}
+EXPORT_SYMBOL_GPL(sock_zerocopy_alloc);
+
+/* fold the completion of @id into a notification still on the queue */
+static bool skb_zerocopy_notify_extend(struct sk_buff *skb, u32 id, u8 code)
+{
+	struct sock_exterr_skb *serr = SKB_EXT_ERR(skb);
+
+	if (serr->ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY ||
+	    serr->ee.ee_code != code || serr->ee.ee_data + 1 != id)
+		return false;
+
+	serr->ee.ee_data = id;
+	return true;
+}
+
+void sock_zerocopy_callback(struct ubuf_info *uarg, bool success)
+{
+	struct sk_buff *tail, *skb = skb_from_uarg(uarg);
+	struct sock_exterr_skb *serr;
+	struct sock *sk = uarg->ctx;
+	struct sk_buff_head *q;
+	unsigned long flags;
+	u8 code;
+	u32 id;
+
+	if (!success)
+		uarg->zerocopy = 0;
+
+	if (!atomic_dec_and_test(&uarg->refcnt))
+		return;
+
+	/* serr overlays uarg in skb->cb */
+	id = uarg->id;
+	code = uarg->zerocopy ? 0 : SO_EE_CODE_ZEROCOPY_COPIED;
+
+	serr = SKB_EXT_ERR(skb);
+	memset(serr, 0, sizeof(*serr));
+	serr->ee.ee_errno = 0;
+	serr->ee.ee_origin = SO_EE_ORIGIN_ZEROCOPY;
+	serr->ee.ee_code = code;
+	serr->ee.ee_info = id;
+	serr->ee.ee_data = id;
+
+	q = &sk->sk_error_queue;
+	spin_lock_irqsave(&q->lock, flags);
+	tail = skb_peek_tail(q);
+	if (!tail || !skb_zerocopy_notify_extend(tail, id, code)) {
+		skb->sk = sk;
+		skb->destructor = sock_rmem_free;
+		atomic_add(skb->truesize, &sk->sk_rmem_alloc);
+		__skb_queue_tail(q, skb);
+		skb = NULL;
+	}
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	if (!sock_flag(sk, SOCK_DEAD))
+		sk->sk_error_report(sk);
+
+	consume_skb(skb);
+	sock_put(sk);
+}
+EXPORT_SYMBOL_GPL(sock_zerocopy_callback);
+
+void sock_zerocopy_put(struct ubuf_info *uarg)
+{
+	if (uarg)
+		sock_zerocopy_callback(uarg, true);
+}
+EXPORT_SYMBOL_GPL(sock_zerocopy_put);
+
+/*
+ * Drop the reference of a send that failed.  If no skb took the pages,
+ * nobody needs to hear about it and the id is handed out again.  Called
+ * with the socket locked.
+ */
+void sock_zerocopy_put_abort(struct ubuf_info *uarg)
+{
+	struct sock *sk;
+
+	if (!uarg)
+		return;
+
+	if (atomic_read(&uarg->refcnt) != 1) {
+		sock_zerocopy_put(uarg);
+		return;
+	}
+
+	sk = uarg->ctx;
+	atomic_dec(&sk->sk_zckey);
+	kfree_skb(skb_from_uarg(uarg));
+	sock_put(sk);
+}
+EXPORT_SYMBOL_GPL(sock_zerocopy_put_abort);
+
+/**
+ *	skb_zerocopy_iter_stream - pin user pages into the frags of an skb
+ *	@sk: socket the skb is queued on
+ *	@skb: skb to extend
+ *	@from: user buffer
+ *	@length: bytes available at @from
+ *	@uarg: completion state of the send
+ *
+ *	Returns the number of bytes added, which may be less than @length.
+ *	Returns -EEXIST if @skb already belongs to another send and
+ *	-EMSGSIZE if it has no room left, the caller then needs a new skb.
+ *	The caller must have charged the memory to @sk already.
+ */
+int skb_zerocopy_iter_stream(struct sock *sk, struct sk_buff *skb,
+			     unsigned char __user *from, int length,
+			     struct ubuf_info *uarg)
+{
+	struct ubuf_info *orig_uarg = skb_zcopy(skb);
+	struct page *pages[MAX_SKB_FRAGS];
+	unsigned long addr = (unsigned long)from;
+	int i = skb_shinfo(skb)->nr_frags;
+	int n, pg, offset, copied = 0;
+
+	if (orig_uarg && uarg != orig_uarg)
+		return -EEXIST;
+
+	offset = offset_in_page(addr);
+	n = min_t(int, MAX_SKB_FRAGS - i,
+		  DIV_ROUND_UP(offset + length, PAGE_SIZE));
+	if (n <= 0)
+		return -EMSGSIZE;
+
+	n = get_user_pages_fast(addr & PAGE_MASK, n, 0, pages);
+	if (n <= 0)
+		return n ? n : -EFAULT;
+
+	for (pg = 0; pg < n && copied < length; pg++) {
+		int size = min_t(int, length - copied, PAGE_SIZE - offset);
+
+		if (skb_can_coalesce(skb, i, pages[pg], offset)) {
+			skb_frag_size_add(&skb_shinfo(skb)->frags[i - 1], size);
+			put_page(pages[pg]);
+		} else {
+			skb_fill_page_desc(skb, i++, pages[pg], offset, size);
+		}
+
+		copied += size;
+		offset = 0;
+	}
+
+	while (pg < n)
+		put_page(pages[pg++]);
+
+	skb->len += copied;
+	skb->data_len += copied;
+	skb->truesize += copied;
+	sk->sk_wmem_queued += copied;
+	sk_mem_charge(sk, copied);
+
+	skb_zcopy_set(skb, uarg);
+	return copied;
+}
+EXPORT_SYMBOL_GPL(skb_zerocopy_iter_stream);
+
+/* let @nskb, which got frags of @orig, hold on to the completion too */
+static int skb_zerocopy_clone(struct sk_buff *nskb, struct sk_buff *orig,
+			      gfp_t gfp_mask)
+{
+	if (skb_zcopy(orig)) {
+		if (skb_zcopy(nskb)) {
+			/* callers without gfp_mask pass a fresh nskb */
+			if (!gfp_mask) {
+				WARN_ON_ONCE(1);
+				return -ENOMEM;
+			}
+			if (skb_uarg(nskb) == skb_uarg(orig))
+				return 0;
+			if (skb_copy_ubufs(nskb, gfp_mask))
+				return -EIO;
+		}
+		skb_zcopy_set(nskb, skb_uarg(orig));
+	}
+	return 0;
+}
+
 /**
  *	skb_copy_ubufs	-	copy userspace skb frags buffers to kernel
  *	@skb: the skb to modify
@@ -1004,6 +1231,12 @@ struct sk_buff *__pskb_copy_fclone(struct sk_buff *skb, int headroom,
 			skb_frag_ref(skb, i);
 		}
 		skb_shinfo(n)->nr_frags = i;
+
+		if (skb_zerocopy_clone(n, skb, gfp_mask)) {
+			kfree_skb(n);
+			n = NULL;
+			goto out;
+		}
 	}
 
 	if (skb_has_frag_list(skb)) {
@@ -1074,6 +1307,9 @@ int pskb_expand_head(struct sk_buff *skb, int nhead, int ntail,
 		/* copy this zero copy skb frags */
 		if (skb_orphan_frags(skb, gfp_mask))
 			goto nofrags;
+		/* both heads now point to the uarg */
+		if (skb_zcopy(skb))
+			sock_zerocopy_get(skb_uarg(skb));
 		for (i = 0; i < skb_shinfo(skb)->nr_frags; i++)
 			skb_frag_ref(skb, i);
 
@@ -1789,15 +2025,43 @@ static bool __skb_splice_bits(struct sk_buff *skb, struct pipe_inode_info *pipe,
 	return false;
 }
 
+ssize_t skb_socket_splice(struct sock *sk, struct pipe_inode_info *pipe,
+			  struct splice_pipe_desc *spd)
+{
+	ssize_t ret;
+
+	/*
+	 * Drop the socket lock, otherwise we have reverse
+	 * locking dependencies between sk_lock and i_mutex
+	 * here as compared to sendfile(). We enter here
+	 * with the socket lock held, and splice_to_pipe() will
+	 * grab the pipe inode lock. For sendfile() emulation,
+	 * we call into ->sendpage() with the i_mutex lock held
+	 * and networking will grab the socket lock.
+	 */
+	release_sock(sk);
+	ret = splice_to_pipe(pipe, spd);
+	lock_sock(sk);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(skb_socket_splice);
+
 /*
  * Map data from the skb to a pipe. Should handle both the linear part,
  * the fragments, and the frag list. It does NOT handle frag lists within
  * the frag list, if such a thing exists. We'd probably need to recurse to
  * handle that cleanly.
+ *
+ * @splice_cb hands the pages to the pipe and is expected to drop the
+ * locks the caller holds on @sk meanwhile, see skb_socket_splice().
  */
-int skb_splice_bits(struct sk_buff *skb, unsigned int offset,
+int skb_splice_bits(struct sk_buff *skb, struct sock *sk, unsigned int offset,
 		    struct pipe_inode_info *pipe, unsigned int tlen,
-		    unsigned int flags)
+		    unsigned int flags,
+		    ssize_t (*splice_cb)(struct sock *,
+					 struct pipe_inode_info *,
+					 struct splice_pipe_desc *))
 {
 	struct partial_page partial[MAX_SKB_FRAGS];
 	struct page *pages[MAX_SKB_FRAGS];
@@ -1810,7 +2074,6 @@ int skb_splice_bits(struct sk_buff *skb, unsigned int offset,
 		.spd_release = sock_spd_release,
 	};
 	struct sk_buff *frag_iter;
-	struct sock *sk = skb->sk;
 	int ret = 0;
 
 	/*
@@ -1833,20 +2096,8 @@ int skb_splice_bits(struct sk_buff *skb, unsigned int offset,
 	}
 
 done:
-	if (spd.nr_pages) {
-		/*
-		 * Drop the socket lock, otherwise we have reverse
-		 * locking dependencies between sk_lock and i_mutex
-		 * here as compared to sendfile(). We enter here
-		 * with the socket lock held, and splice_to_pipe() will
-		 * grab the pipe inode lock. For sendfile() emulation,
-		 * we call into ->sendpage() with the i_mutex lock held
-		 * and networking will grab the socket lock.
-		 */
-		release_sock(sk);
-		ret = splice_to_pipe(pipe, &spd);
-		lock_sock(sk);
-	}
+	if (spd.nr_pages)
+		ret = splice_cb(sk, pipe, &spd);
 
 	return ret;
 }
@@ -1969,10 +2220,19 @@ __wsum __skb_checksum(const struct sk_buff *skb, int offset, int len,
 			if (copy > len)
 				copy = len;
 			vaddr = kmap_atomic(skb_frag_page(frag));
-			csum2 = ops->update(vaddr + frag->page_offset +
-					    offset - start, copy, 0);
+			/* At an even position the running sum can be fed
+			 * straight into update(), saving a combine() per
+			 * fragment.
+			 */
+			if (!(pos & 1)) {
+				csum = ops->update(vaddr + frag->page_offset +
+						   offset - start, copy, csum);
+			} else {
+				csum2 = ops->update(vaddr + frag->page_offset +
+						    offset - start, copy, 0);
+				csum = ops->combine(csum, csum2, pos, copy);
+			}
 			kunmap_atomic(vaddr);
-			csum = ops->combine(csum, csum2, pos, copy);
 			if (!(len -= copy))
 				return csum;
 			offset += copy;
@@ -1991,9 +2251,14 @@ __wsum __skb_checksum(const struct sk_buff *skb, int offset, int len,
 			__wsum csum2;
 			if (copy > len)
 				copy = len;
-			csum2 = __skb_checksum(frag_iter, offset - start,
-					       copy, 0, ops);
-			csum = ops->combine(csum, csum2, pos, copy);
+			if (!(pos & 1)) {
+				csum = __skb_checksum(frag_iter, offset - start,
+						      copy, csum, ops);
+			} else {
+				csum2 = __skb_checksum(frag_iter, offset - start,
+						       copy, 0, ops);
+				csum = ops->combine(csum, csum2, pos, copy);
+			}
 			if ((len -= copy) == 0)
 				return csum;
 			offset += copy;
@@ -2176,7 +2441,7 @@ skb_zerocopy(struct sk_buff *to, struct sk_buff *from, int len, int hlen)
 	to->len += len + plen;
 	to->data_len += len + plen;
 
-	if (unlikely(skb_orphan_frags(from, GFP_ATOMIC))) {
+	if (unlikely(skb_orphan_frags_rx(from, GFP_ATOMIC))) {
 		skb_tx_error(from);
 		return -ENOMEM;
 	}
@@ -2457,6 +2722,7 @@ void skb_split(struct sk_buff *skb, struct sk_buff *skb1, const u32 len)
 	int pos = skb_headlen(skb);
 
 	skb_shinfo(skb1)->tx_flags = skb_shinfo(skb)->tx_flags & SKBTX_SHARED_FRAG;
+	skb_zerocopy_clone(skb1, skb, 0);
 	if (len < pos)	/* Split line is inside header. */
 		skb_split_inside_header(skb, skb1, len, pos);
 	else		/* Second chunk has no header, nothing to copy. */
@@ -2499,6 +2765,10 @@ int skb_shift(struct sk_buff *tgt, struct sk_buff *skb, int shiftlen)
 	BUG_ON(shiftlen > skb->len);
 	BUG_ON(skb_headlen(skb));	/* Would corrupt stream */
 
+	/* frags of different sends can't share one completion */
+	if (skb_zcopy(tgt) || skb_zcopy(skb))
+		return 0;
+
 	todo = shiftlen;
 	from = 0;
 	to = skb_shinfo(tgt)->nr_frags;
@@ -3027,7 +3297,9 @@ struct sk_buff *skb_segment(struct sk_buff *head_skb,
 				goto err;
 			}
 
-			if (unlikely(skb_orphan_frags(frag_skb, GFP_ATOMIC)))
+			if (unlikely(skb_orphan_frags(frag_skb, GFP_ATOMIC) ||
+				     skb_zerocopy_clone(nskb, frag_skb,
+							GFP_ATOMIC)))
 				goto err;
 
 			*nskb_frag = *frag;
@@ -3092,7 +3364,11 @@ int skb_gro_receive(struct sk_buff **head, struct sk_buff *skb)
 	lp = NAPI_GRO_CB(p)->last;
 	pinfo = skb_shinfo(lp);
 
-	if (headlen <= offset) {
+	/* Pages may only move between skbs that free them the same way */
+	if (lp->pp_recycle != skb->pp_recycle) {
+		if (pinfo->frag_list)
+			goto merge;
+	} else if (headlen <= offset) {
 		skb_frag_t *frag;
 		skb_frag_t *frag2;
 		int i = skbinfo->nr_frags;
@@ -3851,6 +4127,9 @@ bool skb_try_coalesce(struct sk_buff *to, struct sk_buff *from,
 		return true;
 	}
 
+	if (to->pp_recycle != from->pp_recycle)
+		return false;
+
 	if (skb_has_frag_list(to) || skb_has_frag_list(from))
 		return false;
 
@@ -3952,6 +4231,9 @@ unsigned int skb_gso_transport_seglen(const struct sk_buff *skb)
 	if (likely(shinfo->gso_type & (SKB_GSO_TCPV4 | SKB_GSO_TCPV6)))
 		return tcp_hdrlen(skb) + shinfo->gso_size;
 
+	if (shinfo->gso_type & SKB_GSO_UDP_L4)
+		return sizeof(struct udphdr) + shinfo->gso_size;
+
 	/* UFO sets gso_size to the size of the fragmentation
 	 * payload, i.e. the size of the L4 (UDP) header is already
 	 * accounted for.
@@ -117,6 +117,7 @@
 #include <linux/static_key.h>
 #include <linux/memcontrol.h>
 #include <linux/prefetch.h>
+#include <linux/cpu.h>
 
 #include <asm/uaccess.h>
 
@@ -141,6 +142,7 @@
 #endif
 
 #include <net/busy_poll.h>
+#include <net/sock_reuseport.h>
 
 static DEFINE_MUTEX(proto_list_mutex);
 static LIST_HEAD(proto_list);
@@ -325,6 +327,9 @@ __u32 sysctl_rmem_default __read_mostly = SK_RMEM_MAX;
 int sysctl_optmem_max __read_mostly = sizeof(unsigned long)*(2*UIO_MAXIOV+512);
 EXPORT_SYMBOL(sysctl_optmem_max);
 
+int sysctl_mem_pcpu_rsv __read_mostly = SK_MEMORY_PCPU_RESERVE;
+EXPORT_SYMBOL(sysctl_mem_pcpu_rsv);
+
 struct static_key memalloc_socks = STATIC_KEY_INIT_FALSE;
 EXPORT_SYMBOL_GPL(memalloc_socks);
 
@@ -895,6 +900,19 @@ set_rcvbuf:
 		}
 		break;
 
+	case SO_ATTACH_REUSEPORT_CBPF:
+		ret = -EINVAL;
+		if (optlen == sizeof(struct sock_fprog)) {
+			struct sock_fprog fprog;
+
+			ret = -EFAULT;
+			if (copy_from_user(&fprog, optval, sizeof(fprog)))
+				break;
+
+			ret = sk_reuseport_attach_filter(&fprog, sk);
+		}
+		break;
+
 	case SO_DETACH_FILTER:
 		ret = sk_detach_filter(sk);
 		break;
@@ -959,11 +977,28 @@ set_rcvbuf:
 #endif
 
 	case SO_MAX_PACING_RATE:
+		if (val != ~0U)
+			cmpxchg(&sk->sk_pacing_status,
+				SK_PACING_NONE,
+				SK_PACING_NEEDED);
 		sk->sk_max_pacing_rate = val;
 		sk->sk_pacing_rate = min(sk->sk_pacing_rate,
 					 sk->sk_max_pacing_rate);
 		break;
 
+	case SO_ZEROCOPY:
+		if (sk->sk_family != PF_INET && sk->sk_family != PF_INET6)
+			ret = -ENOTSUPP;
+		else if (sk->sk_protocol != IPPROTO_TCP)
+			ret = -ENOTSUPP;
+		else if (sk->sk_state != TCP_CLOSE)
+			ret = -EBUSY;
+		else if (val < 0 || val > 1)
+			ret = -EINVAL;
+		else
+			sock_valbool_flag(sk, SOCK_ZEROCOPY, valbool);
+		break;
+
 	default:
 		ret = -ENOPROTOOPT;
 		break;
@@ -1234,6 +1269,10 @@ int sock_getsockopt(struct socket *sock, int level, int optname,
 		v.val = sk->sk_max_pacing_rate;
 		break;
 
+	case SO_ZEROCOPY:
+		v.val = sock_flag(sk, SOCK_ZEROCOPY);
+		break;
+
 	default:
 		return -ENOPROTOOPT;
 	}
@@ -1416,6 +1455,8 @@ static void __sk_free(struct sock *sk)
 		sk_filter_uncharge(sk, filter);
 		RCU_INIT_POINTER(sk->sk_filter, NULL);
 	}
+	if (rcu_access_pointer(sk->sk_reuseport_cb))
+		reuseport_detach_sock(sk);
 
 	sock_disable_timestamp(sk, SK_FLAGS_TIMESTAMP);
 
@@ -1499,6 +1540,7 @@ struct sock *sk_clone_lock(const struct sock *sk, const gfp_t priority)
 		 */
 		atomic_set(&newsk->sk_wmem_alloc, 1);
 		atomic_set(&newsk->sk_omem_alloc, 0);
+		atomic_set(&newsk->sk_zckey, 0);
 		skb_queue_head_init(&newsk->sk_receive_queue);
 		skb_queue_head_init(&newsk->sk_write_queue);
 #ifdef CONFIG_NET_DMA
@@ -1524,6 +1566,9 @@ struct sock *sk_clone_lock(const struct sock *sk, const gfp_t priority)
 		if (filter != NULL)
 			sk_filter_charge(newsk, filter);
 
+		/* children of a listener are not part of its group */
+		RCU_INIT_POINTER(newsk->sk_reuseport_cb, NULL);
+
 		if (unlikely(xfrm_sk_clone_policy(newsk))) {
 			/* It is still raw copy of parent, so invalidate
 			 * destructor and make plain sk_free() */
@@ -2760,6 +2805,57 @@ static inline void release_proto_idx(struct proto *prot)
 }
 #endif
 
+/**
+ *	proto_memory_allocated_sum - exact memory_allocated of a protocol
+ *	@prot: protocol
+ *
+ *	Adds the per-cpu reserves not yet folded into memory_allocated.
+ *	Slow, for reporting only.
+ */
+long proto_memory_allocated_sum(struct proto *prot)
+{
+	long val = atomic_long_read(prot->memory_allocated);
+	int cpu;
+
+	if (prot->per_cpu_fw_alloc)
+		for_each_possible_cpu(cpu)
+			val += *per_cpu_ptr(prot->per_cpu_fw_alloc, cpu);
+
+	return max(val, 0L);
+}
+EXPORT_SYMBOL(proto_memory_allocated_sum);
+
+/* Fold the reserves a dead cpu still holds into the shared counters */
+static int sk_mem_cpu_callback(struct notifier_block *nfb,
+			       unsigned long action, void *hcpu)
+{
+	unsigned int cpu = (unsigned long)hcpu;
+	struct proto *prot;
+	int *local;
+
+	if (action != CPU_DEAD && action != CPU_DEAD_FROZEN)
+		return NOTIFY_OK;
+
+	mutex_lock(&proto_list_mutex);
+	list_for_each_entry(prot, &proto_list, node) {
+		if (!prot->per_cpu_fw_alloc)
+			continue;
+		local = per_cpu_ptr(prot->per_cpu_fw_alloc, cpu);
+		atomic_long_add(*local, prot->memory_allocated);
+		*local = 0;
+	}
+	mutex_unlock(&proto_list_mutex);
+
+	return NOTIFY_OK;
+}
+
+static int __init sk_mem_cpu_init(void)
+{
+	hotcpu_notifier(sk_mem_cpu_callback, 0);
+	return 0;
+}
+core_initcall(sk_mem_cpu_init);
+
 int proto_register(struct proto *prot, int alloc_slab)
 {
 	if (alloc_slab) {
@@ -2882,7 +2978,8 @@ static char proto_method_implemented(const void *method)
 }
 static long sock_prot_memory_allocated(struct proto *proto)
 {
-	return proto->memory_allocated != NULL ? proto_memory_allocated(proto) : -1L;
+	return proto->memory_allocated != NULL ?
+		proto_memory_allocated_sum(proto) : -1L;
 }
 
 static char *sock_prot_memory_pressure(struct proto *proto)
@@ -0,0 +1,121 @@
+/*
+ *	stack_latency.c - receive path latency histograms
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version
+ *	2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/percpu.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/export.h>
+#include <linux/bitops.h>
+#include <net/net_namespace.h>
+#include <net/stack_latency.h>
+
+struct static_key net_lat_needed __read_mostly;
+EXPORT_SYMBOL(net_lat_needed);
+
+int sysctl_net_stack_latency __read_mostly;
+
+static const char * const net_lat_stage_names[NET_LAT_MAX] = {
+	[NET_LAT_DRIVER]	= "driver",
+	[NET_LAT_IP]		= "ip",
+	[NET_LAT_TRANSPORT]	= "transport",
+	[NET_LAT_SOCKET]	= "socket",
+};
+
+void __net_lat_stage(struct net *net, struct sk_buff *skb, int stage,
+		     bool last)
+{
+	ktime_t now = ktime_get();
+	s64 delta;
+
+	/* Packets already in flight when collection was switched on */
+	if (skb->lat_stamp.tv64) {
+		delta = ktime_to_ns(ktime_sub(now, skb->lat_stamp));
+		this_cpu_inc(net->core.lat_hist->count[stage]
+			     [delta > 0 ? min_t(int, fls64(delta),
+						NET_LAT_BUCKETS - 1) : 0]);
+	}
+
+	skb->lat_stamp = last ? ktime_set(0, 0) : now;
+}
+EXPORT_SYMBOL(__net_lat_stage);
+
+static int stack_latency_seq_show(struct seq_file *seq, void *v)
+{
+	struct net *net = seq->private;
+	u64 count[NET_LAT_BUCKETS];
+	int stage, i, cpu;
+
+	seq_puts(seq, "stage    ");
+	for (i = 0; i < NET_LAT_BUCKETS; i++)
+		seq_printf(seq, " %llu", i ? 1ULL << (i - 1) : 0ULL);
+	seq_putc(seq, '\n');
+
+	for (stage = 0; stage < NET_LAT_MAX; stage++) {
+		memset(count, 0, sizeof(count));
+		for_each_possible_cpu(cpu) {
+			struct net_lat_hist *hist =
+				per_cpu_ptr(net->core.lat_hist, cpu);
+
+			for (i = 0; i < NET_LAT_BUCKETS; i++)
+				count[i] += hist->count[stage][i];
+		}
+
+		seq_printf(seq, "%-9s", net_lat_stage_names[stage]);
+		for (i = 0; i < NET_LAT_BUCKETS; i++)
+			seq_printf(seq, " %llu", count[i]);
+		seq_putc(seq, '\n');
+	}
+	return 0;
+}
+
+static int stack_latency_seq_open(struct inode *inode, struct file *file)
+{
+	return single_open_net(inode, file, stack_latency_seq_show);
+}
+
+static const struct file_operations stack_latency_seq_fops = {
+	.owner	 = THIS_MODULE,
+	.open	 = stack_latency_seq_open,
+	.read	 = seq_read,
+	.llseek	 = seq_lseek,
+	.release = single_release_net,
+};
+
+static int __net_init stack_latency_net_init(struct net *net)
+{
+	net->core.lat_hist = alloc_percpu(struct net_lat_hist);
+	if (!net->core.lat_hist)
+		return -ENOMEM;
+
+	if (!proc_create("stack_latency", S_IRUGO, net->proc_net,
+			 &stack_latency_seq_fops)) {
+		free_percpu(net->core.lat_hist);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static void __net_exit stack_latency_net_exit(struct net *net)
+{
+	remove_proc_entry("stack_latency", net->proc_net);
+	free_percpu(net->core.lat_hist);
+}
+
+static struct pernet_operations stack_latency_net_ops = {
+	.init = stack_latency_net_init,
+	.exit = stack_latency_net_exit,
+};
+
+static int __init stack_latency_init(void)
+{
+	return register_pernet_subsys(&stack_latency_net_ops);
+}
+subsys_initcall(stack_latency_init);
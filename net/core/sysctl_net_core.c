@@ -21,6 +21,7 @@
 #include <net/net_ratelimit.h>
 #include <net/busy_poll.h>
 #include <net/pkt_sched.h>
+#include <net/stack_latency.h>
 
 static int zero = 0;
 static int one = 1;
@@ -215,6 +216,30 @@ static int set_default_qdisc(struct ctl_table *table, int write,
 }
 #endif
 
+#ifdef CONFIG_NET_STACK_LATENCY
+static int stack_latency_sysctl(struct ctl_table *table, int write,
+				void __user *buffer, size_t *lenp, loff_t *ppos)
+{
+	static DEFINE_MUTEX(stack_latency_mutex);
+	int orig, ret;
+
+	mutex_lock(&stack_latency_mutex);
+
+	orig = sysctl_net_stack_latency;
+	ret = proc_dointvec_minmax(table, write, buffer, lenp, ppos);
+	if (write && !ret && sysctl_net_stack_latency != orig) {
+		if (sysctl_net_stack_latency)
+			static_key_slow_inc(&net_lat_needed);
+		else
+			static_key_slow_dec(&net_lat_needed);
+	}
+
+	mutex_unlock(&stack_latency_mutex);
+
+	return ret;
+}
+#endif
+
 static struct ctl_table net_core_table[] = {
 #ifdef CONFIG_NET
 	{
@@ -279,6 +304,14 @@ static struct ctl_table net_core_table[] = {
 		.mode		= 0644,
 		.proc_handler	= proc_dointvec
 	},
+	{
+		.procname	= "gro_normal_batch",
+		.data		= &gro_normal_batch,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &one,
+	},
 	{
 		.procname	= "message_cost",
 		.data		= &net_ratelimit_state.interval,
@@ -300,6 +333,14 @@ static struct ctl_table net_core_table[] = {
 		.mode		= 0644,
 		.proc_handler	= proc_dointvec
 	},
+	{
+		.procname	= "mem_pcpu_rsv",
+		.data		= &sysctl_mem_pcpu_rsv,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+	},
 #ifdef CONFIG_RPS
 	{
 		.procname	= "rps_sock_flow_entries",
@@ -307,6 +348,15 @@ static struct ctl_table net_core_table[] = {
 		.mode		= 0644,
 		.proc_handler	= rps_sock_flow_sysctl
 	},
+	{
+		.procname	= "rps_encap_hash",
+		.data		= &rps_encap_hash,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &one,
+	},
 #endif
 #ifdef CONFIG_NET_FLOW_LIMIT
 	{
@@ -346,6 +396,17 @@ static struct ctl_table net_core_table[] = {
 		.proc_handler	= set_default_qdisc
 	},
 #endif
+#ifdef CONFIG_NET_STACK_LATENCY
+	{
+		.procname	= "stack_latency",
+		.data		= &sysctl_net_stack_latency,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= stack_latency_sysctl,
+		.extra1		= &zero,
+		.extra2		= &one,
+	},
+#endif
 #endif /* CONFIG_NET */
 	{
 		.procname	= "netdev_budget",
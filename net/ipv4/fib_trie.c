@@ -100,13 +100,6 @@ struct rt_trie_node {
 	t_key key;
 };
 
-struct leaf {
-	unsigned long parent;
-	t_key key;
-	struct hlist_head list;
-	struct rcu_head rcu;
-};
-
 struct leaf_info {
 	struct hlist_node hlist;
 	int plen;
@@ -115,6 +108,21 @@ struct leaf_info {
 	struct rcu_head rcu;
 };
 
+/*
+ * The leaf_info of the prefix a leaf is created for lives in the leaf
+ * itself, so a lookup hitting the common leaf with a single prefix does
+ * not take an extra cache miss to reach it.  Once unlinked it is left
+ * unused until the leaf is freed, as RCU readers may still be on it;
+ * further prefixes get their leaf_info allocated separately.
+ */
+struct leaf {
+	unsigned long parent;
+	t_key key;
+	struct hlist_head list;
+	struct rcu_head rcu;
+	struct leaf_info info;
+};
+
 struct tnode {
 	unsigned long parent;
 	t_key key;
@@ -368,9 +376,10 @@ static inline void free_leaf(struct leaf *l)
 	call_rcu(&l->rcu, __leaf_free_rcu);
 }
 
-static inline void free_leaf_info(struct leaf_info *leaf)
+static inline void free_leaf_info(struct leaf *l, struct leaf_info *li)
 {
-	kfree_rcu(leaf, rcu);
+	if (li != &l->info)
+		kfree_rcu(li, rcu);
 }
 
 static struct tnode *tnode_alloc(size_t size)
@@ -426,12 +435,23 @@ static void tnode_free_flush(void)
 	}
 }
 
-static struct leaf *leaf_new(void)
+static void leaf_info_init(struct leaf_info *li, int plen)
+{
+	li->plen = plen;
+	li->mask_plen = ntohl(inet_make_mask(plen));
+	INIT_LIST_HEAD(&li->falh);
+}
+
+/* The new leaf comes with its embedded leaf_info for 'plen' linked in. */
+static struct leaf *leaf_new(t_key key, int plen)
 {
 	struct leaf *l = kmem_cache_alloc(trie_leaf_kmem, GFP_KERNEL);
 	if (l) {
 		l->parent = T_LEAF;
+		l->key = key;
 		INIT_HLIST_HEAD(&l->list);
+		leaf_info_init(&l->info, plen);
+		hlist_add_head(&l->info.hlist, &l->list);
 	}
 	return l;
 }
@@ -439,11 +459,8 @@ static struct leaf *leaf_new(void)
 static struct leaf_info *leaf_info_new(int plen)
 {
 	struct leaf_info *li = kmalloc(sizeof(struct leaf_info),  GFP_KERNEL);
-	if (li) {
-		li->plen = plen;
-		li->mask_plen = ntohl(inet_make_mask(plen));
-		INIT_LIST_HEAD(&li->falh);
-	}
+	if (li)
+		leaf_info_init(li, plen);
 	return li;
 }
 
@@ -1087,21 +1104,12 @@ static struct list_head *fib_insert_node(struct trie *t, u32 key, int plen)
 		insert_leaf_info(&l->list, li);
 		goto done;
 	}
-	l = leaf_new();
+	l = leaf_new(key, plen);
 
 	if (!l)
 		return NULL;
 
-	l->key = key;
-	li = leaf_info_new(plen);
-
-	if (!li) {
-		free_leaf(l);
-		return NULL;
-	}
-
-	fa_head = &li->falh;
-	insert_leaf_info(&l->list, li);
+	fa_head = &l->info.falh;
 
 	if (t->trie && n == NULL) {
 		/* Case 2: n is NULL, and will just insert a new leaf */
@@ -1127,7 +1135,6 @@ static struct list_head *fib_insert_node(struct trie *t, u32 key, int plen)
 		}
 
 		if (!tn) {
-			free_leaf_info(li);
 			free_leaf(l);
 			return NULL;
 		}
@@ -1684,7 +1691,7 @@ int fib_table_delete(struct fib_table *tb, struct fib_config *cfg)
 
 	if (list_empty(fa_head)) {
 		hlist_del_rcu(&li->hlist);
-		free_leaf_info(li);
+		free_leaf_info(l, li);
 	}
 
 	if (hlist_empty(&l->list))
@@ -1728,7 +1735,7 @@ static int trie_flush_leaf(struct leaf *l)
 
 		if (list_empty(&li->falh)) {
 			hlist_del_rcu(&li->hlist);
-			free_leaf_info(li);
+			free_leaf_info(l, li);
 		}
 	}
 	return found;
@@ -1951,8 +1958,7 @@ void __init fib_trie_init(void)
 					  0, SLAB_PANIC, NULL);
 
 	trie_leaf_kmem = kmem_cache_create("ip_fib_trie",
-					   max(sizeof(struct leaf),
-					       sizeof(struct leaf_info)),
+					   sizeof(struct leaf),
 					   0, SLAB_PANIC, NULL);
 }
 
@@ -2113,7 +2119,10 @@ static void trie_show_stats(struct seq_file *seq, struct trie_stat *stat)
 	bytes = sizeof(struct leaf) * stat->leaves;
 
 	seq_printf(seq, "\tPrefixes:       %u\n", stat->prefixes);
-	bytes += sizeof(struct leaf_info) * stat->prefixes;
+	/* The first prefix of a leaf is accounted in the leaf. */
+	if (stat->prefixes > stat->leaves)
+		bytes += sizeof(struct leaf_info) *
+			 (stat->prefixes - stat->leaves);
 
 	seq_printf(seq, "\tInternal nodes: %u\n\t", stat->tnodes);
 	bytes += sizeof(struct tnode) * stat->tnodes;
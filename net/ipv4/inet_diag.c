@@ -915,7 +915,7 @@ skip_listen_ht:
 
 	for (i = s_i; i <= hashinfo->ehash_mask; i++) {
 		struct inet_ehash_bucket *head = &hashinfo->ehash[i];
-		spinlock_t *lock = inet_ehash_lockp(hashinfo, i);
+		numa_spinlock_t *lock = inet_ehash_lockp(hashinfo, i);
 		struct sock *sk;
 		struct hlist_nulls_node *node;
 
@@ -927,7 +927,7 @@ skip_listen_ht:
 		if (i > s_i)
 			s_num = 0;
 
-		spin_lock_bh(lock);
+		numa_spin_lock_bh(lock);
 		sk_nulls_for_each(sk, node, &head->chain) {
 			int res;
 			int state;
@@ -954,14 +954,14 @@ skip_listen_ht:
 			else
 				res = inet_csk_diag_dump(sk, skb, cb, r, bc);
 			if (res < 0) {
-				spin_unlock_bh(lock);
+				numa_spin_unlock_bh(lock);
 				goto done;
 			}
 next_normal:
 			++num;
 		}
 
-		spin_unlock_bh(lock);
+		numa_spin_unlock_bh(lock);
 	}
 
 done:
@@ -23,6 +23,7 @@
 #include <net/inet_hashtables.h>
 #include <net/secure_seq.h>
 #include <net/ip.h>
+#include <net/sock_reuseport.h>
 
 static unsigned int inet_ehashfn(struct net *net, const __be32 laddr,
 				 const __u16 lport, const __be32 faddr,
@@ -201,6 +202,7 @@ static inline int compute_score(struct sock *sk, struct net *net,
 
 struct sock *__inet_lookup_listener(struct net *net,
 				    struct inet_hashinfo *hashinfo,
+				    struct sk_buff *skb, int doff,
 				    const __be32 saddr, __be16 sport,
 				    const __be32 daddr, const unsigned short hnum,
 				    const int dif)
@@ -241,6 +243,12 @@ begin:
 	 */
 	if (get_nulls_value(node) != hash + LISTENING_NULLS_BASE)
 		goto begin;
+	if (result && reuseport && skb) {
+		struct sock *sk2 = reuseport_select_sock(result, skb, doff);
+
+		if (sk2 && compute_score(sk2, net, hnum, daddr, dif) == hiscore)
+			result = sk2;
+	}
 	if (result) {
 		if (unlikely(!atomic_inc_not_zero(&result->sk_refcnt)))
 			result = NULL;
@@ -333,13 +341,13 @@ static int __inet_check_established(struct inet_timewait_death_row *death_row,
 	unsigned int hash = inet_ehashfn(net, daddr, lport,
 					 saddr, inet->inet_dport);
 	struct inet_ehash_bucket *head = inet_ehash_bucket(hinfo, hash);
-	spinlock_t *lock = inet_ehash_lockp(hinfo, hash);
+	numa_spinlock_t *lock = inet_ehash_lockp(hinfo, hash);
 	struct sock *sk2;
 	const struct hlist_nulls_node *node;
 	struct inet_timewait_sock *tw = NULL;
 	int twrefcnt = 0;
 
-	spin_lock(lock);
+	numa_spin_lock(lock);
 
 	sk_nulls_for_each(sk2, node, &head->chain) {
 		if (sk2->sk_hash != hash)
@@ -368,7 +376,7 @@ static int __inet_check_established(struct inet_timewait_death_row *death_row,
 		twrefcnt = inet_twsk_unhash(tw);
 		NET_INC_STATS_BH(net, LINUX_MIB_TIMEWAITRECYCLED);
 	}
-	spin_unlock(lock);
+	numa_spin_unlock(lock);
 	if (twrefcnt)
 		inet_twsk_put(tw);
 	sock_prot_inuse_add(sock_net(sk), sk->sk_prot, 1);
@@ -384,7 +392,7 @@ static int __inet_check_established(struct inet_timewait_death_row *death_row,
 	return 0;
 
 not_unique:
-	spin_unlock(lock);
+	numa_spin_unlock(lock);
 	return -EADDRNOTAVAIL;
 }
 
@@ -400,7 +408,7 @@ int __inet_hash_nolisten(struct sock *sk, struct inet_timewait_sock *tw)
 {
 	struct inet_hashinfo *hashinfo = sk->sk_prot->h.hashinfo;
 	struct hlist_nulls_head *list;
-	spinlock_t *lock;
+	numa_spinlock_t *lock;
 	struct inet_ehash_bucket *head;
 	int twrefcnt = 0;
 
@@ -411,18 +419,45 @@ int __inet_hash_nolisten(struct sock *sk, struct inet_timewait_sock *tw)
 	list = &head->chain;
 	lock = inet_ehash_lockp(hashinfo, sk->sk_hash);
 
-	spin_lock(lock);
+	numa_spin_lock(lock);
 	__sk_nulls_add_node_rcu(sk, list);
 	if (tw) {
 		WARN_ON(sk->sk_hash != tw->tw_hash);
 		twrefcnt = inet_twsk_unhash(tw);
 	}
-	spin_unlock(lock);
+	numa_spin_unlock(lock);
 	sock_prot_inuse_add(sock_net(sk), sk->sk_prot, 1);
 	return twrefcnt;
 }
 EXPORT_SYMBOL_GPL(__inet_hash_nolisten);
 
+/*
+ * Put a SO_REUSEPORT listener into the reuseport group of the listeners on
+ * exactly the same address and port, or start a new group.  Called with
+ * the listening bucket locked.
+ */
+static int inet_reuseport_add_sock(struct sock *sk,
+				   struct inet_listen_hashbucket *ilb)
+{
+	struct hlist_nulls_node *node;
+	kuid_t uid = sock_i_uid(sk);
+	struct sock *sk2;
+
+	sk_nulls_for_each(sk2, node, &ilb->head) {
+		if (sk2 != sk &&
+		    net_eq(sock_net(sk2), sock_net(sk)) &&
+		    sk2->sk_family == sk->sk_family &&
+		    inet_sk(sk2)->inet_num == inet_sk(sk)->inet_num &&
+		    sk2->sk_bound_dev_if == sk->sk_bound_dev_if &&
+		    sk2->sk_reuseport && uid_eq(uid, sock_i_uid(sk2)) &&
+		    inet_sk(sk2)->inet_rcv_saddr == inet_sk(sk)->inet_rcv_saddr &&
+		    rcu_access_pointer(sk2->sk_reuseport_cb))
+			return reuseport_add_sock(sk, sk2);
+	}
+
+	return reuseport_alloc(sk);
+}
+
 static void __inet_hash(struct sock *sk)
 {
 	struct inet_hashinfo *hashinfo = sk->sk_prot->h.hashinfo;
@@ -437,6 +472,12 @@ static void __inet_hash(struct sock *sk)
 	ilb = &hashinfo->listening_hash[inet_sk_listen_hashfn(sk)];
 
 	spin_lock(&ilb->lock);
+	/*
+	 * Failing to set up the group only costs the listener its place in
+	 * steering decisions, lookups fall back to the flow hash.
+	 */
+	if (sk->sk_reuseport)
+		inet_reuseport_add_sock(sk, ilb);
 	__sk_nulls_add_node_rcu(sk, &ilb->head);
 	sock_prot_inuse_add(sock_net(sk), sk->sk_prot, 1);
 	spin_unlock(&ilb->lock);
@@ -455,22 +496,31 @@ EXPORT_SYMBOL_GPL(inet_hash);
 void inet_unhash(struct sock *sk)
 {
 	struct inet_hashinfo *hashinfo = sk->sk_prot->h.hashinfo;
-	spinlock_t *lock;
+	spinlock_t *lock = NULL;
+	numa_spinlock_t *elock = NULL;
 	int done;
 
 	if (sk_unhashed(sk))
 		return;
 
-	if (sk->sk_state == TCP_LISTEN)
+	if (sk->sk_state == TCP_LISTEN) {
 		lock = &hashinfo->listening_hash[inet_sk_listen_hashfn(sk)].lock;
-	else
-		lock = inet_ehash_lockp(hashinfo, sk->sk_hash);
+		spin_lock_bh(lock);
+	} else {
+		elock = inet_ehash_lockp(hashinfo, sk->sk_hash);
+		numa_spin_lock_bh(elock);
+	}
 
-	spin_lock_bh(lock);
+	if (rcu_access_pointer(sk->sk_reuseport_cb))
+		reuseport_detach_sock(sk);
 	done = __sk_nulls_del_node_init_rcu(sk);
 	if (done)
 		sock_prot_inuse_add(sock_net(sk), sk->sk_prot, -1);
-	spin_unlock_bh(lock);
+
+	if (lock)
+		spin_unlock_bh(lock);
+	else
+		numa_spin_unlock_bh(elock);
 }
 EXPORT_SYMBOL_GPL(inet_unhash);
 
@@ -309,7 +309,37 @@ drop:
 int sysctl_ip_early_demux __read_mostly = 1;
 EXPORT_SYMBOL(sysctl_ip_early_demux);
 
-static int ip_rcv_finish(struct sk_buff *skb)
+/* A packet of a batch can take the route of the one before it when
+ * everything the input route lookup keys on is the same.  Only local
+ * and unicast routes are shared, the other types carry per packet
+ * state, and not from packets with options as source routing may
+ * have replaced the route.
+ */
+static bool ip_can_use_hint(const struct sk_buff *skb,
+			    const struct iphdr *iph,
+			    const struct sk_buff *hint)
+{
+	const struct iphdr *hiph;
+
+	if (!hint)
+		return false;
+
+	hiph = ip_hdr(hint);
+	return hiph->daddr == iph->daddr && hiph->saddr == iph->saddr &&
+	       hiph->tos == iph->tos && hint->dev == skb->dev &&
+	       hint->mark == skb->mark;
+}
+
+static bool ip_is_route_hint(const struct sk_buff *skb)
+{
+	const struct rtable *rt = skb_rtable(skb);
+
+	return ip_hdr(skb)->ihl == 5 &&
+	       (rt->rt_type == RTN_LOCAL || rt->rt_type == RTN_UNICAST);
+}
+
+static int ip_rcv_finish_core(struct sk_buff *skb,
+			      const struct sk_buff *hint)
 {
 	const struct iphdr *iph = ip_hdr(skb);
 	struct rtable *rt;
@@ -330,7 +360,9 @@ static int ip_rcv_finish(struct sk_buff *skb)
 	 *	Initialise the virtual path cache for the packet. It describes
 	 *	how the packet travels inside Linux networking.
 	 */
-	if (!skb_dst(skb)) {
+	if (!skb_dst(skb) && ip_can_use_hint(skb, iph, hint)) {
+		skb_dst_copy(skb, hint);
+	} else if (!skb_dst(skb)) {
 		int err = ip_route_input_noref(skb, iph->daddr, iph->saddr,
 					       iph->tos, skb->dev);
 		if (unlikely(err)) {
@@ -363,17 +395,26 @@ static int ip_rcv_finish(struct sk_buff *skb)
 		IP_UPD_PO_STATS_BH(dev_net(rt->dst.dev), IPSTATS_MIB_INBCAST,
 				skb->len);
 
-	return dst_input(skb);
+	return NET_RX_SUCCESS;
 
 drop:
 	kfree_skb(skb);
 	return NET_RX_DROP;
 }
 
+static int ip_rcv_finish(struct sk_buff *skb)
+{
+	int ret = ip_rcv_finish_core(skb, NULL);
+
+	if (ret != NET_RX_DROP)
+		ret = dst_input(skb);
+	return ret;
+}
+
 /*
  * 	Main IP Receive routine.
  */
-int ip_rcv(struct sk_buff *skb, struct net_device *dev, struct packet_type *pt, struct net_device *orig_dev)
+static struct sk_buff *ip_rcv_core(struct sk_buff *skb, struct net_device *dev)
 {
 	const struct iphdr *iph;
 	u32 len;
@@ -450,8 +491,7 @@ int ip_rcv(struct sk_buff *skb, struct net_device *dev, struct packet_type *pt,
 	/* Must drop socket now because of tproxy. */
 	skb_orphan(skb);
 
-	return NF_HOOK(NFPROTO_IPV4, NF_INET_PRE_ROUTING, skb, dev, NULL,
-		       ip_rcv_finish);
+	return skb;
 
 csum_error:
 	IP_INC_STATS_BH(dev_net(dev), IPSTATS_MIB_CSUMERRORS);
@@ -460,5 +500,83 @@ inhdr_error:
 drop:
 	kfree_skb(skb);
 out:
-	return NET_RX_DROP;
+	return NULL;
+}
+
+int ip_rcv(struct sk_buff *skb, struct net_device *dev, struct packet_type *pt, struct net_device *orig_dev)
+{
+	skb = ip_rcv_core(skb, dev);
+	if (skb == NULL)
+		return NET_RX_DROP;
+
+	return NF_HOOK(NFPROTO_IPV4, NF_INET_PRE_ROUTING, skb, dev, NULL,
+		       ip_rcv_finish);
+}
+
+static void ip_sublist_rcv_finish(struct sk_buff_head *head)
+{
+	struct sk_buff *skb;
+
+	while ((skb = __skb_dequeue(head)) != NULL)
+		dst_input(skb);
+}
+
+static void ip_list_rcv_finish(struct sk_buff_head *head)
+{
+	struct dst_entry *curr_dst = NULL;
+	struct sk_buff *skb, *hint = NULL;
+	struct sk_buff_head sublist;
+
+	__skb_queue_head_init(&sublist);
+	while ((skb = __skb_dequeue(head)) != NULL) {
+		struct dst_entry *dst;
+
+		if (ip_rcv_finish_core(skb, hint) == NET_RX_DROP)
+			continue;
+
+		/* hint stays on the undelivered sublist until replaced */
+		hint = ip_is_route_hint(skb) ? skb : NULL;
+
+		dst = skb_dst(skb);
+		if (curr_dst != dst) {
+			ip_sublist_rcv_finish(&sublist);
+			curr_dst = dst;
+		}
+		__skb_queue_tail(&sublist, skb);
+	}
+	ip_sublist_rcv_finish(&sublist);
+}
+
+static void ip_sublist_rcv(struct sk_buff_head *head, struct net_device *dev)
+{
+	NF_HOOK_LIST(NFPROTO_IPV4, NF_INET_PRE_ROUTING, head, dev, NULL,
+		     ip_rcv_finish);
+	ip_list_rcv_finish(head);
+}
+
+/* Receive a list of IP packets */
+void ip_list_rcv(struct sk_buff_head *head, struct packet_type *pt,
+		 struct net_device *orig_dev)
+{
+	struct net_device *curr_dev = NULL;
+	struct sk_buff_head sublist;
+	struct sk_buff *skb;
+
+	__skb_queue_head_init(&sublist);
+	while ((skb = __skb_dequeue(head)) != NULL) {
+		struct net_device *dev = skb->dev;
+
+		skb = ip_rcv_core(skb, dev);
+		if (skb == NULL)
+			continue;
+
+		if (curr_dev != dev) {
+			if (!skb_queue_empty(&sublist))
+				ip_sublist_rcv(&sublist, curr_dev);
+			curr_dev = dev;
+		}
+		__skb_queue_tail(&sublist, skb);
+	}
+	if (!skb_queue_empty(&sublist))
+		ip_sublist_rcv(&sublist, curr_dev);
 }
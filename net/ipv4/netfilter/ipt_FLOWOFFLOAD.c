@@ -0,0 +1,416 @@
+/*
+ * FLOWOFFLOAD target and flow table fast path for IPv4.
+ *
+ * A rule like
+ *
+ *	iptables -A FORWARD -m conntrack --ctstate ESTABLISHED -j FLOWOFFLOAD
+ *
+ * moves established TCP and UDP connections into the flow table.  From
+ * then on their packets are picked up in PREROUTING, before defragmentation
+ * and connection tracking, get their NAT mangling and TTL decrement, and
+ * are handed to the neighbour layer using the routes cached in the flow.
+ * Anything the fast path does not handle, like packets with IP options,
+ * fragments, packets exceeding the MTU or TCP FIN and RST, keeps going
+ * through the regular path.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/skbuff.h>
+#include <linux/ip.h>
+#include <linux/tcp.h>
+#include <linux/udp.h>
+#include <net/ip.h>
+#include <net/route.h>
+#include <net/arp.h>
+#include <net/neighbour.h>
+#include <net/checksum.h>
+
+#include <linux/netfilter_ipv4/ip_tables.h>
+#include <linux/netfilter/x_tables.h>
+#include <net/netfilter/nf_conntrack.h>
+#include <net/netfilter/nf_conntrack_helper.h>
+#include <net/netfilter/nf_conntrack_l3proto.h>
+#include <net/netfilter/nf_flow_table.h>
+
+static int flowoffload_route(struct sk_buff *skb, const struct nf_conn *ct,
+			     const struct xt_action_param *par,
+			     struct nf_flow_route *route,
+			     enum ip_conntrack_dir dir)
+{
+	struct dst_entry *this_dst = skb_dst(skb);
+	struct flowi4 fl4;
+	struct rtable *rt;
+
+	if (!this_dst || this_dst->dev != par->out || dst_xfrm(this_dst))
+		return -EINVAL;
+
+	/* Replies go back to where this packet came from, through the
+	 * device it came in on; anything else is left to the slow path.
+	 */
+	memset(&fl4, 0, sizeof(fl4));
+	fl4.daddr = ct->tuplehash[dir].tuple.src.u3.ip;
+	fl4.flowi4_oif = par->in->ifindex;
+	fl4.flowi4_mark = skb->mark;
+
+	rt = ip_route_output_key(dev_net(par->in), &fl4);
+	if (IS_ERR(rt))
+		return PTR_ERR(rt);
+
+	if (rt->dst.dev != par->in || dst_xfrm(&rt->dst)) {
+		ip_rt_put(rt);
+		return -EINVAL;
+	}
+
+	dst_hold(this_dst);
+	route->tuple[dir].dst = this_dst;
+	route->tuple[!dir].dst = &rt->dst;
+	return 0;
+}
+
+static unsigned int
+flowoffload_tg(struct sk_buff *skb, const struct xt_action_param *par)
+{
+	struct nf_flow_route route = {};
+	enum ip_conntrack_info ctinfo;
+	struct flow_offload *flow;
+	struct nf_conn *ct;
+
+	ct = nf_ct_get(skb, &ctinfo);
+	if (ct == NULL || nf_ct_is_untracked(ct))
+		return XT_CONTINUE;
+
+	if (ctinfo != IP_CT_ESTABLISHED && ctinfo != IP_CT_ESTABLISHED_REPLY)
+		return XT_CONTINUE;
+
+	switch (nf_ct_protonum(ct)) {
+	case IPPROTO_TCP:
+		if (ct->proto.tcp.state != TCP_CONNTRACK_ESTABLISHED)
+			return XT_CONTINUE;
+		break;
+	case IPPROTO_UDP:
+		break;
+	default:
+		return XT_CONTINUE;
+	}
+
+	/* helpers and sequence number rewriting need to see every packet */
+	if (nfct_help(ct) || test_bit(IPS_SEQ_ADJUST_BIT, &ct->status))
+		return XT_CONTINUE;
+
+	if (!nf_ct_is_confirmed(ct) ||
+	    !test_bit(IPS_SEEN_REPLY_BIT, &ct->status))
+		return XT_CONTINUE;
+
+	if (test_and_set_bit(IPS_OFFLOAD_BIT, &ct->status))
+		return XT_CONTINUE;
+
+	if (flowoffload_route(skb, ct, par, &route, CTINFO2DIR(ctinfo)) < 0)
+		goto err_route;
+
+	nf_conntrack_get(&ct->ct_general);
+	flow = flow_offload_alloc(ct, &route);
+	if (flow == NULL)
+		goto err_flow_alloc;
+
+	if (flow_offload_add(flow) < 0)
+		flow_offload_free(flow);
+
+	return XT_CONTINUE;
+
+err_flow_alloc:
+	nf_ct_put(ct);
+	dst_release(route.tuple[IP_CT_DIR_ORIGINAL].dst);
+	dst_release(route.tuple[IP_CT_DIR_REPLY].dst);
+err_route:
+	clear_bit(IPS_OFFLOAD_BIT, &ct->status);
+	return XT_CONTINUE;
+}
+
+static int flowoffload_tg_check(const struct xt_tgchk_param *par)
+{
+	return nf_ct_l3proto_try_module_get(par->family);
+}
+
+static void flowoffload_tg_destroy(const struct xt_tgdtor_param *par)
+{
+	nf_ct_l3proto_module_put(par->family);
+}
+
+static int flowoffload_tuple(struct sk_buff *skb, const struct net_device *in,
+			     struct flow_offload_tuple *tuple,
+			     unsigned int *thoffp)
+{
+	unsigned int thoff, hdrsize;
+	const struct iphdr *iph;
+	const __be16 *ports;
+
+	/* ip_rcv() has validated the header already */
+	iph = ip_hdr(skb);
+	thoff = iph->ihl * 4;
+
+	if (ip_is_fragment(iph) || unlikely(thoff != sizeof(struct iphdr)))
+		return -1;
+
+	switch (iph->protocol) {
+	case IPPROTO_TCP:
+		hdrsize = sizeof(struct tcphdr);
+		break;
+	case IPPROTO_UDP:
+		hdrsize = sizeof(struct udphdr);
+		break;
+	default:
+		return -1;
+	}
+
+	if (iph->ttl <= 1)
+		return -1;
+
+	if (!pskb_may_pull(skb, thoff + hdrsize))
+		return -1;
+
+	iph = ip_hdr(skb);
+	ports = (const __be16 *)(skb_network_header(skb) + thoff);
+
+	tuple->src_v4	= iph->saddr;
+	tuple->dst_v4	= iph->daddr;
+	tuple->src_port	= ports[0];
+	tuple->dst_port	= ports[1];
+	tuple->iifidx	= in->ifindex;
+	tuple->l3proto	= NFPROTO_IPV4;
+	tuple->l4proto	= iph->protocol;
+
+	*thoffp = thoff;
+	return 0;
+}
+
+static bool flowoffload_exceeds_mtu(const struct sk_buff *skb,
+				    unsigned int mtu)
+{
+	if (skb->len <= mtu)
+		return false;
+
+	if (skb_is_gso(skb) && skb_gso_network_seglen(skb) <= mtu)
+		return false;
+
+	return true;
+}
+
+static __sum16 *flowoffload_l4_check(struct sk_buff *skb, unsigned int thoff,
+				     u8 protocol)
+{
+	void *l4hdr = skb_network_header(skb) + thoff;
+	struct udphdr *udph;
+
+	switch (protocol) {
+	case IPPROTO_TCP:
+		return &((struct tcphdr *)l4hdr)->check;
+	case IPPROTO_UDP:
+		udph = l4hdr;
+		if (!udph->check && skb->ip_summed != CHECKSUM_PARTIAL)
+			return NULL;
+		return &udph->check;
+	}
+	return NULL;
+}
+
+static void flowoffload_mangle(struct sk_buff *skb, struct iphdr *iph,
+			       __sum16 *check, __be32 *addr, __be32 new_addr,
+			       __be16 *port, __be16 new_port)
+{
+	csum_replace4(&iph->check, *addr, new_addr);
+	if (check) {
+		inet_proto_csum_replace4(check, skb, *addr, new_addr, 1);
+		inet_proto_csum_replace2(check, skb, *port, new_port, 0);
+	}
+	*addr = new_addr;
+	*port = new_port;
+}
+
+/* The tuple of the other direction holds what conntrack rewrote the
+ * addresses and ports of this one to.
+ */
+static void flowoffload_nat(struct sk_buff *skb, struct flow_offload *flow,
+			    enum ip_conntrack_dir dir, unsigned int thoff)
+{
+	const struct flow_offload_tuple *other = &flow->tuplehash[!dir].tuple;
+	bool snat = test_bit(FLOW_OFFLOAD_SNAT_BIT, &flow->flags);
+	bool dnat = test_bit(FLOW_OFFLOAD_DNAT_BIT, &flow->flags);
+	struct iphdr *iph = ip_hdr(skb);
+	__sum16 *check;
+	__be16 *ports;
+
+	if (!snat && !dnat)
+		return;
+
+	ports = (__be16 *)(skb_network_header(skb) + thoff);
+	check = flowoffload_l4_check(skb, thoff, iph->protocol);
+
+	if ((snat && dir == IP_CT_DIR_ORIGINAL) ||
+	    (dnat && dir == IP_CT_DIR_REPLY))
+		flowoffload_mangle(skb, iph, check, &iph->saddr, other->dst_v4,
+				   &ports[0], other->dst_port);
+
+	if ((snat && dir == IP_CT_DIR_REPLY) ||
+	    (dnat && dir == IP_CT_DIR_ORIGINAL))
+		flowoffload_mangle(skb, iph, check, &iph->daddr, other->src_v4,
+				   &ports[1], other->src_port);
+
+	if (iph->protocol == IPPROTO_UDP && check && !*check)
+		*check = CSUM_MANGLED_0;
+}
+
+static void flowoffload_xmit(struct sk_buff *skb, struct rtable *rt)
+{
+	struct net_device *dev = rt->dst.dev;
+	struct neighbour *neigh;
+	u32 nexthop;
+
+	skb->dev = dev;
+	/* the flow holds the route until after an RCU grace period and the
+	 * neighbour layer takes a reference should it need to queue the skb
+	 */
+	skb_dst_set_noref(skb, &rt->dst);
+
+	rcu_read_lock_bh();
+	nexthop = (__force u32) rt_nexthop(rt, ip_hdr(skb)->daddr);
+	neigh = __ipv4_neigh_lookup_noref(dev, nexthop);
+	if (unlikely(!neigh))
+		neigh = __neigh_create(&arp_tbl, &nexthop, dev, false);
+	if (!IS_ERR(neigh))
+		dst_neigh_output(&rt->dst, neigh, skb);
+	else
+		kfree_skb(skb);
+	rcu_read_unlock_bh();
+}
+
+static unsigned int flowoffload_hook(const struct nf_hook_ops *ops,
+				     struct sk_buff *skb,
+				     const struct net_device *in,
+				     const struct net_device *out,
+				     int (*okfn)(struct sk_buff *))
+{
+	struct flow_offload_tuple_hash *tuplehash;
+	struct flow_offload_tuple tuple = {};
+	enum ip_conntrack_dir dir;
+	struct flow_offload *flow;
+	struct net_device *outdev;
+	unsigned int thoff;
+	const struct tcphdr *tcph;
+	struct iphdr *iph;
+	struct rtable *rt;
+
+	if (skb->nfct)
+		return NF_ACCEPT;
+
+	if (flowoffload_tuple(skb, in, &tuple, &thoff) < 0)
+		return NF_ACCEPT;
+
+	tuplehash = flow_offload_lookup(dev_net(in), &tuple);
+	if (tuplehash == NULL)
+		return NF_ACCEPT;
+
+	dir = tuplehash->tuple.dir;
+	flow = flow_offload_from_tuple(tuplehash);
+	rt = (struct rtable *)tuplehash->tuple.dst_cache;
+	outdev = rt->dst.dev;
+
+	if (flowoffload_exceeds_mtu(skb, tuplehash->tuple.mtu))
+		return NF_ACCEPT;
+
+	if (skb_headroom(skb) < LL_RESERVED_SPACE(outdev) && outdev->header_ops)
+		return NF_ACCEPT;
+
+	/* routing changed under us, let the slow path find the new one */
+	if (rt->dst.obsolete && !dst_check(&rt->dst, 0)) {
+		flow_offload_teardown(flow);
+		return NF_ACCEPT;
+	}
+
+	if (tuple.l4proto == IPPROTO_TCP) {
+		tcph = (const struct tcphdr *)(skb_network_header(skb) + thoff);
+		if (unlikely(tcph->fin || tcph->rst)) {
+			flow_offload_teardown(flow);
+			return NF_ACCEPT;
+		}
+	}
+
+	if (!skb_make_writable(skb, thoff + (tuple.l4proto == IPPROTO_TCP ?
+					     sizeof(struct tcphdr) :
+					     sizeof(struct udphdr))))
+		return NF_DROP;
+
+	flowoffload_nat(skb, flow, dir, thoff);
+	flow_offload_refresh(flow);
+
+	iph = ip_hdr(skb);
+	ip_decrease_ttl(iph);
+	skb->priority = rt_tos2priority(iph->tos);
+	skb_forward_csum(skb);
+
+	IP_INC_STATS_BH(dev_net(outdev), IPSTATS_MIB_OUTFORWDATAGRAMS);
+	IP_ADD_STATS_BH(dev_net(outdev), IPSTATS_MIB_OUTOCTETS, skb->len);
+
+	flowoffload_xmit(skb, rt);
+	return NF_STOLEN;
+}
+
+static struct xt_target flowoffload_tg4_reg __read_mostly = {
+	.name		= "FLOWOFFLOAD",
+	.family		= NFPROTO_IPV4,
+	.hooks		= 1 << NF_INET_FORWARD,
+	.target		= flowoffload_tg,
+	.checkentry	= flowoffload_tg_check,
+	.destroy	= flowoffload_tg_destroy,
+	.me		= THIS_MODULE,
+};
+
+static struct nf_hook_ops ipv4_flowoffload_ops[] __read_mostly = {
+	{
+		/* ahead of defragmentation and connection tracking */
+		.hook		= flowoffload_hook,
+		.owner		= THIS_MODULE,
+		.pf		= NFPROTO_IPV4,
+		.hooknum	= NF_INET_PRE_ROUTING,
+		.priority	= NF_IP_PRI_CONNTRACK_DEFRAG - 1,
+	},
+};
+
+static int __init flowoffload_tg4_init(void)
+{
+	int err;
+
+	err = nf_register_hooks(ipv4_flowoffload_ops,
+				ARRAY_SIZE(ipv4_flowoffload_ops));
+	if (err < 0)
+		goto err1;
+
+	err = xt_register_target(&flowoffload_tg4_reg);
+	if (err < 0)
+		goto err2;
+
+	return 0;
+
+err2:
+	nf_unregister_hooks(ipv4_flowoffload_ops,
+			    ARRAY_SIZE(ipv4_flowoffload_ops));
+err1:
+	return err;
+}
+
+static void __exit flowoffload_tg4_exit(void)
+{
+	xt_unregister_target(&flowoffload_tg4_reg);
+	nf_unregister_hooks(ipv4_flowoffload_ops,
+			    ARRAY_SIZE(ipv4_flowoffload_ops));
+}
+
+module_init(flowoffload_tg4_init);
+module_exit(flowoffload_tg4_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Xtables: offload established connections to the flow table");
+MODULE_ALIAS("ipt_FLOWOFFLOAD");
@@ -124,6 +124,7 @@ static int ip_rt_error_burst __read_mostly	= 5 * HZ;
 static int ip_rt_mtu_expires __read_mostly	= 10 * 60 * HZ;
 static int ip_rt_min_pmtu __read_mostly		= 512 + 20 + 20;
 static int ip_rt_min_advmss __read_mostly	= 256;
+static int ip_rt_output_cache __read_mostly;
 
 /*
  *	Interface to generic destination cache.
@@ -2000,6 +2001,109 @@ add:
  * Major route resolver routine.
  */
 
+/*
+ * Small per-cpu cache of output routes, for senders that do a full
+ * lookup for every packet, like unconnected UDP sockets.  It is keyed on
+ * everything the lookup depends on and holds a reference on each route;
+ * a route is only handed out again while it passes the same checks a
+ * socket's cached route does, so a FIB change, which bumps the genid,
+ * or a new nexthop exception makes all entries miss.  Stale entries are
+ * released when they are replaced or the namespace goes away.
+ *
+ * Only plain unicast routes resolved through the FIB are cached, routes
+ * subject to multipath or default route selection are not.
+ */
+#define RT_OUTPUT_CACHE_SIZE	16
+
+struct rt_output_cache_entry {
+	__be32		daddr;
+	__be32		saddr;
+	int		oif;
+	u32		mark;
+	__u8		tos;
+	__u8		flags;
+	/* Result of the lookup */
+	__be32		res_saddr;
+	int		res_oif;
+	struct rtable	*rth;
+};
+
+struct rt_output_cache {
+	struct rt_output_cache_entry	entries[RT_OUTPUT_CACHE_SIZE];
+};
+
+/* Called with rcu_read_lock_bh(), the cache goes away with the
+ * namespace's devices.
+ */
+static struct rt_output_cache_entry *
+rt_output_cache_entry(struct net *net, const struct flowi4 *fl4, __u8 tos)
+{
+	struct rt_output_cache __percpu *pcache;
+	struct rt_output_cache *cache;
+	u32 hash;
+
+	pcache = ACCESS_ONCE(net->ipv4.rt_output_cache);
+	if (!pcache)
+		return NULL;
+	cache = this_cpu_ptr(pcache);
+
+	hash = jhash_3words((__force u32)fl4->daddr, (__force u32)fl4->saddr,
+			    fl4->flowi4_oif ^ fl4->flowi4_mark ^ tos, 0);
+	return &cache->entries[hash & (RT_OUTPUT_CACHE_SIZE - 1)];
+}
+
+static struct rtable *rt_output_cache_lookup(struct net *net,
+					     struct flowi4 *fl4, __u8 tos)
+{
+	struct rt_output_cache_entry *e;
+	struct rtable *rth = NULL;
+
+	rcu_read_lock_bh();
+	e = rt_output_cache_entry(net, fl4, tos);
+	if (e && e->rth && e->daddr == fl4->daddr && e->saddr == fl4->saddr &&
+	    e->oif == fl4->flowi4_oif && e->mark == fl4->flowi4_mark &&
+	    e->tos == tos && e->flags == fl4->flowi4_flags &&
+	    rt_cache_valid(e->rth)) {
+		rth = e->rth;
+		dst_hold(&rth->dst);
+		fl4->saddr = e->res_saddr;
+		fl4->flowi4_oif = e->res_oif;
+	}
+	rcu_read_unlock_bh();
+
+	return rth;
+}
+
+static void rt_output_cache_insert(struct net *net, const struct flowi4 *key,
+				   __u8 tos, const struct flowi4 *fl4,
+				   struct rtable *rth)
+{
+	struct rt_output_cache_entry *e;
+	struct rtable *old;
+
+	rcu_read_lock_bh();
+	e = rt_output_cache_entry(net, key, tos);
+	if (!e) {
+		rcu_read_unlock_bh();
+		return;
+	}
+	old = e->rth;
+	e->daddr = key->daddr;
+	e->saddr = key->saddr;
+	e->oif = key->flowi4_oif;
+	e->mark = key->flowi4_mark;
+	e->tos = tos;
+	e->flags = key->flowi4_flags;
+	e->res_saddr = fl4->saddr;
+	e->res_oif = fl4->flowi4_oif;
+	dst_hold(&rth->dst);
+	e->rth = rth;
+	rcu_read_unlock_bh();
+
+	if (old)
+		ip_rt_put(old);
+}
+
 struct rtable *__ip_route_output_key(struct net *net, struct flowi4 *fl4)
 {
 	struct net_device *dev_out = NULL;
@@ -2007,6 +2111,8 @@ struct rtable *__ip_route_output_key(struct net *net, struct flowi4 *fl4)
 	unsigned int flags = 0;
 	struct fib_result res;
 	struct rtable *rth;
+	struct flowi4 key;
+	bool cacheable = false;
 	int orig_oif;
 
 	res.tclassid	= 0;
@@ -2015,6 +2121,20 @@ struct rtable *__ip_route_output_key(struct net *net, struct flowi4 *fl4)
 
 	orig_oif = fl4->flowi4_oif;
 
+	if (ip_rt_output_cache && fl4->daddr &&
+	    !ipv4_is_multicast(fl4->daddr) && !ipv4_is_lbcast(fl4->daddr)) {
+		rth = rt_output_cache_lookup(net, fl4, tos);
+		if (rth) {
+			fl4->flowi4_iif = LOOPBACK_IFINDEX;
+			fl4->flowi4_tos = tos & IPTOS_RT_MASK;
+			fl4->flowi4_scope = ((tos & RTO_ONLINK) ?
+					 RT_SCOPE_LINK : RT_SCOPE_UNIVERSE);
+			return rth;
+		}
+		key = *fl4;
+		cacheable = true;
+	}
+
 	fl4->flowi4_iif = LOOPBACK_IFINDEX;
 	fl4->flowi4_tos = tos & IPTOS_RT_MASK;
 	fl4->flowi4_scope = ((tos & RTO_ONLINK) ?
@@ -2156,14 +2276,17 @@ struct rtable *__ip_route_output_key(struct net *net, struct flowi4 *fl4)
 	}
 
 #ifdef CONFIG_IP_ROUTE_MULTIPATH
-	if (res.fi->fib_nhs > 1 && fl4->flowi4_oif == 0)
+	if (res.fi->fib_nhs > 1 && fl4->flowi4_oif == 0) {
 		fib_select_multipath(&res);
-	else
+		cacheable = false;
+	} else
 #endif
 	if (!res.prefixlen &&
 	    res.table->tb_num_default > 1 &&
-	    res.type == RTN_UNICAST && !fl4->flowi4_oif)
+	    res.type == RTN_UNICAST && !fl4->flowi4_oif) {
 		fib_select_default(&res);
+		cacheable = false;
+	}
 
 	if (!fl4->saddr)
 		fl4->saddr = FIB_RES_PREFSRC(net, res);
@@ -2171,6 +2294,10 @@ struct rtable *__ip_route_output_key(struct net *net, struct flowi4 *fl4)
 	dev_out = FIB_RES_DEV(res);
 	fl4->flowi4_oif = dev_out->ifindex;
 
+	rth = __mkroute_output(&res, fl4, orig_oif, dev_out, flags);
+	if (cacheable && !IS_ERR(rth) && rth->rt_type == RTN_UNICAST)
+		rt_output_cache_insert(net, &key, tos, fl4, rth);
+	goto out;
 
 make_route:
 	rth = __mkroute_output(&res, fl4, orig_oif, dev_out, flags);
@@ -2616,6 +2743,13 @@ static struct ctl_table ipv4_route_table[] = {
 		.mode		= 0644,
 		.proc_handler	= proc_dointvec,
 	},
+	{
+		.procname	= "output_cache",
+		.data		= &ip_rt_output_cache,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec,
+	},
 	{ }
 };
 
@@ -2686,6 +2820,51 @@ static __net_initdata struct pernet_operations rt_genid_ops = {
 	.init = rt_genid_init,
 };
 
+static int __net_init rt_output_cache_init(struct net *net)
+{
+	net->ipv4.rt_output_cache = alloc_percpu(struct rt_output_cache);
+	if (!net->ipv4.rt_output_cache)
+		return -ENOMEM;
+	return 0;
+}
+
+static void __net_exit
+rt_output_cache_free(struct rt_output_cache __percpu *pcache)
+{
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		struct rt_output_cache *cache = per_cpu_ptr(pcache, cpu);
+
+		for (i = 0; i < RT_OUTPUT_CACHE_SIZE; i++)
+			if (cache->entries[i].rth)
+				ip_rt_put(cache->entries[i].rth);
+	}
+	free_percpu(pcache);
+}
+
+/* Runs before the namespace's devices are unregistered, which would
+ * otherwise wait forever for the references the cache holds.
+ */
+static void __net_exit rt_output_cache_exit_batch(struct list_head *net_list)
+{
+	struct net *net;
+
+	list_for_each_entry(net, net_list, exit_list) {
+		net->ipv4.rt_output_cache_stash = net->ipv4.rt_output_cache;
+		net->ipv4.rt_output_cache = NULL;
+	}
+	synchronize_rcu_bh();
+
+	list_for_each_entry(net, net_list, exit_list)
+		rt_output_cache_free(net->ipv4.rt_output_cache_stash);
+}
+
+static __net_initdata struct pernet_operations rt_output_cache_ops = {
+	.init = rt_output_cache_init,
+	.exit_batch = rt_output_cache_exit_batch,
+};
+
 static int __net_init ipv4_inetpeer_init(struct net *net)
 {
 	struct inet_peer_base *bp = kmalloc(sizeof(*bp), GFP_KERNEL);
@@ -2761,6 +2940,7 @@ int __init ip_rt_init(void)
 	register_pernet_subsys(&sysctl_route_ops);
 #endif
 	register_pernet_subsys(&rt_genid_ops);
+	register_pernet_device(&rt_output_cache_ops);
 	register_pernet_subsys(&ipv4_inetpeer_ops);
 	return rc;
 }
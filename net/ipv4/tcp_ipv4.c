@@ -76,6 +76,7 @@
 #include <net/secure_seq.h>
 #include <net/tcp_memcontrol.h>
 #include <net/busy_poll.h>
+#include <net/stack_latency.h>
 
 #include <linux/inet.h>
 #include <linux/ipv6.h>
@@ -634,7 +635,8 @@ static void tcp_v4_send_reset(struct sock *sk, struct sk_buff *skb)
 		 * no RST generated if md5 hash doesn't match.
 		 */
 		sk1 = __inet_lookup_listener(dev_net(skb_dst(skb)->dev),
-					     &tcp_hashinfo, ip_hdr(skb)->saddr,
+					     &tcp_hashinfo, NULL, 0,
+					     ip_hdr(skb)->saddr,
 					     th->source, ip_hdr(skb)->daddr,
 					     ntohs(th->source), inet_iif(skb));
 		/* don't send rst if it can't find key */
@@ -1254,7 +1256,8 @@ static const struct tcp_request_sock_ops tcp_request_sock_ipv4_ops = {
 };
 #endif
 
-int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
+static int __tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb,
+				 bool want_cookie)
 {
 	struct tcp_options_received tmp_opt;
 	struct request_sock *req;
@@ -1264,7 +1267,7 @@ int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 	__be32 saddr = ip_hdr(skb)->saddr;
 	__be32 daddr = ip_hdr(skb)->daddr;
 	__u32 isn = TCP_SKB_CB(skb)->when;
-	bool want_cookie = false, fastopen;
+	bool fastopen;
 	struct flowi4 fl4;
 	struct tcp_fastopen_cookie foc = { .len = -1 };
 	int err;
@@ -1277,7 +1280,7 @@ int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 	 * limitations, they conserve resources and peer is
 	 * evidently real one.
 	 */
-	if ((sysctl_tcp_syncookies == 2 ||
+	if (!want_cookie && (sysctl_tcp_syncookies == 2 ||
 	     inet_csk_reqsk_queue_is_full(sk)) && !isn) {
 		want_cookie = tcp_syn_flood_action(sk, skb, "TCP");
 		if (!want_cookie)
@@ -1396,8 +1399,75 @@ drop:
 	NET_INC_STATS_BH(sock_net(sk), LINUX_MIB_LISTENDROPS);
 	return 0;
 }
+
+int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
+{
+	return __tcp_v4_conn_request(sk, skb, false);
+}
 EXPORT_SYMBOL(tcp_v4_conn_request);
 
+#ifdef CONFIG_SYN_COOKIES
+/*
+ * Once the SYN queue of a listener overflows (or if syncookies are
+ * forced), every new SYN is answered with a syncookie and leaves no
+ * state behind.  Such SYNs only read the listener, so send their
+ * SYN-ACK without taking the listener lock: a SYN flood, or a high
+ * connection rate, is then handled by all the cpus receiving it
+ * instead of serializing on the socket lock and backlog of the one
+ * listening socket.
+ *
+ * syn_wait_lock is only held for reading, it keeps listen_opt alive
+ * and the SYN queue stable while we check this is not a retransmit
+ * of a SYN already queued.
+ *
+ * Returns true if the SYN was consumed.
+ */
+static bool tcp_v4_syn_lockless(struct sock *sk, struct sk_buff *skb)
+{
+	struct request_sock_queue *queue = &inet_csk(sk)->icsk_accept_queue;
+	const struct tcphdr *th = tcp_hdr(skb);
+	const struct iphdr *iph = ip_hdr(skb);
+	struct request_sock **prev;
+	bool consumed = false;
+
+	if (!sysctl_tcp_syncookies ||
+	    !th->syn || th->ack || th->rst || th->fin)
+		return false;
+
+	read_lock(&queue->syn_wait_lock);
+	if (sk->sk_state != TCP_LISTEN || !queue->listen_opt)
+		goto out;
+	if (sysctl_tcp_syncookies != 2 && !reqsk_queue_is_full(queue))
+		goto out;
+	if (inet_csk_search_req(sk, &prev, th->source, iph->saddr, iph->daddr))
+		goto out;
+
+	consumed = true;
+#ifdef CONFIG_TCP_MD5SIG
+	if (tcp_v4_inbound_md5_hash(sk, skb))
+		goto discard;
+#endif
+	if (skb->len < tcp_hdrlen(skb) || tcp_checksum_complete(skb)) {
+		TCP_INC_STATS_BH(sock_net(sk), TCP_MIB_CSUMERRORS);
+		TCP_INC_STATS_BH(sock_net(sk), TCP_MIB_INERRS);
+		goto discard;
+	}
+
+	if (tcp_syn_flood_action(sk, skb, "TCP"))
+		__tcp_v4_conn_request(sk, skb, true);
+discard:
+	kfree_skb(skb);
+out:
+	read_unlock(&queue->syn_wait_lock);
+	return consumed;
+}
+#else
+static bool tcp_v4_syn_lockless(struct sock *sk, struct sk_buff *skb)
+{
+	return false;
+}
+#endif
+
 
 /*
  * The three way handshake has completed - we got a valid synack -
@@ -1705,6 +1775,8 @@ int tcp_v4_rcv(struct sk_buff *skb)
 	if (skb->pkt_type != PACKET_HOST)
 		goto discard_it;
 
+	net_lat_stage(net, skb, NET_LAT_IP);
+
 	/* Count it even if it's bad */
 	TCP_INC_STATS_BH(net, TCP_MIB_INSEGS);
 
@@ -1736,7 +1808,8 @@ int tcp_v4_rcv(struct sk_buff *skb)
 	TCP_SKB_CB(skb)->ip_dsfield = ipv4_get_dsfield(iph);
 	TCP_SKB_CB(skb)->sacked	 = 0;
 
-	sk = __inet_lookup_skb(&tcp_hashinfo, skb, th->source, th->dest);
+	sk = __inet_lookup_skb(&tcp_hashinfo, skb, th->doff * 4, th->source,
+			       th->dest);
 	if (!sk)
 		goto no_tcp_socket;
 
@@ -1759,6 +1832,11 @@ process:
 	sk_mark_napi_id(sk, skb);
 	skb->dev = NULL;
 
+	if (sk->sk_state == TCP_LISTEN && tcp_v4_syn_lockless(sk, skb)) {
+		sock_put(sk);
+		return 0;
+	}
+
 	bh_lock_sock_nested(sk);
 	ret = 0;
 	if (!sock_owned_by_user(sk)) {
@@ -1825,7 +1903,8 @@ do_time_wait:
 	switch (tcp_timewait_state_process(inet_twsk(sk), skb, th)) {
 	case TCP_TW_SYN: {
 		struct sock *sk2 = inet_lookup_listener(dev_net(skb->dev),
-							&tcp_hashinfo,
+							&tcp_hashinfo, skb,
+							th->doff * 4,
 							iph->saddr, th->source,
 							iph->daddr, th->dest,
 							inet_iif(skb));
@@ -1917,6 +1996,8 @@ void tcp_v4_destroy_sock(struct sock *sk)
 
 	tcp_cleanup_congestion_control(sk);
 
+	tcp_cleanup_ulp(sk);
+
 	/* Cleanup up the write buffer. */
 	tcp_write_queue_purge(sk);
 
@@ -2079,13 +2160,13 @@ static void *established_get_first(struct seq_file *seq)
 	for (; st->bucket <= tcp_hashinfo.ehash_mask; ++st->bucket) {
 		struct sock *sk;
 		struct hlist_nulls_node *node;
-		spinlock_t *lock = inet_ehash_lockp(&tcp_hashinfo, st->bucket);
+		numa_spinlock_t *lock = inet_ehash_lockp(&tcp_hashinfo, st->bucket);
 
 		/* Lockless fast path for the common case of empty buckets */
 		if (empty_bucket(st))
 			continue;
 
-		spin_lock_bh(lock);
+		numa_spin_lock_bh(lock);
 		sk_nulls_for_each(sk, node, &tcp_hashinfo.ehash[st->bucket].chain) {
 			if (sk->sk_family != st->family ||
 			    !net_eq(sock_net(sk), net)) {
@@ -2094,7 +2175,7 @@ static void *established_get_first(struct seq_file *seq)
 			rc = sk;
 			goto out;
 		}
-		spin_unlock_bh(lock);
+		numa_spin_unlock_bh(lock);
 	}
 out:
 	return rc;
@@ -2117,7 +2198,7 @@ static void *established_get_next(struct seq_file *seq, void *cur)
 			return sk;
 	}
 
-	spin_unlock_bh(inet_ehash_lockp(&tcp_hashinfo, st->bucket));
+	numa_spin_unlock_bh(inet_ehash_lockp(&tcp_hashinfo, st->bucket));
 	++st->bucket;
 	return established_get_first(seq);
 }
@@ -2256,7 +2337,7 @@ static void tcp_seq_stop(struct seq_file *seq, void *v)
 		break;
 	case TCP_SEQ_STATE_ESTABLISHED:
 		if (v)
-			spin_unlock_bh(inet_ehash_lockp(&tcp_hashinfo, st->bucket));
+			numa_spin_unlock_bh(inet_ehash_lockp(&tcp_hashinfo, st->bucket));
 		break;
 	}
 }
@@ -2508,6 +2589,7 @@ struct proto tcp_prot = {
 	.sockets_allocated	= &tcp_sockets_allocated,
 	.orphan_count		= &tcp_orphan_count,
 	.memory_allocated	= &tcp_memory_allocated,
+	.per_cpu_fw_alloc	= &tcp_memory_per_cpu_fw_alloc,
 	.memory_pressure	= &tcp_memory_pressure,
 	.sysctl_mem		= sysctl_tcp_mem,
 	.sysctl_wmem		= sysctl_tcp_wmem,
@@ -111,6 +111,7 @@
 #include <linux/static_key.h>
 #include <trace/events/skb.h>
 #include <net/busy_poll.h>
+#include <net/sock_reuseport.h>
 #include "udp_impl.h"
 
 struct udp_table udp_table __read_mostly;
@@ -128,6 +129,9 @@ EXPORT_SYMBOL(sysctl_udp_wmem_min);
 atomic_long_t udp_memory_allocated;
 EXPORT_SYMBOL(udp_memory_allocated);
 
+DEFINE_PER_CPU(int, udp_memory_per_cpu_fw_alloc);
+EXPORT_PER_CPU_SYMBOL_GPL(udp_memory_per_cpu_fw_alloc);
+
 #define MAX_UDP_PORTS 65536
 #define PORTS_PER_CHAIN (MAX_UDP_PORTS / UDP_HTABLE_SIZE_MIN)
 
@@ -204,6 +208,33 @@ static int udp_lib_lport_inuse2(struct net *net, __u16 num,
  *  @hash2_nulladdr: AF-dependent hash value in secondary hash chains,
  *                   with NULL address
  */
+/*
+ * Put a SO_REUSEPORT IPv4 socket into the reuseport group of the sockets
+ * bound to exactly the same address and port, or start a new group.
+ * Called with the primary hash slot locked.
+ */
+static int udp_reuseport_add_sock(struct sock *sk, struct udp_hslot *hslot)
+{
+	struct net *net = sock_net(sk);
+	struct hlist_nulls_node *node;
+	kuid_t uid = sock_i_uid(sk);
+	struct sock *sk2;
+
+	sk_nulls_for_each(sk2, node, &hslot->head) {
+		if (net_eq(sock_net(sk2), net) &&
+		    sk2 != sk &&
+		    sk2->sk_family == AF_INET &&
+		    udp_sk(sk2)->udp_port_hash == udp_sk(sk)->udp_port_hash &&
+		    sk2->sk_bound_dev_if == sk->sk_bound_dev_if &&
+		    sk2->sk_reuseport && uid_eq(uid, sock_i_uid(sk2)) &&
+		    inet_sk(sk2)->inet_rcv_saddr == inet_sk(sk)->inet_rcv_saddr &&
+		    rcu_access_pointer(sk2->sk_reuseport_cb))
+			return reuseport_add_sock(sk, sk2);
+	}
+
+	return reuseport_alloc(sk);
+}
+
 int udp_lib_get_port(struct sock *sk, unsigned short snum,
 		       int (*saddr_comp)(const struct sock *sk1,
 					 const struct sock *sk2),
@@ -289,6 +320,14 @@ found:
 	udp_sk(sk)->udp_port_hash = snum;
 	udp_sk(sk)->udp_portaddr_hash ^= snum;
 	if (sk_unhashed(sk)) {
+		if (sk->sk_reuseport && sk->sk_family == AF_INET &&
+		    udp_reuseport_add_sock(sk, hslot)) {
+			inet_sk(sk)->inet_num = 0;
+			udp_sk(sk)->udp_port_hash = 0;
+			udp_sk(sk)->udp_portaddr_hash ^= snum;
+			goto fail_unlock;
+		}
+
 		sk_nulls_add_node_rcu(sk, &hslot->head);
 		hslot->count++;
 		sock_prot_inuse_add(sock_net(sk), sk->sk_prot, 1);
@@ -424,7 +463,8 @@ static unsigned int udp_ehashfn(struct net *net, const __be32 laddr,
 static struct sock *udp4_lib_lookup2(struct net *net,
 		__be32 saddr, __be16 sport,
 		__be32 daddr, unsigned int hnum, int dif,
-		struct udp_hslot *hslot2, unsigned int slot2)
+		struct udp_hslot *hslot2, unsigned int slot2,
+		struct sk_buff *skb)
 {
 	struct sock *sk, *result;
 	struct hlist_nulls_node *node;
@@ -460,6 +500,14 @@ begin:
 	 */
 	if (get_nulls_value(node) != slot2)
 		goto begin;
+	if (result && reuseport && skb) {
+		struct sock *sk2 = reuseport_select_sock(result, skb,
+						sizeof(struct udphdr));
+
+		if (sk2 && compute_score2(sk2, net, saddr, sport,
+					  daddr, hnum, dif) == badness)
+			result = sk2;
+	}
 	if (result) {
 		if (unlikely(!atomic_inc_not_zero_hint(&result->sk_refcnt, 2)))
 			result = NULL;
@@ -472,12 +520,71 @@ begin:
 	return result;
 }
 
+/* Connected IPv4 sockets are also hashed on their four-tuple, so that the
+ * packets of a connected flow find their socket without walking chains
+ * shared with every other socket on the same port.
+ */
+static struct static_key udp_hash4_needed __read_mostly;
+static u32 udp_hash4_secret __read_mostly;
+
+static unsigned int udp4_hash4(const struct net *net, __be32 laddr,
+			       unsigned short lport, __be32 faddr,
+			       __be16 fport)
+{
+	return jhash_3words((__force u32)laddr, (__force u32)faddr,
+			    ((u32)lport << 16) | (__force u32)fport,
+			    udp_hash4_secret + net_hash_mix(net));
+}
+
+static struct sock *udp4_lib_lookup4(struct net *net, __be32 saddr,
+				     __be16 sport, __be32 daddr,
+				     unsigned short hnum, int dif,
+				     struct udp_table *udptable)
+{
+	unsigned int slot4 = udp4_hash4(net, daddr, hnum, saddr, sport) &
+			     udptable->mask;
+	struct udp_hslot *hslot4 = &udptable->hash4[slot4];
+	INET_ADDR_COOKIE(acookie, saddr, daddr);
+	const __portpair ports = INET_COMBINED_PORTS(sport, hnum);
+	struct hlist_nulls_node *node;
+	struct udp_sock *up;
+	struct sock *sk;
+
+	rcu_read_lock();
+begin:
+	hlist_nulls_for_each_entry_rcu(up, node, &hslot4->head,
+				       udp_hash4_node) {
+		sk = (struct sock *)up;
+		if (!INET_MATCH(sk, net, acookie, saddr, daddr, ports, dif))
+			continue;
+		if (unlikely(!atomic_inc_not_zero_hint(&sk->sk_refcnt, 2)))
+			goto out;
+		if (unlikely(!INET_MATCH(sk, net, acookie,
+					 saddr, daddr, ports, dif))) {
+			sock_put(sk);
+			goto begin;
+		}
+		rcu_read_unlock();
+		return sk;
+	}
+	/*
+	 * if the nulls value we got at the end of this lookup is
+	 * not the expected one, we must restart lookup.
+	 * We probably met an item that was moved to another chain.
+	 */
+	if (get_nulls_value(node) != slot4)
+		goto begin;
+out:
+	rcu_read_unlock();
+	return NULL;
+}
+
 /* UDP is nearly always wildcards out the wazoo, it makes no sense to try
  * harder than this. -DaveM
  */
 struct sock *__udp4_lib_lookup(struct net *net, __be32 saddr,
 		__be16 sport, __be32 daddr, __be16 dport,
-		int dif, struct udp_table *udptable)
+		int dif, struct udp_table *udptable, struct sk_buff *skb)
 {
 	struct sock *sk, *result;
 	struct hlist_nulls_node *node;
@@ -487,6 +594,14 @@ struct sock *__udp4_lib_lookup(struct net *net, __be32 saddr,
 	int score, badness, matches = 0, reuseport = 0;
 	u32 hash = 0;
 
+	/* An exact match always wins over wildcard sockets */
+	if (static_key_false(&udp_hash4_needed)) {
+		result = udp4_lib_lookup4(net, saddr, sport, daddr, hnum, dif,
+					  udptable);
+		if (result)
+			return result;
+	}
+
 	rcu_read_lock();
 	if (hslot->count > 10) {
 		hash2 = udp4_portaddr_hash(net, daddr, hnum);
@@ -497,7 +612,7 @@ struct sock *__udp4_lib_lookup(struct net *net, __be32 saddr,
 
 		result = udp4_lib_lookup2(net, saddr, sport,
 					  daddr, hnum, dif,
-					  hslot2, slot2);
+					  hslot2, slot2, skb);
 		if (!result) {
 			hash2 = udp4_portaddr_hash(net, htonl(INADDR_ANY), hnum);
 			slot2 = hash2 & udptable->mask;
@@ -507,7 +622,7 @@ struct sock *__udp4_lib_lookup(struct net *net, __be32 saddr,
 
 			result = udp4_lib_lookup2(net, saddr, sport,
 						  htonl(INADDR_ANY), hnum, dif,
-						  hslot2, slot2);
+						  hslot2, slot2, skb);
 		}
 		rcu_read_unlock();
 		return result;
@@ -542,6 +657,14 @@ begin:
 	if (get_nulls_value(node) != slot)
 		goto begin;
 
+	if (result && reuseport && skb) {
+		struct sock *sk2 = reuseport_select_sock(result, skb,
+						sizeof(struct udphdr));
+
+		if (sk2 && compute_score(sk2, net, saddr, hnum, sport,
+					 daddr, dport, dif) == badness)
+			result = sk2;
+	}
 	if (result) {
 		if (unlikely(!atomic_inc_not_zero_hint(&result->sk_refcnt, 2)))
 			result = NULL;
@@ -564,13 +687,14 @@ static inline struct sock *__udp4_lib_lookup_skb(struct sk_buff *skb,
 
 	return __udp4_lib_lookup(dev_net(skb_dst(skb)->dev), iph->saddr, sport,
 				 iph->daddr, dport, inet_iif(skb),
-				 udptable);
+				 udptable, skb);
 }
 
 struct sock *udp4_lib_lookup(struct net *net, __be32 saddr, __be16 sport,
 			     __be32 daddr, __be16 dport, int dif)
 {
-	return __udp4_lib_lookup(net, saddr, sport, daddr, dport, dif, &udp_table);
+	return __udp4_lib_lookup(net, saddr, sport, daddr, dport, dif,
+				 &udp_table, NULL);
 }
 EXPORT_SYMBOL_GPL(udp4_lib_lookup);
 
@@ -639,7 +763,8 @@ void __udp4_lib_err(struct sk_buff *skb, u32 info, struct udp_table *udptable)
 	struct net *net = dev_net(skb->dev);
 
 	sk = __udp4_lib_lookup(net, iph->daddr, uh->dest,
-			iph->saddr, uh->source, skb->dev->ifindex, udptable);
+			iph->saddr, uh->source, skb->dev->ifindex, udptable,
+			NULL);
 	if (sk == NULL) {
 		ICMP_INC_STATS_BH(net, ICMP_MIB_INERRORS);
 		return;	/* No socket for error */
@@ -800,7 +925,8 @@ void udp_set_csum(bool nocheck, struct sk_buff *skb,
 }
 EXPORT_SYMBOL(udp_set_csum);
 
-static int udp_send_skb(struct sk_buff *skb, struct flowi4 *fl4)
+static int udp_send_skb(struct sk_buff *skb, struct flowi4 *fl4,
+			u16 gso_size)
 {
 	struct sock *sk = skb->sk;
 	struct inet_sock *inet = inet_sk(sk);
@@ -820,6 +946,34 @@ static int udp_send_skb(struct sk_buff *skb, struct flowi4 *fl4)
 	uh->len = htons(len);
 	uh->check = 0;
 
+	if (gso_size) {
+		const int hlen = skb_network_header_len(skb) +
+				 sizeof(struct udphdr);
+
+		if (hlen + gso_size > ip_skb_dst_mtu(skb) ||
+		    len - sizeof(struct udphdr) > gso_size * UDP_MAX_SEGMENTS ||
+		    is_udplite || sk->sk_no_check_tx) {
+			kfree_skb(skb);
+			return -EINVAL;
+		}
+		if (dst_xfrm(skb_dst(skb))) {
+			kfree_skb(skb);
+			return -EIO;
+		}
+
+		if (len - sizeof(struct udphdr) > gso_size) {
+			skb_shinfo(skb)->gso_size = gso_size;
+			skb_shinfo(skb)->gso_type = SKB_GSO_UDP_L4;
+			skb_shinfo(skb)->gso_segs =
+				DIV_ROUND_UP(len - sizeof(struct udphdr),
+					     gso_size);
+			/* the segments are checksummed in GSO, in software
+			 * if the device cannot do it
+			 */
+			skb->ip_summed = CHECKSUM_PARTIAL;
+		}
+	}
+
 	if (is_udplite)  				 /*     UDP-Lite      */
 		csum = udplite_csum(skb);
 
@@ -871,7 +1025,7 @@ int udp_push_pending_frames(struct sock *sk)
 	if (!skb)
 		goto out;
 
-	err = udp_send_skb(skb, fl4);
+	err = udp_send_skb(skb, fl4, 0);
 
 out:
 	up->len = 0;
@@ -915,6 +1069,7 @@ int udp_sendmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
 	ipc.tx_flags = 0;
 	ipc.ttl = 0;
 	ipc.tos = -1;
+	ipc.gso_size = up->gso_size;
 
 	getfrag = is_udplite ? udplite_getfrag : ip_generic_getfrag;
 
@@ -1061,7 +1216,7 @@ back_from_confirm:
 				  msg->msg_flags);
 		err = PTR_ERR(skb);
 		if (!IS_ERR_OR_NULL(skb))
-			err = udp_send_skb(skb, fl4);
+			err = udp_send_skb(skb, fl4, ipc.gso_size);
 		goto out;
 	}
 
@@ -1180,6 +1335,80 @@ out:
 }
 
 
+/*
+ * Move everything softirq has queued so far onto the reader queue in one
+ * go: recvmmsg() and back to back recvmsg() calls then dequeue without
+ * bouncing sk_receive_queue.lock against the producer for every datagram.
+ * Called with the reader queue lock held.
+ */
+static void udp_refill_reader_queue(struct sock *sk, struct sk_buff_head *queue)
+{
+	struct sk_buff_head *sk_queue = &sk->sk_receive_queue;
+
+	spin_lock(&sk_queue->lock);
+	skb_queue_splice_tail_init(sk_queue, queue);
+	spin_unlock(&sk_queue->lock);
+}
+
+/**
+ *	__skb_recv_udp - Receive a datagram from a UDP socket
+ *	@sk: socket
+ *	@flags: MSG_ flags
+ *	@peeked: returns non-zero if this packet has been seen before
+ *	@off: an offset in bytes to peek skb from
+ *	@err: error code returned
+ *
+ *	Like __skb_recv_datagram(), but serves from the reader queue and
+ *	only goes to sk_receive_queue once that is empty.
+ */
+struct sk_buff *__skb_recv_udp(struct sock *sk, unsigned int flags,
+			       int *peeked, int *off, int *err)
+{
+	struct sk_buff_head *sk_queue = &sk->sk_receive_queue;
+	struct sk_buff_head *queue = &udp_sk(sk)->reader_queue;
+	struct sk_buff *skb, *last;
+	long timeo;
+	int error = sock_error(sk);
+
+	if (error)
+		goto no_packet;
+
+	timeo = sock_rcvtimeo(sk, flags & MSG_DONTWAIT);
+
+	do {
+		spin_lock_bh(&queue->lock);
+		skb = __skb_try_recv_from_queue(sk, queue, flags, peeked, off,
+						&last);
+		if (!skb && !skb_queue_empty(sk_queue)) {
+			udp_refill_reader_queue(sk, queue);
+			skb = __skb_try_recv_from_queue(sk, queue, flags,
+							peeked, off, &last);
+		}
+		spin_unlock_bh(&queue->lock);
+		if (skb)
+			return skb;
+
+		if (sk_can_busy_loop(sk) &&
+		    sk_busy_loop(sk, flags & MSG_DONTWAIT))
+			continue;
+
+		/* User doesn't want to wait */
+		error = -EAGAIN;
+		if (!timeo)
+			goto no_packet;
+
+		/* anything new shows up on sk_receive_queue */
+	} while (!__skb_wait_for_more_packets(sk, err, &timeo,
+					      (struct sk_buff *)sk_queue));
+
+	return NULL;
+
+no_packet:
+	*err = error;
+	return NULL;
+}
+EXPORT_SYMBOL(__skb_recv_udp);
+
 /**
  *	first_packet_length	- return length of first packet in receive queue
  *	@sk: socket
@@ -1189,22 +1418,27 @@ out:
  */
 static unsigned int first_packet_length(struct sock *sk)
 {
-	struct sk_buff_head list_kill, *rcvq = &sk->sk_receive_queue;
+	struct sk_buff_head list_kill, *rcvq = &udp_sk(sk)->reader_queue;
 	struct sk_buff *skb;
 	unsigned int res;
 
 	__skb_queue_head_init(&list_kill);
 
 	spin_lock_bh(&rcvq->lock);
-	while ((skb = skb_peek(rcvq)) != NULL &&
-		udp_lib_checksum_complete(skb)) {
-		UDP_INC_STATS_BH(sock_net(sk), UDP_MIB_CSUMERRORS,
-				 IS_UDPLITE(sk));
-		UDP_INC_STATS_BH(sock_net(sk), UDP_MIB_INERRORS,
-				 IS_UDPLITE(sk));
-		atomic_inc(&sk->sk_drops);
-		__skb_unlink(skb, rcvq);
-		__skb_queue_tail(&list_kill, skb);
+	for (;;) {
+		while ((skb = skb_peek(rcvq)) != NULL &&
+			udp_lib_checksum_complete(skb)) {
+			UDP_INC_STATS_BH(sock_net(sk), UDP_MIB_CSUMERRORS,
+					 IS_UDPLITE(sk));
+			UDP_INC_STATS_BH(sock_net(sk), UDP_MIB_INERRORS,
+					 IS_UDPLITE(sk));
+			atomic_inc(&sk->sk_drops);
+			__skb_unlink(skb, rcvq);
+			__skb_queue_tail(&list_kill, skb);
+		}
+		if (skb || skb_queue_empty(&sk->sk_receive_queue))
+			break;
+		udp_refill_reader_queue(sk, rcvq);
 	}
 	res = skb ? skb->len : 0;
 	spin_unlock_bh(&rcvq->lock);
@@ -1277,8 +1511,8 @@ int udp_recvmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
 		return ip_recv_error(sk, msg, len, addr_len);
 
 try_again:
-	skb = __skb_recv_datagram(sk, flags | (noblock ? MSG_DONTWAIT : 0),
-				  &peeked, &off, &err);
+	skb = __skb_recv_udp(sk, flags | (noblock ? MSG_DONTWAIT : 0),
+			     &peeked, &off, &err);
 	if (!skb)
 		goto out;
 
@@ -1338,6 +1572,8 @@ try_again:
 	}
 	if (inet->cmsg_flags)
 		ip_cmsg_recv(msg, skb);
+	if (udp_sk(sk)->gro_enabled)
+		udp_cmsg_recv(msg, sk, skb);
 
 	err = copied;
 	if (flags & MSG_TRUNC)
@@ -1350,7 +1586,7 @@ out:
 
 csum_copy_err:
 	slow = lock_sock_fast(sk);
-	if (!skb_kill_datagram(sk, skb, flags)) {
+	if (!__sk_queue_drop_skb(sk, &udp_sk(sk)->reader_queue, skb, flags)) {
 		UDP_INC_STATS_USER(sock_net(sk), UDP_MIB_CSUMERRORS, is_udplite);
 		UDP_INC_STATS_USER(sock_net(sk), UDP_MIB_INERRORS, is_udplite);
 	}
@@ -1365,6 +1601,101 @@ csum_copy_err:
 }
 
 
+/* Called with the primary hash slot lock held */
+static bool udp_unhash4(struct udp_table *udptable, struct sock *sk)
+{
+	struct udp_sock *up = udp_sk(sk);
+	struct udp_hslot *hslot4;
+
+	if (hlist_nulls_unhashed(&up->udp_hash4_node))
+		return false;
+
+	hslot4 = &udptable->hash4[up->udp_hash4 & udptable->mask];
+	spin_lock(&hslot4->lock);
+	hlist_nulls_del_init_rcu(&up->udp_hash4_node);
+	hslot4->count--;
+	spin_unlock(&hslot4->lock);
+	return true;
+}
+
+/* (Re)hash a connected socket on its four-tuple */
+static void udp_lib_hash4(struct sock *sk)
+{
+	struct udp_table *udptable = sk->sk_prot->h.udp_table;
+	struct inet_sock *inet = inet_sk(sk);
+	struct udp_sock *up = udp_sk(sk);
+	struct udp_hslot *hslot, *hslot4;
+	bool added = false;
+
+	if (!sk_hashed(sk) || sk->sk_state != TCP_ESTABLISHED ||
+	    !inet->inet_rcv_saddr)
+		return;
+
+	net_get_random_once(&udp_hash4_secret, sizeof(udp_hash4_secret));
+
+	hslot = udp_hashslot(udptable, sock_net(sk), up->udp_port_hash);
+	spin_lock_bh(&hslot->lock);
+	if (sk_hashed(sk)) {
+		added = !udp_unhash4(udptable, sk);
+
+		up->udp_hash4 = udp4_hash4(sock_net(sk), inet->inet_rcv_saddr,
+					   inet->inet_num, inet->inet_daddr,
+					   inet->inet_dport);
+		hslot4 = &udptable->hash4[up->udp_hash4 & udptable->mask];
+		spin_lock(&hslot4->lock);
+		hlist_nulls_add_head_rcu(&up->udp_hash4_node, &hslot4->head);
+		hslot4->count++;
+		spin_unlock(&hslot4->lock);
+	}
+	spin_unlock_bh(&hslot->lock);
+
+	if (added)
+		static_key_slow_inc(&udp_hash4_needed);
+}
+
+static void udp_lib_unhash4(struct sock *sk)
+{
+	struct udp_table *udptable = sk->sk_prot->h.udp_table;
+	struct udp_hslot *hslot;
+	bool removed;
+
+	if (hlist_nulls_unhashed(&udp_sk(sk)->udp_hash4_node))
+		return;
+
+	hslot = udp_hashslot(udptable, sock_net(sk), udp_sk(sk)->udp_port_hash);
+	spin_lock_bh(&hslot->lock);
+	removed = udp_unhash4(udptable, sk);
+	spin_unlock_bh(&hslot->lock);
+
+	if (removed)
+		static_key_slow_dec(&udp_hash4_needed);
+}
+
+static int udp_v4_connect(struct sock *sk, struct sockaddr *uaddr,
+			  int addr_len)
+{
+	int err = ip4_datagram_connect(sk, uaddr, addr_len);
+
+	if (!err) {
+		lock_sock(sk);
+		udp_lib_hash4(sk);
+		release_sock(sk);
+	}
+	return err;
+}
+
+/* Like sk_prot_clear_portaddr_nulls(), but also keep udp_hash4_node.next,
+ * which RCU readers of the four-tuple hash may still be following.
+ */
+static void udp_v4_clear_sk(struct sock *sk, int size)
+{
+	int next4 = offsetof(struct udp_sock, udp_hash4_node.next);
+
+	sk_prot_clear_portaddr_nulls(sk, next4);
+	memset((char *)sk + next4 + sizeof(void *), 0,
+	       size - next4 - sizeof(void *));
+}
+
 int udp_disconnect(struct sock *sk, int flags)
 {
 	struct inet_sock *inet = inet_sk(sk);
@@ -1372,6 +1703,7 @@ int udp_disconnect(struct sock *sk, int flags)
 	 *	1003.1g - break association.
 	 */
 
+	udp_lib_unhash4(sk);
 	sk->sk_state = TCP_CLOSE;
 	inet->inet_daddr = 0;
 	inet->inet_dport = 0;
@@ -1394,12 +1726,16 @@ void udp_lib_unhash(struct sock *sk)
 	if (sk_hashed(sk)) {
 		struct udp_table *udptable = sk->sk_prot->h.udp_table;
 		struct udp_hslot *hslot, *hslot2;
+		bool removed4;
 
 		hslot  = udp_hashslot(udptable, sock_net(sk),
 				      udp_sk(sk)->udp_port_hash);
 		hslot2 = udp_hashslot2(udptable, udp_sk(sk)->udp_portaddr_hash);
 
 		spin_lock_bh(&hslot->lock);
+		removed4 = udp_unhash4(udptable, sk);
+		if (rcu_access_pointer(sk->sk_reuseport_cb))
+			reuseport_detach_sock(sk);
 		if (sk_nulls_del_node_init_rcu(sk)) {
 			hslot->count--;
 			inet_sk(sk)->inet_num = 0;
@@ -1411,6 +1747,9 @@ void udp_lib_unhash(struct sock *sk)
 			spin_unlock(&hslot2->lock);
 		}
 		spin_unlock_bh(&hslot->lock);
+
+		if (removed4)
+			static_key_slow_dec(&udp_hash4_needed);
 	}
 }
 EXPORT_SYMBOL(udp_lib_unhash);
@@ -1432,6 +1771,9 @@ void udp_lib_rehash(struct sock *sk, u16 newhash)
 					     udp_sk(sk)->udp_port_hash);
 			/* we must lock primary chain too */
 			spin_lock_bh(&hslot->lock);
+			/* the bound address changed, leave the group */
+			if (rcu_access_pointer(sk->sk_reuseport_cb))
+				reuseport_detach_sock(sk);
 
 			spin_lock(&hslot2->lock);
 			hlist_nulls_del_init_rcu(&udp_sk(sk)->udp_portaddr_node);
@@ -1501,7 +1843,7 @@ EXPORT_SYMBOL(udp_encap_enable);
  * Note that in the success and error cases, the skb is assumed to
  * have either been requeued or freed.
  */
-int udp_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
+static int udp_queue_rcv_one_skb(struct sock *sk, struct sk_buff *skb)
 {
 	struct udp_sock *up = udp_sk(sk);
 	int rc;
@@ -1617,6 +1959,61 @@ drop:
 	return -1;
 }
 
+/* A GRO packet reached a socket which did not ask for them (UDP_GRO),
+ * split it back into the datagrams it was built from.
+ */
+static struct sk_buff *udp_rcv_segment(struct sock *sk, struct sk_buff *skb)
+{
+	char cb[sizeof(skb->cb)];
+	struct sk_buff *segs, *seg;
+
+	/* SKB_GSO_CB() overlays UDP_SKB_CB(), keep the latter around */
+	memcpy(cb, skb->cb, sizeof(cb));
+	SKB_GSO_CB(skb)->mac_offset = skb_mac_header(skb) - skb->head;
+	SKB_GSO_CB(skb)->encap_level = 0;
+
+	segs = __udp_gso_segment(skb, NETIF_F_SG | NETIF_F_HW_CSUM);
+	if (IS_ERR_OR_NULL(segs)) {
+		atomic_add(skb_shinfo(skb)->gso_segs, &sk->sk_drops);
+		UDP_INC_STATS_BH(sock_net(sk), UDP_MIB_INERRORS,
+				 IS_UDPLITE(sk));
+		kfree_skb(skb);
+		return NULL;
+	}
+
+	for (seg = segs; seg; seg = seg->next) {
+		memcpy(seg->cb, cb, sizeof(cb));
+		__skb_pull(seg, skb_transport_offset(seg));
+		UDP_SKB_CB(seg)->cscov = seg->len;
+	}
+	consume_skb(skb);
+	return segs;
+}
+
+int udp_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
+{
+	struct sk_buff *next, *segs;
+	int ret;
+
+	if (likely(!skb_is_gso(skb) ||
+		   !(skb_shinfo(skb)->gso_type & SKB_GSO_UDP_L4) ||
+		   udp_sk(sk)->gro_enabled))
+		return udp_queue_rcv_one_skb(sk, skb);
+
+	segs = udp_rcv_segment(sk, skb);
+	for (skb = segs; skb; skb = next) {
+		next = skb->next;
+		skb->next = NULL;
+		ret = udp_queue_rcv_one_skb(sk, skb);
+		/* encapsulation sockets never ask for GRO packets, there
+		 * is no way to resubmit a split datagram to another protocol
+		 */
+		if (ret > 0)
+			kfree_skb(skb);
+	}
+	return 0;
+}
+
 
 static void flush_stack(struct sock **stack, unsigned int count,
 			struct sk_buff *skb, unsigned int final)
@@ -1923,6 +2320,13 @@ static struct sock *__udp4_lib_demux_lookup(struct net *net,
 	INET_ADDR_COOKIE(acookie, rmt_addr, loc_addr);
 	const __portpair ports = INET_COMBINED_PORTS(rmt_port, hnum);
 
+	if (static_key_false(&udp_hash4_needed)) {
+		result = udp4_lib_lookup4(net, rmt_addr, rmt_port, loc_addr,
+					  hnum, dif, &udp_table);
+		if (result)
+			return result;
+	}
+
 	rcu_read_lock();
 	result = NULL;
 	udp_portaddr_for_each_entry_rcu(sk, node, &hslot2->head) {
@@ -1996,6 +2400,7 @@ void udp_destroy_sock(struct sock *sk)
 	struct udp_sock *up = udp_sk(sk);
 	bool slow = lock_sock_fast(sk);
 	udp_flush_pending_frames(sk);
+	__skb_queue_purge(&up->reader_queue);
 	unlock_sock_fast(sk, slow);
 	if (static_key_false(&udp_encap_needed) && up->encap_type) {
 		void (*encap_destroy)(struct sock *sk);
@@ -2062,6 +2467,16 @@ int udp_lib_setsockopt(struct sock *sk, int level, int optname,
 		up->no_check6_rx = valbool;
 		break;
 
+	case UDP_SEGMENT:
+		if (val < 0 || val > USHRT_MAX)
+			return -EINVAL;
+		up->gso_size = val;
+		break;
+
+	case UDP_GRO:
+		up->gro_enabled = valbool;
+		break;
+
 	/*
 	 * 	UDP-Lite's partial checksum coverage (RFC 3828).
 	 */
@@ -2152,6 +2567,14 @@ int udp_lib_getsockopt(struct sock *sk, int level, int optname,
 		val = up->no_check6_rx;
 		break;
 
+	case UDP_SEGMENT:
+		val = up->gso_size;
+		break;
+
+	case UDP_GRO:
+		val = up->gro_enabled;
+		break;
+
 	/* The following two cannot be changed on UDP sockets, the return is
 	 * always 0 (which corresponds to the full checksum coverage of UDP). */
 	case UDPLITE_SEND_CSCOV:
@@ -2209,6 +2632,9 @@ unsigned int udp_poll(struct file *file, struct socket *sock, poll_table *wait)
 	unsigned int mask = datagram_poll(file, sock, wait);
 	struct sock *sk = sock->sk;
 
+	if (!skb_queue_empty(&udp_sk(sk)->reader_queue))
+		mask |= POLLIN | POLLRDNORM;
+
 	sock_rps_record_flow(sk);
 
 	/* Check for false positives due to checksum errors */
@@ -2225,7 +2651,8 @@ struct proto udp_prot = {
 	.name		   = "UDP",
 	.owner		   = THIS_MODULE,
 	.close		   = udp_lib_close,
-	.connect	   = ip4_datagram_connect,
+	.init		   = udp_init_sock,
+	.connect	   = udp_v4_connect,
 	.disconnect	   = udp_disconnect,
 	.ioctl		   = udp_ioctl,
 	.destroy	   = udp_destroy_sock,
@@ -2241,6 +2668,7 @@ struct proto udp_prot = {
 	.rehash		   = udp_v4_rehash,
 	.get_port	   = udp_v4_get_port,
 	.memory_allocated  = &udp_memory_allocated,
+	.per_cpu_fw_alloc  = &udp_memory_per_cpu_fw_alloc,
 	.sysctl_mem	   = sysctl_udp_mem,
 	.sysctl_wmem	   = &sysctl_udp_wmem_min,
 	.sysctl_rmem	   = &sysctl_udp_rmem_min,
@@ -2251,7 +2679,7 @@ struct proto udp_prot = {
 	.compat_setsockopt = compat_udp_setsockopt,
 	.compat_getsockopt = compat_udp_getsockopt,
 #endif
-	.clear_sk	   = sk_prot_clear_portaddr_nulls,
+	.clear_sk	   = udp_v4_clear_sk,
 };
 EXPORT_SYMBOL(udp_prot);
 
@@ -2490,7 +2918,7 @@ void __init udp_table_init(struct udp_table *table, const char *name)
 	unsigned int i;
 
 	table->hash = alloc_large_system_hash(name,
-					      2 * sizeof(struct udp_hslot),
+					      3 * sizeof(struct udp_hslot),
 					      uhash_entries,
 					      21, /* one slot per 2 MB */
 					      0,
@@ -2500,6 +2928,7 @@ void __init udp_table_init(struct udp_table *table, const char *name)
 					      64 * 1024);
 
 	table->hash2 = table->hash + (table->mask + 1);
+	table->hash4 = table->hash2 + (table->mask + 1);
 	for (i = 0; i <= table->mask; i++) {
 		INIT_HLIST_NULLS_HEAD(&table->hash[i].head, i);
 		table->hash[i].count = 0;
@@ -2510,6 +2939,11 @@ void __init udp_table_init(struct udp_table *table, const char *name)
 		table->hash2[i].count = 0;
 		spin_lock_init(&table->hash2[i].lock);
 	}
+	for (i = 0; i <= table->mask; i++) {
+		INIT_HLIST_NULLS_HEAD(&table->hash4[i].head, i);
+		table->hash4[i].count = 0;
+		spin_lock_init(&table->hash4[i].lock);
+	}
 }
 
 void __init udp_init(void)
@@ -47,6 +47,96 @@ static int udp4_ufo_send_check(struct sk_buff *skb)
 	return 0;
 }
 
+/* Split a datagram built with UDP_SEGMENT (or aggregated by GRO) back into
+ * gso_size sized datagrams, each with its own UDP header.  The skb data
+ * must start at the UDP header.
+ */
+struct sk_buff *__udp_gso_segment(struct sk_buff *gso_skb,
+				  netdev_features_t features)
+{
+	struct sk_buff *segs = ERR_PTR(-EINVAL);
+	unsigned int sum_truesize = 0;
+	struct sk_buff *skb;
+	struct udphdr *uh;
+	unsigned int mss;
+	bool copy_destructor;
+	__sum16 check;
+	__be16 newlen;
+
+	if (!pskb_may_pull(gso_skb, sizeof(*uh)))
+		goto out;
+
+	mss = skb_shinfo(gso_skb)->gso_size;
+	if (unlikely(gso_skb->len <= sizeof(*uh) + mss))
+		goto out;
+
+	if (skb_gso_ok(gso_skb, features | NETIF_F_GSO_ROBUST)) {
+		/* Packet is from an untrusted source, reset gso_segs. */
+		skb_shinfo(gso_skb)->gso_segs =
+			DIV_ROUND_UP(gso_skb->len - sizeof(*uh), mss);
+		segs = NULL;
+		goto out;
+	}
+
+	__skb_pull(gso_skb, sizeof(*uh));
+
+	copy_destructor = gso_skb->destructor == sock_wfree;
+
+	segs = skb_segment(gso_skb, features);
+	if (IS_ERR(segs))
+		goto out;
+
+	skb = segs;
+	uh = udp_hdr(skb);
+
+	/* the checksum field still holds the pseudo header sum for the
+	 * length of the whole datagram, adjust it to the segment length
+	 */
+	newlen = htons(sizeof(*uh) + mss);
+	check = csum16_add(csum16_sub(uh->check, uh->len), newlen);
+
+	do {
+		uh->len = newlen;
+		uh->check = check;
+
+		if (skb->ip_summed != CHECKSUM_PARTIAL)
+			uh->check = gso_make_checksum(skb, ~check) ? :
+				    CSUM_MANGLED_0;
+
+		if (copy_destructor) {
+			skb->destructor = gso_skb->destructor;
+			skb->sk = gso_skb->sk;
+			sum_truesize += skb->truesize;
+		}
+		skb = skb->next;
+		uh = udp_hdr(skb);
+	} while (skb->next);
+
+	/* The last segment keeps the socket reference, so that the sender
+	 * is only woken up once the whole datagram left the host.
+	 */
+	if (copy_destructor) {
+		swap(gso_skb->sk, skb->sk);
+		swap(gso_skb->destructor, skb->destructor);
+		sum_truesize += skb->truesize;
+		atomic_add(sum_truesize - gso_skb->truesize,
+			   &skb->sk->sk_wmem_alloc);
+	}
+
+	/* last segment can be shorter than gso_size */
+	newlen = htons(skb_tail_pointer(skb) - skb_transport_header(skb) +
+		       skb->data_len);
+	check = csum16_add(csum16_sub(uh->check, uh->len), newlen);
+
+	uh->len = newlen;
+	uh->check = check;
+
+	if (skb->ip_summed != CHECKSUM_PARTIAL)
+		uh->check = gso_make_checksum(skb, ~check) ? : CSUM_MANGLED_0;
+out:
+	return segs;
+}
+
 static struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb,
 					 netdev_features_t features)
 {
@@ -62,6 +152,11 @@ static struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb,
 		goto out;
 	}
 
+	if (skb_shinfo(skb)->gso_type & SKB_GSO_UDP_L4) {
+		segs = __udp_gso_segment(skb, features);
+		goto out;
+	}
+
 	mss = skb_shinfo(skb)->gso_size;
 	if (unlikely(skb->len <= mss))
 		goto out;
@@ -152,6 +247,107 @@ unlock:
 }
 EXPORT_SYMBOL(udp_del_offload);
 
+/* Called under rcu_read_lock() by the flow dissector */
+unsigned int udp_offload_encap_hlen(__be16 port)
+{
+	struct udp_offload_priv *uo_priv;
+
+	for (uo_priv = rcu_dereference(udp_offload_base); uo_priv != NULL;
+	     uo_priv = rcu_dereference(uo_priv->next)) {
+		if (uo_priv->offload->port == port)
+			return uo_priv->offload->encap_hlen;
+	}
+	return 0;
+}
+
+/* Is the datagram going to a local socket that accepts GRO packets ? */
+static bool udp4_gro_sk_enabled(struct sk_buff *skb, struct udphdr *uh)
+{
+	const struct iphdr *iph = skb_gro_network_header(skb);
+	struct sock *sk;
+	bool enabled;
+
+	sk = udp4_lib_lookup(dev_net(skb->dev), iph->saddr, uh->source,
+			     iph->daddr, uh->dest, skb->dev->ifindex);
+	if (!sk)
+		return false;
+	enabled = udp_sk(sk)->gro_enabled;
+	sock_put(sk);
+	return enabled;
+}
+
+static bool udp4_gro_csum_ok(struct sk_buff *skb)
+{
+	const struct iphdr *iph = skb_gro_network_header(skb);
+	__wsum wsum = NAPI_GRO_CB(skb)->csum;
+
+	switch (skb->ip_summed) {
+	case CHECKSUM_NONE:
+		wsum = skb_checksum(skb, skb_gro_offset(skb), skb_gro_len(skb),
+				    0);
+
+		/* fall through */
+
+	case CHECKSUM_COMPLETE:
+		if (csum_tcpudp_magic(iph->saddr, iph->daddr, skb_gro_len(skb),
+				      IPPROTO_UDP, wsum))
+			return false;
+		skb->ip_summed = CHECKSUM_UNNECESSARY;
+	}
+	return true;
+}
+
+/* Aggregate consecutive datagrams of the same size of a flow, the last one
+ * may be shorter.  The result looks like a UDP_SEGMENT datagram.
+ */
+static struct sk_buff **udp_gro_receive_segment(struct sk_buff **head,
+						struct sk_buff *skb,
+						struct udphdr *uh)
+{
+	unsigned int off = skb_gro_offset(skb);
+	struct sk_buff *p, **pp = NULL;
+	unsigned int ulen, len;
+	struct udphdr *uh2;
+
+	/* requires non zero csum, for symmetry with GSO */
+	ulen = ntohs(uh->len);
+	if (!uh->check || ulen != skb_gro_len(skb) || ulen <= sizeof(*uh) ||
+	    !udp4_gro_csum_ok(skb)) {
+		NAPI_GRO_CB(skb)->flush = 1;
+		return NULL;
+	}
+	len = ulen - sizeof(*uh);
+
+	skb_gro_pull(skb, sizeof(struct udphdr));
+	skb_gro_postpull_rcsum(skb, uh, sizeof(struct udphdr));
+
+	for (; (p = *head); head = &p->next) {
+		if (!NAPI_GRO_CB(p)->same_flow)
+			continue;
+
+		uh2 = (struct udphdr *)(p->data + off);
+		if ((*(u32 *)&uh->source != *(u32 *)&uh2->source)) {
+			NAPI_GRO_CB(p)->same_flow = 0;
+			continue;
+		}
+
+		/* A bigger datagram can not be appended, a shorter one
+		 * terminates the flow, as does reaching the segment limit.
+		 */
+		if (NAPI_GRO_CB(p)->flush || len > skb_shinfo(p)->gso_size ||
+		    skb_gro_receive(head, skb))
+			return head;
+
+		if (len < skb_shinfo(*head)->gso_size ||
+		    NAPI_GRO_CB(*head)->count >= UDP_MAX_SEGMENTS)
+			pp = head;
+		return pp;
+	}
+
+	/* first datagram of a new flow */
+	return NULL;
+}
+
 static struct sk_buff **udp_gro_receive(struct sk_buff **head, struct sk_buff *skb)
 {
 	struct udp_offload_priv *uo_priv;
@@ -160,8 +356,7 @@ static struct sk_buff **udp_gro_receive(struct sk_buff **head, struct sk_buff *s
 	unsigned int hlen, off;
 	int flush = 1;
 
-	if (NAPI_GRO_CB(skb)->udp_mark ||
-	    (!skb->encapsulation && skb->ip_summed != CHECKSUM_COMPLETE))
+	if (NAPI_GRO_CB(skb)->udp_mark)
 		goto out;
 
 	/* mark that this skb passed once through the udp gro layer */
@@ -183,9 +378,19 @@ static struct sk_buff **udp_gro_receive(struct sk_buff **head, struct sk_buff *s
 		    uo_priv->offload->callbacks.gro_receive)
 			goto unflush;
 	}
+
+	if (!skb->encapsulation && !NAPI_GRO_CB(skb)->flush &&
+	    udp4_gro_sk_enabled(skb, uh)) {
+		pp = udp_gro_receive_segment(head, skb, uh);
+		rcu_read_unlock();
+		return pp;
+	}
 	goto out_unlock;
 
 unflush:
+	if (!skb->encapsulation && skb->ip_summed != CHECKSUM_COMPLETE)
+		goto out_unlock;
+
 	flush = 0;
 
 	for (p = *head; p; p = p->next) {
@@ -228,8 +433,23 @@ static int udp_gro_complete(struct sk_buff *skb, int nhoff)
 			break;
 	}
 
-	if (uo_priv != NULL)
+	if (uo_priv != NULL) {
 		err = uo_priv->offload->callbacks.gro_complete(skb, nhoff + sizeof(struct udphdr));
+	} else {
+		/* aggregated by udp_gro_receive_segment() */
+		const struct iphdr *iph = ip_hdr(skb);
+
+		uh->check = ~csum_tcpudp_magic(iph->saddr, iph->daddr,
+					       skb->len - nhoff,
+					       IPPROTO_UDP, 0);
+		skb->csum_start = (unsigned char *)uh - skb->head;
+		skb->csum_offset = offsetof(struct udphdr, check);
+		skb->ip_summed = CHECKSUM_PARTIAL;
+
+		skb_shinfo(skb)->gso_segs = NAPI_GRO_CB(skb)->count;
+		skb_shinfo(skb)->gso_type |= SKB_GSO_UDP_L4;
+		err = 0;
+	}
 
 	rcu_read_unlock();
 	return err;
@@ -5369,12 +5369,14 @@ int __init addrconf_init(void)
 	/* Only the first call to __rtnl_register can fail */
 	__rtnl_register(PF_INET6, RTM_NEWADDR, inet6_rtm_newaddr, NULL, NULL);
 	__rtnl_register(PF_INET6, RTM_DELADDR, inet6_rtm_deladdr, NULL, NULL);
-	__rtnl_register(PF_INET6, RTM_GETADDR, inet6_rtm_getaddr,
-			inet6_dump_ifaddr, NULL);
-	__rtnl_register(PF_INET6, RTM_GETMULTICAST, NULL,
-			inet6_dump_ifmcaddr, NULL);
-	__rtnl_register(PF_INET6, RTM_GETANYCAST, NULL,
-			inet6_dump_ifacaddr, NULL);
+	__rtnl_register_flags(PF_INET6, RTM_GETADDR, inet6_rtm_getaddr,
+			      inet6_dump_ifaddr, NULL, RTNL_FLAG_DUMP_UNLOCKED);
+	__rtnl_register_flags(PF_INET6, RTM_GETMULTICAST, NULL,
+			      inet6_dump_ifmcaddr, NULL,
+			      RTNL_FLAG_DUMP_UNLOCKED);
+	__rtnl_register_flags(PF_INET6, RTM_GETANYCAST, NULL,
+			      inet6_dump_ifacaddr, NULL,
+			      RTNL_FLAG_DUMP_UNLOCKED);
 	__rtnl_register(PF_INET6, RTM_GETNETCONF, inet6_netconf_get_devconf,
 			inet6_netconf_dump_devconf, NULL);
 
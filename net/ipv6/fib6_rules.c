@@ -261,6 +261,11 @@ nla_put_failure:
 	return -ENOBUFS;
 }
 
+static void fib6_rule_flush(struct fib_rules_ops *ops)
+{
+	fib6_gen_bump(ops->fro_net);
+}
+
 static u32 fib6_rule_default_pref(struct fib_rules_ops *ops)
 {
 	return 0x3FFF;
@@ -284,6 +289,7 @@ static const struct fib_rules_ops __net_initconst fib6_rules_ops_template = {
 	.fill			= fib6_rule_fill,
 	.default_pref		= fib6_rule_default_pref,
 	.nlmsg_payload		= fib6_rule_nlmsg_payload,
+	.flush			= fib6_rule_flush,
 	.nlgroup		= RTNLGRP_IPV6_RULE,
 	.policy			= fib6_rule_policy,
 	.owner			= THIS_MODULE,
@@ -73,18 +73,18 @@ int __inet6_hash(struct sock *sk, struct inet_timewait_sock *tw)
 	} else {
 		unsigned int hash;
 		struct hlist_nulls_head *list;
-		spinlock_t *lock;
+		numa_spinlock_t *lock;
 
 		sk->sk_hash = hash = inet6_sk_ehashfn(sk);
 		list = &inet_ehash_bucket(hashinfo, hash)->chain;
 		lock = inet_ehash_lockp(hashinfo, hash);
-		spin_lock(lock);
+		numa_spin_lock(lock);
 		__sk_nulls_add_node_rcu(sk, list);
 		if (tw) {
 			WARN_ON(sk->sk_hash != tw->tw_hash);
 			twrefcnt = inet_twsk_unhash(tw);
 		}
-		spin_unlock(lock);
+		numa_spin_unlock(lock);
 	}
 
 	sock_prot_inuse_add(sock_net(sk), sk->sk_prot, 1);
@@ -255,13 +255,13 @@ static int __inet6_check_established(struct inet_timewait_death_row *death_row,
 	const unsigned int hash = inet6_ehashfn(net, daddr, lport, saddr,
 						inet->inet_dport);
 	struct inet_ehash_bucket *head = inet_ehash_bucket(hinfo, hash);
-	spinlock_t *lock = inet_ehash_lockp(hinfo, hash);
+	numa_spinlock_t *lock = inet_ehash_lockp(hinfo, hash);
 	struct sock *sk2;
 	const struct hlist_nulls_node *node;
 	struct inet_timewait_sock *tw = NULL;
 	int twrefcnt = 0;
 
-	spin_lock(lock);
+	numa_spin_lock(lock);
 
 	sk_nulls_for_each(sk2, node, &head->chain) {
 		if (sk2->sk_hash != hash)
@@ -289,7 +289,7 @@ static int __inet6_check_established(struct inet_timewait_death_row *death_row,
 		twrefcnt = inet_twsk_unhash(tw);
 		NET_INC_STATS_BH(net, LINUX_MIB_TIMEWAITRECYCLED);
 	}
-	spin_unlock(lock);
+	numa_spin_unlock(lock);
 	if (twrefcnt)
 		inet_twsk_put(tw);
 	sock_prot_inuse_add(sock_net(sk), sk->sk_prot, 1);
@@ -305,7 +305,7 @@ static int __inet6_check_established(struct inet_timewait_death_row *death_row,
 	return 0;
 
 not_unique:
-	spin_unlock(lock);
+	numa_spin_unlock(lock);
 	return -EADDRNOTAVAIL;
 }
 
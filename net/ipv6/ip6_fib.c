@@ -939,8 +939,10 @@ int fib6_add(struct fib6_node *root, struct rt6_info *rt, struct nl_info *info,
 	err = fib6_add_rt2node(fn, rt, info, mx, mx_len);
 	if (!err) {
 		fib6_start_gc(info->nl_net, rt);
-		if (!(rt->rt6i_flags & RTF_CACHE))
+		if (!(rt->rt6i_flags & RTF_CACHE)) {
 			fib6_prune_clones(info->nl_net, pn);
+			fib6_gen_bump(info->nl_net);
+		}
 	}
 
 out:
@@ -1384,6 +1386,8 @@ int fib6_del(struct rt6_info *rt, struct nl_info *info)
 	for (rtp = &fn->leaf; *rtp; rtp = &(*rtp)->dst.rt6_next) {
 		if (*rtp == rt) {
 			fib6_del_route(fn, rtp, info);
+			if (!(rt->rt6i_flags & RTF_CACHE))
+				fib6_gen_bump(net);
 			return 0;
 		}
 	}
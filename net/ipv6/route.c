@@ -63,6 +63,7 @@
 
 #ifdef CONFIG_SYSCTL
 #include <linux/sysctl.h>
+#include <linux/jhash.h>
 #endif
 
 enum rt6_nud_state {
@@ -914,15 +915,16 @@ static struct rt6_info *rt6_alloc_clone(struct rt6_info *ort,
 	return rt;
 }
 
-static struct rt6_info *ip6_pol_route(struct net *net, struct fib6_table *table, int oif,
-				      struct flowi6 *fl6, int flags)
+static struct rt6_info *__ip6_pol_route(struct net *net,
+					struct fib6_table *table, int oif,
+					struct flowi6 *fl6, int flags,
+					int reachable)
 {
 	struct fib6_node *fn;
 	struct rt6_info *rt, *nrt;
 	int strict = 0;
 	int attempts = 3;
 	int err;
-	int reachable = net->ipv6.devconf_all->forwarding ? 0 : RT6_LOOKUP_F_REACHABLE;
 
 	strict |= flags & RT6_LOOKUP_F_IFACE;
 
@@ -985,6 +987,125 @@ out2:
 	return rt;
 }
 
+/*
+ * Optional per-cpu cache in front of __ip6_pol_route(), so that repeated
+ * lookups for the same destination do not take tb6_lock and walk the
+ * tree.  Entries hold a reference on their route and are only used while
+ * the FIB, the route genid and the route itself are unchanged: any
+ * change to the table other than adding or removing a cloned route bumps
+ * fib6_gen, and a clone that is removed from the tree is recognised by
+ * its cleared rt6i_node.
+ */
+#define RT6_POL_CACHE_SIZE	16
+
+struct rt6_pol_cache_entry {
+	struct fib6_table	*table;
+	struct in6_addr		daddr;
+	struct in6_addr		saddr;
+	int			oif;
+	int			flags;
+	int			fib6_gen;
+	int			rt_genid;
+	struct rt6_info		*rt;
+};
+
+struct rt6_pol_cache {
+	struct rt6_pol_cache_entry	entries[RT6_POL_CACHE_SIZE];
+};
+
+/* Called with rcu_read_lock_bh(), the cache goes away with the
+ * namespace's devices.
+ */
+static struct rt6_pol_cache_entry *
+rt6_pol_cache_entry(struct net *net, const struct fib6_table *table,
+		    const struct flowi6 *fl6, int oif)
+{
+	struct rt6_pol_cache __percpu *pcache;
+	u32 hash;
+
+	pcache = ACCESS_ONCE(net->ipv6.rt6_pol_cache);
+	if (!pcache)
+		return NULL;
+
+	hash = jhash_3words((__force u32)fl6->daddr.s6_addr32[3],
+			    (__force u32)fl6->saddr.s6_addr32[3],
+			    oif ^ table->tb6_id, 0);
+	return &this_cpu_ptr(pcache)->entries[hash & (RT6_POL_CACHE_SIZE - 1)];
+}
+
+static bool rt6_pol_cache_match(struct net *net,
+				const struct rt6_pol_cache_entry *e,
+				const struct fib6_table *table,
+				const struct flowi6 *fl6, int oif, int flags)
+{
+	return e->rt && e->table == table && e->oif == oif &&
+	       e->flags == flags &&
+	       ipv6_addr_equal(&e->daddr, &fl6->daddr) &&
+	       ipv6_addr_equal(&e->saddr, &fl6->saddr) &&
+	       e->fib6_gen == atomic_read(&net->ipv6.fib6_gen) &&
+	       e->rt_genid == rt_genid_ipv6(net) &&
+	       e->rt->rt6i_node && !rt6_check_expired(e->rt);
+}
+
+static struct rt6_info *ip6_pol_route(struct net *net, struct fib6_table *table, int oif,
+				      struct flowi6 *fl6, int flags)
+{
+	int reachable = net->ipv6.devconf_all->forwarding ? 0 : RT6_LOOKUP_F_REACHABLE;
+	struct rt6_pol_cache_entry *e;
+	struct rt6_info *rt, *old;
+	int fib6_gen, rt_genid;
+
+	if (!net->ipv6.sysctl.ip6_rt_pol_cache)
+		return __ip6_pol_route(net, table, oif, fl6, flags, reachable);
+
+	flags = (flags & RT6_LOOKUP_F_IFACE) | reachable;
+
+	rcu_read_lock_bh();
+	e = rt6_pol_cache_entry(net, table, fl6, oif);
+	if (e && rt6_pol_cache_match(net, e, table, fl6, oif, flags)) {
+		rt = e->rt;
+		dst_hold(&rt->dst);
+		rcu_read_unlock_bh();
+
+		rt->dst.lastuse = jiffies;
+		rt->dst.__use++;
+		return rt;
+	}
+	rcu_read_unlock_bh();
+
+	/* Sample the generations first, a change racing with the lookup
+	 * then leaves an entry that never matches.
+	 */
+	fib6_gen = atomic_read(&net->ipv6.fib6_gen);
+	rt_genid = rt_genid_ipv6(net);
+	smp_rmb();
+
+	rt = __ip6_pol_route(net, table, oif, fl6, flags, reachable);
+	if (rt == net->ipv6.ip6_null_entry)
+		return rt;
+
+	rcu_read_lock_bh();
+	e = rt6_pol_cache_entry(net, table, fl6, oif);
+	if (!e) {
+		rcu_read_unlock_bh();
+		return rt;
+	}
+	old = e->rt;
+	e->table = table;
+	e->daddr = fl6->daddr;
+	e->saddr = fl6->saddr;
+	e->oif = oif;
+	e->flags = flags;
+	e->fib6_gen = fib6_gen;
+	e->rt_genid = rt_genid;
+	dst_hold(&rt->dst);
+	e->rt = rt;
+	rcu_read_unlock_bh();
+
+	ip6_rt_put(old);
+	return rt;
+}
+
 static struct rt6_info *ip6_pol_route_input(struct net *net, struct fib6_table *table,
 					    struct flowi6 *fl6, int flags)
 {
@@ -2966,6 +3087,13 @@ struct ctl_table ipv6_route_table_template[] = {
 		.mode		=	0644,
 		.proc_handler	=	proc_dointvec_ms_jiffies,
 	},
+	{
+		.procname	=	"lookup_cache",
+		.data		=	&init_net.ipv6.sysctl.ip6_rt_pol_cache,
+		.maxlen		=	sizeof(int),
+		.mode		=	0644,
+		.proc_handler	=	proc_dointvec,
+	},
 	{ }
 };
 
@@ -2989,6 +3117,7 @@ struct ctl_table * __net_init ipv6_route_sysctl_init(struct net *net)
 		table[7].data = &net->ipv6.sysctl.ip6_rt_mtu_expires;
 		table[8].data = &net->ipv6.sysctl.ip6_rt_min_advmss;
 		table[9].data = &net->ipv6.sysctl.ip6_rt_gc_min_interval;
+		table[10].data = &net->ipv6.sysctl.ip6_rt_pol_cache;
 
 		/* Don't export sysctls to unprivileged users */
 		if (net->user_ns != &init_user_ns)
@@ -3128,6 +3257,50 @@ static struct pernet_operations ipv6_inetpeer_ops = {
 	.exit	=	ipv6_inetpeer_exit,
 };
 
+static int __net_init ip6_route_pcache_init(struct net *net)
+{
+	net->ipv6.rt6_pol_cache = alloc_percpu(struct rt6_pol_cache);
+	if (!net->ipv6.rt6_pol_cache)
+		return -ENOMEM;
+	return 0;
+}
+
+static void __net_exit
+ip6_route_pcache_free(struct rt6_pol_cache __percpu *pcache)
+{
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		struct rt6_pol_cache *cache = per_cpu_ptr(pcache, cpu);
+
+		for (i = 0; i < RT6_POL_CACHE_SIZE; i++)
+			ip6_rt_put(cache->entries[i].rt);
+	}
+	free_percpu(pcache);
+}
+
+/* Runs before the namespace's devices are unregistered, which would
+ * otherwise wait forever for the references the cache holds.
+ */
+static void __net_exit ip6_route_pcache_exit_batch(struct list_head *net_list)
+{
+	struct net *net;
+
+	list_for_each_entry(net, net_list, exit_list) {
+		net->ipv6.rt6_pol_cache_stash = net->ipv6.rt6_pol_cache;
+		net->ipv6.rt6_pol_cache = NULL;
+	}
+	synchronize_rcu_bh();
+
+	list_for_each_entry(net, net_list, exit_list)
+		ip6_route_pcache_free(net->ipv6.rt6_pol_cache_stash);
+}
+
+static struct pernet_operations ip6_route_pcache_ops = {
+	.init = ip6_route_pcache_init,
+	.exit_batch = ip6_route_pcache_exit_batch,
+};
+
 static struct pernet_operations ip6_route_net_late_ops = {
 	.init = ip6_route_net_init_late,
 	.exit = ip6_route_net_exit_late,
@@ -3161,6 +3334,10 @@ int __init ip6_route_init(void)
 	if (ret)
 		goto out_register_inetpeer;
 
+	ret = register_pernet_device(&ip6_route_pcache_ops);
+	if (ret)
+		goto out_register_subsys;
+
 	ip6_dst_blackhole_ops.kmem_cachep = ip6_dst_ops_template.kmem_cachep;
 
 	/* Registering of the loopback is done before this portion of code,
@@ -3176,7 +3353,7 @@ int __init ip6_route_init(void)
   #endif
 	ret = fib6_init();
 	if (ret)
-		goto out_register_subsys;
+		goto out_register_pcache;
 
 	ret = xfrm6_init();
 	if (ret)
@@ -3211,6 +3388,8 @@ xfrm6_init:
 	xfrm6_fini();
 out_fib6_init:
 	fib6_gc_cleanup();
+out_register_pcache:
+	unregister_pernet_device(&ip6_route_pcache_ops);
 out_register_subsys:
 	unregister_pernet_subsys(&ip6_route_net_ops);
 out_register_inetpeer:
@@ -3229,6 +3408,7 @@ void ip6_route_cleanup(void)
 	fib6_rules_cleanup();
 	xfrm6_fini();
 	fib6_gc_cleanup();
+	unregister_pernet_device(&ip6_route_pcache_ops);
 	unregister_pernet_subsys(&ipv6_inetpeer_ops);
 	unregister_pernet_subsys(&ip6_route_net_ops);
 	dst_entries_destroy(&ip6_dst_blackhole_ops);
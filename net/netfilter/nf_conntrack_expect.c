@@ -180,6 +180,26 @@ nf_ct_find_expectation(struct net *net, u16 zone,
 	return NULL;
 }
 
+/* Lockless check whether nf_ct_find_expectation() may find something
+ * for @tuple, so that new connections only serialize on
+ * nf_conntrack_expect_lock when they are actually expected.  A false
+ * positive merely costs taking the lock.
+ */
+bool nf_ct_expect_pending(struct net *net, u16 zone,
+			  const struct nf_conntrack_tuple *tuple)
+{
+	bool found;
+
+	if (!net->ct.expect_count)
+		return false;
+
+	rcu_read_lock();
+	found = __nf_ct_expect_find(net, zone, tuple) != NULL;
+	rcu_read_unlock();
+
+	return found;
+}
+
 /* delete all expectations for this conntrack */
 void nf_ct_remove_expectations(struct nf_conn *ct)
 {
@@ -1329,7 +1329,7 @@ ctnetlink_change_status(struct nf_conn *ct, const struct nlattr * const cda[])
 	/* Be careful here, modifying NAT bits can screw up things,
 	 * so don't let users modify them directly if they don't pass
 	 * nf_nat_range. */
-	ct->status |= status & ~(IPS_NAT_DONE_MASK | IPS_NAT_MASK);
+	ct->status |= status & ~(IPS_NAT_DONE_MASK | IPS_NAT_MASK | IPS_OFFLOAD);
 	return 0;
 }
 
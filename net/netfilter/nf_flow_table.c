@@ -0,0 +1,340 @@
+/*
+ * Flow table for offloaded conntrack entries.
+ *
+ * Established connections may be moved into this table, after which their
+ * packets are forwarded straight from the ingress hook of the flow table
+ * user, see ipt_FLOWOFFLOAD.  The conntrack entry stays in place and is
+ * kept alive as long as the flow sees traffic; when the flow goes idle,
+ * its route goes stale or one of its devices goes down, the entry is
+ * removed and the connection continues in the slow path.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/jhash.h>
+#include <linux/random.h>
+#include <linux/netdevice.h>
+#include <linux/workqueue.h>
+#include <net/netfilter/nf_conntrack.h>
+#include <net/netfilter/nf_conntrack_core.h>
+#include <net/netfilter/nf_conntrack_tuple.h>
+#include <net/netfilter/nf_flow_table.h>
+
+static unsigned int nf_flow_hsize __read_mostly = 16384;
+module_param_named(hashsize, nf_flow_hsize, uint, 0400);
+MODULE_PARM_DESC(hashsize, "number of flow table hash buckets");
+
+static unsigned int nf_flow_max __read_mostly = 65536;
+module_param_named(max, nf_flow_max, uint, 0400);
+MODULE_PARM_DESC(max, "maximum number of offloaded flows");
+
+static struct hlist_head *nf_flow_hash __read_mostly;
+static u32 nf_flow_hash_rnd __read_mostly;
+static unsigned int nf_flow_count;
+static DEFINE_SPINLOCK(nf_flow_lock);
+
+static void nf_flow_offload_gc(struct work_struct *work);
+static DECLARE_DELAYED_WORK(nf_flow_gc_work, nf_flow_offload_gc);
+
+static void
+flow_offload_fill_dir(struct flow_offload *flow, struct nf_conn *ct,
+		      struct nf_flow_route *route,
+		      enum ip_conntrack_dir dir)
+{
+	struct flow_offload_tuple *ft = &flow->tuplehash[dir].tuple;
+	struct nf_conntrack_tuple *ctt = &ct->tuplehash[dir].tuple;
+	struct dst_entry *dst = route->tuple[dir].dst;
+
+	ft->dir = dir;
+
+	ft->src_v4 = ctt->src.u3.ip;
+	ft->dst_v4 = ctt->dst.u3.ip;
+	ft->l3proto = ctt->src.l3num;
+	ft->l4proto = ctt->dst.protonum;
+	ft->src_port = ctt->src.u.tcp.port;
+	ft->dst_port = ctt->dst.u.tcp.port;
+
+	/* packets of this direction come in where the other one goes out */
+	ft->iifidx = route->tuple[!dir].dst->dev->ifindex;
+	ft->mtu = dst_mtu(dst);
+	ft->dst_cache = dst;
+}
+
+/* Takes over the references to the routes in @route and to @ct. */
+struct flow_offload *
+flow_offload_alloc(struct nf_conn *ct, struct nf_flow_route *route)
+{
+	struct flow_offload *flow;
+	long ct_timeout;
+
+	flow = kzalloc(sizeof(*flow), GFP_ATOMIC);
+	if (!flow)
+		return NULL;
+
+	flow->ct = ct;
+
+	flow_offload_fill_dir(flow, ct, route, IP_CT_DIR_ORIGINAL);
+	flow_offload_fill_dir(flow, ct, route, IP_CT_DIR_REPLY);
+
+	if (ct->status & IPS_SRC_NAT)
+		__set_bit(FLOW_OFFLOAD_SNAT_BIT, &flow->flags);
+	if (ct->status & IPS_DST_NAT)
+		__set_bit(FLOW_OFFLOAD_DNAT_BIT, &flow->flags);
+
+	/* The packet in flight has just refreshed the conntrack timer, so
+	 * what is left of it is the timeout the protocol tracker wants for
+	 * this connection.  It is replayed from the last packet seen while
+	 * the flow is offloaded.
+	 */
+	ct_timeout = (long)(ct->timeout.expires - jiffies);
+	flow->ct_timeout = max_t(long, ct_timeout, NF_FLOW_TIMEOUT);
+	flow->timeout = (u32)jiffies + NF_FLOW_TIMEOUT;
+
+	return flow;
+}
+EXPORT_SYMBOL_GPL(flow_offload_alloc);
+
+static void __flow_offload_free(struct flow_offload *flow)
+{
+	dst_release(flow->tuplehash[IP_CT_DIR_ORIGINAL].tuple.dst_cache);
+	dst_release(flow->tuplehash[IP_CT_DIR_REPLY].tuple.dst_cache);
+	nf_ct_put(flow->ct);
+	kfree(flow);
+}
+
+/* For entries that never made it into the table. */
+void flow_offload_free(struct flow_offload *flow)
+{
+	clear_bit(IPS_OFFLOAD_BIT, &flow->ct->status);
+	__flow_offload_free(flow);
+}
+EXPORT_SYMBOL_GPL(flow_offload_free);
+
+static void flow_offload_free_rcu(struct rcu_head *head)
+{
+	__flow_offload_free(container_of(head, struct flow_offload, rcu_head));
+}
+
+static u32 flow_offload_hash(const struct flow_offload_tuple *tuple)
+{
+	u32 hash = jhash(tuple, FLOW_OFFLOAD_TUPLE_KEYLEN, nf_flow_hash_rnd);
+
+	return ((u64)hash * nf_flow_hsize) >> 32;
+}
+
+int flow_offload_add(struct flow_offload *flow)
+{
+	struct flow_offload_tuple_hash *th;
+	int dir;
+
+	spin_lock_bh(&nf_flow_lock);
+	if (nf_flow_count >= nf_flow_max) {
+		spin_unlock_bh(&nf_flow_lock);
+		return -ENOSPC;
+	}
+
+	for (dir = 0; dir < IP_CT_DIR_MAX; dir++) {
+		th = &flow->tuplehash[dir];
+		hlist_add_head_rcu(&th->node,
+				   &nf_flow_hash[flow_offload_hash(&th->tuple)]);
+	}
+	nf_flow_count++;
+	spin_unlock_bh(&nf_flow_lock);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(flow_offload_add);
+
+/* Called under rcu_read_lock(). */
+struct flow_offload_tuple_hash *
+flow_offload_lookup(struct net *net, const struct flow_offload_tuple *tuple)
+{
+	struct flow_offload_tuple_hash *th;
+	struct flow_offload *flow;
+
+	hlist_for_each_entry_rcu(th, &nf_flow_hash[flow_offload_hash(tuple)],
+				 node) {
+		if (memcmp(&th->tuple, tuple, FLOW_OFFLOAD_TUPLE_KEYLEN))
+			continue;
+
+		flow = flow_offload_from_tuple(th);
+		if (!net_eq(nf_ct_net(flow->ct), net))
+			continue;
+		if (test_bit(FLOW_OFFLOAD_TEARDOWN_BIT, &flow->flags))
+			return NULL;
+		return th;
+	}
+	return NULL;
+}
+EXPORT_SYMBOL_GPL(flow_offload_lookup);
+
+static bool flow_offload_expired(const struct flow_offload *flow)
+{
+	return (s32)(flow->timeout - (u32)jiffies) <= 0;
+}
+
+/* Conntrack has not seen the packets forwarded behind its back: push its
+ * timer out as if it had seen the last one.
+ */
+static void flow_offload_ct_refresh(struct flow_offload *flow)
+{
+	struct nf_conn *ct = flow->ct;
+	unsigned long expires;
+	u32 idle;
+
+	if (test_bit(IPS_FIXED_TIMEOUT_BIT, &ct->status))
+		return;
+
+	idle = (u32)jiffies - (flow->timeout - NF_FLOW_TIMEOUT);
+	expires = jiffies - idle + flow->ct_timeout;
+	if ((long)(expires - ct->timeout.expires) >= HZ)
+		mod_timer_pending(&ct->timeout, expires);
+}
+
+static void flow_offload_fixup_ct(struct nf_conn *ct)
+{
+	if (nf_ct_protonum(ct) != IPPROTO_TCP)
+		return;
+
+	/* Sequence numbers have moved on, let the tracker pick up the
+	 * windows from the next packets instead of dropping them as
+	 * out of window.
+	 */
+	spin_lock_bh(&ct->lock);
+	ct->proto.tcp.seen[0].td_maxwin = 0;
+	ct->proto.tcp.seen[1].td_maxwin = 0;
+	spin_unlock_bh(&ct->lock);
+}
+
+/* Called with nf_flow_lock held. */
+static void flow_offload_del(struct flow_offload *flow)
+{
+	hlist_del_rcu(&flow->tuplehash[IP_CT_DIR_ORIGINAL].node);
+	hlist_del_rcu(&flow->tuplehash[IP_CT_DIR_REPLY].node);
+	nf_flow_count--;
+
+	flow_offload_ct_refresh(flow);
+	flow_offload_fixup_ct(flow->ct);
+	clear_bit(IPS_OFFLOAD_BIT, &flow->ct->status);
+
+	call_rcu(&flow->rcu_head, flow_offload_free_rcu);
+}
+
+static bool flow_offload_gc_one(struct flow_offload *flow, void *data)
+{
+	if (flow_offload_expired(flow) ||
+	    nf_ct_is_dying(flow->ct) ||
+	    test_bit(FLOW_OFFLOAD_TEARDOWN_BIT, &flow->flags))
+		return true;
+
+	flow_offload_ct_refresh(flow);
+	return false;
+}
+
+/* Removes every flow @fn returns true for. */
+static void nf_flow_table_iterate(bool (*fn)(struct flow_offload *, void *),
+				  void *data)
+{
+	struct flow_offload_tuple_hash *th;
+	struct hlist_node *n;
+	struct flow_offload *flow;
+	unsigned int i;
+
+	for (i = 0; i < nf_flow_hsize; i++) {
+		spin_lock_bh(&nf_flow_lock);
+		hlist_for_each_entry_safe(th, n, &nf_flow_hash[i], node) {
+			/* every flow is in the table twice */
+			if (th->tuple.dir != IP_CT_DIR_ORIGINAL)
+				continue;
+
+			flow = flow_offload_from_tuple(th);
+			if (fn(flow, data))
+				flow_offload_del(flow);
+		}
+		spin_unlock_bh(&nf_flow_lock);
+	}
+}
+
+static void nf_flow_offload_gc(struct work_struct *work)
+{
+	nf_flow_table_iterate(flow_offload_gc_one, NULL);
+	schedule_delayed_work(&nf_flow_gc_work, HZ);
+}
+
+static bool flow_offload_uses_dev(struct flow_offload *flow, void *data)
+{
+	struct net_device *dev = data;
+	int dir;
+
+	if (!net_eq(nf_ct_net(flow->ct), dev_net(dev)))
+		return false;
+
+	for (dir = 0; dir < IP_CT_DIR_MAX; dir++) {
+		if (flow->tuplehash[dir].tuple.iifidx == dev->ifindex ||
+		    flow->tuplehash[dir].tuple.dst_cache->dev == dev)
+			return true;
+	}
+	return false;
+}
+
+static bool flow_offload_any(struct flow_offload *flow, void *data)
+{
+	return true;
+}
+
+static int nf_flow_table_netdev_event(struct notifier_block *this,
+				      unsigned long event, void *ptr)
+{
+	struct net_device *dev = netdev_notifier_info_to_dev(ptr);
+
+	if (event == NETDEV_DOWN)
+		nf_flow_table_iterate(flow_offload_uses_dev, dev);
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block nf_flow_table_netdev_notifier = {
+	.notifier_call	= nf_flow_table_netdev_event,
+};
+
+static int __init nf_flow_table_init(void)
+{
+	int err;
+
+	if (!nf_flow_hsize)
+		return -EINVAL;
+
+	nf_flow_hash = nf_ct_alloc_hashtable(&nf_flow_hsize, 0);
+	if (!nf_flow_hash)
+		return -ENOMEM;
+	get_random_bytes(&nf_flow_hash_rnd, sizeof(nf_flow_hash_rnd));
+
+	err = register_netdevice_notifier(&nf_flow_table_netdev_notifier);
+	if (err < 0) {
+		nf_ct_free_hashtable(nf_flow_hash, nf_flow_hsize);
+		return err;
+	}
+
+	schedule_delayed_work(&nf_flow_gc_work, HZ);
+	return 0;
+}
+
+static void __exit nf_flow_table_fini(void)
+{
+	unregister_netdevice_notifier(&nf_flow_table_netdev_notifier);
+	cancel_delayed_work_sync(&nf_flow_gc_work);
+	nf_flow_table_iterate(flow_offload_any, NULL);
+	rcu_barrier();
+	nf_ct_free_hashtable(nf_flow_hash, nf_flow_hsize);
+}
+
+module_init(nf_flow_table_init);
+module_exit(nf_flow_table_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Netfilter flow table for offloaded connections");
@@ -824,18 +824,22 @@ static int __net_init nf_nat_net_init(struct net *net)
 	return 0;
 }
 
-static void __net_exit nf_nat_net_exit(struct net *net)
+static void __net_exit nf_nat_net_exit_batch(struct list_head *net_exit_list)
 {
 	struct nf_nat_proto_clean clean = {};
+	struct net *net;
 
-	nf_ct_iterate_cleanup(net, nf_nat_proto_clean, &clean, 0, 0);
+	list_for_each_entry(net, net_exit_list, exit_list)
+		nf_ct_iterate_cleanup(net, nf_nat_proto_clean, &clean, 0, 0);
 	synchronize_rcu();
-	nf_ct_free_hashtable(net->ct.nat_bysource, net->ct.nat_htable_size);
+	list_for_each_entry(net, net_exit_list, exit_list)
+		nf_ct_free_hashtable(net->ct.nat_bysource,
+				     net->ct.nat_htable_size);
 }
 
 static struct pernet_operations nf_nat_net_ops = {
 	.init = nf_nat_net_init,
-	.exit = nf_nat_net_exit,
+	.exit_batch = nf_nat_net_exit_batch,
 };
 
 static struct nf_ct_helper_expectfn follow_master_nat = {
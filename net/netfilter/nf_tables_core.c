@@ -60,6 +60,38 @@ static bool nft_payload_fast_eval(const struct nft_expr *expr,
 	return true;
 }
 
+/* Rules mostly consist of the expressions built into nf_tables, so instead
+ * of an indirect call per expression, which the CPU has a hard time
+ * predicting across a large ruleset, compare the ops against those and
+ * call them directly.
+ */
+static void nft_expr_eval(const struct nft_expr *expr,
+			  struct nft_data data[NFT_REG_MAX + 1],
+			  const struct nft_pktinfo *pkt)
+{
+	const struct nft_expr_ops *ops = expr->ops;
+
+	if (ops == &nft_cmp_fast_ops)
+		nft_cmp_fast_eval(expr, data);
+	else if (ops == &nft_payload_fast_ops) {
+		if (!nft_payload_fast_eval(expr, data, pkt))
+			nft_payload_eval(expr, data, pkt);
+	} else if (ops->eval == nft_immediate_eval)
+		nft_immediate_eval(expr, data, pkt);
+	else if (ops->eval == nft_cmp_eval)
+		nft_cmp_eval(expr, data, pkt);
+	else if (ops->eval == nft_lookup_eval)
+		nft_lookup_eval(expr, data, pkt);
+	else if (ops->eval == nft_payload_eval)
+		nft_payload_eval(expr, data, pkt);
+	else if (ops->eval == nft_bitwise_eval)
+		nft_bitwise_eval(expr, data, pkt);
+	else if (ops->eval == nft_byteorder_eval)
+		nft_byteorder_eval(expr, data, pkt);
+	else
+		ops->eval(expr, data, pkt);
+}
+
 struct nft_jumpstack {
 	const struct nft_chain	*chain;
 	const struct nft_rule	*rule;
@@ -131,11 +163,7 @@ next_rule:
 		rulenum++;
 
 		nft_rule_for_each_expr(expr, last, rule) {
-			if (expr->ops == &nft_cmp_fast_ops)
-				nft_cmp_fast_eval(expr, data);
-			else if (expr->ops != &nft_payload_fast_ops ||
-				 !nft_payload_fast_eval(expr, data, pkt))
-				expr->ops->eval(expr, data, pkt);
+			nft_expr_eval(expr, data, pkt);
 
 			if (data[NFT_REG_VERDICT].verdict != NFT_CONTINUE)
 				break;
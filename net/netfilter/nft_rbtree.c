@@ -13,6 +13,9 @@
 #include <linux/module.h>
 #include <linux/list.h>
 #include <linux/rbtree.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 #include <linux/netlink.h>
 #include <linux/netfilter.h>
 #include <linux/netfilter/nf_tables.h>
@@ -20,27 +23,93 @@
 
 static DEFINE_SPINLOCK(nft_rbtree_lock);
 
+/* Packet path lookups don't walk the tree.  After each change a work item
+ * lays the keys out as a flat array in Eytzinger (breadth first) order,
+ * which is published through RCU and searched without taking any lock:
+ * the top levels of the implicit tree share a few cache lines and the
+ * children of a node are next to each other, so they can be prefetched
+ * ahead.  Until the array has been rebuilt lookups fall back to the tree.
+ */
+struct nft_rbtree_array {
+	struct rcu_head			rcu_head;
+	unsigned int			num;
+	/* both indexed from 1, in Eytzinger order */
+	const struct nft_rbtree_elem	**elems;
+	u8				*keys;
+};
+
 struct nft_rbtree {
-	struct rb_root		root;
+	struct rb_root			root;
+	unsigned int			count;
+	bool				dirty;
+	struct nft_rbtree_array __rcu	*array;
+	const struct nft_set		*set;
+	struct work_struct		rebuild;
 };
 
 struct nft_rbtree_elem {
 	struct rb_node		node;
+	struct rcu_head		rcu_head;
 	u16			flags;
 	struct nft_data		key;
 	struct nft_data		data[];
 };
 
+static bool nft_rbtree_match(const struct nft_set *set,
+			     const struct nft_rbtree_elem *rbe,
+			     struct nft_data *data)
+{
+	if (rbe->flags & NFT_SET_ELEM_INTERVAL_END)
+		return false;
+	if (set->flags & NFT_SET_MAP)
+		nft_data_copy(data, rbe->data);
+	return true;
+}
+
+static bool nft_rbtree_array_lookup(const struct nft_set *set,
+				    const struct nft_rbtree_array *array,
+				    const struct nft_data *key,
+				    struct nft_data *data)
+{
+	unsigned int klen = set->klen, i = 1;
+
+	/* find the greatest key not above the one looked up */
+	while (i <= array->num) {
+		prefetch(array->keys + 16 * i * klen);
+		i = 2 * i + (memcmp(array->keys + i * klen, key, klen) <= 0);
+	}
+	/* back up to where the search last went right */
+	i >>= __ffs(i) + 1;
+	if (i == 0)
+		return false;
+
+	if (!(set->flags & NFT_SET_INTERVAL) &&
+	    memcmp(array->keys + i * klen, key, klen))
+		return false;
+
+	return nft_rbtree_match(set, array->elems[i], data);
+}
+
 static bool nft_rbtree_lookup(const struct nft_set *set,
 			      const struct nft_data *key,
 			      struct nft_data *data)
 {
 	const struct nft_rbtree *priv = nft_set_priv(set);
 	const struct nft_rbtree_elem *rbe, *interval = NULL;
-	const struct rb_node *parent = priv->root.rb_node;
+	const struct rb_node *parent;
+	const struct nft_rbtree_array *array;
+	bool dirty, match;
 	int d;
 
+	dirty = ACCESS_ONCE(priv->dirty);
+	/* pairs with the barriers in nft_rbtree_rebuild() */
+	smp_rmb();
+	array = rcu_dereference(priv->array);
+	if (likely(!dirty && array != NULL))
+		return nft_rbtree_array_lookup(set, array, key, data);
+
 	spin_lock_bh(&nft_rbtree_lock);
+	parent = priv->root.rb_node;
 	while (parent != NULL) {
 		rbe = rb_entry(parent, struct nft_rbtree_elem, node);
 
@@ -52,13 +121,9 @@ static bool nft_rbtree_lookup(const struct nft_set *set,
 			parent = parent->rb_right;
 		else {
 found:
-			if (rbe->flags & NFT_SET_ELEM_INTERVAL_END)
-				goto out;
-			if (set->flags & NFT_SET_MAP)
-				nft_data_copy(data, rbe->data);
-
+			match = nft_rbtree_match(set, rbe, data);
 			spin_unlock_bh(&nft_rbtree_lock);
-			return true;
+			return match;
 		}
 	}
 
@@ -66,11 +131,109 @@ found:
 		rbe = interval;
 		goto found;
 	}
-out:
 	spin_unlock_bh(&nft_rbtree_lock);
 	return false;
 }
 
+static void nft_rbtree_array_free(struct nft_rbtree_array *array)
+{
+	if (is_vmalloc_addr(array))
+		vfree(array);
+	else
+		kfree(array);
+}
+
+static void nft_rbtree_array_free_rcu(struct rcu_head *head)
+{
+	nft_rbtree_array_free(container_of(head, struct nft_rbtree_array,
+					   rcu_head));
+}
+
+static struct nft_rbtree_array *nft_rbtree_array_alloc(unsigned int num,
+						       unsigned int klen)
+{
+	struct nft_rbtree_array *array;
+	size_t size;
+
+	size = sizeof(*array) + (num + 1) * (sizeof(array->elems[0]) + klen);
+	array = kzalloc(size, GFP_KERNEL | __GFP_NOWARN);
+	if (array == NULL)
+		array = vzalloc(size);
+	if (array == NULL)
+		return NULL;
+
+	array->elems = (const struct nft_rbtree_elem **)(array + 1);
+	array->keys = (u8 *)(array->elems + num + 1);
+	return array;
+}
+
+/* In-order walk of the implicit tree, fed with the elements in ascending
+ * key order; the tree itself is sorted in descending order.
+ */
+static void nft_rbtree_array_fill(const struct nft_set *set,
+				  struct nft_rbtree_array *array,
+				  unsigned int i, struct rb_node **node)
+{
+	const struct nft_rbtree_elem *rbe;
+
+	if (i > array->num)
+		return;
+
+	nft_rbtree_array_fill(set, array, 2 * i, node);
+
+	rbe = rb_entry(*node, struct nft_rbtree_elem, node);
+	array->elems[i] = rbe;
+	memcpy(array->keys + i * set->klen, &rbe->key, set->klen);
+	*node = rb_prev(*node);
+
+	nft_rbtree_array_fill(set, array, 2 * i + 1, node);
+}
+
+static void nft_rbtree_rebuild(struct work_struct *work)
+{
+	struct nft_rbtree *priv = container_of(work, struct nft_rbtree,
+					       rebuild);
+	const struct nft_set *set = priv->set;
+	struct nft_rbtree_array *array, *old;
+	struct rb_node *node;
+	unsigned int num;
+
+	for (;;) {
+		num = ACCESS_ONCE(priv->count);
+		array = nft_rbtree_array_alloc(num, set->klen);
+		if (array == NULL)
+			return;
+
+		spin_lock_bh(&nft_rbtree_lock);
+		if (priv->count <= num)
+			break;
+		/* grew in the meantime */
+		spin_unlock_bh(&nft_rbtree_lock);
+		nft_rbtree_array_free(array);
+	}
+
+	array->num = priv->count;
+	node = rb_last(&priv->root);
+	nft_rbtree_array_fill(set, array, 1, &node);
+
+	old = rcu_dereference_protected(priv->array,
+					lockdep_is_held(&nft_rbtree_lock));
+	rcu_assign_pointer(priv->array, array);
+	smp_wmb();
+	priv->dirty = false;
+	spin_unlock_bh(&nft_rbtree_lock);
+
+	if (old != NULL)
+		call_rcu(&old->rcu_head, nft_rbtree_array_free_rcu);
+}
+
+/* Called with nft_rbtree_lock held. */
+static void nft_rbtree_changed(struct nft_rbtree *priv)
+{
+	priv->dirty = true;
+	schedule_work(&priv->rebuild);
+}
+
 static void nft_rbtree_elem_destroy(const struct nft_set *set,
 				    struct nft_rbtree_elem *rbe)
 {
@@ -111,6 +274,7 @@ static int __nft_rbtree_insert(const struct nft_set *set,
 static int nft_rbtree_insert(const struct nft_set *set,
 			     const struct nft_set_elem *elem)
 {
+	struct nft_rbtree *priv = nft_set_priv(set);
 	struct nft_rbtree_elem *rbe;
 	unsigned int size;
 	int err;
@@ -132,9 +296,12 @@ static int nft_rbtree_insert(const struct nft_set *set,
 
 	spin_lock_bh(&nft_rbtree_lock);
 	err = __nft_rbtree_insert(set, rbe);
-	if (err < 0)
+	if (err < 0) {
 		kfree(rbe);
-
+	} else {
+		priv->count++;
+		nft_rbtree_changed(priv);
+	}
 	spin_unlock_bh(&nft_rbtree_lock);
 	return err;
 }
@@ -147,8 +314,11 @@ static void nft_rbtree_remove(const struct nft_set *set,
 
 	spin_lock_bh(&nft_rbtree_lock);
 	rb_erase(&rbe->node, &priv->root);
+	priv->count--;
+	nft_rbtree_changed(priv);
 	spin_unlock_bh(&nft_rbtree_lock);
-	kfree(rbe);
+	/* may still be referenced from the lookup array */
+	kfree_rcu(rbe, rcu_head);
 }
 
 static int nft_rbtree_get(const struct nft_set *set, struct nft_set_elem *elem)
@@ -225,15 +395,20 @@ static int nft_rbtree_init(const struct nft_set *set,
 	struct nft_rbtree *priv = nft_set_priv(set);
 
 	priv->root = RB_ROOT;
+	priv->set = set;
+	INIT_WORK(&priv->rebuild, nft_rbtree_rebuild);
 	return 0;
 }
 
 static void nft_rbtree_destroy(const struct nft_set *set)
 {
 	struct nft_rbtree *priv = nft_set_priv(set);
+	struct nft_rbtree_array *array;
 	struct nft_rbtree_elem *rbe;
 	struct rb_node *node;
 
+	cancel_work_sync(&priv->rebuild);
+
 	spin_lock_bh(&nft_rbtree_lock);
 	while ((node = priv->root.rb_node) != NULL) {
 		rb_erase(node, &priv->root);
@@ -241,6 +416,10 @@ static void nft_rbtree_destroy(const struct nft_set *set)
 		nft_rbtree_elem_destroy(set, rbe);
 	}
 	spin_unlock_bh(&nft_rbtree_lock);
+
+	array = rcu_dereference_protected(priv->array, 1);
+	if (array != NULL)
+		nft_rbtree_array_free(array);
 }
 
 static bool nft_rbtree_estimate(const struct nft_set_desc *desc, u32 features,
@@ -248,7 +427,8 @@ static bool nft_rbtree_estimate(const struct nft_set_desc *desc, u32 features,
 {
 	unsigned int nsize;
 
-	nsize = sizeof(struct nft_rbtree_elem);
+	nsize = sizeof(struct nft_rbtree_elem) +
+		sizeof(struct nft_rbtree_elem *) + desc->klen;
 	if (features & NFT_SET_MAP)
 		nsize += FIELD_SIZEOF(struct nft_rbtree_elem, data[0]);
 
@@ -170,6 +170,20 @@ void ovs_flow_stats_clear(struct sw_flow *flow)
 	}
 }
 
+/* Accounts packets switched outside of the datapath, e.g. by hardware.
+ * Called with ovs_mutex.
+ */
+void ovs_flow_stats_add(struct sw_flow *flow, u64 packets, u64 bytes)
+{
+	struct flow_stats *stats = ovsl_dereference(flow->stats[0]);
+
+	spin_lock_bh(&stats->lock);
+	stats->used = jiffies;
+	stats->packet_count += packets;
+	stats->byte_count += bytes;
+	spin_unlock_bh(&stats->lock);
+}
+
 static int check_header(struct sk_buff *skb, int len)
 {
 	if (unlikely(skb->len < len))
@@ -34,6 +34,7 @@
 #include <net/inet_ecn.h>
 
 struct sk_buff;
+struct sw_flow_hw;
 
 /* Used to memset ovs_key_ipv4_tunnel padding. */
 #define OVS_TUNNEL_KEY_SIZE					\
@@ -123,7 +124,6 @@ struct sw_flow_key_range {
 struct sw_flow_mask {
 	int ref_count;
 	struct rcu_head rcu;
-	struct list_head list;
 	struct sw_flow_key_range range;
 	struct sw_flow_key key;
 };
@@ -159,6 +159,9 @@ struct sw_flow {
 	struct sw_flow_key unmasked_key;
 	struct sw_flow_mask *mask;
 	struct sw_flow_actions __rcu *sf_acts;
+	struct sw_flow_hw *hw;		/* Hardware offload state, if any.
+					 * Protected by ovs_mutex.
+					 */
 	struct flow_stats __rcu *stats[]; /* One for each NUMA node.  First one
 					   * is allocated at flow creation time,
 					   * the rest are allocated on demand
@@ -185,6 +188,7 @@ void ovs_flow_stats_update(struct sw_flow *, __be16 tcp_flags,
 void ovs_flow_stats_get(const struct sw_flow *, struct ovs_flow_stats *,
 			unsigned long *used, __be16 *tcp_flags);
 void ovs_flow_stats_clear(struct sw_flow *);
+void ovs_flow_stats_add(struct sw_flow *, u64 packets, u64 bytes);
 u64 ovs_flow_used_time(unsigned long flow_jiffies);
 
 int ovs_flow_extract(struct sk_buff *, u16 in_port, struct sw_flow_key *);
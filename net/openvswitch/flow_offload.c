@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2014 Nicira, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/list.h>
+#include <linux/netdevice.h>
+#include <linux/openvswitch.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/workqueue.h>
+#include <net/dp_flow_offload.h>
+
+#include "datapath.h"
+#include "flow.h"
+#include "flow_offload.h"
+#include "vport-netdev.h"
+
+/* Flows whose packets enter on a netdev port and are either dropped or
+ * output to a single other netdev port can be handed to the ingress
+ * device, which switches them in hardware if it is able to.  The flow
+ * stays in the software table, so packets the hardware does not catch
+ * are still handled there, and the hardware counters are folded into
+ * the flow statistics periodically so that userspace sees the flow as
+ * used.
+ */
+
+#define OFFLOAD_STATS_INTERVAL	HZ
+
+struct sw_flow_hw {
+	struct list_head list;
+	struct sw_flow *flow;
+	struct datapath *dp;
+	struct vport *in_port;
+	struct vport *out_port;		/* NULL if the flow drops. */
+	u64 packets;			/* Hardware counters seen so far. */
+	u64 bytes;
+};
+
+/* Protected by ovs_mutex. */
+static LIST_HEAD(offloaded_flows);
+
+static void offload_stats_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(offload_stats_work, offload_stats_work_fn);
+
+static struct net_device *offload_port_dev(struct vport *vport)
+{
+	if (!vport || vport->ops->type != OVS_VPORT_TYPE_NETDEV)
+		return NULL;
+	return netdev_vport_priv(vport)->dev;
+}
+
+/* Returns true if the flow's actions are a plain drop or a single output,
+ * and sets '*out_port' to the output port or NULL.
+ */
+static bool offload_parse_actions(struct datapath *dp,
+				  const struct sw_flow_actions *acts,
+				  struct vport **out_port)
+{
+	const struct nlattr *a;
+	int rem;
+
+	*out_port = NULL;
+	nla_for_each_attr(a, acts->actions, acts->actions_len, rem) {
+		if (nla_type(a) != OVS_ACTION_ATTR_OUTPUT || *out_port)
+			return false;
+
+		*out_port = ovs_vport_ovsl(dp, nla_get_u32(a));
+		if (!offload_port_dev(*out_port))
+			return false;
+	}
+	return true;
+}
+
+/* Translates the flow's match into 'fo', returns false if it matches on
+ * anything the offload key cannot express.
+ */
+static bool offload_parse_match(const struct sw_flow *flow,
+				struct dp_flow_offload *fo)
+{
+	const struct sw_flow_key *key = &flow->key;
+	const struct sw_flow_mask *mask = flow->mask;
+	struct sw_flow_key rest = mask->key;
+	bool ipv4 = key->eth.type == htons(ETH_P_IP);
+	const u8 *start;
+
+	/* A wildcarded input port would have to be offloaded everywhere. */
+	if (mask->key.phy.in_port != 0xffff)
+		return false;
+
+	memcpy(fo->key.eth_src, key->eth.src, ETH_ALEN);
+	memcpy(fo->key.eth_dst, key->eth.dst, ETH_ALEN);
+	fo->key.vlan_tci = key->eth.tci;
+	fo->key.eth_type = key->eth.type;
+	memcpy(fo->mask.eth_src, mask->key.eth.src, ETH_ALEN);
+	memcpy(fo->mask.eth_dst, mask->key.eth.dst, ETH_ALEN);
+	fo->mask.vlan_tci = mask->key.eth.tci;
+	fo->mask.eth_type = mask->key.eth.type;
+
+	rest.phy.in_port = 0;
+	memset(&rest.eth, 0, sizeof(rest.eth));
+
+	if (ipv4 && mask->key.eth.type == htons(0xffff)) {
+		fo->key.ipv4_src = key->ipv4.addr.src;
+		fo->key.ipv4_dst = key->ipv4.addr.dst;
+		fo->key.ip_proto = key->ip.proto;
+		fo->key.tp_src = key->tp.src;
+		fo->key.tp_dst = key->tp.dst;
+		fo->mask.ipv4_src = mask->key.ipv4.addr.src;
+		fo->mask.ipv4_dst = mask->key.ipv4.addr.dst;
+		fo->mask.ip_proto = mask->key.ip.proto;
+		fo->mask.tp_src = mask->key.tp.src;
+		fo->mask.tp_dst = mask->key.tp.dst;
+
+		memset(&rest.ipv4.addr, 0, sizeof(rest.ipv4.addr));
+		rest.ip.proto = 0;
+		rest.tp.src = 0;
+		rest.tp.dst = 0;
+	}
+
+	/* Everything else, tunnel metadata, fragments, TCP flags and so on,
+	 * must be wildcarded.
+	 */
+	start = (const u8 *)&rest + mask->range.start;
+	return !memchr_inv(start, 0, mask->range.end - mask->range.start);
+}
+
+static int offload_call(struct vport *in_port, struct dp_flow_offload *fo)
+{
+	struct net_device *dev = offload_port_dev(in_port);
+
+	return dev->netdev_ops->ndo_dp_flow_offload(dev, fo);
+}
+
+static void offload_sync_stats(struct sw_flow_hw *hw)
+{
+	struct dp_flow_offload fo = {
+		.command = DP_FLOW_OFFLOAD_STATS,
+		.cookie = (unsigned long)hw->flow,
+	};
+
+	if (offload_call(hw->in_port, &fo))
+		return;
+
+	if (fo.packets > hw->packets)
+		ovs_flow_stats_add(hw->flow, fo.packets - hw->packets,
+				   fo.bytes - hw->bytes);
+	hw->packets = fo.packets;
+	hw->bytes = fo.bytes;
+}
+
+void ovs_flow_offload_del(struct sw_flow *flow)
+{
+	struct sw_flow_hw *hw = flow->hw;
+	struct dp_flow_offload fo = {
+		.command = DP_FLOW_OFFLOAD_DEL,
+	};
+
+	ASSERT_OVSL();
+
+	if (!hw)
+		return;
+
+	offload_sync_stats(hw);
+
+	fo.cookie = (unsigned long)flow;
+	offload_call(hw->in_port, &fo);
+
+	list_del(&hw->list);
+	flow->hw = NULL;
+	kfree(hw);
+}
+
+/* Offers 'flow' to the hardware, replacing what was offloaded for it
+ * before if its actions changed.  Failing is not an error, the flow is
+ * simply kept in software.
+ */
+void ovs_flow_offload_add(struct datapath *dp, struct sw_flow *flow)
+{
+	struct dp_flow_offload fo = {
+		.command = DP_FLOW_OFFLOAD_ADD,
+		.cookie = (unsigned long)flow,
+	};
+	struct vport *in_port, *out_port;
+	struct net_device *dev;
+	struct sw_flow_hw *hw;
+
+	ASSERT_OVSL();
+
+	ovs_flow_offload_del(flow);
+
+	in_port = ovs_vport_ovsl(dp, flow->key.phy.in_port);
+	dev = offload_port_dev(in_port);
+	if (!dev || !dp_flow_offload_supported(dev))
+		return;
+
+	if (!offload_parse_actions(dp, ovsl_dereference(flow->sf_acts),
+				   &out_port) || out_port == in_port)
+		return;
+	if (!offload_parse_match(flow, &fo))
+		return;
+	fo.out_dev = offload_port_dev(out_port);
+
+	hw = kzalloc(sizeof(*hw), GFP_KERNEL);
+	if (!hw)
+		return;
+
+	if (dev->netdev_ops->ndo_dp_flow_offload(dev, &fo)) {
+		kfree(hw);
+		return;
+	}
+
+	hw->flow = flow;
+	hw->dp = dp;
+	hw->in_port = in_port;
+	hw->out_port = out_port;
+	flow->hw = hw;
+
+	if (list_empty(&offloaded_flows))
+		schedule_delayed_work(&offload_stats_work,
+				      OFFLOAD_STATS_INTERVAL);
+	list_add_tail(&hw->list, &offloaded_flows);
+}
+
+void ovs_flow_offload_flush(struct datapath *dp)
+{
+	struct sw_flow_hw *hw, *n;
+
+	ASSERT_OVSL();
+
+	list_for_each_entry_safe(hw, n, &offloaded_flows, list)
+		if (hw->dp == dp)
+			ovs_flow_offload_del(hw->flow);
+}
+
+/* Called before 'vport' goes away; flows using it are left to software. */
+void ovs_flow_offload_port_del(struct vport *vport)
+{
+	struct sw_flow_hw *hw, *n;
+
+	ASSERT_OVSL();
+
+	list_for_each_entry_safe(hw, n, &offloaded_flows, list)
+		if (hw->in_port == vport || hw->out_port == vport)
+			ovs_flow_offload_del(hw->flow);
+}
+
+static void offload_stats_work_fn(struct work_struct *work)
+{
+	struct sw_flow_hw *hw;
+
+	ovs_lock();
+	list_for_each_entry(hw, &offloaded_flows, list)
+		offload_sync_stats(hw);
+
+	if (!list_empty(&offloaded_flows))
+		schedule_delayed_work(&offload_stats_work,
+				      OFFLOAD_STATS_INTERVAL);
+	ovs_unlock();
+}
+
+/* All datapaths are gone by now, so the work does not requeue itself. */
+void ovs_flow_offload_exit(void)
+{
+	cancel_delayed_work_sync(&offload_stats_work);
+}
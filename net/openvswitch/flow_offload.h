@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2014 Nicira, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+#ifndef FLOW_OFFLOAD_H
+#define FLOW_OFFLOAD_H 1
+
+struct datapath;
+struct sw_flow;
+struct vport;
+
+/* All called with ovs_mutex. */
+void ovs_flow_offload_add(struct datapath *, struct sw_flow *);
+void ovs_flow_offload_del(struct sw_flow *);
+void ovs_flow_offload_flush(struct datapath *);
+void ovs_flow_offload_port_del(struct vport *);
+
+void ovs_flow_offload_exit(void);
+
+#endif /* flow_offload.h */
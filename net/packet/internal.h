@@ -81,6 +81,7 @@ struct packet_fanout {
 	u8			type;
 	u8			flags;
 	atomic_t		rr_cur;
+	struct sk_filter __rcu	*bpf_prog;
 	struct list_head	list;
 	struct sock		*arr[PACKET_FANOUT_MAX];
 	int			next[PACKET_FANOUT_MAX];
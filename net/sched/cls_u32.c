@@ -52,6 +52,7 @@ struct tc_u_knode {
 	int			ifindex;
 #endif
 	u8			fshift;
+	u32			flags;
 	struct tcf_result	res;
 	struct tc_u_hnode	*ht_down;
 #ifdef CONFIG_CLS_U32_PERF
@@ -70,6 +71,7 @@ struct tc_u_hnode {
 	struct tc_u_common	*tp_c;
 	int			refcnt;
 	unsigned int		divisor;
+	u32			flags;
 	struct tc_u_knode	*ht[1];
 };
 
@@ -114,6 +116,12 @@ next_knode:
 	if (n) {
 		struct tc_u32_key *key = n->sel.keys;
 
+		/* matched by the hardware only */
+		if (tc_skip_sw(n->flags)) {
+			n = n->next;
+			goto next_knode;
+		}
+
 #ifdef CONFIG_CLS_U32_PERF
 		n->pf->rcnt += 1;
 		j = 0;
@@ -299,6 +307,96 @@ static u32 gen_new_htid(struct tc_u_common *tp_c)
 	return i > 0 ? (tp_c->hgenerator|0x800)<<20 : 0;
 }
 
+static void u32_remove_hw_knode(struct tcf_proto *tp, u32 handle, u32 flags)
+{
+	struct net_device *dev = qdisc_dev(tp->q);
+	struct tc_cls_u32_offload u32_offload = {0};
+	struct tc_to_netdev offload;
+
+	if (!tc_should_offload(dev, flags))
+		return;
+
+	offload.type = TC_SETUP_CLSU32;
+	offload.cls_u32 = &u32_offload;
+	u32_offload.command = TC_CLSU32_DELETE_KNODE;
+	u32_offload.knode.handle = handle;
+
+	dev->netdev_ops->ndo_setup_tc_offload(dev, tp->q->handle,
+					      tp->protocol, &offload);
+}
+
+/* Errors only matter when there is no software fallback for the node. */
+static int u32_replace_hw_knode(struct tcf_proto *tp, struct tc_u_knode *n,
+				u32 flags)
+{
+	struct net_device *dev = qdisc_dev(tp->q);
+	struct tc_cls_u32_offload u32_offload = {0};
+	struct tc_to_netdev offload;
+	int err;
+
+	if (!tc_should_offload(dev, flags))
+		return tc_skip_sw(flags) ? -EINVAL : 0;
+
+	offload.type = TC_SETUP_CLSU32;
+	offload.cls_u32 = &u32_offload;
+	u32_offload.command = TC_CLSU32_REPLACE_KNODE;
+	u32_offload.knode.handle = n->handle;
+	u32_offload.knode.fshift = n->fshift;
+#ifdef CONFIG_CLS_U32_MARK
+	u32_offload.knode.val = n->mark.val;
+	u32_offload.knode.mask = n->mark.mask;
+#endif
+	u32_offload.knode.sel = &n->sel;
+	u32_offload.knode.exts = &n->exts;
+	if (n->ht_down)
+		u32_offload.knode.link_handle = n->ht_down->handle;
+
+	err = dev->netdev_ops->ndo_setup_tc_offload(dev, tp->q->handle,
+						    tp->protocol, &offload);
+	return tc_skip_sw(flags) ? err : 0;
+}
+
+static void u32_replace_hw_hnode(struct tcf_proto *tp, struct tc_u_hnode *h,
+				 u32 flags)
+{
+	struct net_device *dev = qdisc_dev(tp->q);
+	struct tc_cls_u32_offload u32_offload = {0};
+	struct tc_to_netdev offload;
+
+	if (!tc_should_offload(dev, flags))
+		return;
+
+	offload.type = TC_SETUP_CLSU32;
+	offload.cls_u32 = &u32_offload;
+	u32_offload.command = TC_CLSU32_NEW_HNODE;
+	u32_offload.hnode.divisor = h->divisor;
+	u32_offload.hnode.handle = h->handle;
+	u32_offload.hnode.prio = h->prio;
+
+	dev->netdev_ops->ndo_setup_tc_offload(dev, tp->q->handle,
+					      tp->protocol, &offload);
+}
+
+static void u32_clear_hw_hnode(struct tcf_proto *tp, struct tc_u_hnode *h)
+{
+	struct net_device *dev = qdisc_dev(tp->q);
+	struct tc_cls_u32_offload u32_offload = {0};
+	struct tc_to_netdev offload;
+
+	if (!tc_should_offload(dev, h->flags))
+		return;
+
+	offload.type = TC_SETUP_CLSU32;
+	offload.cls_u32 = &u32_offload;
+	u32_offload.command = TC_CLSU32_DELETE_HNODE;
+	u32_offload.hnode.divisor = h->divisor;
+	u32_offload.hnode.handle = h->handle;
+	u32_offload.hnode.prio = h->prio;
+
+	dev->netdev_ops->ndo_setup_tc_offload(dev, tp->q->handle,
+					      tp->protocol, &offload);
+}
+
 static int u32_init(struct tcf_proto *tp)
 {
 	struct tc_u_hnode *root_ht;
@@ -332,11 +430,13 @@ static int u32_init(struct tcf_proto *tp)
 
 	tp->root = root_ht;
 	tp->data = tp_c;
+	u32_replace_hw_hnode(tp, root_ht, 0);
 	return 0;
 }
 
 static int u32_destroy_key(struct tcf_proto *tp, struct tc_u_knode *n)
 {
+	u32_remove_hw_knode(tp, n->handle, n->flags);
 	tcf_unbind_filter(tp, &n->res);
 	tcf_exts_destroy(tp, &n->exts);
 	if (n->ht_down)
@@ -391,6 +491,7 @@ static int u32_destroy_hnode(struct tcf_proto *tp, struct tc_u_hnode *ht)
 	WARN_ON(ht->refcnt);
 
 	u32_clear_hnode(tp, ht);
+	u32_clear_hw_hnode(tp, ht);
 
 	for (hn = &tp_c->hlist; *hn; hn = &(*hn)->next) {
 		if (*hn == ht) {
@@ -429,6 +530,7 @@ static void u32_destroy(struct tcf_proto *tp)
 
 			WARN_ON(ht->refcnt != 0);
 
+			u32_clear_hw_hnode(tp, ht);
 			kfree(ht);
 		}
 
@@ -490,6 +592,7 @@ static const struct nla_policy u32_policy[TCA_U32_MAX + 1] = {
 	[TCA_U32_SEL]		= { .len = sizeof(struct tc_u32_sel) },
 	[TCA_U32_INDEV]		= { .type = NLA_STRING, .len = IFNAMSIZ },
 	[TCA_U32_MARK]		= { .len = sizeof(struct tc_u32_mark) },
+	[TCA_U32_FLAGS]		= { .type = NLA_U32 },
 };
 
 static int u32_set_parms(struct net *net, struct tcf_proto *tp,
@@ -562,7 +665,7 @@ static int u32_change(struct net *net, struct sk_buff *in_skb,
 	struct tc_u32_sel *s;
 	struct nlattr *opt = tca[TCA_OPTIONS];
 	struct nlattr *tb[TCA_U32_MAX + 1];
-	u32 htid;
+	u32 htid, flags = 0;
 	int err;
 
 	if (opt == NULL)
@@ -572,13 +675,25 @@ static int u32_change(struct net *net, struct sk_buff *in_skb,
 	if (err < 0)
 		return err;
 
+	if (tb[TCA_U32_FLAGS]) {
+		flags = nla_get_u32(tb[TCA_U32_FLAGS]);
+		if (!tc_flags_valid(flags))
+			return -EINVAL;
+	}
+
 	n = (struct tc_u_knode *)*arg;
 	if (n) {
 		if (TC_U32_KEY(n->handle) == 0)
 			return -EINVAL;
 
-		return u32_set_parms(net, tp, base, n->ht_up, n, tb,
-				     tca[TCA_RATE], ovr);
+		if (tb[TCA_U32_FLAGS] && flags != n->flags)
+			return -EINVAL;
+
+		err = u32_set_parms(net, tp, base, n->ht_up, n, tb,
+				    tca[TCA_RATE], ovr);
+		if (err)
+			return err;
+		return u32_replace_hw_knode(tp, n, n->flags);
 	}
 
 	if (tb[TCA_U32_DIVISOR]) {
@@ -601,8 +716,10 @@ static int u32_change(struct net *net, struct sk_buff *in_skb,
 		ht->divisor = divisor;
 		ht->handle = handle;
 		ht->prio = tp->prio;
+		ht->flags = flags;
 		ht->next = tp_c->hlist;
 		tp_c->hlist = ht;
+		u32_replace_hw_hnode(tp, ht, flags);
 		*arg = (unsigned long)ht;
 		return 0;
 	}
@@ -653,6 +770,7 @@ static int u32_change(struct net *net, struct sk_buff *in_skb,
 	n->ht_up = ht;
 	n->handle = handle;
 	n->fshift = s->hmask ? ffs(ntohl(s->hmask)) - 1 : 0;
+	n->flags = flags;
 	tcf_exts_init(&n->exts, TCA_U32_ACT, TCA_U32_POLICE);
 
 #ifdef CONFIG_CLS_U32_MARK
@@ -668,6 +786,12 @@ static int u32_change(struct net *net, struct sk_buff *in_skb,
 	err = u32_set_parms(net, tp, base, ht, n, tb, tca[TCA_RATE], ovr);
 	if (err == 0) {
 		struct tc_u_knode **ins;
+
+		err = u32_replace_hw_knode(tp, n, flags);
+		if (err) {
+			u32_destroy_key(tp, n);
+			return err;
+		}
 		for (ins = &ht->ht[TC_U32_HASH(handle)]; *ins; ins = &(*ins)->next)
 			if (TC_U32_NODE(handle) < TC_U32_NODE((*ins)->handle))
 				break;
@@ -744,6 +868,8 @@ static int u32_dump(struct net *net, struct tcf_proto *tp, unsigned long fh,
 
 		if (nla_put_u32(skb, TCA_U32_DIVISOR, divisor))
 			goto nla_put_failure;
+		if (ht->flags && nla_put_u32(skb, TCA_U32_FLAGS, ht->flags))
+			goto nla_put_failure;
 	} else {
 		if (nla_put(skb, TCA_U32_SEL,
 			    sizeof(n->sel) + n->sel.nkeys*sizeof(struct tc_u32_key),
@@ -760,6 +886,8 @@ static int u32_dump(struct net *net, struct tcf_proto *tp, unsigned long fh,
 		if (n->ht_down &&
 		    nla_put_u32(skb, TCA_U32_LINK, n->ht_down->handle))
 			goto nla_put_failure;
+		if (n->flags && nla_put_u32(skb, TCA_U32_FLAGS, n->flags))
+			goto nla_put_failure;
 
 #ifdef CONFIG_CLS_U32_MARK
 		if ((n->mark.val || n->mark.mask) &&
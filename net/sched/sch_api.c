@@ -847,6 +847,10 @@ static int qdisc_graft(struct net_device *dev, struct Qdisc *parent,
 		const struct Qdisc_class_ops *cops = parent->ops->cl_ops;
 
 		err = -EOPNOTSUPP;
+		/* only a tx queue root can run without the qdisc lock */
+		if (new && (new->flags & TCQ_F_NOLOCK) &&
+		    !(parent->flags & TCQ_F_MQROOT))
+			return err;
 		if (cops && cops->graft) {
 			unsigned long cl = cops->get(parent, classid);
 			if (cl) {
@@ -1321,6 +1325,7 @@ static int tc_fill_qdisc(struct sk_buff *skb, struct Qdisc *q, u32 clid,
 		goto nla_put_failure;
 	if (q->ops->dump && q->ops->dump(q, skb) < 0)
 		goto nla_put_failure;
+	qdisc_fold_cpu_stats(q);
 	q->qstats.qlen = q->q.qlen;
 
 	stab = rtnl_dereference(q->stab);
@@ -1917,6 +1922,7 @@ static int __init pktsched_init(void)
 	}
 
 	register_qdisc(&pfifo_fast_ops);
+	register_qdisc(&pfifo_nolock_ops);
 	register_qdisc(&pfifo_qdisc_ops);
 	register_qdisc(&bfifo_qdisc_ops);
 	register_qdisc(&pfifo_head_drop_qdisc_ops);
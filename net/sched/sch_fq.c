@@ -211,6 +211,15 @@ static void fq_gc(struct fq_sched_data *q,
 	}
 }
 
+/* Tell the transport that we pace this socket, so that it does not
+ * have to do it itself (see tcp_needs_internal_pacing()).
+ */
+static void fq_take_pacing(const struct fq_sched_data *q, struct sock *sk)
+{
+	if (q->rate_enable && sk->sk_state != TCP_TIME_WAIT)
+		smp_store_release(&sk->sk_pacing_status, SK_PACING_FQ);
+}
+
 static struct fq_flow *fq_classify(struct sk_buff *skb, struct fq_sched_data *q)
 {
 	struct rb_node **p, *parent;
@@ -251,6 +260,7 @@ static struct fq_flow *fq_classify(struct sk_buff *skb, struct fq_sched_data *q)
 				     f->socket_hash != sk->sk_hash)) {
 				f->credit = q->initial_quantum;
 				f->socket_hash = sk->sk_hash;
+				fq_take_pacing(q, sk);
 				f->time_next_packet = 0ULL;
 			}
 			return f;
@@ -268,8 +278,10 @@ static struct fq_flow *fq_classify(struct sk_buff *skb, struct fq_sched_data *q)
 	}
 	fq_flow_set_detached(f);
 	f->sk = sk;
-	if (skb->sk)
+	if (skb->sk) {
 		f->socket_hash = sk->sk_hash;
+		fq_take_pacing(q, sk);
+	}
 	f->credit = q->initial_quantum;
 
 	rb_link_node(&f->fq_node, parent, p);
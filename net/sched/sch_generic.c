@@ -26,6 +26,7 @@
 #include <linux/list.h>
 #include <linux/slab.h>
 #include <linux/if_vlan.h>
+#include <linux/ptr_ring.h>
 #include <net/sch_generic.h>
 #include <net/pkt_sched.h>
 #include <net/dst.h>
@@ -45,17 +46,93 @@ EXPORT_SYMBOL(default_qdisc_ops);
  * - updates to tree and tree walking are only done under the rtnl mutex.
  */
 
+/* Packets dequeued in bulk are chained through skb->next. A GSO packet
+ * can only end such a batch, as dev_hard_start_xmit() hangs its segments
+ * off skb->next.
+ */
+static inline struct sk_buff *qdisc_batch_next(const struct sk_buff *skb)
+{
+	return skb_is_gso(skb) ? NULL : skb->next;
+}
+
+static unsigned int qdisc_batch_len(const struct sk_buff *skb)
+{
+	unsigned int len = 0;
+
+	for (; skb; skb = qdisc_batch_next(skb))
+		len++;
+	return len;
+}
+
+static void kfree_skb_batch(struct sk_buff *skb)
+{
+	while (skb) {
+		struct sk_buff *next = qdisc_batch_next(skb);
+
+		kfree_skb(skb);
+		skb = next;
+	}
+}
+
+static inline void qdisc_qlen_add(struct Qdisc *q, int n)
+{
+	if (q->flags & TCQ_F_NOLOCK)
+		this_cpu_add(q->cpu_stats->qlen, n);
+	else
+		q->q.qlen += n;
+}
+
 static inline int dev_requeue_skb(struct sk_buff *skb, struct Qdisc *q)
 {
-	skb_dst_force(skb);
+	struct sk_buff *p;
+	int n = 0;
+
+	for (p = skb; p; p = qdisc_batch_next(p)) {
+		skb_dst_force(p);
+		n++;
+	}
+	qdisc_qlen_add(q, n);	/* it's still part of the queue */
 	q->gso_skb = skb;
-	q->qstats.requeues++;
-	q->q.qlen++;	/* it's still part of the queue */
+	if (q->flags & TCQ_F_NOLOCK)
+		this_cpu_inc(q->cpu_stats->qstats.requeues);
+	else
+		q->qstats.requeues++;
 	__netif_schedule(q);
 
 	return 0;
 }
 
+/* Bytes the driver can take on @txq before BQL would stop it; drivers
+ * not using BQL report zero, which disables bulk dequeue for them.
+ */
+static inline int qdisc_avail_bulklimit(const struct netdev_queue *txq)
+{
+#ifdef CONFIG_BQL
+	return dql_avail(&txq->dql);
+#else
+	return 0;
+#endif
+}
+
+static void try_bulk_dequeue_skb(struct Qdisc *q, struct sk_buff *skb,
+				 const struct netdev_queue *txq)
+{
+	int bytelimit = qdisc_avail_bulklimit(txq) - skb->len;
+
+	while (bytelimit > 0) {
+		struct sk_buff *nskb = q->dequeue(q);
+
+		if (!nskb)
+			break;
+
+		bytelimit -= nskb->len;
+		skb->next = nskb;
+		skb = nskb;
+		if (skb_is_gso(skb))
+			break;
+	}
+}
+
 static inline struct sk_buff *dequeue_skb(struct Qdisc *q)
 {
 	struct sk_buff *skb = q->gso_skb;
@@ -66,12 +143,17 @@ static inline struct sk_buff *dequeue_skb(struct Qdisc *q)
 		txq = netdev_get_tx_queue(txq->dev, skb_get_queue_mapping(skb));
 		if (!netif_xmit_frozen_or_stopped(txq)) {
 			q->gso_skb = NULL;
-			q->q.qlen--;
+			qdisc_qlen_add(q, -(int)qdisc_batch_len(skb));
 		} else
 			skb = NULL;
 	} else {
-		if (!(q->flags & TCQ_F_ONETXQUEUE) || !netif_xmit_frozen_or_stopped(txq))
+		if (!(q->flags & TCQ_F_ONETXQUEUE) || !netif_xmit_frozen_or_stopped(txq)) {
 			skb = q->dequeue(q);
+			/* all packets of a single queue qdisc go to @txq */
+			if (skb && (q->flags & TCQ_F_ONETXQUEUE) &&
+			    !skb_is_gso(skb))
+				try_bulk_dequeue_skb(q, skb, txq);
+		}
 	}
 
 	return skb;
@@ -90,7 +172,7 @@ static inline int handle_dev_cpu_collision(struct sk_buff *skb,
 		 * detect it by checking xmit owner and drop the packet when
 		 * deadloop is detected. Return OK to try the next skb.
 		 */
-		kfree_skb(skb);
+		kfree_skb_batch(skb);
 		net_warn_ratelimited("Dead loop on netdevice %s, fix it urgently!\n",
 				     dev_queue->dev->name);
 		ret = qdisc_qlen(q);
@@ -107,9 +189,11 @@ static inline int handle_dev_cpu_collision(struct sk_buff *skb,
 }
 
 /*
- * Transmit one skb, and handle the return status as required. Holding the
- * __QDISC_STATE_RUNNING bit guarantees that only one CPU can execute this
- * function.
+ * Transmit one skb, or a batch of them chained by dequeue_skb(), and handle
+ * the return status as required. The driver is told through skb->xmit_more
+ * that further packets follow, a batch not fully sent is requeued as a
+ * whole. Holding the __QDISC_STATE_RUNNING bit guarantees that only one CPU
+ * can execute this function. @root_lock is NULL for TCQ_F_NOLOCK qdiscs.
  *
  * Returns to the caller:
  *				0  - queue is empty or throttled.
@@ -120,21 +204,44 @@ int sch_direct_xmit(struct sk_buff *skb, struct Qdisc *q,
 		    spinlock_t *root_lock)
 {
 	int ret = NETDEV_TX_BUSY;
+	struct sk_buff *next;
 
 	/* And release qdisc */
-	spin_unlock(root_lock);
+	if (root_lock)
+		spin_unlock(root_lock);
 
 	HARD_TX_LOCK(dev, txq, smp_processor_id());
-	if (!netif_xmit_frozen_or_stopped(txq))
-		ret = dev_hard_start_xmit(skb, dev, txq);
+	for (;;) {
+		if (netif_xmit_frozen_or_stopped(txq)) {
+			ret = NETDEV_TX_BUSY;
+			break;
+		}
 
+		next = qdisc_batch_next(skb);
+		if (next)
+			skb->next = NULL;
+		ret = __dev_hard_start_xmit(skb, dev, txq, next != NULL);
+		if (unlikely(!dev_xmit_complete(ret))) {
+			if (next)
+				skb->next = next;
+			break;
+		}
+
+		skb = next;
+		if (!skb)
+			break;
+	}
 	HARD_TX_UNLOCK(dev, txq);
 
-	spin_lock(root_lock);
+	if (root_lock)
+		spin_lock(root_lock);
 
 	if (dev_xmit_complete(ret)) {
-		/* Driver sent out skb successfully or skb was consumed */
-		ret = qdisc_qlen(q);
+		/* Driver sent out skb successfully or skb was consumed.
+		 * The length of a lockless qdisc is not known cheaply, keep
+		 * going until it dequeues nothing.
+		 */
+		ret = root_lock ? qdisc_qlen(q) : 1;
 	} else if (ret == NETDEV_TX_LOCKED) {
 		/* Driver try lock failed */
 		ret = handle_dev_cpu_collision(skb, txq, q);
@@ -154,7 +261,8 @@ int sch_direct_xmit(struct sk_buff *skb, struct Qdisc *q,
 }
 
 /*
- * NOTE: Called under qdisc_lock(q) with locally disabled BH.
+ * NOTE: Called under qdisc_lock(q) with locally disabled BH, or with
+ * just BH disabled for TCQ_F_NOLOCK qdiscs.
  *
  * __QDISC_STATE_RUNNING guarantees only one CPU can process
  * this qdisc at a time. qdisc_lock(q) serializes queue accesses for
@@ -184,7 +292,7 @@ static inline int qdisc_restart(struct Qdisc *q)
 	if (unlikely(!skb))
 		return 0;
 	WARN_ON_ONCE(skb_dst_is_noref(skb));
-	root_lock = qdisc_lock(q);
+	root_lock = q->flags & TCQ_F_NOLOCK ? NULL : qdisc_lock(q);
 	dev = qdisc_dev(q);
 	txq = netdev_get_tx_queue(dev, skb_get_queue_mapping(skb));
 
@@ -537,6 +645,135 @@ struct Qdisc_ops pfifo_fast_ops __read_mostly = {
 	.owner		=	THIS_MODULE,
 };
 
+/* pfifo_fast without the qdisc lock: each band is a ring of skbs that
+ * senders fill concurrently, while whoever owns __QDISC_STATE_RUNNING
+ * drains it.  Every band holds up to tx_queue_len packets.
+ */
+struct pfifo_nolock_priv {
+	struct ptr_ring q[PFIFO_FAST_BANDS];
+};
+
+static int pfifo_nolock_enqueue(struct sk_buff *skb, struct Qdisc *qdisc)
+{
+	int band = prio2band[skb->priority & TC_PRIO_MAX];
+	struct pfifo_nolock_priv *priv = qdisc_priv(qdisc);
+	unsigned int pkt_len = qdisc_pkt_len(skb);
+	struct qdisc_cpu_stats *stats = this_cpu_ptr(qdisc->cpu_stats);
+
+	if (unlikely(ptr_ring_produce(&priv->q[band], skb))) {
+		stats->qstats.drops++;
+		kfree_skb(skb);
+		return NET_XMIT_DROP;
+	}
+
+	/* skb may already be gone, dequeued by another cpu */
+	stats->qlen++;
+	stats->qstats.backlog += pkt_len;
+	return NET_XMIT_SUCCESS;
+}
+
+static struct sk_buff *pfifo_nolock_dequeue(struct Qdisc *qdisc)
+{
+	struct pfifo_nolock_priv *priv = qdisc_priv(qdisc);
+	struct qdisc_cpu_stats *stats;
+	struct sk_buff *skb = NULL;
+	int band;
+
+	for (band = 0; band < PFIFO_FAST_BANDS && !skb; band++) {
+		if (__ptr_ring_empty(&priv->q[band]))
+			continue;
+		skb = ptr_ring_consume(&priv->q[band]);
+	}
+	if (!skb)
+		return NULL;
+
+	stats = this_cpu_ptr(qdisc->cpu_stats);
+	stats->qlen--;
+	stats->qstats.backlog -= qdisc_pkt_len(skb);
+	u64_stats_update_begin(&stats->syncp);
+	bstats_update(&stats->bstats, skb);
+	u64_stats_update_end(&stats->syncp);
+
+	return skb;
+}
+
+static void pfifo_nolock_reset(struct Qdisc *qdisc)
+{
+	struct pfifo_nolock_priv *priv = qdisc_priv(qdisc);
+	struct sk_buff *skb;
+	int band, cpu;
+
+	/* init failed half way */
+	if (!qdisc->cpu_stats)
+		return;
+
+	for (band = 0; band < PFIFO_FAST_BANDS; band++)
+		while ((skb = ptr_ring_consume(&priv->q[band])))
+			kfree_skb(skb);
+
+	for_each_possible_cpu(cpu) {
+		struct qdisc_cpu_stats *stats = per_cpu_ptr(qdisc->cpu_stats,
+							    cpu);
+
+		stats->qlen = 0;
+		stats->qstats.backlog = 0;
+	}
+}
+
+static void pfifo_nolock_skb_free(void *ptr)
+{
+	kfree_skb(ptr);
+}
+
+static void pfifo_nolock_destroy(struct Qdisc *qdisc)
+{
+	struct pfifo_nolock_priv *priv = qdisc_priv(qdisc);
+	int band;
+
+	for (band = 0; band < PFIFO_FAST_BANDS; band++)
+		ptr_ring_cleanup(&priv->q[band], pfifo_nolock_skb_free);
+}
+
+static int pfifo_nolock_init(struct Qdisc *qdisc, struct nlattr *opt)
+{
+	struct pfifo_nolock_priv *priv = qdisc_priv(qdisc);
+	int qlen = max_t(int, qdisc_dev(qdisc)->tx_queue_len, 1);
+	int band, err;
+
+	for (band = 0; band < PFIFO_FAST_BANDS; band++) {
+		err = ptr_ring_init(&priv->q[band], qlen, GFP_KERNEL);
+		if (err)
+			goto err_ring;
+	}
+
+	qdisc->cpu_stats = alloc_percpu(struct qdisc_cpu_stats);
+	if (!qdisc->cpu_stats) {
+		err = -ENOMEM;
+		goto err_ring;
+	}
+
+	qdisc->flags |= TCQ_F_NOLOCK;
+	return 0;
+
+err_ring:
+	while (--band >= 0)
+		ptr_ring_cleanup(&priv->q[band], NULL);
+	return err;
+}
+
+struct Qdisc_ops pfifo_nolock_ops __read_mostly = {
+	.id		=	"pfifo_nolock",
+	.priv_size	=	sizeof(struct pfifo_nolock_priv),
+	.enqueue	=	pfifo_nolock_enqueue,
+	.dequeue	=	pfifo_nolock_dequeue,
+	.peek		=	qdisc_peek_dequeued,
+	.init		=	pfifo_nolock_init,
+	.reset		=	pfifo_nolock_reset,
+	.destroy	=	pfifo_nolock_destroy,
+	.dump		=	pfifo_fast_dump,
+	.owner		=	THIS_MODULE,
+};
+
 static struct lock_class_key qdisc_tx_busylock;
 
 struct Qdisc *qdisc_alloc(struct netdev_queue *dev_queue,
@@ -616,17 +853,62 @@ void qdisc_reset(struct Qdisc *qdisc)
 		ops->reset(qdisc);
 
 	if (qdisc->gso_skb) {
-		kfree_skb(qdisc->gso_skb);
+		kfree_skb_batch(qdisc->gso_skb);
 		qdisc->gso_skb = NULL;
 		qdisc->q.qlen = 0;
 	}
 }
 EXPORT_SYMBOL(qdisc_reset);
 
+/* Sum up the per-cpu counters of a TCQ_F_NOLOCK qdisc into the fields
+ * everybody else reads. Called before reporting them.
+ */
+void qdisc_fold_cpu_stats(struct Qdisc *qdisc)
+{
+	struct gnet_stats_basic_packed bstats = { 0 };
+	struct gnet_stats_queue qstats = { 0 };
+	int qlen = 0;
+	int cpu;
+
+	if (!(qdisc->flags & TCQ_F_NOLOCK))
+		return;
+
+	for_each_possible_cpu(cpu) {
+		const struct qdisc_cpu_stats *stats;
+		unsigned int start;
+		u64 bytes;
+		u32 packets;
+
+		stats = per_cpu_ptr(qdisc->cpu_stats, cpu);
+		do {
+			start = u64_stats_fetch_begin_irq(&stats->syncp);
+			bytes = stats->bstats.bytes;
+			packets = stats->bstats.packets;
+		} while (u64_stats_fetch_retry_irq(&stats->syncp, start));
+
+		bstats.bytes += bytes;
+		bstats.packets += packets;
+		qstats.backlog += stats->qstats.backlog;
+		qstats.drops += stats->qstats.drops;
+		qstats.requeues += stats->qstats.requeues;
+		qstats.overlimits += stats->qstats.overlimits;
+		qlen += stats->qlen;
+	}
+
+	qdisc->bstats = bstats;
+	qdisc->qstats.backlog = qstats.backlog;
+	qdisc->qstats.drops = qstats.drops;
+	qdisc->qstats.requeues = qstats.requeues;
+	qdisc->qstats.overlimits = qstats.overlimits;
+	qdisc->q.qlen = max(qlen, 0);
+}
+EXPORT_SYMBOL(qdisc_fold_cpu_stats);
+
 static void qdisc_rcu_free(struct rcu_head *head)
 {
 	struct Qdisc *qdisc = container_of(head, struct Qdisc, rcu_head);
 
+	free_percpu(qdisc->cpu_stats);
 	kfree((char *) qdisc - qdisc->padded);
 }
 
@@ -652,7 +934,7 @@ void qdisc_destroy(struct Qdisc *qdisc)
 	module_put(ops->owner);
 	dev_put(qdisc_dev(qdisc));
 
-	kfree_skb(qdisc->gso_skb);
+	kfree_skb_batch(qdisc->gso_skb);
 	/*
 	 * gen_estimator est_timer() might access qdisc->q.lock,
 	 * wait a RCU grace period before freeing qdisc.
@@ -786,8 +1068,26 @@ static void dev_deactivate_queue(struct net_device *dev,
 			set_bit(__QDISC_STATE_DEACTIVATED, &qdisc->state);
 
 		rcu_assign_pointer(dev_queue->qdisc, qdisc_default);
-		qdisc_reset(qdisc);
+		/* senders may still be enqueueing, see dev_reset_queue() */
+		if (!(qdisc->flags & TCQ_F_NOLOCK))
+			qdisc_reset(qdisc);
+
+		spin_unlock_bh(qdisc_lock(qdisc));
+	}
+}
+
+/* A TCQ_F_NOLOCK qdisc can only be emptied once nobody can reach it
+ * through dev_queue->qdisc any more and it stopped running.
+ */
+static void dev_reset_queue(struct net_device *dev,
+			    struct netdev_queue *dev_queue,
+			    void *_unused)
+{
+	struct Qdisc *qdisc = dev_queue->qdisc_sleeping;
 
+	if (qdisc && (qdisc->flags & TCQ_F_NOLOCK)) {
+		spin_lock_bh(qdisc_lock(qdisc));
+		qdisc_reset(qdisc);
 		spin_unlock_bh(qdisc_lock(qdisc));
 	}
 }
@@ -850,9 +1150,11 @@ void dev_deactivate_many(struct list_head *head)
 		synchronize_net();
 
 	/* Wait for outstanding qdisc_run calls. */
-	list_for_each_entry(dev, head, close_list)
+	list_for_each_entry(dev, head, close_list) {
 		while (some_qdisc_is_busy(dev))
 			yield();
+		netdev_for_each_tx_queue(dev, dev_reset_queue, NULL);
+	}
 }
 
 void dev_deactivate(struct net_device *dev)
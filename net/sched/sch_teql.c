@@ -313,6 +313,8 @@ restart:
 
 		switch (teql_resolve(skb, skb_res, slave, slave_txq)) {
 		case 0:
+			/* the next packet may well go to another slave */
+			skb->xmit_more = 0;
 			if (__netif_tx_trylock(slave_txq)) {
 				unsigned int length = qdisc_pkt_len(skb);
 
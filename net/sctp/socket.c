@@ -109,6 +109,7 @@ extern int sysctl_sctp_wmem[3];
 
 static int sctp_memory_pressure;
 static atomic_long_t sctp_memory_allocated;
+static DEFINE_PER_CPU(int, sctp_memory_per_cpu_fw_alloc);
 struct percpu_counter sctp_sockets_allocated;
 
 static void sctp_enter_memory_pressure(struct sock *sk)
@@ -2079,7 +2080,15 @@ static int sctp_recvmsg(struct kiocb *iocb, struct sock *sk,
 	if (copied > len)
 		copied = len;
 
+	/* Copy to user space without holding the socket.  Chunks that
+	 * arrive meanwhile are then processed in softirq on the cpu that
+	 * received them, instead of being queued to the backlog and all run
+	 * by release_sock() on this one.  The skb is off the receive queue,
+	 * or pinned for MSG_PEEK, and its event holds the association.
+	 */
+	release_sock(sk);
 	err = skb_copy_datagram_iovec(skb, 0, msg->msg_iov, copied);
+	lock_sock(sk);
 
 	event = sctp_skb2event(skb);
 
@@ -7146,6 +7155,7 @@ struct proto sctp_prot = {
 	.memory_pressure = &sctp_memory_pressure,
 	.enter_memory_pressure = sctp_enter_memory_pressure,
 	.memory_allocated = &sctp_memory_allocated,
+	.per_cpu_fw_alloc = &sctp_memory_per_cpu_fw_alloc,
 	.sockets_allocated = &sctp_sockets_allocated,
 };
 
@@ -7178,6 +7188,7 @@ struct proto sctpv6_prot = {
 	.memory_pressure = &sctp_memory_pressure,
 	.enter_memory_pressure = sctp_enter_memory_pressure,
 	.memory_allocated = &sctp_memory_allocated,
+	.per_cpu_fw_alloc = &sctp_memory_per_cpu_fw_alloc,
 	.sockets_allocated = &sctp_sockets_allocated,
 };
 #endif /* IS_ENABLED(CONFIG_IPV6) */
@@ -438,6 +438,90 @@ out_no_rpciod:
 	return ERR_PTR(err);
 }
 
+/*
+ * Open additional connections to the same server.  Requests are spread
+ * round-robin over all of a client's transports in xprt_reserve(), so a
+ * single mount is no longer limited to the throughput of one TCP flow and
+ * one transport lock.
+ *
+ * The extra transports are only ever used once their port is known:
+ * rpcbind lookups always update the client's primary transport, so
+ * clients that need autobind keep a single connection.  Failing to
+ * create an extra transport is not fatal.
+ */
+static void rpc_clnt_add_xprts(struct rpc_clnt *clnt,
+		struct xprt_create *xprtargs, int resvport,
+		unsigned int nconnect)
+{
+	struct rpc_xprt *xprt;
+	unsigned int i;
+
+	if (clnt->cl_autobind)
+		return;
+	if (nconnect > RPC_MAX_NCONNECT)
+		nconnect = RPC_MAX_NCONNECT;
+
+	for (i = 0; i < nconnect - 1; i++) {
+		xprt = xprt_create_transport(xprtargs);
+		if (IS_ERR(xprt)) {
+			dprintk("RPC:       %s: failed to create transport %u "
+					"for clnt %p: %ld\n", __func__, i + 1,
+					clnt, PTR_ERR(xprt));
+			break;
+		}
+		xprt->resvport = resvport;
+		clnt->cl_xprts[i] = xprt;
+	}
+
+	spin_lock(&clnt->cl_lock);
+	clnt->cl_nconnect = i + 1;
+	spin_unlock(&clnt->cl_lock);
+}
+
+/*
+ * Clones share all of their parent's transports.
+ */
+static void rpc_clnt_share_xprts(struct rpc_clnt *new, struct rpc_clnt *clnt)
+{
+	unsigned int i, n;
+
+	spin_lock(&clnt->cl_lock);
+	n = clnt->cl_nconnect;
+	for (i = 0; i + 1 < n; i++)
+		new->cl_xprts[i] = xprt_get(clnt->cl_xprts[i]);
+	spin_unlock(&clnt->cl_lock);
+
+	spin_lock(&new->cl_lock);
+	new->cl_nconnect = n;
+	spin_unlock(&new->cl_lock);
+}
+
+/*
+ * Detach the additional transports from @clnt.  The caller drops the
+ * references once no reader can see them any more.
+ */
+static unsigned int rpc_clnt_detach_xprts(struct rpc_clnt *clnt,
+		struct rpc_xprt **xprts)
+{
+	unsigned int i, n;
+
+	spin_lock(&clnt->cl_lock);
+	n = clnt->cl_nconnect;
+	clnt->cl_nconnect = 0;
+	for (i = 0; i + 1 < n; i++) {
+		xprts[i] = clnt->cl_xprts[i];
+		clnt->cl_xprts[i] = NULL;
+	}
+	spin_unlock(&clnt->cl_lock);
+	return n > 1 ? n - 1 : 0;
+}
+
+static void rpc_clnt_put_xprts(struct rpc_xprt **xprts, unsigned int n)
+{
+	while (n--)
+		xprt_put(xprts[n]);
+}
+
 struct rpc_clnt *rpc_create_xprt(struct rpc_create_args *args,
 					struct rpc_xprt *xprt)
 {
@@ -482,6 +566,7 @@ EXPORT_SYMBOL_GPL(rpc_create_xprt);
  */
 struct rpc_clnt *rpc_create(struct rpc_create_args *args)
 {
+	struct rpc_clnt *clnt;
 	struct rpc_xprt *xprt;
 	struct xprt_create xprtargs = {
 		.net = args->net,
@@ -546,7 +631,11 @@ struct rpc_clnt *rpc_create(struct rpc_create_args *args)
 	if (args->flags & RPC_CLNT_CREATE_NONPRIVPORT)
 		xprt->resvport = 0;
 
-	return rpc_create_xprt(args, xprt);
+	clnt = rpc_create_xprt(args, xprt);
+	if (!IS_ERR(clnt) && args->nconnect > 1)
+		rpc_clnt_add_xprts(clnt, &xprtargs, xprt->resvport,
+				args->nconnect);
+	return clnt;
 }
 EXPORT_SYMBOL_GPL(rpc_create);
 
@@ -576,6 +665,8 @@ static struct rpc_clnt *__rpc_clone_client(struct rpc_create_args *args,
 		goto out_err;
 	}
 
+	rpc_clnt_share_xprts(new, clnt);
+
 	/* Turn off autobind on clones */
 	new->cl_autobind = 0;
 	new->cl_softrtry = clnt->cl_softrtry;
@@ -650,6 +741,8 @@ int rpc_switch_client_transport(struct rpc_clnt *clnt,
 	const struct rpc_timeout *old_timeo;
 	rpc_authflavor_t pseudoflavor;
 	struct rpc_xprt *xprt, *old;
+	struct rpc_xprt *extra[RPC_MAX_NCONNECT - 1];
+	unsigned int nextra;
 	struct rpc_clnt *parent;
 	int err;
 
@@ -685,9 +778,13 @@ int rpc_switch_client_transport(struct rpc_clnt *clnt,
 	if (err)
 		goto out_revert;
 
+	/* Additional connections still point at the old server */
+	nextra = rpc_clnt_detach_xprts(clnt, extra);
+
 	synchronize_rcu();
 	if (parent != clnt)
 		rpc_release_client(parent);
+	rpc_clnt_put_xprts(extra, nextra);
 	xprt_put(old);
 	dprintk("RPC:       replaced xprt for clnt %p\n", clnt);
 	return 0;
@@ -762,6 +859,8 @@ static struct rpc_clnt *
 rpc_free_client(struct rpc_clnt *clnt)
 {
 	struct rpc_clnt *parent = NULL;
+	struct rpc_xprt *extra[RPC_MAX_NCONNECT - 1];
+	unsigned int nextra;
 
 	dprintk_rcu("RPC:       destroying %s client for %s\n",
 			clnt->cl_program->name,
@@ -772,6 +871,8 @@ rpc_free_client(struct rpc_clnt *clnt)
 	rpc_unregister_client(clnt);
 	rpc_free_iostats(clnt->cl_metrics);
 	clnt->cl_metrics = NULL;
+	nextra = rpc_clnt_detach_xprts(clnt, extra);
+	rpc_clnt_put_xprts(extra, nextra);
 	xprt_put(rcu_dereference_raw(clnt->cl_xprt));
 	rpciod_down();
 	rpc_free_clid(clnt);
@@ -9,6 +9,7 @@
 #include <linux/freezer.h>
 #include <linux/kthread.h>
 #include <linux/slab.h>
+#include <linux/rculist.h>
 #include <net/sock.h>
 #include <linux/sunrpc/stats.h>
 #include <linux/sunrpc/svc_xprt.h>
@@ -37,7 +38,10 @@ static LIST_HEAD(svc_xprt_class_list);
 
 /* SMP locking strategy:
  *
- *	svc_pool->sp_lock protects most of the fields of that pool.
+ *	svc_pool->sp_lock protects sp_sockets and changes to sp_all_threads.
+ *	sp_all_threads is walked under RCU; an idle thread is claimed by
+ *	setting RQ_BUSY, and svc_rqst->rq_lock orders handing it a
+ *	transport against the thread waking up.
  *	svc_serv->sv_lock protects sv_tempsocks, sv_permsocks, sv_tmpcnt.
  *	when both need to be taken (rare), svc_serv->sv_lock is first.
  *	BKL protects svc_serv->sv_nrthread.
@@ -307,25 +311,6 @@ char *svc_print_addr(struct svc_rqst *rqstp, char *buf, size_t len)
 }
 EXPORT_SYMBOL_GPL(svc_print_addr);
 
-/*
- * Queue up an idle server thread.  Must have pool->sp_lock held.
- * Note: this is really a stack rather than a queue, so that we only
- * use as many different threads as we need, and the rest don't pollute
- * the cache.
- */
-static void svc_thread_enqueue(struct svc_pool *pool, struct svc_rqst *rqstp)
-{
-	list_add(&rqstp->rq_list, &pool->sp_threads);
-}
-
-/*
- * Dequeue an nfsd thread.  Must have pool->sp_lock held.
- */
-static void svc_thread_dequeue(struct svc_pool *pool, struct svc_rqst *rqstp)
-{
-	list_del(&rqstp->rq_list);
-}
-
 static bool svc_xprt_has_something_to_do(struct svc_xprt *xprt)
 {
 	if (xprt->xpt_flags & ((1<<XPT_CONN)|(1<<XPT_CLOSE)))
@@ -339,30 +324,21 @@ static bool svc_xprt_has_something_to_do(struct svc_xprt *xprt)
  * Queue up a transport with data pending. If there are idle nfsd
  * processes, wake 'em up.
  *
+ * Idle threads are found by walking the pool's thread list under RCU and
+ * claiming one with RQ_BUSY, so handing a transport straight to a waiting
+ * thread never takes the pool lock.  Only when every thread is busy is
+ * the transport put on sp_sockets under sp_lock.
  */
 void svc_xprt_enqueue(struct svc_xprt *xprt)
 {
 	struct svc_pool *pool;
-	struct svc_rqst	*rqstp;
+	struct svc_rqst	*rqstp = NULL;
 	int cpu;
+	bool queued = false;
 
 	if (!svc_xprt_has_something_to_do(xprt))
 		return;
 
-	cpu = get_cpu();
-	pool = svc_pool_for_cpu(xprt->xpt_server, cpu);
-	put_cpu();
-
-	spin_lock_bh(&pool->sp_lock);
-
-	if (!list_empty(&pool->sp_threads) &&
-	    !list_empty(&pool->sp_sockets))
-		printk(KERN_ERR
-		       "svc_xprt_enqueue: "
-		       "threads and transports both waiting??\n");
-
-	pool->sp_stats.packets++;
-
 	/* Mark transport as busy. It will remain in this state until
 	 * the provider calls svc_xprt_received. We update XPT_BUSY
 	 * atomically because it also guards against trying to enqueue
@@ -371,51 +347,85 @@ void svc_xprt_enqueue(struct svc_xprt *xprt)
 	if (test_and_set_bit(XPT_BUSY, &xprt->xpt_flags)) {
 		/* Don't enqueue transport while already enqueued */
 		dprintk("svc: transport %p busy, not enqueued\n", xprt);
-		goto out_unlock;
+		return;
 	}
 
-	if (!list_empty(&pool->sp_threads)) {
-		rqstp = list_entry(pool->sp_threads.next,
-				   struct svc_rqst,
-				   rq_list);
-		dprintk("svc: transport %p served by daemon %p\n",
-			xprt, rqstp);
-		svc_thread_dequeue(pool, rqstp);
-		if (rqstp->rq_xprt)
-			printk(KERN_ERR
-				"svc_xprt_enqueue: server %p, rq_xprt=%p!\n",
-				rqstp, rqstp->rq_xprt);
-		rqstp->rq_xprt = xprt;
-		svc_xprt_get(xprt);
-		pool->sp_stats.threads_woken++;
+	cpu = get_cpu();
+	pool = svc_pool_for_cpu(xprt->xpt_server, cpu);
+
+	atomic_long_inc(&pool->sp_stats.packets);
+
+redo_search:
+	rcu_read_lock();
+	list_for_each_entry_rcu(rqstp, &pool->sp_all_threads, rq_all) {
+		/* Do a lockless check first */
+		if (test_bit(RQ_BUSY, &rqstp->rq_flags))
+			continue;
+
+		/*
+		 * Once the transport has been queued it can only be
+		 * dequeued by the thread that services it; all we can do
+		 * then is make sure some idle thread goes and looks.
+		 */
+		if (!queued) {
+			spin_lock_bh(&rqstp->rq_lock);
+			if (test_and_set_bit(RQ_BUSY, &rqstp->rq_flags)) {
+				/* raced with another enqueue; try the next */
+				spin_unlock_bh(&rqstp->rq_lock);
+				continue;
+			}
+			dprintk("svc: transport %p served by daemon %p\n",
+				xprt, rqstp);
+			rqstp->rq_xprt = xprt;
+			svc_xprt_get(xprt);
+			spin_unlock_bh(&rqstp->rq_lock);
+		}
+		atomic_long_inc(&pool->sp_stats.threads_woken);
 		wake_up(&rqstp->rq_wait);
-	} else {
+		rcu_read_unlock();
+		goto out;
+	}
+	rcu_read_unlock();
+
+	/*
+	 * No idle thread: queue the transport, then look once more in case
+	 * a thread went idle in the meantime without seeing it.
+	 */
+	if (!queued) {
+		queued = true;
 		dprintk("svc: transport %p put into queue\n", xprt);
+		spin_lock_bh(&pool->sp_lock);
 		list_add_tail(&xprt->xpt_ready, &pool->sp_sockets);
 		pool->sp_stats.sockets_queued++;
+		spin_unlock_bh(&pool->sp_lock);
+		goto redo_search;
 	}
-
-out_unlock:
-	spin_unlock_bh(&pool->sp_lock);
+out:
+	put_cpu();
 }
 EXPORT_SYMBOL_GPL(svc_xprt_enqueue);
 
 /*
- * Dequeue the first transport.  Must be called with the pool->sp_lock held.
+ * Dequeue the first transport, if any.
  */
 static struct svc_xprt *svc_xprt_dequeue(struct svc_pool *pool)
 {
-	struct svc_xprt	*xprt;
+	struct svc_xprt	*xprt = NULL;
 
 	if (list_empty(&pool->sp_sockets))
 		return NULL;
 
-	xprt = list_entry(pool->sp_sockets.next,
-			  struct svc_xprt, xpt_ready);
-	list_del_init(&xprt->xpt_ready);
+	spin_lock_bh(&pool->sp_lock);
+	if (likely(!list_empty(&pool->sp_sockets))) {
+		xprt = list_first_entry(&pool->sp_sockets,
+					struct svc_xprt, xpt_ready);
+		list_del_init(&xprt->xpt_ready);
+		svc_xprt_get(xprt);
 
-	dprintk("svc: transport %p dequeued, inuse=%d\n",
-		xprt, atomic_read(&xprt->xpt_ref.refcount));
+		dprintk("svc: transport %p dequeued, inuse=%d\n",
+			xprt, atomic_read(&xprt->xpt_ref.refcount));
+	}
+	spin_unlock_bh(&pool->sp_lock);
 
 	return xprt;
 }
@@ -488,20 +498,22 @@ void svc_wake_up(struct svc_serv *serv)
 	for (i = 0; i < serv->sv_nrpools; i++) {
 		pool = &serv->sv_pools[i];
 
-		spin_lock_bh(&pool->sp_lock);
-		if (!list_empty(&pool->sp_threads)) {
-			rqstp = list_entry(pool->sp_threads.next,
-					   struct svc_rqst,
-					   rq_list);
+		/*
+		 * Set the flag before looking for an idle thread, so that
+		 * a thread about to go to sleep sees it either way.
+		 */
+		set_bit(SP_TASK_PENDING, &pool->sp_flags);
+		smp_mb__after_atomic();
+
+		rcu_read_lock();
+		list_for_each_entry_rcu(rqstp, &pool->sp_all_threads, rq_all) {
+			if (test_bit(RQ_BUSY, &rqstp->rq_flags))
+				continue;
 			dprintk("svc: daemon %p woken up.\n", rqstp);
-			/*
-			svc_thread_dequeue(pool, rqstp);
-			rqstp->rq_xprt = NULL;
-			 */
 			wake_up(&rqstp->rq_wait);
-		} else
-			pool->sp_task_pending = 1;
-		spin_unlock_bh(&pool->sp_lock);
+			break;
+		}
+		rcu_read_unlock();
 	}
 }
 EXPORT_SYMBOL_GPL(svc_wake_up);
@@ -613,82 +625,92 @@ static int svc_alloc_arg(struct svc_rqst *rqstp)
 	return 0;
 }
 
+static bool svc_thread_should_sleep(struct svc_pool *pool)
+{
+	/* did someone call svc_wake_up, or queue a transport? */
+	if (test_bit(SP_TASK_PENDING, &pool->sp_flags))
+		return false;
+	if (!list_empty(&pool->sp_sockets))
+		return false;
+	/*
+	 * checking kthread_should_stop() here allows us to avoid
+	 * locking and signalling when stopping kthreads that call
+	 * svc_recv. If the thread has already been woken up, then
+	 * we can exit here without sleeping. If not, then it
+	 * it'll be woken up quickly during the schedule_timeout
+	 */
+	if (signalled() || kthread_should_stop())
+		return false;
+	return true;
+}
+
 static struct svc_xprt *svc_get_next_xprt(struct svc_rqst *rqstp, long timeout)
 {
 	struct svc_xprt *xprt;
 	struct svc_pool		*pool = rqstp->rq_pool;
 	DECLARE_WAITQUEUE(wait, current);
-	long			time_left;
+	long			time_left = 1;
 
 	/* Normally we will wait up to 5 seconds for any required
 	 * cache information to be provided.
 	 */
 	rqstp->rq_chandle.thread_wait = 5*HZ;
 
-	spin_lock_bh(&pool->sp_lock);
 	xprt = svc_xprt_dequeue(pool);
-	if (xprt) {
-		rqstp->rq_xprt = xprt;
-		svc_xprt_get(xprt);
+	if (xprt)
+		goto out_found;
 
-		/* As there is a shortage of threads and this request
-		 * had to be queued, don't allow the thread to wait so
-		 * long for cache updates.
-		 */
-		rqstp->rq_chandle.thread_wait = 1*HZ;
-		pool->sp_task_pending = 0;
-	} else {
-		if (pool->sp_task_pending) {
-			pool->sp_task_pending = 0;
-			spin_unlock_bh(&pool->sp_lock);
-			return ERR_PTR(-EAGAIN);
-		}
-		/* No data pending. Go to sleep */
-		svc_thread_enqueue(pool, rqstp);
+	if (test_and_clear_bit(SP_TASK_PENDING, &pool->sp_flags))
+		return ERR_PTR(-EAGAIN);
 
-		/*
-		 * We have to be able to interrupt this wait
-		 * to bring down the daemons ...
-		 */
-		set_current_state(TASK_INTERRUPTIBLE);
+	/*
+	 * No data pending.  Advertise ourselves as idle and go to sleep;
+	 * svc_xprt_enqueue() may hand us a transport directly through
+	 * rq_xprt.  We have to be able to interrupt this wait to bring
+	 * down the daemons ...
+	 */
+	add_wait_queue(&rqstp->rq_wait, &wait);
+	set_current_state(TASK_INTERRUPTIBLE);
+	clear_bit(RQ_BUSY, &rqstp->rq_flags);
+	smp_mb__after_atomic();
 
-		/*
-		 * checking kthread_should_stop() here allows us to avoid
-		 * locking and signalling when stopping kthreads that call
-		 * svc_recv. If the thread has already been woken up, then
-		 * we can exit here without sleeping. If not, then it
-		 * it'll be woken up quickly during the schedule_timeout
-		 */
-		if (kthread_should_stop()) {
-			set_current_state(TASK_RUNNING);
-			spin_unlock_bh(&pool->sp_lock);
-			return ERR_PTR(-EINTR);
-		}
+	if (svc_thread_should_sleep(pool))
+		time_left = schedule_timeout(timeout);
+	__set_current_state(TASK_RUNNING);
+	remove_wait_queue(&rqstp->rq_wait, &wait);
 
-		add_wait_queue(&rqstp->rq_wait, &wait);
-		spin_unlock_bh(&pool->sp_lock);
+	try_to_freeze();
 
-		time_left = schedule_timeout(timeout);
+	spin_lock_bh(&rqstp->rq_lock);
+	set_bit(RQ_BUSY, &rqstp->rq_flags);
+	spin_unlock_bh(&rqstp->rq_lock);
 
-		try_to_freeze();
+	xprt = rqstp->rq_xprt;
+	if (xprt != NULL)
+		return xprt;
 
-		spin_lock_bh(&pool->sp_lock);
-		remove_wait_queue(&rqstp->rq_wait, &wait);
-		if (!time_left)
-			pool->sp_stats.threads_timedout++;
+	xprt = svc_xprt_dequeue(pool);
+	if (xprt)
+		goto out_found;
 
-		xprt = rqstp->rq_xprt;
-		if (!xprt) {
-			svc_thread_dequeue(pool, rqstp);
-			spin_unlock_bh(&pool->sp_lock);
-			dprintk("svc: server %p, no data yet\n", rqstp);
-			if (signalled() || kthread_should_stop())
-				return ERR_PTR(-EINTR);
-			else
-				return ERR_PTR(-EAGAIN);
-		}
-	}
-	spin_unlock_bh(&pool->sp_lock);
+	if (!time_left)
+		atomic_long_inc(&pool->sp_stats.threads_timedout);
+
+	dprintk("svc: server %p, no data yet\n", rqstp);
+	if (signalled() || kthread_should_stop())
+		return ERR_PTR(-EINTR);
+	clear_bit(SP_TASK_PENDING, &pool->sp_flags);
+	return ERR_PTR(-EAGAIN);
+
+out_found:
+	rqstp->rq_xprt = xprt;
+
+	/* As there is a shortage of threads and this request
+	 * had to be queued, don't allow the thread to wait so
+	 * long for cache updates.
+	 */
+	rqstp->rq_chandle.thread_wait = 1*HZ;
+	clear_bit(SP_TASK_PENDING, &pool->sp_flags);
 	return xprt;
 }
 
@@ -1304,10 +1326,10 @@ static int svc_pool_stats_show(struct seq_file *m, void *p)
 
 	seq_printf(m, "%u %lu %lu %lu %lu\n",
 		pool->sp_id,
-		pool->sp_stats.packets,
+		(unsigned long)atomic_long_read(&pool->sp_stats.packets),
 		pool->sp_stats.sockets_queued,
-		pool->sp_stats.threads_woken,
-		pool->sp_stats.threads_timedout);
+		(unsigned long)atomic_long_read(&pool->sp_stats.threads_woken),
+		(unsigned long)atomic_long_read(&pool->sp_stats.threads_timedout));
 
 	return 0;
 }
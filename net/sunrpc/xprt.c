@@ -1126,6 +1126,23 @@ void xprt_free(struct rpc_xprt *xprt)
 }
 EXPORT_SYMBOL_GPL(xprt_free);
 
+/*
+ * Choose the transport for a new request.  Clients with more than one
+ * connection to the server hand them out round-robin.
+ */
+static struct rpc_xprt *xprt_select(struct rpc_clnt *clnt)
+{
+	unsigned int n = ACCESS_ONCE(clnt->cl_nconnect);
+	unsigned int i;
+
+	if (n > 1) {
+		i = (unsigned int)atomic_inc_return(&clnt->cl_xprt_next) % n;
+		if (i != 0)
+			return clnt->cl_xprts[i - 1];
+	}
+	return rcu_dereference(clnt->cl_xprt);
+}
+
 /**
  * xprt_reserve - allocate an RPC request slot
  * @task: RPC task requesting a slot allocation
@@ -1145,7 +1162,7 @@ void xprt_reserve(struct rpc_task *task)
 	task->tk_timeout = 0;
 	task->tk_status = -EAGAIN;
 	rcu_read_lock();
-	xprt = rcu_dereference(task->tk_client->cl_xprt);
+	xprt = xprt_select(task->tk_client);
 	if (!xprt_throttle_congested(xprt, task))
 		xprt->ops->alloc_slot(xprt, task);
 	rcu_read_unlock();
@@ -1171,7 +1188,7 @@ void xprt_retry_reserve(struct rpc_task *task)
 	task->tk_timeout = 0;
 	task->tk_status = -EAGAIN;
 	rcu_read_lock();
-	xprt = rcu_dereference(task->tk_client->cl_xprt);
+	xprt = xprt_select(task->tk_client);
 	xprt->ops->alloc_slot(xprt, task);
 	rcu_read_unlock();
 }
@@ -0,0 +1,277 @@
+/*
+ * TLS record layer on top of TCP.
+ *
+ * Userspace performs the handshake, attaches the "tls" ULP to the
+ * connected socket and passes the negotiated transmit keys with the
+ * TLS_TX socket option.  From then on the kernel frames and encrypts
+ * everything written to the socket, including data sent with
+ * sendfile() and splice(), which is encrypted straight from the page
+ * cache.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/module.h>
+
+#include <net/tcp.h>
+#include <net/inet_common.h>
+#include <linux/highmem.h>
+#include <linux/netdevice.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+#include <net/tls.h>
+
+MODULE_DESCRIPTION("Transport Layer Security Support");
+MODULE_LICENSE("GPL");
+MODULE_ALIAS("tcp-ulp-tls");
+
+enum {
+	TLSV4,
+	TLSV6,
+	TLS_NUM_PROTS,
+};
+
+static struct proto *saved_tcpv6_prot;
+static DEFINE_MUTEX(tcpv6_prot_mutex);
+static struct proto tls_prots[TLS_NUM_PROTS][TLS_NUM_CONFIG];
+
+static void tls_sk_proto_close(struct sock *sk, long timeout)
+{
+	struct tls_context *ctx = tls_get_ctx(sk);
+	void (*sk_proto_close)(struct sock *sk, long timeout);
+
+	lock_sock(sk);
+	sk_proto_close = ctx->sk_proto->close;
+
+	if (ctx->tx_conf == TLS_SW_TX)
+		tls_sw_free_tx_resources(sk);
+
+	sk->sk_prot = ctx->sk_proto;
+	inet_csk(sk)->icsk_ulp_data = NULL;
+	release_sock(sk);
+
+	kfree(ctx);
+	sk_proto_close(sk, timeout);
+}
+
+static int do_tls_getsockopt_tx(struct sock *sk, char __user *optval,
+				int __user *optlen)
+{
+	struct tls_context *ctx = tls_get_ctx(sk);
+	struct tls_crypto_info *crypto_info;
+	int len;
+
+	if (get_user(len, optlen))
+		return -EFAULT;
+
+	if (!optval || len < sizeof(*crypto_info))
+		return -EINVAL;
+
+	crypto_info = &ctx->crypto_send;
+	if (ctx->tx_conf != TLS_SW_TX)
+		return -EBUSY;
+
+	if (len == sizeof(*crypto_info)) {
+		if (copy_to_user(optval, crypto_info, sizeof(*crypto_info)))
+			return -EFAULT;
+		return 0;
+	}
+
+	switch (crypto_info->cipher_type) {
+	case TLS_CIPHER_AES_GCM_128: {
+		struct tls12_crypto_info_aes_gcm_128 aes_gcm_128 = {
+			.info = *crypto_info,
+		};
+
+		if (len != sizeof(aes_gcm_128))
+			return -EINVAL;
+
+		/* the key isn't kept, report where the record stream is */
+		lock_sock(sk);
+		memcpy(aes_gcm_128.iv,
+		       ctx->iv + TLS_CIPHER_AES_GCM_128_SALT_SIZE,
+		       TLS_CIPHER_AES_GCM_128_IV_SIZE);
+		memcpy(aes_gcm_128.salt, ctx->iv,
+		       TLS_CIPHER_AES_GCM_128_SALT_SIZE);
+		memcpy(aes_gcm_128.rec_seq, ctx->rec_seq,
+		       TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE);
+		release_sock(sk);
+
+		if (copy_to_user(optval, &aes_gcm_128, sizeof(aes_gcm_128)))
+			return -EFAULT;
+		return 0;
+	}
+	default:
+		return -EINVAL;
+	}
+}
+
+static int tls_getsockopt(struct sock *sk, int level, int optname,
+			  char __user *optval, int __user *optlen)
+{
+	struct tls_context *ctx = tls_get_ctx(sk);
+
+	if (level != SOL_TLS)
+		return ctx->sk_proto->getsockopt(sk, level, optname, optval,
+						 optlen);
+
+	switch (optname) {
+	case TLS_TX:
+		return do_tls_getsockopt_tx(sk, optval, optlen);
+	default:
+		return -ENOPROTOOPT;
+	}
+}
+
+static int do_tls_setsockopt_tx(struct sock *sk, char __user *optval,
+				unsigned int optlen)
+{
+	struct tls_context *ctx = tls_get_ctx(sk);
+	struct tls_crypto_info *crypto_info;
+	int rc = 0;
+
+	if (!optval || optlen < sizeof(*crypto_info))
+		return -EINVAL;
+
+	/* the keys can only be set once */
+	if (ctx->tx_conf != TLS_BASE_TX)
+		return -EBUSY;
+
+	crypto_info = &ctx->crypto_send;
+	if (copy_from_user(crypto_info, optval, sizeof(*crypto_info))) {
+		rc = -EFAULT;
+		goto err_crypto_info;
+	}
+
+	if (crypto_info->version != TLS_1_2_VERSION) {
+		rc = -ENOTSUPP;
+		goto err_crypto_info;
+	}
+
+	switch (crypto_info->cipher_type) {
+	case TLS_CIPHER_AES_GCM_128:
+		if (optlen != sizeof(struct tls12_crypto_info_aes_gcm_128)) {
+			rc = -EINVAL;
+			goto err_crypto_info;
+		}
+		if (copy_from_user(crypto_info + 1,
+				   optval + sizeof(*crypto_info),
+				   optlen - sizeof(*crypto_info))) {
+			rc = -EFAULT;
+			goto err_crypto_info;
+		}
+		break;
+	default:
+		rc = -EINVAL;
+		goto err_crypto_info;
+	}
+
+	rc = tls_set_sw_offload(sk, ctx);
+	if (rc)
+		goto err_crypto_info;
+
+	/* the cipher has its own copy now */
+	memset(ctx->crypto_send_aes_gcm_128.key, 0,
+	       sizeof(ctx->crypto_send_aes_gcm_128.key));
+
+	ctx->tx_conf = TLS_SW_TX;
+	sk->sk_prot = &tls_prots[ctx->prot_idx][TLS_SW_TX];
+	return 0;
+
+err_crypto_info:
+	memset(&ctx->crypto_send_aes_gcm_128, 0,
+	       sizeof(ctx->crypto_send_aes_gcm_128));
+	return rc;
+}
+
+static int tls_setsockopt(struct sock *sk, int level, int optname,
+			  char __user *optval, unsigned int optlen)
+{
+	struct tls_context *ctx = tls_get_ctx(sk);
+	int rc;
+
+	if (level != SOL_TLS)
+		return ctx->sk_proto->setsockopt(sk, level, optname, optval,
+						 optlen);
+
+	switch (optname) {
+	case TLS_TX:
+		lock_sock(sk);
+		rc = do_tls_setsockopt_tx(sk, optval, optlen);
+		release_sock(sk);
+		return rc;
+	default:
+		return -ENOPROTOOPT;
+	}
+}
+
+static void build_protos(struct proto *prot, struct proto *base)
+{
+	prot[TLS_BASE_TX] = *base;
+	prot[TLS_BASE_TX].setsockopt	= tls_setsockopt;
+	prot[TLS_BASE_TX].getsockopt	= tls_getsockopt;
+	prot[TLS_BASE_TX].close		= tls_sk_proto_close;
+
+	prot[TLS_SW_TX] = prot[TLS_BASE_TX];
+	prot[TLS_SW_TX].sendmsg		= tls_sw_sendmsg;
+	prot[TLS_SW_TX].sendpage	= tls_sw_sendpage;
+}
+
+static int tls_init(struct sock *sk)
+{
+	int ip_ver = sk->sk_family == AF_INET6 ? TLSV6 : TLSV4;
+	struct inet_connection_sock *icsk = inet_csk(sk);
+	struct tls_context *ctx;
+
+	/* only a connected socket is known to not get cloned any more */
+	if (sk->sk_state != TCP_ESTABLISHED)
+		return -ENOTSUPP;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+
+	ctx->sk_proto = sk->sk_prot;
+	ctx->prot_idx = ip_ver;
+	ctx->tx_conf = TLS_BASE_TX;
+
+	/* tcpv6_prot lives in a module, build its copies on first use */
+	if (ip_ver == TLSV6 &&
+	    unlikely(sk->sk_prot != smp_load_acquire(&saved_tcpv6_prot))) {
+		mutex_lock(&tcpv6_prot_mutex);
+		if (likely(sk->sk_prot != saved_tcpv6_prot)) {
+			build_protos(tls_prots[TLSV6], sk->sk_prot);
+			smp_store_release(&saved_tcpv6_prot, sk->sk_prot);
+		}
+		mutex_unlock(&tcpv6_prot_mutex);
+	}
+
+	icsk->icsk_ulp_data = ctx;
+	sk->sk_prot = &tls_prots[ip_ver][TLS_BASE_TX];
+	return 0;
+}
+
+static struct tcp_ulp_ops tcp_tls_ulp_ops __read_mostly = {
+	.name			= "tls",
+	.owner			= THIS_MODULE,
+	.init			= tls_init,
+};
+
+static int __init tls_register(void)
+{
+	build_protos(tls_prots[TLSV4], &tcp_prot);
+
+	return tcp_register_ulp(&tcp_tls_ulp_ops);
+}
+
+static void __exit tls_unregister(void)
+{
+	tcp_unregister_ulp(&tcp_tls_ulp_ops);
+}
+
+module_init(tls_register);
+module_exit(tls_unregister);
@@ -0,0 +1,405 @@
+/*
+ * Software encryption of TLS records.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/module.h>
+#include <linux/uio.h>
+#include <crypto/aead.h>
+
+#include <net/tls.h>
+
+static void tls_bigint_increment(unsigned char *seq, int len)
+{
+	int i;
+
+	for (i = len - 1; i >= 0; i--) {
+		++seq[i];
+		if (seq[i] != 0)
+			break;
+	}
+}
+
+static void tls_advance_record_sn(struct tls_context *ctx)
+{
+	tls_bigint_increment(ctx->rec_seq, sizeof(ctx->rec_seq));
+	tls_bigint_increment(ctx->iv + TLS_CIPHER_AES_GCM_128_SALT_SIZE,
+			     TLS_CIPHER_AES_GCM_128_IV_SIZE);
+}
+
+static void tls_make_prepend(struct tls_context *ctx, unsigned char *buf,
+			     size_t plaintext_len)
+{
+	size_t pkt_len = plaintext_len + TLS_CIPHER_AES_GCM_128_IV_SIZE +
+			 TLS_CIPHER_AES_GCM_128_TAG_SIZE;
+
+	buf[0] = TLS_RECORD_TYPE_DATA;
+	buf[1] = TLS_VERSION_MAJOR(ctx->crypto_send.version);
+	buf[2] = TLS_VERSION_MINOR(ctx->crypto_send.version);
+	buf[3] = pkt_len >> 8;
+	buf[4] = pkt_len & 0xFF;
+
+	/* the explicit part of the nonce goes out in the clear */
+	memcpy(buf + TLS_NONCE_OFFSET,
+	       ctx->iv + TLS_CIPHER_AES_GCM_128_SALT_SIZE,
+	       TLS_CIPHER_AES_GCM_128_IV_SIZE);
+}
+
+static void tls_make_aad(struct tls_context *ctx, size_t plaintext_len)
+{
+	char *buf = ctx->aad_space;
+
+	memcpy(buf, ctx->rec_seq, sizeof(ctx->rec_seq));
+	buf[8] = TLS_RECORD_TYPE_DATA;
+	buf[9] = TLS_VERSION_MAJOR(ctx->crypto_send.version);
+	buf[10] = TLS_VERSION_MINOR(ctx->crypto_send.version);
+	buf[11] = plaintext_len >> 8;
+	buf[12] = plaintext_len & 0xFF;
+}
+
+static void tls_free_plaintext(struct tls_context *ctx)
+{
+	int i;
+
+	for (i = 0; i < ctx->sg_plaintext_num; i++)
+		put_page(sg_page(&ctx->sg_plaintext[i]));
+
+	sg_init_table(ctx->sg_plaintext, TLS_SG_MAX);
+	ctx->sg_plaintext_num = 0;
+	ctx->plaintext_size = 0;
+}
+
+static void tls_free_encrypted(struct tls_context *ctx, int from)
+{
+	int i;
+
+	for (i = from; i < ctx->sg_encrypted_num; i++)
+		put_page(sg_page(&ctx->sg_encrypted[i]));
+
+	ctx->sg_encrypted_num = 0;
+	ctx->pending_index = 0;
+	ctx->pending_offset = 0;
+}
+
+/*
+ * Hand what is left of the last encrypted record to TCP.  Returns 0
+ * once all of it has been taken, otherwise the error that stopped TCP,
+ * -EAGAIN if it ran out of send buffer without blocking.
+ */
+static int tls_push_pending(struct sock *sk, int flags)
+{
+	struct tls_context *ctx = tls_get_ctx(sk);
+
+	flags &= ~MSG_SENDPAGE_NOTLAST;
+
+	while (ctx->pending_index < ctx->sg_encrypted_num) {
+		struct scatterlist *sg = &ctx->sg_encrypted[ctx->pending_index];
+		int sendflags = flags;
+		ssize_t ret;
+
+		if (ctx->pending_index + 1 < ctx->sg_encrypted_num)
+			sendflags |= MSG_SENDPAGE_NOTLAST;
+
+		ret = do_tcp_sendpages(sk, sg_page(sg),
+				       sg->offset + ctx->pending_offset,
+				       sg->length - ctx->pending_offset,
+				       sendflags);
+		if (ret <= 0)
+			return ret ? ret : -EAGAIN;
+
+		ctx->pending_offset += ret;
+		if (ctx->pending_offset == sg->length) {
+			put_page(sg_page(sg));
+			ctx->pending_index++;
+			ctx->pending_offset = 0;
+		}
+	}
+
+	ctx->sg_encrypted_num = 0;
+	ctx->pending_index = 0;
+	return 0;
+}
+
+/*
+ * Close the record being filled: encrypt it into new pages and start
+ * pushing those.  Only called with nothing pending.  If no pages can be
+ * had the record stays open.
+ */
+static int tls_push_record(struct sock *sk, int flags)
+{
+	struct tls_context *ctx = tls_get_ctx(sk);
+	struct scatterlist sg_cipher[TLS_RECORD_PAGES_MAX];
+	size_t left = ctx->plaintext_size + TLS_OVERHEAD_SIZE;
+	struct aead_request *req = ctx->aead_req;
+	struct scatterlist sg_aad;
+	int i, nr_pages, rc;
+
+	nr_pages = DIV_ROUND_UP(left, PAGE_SIZE);
+	sg_init_table(ctx->sg_encrypted, nr_pages);
+	sg_init_table(sg_cipher, nr_pages);
+
+	for (i = 0; i < nr_pages; i++) {
+		unsigned int len = min_t(size_t, left, PAGE_SIZE);
+		struct page *page = alloc_page(sk->sk_allocation);
+
+		if (!page) {
+			while (--i >= 0)
+				put_page(sg_page(&ctx->sg_encrypted[i]));
+			return -ENOMEM;
+		}
+
+		sg_set_page(&ctx->sg_encrypted[i], page, len, 0);
+		sg_set_page(&sg_cipher[i], page, len, 0);
+		left -= len;
+	}
+
+	/* the ciphertext and tag follow the header and explicit nonce */
+	sg_cipher[0].offset += TLS_PREPEND_SIZE;
+	sg_cipher[0].length -= TLS_PREPEND_SIZE;
+
+	tls_make_prepend(ctx, page_address(sg_page(&ctx->sg_encrypted[0])),
+			 ctx->plaintext_size);
+	tls_make_aad(ctx, ctx->plaintext_size);
+	sg_init_one(&sg_aad, ctx->aad_space, TLS_AAD_SPACE_SIZE);
+	sg_mark_end(&ctx->sg_plaintext[ctx->sg_plaintext_num - 1]);
+
+	aead_request_set_tfm(req, ctx->aead_send);
+	aead_request_set_callback(req, 0, NULL, NULL);
+	aead_request_set_assoc(req, &sg_aad, TLS_AAD_SPACE_SIZE);
+	aead_request_set_crypt(req, ctx->sg_plaintext, sg_cipher,
+			       ctx->plaintext_size, ctx->iv);
+	rc = crypto_aead_encrypt(req);
+
+	tls_free_plaintext(ctx);
+
+	ctx->sg_encrypted_num = nr_pages;
+	ctx->pending_index = 0;
+	ctx->pending_offset = 0;
+
+	if (rc) {
+		tls_free_encrypted(ctx, 0);
+		return rc;
+	}
+
+	tls_advance_record_sn(ctx);
+	return tls_push_pending(sk, flags);
+}
+
+int tls_sw_sendmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
+		   size_t size)
+{
+	struct tls_context *ctx = tls_get_ctx(sk);
+	int flags = msg->msg_flags;
+	size_t copied = 0;
+	int ret;
+
+	if (flags & ~(MSG_MORE | MSG_DONTWAIT | MSG_NOSIGNAL |
+		      MSG_CMSG_COMPAT))
+		return -ENOTSUPP;
+	flags &= ~MSG_CMSG_COMPAT;
+
+	lock_sock(sk);
+
+	ret = tls_push_pending(sk, flags);
+	if (ret)
+		goto out;
+
+	while (copied < size) {
+		struct scatterlist *sg = NULL;
+		size_t copy;
+
+		if (!ctx->plain_page || ctx->plain_offset == PAGE_SIZE) {
+			if (ctx->plain_page)
+				put_page(ctx->plain_page);
+			ctx->plain_page = alloc_page(sk->sk_allocation);
+			if (!ctx->plain_page) {
+				ret = -ENOMEM;
+				break;
+			}
+			ctx->plain_offset = 0;
+		}
+
+		/* extend the last entry if it ends where we copy to */
+		if (ctx->sg_plaintext_num) {
+			sg = &ctx->sg_plaintext[ctx->sg_plaintext_num - 1];
+			if (sg_page(sg) != ctx->plain_page ||
+			    sg->offset + sg->length != ctx->plain_offset)
+				sg = NULL;
+		}
+
+		if (!sg && ctx->sg_plaintext_num == TLS_SG_MAX) {
+			ret = tls_push_record(sk, flags | MSG_MORE);
+			if (ret)
+				break;
+			continue;
+		}
+
+		copy = min_t(size_t, size - copied,
+			     PAGE_SIZE - ctx->plain_offset);
+		copy = min_t(size_t, copy,
+			     TLS_MAX_PAYLOAD_SIZE - ctx->plaintext_size);
+
+		ret = memcpy_fromiovecend(page_address(ctx->plain_page) +
+					  ctx->plain_offset,
+					  msg->msg_iov, copied, copy);
+		if (ret)
+			break;
+
+		if (sg) {
+			sg->length += copy;
+		} else {
+			get_page(ctx->plain_page);
+			sg_set_page(&ctx->sg_plaintext[ctx->sg_plaintext_num++],
+				    ctx->plain_page, copy, ctx->plain_offset);
+		}
+		ctx->plain_offset += copy;
+		ctx->plaintext_size += copy;
+		copied += copy;
+
+		if (ctx->plaintext_size == TLS_MAX_PAYLOAD_SIZE) {
+			ret = tls_push_record(sk, copied < size ?
+						  flags | MSG_MORE : flags);
+			if (ret)
+				break;
+		}
+	}
+
+	if (!ret && ctx->plaintext_size && !(flags & MSG_MORE))
+		ret = tls_push_record(sk, flags);
+
+out:
+	release_sock(sk);
+	return copied ? copied : ret;
+}
+
+int tls_sw_sendpage(struct sock *sk, struct page *page,
+		    int offset, size_t size, int flags)
+{
+	struct tls_context *ctx = tls_get_ctx(sk);
+	size_t copied = 0;
+	int ret;
+
+	if (flags & ~(MSG_MORE | MSG_DONTWAIT | MSG_NOSIGNAL |
+		      MSG_SENDPAGE_NOTLAST))
+		return -ENOTSUPP;
+
+	lock_sock(sk);
+
+	ret = tls_push_pending(sk, flags);
+	if (ret)
+		goto out;
+
+	/* the page is encrypted from where it is, no copy */
+	while (copied < size) {
+		size_t copy;
+
+		if (ctx->sg_plaintext_num == TLS_SG_MAX) {
+			ret = tls_push_record(sk, flags | MSG_MORE);
+			if (ret)
+				break;
+		}
+
+		copy = min_t(size_t, size - copied,
+			     TLS_MAX_PAYLOAD_SIZE - ctx->plaintext_size);
+
+		get_page(page);
+		sg_set_page(&ctx->sg_plaintext[ctx->sg_plaintext_num++],
+			    page, copy, offset + copied);
+		ctx->plaintext_size += copy;
+		copied += copy;
+
+		if (ctx->plaintext_size == TLS_MAX_PAYLOAD_SIZE) {
+			ret = tls_push_record(sk, copied < size ?
+						  flags | MSG_MORE : flags);
+			if (ret)
+				break;
+		}
+	}
+
+	if (!ret && ctx->plaintext_size &&
+	    !(flags & (MSG_MORE | MSG_SENDPAGE_NOTLAST)))
+		ret = tls_push_record(sk, flags);
+
+out:
+	release_sock(sk);
+	return copied ? copied : ret;
+}
+
+void tls_sw_free_tx_resources(struct sock *sk)
+{
+	struct tls_context *ctx = tls_get_ctx(sk);
+	int flags = MSG_DONTWAIT | MSG_NOSIGNAL;
+
+	/* try to get out what has been accepted already */
+	if (!tls_push_pending(sk, flags) && ctx->plaintext_size)
+		tls_push_record(sk, flags);
+
+	tls_free_encrypted(ctx, ctx->pending_index);
+	tls_free_plaintext(ctx);
+	if (ctx->plain_page)
+		put_page(ctx->plain_page);
+	ctx->plain_page = NULL;
+
+	aead_request_free(ctx->aead_req);
+	crypto_free_aead(ctx->aead_send);
+}
+
+int tls_set_sw_offload(struct sock *sk, struct tls_context *ctx)
+{
+	struct tls12_crypto_info_aes_gcm_128 *gcm_128_info;
+	int rc;
+
+	switch (ctx->crypto_send.cipher_type) {
+	case TLS_CIPHER_AES_GCM_128:
+		gcm_128_info = &ctx->crypto_send_aes_gcm_128;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	memcpy(ctx->iv, gcm_128_info->salt, TLS_CIPHER_AES_GCM_128_SALT_SIZE);
+	memcpy(ctx->iv + TLS_CIPHER_AES_GCM_128_SALT_SIZE, gcm_128_info->iv,
+	       TLS_CIPHER_AES_GCM_128_IV_SIZE);
+	memcpy(ctx->rec_seq, gcm_128_info->rec_seq,
+	       TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE);
+
+	sg_init_table(ctx->sg_plaintext, TLS_SG_MAX);
+	ctx->sg_plaintext_num = 0;
+	ctx->plaintext_size = 0;
+	ctx->sg_encrypted_num = 0;
+
+	/* records are encrypted in the sending context, no async tfms */
+	ctx->aead_send = crypto_alloc_aead("gcm(aes)", 0, CRYPTO_ALG_ASYNC);
+	if (IS_ERR(ctx->aead_send)) {
+		rc = PTR_ERR(ctx->aead_send);
+		ctx->aead_send = NULL;
+		return rc;
+	}
+
+	rc = crypto_aead_setkey(ctx->aead_send, gcm_128_info->key,
+				TLS_CIPHER_AES_GCM_128_KEY_SIZE);
+	if (rc)
+		goto free_aead;
+
+	rc = crypto_aead_setauthsize(ctx->aead_send,
+				     TLS_CIPHER_AES_GCM_128_TAG_SIZE);
+	if (rc)
+		goto free_aead;
+
+	ctx->aead_req = aead_request_alloc(ctx->aead_send, sk->sk_allocation);
+	if (!ctx->aead_req) {
+		rc = -ENOMEM;
+		goto free_aead;
+	}
+
+	return 0;
+
+free_aead:
+	crypto_free_aead(ctx->aead_send);
+	ctx->aead_send = NULL;
+	return rc;
+}
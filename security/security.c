@@ -572,6 +572,16 @@ int security_inode_permission(struct inode *inode, int mask)
 	return security_ops->inode_permission(inode, mask);
 }
 
+/*
+ * True if security_inode_permission() never denies access, i.e. the
+ * module in place left the capability default in place.
+ */
+bool security_inode_permission_is_default(void)
+{
+	return security_ops->inode_permission ==
+	       default_security_ops.inode_permission;
+}
+
 int security_inode_setattr(struct dentry *dentry, struct iattr *attr)
 {
 	int ret;
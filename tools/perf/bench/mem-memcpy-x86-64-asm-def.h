@@ -10,3 +10,15 @@ MEMCPY_FN(memcpy_c,
 MEMCPY_FN(memcpy_c_e,
 	"x86-64-movsb",
 	"movsb-based memcpy() in arch/x86/lib/memcpy_64.S")
+
+MEMCPY_FN(memcpy_movnti,
+	"x86-64-movnti",
+	"non-temporal movnti-based memcpy() in bench/mem-memcpy-x86-64-nt.S")
+
+MEMCPY_FN(memcpy_avx,
+	"x86-64-avx",
+	"AVX memcpy() in bench/mem-memcpy-x86-64-nt.S")
+
+MEMCPY_FN(memcpy_avx_nt,
+	"x86-64-avx-nt",
+	"non-temporal AVX memcpy() in bench/mem-memcpy-x86-64-nt.S")
@@ -220,6 +220,14 @@ int bench_mem_memcpy(int argc, const char **argv,
 		return 1;
 	}
 
+#ifdef HAVE_ARCH_X86_64_SUPPORT
+	if (strstr(routines[i].name, "-avx") && !__builtin_cpu_supports("avx")) {
+		printf("Routine %s needs AVX, which this cpu lacks\n",
+		       routines[i].name);
+		return 1;
+	}
+#endif
+
 	if (bench_format == BENCH_FORMAT_DEFAULT)
 		printf("# Copying %s Bytes ...\n\n", length_str);
 
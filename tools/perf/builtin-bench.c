@@ -13,6 +13,8 @@
  *  mem   ... memory access performance
  *  numa  ... NUMA scheduling and MM performance
  *  futex ... Futex performance
+ *  epoll ... Event poll performance
+ *  mm    ... Page fault and mmap performance
  */
 #include "perf.h"
 #include "util/util.h"
@@ -59,10 +61,25 @@ static struct bench futex_benchmarks[] = {
 	{ "hash",	"Benchmark for futex hash table",               bench_futex_hash	},
 	{ "wake",	"Benchmark for futex wake calls",               bench_futex_wake	},
 	{ "requeue",	"Benchmark for futex requeue calls",            bench_futex_requeue	},
+	{ "lock-pi",	"Benchmark for futex lock_pi calls",            bench_futex_lock_pi	},
 	{ "all",	"Test all futex benchmarks",			NULL			},
 	{ NULL,		NULL,						NULL			}
 };
 
+static struct bench epoll_benchmarks[] = {
+	{ "wait",	"Benchmark epoll_wait() wakeups",		bench_epoll_wait	},
+	{ "ctl",	"Benchmark epoll_ctl() add/mod/del",		bench_epoll_ctl		},
+	{ "all",	"Test all epoll benchmarks",			NULL			},
+	{ NULL,		NULL,						NULL			}
+};
+
+static struct bench mm_benchmarks[] = {
+	{ "fault",	"Benchmark anonymous page faults",		bench_mm_fault		},
+	{ "mmap",	"Benchmark mmap()/munmap() pairs",		bench_mm_mmap		},
+	{ "all",	"Test all mm benchmarks",			NULL			},
+	{ NULL,		NULL,						NULL			}
+};
+
 struct collection {
 	const char	*name;
 	const char	*summary;
@@ -76,6 +93,8 @@ static struct collection collections[] = {
 	{ "numa",	"NUMA scheduling and MM benchmarks",		numa_benchmarks		},
 #endif
 	{"futex",       "Futex stressing benchmarks",                   futex_benchmarks        },
+	{ "epoll",	"Epoll stressing benchmarks",			epoll_benchmarks	},
+	{ "mm",		"Page fault and mmap benchmarks",		mm_benchmarks		},
 	{ "all",	"All benchmarks",				NULL			},
 	{ NULL,		NULL,						NULL			}
 };
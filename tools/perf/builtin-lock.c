@@ -354,6 +354,12 @@ struct trace_lock_handler {
 
 	int (*release_event)(struct perf_evsel *evsel,
 			     struct perf_sample *sample);
+
+	int (*contention_begin_event)(struct perf_evsel *evsel,
+				      struct perf_sample *sample);
+
+	int (*contention_end_event)(struct perf_evsel *evsel,
+				    struct perf_sample *sample);
 };
 
 static struct lock_seq_stat *get_seq(struct thread_stat *ts, void *addr)
@@ -641,6 +647,118 @@ end:
 	return 0;
 }
 
+/*
+ * lock:contention_begin and lock:contention_end come from the slow
+ * paths of the locks themselves and do not need lockdep.  There is no
+ * lock class name, so locks are told apart by address and the name is
+ * the kind of lock.
+ */
+#define LCB_F_SPIN	(1U << 0)
+#define LCB_F_READ	(1U << 1)
+#define LCB_F_WRITE	(1U << 2)
+#define LCB_F_RT	(1U << 3)
+#define LCB_F_MUTEX	(1U << 4)
+
+static bool contention_mode;
+
+static const char *contention_lock_kind(unsigned int flags)
+{
+	if (flags & LCB_F_MUTEX)
+		return "mutex";
+	if (flags & LCB_F_RT)
+		return "rtmutex";
+	if (flags & LCB_F_SPIN) {
+		if (flags & LCB_F_READ)
+			return "rwlock:R";
+		if (flags & LCB_F_WRITE)
+			return "rwlock:W";
+		return "spinlock";
+	}
+	if (flags & LCB_F_READ)
+		return "rwsem:R";
+	if (flags & LCB_F_WRITE)
+		return "rwsem:W";
+	return "unknown";
+}
+
+static int report_lock_contention_begin_event(struct perf_evsel *evsel,
+					      struct perf_sample *sample)
+{
+	void *addr;
+	struct lock_stat *ls;
+	struct thread_stat *ts;
+	struct lock_seq_stat *seq;
+	u64 tmp = perf_evsel__intval(evsel, sample, "lock_addr");
+	unsigned int flags = perf_evsel__intval(evsel, sample, "flags");
+
+	memcpy(&addr, &tmp, sizeof(void *));
+	contention_mode = true;
+
+	ls = lock_stat_findnew(addr, contention_lock_kind(flags));
+	if (!ls)
+		return -ENOMEM;
+
+	ts = thread_stat_findnew(sample->tid);
+	if (!ts)
+		return -ENOMEM;
+
+	seq = get_seq(ts, addr);
+	if (!seq)
+		return -ENOMEM;
+
+	/* a begin without an end means the end was lost; start over */
+	seq->state = SEQ_STATE_CONTENDED;
+	seq->prev_event_time = sample->time;
+	ls->nr_contended++;
+
+	return 0;
+}
+
+static int report_lock_contention_end_event(struct perf_evsel *evsel,
+					    struct perf_sample *sample)
+{
+	void *addr;
+	struct lock_stat *ls;
+	struct thread_stat *ts;
+	struct lock_seq_stat *seq;
+	u64 contended_term;
+	u64 tmp = perf_evsel__intval(evsel, sample, "lock_addr");
+
+	memcpy(&addr, &tmp, sizeof(void *));
+
+	ts = thread_stat_findnew(sample->tid);
+	if (!ts)
+		return -ENOMEM;
+
+	seq = get_seq(ts, addr);
+	if (!seq)
+		return -ENOMEM;
+
+	if (seq->state != SEQ_STATE_CONTENDED) {
+		/* orphan event, do nothing */
+		goto free_seq;
+	}
+
+	ls = lock_stat_findnew(addr, "unknown");
+	if (!ls)
+		return -ENOMEM;
+
+	contended_term = sample->time - seq->prev_event_time;
+	ls->wait_time_total += contended_term;
+	if (contended_term < ls->wait_time_min)
+		ls->wait_time_min = contended_term;
+	if (ls->wait_time_max < contended_term)
+		ls->wait_time_max = contended_term;
+
+	ls->nr_acquired++;
+	ls->avg_wait_time = ls->wait_time_total / ls->nr_contended;
+
+free_seq:
+	list_del(&seq->list);
+	free(seq);
+	return 0;
+}
+
 /* lock oriented handlers */
 /* TODO: handlers for CPU oriented, thread oriented */
 static struct trace_lock_handler report_lock_ops  = {
@@ -648,6 +766,8 @@ static struct trace_lock_handler report_lock_ops  = {
 	.acquired_event		= report_lock_acquired_event,
 	.contended_event	= report_lock_contended_event,
 	.release_event		= report_lock_release_event,
+	.contention_begin_event	= report_lock_contention_begin_event,
+	.contention_end_event	= report_lock_contention_end_event,
 };
 
 static struct trace_lock_handler *trace_handler;
@@ -684,6 +804,22 @@ static int perf_evsel__process_lock_release(struct perf_evsel *evsel,
 	return 0;
 }
 
+static int perf_evsel__process_contention_begin(struct perf_evsel *evsel,
+					       struct perf_sample *sample)
+{
+	if (trace_handler->contention_begin_event)
+		return trace_handler->contention_begin_event(evsel, sample);
+	return 0;
+}
+
+static int perf_evsel__process_contention_end(struct perf_evsel *evsel,
+					     struct perf_sample *sample)
+{
+	if (trace_handler->contention_end_event)
+		return trace_handler->contention_end_event(evsel, sample);
+	return 0;
+}
+
 static void print_bad_events(int bad, int total)
 {
 	/* Output for debug, this have to be removed */
@@ -706,6 +842,8 @@ static void print_result(void)
 	char cut_name[20];
 	int bad, total;
 
+	if (contention_mode)
+		pr_info("%18s ", "Address");
 	pr_info("%20s ", "Name");
 	pr_info("%10s ", "acquired");
 	pr_info("%10s ", "contended");
@@ -726,6 +864,9 @@ static void print_result(void)
 		}
 		bzero(cut_name, 20);
 
+		if (contention_mode)
+			pr_info("%18p ", st->addr);
+
 		if (strlen(st->name) < 16) {
 			/* output raw name */
 			pr_info("%20s ", st->name);
@@ -846,6 +987,11 @@ static const struct perf_evsel_str_handler lock_tracepoints[] = {
 	{ "lock:lock_release",	 perf_evsel__process_lock_release,   }, /* CONFIG_LOCKDEP */
 };
 
+static const struct perf_evsel_str_handler contention_tracepoints[] = {
+	{ "lock:contention_begin", perf_evsel__process_contention_begin, },
+	{ "lock:contention_end",   perf_evsel__process_contention_end,   },
+};
+
 static int __cmd_report(bool display_info)
 {
 	int err = -EINVAL;
@@ -868,7 +1014,9 @@ static int __cmd_report(bool display_info)
 	if (!perf_session__has_traces(session, "lock record"))
 		goto out_delete;
 
-	if (perf_session__set_tracepoints_handlers(session, lock_tracepoints)) {
+	if (perf_session__set_tracepoints_handlers(session, lock_tracepoints) ||
+	    perf_session__set_tracepoints_handlers(session,
+						   contention_tracepoints)) {
 		pr_err("Initializing perf session tracepoint handlers failed\n");
 		goto out_delete;
 	}
@@ -898,21 +1046,40 @@ static int __cmd_record(int argc, const char **argv)
 	const char *record_args[] = {
 		"record", "-R", "-m", "1024", "-c", "1",
 	};
+	const struct perf_evsel_str_handler *tracepoints = lock_tracepoints;
+	unsigned int nr_tracepoints = ARRAY_SIZE(lock_tracepoints);
 	unsigned int rec_argc, i, j, ret;
 	const char **rec_argv;
 
 	for (i = 0; i < ARRAY_SIZE(lock_tracepoints); i++) {
-		if (!is_valid_tracepoint(lock_tracepoints[i].name)) {
+		if (!is_valid_tracepoint(lock_tracepoints[i].name))
+			break;
+	}
+
+	/*
+	 * Without lockdep, fall back to the contention tracepoints of the
+	 * lock slow paths: no acquire/release counts, but wait times come
+	 * at no cost to uncontended locks.
+	 */
+	if (i < ARRAY_SIZE(lock_tracepoints)) {
+		tracepoints = contention_tracepoints;
+		nr_tracepoints = ARRAY_SIZE(contention_tracepoints);
+
+		for (i = 0; i < nr_tracepoints; i++) {
+			if (!is_valid_tracepoint(tracepoints[i].name)) {
 				pr_err("tracepoint %s is not enabled. "
 				       "Are CONFIG_LOCKDEP and CONFIG_LOCK_STAT enabled?\n",
-				       lock_tracepoints[i].name);
+				       lock_tracepoints[0].name);
 				return 1;
+			}
 		}
+		pr_debug("lockdep tracepoints not available, "
+			 "recording lock contention only\n");
 	}
 
 	rec_argc = ARRAY_SIZE(record_args) + argc - 1;
 	/* factor of 2 is for -e in front of each tracepoint */
-	rec_argc += 2 * ARRAY_SIZE(lock_tracepoints);
+	rec_argc += 2 * nr_tracepoints;
 
 	rec_argv = calloc(rec_argc + 1, sizeof(char *));
 	if (!rec_argv)
@@ -921,9 +1088,9 @@ static int __cmd_record(int argc, const char **argv)
 	for (i = 0; i < ARRAY_SIZE(record_args); i++)
 		rec_argv[i] = strdup(record_args[i]);
 
-	for (j = 0; j < ARRAY_SIZE(lock_tracepoints); j++) {
+	for (j = 0; j < nr_tracepoints; j++) {
 		rec_argv[i++] = "-e";
-		rec_argv[i++] = strdup(lock_tracepoints[j].name);
+		rec_argv[i++] = strdup(tracepoints[j].name);
 	}
 
 	for (j = 1; j < (unsigned int)argc; j++, i++)
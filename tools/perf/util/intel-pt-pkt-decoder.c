@@ -0,0 +1,377 @@
+/*
+ * intel-pt-pkt-decoder.c: split an Intel Processor Trace into packets
+ *
+ * The packet formats are specified in the Intel Architecture Instruction
+ * Set Extensions Programming Reference.  This only splits the stream into
+ * packets; following the control flow also needs the traced binaries.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "intel-pt-pkt-decoder.h"
+
+#define BIT63		((uint64_t)1 << 63)
+
+static const char * const packet_name[] = {
+	[INTEL_PT_BAD]		= "Bad Packet!",
+	[INTEL_PT_PAD]		= "PAD",
+	[INTEL_PT_TNT]		= "TNT",
+	[INTEL_PT_TIP_PGD]	= "TIP.PGD",
+	[INTEL_PT_TIP_PGE]	= "TIP.PGE",
+	[INTEL_PT_TSC]		= "TSC",
+	[INTEL_PT_MODE_EXEC]	= "MODE.Exec",
+	[INTEL_PT_MODE_TSX]	= "MODE.TSX",
+	[INTEL_PT_TIP]		= "TIP",
+	[INTEL_PT_FUP]		= "FUP",
+	[INTEL_PT_PSB]		= "PSB",
+	[INTEL_PT_PSBEND]	= "PSBEND",
+	[INTEL_PT_CBR]		= "CBR",
+	[INTEL_PT_PIP]		= "PIP",
+	[INTEL_PT_OVF]		= "OVF",
+};
+
+const char *intel_pt_pkt_name(enum intel_pt_pkt_type type)
+{
+	return packet_name[type];
+}
+
+static uint64_t get_le(const unsigned char *buf, int n)
+{
+	uint64_t val = 0;
+
+	while (n--)
+		val = (val << 8) | buf[n];
+
+	return val;
+}
+
+/*
+ * Short TNT: a single byte with bit 0 clear, holding up to 6 branch bits
+ * below a stop bit.
+ */
+static int intel_pt_get_short_tnt(unsigned int byte,
+				  struct intel_pt_pkt *packet)
+{
+	int count;
+
+	for (count = 6; count; count--) {
+		if (byte & (1 << (count + 1)))
+			break;
+	}
+
+	packet->type = INTEL_PT_TNT;
+	packet->count = count;
+	packet->payload = (uint64_t)byte << (63 - count);
+
+	return 1;
+}
+
+/* Long TNT: 47 branch bits below a stop bit in a 6 byte payload */
+static int intel_pt_get_long_tnt(const unsigned char *buf, size_t len,
+				 struct intel_pt_pkt *packet)
+{
+	uint64_t payload;
+	int count;
+
+	if (len < 8)
+		return INTEL_PT_NEED_MORE_BYTES;
+
+	/* the two header bytes end up below the payload */
+	payload = get_le(buf, 8);
+
+	for (count = 47; count; count--) {
+		if (payload & BIT63)
+			break;
+		payload <<= 1;
+	}
+
+	packet->type = INTEL_PT_TNT;
+	packet->count = count;
+	packet->payload = payload << 1;
+
+	return 8;
+}
+
+static int intel_pt_get_pip(const unsigned char *buf, size_t len,
+			    struct intel_pt_pkt *packet)
+{
+	if (len < 8)
+		return INTEL_PT_NEED_MORE_BYTES;
+
+	/* CR3[47:5] is stored in bits 47:1 of the payload */
+	packet->type = INTEL_PT_PIP;
+	packet->payload = (get_le(buf + 2, 6) >> 1) << 5;
+
+	return 8;
+}
+
+static int intel_pt_get_cbr(const unsigned char *buf, size_t len,
+			    struct intel_pt_pkt *packet)
+{
+	if (len < 4)
+		return INTEL_PT_NEED_MORE_BYTES;
+
+	packet->type = INTEL_PT_CBR;
+	packet->payload = buf[2];
+
+	return 4;
+}
+
+static int intel_pt_get_psb(const unsigned char *buf, size_t len,
+			    struct intel_pt_pkt *packet)
+{
+	int i;
+
+	if (len < INTEL_PT_PSB_LEN)
+		return INTEL_PT_NEED_MORE_BYTES;
+
+	for (i = 2; i < INTEL_PT_PSB_LEN; i += 2) {
+		if (buf[i] != 0x02 || buf[i + 1] != 0x82)
+			return INTEL_PT_BAD_PACKET;
+	}
+
+	packet->type = INTEL_PT_PSB;
+
+	return INTEL_PT_PSB_LEN;
+}
+
+static int intel_pt_get_ext(const unsigned char *buf, size_t len,
+			    struct intel_pt_pkt *packet)
+{
+	if (len < 2)
+		return INTEL_PT_NEED_MORE_BYTES;
+
+	switch (buf[1]) {
+	case 0xa3: /* Long TNT */
+		return intel_pt_get_long_tnt(buf, len, packet);
+	case 0x43: /* PIP */
+		return intel_pt_get_pip(buf, len, packet);
+	case 0x03: /* CBR */
+		return intel_pt_get_cbr(buf, len, packet);
+	case 0x82: /* PSB */
+		return intel_pt_get_psb(buf, len, packet);
+	case 0x23: /* PSBEND */
+		packet->type = INTEL_PT_PSBEND;
+		return 2;
+	case 0xf3: /* OVF */
+		packet->type = INTEL_PT_OVF;
+		return 2;
+	default:
+		return INTEL_PT_BAD_PACKET;
+	}
+}
+
+static int intel_pt_get_ip(enum intel_pt_pkt_type type, unsigned int byte,
+			   const unsigned char *buf, size_t len,
+			   struct intel_pt_pkt *packet)
+{
+	static const int ip_len[8] = { 0, 2, 4, 6, -1, -1, 8, -1 };
+	int ipbytes = byte >> 5;
+	int n = ip_len[ipbytes];
+
+	if (n < 0)
+		return INTEL_PT_BAD_PACKET;
+
+	if (len < (size_t)n + 1)
+		return INTEL_PT_NEED_MORE_BYTES;
+
+	packet->type = type;
+	packet->count = ipbytes;
+	packet->payload = get_le(buf + 1, n);
+
+	return n + 1;
+}
+
+static int intel_pt_get_mode(const unsigned char *buf, size_t len,
+			     struct intel_pt_pkt *packet)
+{
+	if (len < 2)
+		return INTEL_PT_NEED_MORE_BYTES;
+
+	switch (buf[1] >> 5) {
+	case 0:
+		/* bit 0 is CS.L (64-bit), bit 1 is CS.D */
+		packet->type = INTEL_PT_MODE_EXEC;
+		switch (buf[1] & 3) {
+		case 0:
+			packet->payload = 16;
+			break;
+		case 1:
+			packet->payload = 64;
+			break;
+		case 2:
+			packet->payload = 32;
+			break;
+		default:
+			return INTEL_PT_BAD_PACKET;
+		}
+		break;
+	case 1:
+		/* bit 0 is InTX, bit 1 is TXAbort */
+		packet->type = INTEL_PT_MODE_TSX;
+		if ((buf[1] & 3) == 3)
+			return INTEL_PT_BAD_PACKET;
+		packet->payload = buf[1] & 3;
+		break;
+	default:
+		return INTEL_PT_BAD_PACKET;
+	}
+
+	return 2;
+}
+
+static int intel_pt_get_tsc(const unsigned char *buf, size_t len,
+			    struct intel_pt_pkt *packet)
+{
+	if (len < 8)
+		return INTEL_PT_NEED_MORE_BYTES;
+
+	packet->type = INTEL_PT_TSC;
+	packet->payload = get_le(buf + 1, 7);
+
+	return 8;
+}
+
+/*
+ * intel_pt_get_packet - decode the packet at the start of @buf
+ *
+ * Returns the length of the packet, INTEL_PT_NEED_MORE_BYTES if the
+ * packet is cut short by the end of the data, or INTEL_PT_BAD_PACKET.
+ * After a bad packet, decoding can be resumed at the next PSB.
+ */
+int intel_pt_get_packet(const unsigned char *buf, size_t len,
+			struct intel_pt_pkt *packet)
+{
+	unsigned int byte;
+
+	memset(packet, 0, sizeof(struct intel_pt_pkt));
+
+	if (!len)
+		return INTEL_PT_NEED_MORE_BYTES;
+
+	byte = buf[0];
+
+	if (!(byte & 1)) {
+		if (byte == 0) {
+			packet->type = INTEL_PT_PAD;
+			return 1;
+		}
+		if (byte == 0x02)
+			return intel_pt_get_ext(buf, len, packet);
+		return intel_pt_get_short_tnt(byte, packet);
+	}
+
+	switch (byte & 0x1f) {
+	case 0x0d:
+		return intel_pt_get_ip(INTEL_PT_TIP, byte, buf, len, packet);
+	case 0x11:
+		return intel_pt_get_ip(INTEL_PT_TIP_PGE, byte, buf, len,
+				       packet);
+	case 0x01:
+		return intel_pt_get_ip(INTEL_PT_TIP_PGD, byte, buf, len,
+				       packet);
+	case 0x1d:
+		return intel_pt_get_ip(INTEL_PT_FUP, byte, buf, len, packet);
+	case 0x19:
+		switch (byte) {
+		case 0x99:
+			return intel_pt_get_mode(buf, len, packet);
+		case 0x19:
+			return intel_pt_get_tsc(buf, len, packet);
+		default:
+			return INTEL_PT_BAD_PACKET;
+		}
+	default:
+		return INTEL_PT_BAD_PACKET;
+	}
+}
+
+/*
+ * IP packets carry only the bytes of the target that differ from the
+ * last IP: 2 or 4 low bytes replace those of @last_ip, 6 bytes are sign
+ * extended from bit 47 and 8 bytes are a full address.
+ */
+uint64_t intel_pt_pkt_ip(const struct intel_pt_pkt *packet, uint64_t last_ip)
+{
+	uint64_t ip;
+
+	switch (packet->count) {
+	case 1:
+		ip = (last_ip & ~(uint64_t)0xffff) | packet->payload;
+		break;
+	case 2:
+		ip = (last_ip & ~(uint64_t)0xffffffff) | packet->payload;
+		break;
+	case 3:
+		ip = packet->payload;
+		if (ip & ((uint64_t)1 << 47))
+			ip |= (uint64_t)0xffff << 48;
+		break;
+	case 6:
+		ip = packet->payload;
+		break;
+	default:
+		ip = last_ip;
+		break;
+	}
+
+	return ip;
+}
+
+int intel_pt_pkt_desc(const struct intel_pt_pkt *packet, char *buf,
+		      size_t buf_len)
+{
+	const char *name = intel_pt_pkt_name(packet->type);
+	uint64_t payload = packet->payload;
+	int ret, i, blen = buf_len;
+
+	switch (packet->type) {
+	case INTEL_PT_BAD:
+	case INTEL_PT_PAD:
+	case INTEL_PT_PSB:
+	case INTEL_PT_PSBEND:
+	case INTEL_PT_OVF:
+		return snprintf(buf, buf_len, "%s", name);
+	case INTEL_PT_TNT:
+		ret = snprintf(buf, blen, "%s ", name);
+		if (ret < 0)
+			return ret;
+		buf += ret;
+		blen -= ret;
+		for (i = 0; i < packet->count && blen > 1; i++) {
+			*buf++ = payload & BIT63 ? 'T' : 'N';
+			blen -= 1;
+			payload <<= 1;
+		}
+		*buf = '\0';
+		return buf_len - blen;
+	case INTEL_PT_TIP_PGD:
+	case INTEL_PT_TIP_PGE:
+	case INTEL_PT_TIP:
+	case INTEL_PT_FUP:
+		if (!packet->count)
+			return snprintf(buf, buf_len, "%s no ip", name);
+		return snprintf(buf, buf_len, "%s 0x%llx (%d)", name,
+				(unsigned long long)payload, packet->count);
+	case INTEL_PT_MODE_EXEC:
+		return snprintf(buf, buf_len, "%s %lld", name,
+				(unsigned long long)payload);
+	case INTEL_PT_MODE_TSX:
+		return snprintf(buf, buf_len, "%s TXAbort:%u InTX:%u", name,
+				(unsigned int)(payload >> 1) & 1,
+				(unsigned int)payload & 1);
+	case INTEL_PT_TSC:
+	case INTEL_PT_PIP:
+		return snprintf(buf, buf_len, "%s 0x%llx", name,
+				(unsigned long long)payload);
+	case INTEL_PT_CBR:
+		return snprintf(buf, buf_len, "%s %llu", name,
+				(unsigned long long)payload);
+	default:
+		break;
+	}
+
+	return snprintf(buf, buf_len, "%s 0x%llx (%d)", name,
+			(unsigned long long)payload, packet->count);
+}
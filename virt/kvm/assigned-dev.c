@@ -195,6 +195,42 @@ static void kvm_assigned_dev_ack_irq(struct kvm_irq_ack_notifier *kian)
 	spin_unlock(&dev->intx_mask_lock);
 }
 
+/*
+ * Have the IOMMU post the device's MSI/MSI-X messages straight to the
+ * vcpu their guest route targets, the host handlers then no longer run
+ * for them.  Posting is best effort, irqs it can't be set up for keep
+ * going through the host.  Called with kvm->lock held.
+ */
+static void kvm_assigned_dev_update_posting(struct kvm *kvm,
+				struct kvm_assigned_dev_kernel *dev, bool set)
+{
+	unsigned long type = dev->irq_requested_type;
+	int i;
+
+	if ((type & KVM_DEV_IRQ_HOST_MSI) && (type & KVM_DEV_IRQ_GUEST_MSI)) {
+		kvm_arch_update_pi_irte(kvm, dev->host_irq, dev->guest_irq,
+					set);
+	} else if ((type & KVM_DEV_IRQ_HOST_MSIX) &&
+		   (type & KVM_DEV_IRQ_GUEST_MSIX)) {
+		for (i = 0; i < dev->entries_nr; i++)
+			kvm_arch_update_pi_irte(kvm,
+					dev->host_msix_entries[i].vector,
+					dev->guest_msix_entries[i].vector,
+					set);
+	}
+}
+
+/* the guest changed its irq routes, repoint posted device irqs */
+void kvm_assigned_dev_update_irq_routing(struct kvm *kvm)
+{
+	struct kvm_assigned_dev_kernel *dev;
+
+	mutex_lock(&kvm->lock);
+	list_for_each_entry(dev, &kvm->arch.assigned_dev_head, list)
+		kvm_assigned_dev_update_posting(kvm, dev, true);
+	mutex_unlock(&kvm->lock);
+}
+
 static void deassign_guest_irq(struct kvm *kvm,
 			       struct kvm_assigned_dev_kernel *assigned_dev)
 {
@@ -274,6 +310,10 @@ static int kvm_deassign_irq(struct kvm *kvm,
 	host_irq_type = irq_requested_type & KVM_DEV_IRQ_HOST_MASK;
 	guest_irq_type = irq_requested_type & KVM_DEV_IRQ_GUEST_MASK;
 
+	/* hand posted irqs back to the host before tearing anything down */
+	if (host_irq_type || guest_irq_type)
+		kvm_assigned_dev_update_posting(kvm, assigned_dev, false);
+
 	if (host_irq_type)
 		deassign_host_irq(kvm, assigned_dev);
 	if (guest_irq_type)
@@ -570,6 +610,8 @@ static int kvm_vm_ioctl_assign_irq(struct kvm *kvm,
 
 	if (guest_irq_type)
 		r = assign_guest_irq(kvm, match, assigned_irq, guest_irq_type);
+	if (!r)
+		kvm_assigned_dev_update_posting(kvm, match, true);
 out:
 	mutex_unlock(&kvm->lock);
 	return r;
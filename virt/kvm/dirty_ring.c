@@ -0,0 +1,130 @@
+/*
+ * kvm dirty ring support
+ *
+ * Each vcpu logs the guest pages it dirties to a ring shared with
+ * userspace, so that collecting dirty pages costs in proportion to how
+ * many there are rather than to the size of guest memory.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <linux/kvm_host.h>
+#include <linux/kvm_dirty_ring.h>
+#include <linux/vmalloc.h>
+
+int kvm_dirty_ring_alloc(struct kvm_dirty_ring *ring, u32 size)
+{
+	ring->dirty_gfns = vzalloc(size);
+	if (!ring->dirty_gfns)
+		return -ENOMEM;
+
+	ring->size = size / sizeof(struct kvm_dirty_gfn);
+	ring->soft_limit = ring->size - KVM_DIRTY_RING_RSVD_ENTRIES;
+	ring->dirty_index = 0;
+	ring->reset_index = 0;
+	return 0;
+}
+
+void kvm_dirty_ring_free(struct kvm_dirty_ring *ring)
+{
+	vfree(ring->dirty_gfns);
+	ring->dirty_gfns = NULL;
+	ring->size = 0;
+}
+
+struct page *kvm_dirty_ring_get_page(struct kvm_dirty_ring *ring, u32 offset)
+{
+	return vmalloc_to_page((void *)ring->dirty_gfns + offset * PAGE_SIZE);
+}
+
+/*
+ * Must be called by the owner of the ring with preemption disabled.
+ * Returns false if there's no room, the caller then has to log the page
+ * some other way.
+ */
+bool kvm_dirty_ring_push(struct kvm_dirty_ring *ring, u32 slot, u64 offset)
+{
+	struct kvm_dirty_gfn *entry;
+
+	if (!ring->size || kvm_dirty_ring_used(ring) >= ring->size)
+		return false;
+
+	entry = &ring->dirty_gfns[ring->dirty_index & (ring->size - 1)];
+	entry->slot = slot;
+	entry->offset = offset;
+	/* userspace must not see the flag before the gfn */
+	smp_wmb();
+	ACCESS_ONCE(entry->flags) = KVM_DIRTY_GFN_F_DIRTY;
+	ring->dirty_index++;
+	return true;
+}
+
+/*
+ * Slot and offset come from memory userspace can write to, so check
+ * them before touching the rmaps.
+ */
+static void kvm_reset_dirty_gfn(struct kvm *kvm, u32 slot, u64 offset,
+				unsigned long mask)
+{
+	struct kvm_memory_slot *memslot;
+
+	if (!mask || slot >= KVM_USER_MEM_SLOTS)
+		return;
+
+	memslot = id_to_memslot(kvm->memslots, slot);
+	if (!memslot->dirty_bitmap || offset >= memslot->npages)
+		return;
+
+	if (memslot->npages - offset < BITS_PER_LONG)
+		mask &= (1UL << (memslot->npages - offset)) - 1;
+
+	kvm_arch_mmu_enable_log_dirty_pt_masked(kvm, memslot, offset, mask);
+}
+
+/*
+ * Write protect the pages of all entries userspace has collected, from
+ * the oldest on, and hand the entries back to the vcpu.  Consecutive
+ * entries close to each other are protected in one go.  Called with
+ * kvm->slots_lock held, returns the number of entries reset.
+ */
+int kvm_dirty_ring_reset(struct kvm *kvm, struct kvm_dirty_ring *ring)
+{
+	u32 cur_slot = 0, slot;
+	u64 cur_offset = 0, offset;
+	unsigned long mask = 0;
+	int count = 0;
+
+	while (ring->reset_index != ACCESS_ONCE(ring->dirty_index)) {
+		struct kvm_dirty_gfn *entry;
+
+		entry = &ring->dirty_gfns[ring->reset_index & (ring->size - 1)];
+		if (!(ACCESS_ONCE(entry->flags) & KVM_DIRTY_GFN_F_RESET))
+			break;
+
+		/* the gfn may only be read once userspace is done with it */
+		smp_rmb();
+		slot = ACCESS_ONCE(entry->slot);
+		offset = ACCESS_ONCE(entry->offset);
+
+		/* the vcpu may reuse the entry as soon as it sees reset_index */
+		ACCESS_ONCE(entry->flags) = 0;
+		smp_wmb();
+		ring->reset_index++;
+		count++;
+
+		if (mask && slot == cur_slot && offset >= cur_offset &&
+		    offset - cur_offset < BITS_PER_LONG) {
+			mask |= 1UL << (offset - cur_offset);
+			continue;
+		}
+
+		kvm_reset_dirty_gfn(kvm, cur_slot, cur_offset, mask);
+		cur_slot = slot;
+		cur_offset = offset;
+		mask = 1;
+	}
+
+	kvm_reset_dirty_gfn(kvm, cur_slot, cur_offset, mask);
+	return count;
+}
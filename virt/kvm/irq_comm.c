@@ -106,11 +106,9 @@ int kvm_irq_delivery_to_apic(struct kvm *kvm, struct kvm_lapic *src,
 	return r;
 }
 
-static inline void kvm_set_msi_irq(struct kvm_kernel_irq_routing_entry *e,
-				   struct kvm_lapic_irq *irq)
+void kvm_set_msi_irq(struct kvm_kernel_irq_routing_entry *e,
+		     struct kvm_lapic_irq *irq)
 {
-	trace_kvm_msi_set_irq(e->msi.address_lo, e->msi.data);
-
 	irq->dest_id = (e->msi.address_lo &
 			MSI_ADDR_DEST_ID_MASK) >> MSI_ADDR_DEST_ID_SHIFT;
 	irq->vector = (e->msi.data &
@@ -122,6 +120,38 @@ static inline void kvm_set_msi_irq(struct kvm_kernel_irq_routing_entry *e,
 	irq->shorthand = 0;
 	/* TODO Deal with RH bit of MSI message address */
 }
+EXPORT_SYMBOL_GPL(kvm_set_msi_irq);
+
+/*
+ * Return the only vcpu @irq can be delivered to, or NULL if there may be
+ * several.  A lowest priority irq with a single possible destination
+ * counts.
+ */
+struct kvm_vcpu *kvm_intr_single_vcpu(struct kvm *kvm,
+				      struct kvm_lapic_irq *irq)
+{
+	struct kvm_vcpu *vcpu, *dest = NULL;
+	int i;
+
+	if (irq->delivery_mode != APIC_DM_FIXED && !kvm_is_dm_lowest_prio(irq))
+		return NULL;
+
+	kvm_for_each_vcpu(i, vcpu, kvm) {
+		if (!kvm_apic_present(vcpu))
+			continue;
+
+		if (!kvm_apic_match_dest(vcpu, NULL, irq->shorthand,
+					irq->dest_id, irq->dest_mode))
+			continue;
+
+		if (dest)
+			return NULL;
+		dest = vcpu;
+	}
+
+	return dest;
+}
+EXPORT_SYMBOL_GPL(kvm_intr_single_vcpu);
 
 int kvm_set_msi(struct kvm_kernel_irq_routing_entry *e,
 		struct kvm *kvm, int irq_source_id, int level, bool line_status)
@@ -131,6 +161,7 @@ int kvm_set_msi(struct kvm_kernel_irq_routing_entry *e,
 	if (!level)
 		return -1;
 
+	trace_kvm_msi_set_irq(e->msi.address_lo, e->msi.data);
 	kvm_set_msi_irq(e, &irq);
 
 	return kvm_irq_delivery_to_apic(kvm, NULL, &irq, NULL);
@@ -143,6 +174,7 @@ static int kvm_set_msi_inatomic(struct kvm_kernel_irq_routing_entry *e,
 	struct kvm_lapic_irq irq;
 	int r;
 
+	trace_kvm_msi_set_irq(e->msi.address_lo, e->msi.data);
 	kvm_set_msi_irq(e, &irq);
 
 	if (kvm_irq_delivery_to_apic_fast(kvm, NULL, &irq, &r, NULL))